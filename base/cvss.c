@@ -9,7 +9,8 @@
  *
  * This file contains utility functions for handling CVSS v2 and v3.
  * get_cvss_score_from_base_metrics calculates the CVSS base score from a CVSS
- * base vector.
+ * base vector, get_cvss_scores_from_base_metrics those of an array of
+ * vectors.  Scores are cached per vector.
  *
  * CVSS v3.1:
  *
@@ -199,37 +200,43 @@ static const struct impact_item impact_map[][3] = {
     },
 };
 
+/**
+ * @brief Describe a CVSS v2 base metric name.
+ */
+struct metric_name
+{
+  const char *name;         /**< Metric name. */
+  enum base_metrics metric; /**< Metric. */
+};
+
+static const struct metric_name metric_names[] = {
+  {"A", A},   {"I", I},   {"C", C},   {"Au", Au},
+  {"AU", Au}, {"AV", AV}, {"AC", AC},
+};
+
 /**
  * @brief Determine base metric enumeration from a string.
  *
  * @param[in]  str Base metric in string form, for example "A".
+ * @param[in]  len Length of str.
  * @param[out] res Where to write the desired value.
  *
  * @return 0 on success, -1 on error.
  */
 static int
-toenum (const char *str, enum base_metrics *res)
+toenum (const char *str, size_t len, enum base_metrics *res)
 {
-  int rc = 0; /* let's be optimistic */
-
-  if (g_strcmp0 (str, "A") == 0)
-    *res = A;
-  else if (g_strcmp0 (str, "I") == 0)
-    *res = I;
-  else if (g_strcmp0 (str, "C") == 0)
-    *res = C;
-  else if (g_strcmp0 (str, "Au") == 0)
-    *res = Au;
-  else if (g_strcmp0 (str, "AU") == 0)
-    *res = Au;
-  else if (g_strcmp0 (str, "AV") == 0)
-    *res = AV;
-  else if (g_strcmp0 (str, "AC") == 0)
-    *res = AC;
-  else
-    rc = -1;
+  size_t i;
+
+  for (i = 0; i < G_N_ELEMENTS (metric_names); i++)
+    if (strlen (metric_names[i].name) == len
+        && memcmp (metric_names[i].name, str, len) == 0)
+      {
+        *res = metric_names[i].metric;
+        return 0;
+      }
 
-  return rc;
+  return -1;
 }
 
 /**
@@ -268,24 +275,28 @@ get_exploitability_subscore (const struct cvss *cvss)
  * @brief  Set impact score from string representation.
  *
  * @param[in] value  The literal value associated to the metric.
+ * @param[in] len    Length of value.
  * @param[in] metric The enumeration constant identifying the metric.
  * @param[out] cvss  The structure to update with the score.
  *
  * @return 0 on success, -1 on error.
  */
 static inline int
-set_impact_from_str (const char *value, enum base_metrics metric,
+set_impact_from_str (const char *value, size_t len, enum base_metrics metric,
                      struct cvss *cvss)
 {
   int i;
 
+  if (len != 1)
+    return -1;
+
   for (i = 0; i < 3; i++)
     {
       const struct impact_item *impact;
 
       impact = &impact_map[metric][i];
 
-      if (g_strcmp0 (impact->name, value) == 0)
+      if (impact->name[0] == *value)
         {
           switch (metric)
             {
@@ -348,64 +359,248 @@ __get_cvss_score (struct cvss *cvss)
 }
 
 /**
- * @brief Calculate CVSS Score.
+ * @brief Get the next colon separated field of a CVSS v2 metric.
+ *
+ * Leading colons are skipped, like strtok does.
+ *
+ * @param[in,out] pos  Position in the metric, moved past the field.
+ * @param[in]     end  End of the metric.
+ * @param[out]    len  Length of the field.
+ *
+ * @return Start of the field, NULL if there is none.
+ */
+static const char *
+v2_field (const char **pos, const char *end, size_t *len)
+{
+  const char *start, *stop;
+
+  start = *pos;
+  while (start < end && *start == ':')
+    start++;
+  if (start == end)
+    return NULL;
+
+  stop = memchr (start, ':', end - start);
+  if (stop == NULL)
+    stop = end;
+  *len = stop - start;
+  *pos = stop < end ? stop + 1 : end;
+  return start;
+}
+
+/**
+ * @brief Calculate CVSS v2 Score.
+ *
+ * Parses the vector in place, without copying it.
  *
  * @param cvss_str Base vector string from which to compute score.
  *
  * @return The resulting score. -1 upon error during parsing.
  */
-double
-get_cvss_score_from_base_metrics (const char *cvss_str)
+static double
+get_cvss_score_from_base_metrics_v2 (const char *cvss_str)
 {
   struct cvss cvss;
-  char *token, *base_str, *base_metrics;
 
-  if (cvss_str == NULL)
-    return -1.0;
+  memset (&cvss, 0x00, sizeof (struct cvss));
+
+  while (1)
+    {
+      const char *end, *pos, *metric_name, *metric_value;
+      size_t name_len, value_len;
+      enum base_metrics mval;
+
+      end = cvss_str + strcspn (cvss_str, "/");
+      pos = cvss_str;
+
+      metric_name = v2_field (&pos, end, &name_len);
+      if (metric_name == NULL)
+        return -1.0;
+
+      metric_value = v2_field (&pos, end, &value_len);
+      if (metric_value == NULL)
+        return -1.0;
+
+      if (toenum (metric_name, name_len, &mval))
+        return -1.0;
+
+      if (set_impact_from_str (metric_value, value_len, mval, &cvss))
+        return -1.0;
+
+      if (*end == '\0')
+        break;
+      cvss_str = end + 1;
+    }
 
+  return __get_cvss_score (&cvss);
+}
+
+/**
+ * @brief Calculate CVSS Score, without the score cache.
+ *
+ * @param cvss_str Base vector string from which to compute score.
+ *
+ * @return The resulting score. -1 upon error during parsing.
+ */
+static double
+cvss_score (const char *cvss_str)
+{
   if (g_str_has_prefix (cvss_str, "CVSS:3.1/")
       || g_str_has_prefix (cvss_str, "CVSS:3.0/"))
     return get_cvss_score_from_base_metrics_v3 (cvss_str
                                                 + strlen ("CVSS:3.X/"));
 
-  memset (&cvss, 0x00, sizeof (struct cvss));
+  return get_cvss_score_from_base_metrics_v2 (cvss_str);
+}
 
-  base_str = base_metrics = g_strdup_printf ("%s/", cvss_str);
+/* Score cache. */
 
-  while ((token = strchr (base_metrics, '/')) != NULL)
-    {
-      char *token2 = strtok (base_metrics, ":");
-      char *metric_name = token2;
-      char *metric_value;
-      enum base_metrics mval;
-      int rc;
+/**
+ * @brief Maximum number of vectors in the score cache.
+ */
+#define CVSS_CACHE_MAX 8192
 
-      *token++ = '\0';
+/**
+ * @brief Maximum length of a vector kept in the score cache.
+ */
+#define CVSS_CACHE_VECTOR_MAX 128
 
-      if (metric_name == NULL)
-        goto ret_err;
+static GHashTable *cvss_cache = NULL; ///< Scores, keyed by vector.
+static GMutex cvss_cache_mutex;       ///< Protects cvss_cache.
 
-      metric_value = strtok (NULL, ":");
+/**
+ * @brief Look up a score in the score cache.
+ *
+ * Must be called with cvss_cache_mutex held.
+ *
+ * @param[in]  cvss_str  Vector.
+ * @param[out] score     Score.
+ *
+ * @return TRUE if the vector is in the cache, else FALSE.
+ */
+static gboolean
+cvss_cache_lookup (const char *cvss_str, double *score)
+{
+  double *cached;
 
-      if (metric_value == NULL)
-        goto ret_err;
+  if (cvss_cache == NULL)
+    return FALSE;
 
-      rc = toenum (metric_name, &mval);
-      if (rc)
-        goto ret_err;
+  cached = g_hash_table_lookup (cvss_cache, cvss_str);
+  if (cached == NULL)
+    return FALSE;
 
-      if (set_impact_from_str (metric_value, mval, &cvss))
-        goto ret_err;
+  *score = *cached;
+  return TRUE;
+}
 
-      base_metrics = token;
-    }
+/**
+ * @brief Add a score to the score cache.
+ *
+ * The cache is emptied when it is full.  Must be called with
+ * cvss_cache_mutex held.
+ *
+ * @param[in]  cvss_str  Vector.
+ * @param[in]  score     Score.
+ */
+static void
+cvss_cache_insert (const char *cvss_str, double score)
+{
+  double *cached;
 
-  g_free (base_str);
-  return __get_cvss_score (&cvss);
+  if (strlen (cvss_str) > CVSS_CACHE_VECTOR_MAX)
+    return;
+
+  if (cvss_cache == NULL)
+    cvss_cache =
+      g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  else if (g_hash_table_size (cvss_cache) >= CVSS_CACHE_MAX)
+    g_hash_table_remove_all (cvss_cache);
+
+  cached = g_new (double, 1);
+  *cached = score;
+  g_hash_table_replace (cvss_cache, g_strdup (cvss_str), cached);
+}
+
+/**
+ * @brief Calculate CVSS Score.
+ *
+ * Scores are kept in a cache, so feeds repeating vectors only parse each of
+ * them once.  Safe to call from several threads.
+ *
+ * @param cvss_str Base vector string from which to compute score.
+ *
+ * @return The resulting score. -1 upon error during parsing.
+ */
+double
+get_cvss_score_from_base_metrics (const char *cvss_str)
+{
+  double score;
+  gboolean found;
+
+  if (cvss_str == NULL)
+    return -1.0;
+
+  g_mutex_lock (&cvss_cache_mutex);
+  found = cvss_cache_lookup (cvss_str, &score);
+  g_mutex_unlock (&cvss_cache_mutex);
+  if (found)
+    return score;
+
+  score = cvss_score (cvss_str);
 
-ret_err:
-  g_free (base_str);
-  return (double) -1;
+  g_mutex_lock (&cvss_cache_mutex);
+  cvss_cache_insert (cvss_str, score);
+  g_mutex_unlock (&cvss_cache_mutex);
+  return score;
+}
+
+/**
+ * @brief Calculate the CVSS Scores of many vectors.
+ *
+ * Like get_cvss_score_from_base_metrics, but only takes the cache lock twice
+ * for the whole batch.
+ *
+ * @param[in]  vectors  Base vector strings.  NULL entries score -1.
+ * @param[in]  count    Number of vectors.
+ * @param[out] scores   Array of count elements for the scores.
+ */
+void
+get_cvss_scores_from_base_metrics (const char *const *vectors, gsize count,
+                                   double *scores)
+{
+  gboolean *missing;
+  gsize i, misses;
+
+  if (vectors == NULL || scores == NULL)
+    return;
+
+  missing = g_new0 (gboolean, count);
+  misses = 0;
+  g_mutex_lock (&cvss_cache_mutex);
+  for (i = 0; i < count; i++)
+    if (vectors[i] == NULL)
+      scores[i] = -1.0;
+    else if (!cvss_cache_lookup (vectors[i], &scores[i]))
+      {
+        missing[i] = TRUE;
+        misses++;
+      }
+  g_mutex_unlock (&cvss_cache_mutex);
+
+  if (misses)
+    {
+      for (i = 0; i < count; i++)
+        if (missing[i])
+          scores[i] = cvss_score (vectors[i]);
+
+      g_mutex_lock (&cvss_cache_mutex);
+      for (i = 0; i < count; i++)
+        if (missing[i])
+          cvss_cache_insert (vectors[i], scores[i]);
+      g_mutex_unlock (&cvss_cache_mutex);
+    }
+  g_free (missing);
 }
 
 /* CVSS v3. */
@@ -438,22 +633,84 @@ roundup (double cvss)
 }
 
 /**
- * @brief Get impact.
+ * @brief CVSS v3 base metrics.
+ */
+enum v3_base_metrics
+{
+  V3_S,      /**< Scope. */
+  V3_C,      /**< Confidentiality. */
+  V3_I,      /**< Integrity. */
+  V3_A,      /**< Availability. */
+  V3_AV,     /**< Attack Vector. */
+  V3_AC,     /**< Attack Complexity. */
+  V3_PR,     /**< Privileges Required. */
+  V3_UI,     /**< User Interaction. */
+  V3_METRICS /**< Number of metrics. */
+};
+
+/**
+ * @brief Describe a CVSS v3 base metric.
+ */
+struct v3_metric
+{
+  const char *name;             /**< Metric name. */
+  gboolean reset;               /**< Whether an unknown value unsets it. */
+  struct impact_item values[4]; /**< Values, up to the first NULL name. */
+};
+
+static const struct v3_metric v3_metrics[] = {
+  [V3_S] = {"S", FALSE, {{"U", 0.0}, {"C", 1.0}}},
+  [V3_C] = {"C", TRUE, {{"N", 0.0}, {"L", 0.22}, {"H", 0.56}}},
+  [V3_I] = {"I", TRUE, {{"N", 0.0}, {"L", 0.22}, {"H", 0.56}}},
+  [V3_A] = {"A", TRUE, {{"N", 0.0}, {"L", 0.22}, {"H", 0.56}}},
+  [V3_AV] = {"AV", FALSE, {{"N", 0.85}, {"A", 0.62}, {"L", 0.55}, {"P", 0.2}}},
+  [V3_AC] = {"AC", FALSE, {{"L", 0.77}, {"H", 0.44}}},
+  [V3_PR] = {"PR", TRUE, {{"N", 0.85}, {"L", 0.62}, {"H", 0.27}}},
+  [V3_UI] = {"UI", FALSE, {{"N", 0.85}, {"R", 0.62}}},
+};
+
+/**
+ * @brief Set a CVSS v3 metric from a "name:value" element of a vector.
  *
- * @param  value  Metric value.
+ * Names and values are case insensitive.  Unknown names are ignored.
  *
- * @return Impact.
+ * @param[in]      str     Element, not NUL terminated.
+ * @param[in]      len     Length of str.
+ * @param[in,out]  values  Metric values, indexed by enum v3_base_metrics.
  */
-static double
-v3_impact (const char *value)
+static void
+v3_set_metric (const char *str, size_t len, double *values)
 {
-  if (strcasecmp (value, "N") == 0)
-    return 0.0;
-  if (strcasecmp (value, "L") == 0)
-    return 0.22;
-  if (strcasecmp (value, "H") == 0)
-    return 0.56;
-  return -1.0;
+  const char *colon, *value;
+  size_t name_len, value_len;
+  int metric, i;
+
+  colon = memchr (str, ':', len);
+  if (colon == NULL)
+    return;
+  name_len = colon - str;
+  value = colon + 1;
+  value_len = len - name_len - 1;
+
+  for (metric = 0; metric < V3_METRICS; metric++)
+    if (strlen (v3_metrics[metric].name) == name_len
+        && g_ascii_strncasecmp (v3_metrics[metric].name, str, name_len) == 0)
+      break;
+  if (metric == V3_METRICS)
+    return;
+
+  for (i = 0; i < (int) G_N_ELEMENTS (v3_metrics[metric].values)
+              && v3_metrics[metric].values[i].name;
+       i++)
+    if (value_len == 1
+        && g_ascii_toupper (*value) == v3_metrics[metric].values[i].name[0])
+      {
+        values[metric] = v3_metrics[metric].values[i].nvalue;
+        return;
+      }
+
+  if (v3_metrics[metric].reset)
+    values[metric] = -1.0;
 }
 
 /**
@@ -466,8 +723,8 @@ v3_impact (const char *value)
 static double
 get_cvss_score_from_base_metrics_v3 (const char *cvss_str)
 {
-  gchar **split, **point;
-  int scope_changed;
+  double values[V3_METRICS];
+  int metric, scope_changed;
   double impact_conf, impact_integ, impact_avail;
   double vector, complexity, privilege, user;
   double isc_base, impact, exploitability, base;
@@ -476,97 +733,35 @@ get_cvss_score_from_base_metrics_v3 (const char *cvss_str)
    * https://www.first.org/cvss/v3.1/specification-document
    * https://www.first.org/cvss/v3.0/specification-document */
 
-  scope_changed = -1;
-  impact_conf = -1.0;
-  impact_integ = -1.0;
-  impact_avail = -1.0;
-  vector = -1.0;
-  complexity = -1.0;
-  privilege = -1.0;
-  user = -1.0;
+  for (metric = 0; metric < V3_METRICS; metric++)
+    values[metric] = -1.0;
 
   /* AV:N/AC:L/PR:N/UI:N/S:C/C:H/I:H/A:N */
 
-  split = g_strsplit (cvss_str, "/", 0);
-  point = split;
-  while (*point)
+  while (1)
     {
-      /* Scope. */
-      if (strncasecmp ("S:", *point, 2) == 0)
-        {
-          if (strcasecmp (*point + 2, "U") == 0)
-            scope_changed = 0;
-          else if (strcasecmp (*point + 2, "C") == 0)
-            scope_changed = 1;
-        }
+      size_t len = strcspn (cvss_str, "/");
 
-      /* Confidentiality. */
-      if (strncasecmp ("C:", *point, 2) == 0)
-        impact_conf = v3_impact (*point + 2);
-
-      /* Integrity. */
-      if (strncasecmp ("I:", *point, 2) == 0)
-        impact_integ = v3_impact (*point + 2);
-
-      /* Availability. */
-      if (strncasecmp ("A:", *point, 2) == 0)
-        impact_avail = v3_impact (*point + 2);
-
-      /* Attack Vector. */
-      if (strncasecmp ("AV:", *point, 3) == 0)
-        {
-          if (strcasecmp (*point + 3, "N") == 0)
-            vector = 0.85;
-          else if (strcasecmp (*point + 3, "A") == 0)
-            vector = 0.62;
-          else if (strcasecmp (*point + 3, "L") == 0)
-            vector = 0.55;
-          else if (strcasecmp (*point + 3, "P") == 0)
-            vector = 0.2;
-        }
-
-      /* Attack Complexity. */
-      if (strncasecmp ("AC:", *point, 3) == 0)
-        {
-          if (strcasecmp (*point + 3, "L") == 0)
-            complexity = 0.77;
-          else if (strcasecmp (*point + 3, "H") == 0)
-            complexity = 0.44;
-        }
-
-      /* Privileges Required. */
-      if (strncasecmp ("PR:", *point, 3) == 0)
-        {
-          if (strcasecmp (*point + 3, "N") == 0)
-            privilege = 0.85;
-          else if (strcasecmp (*point + 3, "L") == 0)
-            privilege = 0.62;
-          else if (strcasecmp (*point + 3, "H") == 0)
-            privilege = 0.27;
-          else
-            privilege = -1.0;
-        }
-
-      /* User Interaction. */
-      if (strncasecmp ("UI:", *point, 3) == 0)
-        {
-          if (strcasecmp (*point + 3, "N") == 0)
-            user = 0.85;
-          else if (strcasecmp (*point + 3, "R") == 0)
-            user = 0.62;
-        }
-
-      point++;
+      v3_set_metric (cvss_str, len, values);
+      if (cvss_str[len] == '\0')
+        break;
+      cvss_str += len + 1;
     }
 
-  g_strfreev (split);
-
   /* All of the base metrics are required. */
 
-  if (scope_changed == -1 || impact_conf == -1.0 || impact_integ == -1.0
-      || impact_avail == -1.0 || vector == -1.0 || complexity == -1.0
-      || privilege == -1.0 || user == -1.0)
-    return -1.0;
+  for (metric = 0; metric < V3_METRICS; metric++)
+    if (values[metric] == -1.0)
+      return -1.0;
+
+  scope_changed = values[V3_S] == 1.0;
+  impact_conf = values[V3_C];
+  impact_integ = values[V3_I];
+  impact_avail = values[V3_A];
+  vector = values[V3_AV];
+  complexity = values[V3_AC];
+  privilege = values[V3_PR];
+  user = values[V3_UI];
 
   /* Privileges Required has a special case for S:C. */
 
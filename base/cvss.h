@@ -18,4 +18,7 @@
 double
 get_cvss_score_from_base_metrics (const char *);
 
+void
+get_cvss_scores_from_base_metrics (const char *const *, gsize, double *);
+
 #endif /* not _GVM_CVSS_H */
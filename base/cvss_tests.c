@@ -113,6 +113,45 @@ Ensure (cvss, get_cvss_score_from_base_metrics_fails)
   CHECK ("cvss:3.0/AV:L/AC:L/PR:N/UI:R/S:U/C:N/I:N/A:H", -1.0);
 }
 
+Ensure (cvss, get_cvss_score_from_base_metrics_caches)
+{
+  double score;
+
+  score = get_cvss_score_from_base_metrics ("AV:N/AC:M/Au:S/C:P/I:N/A:N");
+  assert_that (g_hash_table_contains (cvss_cache,
+                                      "AV:N/AC:M/Au:S/C:P/I:N/A:N"),
+               is_true);
+  assert_that_double (
+    get_cvss_score_from_base_metrics ("AV:N/AC:M/Au:S/C:P/I:N/A:N"),
+    is_equal_to_double (score));
+  assert_that_double (nearest (score), is_equal_to_double (3.5));
+}
+
+Ensure (cvss, get_cvss_scores_from_base_metrics_succeeds)
+{
+  const char *vectors[] = {
+    "AV:N/AC:L/Au:N/C:N/I:N/A:C",
+    NULL,
+    "CVSS:3.1/AV:N/AC:L/PR:N/UI:N/S:U/C:H/I:H/A:H",
+    "AV:N/AC:L/Au:N/C:N/I:N/A:C",
+    "AV:N/AC:L/Au:N/C:N/I:N/A:X",
+  };
+  double scores[G_N_ELEMENTS (vectors)];
+  gsize i;
+
+  get_cvss_scores_from_base_metrics (vectors, G_N_ELEMENTS (vectors), scores);
+  assert_that_double (nearest (scores[0]), is_equal_to_double (7.8));
+  assert_that_double (scores[1], is_equal_to_double (-1.0));
+  assert_that_double (scores[2], is_equal_to_double (9.8));
+  assert_that_double (scores[3], is_equal_to_double (scores[0]));
+  assert_that_double (scores[4], is_equal_to_double (-1.0));
+
+  for (i = 0; i < G_N_ELEMENTS (vectors); i++)
+    if (vectors[i])
+      assert_that_double (get_cvss_score_from_base_metrics (vectors[i]),
+                          is_equal_to_double (scores[i]));
+}
+
 Ensure (cvss, get_cvss_score_from_base_metrics_all_in_feed_match)
 {
   /* Every distinct CVSSv2 vector and score shipped in the feed nvdcve files. */
@@ -1750,6 +1789,9 @@ main (int argc, char **argv)
   add_test_with_context (suite, cvss,
                          get_cvss_score_from_base_metrics_succeeds);
   add_test_with_context (suite, cvss, get_cvss_score_from_base_metrics_fails);
+  add_test_with_context (suite, cvss, get_cvss_score_from_base_metrics_caches);
+  add_test_with_context (suite, cvss,
+                         get_cvss_scores_from_base_metrics_succeeds);
   add_test_with_context (suite, cvss,
                          get_cvss_score_from_base_metrics_succeeds_v3);
   add_test_with_context (suite, cvss,
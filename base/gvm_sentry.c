@@ -14,7 +14,26 @@
 
 #include "gvm_sentry.h"
 
+#include <glib.h> /* for GQueue, GThread, g_random_double */
 #include <stdio.h>
+#include <unistd.h> /* for getpid */
+
+/**
+ * @brief Maximum number of messages waiting to be sent to Sentry.
+ *
+ * Messages logged while the queue is full are dropped.
+ */
+#define SENTRY_QUEUE_MAX 256
+
+/**
+ * @brief Window of the rate limit of similar messages, in microseconds.
+ */
+#define SENTRY_RATE_WINDOW (60 * G_USEC_PER_SEC)
+
+/**
+ * @brief Maximum number of fingerprints kept for the rate limit.
+ */
+#define SENTRY_FINGERPRINTS_MAX 1024
 
 /**
  * @brief Check for sentry support
@@ -60,6 +79,254 @@ is_sentry_initialized ()
 {
   return global_init_sentry;
 }
+
+/**
+ * @brief Rate limit state of the messages with the same fingerprint.
+ */
+struct sentry_fingerprint
+{
+  gint64 window_start; /**< Start of the current window. */
+  guint count;         /**< Messages sent in the current window. */
+  guint suppressed;    /**< Messages suppressed since the last one sent. */
+};
+
+/**
+ * @brief Queue of messages waiting to be sent by the sender thread.
+ */
+static struct
+{
+  GMutex mutex;              /**< Lock for all the fields. */
+  GCond cond;                /**< Signalled when a message is queued. */
+  GQueue messages;           /**< Messages to send. */
+  GHashTable *fingerprints;  /**< Rate limit state per fingerprint. */
+  GThread *thread;           /**< Sender thread, NULL if not running. */
+  pid_t pid;                 /**< Process which started the thread. */
+  int stop;                  /**< Whether the sender thread should stop. */
+  guint dropped;             /**< Messages dropped as the queue was full. */
+} sentry_queue = {.messages = G_QUEUE_INIT};
+
+/**
+ * @brief Fraction of the messages sent to Sentry.
+ */
+static double sentry_sample_rate = 1.0;
+
+/**
+ * @brief Maximum similar messages sent per minute, 0 for no limit.
+ */
+static guint sentry_rate_limit = 10;
+
+/**
+ * @brief Compute the fingerprint of a message.
+ *
+ * Runs of digits are hashed as a single '0', so that messages which only
+ * differ in numbers like addresses, ports or counts are similar.
+ *
+ * @param[in] message Message.
+ *
+ * @return Fingerprint.
+ */
+static guint
+sentry_fingerprint (const char *message)
+{
+  guint hash = 5381;
+
+  while (*message)
+    {
+      char c = *message++;
+
+      if (g_ascii_isdigit (c))
+        {
+          while (g_ascii_isdigit (*message))
+            message++;
+          c = '0';
+        }
+      hash = hash * 33 + c;
+    }
+  return hash;
+}
+
+/**
+ * @brief Send the queued messages to Sentry, until told to stop.
+ *
+ * @param[in] data Unused.
+ *
+ * @return NULL.
+ */
+static gpointer
+sentry_sender (gpointer data)
+{
+  (void) data;
+
+  g_mutex_lock (&sentry_queue.mutex);
+  for (;;)
+    {
+      gchar *message;
+
+      while (g_queue_is_empty (&sentry_queue.messages) && !sentry_queue.stop)
+        g_cond_wait (&sentry_queue.cond, &sentry_queue.mutex);
+      message = g_queue_pop_head (&sentry_queue.messages);
+      if (message == NULL)
+        break;
+      g_mutex_unlock (&sentry_queue.mutex);
+
+      sentry_capture_event (sentry_value_new_message_event (
+        /*   level */ SENTRY_LEVEL_INFO,
+        /*  logger */ "custom",
+        /* message */ message));
+      g_free (message);
+
+      g_mutex_lock (&sentry_queue.mutex);
+    }
+  g_mutex_unlock (&sentry_queue.mutex);
+  return NULL;
+}
+
+/**
+ * @brief Check whether the sender thread was started by a parent process.
+ *
+ * A forked child only inherits the queue, not the sender thread, so queued
+ * messages would never be sent and a full queue would drop all of them.
+ *
+ * @return 1 in a child forked after the start of the thread, else 0.
+ */
+static int
+sentry_sender_forked (void)
+{
+  return sentry_queue.thread != NULL && sentry_queue.pid != getpid ();
+}
+
+/**
+ * @brief Forget the sender thread of the parent, in a forked child.
+ *
+ * The thread cannot be joined and the queue, which may have been locked by
+ * another thread of the parent during the fork, is left alone.
+ */
+static void
+sentry_sender_forget (void)
+{
+  sentry_queue.thread = NULL;
+  sentry_queue.fingerprints = NULL;
+  g_queue_init (&sentry_queue.messages);
+  g_mutex_init (&sentry_queue.mutex);
+  g_cond_init (&sentry_queue.cond);
+}
+
+/**
+ * @brief Start the sender thread.
+ */
+static void
+sentry_sender_start (void)
+{
+  if (sentry_sender_forked ())
+    sentry_sender_forget ();
+  g_mutex_lock (&sentry_queue.mutex);
+  sentry_queue.stop = 0;
+  sentry_queue.dropped = 0;
+  if (sentry_queue.fingerprints == NULL)
+    sentry_queue.fingerprints =
+      g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
+  g_mutex_unlock (&sentry_queue.mutex);
+  sentry_queue.pid = getpid ();
+  sentry_queue.thread =
+    g_thread_try_new ("gvm-sentry", sentry_sender, NULL, NULL);
+}
+
+/**
+ * @brief Stop the sender thread, once it sent the queued messages.
+ *
+ * In a forked child the thread of the parent is only forgotten.
+ */
+static void
+sentry_sender_stop (void)
+{
+  if (sentry_sender_forked ())
+    {
+      sentry_sender_forget ();
+      return;
+    }
+
+  g_mutex_lock (&sentry_queue.mutex);
+  sentry_queue.stop = 1;
+  g_cond_signal (&sentry_queue.cond);
+  g_mutex_unlock (&sentry_queue.mutex);
+  if (sentry_queue.thread)
+    g_thread_join (sentry_queue.thread);
+  sentry_queue.thread = NULL;
+
+  g_mutex_lock (&sentry_queue.mutex);
+  g_queue_clear_full (&sentry_queue.messages, g_free);
+  if (sentry_queue.fingerprints)
+    g_hash_table_destroy (sentry_queue.fingerprints);
+  sentry_queue.fingerprints = NULL;
+  g_mutex_unlock (&sentry_queue.mutex);
+}
+
+/**
+ * @brief Queue a message for the sender thread, unless sampled out or rate
+ * limited.
+ *
+ * @param[in] message Message.
+ */
+static void
+sentry_enqueue (const char *message)
+{
+  struct sentry_fingerprint *state;
+  gpointer key;
+  gint64 now;
+  gchar *event;
+
+  if (sentry_sample_rate < 1.0 && g_random_double () >= sentry_sample_rate)
+    return;
+
+  key = GUINT_TO_POINTER (sentry_fingerprint (message));
+  now = g_get_monotonic_time ();
+  g_mutex_lock (&sentry_queue.mutex);
+  if (sentry_queue.stop || sentry_queue.fingerprints == NULL)
+    {
+      g_mutex_unlock (&sentry_queue.mutex);
+      return;
+    }
+
+  state = g_hash_table_lookup (sentry_queue.fingerprints, key);
+  if (state == NULL)
+    {
+      if (g_hash_table_size (sentry_queue.fingerprints)
+          >= SENTRY_FINGERPRINTS_MAX)
+        g_hash_table_remove_all (sentry_queue.fingerprints);
+      state = g_malloc0 (sizeof (*state));
+      state->window_start = now;
+      g_hash_table_insert (sentry_queue.fingerprints, key, state);
+    }
+  else if (now - state->window_start >= SENTRY_RATE_WINDOW)
+    {
+      state->window_start = now;
+      state->count = 0;
+    }
+  if ((sentry_rate_limit && state->count >= sentry_rate_limit)
+      || g_queue_get_length (&sentry_queue.messages) >= SENTRY_QUEUE_MAX)
+    {
+      if (sentry_rate_limit && state->count >= sentry_rate_limit)
+        state->suppressed++;
+      else
+        sentry_queue.dropped++;
+      g_mutex_unlock (&sentry_queue.mutex);
+      return;
+    }
+  state->count++;
+
+  if (state->suppressed || sentry_queue.dropped)
+    event = g_strdup_printf ("%s (%u similar messages suppressed,"
+                             " %u messages dropped)",
+                             message, state->suppressed,
+                             sentry_queue.dropped);
+  else
+    event = g_strdup (message);
+  state->suppressed = 0;
+  sentry_queue.dropped = 0;
+  g_queue_push_tail (&sentry_queue.messages, event);
+  g_cond_signal (&sentry_queue.cond);
+  g_mutex_unlock (&sentry_queue.mutex);
+}
 #endif /* HAVE_SENTRY */
 
 /**
@@ -79,6 +346,7 @@ gvm_sentry_init (const char *dsn, const char *release)
   sentry_options_set_release (options, release);
   sentry_options_set_sample_rate (options, 1.0);
   sentry_init (options);
+  sentry_sender_start ();
   set_init_sentry ();
 #else
   (void) dsn;
@@ -89,6 +357,14 @@ gvm_sentry_init (const char *dsn, const char *release)
 /**
  * @brief Send a message to Sentry server if it was initialized
  *
+ * The message is sent by a background thread, so that the caller does not
+ * wait for the Sentry server.  Messages are sampled, similar messages are
+ * rate limited, and messages are dropped while too many wait to be sent.
+ * See gvm_sentry_set_sample_rate and gvm_sentry_set_rate_limit.
+ *
+ * In a child forked after gvm_sentry_init the message is sent directly, as
+ * the child has no sender thread.
+ *
  * The function does nothing if HAVE_SENTRY is not defined
  *
  * @param[in] message Message to send
@@ -97,13 +373,15 @@ void
 gvm_sentry_log (const char *message)
 {
 #ifdef HAVE_SENTRY
-  if (is_sentry_initialized ())
-    {
-      sentry_capture_event (sentry_value_new_message_event (
-        /*   level */ SENTRY_LEVEL_INFO,
-        /*  logger */ "custom",
-        /* message */ message));
-    }
+  if (message == NULL || !is_sentry_initialized ())
+    return;
+  if (sentry_queue.thread && !sentry_sender_forked ())
+    sentry_enqueue (message);
+  else
+    sentry_capture_event (sentry_value_new_message_event (
+      /*   level */ SENTRY_LEVEL_INFO,
+      /*  logger */ "custom",
+      /* message */ message));
 #else
   (void) message;
 #endif /* HAVE_SENTRY */
@@ -124,8 +402,47 @@ gvm_close_sentry (void)
 #ifdef HAVE_SENTRY
   if (is_sentry_initialized ())
     {
-      sentry_close ();
       reset_init_sentry ();
+      sentry_sender_stop ();
+      sentry_close ();
     }
 #endif /* HAVE_SENTRY */
 }
+
+/**
+ * @brief Set the fraction of the messages sent to Sentry.
+ *
+ * The function does nothing if HAVE_SENTRY is not defined
+ *
+ * @param[in] rate Fraction between 0 and 1.  1, the default, sends all.
+ */
+void
+gvm_sentry_set_sample_rate (double rate)
+{
+#ifdef HAVE_SENTRY
+  sentry_sample_rate = CLAMP (rate, 0.0, 1.0);
+#else
+  (void) rate;
+#endif /* HAVE_SENTRY */
+}
+
+/**
+ * @brief Set the maximum number of similar messages sent to Sentry per
+ * minute.
+ *
+ * Messages are similar when they only differ in numbers.  The number of
+ * similar messages suppressed is added to the next one sent.
+ *
+ * The function does nothing if HAVE_SENTRY is not defined
+ *
+ * @param[in] per_minute Maximum messages, 0 for no limit.  Default is 10.
+ */
+void
+gvm_sentry_set_rate_limit (unsigned int per_minute)
+{
+#ifdef HAVE_SENTRY
+  sentry_rate_limit = per_minute;
+#else
+  (void) per_minute;
+#endif /* HAVE_SENTRY */
+}
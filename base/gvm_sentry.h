@@ -28,6 +28,12 @@ gvm_sentry_log (const char *);
 void
 gvm_close_sentry (void);
 
+void
+gvm_sentry_set_sample_rate (double);
+
+void
+gvm_sentry_set_rate_limit (unsigned int);
+
 int
 gvm_has_sentry_support (void);
 
@@ -15,6 +15,7 @@
 
 #include "hosts.h"
 
+#include "memstats.h"   /* for gvm_memstats_alloc, gvm_memstats_free */
 #include "networking.h" /* for ipv4_as_ipv6, addr6_as_str, gvm_resolve */
 
 #include <arpa/inet.h> /* for inet_pton, inet_ntop */
@@ -873,6 +874,7 @@ gvm_vhost_new (char *value, char *source)
   gvm_vhost_t *vhost;
 
   vhost = g_malloc0 (sizeof (gvm_vhost_t));
+  gvm_memstats_alloc (GVM_MEM_HOSTS, sizeof (gvm_vhost_t));
   vhost->value = value;
   vhost->source = source;
 
@@ -891,6 +893,7 @@ gvm_vhost_free (gpointer vhost)
     {
       g_free (((gvm_vhost_t *) vhost)->value);
       g_free (((gvm_vhost_t *) vhost)->source);
+      gvm_memstats_free (GVM_MEM_HOSTS, sizeof (gvm_vhost_t));
     }
   g_free (vhost);
 }
@@ -917,6 +920,154 @@ gvm_duplicate_vhost (gconstpointer vhost, gpointer data)
   return ret;
 }
 
+/**
+ * @brief Hashes a vhost value, ignoring the case of ASCII letters.
+ *
+ * @param[in] key Vhost value.
+ *
+ * @return Hash of the value.
+ */
+static guint
+vhost_value_hash (gconstpointer key)
+{
+  const unsigned char *p = key;
+  guint hash = 5381;
+
+  for (; *p; p++)
+    hash = hash * 33 + g_ascii_tolower (*p);
+  return hash;
+}
+
+/**
+ * @brief Compares two vhost values, ignoring the case of ASCII letters.
+ *
+ * @param[in] a First vhost value.
+ * @param[in] b Second vhost value.
+ *
+ * @return TRUE if the values are equal.
+ */
+static gboolean
+vhost_value_equal (gconstpointer a, gconstpointer b)
+{
+  return !g_ascii_strcasecmp (a, b);
+}
+
+/**
+ * @brief Creates a set of vhosts indexed by value, from a vhosts list.
+ *
+ * Of several vhosts with the same value, the first one is indexed.
+ *
+ * @param[in] vhosts List of gvm_vhost_t.
+ *
+ * @return New set, whose keys and values belong to the vhosts of the list.
+ */
+static GHashTable *
+vhosts_set_new (const GSList *vhosts)
+{
+  GHashTable *set;
+
+  set = g_hash_table_new (vhost_value_hash, vhost_value_equal);
+  for (; vhosts; vhosts = vhosts->next)
+    {
+      gvm_vhost_t *vhost = vhosts->data;
+
+      if (!g_hash_table_contains (set, vhost->value))
+        g_hash_table_insert (set, vhost->value, vhost);
+    }
+  return set;
+}
+
+/**
+ * @brief State of the merge of vhosts lists into a vhosts list.
+ *
+ * Keeps the values and the end of the list, so that each merged vhost costs
+ * the same whatever the length of the list.
+ */
+struct vhosts_merge
+{
+  GSList **vhosts;  /**< List merged into. */
+  GHashTable *set;  /**< Vhosts of the list, by value. */
+  GSList *last;     /**< Last link of the list. */
+};
+
+/**
+ * @brief Starts merging vhosts into a vhosts list.
+ *
+ * @param[out] merge   Merge state, to clear with vhosts_merge_clear.
+ * @param[in]  vhosts  List to merge into.
+ * @param[in]  set     Index of the list, which is kept up to date, or NULL.
+ */
+static void
+vhosts_merge_init (struct vhosts_merge *merge, GSList **vhosts,
+                   GHashTable *set)
+{
+  merge->vhosts = vhosts;
+  merge->set = set ? g_hash_table_ref (set) : vhosts_set_new (*vhosts);
+  merge->last = g_slist_last (*vhosts);
+}
+
+/**
+ * @brief Appends vhosts to the list of a merge, freeing those whose value is
+ * already in it.
+ *
+ * @param[in] merge   Merge state.
+ * @param[in] vhosts  List of gvm_vhost_t, whose links are taken over.
+ *
+ * @return Number of vhosts appended.
+ */
+static unsigned int
+vhosts_merge_add (struct vhosts_merge *merge, GSList *vhosts)
+{
+  unsigned int added = 0;
+
+  while (vhosts)
+    {
+      GSList *link = vhosts;
+      gvm_vhost_t *vhost = link->data;
+
+      vhosts = vhosts->next;
+      if (g_hash_table_contains (merge->set, vhost->value))
+        {
+          gvm_vhost_free (vhost);
+          g_slist_free_1 (link);
+          continue;
+        }
+      g_hash_table_insert (merge->set, vhost->value, vhost);
+      link->next = NULL;
+      if (merge->last)
+        merge->last->next = link;
+      else
+        *merge->vhosts = link;
+      merge->last = link;
+      added++;
+    }
+  return added;
+}
+
+/**
+ * @brief Ends the merge of vhosts into a vhosts list.
+ *
+ * @param[in] merge  Merge state.
+ */
+static void
+vhosts_merge_clear (struct vhosts_merge *merge)
+{
+  g_hash_table_unref (merge->set);
+  merge->set = NULL;
+}
+
+/**
+ * @brief Frees a merge state allocated by vhosts_merges_add.
+ *
+ * @param[in] merge  Merge state.
+ */
+static void
+vhosts_merge_free (gpointer merge)
+{
+  vhosts_merge_clear (merge);
+  g_free (merge);
+}
+
 /**
  * @brief Creates a new gvm_host_t object.
  *
@@ -928,6 +1079,7 @@ gvm_host_new ()
   gvm_host_t *host;
 
   host = g_malloc0 (sizeof (gvm_host_t));
+  gvm_memstats_alloc (GVM_MEM_HOSTS, sizeof (gvm_host_t));
 
   return host;
 }
@@ -948,140 +1100,1186 @@ gvm_host_free (gpointer host)
   if (h->type == HOST_TYPE_NAME)
     g_free (h->name);
 
+  if (h->vhosts_set)
+    g_hash_table_destroy (h->vhosts_set);
   g_slist_free_full (h->vhosts, gvm_vhost_free);
   g_free (h);
+  gvm_memstats_free (GVM_MEM_HOSTS, sizeof (gvm_host_t));
 }
 
 /**
- * @brief Inserts a host object at the end of a hosts collection.
+ * @brief A 128 bits address, in host byte order.
+ *
+ * IPv4 addresses only use the lower half.
+ */
+struct span_addr
+{
+  guint64 hi; /**< Upper 64 bits. */
+  guint64 lo; /**< Lower 64 bits. */
+};
+
+/**
+ * @brief A range of consecutive addresses, or a single host, which are
+ * materialized as gvm_host_t objects only when iterated over.
+ *
+ * The hosts of a span come in address order, or reversed. Shuffled spans
+ * are iterated over through a permutation of all their hosts instead.
+ */
+struct gvm_hosts_span
+{
+  enum host_type type;     /**< HOST_TYPE_NAME, _IPV4 or _IPV6. */
+  gvm_host_t *host;        /**< Host object of a single host span, or NULL. */
+  struct span_addr first;  /**< First address of the range. */
+  guint64 size;            /**< Number of addresses in the range. */
+  guint64 pos;             /**< Index of the next host to materialize. */
+  guint64 start;           /**< Index of the first host, when shuffled. */
+  gboolean reversed;       /**< Whether to iterate from the last address. */
+};
+
+/**
+ * @brief An address interval in a set of covered addresses.
+ */
+struct span_interval
+{
+  enum host_type type;    /**< HOST_TYPE_IPV4 or HOST_TYPE_IPV6. */
+  struct span_addr first; /**< First covered address. */
+  struct span_addr last;  /**< Last covered address. */
+};
+
+/**
+ * @brief Compares two span addresses.
+ *
+ * @param[in] a First address.
+ * @param[in] b Second address.
+ *
+ * @return Negative, 0 or positive as a is lower, equal or greater than b.
+ */
+static int
+span_addr_cmp (const struct span_addr *a, const struct span_addr *b)
+{
+  if (a->hi != b->hi)
+    return a->hi < b->hi ? -1 : 1;
+  if (a->lo != b->lo)
+    return a->lo < b->lo ? -1 : 1;
+  return 0;
+}
+
+/**
+ * @brief Adds an offset to a span address.
+ *
+ * @param[in] addr  Address.
+ * @param[in] n     Offset to add.
+ *
+ * @return addr + n.
+ */
+static struct span_addr
+span_addr_add (struct span_addr addr, guint64 n)
+{
+  struct span_addr ret;
+
+  ret.lo = addr.lo + n;
+  ret.hi = addr.hi + (ret.lo < addr.lo);
+  return ret;
+}
+
+/**
+ * @brief Converts an IPv6 address to a span address.
+ *
+ * @param[in]  addr6 IPv6 address.
+ * @param[out] addr  Span address.
+ */
+static void
+span_addr_from_in6 (const struct in6_addr *addr6, struct span_addr *addr)
+{
+  int i;
+
+  addr->hi = addr->lo = 0;
+  for (i = 0; i < 8; i++)
+    {
+      addr->hi = (addr->hi << 8) | addr6->s6_addr[i];
+      addr->lo = (addr->lo << 8) | addr6->s6_addr[i + 8];
+    }
+}
+
+/**
+ * @brief Converts a span address to an IPv6 address.
+ *
+ * @param[in]  addr  Span address.
+ * @param[out] addr6 IPv6 address.
+ */
+static void
+span_addr_to_in6 (const struct span_addr *addr, struct in6_addr *addr6)
+{
+  int i;
+
+  for (i = 0; i < 8; i++)
+    {
+      addr6->s6_addr[i] = (addr->hi >> (56 - 8 * i)) & 0xff;
+      addr6->s6_addr[i + 8] = (addr->lo >> (56 - 8 * i)) & 0xff;
+    }
+}
+
+/**
+ * @brief Gets the span address of an IPv4 or IPv6 host.
+ *
+ * @param[in]  host  Host object.
+ * @param[out] addr  Span address.
+ */
+static void
+host_span_addr (const gvm_host_t *host, struct span_addr *addr)
+{
+  if (host->type == HOST_TYPE_IPV4)
+    {
+      addr->hi = 0;
+      addr->lo = ntohl (host->addr.s_addr);
+    }
+  else
+    span_addr_from_in6 (&host->addr6, addr);
+}
+
+/**
+ * @brief Gets the last address of a span.
+ *
+ * @param[in] span  Address span.
+ *
+ * @return Last address.
+ */
+static struct span_addr
+span_last (const struct gvm_hosts_span *span)
+{
+  return span_addr_add (span->first, span->size - 1);
+}
+
+/**
+ * @brief Gets the address of the k-th host of a span.
+ *
+ * @param[in] span  Address span.
+ * @param[in] k     Index of the host in the iteration order.
+ *
+ * @return Address.
+ */
+static struct span_addr
+span_addr_at (const struct gvm_hosts_span *span, guint64 k)
+{
+  guint64 index = k;
+
+  if (span->reversed)
+    index = span->size - 1 - index;
+  return span_addr_add (span->first, index);
+}
+
+/**
+ * @brief Appends a pending span to a hosts collection.
+ *
+ * @param[in] hosts The hosts collection.
+ * @param[in] type  Address type.
+ * @param[in] host  Host object of a single host span, or NULL.
+ * @param[in] first First address of the range.
+ * @param[in] size  Number of addresses in the range.
+ */
+static void
+gvm_hosts_add_span (gvm_hosts_t *hosts, enum host_type type, gvm_host_t *host,
+                    struct span_addr first, guint64 size)
+{
+  struct gvm_hosts_span span = {0};
+
+  span.type = type;
+  span.host = host;
+  span.first = first;
+  span.size = size;
+  g_array_append_val (hosts->spans, span);
+  hosts->span_hosts += size;
+}
+
+/**
+ * @brief Drops the index of a hosts collection, after a change of its hosts
+ * array.
+ *
+ * @param[in] hosts Hosts collection.
+ */
+static void
+gvm_hosts_index_invalidate (gvm_hosts_t *hosts)
+{
+  if (hosts->index)
+    {
+      g_hash_table_destroy (hosts->index);
+      hosts->index = NULL;
+    }
+}
+
+/**
+ * @brief Inserts a host object at the end of the materialized hosts.
  *
  * @param[in] hosts Hosts in which to insert the host.
  * @param[in] host  Host to insert.
  */
-void
-gvm_hosts_add (gvm_hosts_t *hosts, gvm_host_t *host)
+static void
+gvm_hosts_append (gvm_hosts_t *hosts, gvm_host_t *host)
 {
   if (hosts->count == hosts->max_size)
     {
+      gvm_memstats_free (GVM_MEM_HOSTS,
+                         hosts->max_size * sizeof (*hosts->hosts));
       hosts->max_size *= 4;
       hosts->hosts =
         g_realloc_n (hosts->hosts, hosts->max_size, sizeof (*hosts->hosts));
+      gvm_memstats_alloc (GVM_MEM_HOSTS,
+                          hosts->max_size * sizeof (*hosts->hosts));
       memset (hosts->hosts + hosts->count, '\0',
               (hosts->max_size - hosts->count) * sizeof (gvm_host_t *));
     }
   hosts->hosts[hosts->count] = host;
   hosts->count++;
+  gvm_hosts_index_invalidate (hosts);
 }
 
 /**
- * @brief Creates a hosts collection from a hosts string.
+ * @brief Round function of the shuffling permutation.
  *
- * @param[in] hosts_str String of hosts.
+ * @param[in] half  Half block.
+ * @param[in] key   Round key.
  *
- * @return Hosts collection.
+ * @return Mixed value.
  */
-static gvm_hosts_t *
-gvm_hosts_init (const char *hosts_str)
+static guint32
+perm_round (guint32 half, guint32 key)
 {
-  gvm_hosts_t *hosts;
-
-  hosts = g_malloc0 (sizeof (gvm_hosts_t));
-  hosts->max_size = 1024;
-  hosts->hosts = g_malloc0_n (hosts->max_size, sizeof (gvm_host_t *));
-  hosts->orig_str = g_strdup (hosts_str);
-  return hosts;
+  half ^= key;
+  half *= 0x9e3779b1U;
+  half ^= half >> 15;
+  half *= 0x85ebca77U;
+  half ^= half >> 13;
+  return half;
 }
 
 /**
- * @brief Fill the gaps in the array of a hosts collection, which are caused by
- * the removal of host entries.
+ * @brief Gets the span and index in the span of the next host of a shuffled
+ * hosts collection.
  *
- * @param[in] hosts Hosts collection to fill gaps in.
+ * The permutation is a 4 rounds Feistel network over the smallest domain of
+ * an even number of bits holding all the hosts, cycle walking over the
+ * values out of range. It only needs the round keys and a counter.
+ *
+ * @param[in]     hosts Shuffled hosts collection with pending hosts.
+ * @param[in,out] next  Permutation counter.
+ * @param[out]    index Index of the host in the span.
+ *
+ * @return Span of the host.
  */
-static void
-gvm_hosts_fill_gaps (gvm_hosts_t *hosts)
+static struct gvm_hosts_span *
+gvm_hosts_perm_span (const gvm_hosts_t *hosts, guint64 *next, guint64 *index)
 {
-  size_t i;
-  if (!hosts)
-    return;
+  guint64 mask = (G_GUINT64_CONSTANT (1) << hosts->perm_bits) - 1, value;
+  size_t low, high;
 
-  for (i = 0; i < hosts->max_size; i++)
+  do
     {
-      if (!hosts->hosts[i])
+      guint64 left = *next >> hosts->perm_bits, right = *next & mask;
+      int round;
+
+      (*next)++;
+      for (round = 0; round < 4; round++)
         {
-          size_t j;
+          guint64 tmp = right;
 
-          /* Fill the gap with the closest host entry, in order to keep the
-           * sequential ordering. */
-          for (j = i + 1; j < hosts->max_size; j++)
-            {
-              if (hosts->hosts[j])
-                {
-                  hosts->hosts[i] = hosts->hosts[j];
-                  hosts->hosts[j] = NULL;
-                  break;
-                }
-            }
-          /* No more entries left, ie. the empty space between count and
-           * max_size. */
-          if (!hosts->hosts[i])
-            return;
+          right = left ^ (perm_round (right, hosts->perm_keys[round]) & mask);
+          left = tmp;
         }
+      value = (left << hosts->perm_bits) | right;
+    }
+  while (value >= hosts->perm_total);
+
+  /* Binary search of the span holding the host. */
+  low = hosts->span;
+  high = hosts->spans->len - 1;
+  while (low < high)
+    {
+      size_t mid = low + (high - low + 1) / 2;
+
+      if (g_array_index (hosts->spans, struct gvm_hosts_span, mid).start
+          <= value)
+        low = mid;
+      else
+        high = mid - 1;
     }
+  *index =
+    value - g_array_index (hosts->spans, struct gvm_hosts_span, low).start;
+  return &g_array_index (hosts->spans, struct gvm_hosts_span, low);
 }
 
 /**
- * @brief Removes duplicate hosts values from an gvm_hosts_t structure.
- * Also resets the iterator current position.
+ * @brief Materializes the next host of the pending spans.
  *
- * @param[in] hosts hosts collection from which to remove duplicates.
+ * @param[in] hosts Hosts collection.
+ *
+ * @return 0 if a host was appended, -1 if there are no pending spans.
  */
-static void
-gvm_hosts_deduplicate (gvm_hosts_t *hosts)
+static int
+gvm_hosts_materialize_next (gvm_hosts_t *hosts)
 {
-  /**
-   * Uses a hash table in order to deduplicate the hosts list in O(N) time.
-   */
-  GHashTable *name_table;
-  size_t i, duplicates = 0;
+  struct gvm_hosts_span *span;
+  gvm_host_t *host;
+  guint64 index;
 
-  if (hosts == NULL)
-    return;
-  name_table = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  if (hosts->span >= hosts->spans->len)
+    return -1;
 
-  for (i = 0; i < hosts->count; i++)
+  if (hosts->perm_bits)
+    span = gvm_hosts_perm_span (hosts, &hosts->perm_next, &index);
+  else
     {
-      gchar *name;
+      span = &g_array_index (hosts->spans, struct gvm_hosts_span,
+                             hosts->span);
+      index = span->pos;
+    }
+  if (span->host)
+    {
+      host = span->host;
+      span->host = NULL;
+    }
+  else
+    {
+      struct span_addr addr = span_addr_at (span, index);
 
-      if ((name = gvm_host_value_str (hosts->hosts[i])))
-        {
-          gvm_host_t *host, *removed = hosts->hosts[i];
+      host = gvm_host_new ();
+      host->type = span->type;
+      if (span->type == HOST_TYPE_IPV4)
+        host->addr.s_addr = htonl ((uint32_t) addr.lo);
+      else
+        span_addr_to_in6 (&addr, &host->addr6);
+    }
+  gvm_hosts_append (hosts, host);
+  hosts->span_hosts--;
+  if (hosts->perm_bits)
+    {
+      if (hosts->span_hosts == 0)
+        hosts->span = hosts->spans->len;
+    }
+  else if (++span->pos == span->size)
+    hosts->span++;
+  return 0;
+}
 
-          host = g_hash_table_lookup (name_table, name);
-          if (host)
-            {
-              /* Remove duplicate host. Add its vhosts to the original host. */
-              host->vhosts = g_slist_concat (host->vhosts, removed->vhosts);
-              removed->vhosts = NULL;
-              gvm_host_free (removed);
-              hosts->hosts[i] = NULL;
-              duplicates++;
-              g_free (name);
-            }
-          else
-            g_hash_table_insert (name_table, name, hosts->hosts[i]);
+/**
+ * @brief Materializes all the pending spans of a hosts collection, for the
+ * operations which need the whole hosts array.
+ *
+ * @param[in] hosts Hosts collection.
+ */
+static void
+gvm_hosts_expand (gvm_hosts_t *hosts)
+{
+  while (gvm_hosts_materialize_next (hosts) == 0)
+    ;
+  g_array_set_size (hosts->spans, 0);
+  hosts->span = 0;
+  hosts->perm_bits = 0;
+}
+
+/**
+ * @brief Checks whether a hosts collection is only made of pending spans
+ * in their original order, so that filters can work on the spans directly.
+ *
+ * @param[in] hosts Hosts collection.
+ *
+ * @return 1 if so, 0 otherwise.
+ */
+static int
+gvm_hosts_spans_only (const gvm_hosts_t *hosts)
+{
+  size_t i;
+
+  if (hosts->count || hosts->perm_bits)
+    return 0;
+  for (i = hosts->span; i < hosts->spans->len; i++)
+    {
+      struct gvm_hosts_span *span;
+
+      span = &g_array_index (hosts->spans, struct gvm_hosts_span, i);
+      if (span->reversed
+          || (span->host && span->type != HOST_TYPE_NAME))
+        return 0;
+    }
+  return 1;
+}
+
+/**
+ * @brief Compares two intervals of a set of covered addresses.
+ */
+static gint
+span_interval_cmp (gconstpointer a, gconstpointer b, gpointer data)
+{
+  const struct span_interval *ia = a, *ib = b;
+
+  (void) data;
+  if (ia->type != ib->type)
+    return ia->type < ib->type ? -1 : 1;
+  return span_addr_cmp (&ia->first, &ib->first);
+}
+
+/**
+ * @brief Appends the addresses of a span not covered by a set of intervals
+ * to a spans array, as new spans.
+ *
+ * @param[in]  set  Sorted set of non-overlapping intervals.
+ * @param[in]  span Span to filter.
+ * @param[out] out  Array to which to append the uncovered parts.
+ *
+ * @return Number of uncovered addresses.
+ */
+static guint64
+span_subtract (GSequence *set, const struct gvm_hosts_span *span, GArray *out)
+{
+  struct span_interval probe, *interval;
+  struct span_addr cur, last;
+  struct gvm_hosts_span part = {0};
+  GSequenceIter *iter;
+  guint64 kept = 0;
+
+  cur = span->first;
+  last = span_last (span);
+  part.type = span->type;
+
+  probe.type = span->type;
+  probe.first = cur;
+  iter = g_sequence_search (set, &probe, span_interval_cmp, NULL);
+  if (!g_sequence_iter_is_begin (iter))
+    {
+      interval = g_sequence_get (g_sequence_iter_prev (iter));
+      if (interval->type == span->type
+          && span_addr_cmp (&interval->last, &cur) >= 0)
+        {
+          if (span_addr_cmp (&interval->last, &last) >= 0)
+            return 0;
+          cur = span_addr_add (interval->last, 1);
+        }
+    }
+
+  for (; !g_sequence_iter_is_end (iter); iter = g_sequence_iter_next (iter))
+    {
+      interval = g_sequence_get (iter);
+      if (interval->type != span->type
+          || span_addr_cmp (&interval->first, &last) > 0)
+        break;
+      if (span_addr_cmp (&interval->first, &cur) > 0)
+        {
+          part.first = cur;
+          part.size = interval->first.lo - cur.lo;
+          g_array_append_val (out, part);
+          kept += part.size;
+        }
+      if (span_addr_cmp (&interval->last, &last) >= 0)
+        return kept;
+      cur = span_addr_add (interval->last, 1);
+    }
+
+  part.first = cur;
+  part.size = last.lo - cur.lo + 1;
+  g_array_append_val (out, part);
+  return kept + part.size;
+}
+
+/**
+ * @brief Adds the addresses of a span to a set of intervals, merging the
+ * overlapping ones.
+ *
+ * @param[in] set  Sorted set of non-overlapping intervals.
+ * @param[in] span Span to add.
+ */
+static void
+span_set_add (GSequence *set, const struct gvm_hosts_span *span)
+{
+  struct span_interval *new, *interval;
+  GSequenceIter *iter;
+
+  new = g_malloc (sizeof (*new));
+  new->type = span->type;
+  new->first = span->first;
+  new->last = span_last (span);
+
+  iter = g_sequence_search (set, new, span_interval_cmp, NULL);
+  if (!g_sequence_iter_is_begin (iter))
+    {
+      GSequenceIter *prev = g_sequence_iter_prev (iter);
+
+      interval = g_sequence_get (prev);
+      if (interval->type == new->type
+          && span_addr_cmp (&interval->last, &new->first) >= 0)
+        {
+          new->first = interval->first;
+          if (span_addr_cmp (&interval->last, &new->last) > 0)
+            new->last = interval->last;
+          g_sequence_remove (prev);
+        }
+    }
+  while (!g_sequence_iter_is_end (iter))
+    {
+      GSequenceIter *next = g_sequence_iter_next (iter);
+
+      interval = g_sequence_get (iter);
+      if (interval->type != new->type
+          || span_addr_cmp (&interval->first, &new->last) > 0)
+        break;
+      if (span_addr_cmp (&interval->last, &new->last) > 0)
+        new->last = interval->last;
+      g_sequence_remove (iter);
+      iter = next;
+    }
+  g_sequence_insert_sorted (set, new, span_interval_cmp, NULL);
+}
+
+/**
+ * @brief Replaces the pending spans of a hosts collection.
+ *
+ * @param[in] hosts Hosts collection.
+ * @param[in] spans New spans array.
+ */
+static void
+gvm_hosts_set_spans (gvm_hosts_t *hosts, GArray *spans)
+{
+  size_t i;
+
+  g_array_free (hosts->spans, TRUE);
+  hosts->spans = spans;
+  hosts->span = 0;
+  hosts->span_hosts = 0;
+  for (i = 0; i < spans->len; i++)
+    hosts->span_hosts +=
+      g_array_index (spans, struct gvm_hosts_span, i).size;
+}
+
+/**
+ * @brief Inserts a host object at the end of a hosts collection.
+ *
+ * @param[in] hosts Hosts in which to insert the host.
+ * @param[in] host  Host to insert.
+ */
+void
+gvm_hosts_add (gvm_hosts_t *hosts, gvm_host_t *host)
+{
+  /* The pending spans come before the new host. */
+  gvm_hosts_expand (hosts);
+  gvm_hosts_append (hosts, host);
+}
+
+/**
+ * @brief Creates a hosts collection from a hosts string.
+ *
+ * @param[in] hosts_str String of hosts.
+ *
+ * @return Hosts collection.
+ */
+static gvm_hosts_t *
+gvm_hosts_init (const char *hosts_str)
+{
+  gvm_hosts_t *hosts;
+
+  hosts = g_malloc0 (sizeof (gvm_hosts_t));
+  hosts->max_size = 1024;
+  hosts->hosts = g_malloc0_n (hosts->max_size, sizeof (gvm_host_t *));
+  gvm_memstats_alloc (GVM_MEM_HOSTS, sizeof (gvm_hosts_t)
+                                       + hosts->max_size * sizeof (gvm_host_t *));
+  hosts->orig_str = g_strdup (hosts_str);
+  hosts->spans = g_array_new (FALSE, FALSE, sizeof (struct gvm_hosts_span));
+  return hosts;
+}
+
+/**
+ * @brief Fill the gaps in the array of a hosts collection, which are caused by
+ * the removal of host entries.
+ *
+ * @param[in] hosts Hosts collection to fill gaps in.
+ */
+static void
+gvm_hosts_fill_gaps (gvm_hosts_t *hosts)
+{
+  size_t i, j;
+  if (!hosts)
+    return;
+
+  gvm_hosts_index_invalidate (hosts);
+  /* Move the host entries down over the gaps in a single pass, in order to
+   * keep the sequential ordering. */
+  for (i = 0, j = 0; i < hosts->max_size; i++)
+    {
+      if (!hosts->hosts[i])
+        continue;
+      if (i != j)
+        {
+          hosts->hosts[j] = hosts->hosts[i];
+          hosts->hosts[i] = NULL;
+        }
+      j++;
+    }
+}
+
+/**
+ * @brief Moves the vhosts of a duplicate host to the host it duplicates,
+ * except those the host already has.
+ *
+ * @param[in,out] merges   Merge states by host, created when NULL.  To free
+ *                         once the hosts are deduplicated.
+ * @param[in]     host     Host which is kept.
+ * @param[in]     removed  Duplicate host.
+ */
+static void
+vhosts_merges_add (GHashTable **merges, gvm_host_t *host, gvm_host_t *removed)
+{
+  struct vhosts_merge *merge;
+
+  if (removed->vhosts == NULL)
+    return;
+  if (*merges == NULL)
+    *merges = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+                                     vhosts_merge_free);
+  merge = g_hash_table_lookup (*merges, host);
+  if (merge == NULL)
+    {
+      merge = g_malloc (sizeof (*merge));
+      vhosts_merge_init (merge, &host->vhosts, host->vhosts_set);
+      g_hash_table_insert (*merges, host, merge);
+    }
+  vhosts_merge_add (merge, removed->vhosts);
+  removed->vhosts = NULL;
+}
+
+/**
+ * @brief Removes duplicate hosts values from the pending spans of a hosts
+ * collection, without materializing them.
+ *
+ * @param[in] hosts hosts collection from which to remove duplicates.
+ */
+static void
+gvm_hosts_deduplicate_spans (gvm_hosts_t *hosts)
+{
+  GHashTable *name_table, *merges = NULL;
+  GSequence *seen;
+  GArray *spans;
+  size_t i, duplicates = 0;
+
+  name_table = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  seen = g_sequence_new (g_free);
+  spans = g_array_new (FALSE, FALSE, sizeof (struct gvm_hosts_span));
+  for (i = hosts->span; i < hosts->spans->len; i++)
+    {
+      struct gvm_hosts_span *span;
+
+      span = &g_array_index (hosts->spans, struct gvm_hosts_span, i);
+      if (span->type == HOST_TYPE_NAME)
+        {
+          gvm_host_t *host;
+
+          host = g_hash_table_lookup (name_table, span->host->name);
+          if (host)
+            {
+              /* Remove duplicate host. Add its vhosts to the original host. */
+              vhosts_merges_add (&merges, host, span->host);
+              gvm_host_free (span->host);
+              duplicates++;
+              continue;
+            }
+          g_hash_table_insert (name_table, g_strdup (span->host->name),
+                               span->host);
+          g_array_append_val (spans, *span);
+          continue;
+        }
+      duplicates += span->size - span_subtract (seen, span, spans);
+      span_set_add (seen, span);
+    }
+
+  g_hash_table_destroy (name_table);
+  if (merges)
+    g_hash_table_destroy (merges);
+  g_sequence_free (seen);
+  gvm_hosts_set_spans (hosts, spans);
+  hosts->duplicated += duplicates;
+  hosts->current = 0;
+}
+
+/**
+ * @brief Hashes a host object by value.
+ *
+ * @param[in] key Host object.
+ *
+ * @return Hash of the host type and address or name.
+ */
+static guint
+gvm_host_key_hash (gconstpointer key)
+{
+  const gvm_host_t *host = key;
+  const guint32 *words;
+
+  switch (host->type)
+    {
+    case HOST_TYPE_NAME:
+      return g_str_hash (host->name);
+    case HOST_TYPE_IPV4:
+      return host->addr.s_addr * 2654435761U;
+    case HOST_TYPE_IPV6:
+      words = (const guint32 *) host->addr6.s6_addr;
+      return ((words[0] * 31 + words[1]) * 31 + words[2]) * 31 + words[3];
+    default:
+      return 0;
+    }
+}
+
+/**
+ * @brief Compares two host objects by value.
+ *
+ * @param[in] a First host object.
+ * @param[in] b Second host object.
+ *
+ * @return TRUE if they have the same type and address or name.
+ */
+static gboolean
+gvm_host_key_equal (gconstpointer a, gconstpointer b)
+{
+  const gvm_host_t *host_a = a, *host_b = b;
+
+  if (host_a->type != host_b->type)
+    return FALSE;
+  switch (host_a->type)
+    {
+    case HOST_TYPE_NAME:
+      return g_str_equal (host_a->name, host_b->name);
+    case HOST_TYPE_IPV4:
+      return host_a->addr.s_addr == host_b->addr.s_addr;
+    case HOST_TYPE_IPV6:
+      return !memcmp (&host_a->addr6, &host_b->addr6, sizeof (host_a->addr6));
+    default:
+      return FALSE;
+    }
+}
+
+/**
+ * @brief Removes duplicate hosts values from an gvm_hosts_t structure.
+ * Also resets the iterator current position.
+ *
+ * @param[in] hosts hosts collection from which to remove duplicates.
+ */
+static void
+gvm_hosts_deduplicate (gvm_hosts_t *hosts)
+{
+  /**
+   * Uses a hash table in order to deduplicate the hosts list in O(N) time.
+   */
+  GHashTable *host_table, *merges = NULL;
+  size_t i, duplicates = 0;
+
+  if (hosts == NULL)
+    return;
+  if (gvm_hosts_spans_only (hosts))
+    {
+      gvm_hosts_deduplicate_spans (hosts);
+      return;
+    }
+  gvm_hosts_expand (hosts);
+  /* The hosts are their own keys: addresses are hashed as binary and only
+   * hostnames as strings, without allocations. */
+  host_table = g_hash_table_new (gvm_host_key_hash, gvm_host_key_equal);
+
+  for (i = 0; i < hosts->count; i++)
+    {
+      gvm_host_t *host, *removed = hosts->hosts[i];
+
+      host = g_hash_table_lookup (host_table, removed);
+      if (host)
+        {
+          /* Remove duplicate host. Add its vhosts to the original host. */
+          vhosts_merges_add (&merges, host, removed);
+          gvm_host_free (removed);
+          hosts->hosts[i] = NULL;
+          duplicates++;
+        }
+      else
+        g_hash_table_add (host_table, removed);
+    }
+
+  if (duplicates)
+    gvm_hosts_fill_gaps (hosts);
+  g_hash_table_destroy (host_table);
+  if (merges)
+    g_hash_table_destroy (merges);
+  hosts->count -= duplicates;
+  hosts->duplicated += duplicates;
+  hosts->current = 0;
+#ifdef __GLIBC__
+  malloc_trim (0);
+#endif
+}
+
+/**
+ * @brief Parses a dotted-quad IPv4 address, as inet_pton does.
+ *
+ * @param[in]  str   Address, not NUL terminated.
+ * @param[in]  len   Length of the address.
+ * @param[out] addr  Address in host byte order.
+ *
+ * @return 0 if success, -1 if str is not a dotted-quad IPv4 address.
+ */
+static int
+ipv4_parse_fast (const char *str, size_t len, guint32 *addr)
+{
+  guint32 value = 0, octet = 0;
+  int octets = 0, digits = 0;
+  size_t i;
+
+  for (i = 0; i < len; i++)
+    {
+      char c = str[i];
+
+      if (c >= '0' && c <= '9')
+        {
+          /* Like inet_pton, reject leading zeros. */
+          if (digits && octet == 0)
+            return -1;
+          octet = octet * 10 + (c - '0');
+          if (++digits > 3 || octet > 255)
+            return -1;
+        }
+      else if (c == '.' && digits && octets < 3)
+        {
+          value = value << 8 | octet;
+          octets++;
+          digits = 0;
+          octet = 0;
+        }
+      else
+        return -1;
+    }
+  if (!digits || octets != 3)
+    return -1;
+  *addr = value << 8 | octet;
+  return 0;
+}
+
+/**
+ * @brief Adds the hosts of a single host specification to a hosts
+ * collection.
+ *
+ * @param[in] hosts  The hosts collection.
+ * @param[in] token  Host specification, stripped, not NUL terminated.
+ * @param[in] len    Length of the host specification, not 0.
+ *
+ * @return 0 if success, -1 if the specification is invalid or too large.
+ */
+static int
+gvm_hosts_parse_token (gvm_hosts_t *hosts, const char *token, size_t len)
+{
+  char buffer[256];
+  gchar *stripped;
+  guint32 ipv4;
+  int host_type, ret = 0;
+
+  /* Most tokens of long lists are single IPv4 addresses. */
+  if (ipv4_parse_fast (token, len, &ipv4) == 0)
+    {
+      struct span_addr first = {0, ipv4};
+
+      gvm_hosts_add_span (hosts, HOST_TYPE_IPV4, NULL, first, 1);
+      return 0;
+    }
+
+  if (len < sizeof (buffer))
+    {
+      memcpy (buffer, token, len);
+      buffer[len] = '\0';
+      stripped = buffer;
+    }
+  else
+    stripped = g_strndup (token, len);
+
+  /* IPv4, hostname, IPv6, collection (short/long range, cidr block) etc,. ?
+   */
+  /* -1 if error. */
+  host_type = gvm_get_host_type (stripped);
+
+  switch (host_type)
+    {
+    case HOST_TYPE_NAME:
+      {
+        /* New host. */
+        gvm_host_t *host = gvm_host_new ();
+        struct span_addr none = {0, 0};
+
+        host->type = host_type;
+        host->name = g_ascii_strdown (stripped, -1);
+        gvm_hosts_add_span (hosts, HOST_TYPE_NAME, host, none, 1);
+        break;
+      }
+    case HOST_TYPE_IPV4:
+      {
+        struct in_addr addr;
+        struct span_addr first = {0, 0};
+
+        if (inet_pton (AF_INET, stripped, &addr) != 1)
+          break;
+        first.lo = ntohl (addr.s_addr);
+        gvm_hosts_add_span (hosts, HOST_TYPE_IPV4, NULL, first, 1);
+        break;
+      }
+    case HOST_TYPE_IPV6:
+      {
+        struct in6_addr addr6;
+        struct span_addr first;
+
+        if (inet_pton (AF_INET6, stripped, &addr6) != 1)
+          break;
+        span_addr_from_in6 (&addr6, &first);
+        gvm_hosts_add_span (hosts, HOST_TYPE_IPV6, NULL, first, 1);
+        break;
+      }
+    case HOST_TYPE_CIDR_BLOCK:
+    case HOST_TYPE_RANGE_SHORT:
+    case HOST_TYPE_RANGE_LONG:
+      {
+        struct in_addr first, last;
+        struct span_addr start = {0, 0};
+        int (*ips_func) (const char *, struct in_addr *, struct in_addr *);
+
+        if (host_type == HOST_TYPE_CIDR_BLOCK)
+          ips_func = cidr_block_ips;
+        else if (host_type == HOST_TYPE_RANGE_SHORT)
+          ips_func = short_range_network_ips;
+        else
+          ips_func = long_range_network_ips;
+
+        if (ips_func (stripped, &first, &last) == -1)
+          break;
+
+        /* Make sure that first actually comes before last */
+        if (ntohl (first.s_addr) > ntohl (last.s_addr))
+          break;
+
+        /* Hosts are created from the range when iterated over. */
+        start.lo = ntohl (first.s_addr);
+        gvm_hosts_add_span (
+          hosts, HOST_TYPE_IPV4, NULL, start,
+          (guint64) ntohl (last.s_addr) - ntohl (first.s_addr) + 1);
+        break;
+      }
+    case HOST_TYPE_CIDR6_BLOCK:
+    case HOST_TYPE_RANGE6_LONG:
+    case HOST_TYPE_RANGE6_SHORT:
+      {
+        struct in6_addr first, last;
+        struct span_addr start, end;
+        int (*ips_func) (const char *, struct in6_addr *, struct in6_addr *);
+
+        if (host_type == HOST_TYPE_CIDR6_BLOCK)
+          ips_func = cidr6_block_ips;
+        else if (host_type == HOST_TYPE_RANGE6_SHORT)
+          ips_func = short_range6_network_ips;
+        else
+          ips_func = long_range6_network_ips;
+
+        if (ips_func (stripped, &first, &last) == -1)
+          break;
+
+        /* Make sure the first comes before the last. */
+        if (memcmp (&first.s6_addr, &last.s6_addr, 16) > 0)
+          break;
+
+        /* Hosts are created from the range when iterated over. Reject
+         * ranges which would overflow the hosts count. */
+        span_addr_from_in6 (&first, &start);
+        span_addr_from_in6 (&last, &end);
+        if (end.hi - start.hi - (end.lo < start.lo) != 0
+            || end.lo - start.lo >= G_MAXSIZE - hosts->span_hosts)
+          {
+            ret = -1;
+            break;
+          }
+        gvm_hosts_add_span (hosts, HOST_TYPE_IPV6, NULL, start,
+                            end.lo - start.lo + 1);
+        break;
+      }
+    case -1:
+    default:
+      /* Invalid host string. */
+      ret = -1;
+      break;
+    }
+
+  if (stripped != buffer)
+    g_free (stripped);
+  return ret;
+}
+
+/**
+ * @brief Adds the hosts of a part of a hosts string to a hosts collection.
+ *
+ * Host specifications are separated by commas, and stripped of white
+ * space, in a single pass over the string, without allocations.
+ *
+ * @param[in] hosts      The hosts collection.
+ * @param[in] start      Start of the part.
+ * @param[in] end        End of the part.
+ * @param[in] max_hosts  Max number of hosts, 0 for no limit.
+ *
+ * @return 0 if success, -1 if a specification is invalid or there are too
+ *         many hosts.
+ */
+static int
+gvm_hosts_parse (gvm_hosts_t *hosts, const char *start, const char *end,
+                 unsigned int max_hosts)
+{
+  while (start < end)
+    {
+      const char *token = start, *token_end;
+
+      while (start < end && *start != ',')
+        start++;
+      token_end = start;
+      start++;
+
+      while (token < token_end && g_ascii_isspace (*token))
+        token++;
+      while (token_end > token && g_ascii_isspace (token_end[-1]))
+        token_end--;
+      if (token == token_end)
+        continue;
+
+      if (gvm_hosts_parse_token (hosts, token, token_end - token))
+        return -1;
+      if (max_hosts > 0 && gvm_hosts_count (hosts) > max_hosts)
+        return -1;
+    }
+  return 0;
+}
+
+/**
+ * @brief Number of threads parsing a large hosts string.
+ */
+static unsigned int parse_threads = 1;
+
+/**
+ * @brief Size of the hosts strings from which they are parsed in parallel.
+ */
+#define HOSTS_PARSE_CHUNK_MIN (256 * 1024)
+
+/**
+ * @brief A part of a hosts string parsed by a thread.
+ */
+struct hosts_parse_chunk
+{
+  gvm_hosts_t *hosts;     /**< Hosts of the part. */
+  const char *start;      /**< Start of the part. */
+  const char *end;        /**< End of the part. */
+  unsigned int max_hosts; /**< Max number of hosts, 0 for no limit. */
+  int ret;                /**< Result of gvm_hosts_parse. */
+};
+
+/**
+ * @brief Parses a part of a hosts string, in a thread.
+ *
+ * @param[in] data  The part, a struct hosts_parse_chunk.
+ *
+ * @return NULL.
+ */
+static gpointer
+hosts_parse_chunk_run (gpointer data)
+{
+  struct hosts_parse_chunk *chunk = data;
+
+  chunk->ret =
+    gvm_hosts_parse (chunk->hosts, chunk->start, chunk->end, chunk->max_hosts);
+  return NULL;
+}
+
+/**
+ * @brief Sets the number of threads parsing large hosts strings in
+ * @ref gvm_hosts_new_with_max.
+ *
+ * The string is split at separators into a part per thread, and the hosts
+ * of the parts are joined in order, so the result is the same as with a
+ * single thread.  Strings shorter than 256 KiB are always parsed by the
+ * calling thread.
+ *
+ * @param[in] threads Number of threads. 0 or 1 parses in the calling
+ *                    thread, which is the default.
+ */
+void
+gvm_hosts_set_parse_threads (unsigned int threads)
+{
+  parse_threads = threads;
+}
+
+/**
+ * @brief Adds the hosts of a hosts string to a hosts collection, with a
+ * thread per part of the string.
+ *
+ * @param[in] hosts      The hosts collection.
+ * @param[in] str        The hosts string.
+ * @param[in] len        Length of the hosts string.
+ * @param[in] threads    Number of threads.
+ * @param[in] max_hosts  Max number of hosts, 0 for no limit.
+ *
+ * @return 0 if success, -1 if a specification is invalid or there are too
+ *         many hosts.
+ */
+static int
+gvm_hosts_parse_parallel (gvm_hosts_t *hosts, const char *str, size_t len,
+                          unsigned int threads, unsigned int max_hosts)
+{
+  struct hosts_parse_chunk *chunks;
+  GThread **workers;
+  const char *start = str, *end = str + len;
+  unsigned int i, count = 0;
+  int ret = 0;
+
+  chunks = g_malloc0_n (threads, sizeof (*chunks));
+  workers = g_malloc0_n (threads, sizeof (*workers));
+  for (i = 0; i < threads && start < end; i++)
+    {
+      const char *stop = end;
+
+      /* Cut after the first separator following an equal share. */
+      if (i < threads - 1 && (size_t) (end - start) > len / threads)
+        {
+          stop = start + len / threads;
+          while (stop < end && *stop != ',')
+            stop++;
         }
+      chunks[i].hosts = gvm_hosts_init (NULL);
+      chunks[i].start = start;
+      chunks[i].end = stop;
+      chunks[i].max_hosts = max_hosts;
+      workers[i] =
+        g_thread_try_new ("gvm-hosts-parse", hosts_parse_chunk_run,
+                          &chunks[i], NULL);
+      if (workers[i] == NULL)
+        hosts_parse_chunk_run (&chunks[i]);
+      start = stop;
+      count++;
     }
 
-  if (duplicates)
-    gvm_hosts_fill_gaps (hosts);
-  g_hash_table_destroy (name_table);
-  hosts->count -= duplicates;
-  hosts->duplicated += duplicates;
-  hosts->current = 0;
-#ifdef __GLIBC__
-  malloc_trim (0);
-#endif
+  for (i = 0; i < count; i++)
+    {
+      struct hosts_parse_chunk *chunk = &chunks[i];
+      GArray *spans = chunk->hosts->spans;
+
+      if (workers[i])
+        g_thread_join (workers[i]);
+      if (chunk->ret || ret)
+        ret = -1;
+      else if (chunk->hosts->span_hosts >= G_MAXSIZE - hosts->span_hosts)
+        /* The part has IPv6 ranges which overflow the hosts count. */
+        ret = -1;
+      else
+        {
+          /* The hosts of the spans now belong to hosts. */
+          g_array_append_vals (hosts->spans, spans->data, spans->len);
+          hosts->span_hosts += chunk->hosts->span_hosts;
+          g_array_set_size (spans, 0);
+          if (max_hosts > 0 && gvm_hosts_count (hosts) > max_hosts)
+            ret = -1;
+        }
+      gvm_hosts_free (chunk->hosts);
+    }
+  g_free (workers);
+  g_free (chunks);
+  return ret;
 }
 
 /**
@@ -1099,8 +2297,9 @@ gvm_hosts_t *
 gvm_hosts_new_with_max (const gchar *hosts_str, unsigned int max_hosts)
 {
   gvm_hosts_t *hosts;
-  gchar **host_element, **split;
   gchar *str;
+  size_t len;
+  int ret;
 
   if (hosts_str == NULL)
     return NULL;
@@ -1108,174 +2307,27 @@ gvm_hosts_new_with_max (const gchar *hosts_str, unsigned int max_hosts)
   /* Normalize separator: Transform newlines into commas. */
   hosts = gvm_hosts_init (hosts_str);
   str = hosts->orig_str;
-  while (*str)
-    {
-      if (*str == '\n')
-        *str = ',';
-      str++;
-    }
-
-  /* Split comma-separated list into single host-specifications */
-  split = g_strsplit (hosts->orig_str, ",", 0);
+  while ((str = strchr (str, '\n')))
+    *str++ = ',';
 
-  /* first element of the split list */
-  host_element = split;
-  while (*host_element)
+  len = strlen (hosts->orig_str);
+  if (parse_threads > 1 && len >= HOSTS_PARSE_CHUNK_MIN)
+    ret = gvm_hosts_parse_parallel (hosts, hosts->orig_str, len,
+                                    parse_threads, max_hosts);
+  else
+    ret = gvm_hosts_parse (hosts, hosts->orig_str, hosts->orig_str + len,
+                           max_hosts);
+  if (ret)
     {
-      int host_type;
-      gchar *stripped = g_strstrip (*host_element);
-
-      if (stripped == NULL || *stripped == '\0')
-        {
-          host_element++;
-          continue;
-        }
-
-      /* IPv4, hostname, IPv6, collection (short/long range, cidr block) etc,. ?
-       */
-      /* -1 if error. */
-      host_type = gvm_get_host_type (stripped);
-
-      switch (host_type)
-        {
-        case HOST_TYPE_NAME:
-        case HOST_TYPE_IPV4:
-        case HOST_TYPE_IPV6:
-          {
-            /* New host. */
-            gvm_host_t *host = gvm_host_new ();
-            host->type = host_type;
-            if (host_type == HOST_TYPE_NAME)
-              host->name = g_ascii_strdown (stripped, -1);
-            else if (host_type == HOST_TYPE_IPV4)
-              {
-                if (inet_pton (AF_INET, stripped, &host->addr) != 1)
-                  break;
-              }
-            else if (host_type == HOST_TYPE_IPV6)
-              {
-                if (inet_pton (AF_INET6, stripped, &host->addr6) != 1)
-                  break;
-              }
-            gvm_hosts_add (hosts, host);
-            break;
-          }
-        case HOST_TYPE_CIDR_BLOCK:
-        case HOST_TYPE_RANGE_SHORT:
-        case HOST_TYPE_RANGE_LONG:
-          {
-            struct in_addr first, last;
-            uint32_t current;
-            int (*ips_func) (const char *, struct in_addr *, struct in_addr *);
-
-            if (host_type == HOST_TYPE_CIDR_BLOCK)
-              ips_func = cidr_block_ips;
-            else if (host_type == HOST_TYPE_RANGE_SHORT)
-              ips_func = short_range_network_ips;
-            else
-              ips_func = long_range_network_ips;
-
-            if (ips_func (stripped, &first, &last) == -1)
-              break;
-
-            /* Make sure that first actually comes before last */
-            if (ntohl (first.s_addr) > ntohl (last.s_addr))
-              break;
-
-            /* Add addresses from first to last as single hosts. */
-            current = first.s_addr;
-            while (ntohl (current) <= ntohl (last.s_addr))
-              {
-                gvm_host_t *host;
-                if (max_hosts > 0 && hosts->count > max_hosts)
-                  {
-                    g_strfreev (split);
-                    gvm_hosts_free (hosts);
-                    return NULL;
-                  }
-                host = gvm_host_new ();
-                host->type = HOST_TYPE_IPV4;
-                host->addr.s_addr = current;
-                gvm_hosts_add (hosts, host);
-                /* Next IP address. */
-                current = htonl (ntohl (current) + 1);
-              }
-            break;
-          }
-        case HOST_TYPE_CIDR6_BLOCK:
-        case HOST_TYPE_RANGE6_LONG:
-        case HOST_TYPE_RANGE6_SHORT:
-          {
-            struct in6_addr first, last;
-            unsigned char current[16];
-            int (*ips_func) (const char *, struct in6_addr *,
-                             struct in6_addr *);
-
-            if (host_type == HOST_TYPE_CIDR6_BLOCK)
-              ips_func = cidr6_block_ips;
-            else if (host_type == HOST_TYPE_RANGE6_SHORT)
-              ips_func = short_range6_network_ips;
-            else
-              ips_func = long_range6_network_ips;
-
-            if (ips_func (stripped, &first, &last) == -1)
-              break;
-
-            /* Make sure the first comes before the last. */
-            if (memcmp (&first.s6_addr, &last.s6_addr, 16) > 0)
-              break;
-
-            /* Add addresses from first to last as single hosts. */
-            memcpy (current, &first.s6_addr, 16);
-            while (memcmp (current, &last.s6_addr, 16) <= 0)
-              {
-                int i;
-                gvm_host_t *host;
-
-                if (max_hosts > 0 && hosts->count > max_hosts)
-                  {
-                    g_strfreev (split);
-                    gvm_hosts_free (hosts);
-                    return NULL;
-                  }
-                host = gvm_host_new ();
-                host->type = HOST_TYPE_IPV6;
-                memcpy (host->addr6.s6_addr, current, 16);
-                gvm_hosts_add (hosts, host);
-                /* Next IPv6 address. */
-                for (i = 15; i >= 0; --i)
-                  if (current[i] < 255)
-                    {
-                      current[i]++;
-                      break;
-                    }
-                  else
-                    current[i] = 0;
-              }
-            break;
-          }
-        case -1:
-        default:
-          /* Invalid host string. */
-          g_strfreev (split);
-          gvm_hosts_free (hosts);
-          return NULL;
-        }
-      host_element++; /* move on to next element of split list */
-      if (max_hosts > 0 && hosts->count > max_hosts)
-        {
-          g_strfreev (split);
-          gvm_hosts_free (hosts);
-          return NULL;
-        }
+      gvm_hosts_free (hosts);
+      return NULL;
     }
 
   /* No need to check for duplicates when a hosts string contains a
    * single (IP/Hostname/Range/Subnetwork) entry. */
-  if (g_strv_length (split) > 1)
+  if (strchr (hosts->orig_str, ','))
     gvm_hosts_deduplicate (hosts);
 
-  g_strfreev (split);
 #ifdef __GLIBC__
   malloc_trim (0);
 #endif
@@ -1309,7 +2361,10 @@ gvm_hosts_new (const gchar *hosts_str)
 gvm_host_t *
 gvm_hosts_next (gvm_hosts_t *hosts)
 {
-  if (!hosts || hosts->current == hosts->count)
+  if (!hosts)
+    return NULL;
+  if (hosts->current == hosts->count
+      && gvm_hosts_materialize_next (hosts) == -1)
     return NULL;
 
   return hosts->hosts[hosts->current++];
@@ -1333,6 +2388,7 @@ gvm_hosts_move_current_host_to_end (gvm_hosts_t *hosts)
   if (!hosts)
     return;
 
+  gvm_hosts_expand (hosts);
   if (hosts->current == hosts->count)
     {
       hosts->current -= 1;
@@ -1346,6 +2402,7 @@ gvm_hosts_move_current_host_to_end (gvm_hosts_t *hosts)
     hosts->hosts[i - 1] = hosts->hosts[i];
 
   hosts->hosts[hosts->count - 1] = host_tmp;
+  gvm_hosts_index_invalidate (hosts);
 }
 
 /**
@@ -1367,63 +2424,515 @@ gvm_hosts_free (gvm_hosts_t *hosts)
   for (i = 0; i < hosts->count; i++)
     gvm_host_free (hosts->hosts[i]);
   g_free (hosts->hosts);
+  for (i = hosts->span; i < hosts->spans->len; i++)
+    gvm_host_free (g_array_index (hosts->spans, struct gvm_hosts_span, i).host);
+  g_array_free (hosts->spans, TRUE);
+  gvm_hosts_index_invalidate (hosts);
+  gvm_memstats_free (GVM_MEM_HOSTS, sizeof (gvm_hosts_t)
+                                      + hosts->max_size * sizeof (gvm_host_t *));
   g_free (hosts);
   hosts = NULL;
 }
 
 /**
- * @brief Randomizes the order of the hosts objects in the collection.
- * Not to be used while iterating over the single hosts as it resets the
- * iterator.
+ * @brief Randomizes the order of the pending hosts of a hosts collection,
+ * without materializing them.
+ *
+ * The hosts are then iterated over through a pseudo-random permutation of
+ * all of them, across the spans, in O(1) memory.
+ *
+ * @param[in] hosts The hosts collection to shuffle, without materialized
+ *                  hosts.
+ * @param[in] rand  Random numbers generator.
+ */
+static void
+gvm_hosts_shuffle_spans (gvm_hosts_t *hosts, GRand *rand)
+{
+  size_t i;
+  guint64 start = 0;
+  int round;
+
+  for (i = hosts->span; i < hosts->spans->len; i++)
+    {
+      struct gvm_hosts_span *span;
+
+      span = &g_array_index (hosts->spans, struct gvm_hosts_span, i);
+      span->reversed = FALSE;
+      span->start = start;
+      start += span->size;
+    }
+
+  hosts->perm_total = start;
+  hosts->perm_next = 0;
+  hosts->perm_bits = 1;
+  while (hosts->perm_bits < 32
+         && (G_GUINT64_CONSTANT (1) << (2 * hosts->perm_bits)) < start)
+    hosts->perm_bits++;
+  for (round = 0; round < 4; round++)
+    hosts->perm_keys[round] = g_rand_int (rand);
+  hosts->current = 0;
+}
+
+/**
+ * @brief Randomizes the order of the hosts objects in the collection.
+ * Not to be used while iterating over the single hosts as it resets the
+ * iterator.
+ *
+ * @param[in] hosts The hosts collection to shuffle.
+ */
+void
+gvm_hosts_shuffle (gvm_hosts_t *hosts)
+{
+  size_t i = 0;
+  GRand *rand;
+
+  if (hosts == NULL)
+    return;
+
+  rand = g_rand_new ();
+  if (hosts->count == 0)
+    {
+      gvm_hosts_shuffle_spans (hosts, rand);
+      g_rand_free (rand);
+      return;
+    }
+
+  /* Shuffle the array. */
+  gvm_hosts_expand (hosts);
+  for (i = 0; i < hosts->count; i++)
+    {
+      void *tmp;
+      int j = g_rand_int_range (rand, 0, hosts->count);
+
+      tmp = hosts->hosts[i];
+      hosts->hosts[i] = hosts->hosts[j];
+      hosts->hosts[j] = tmp;
+    }
+
+  hosts->current = 0;
+  gvm_hosts_index_invalidate (hosts);
+  g_rand_free (rand);
+}
+
+/**
+ * @brief Reverses the order of the hosts objects in the collection.
+ * Not to be used while iterating over the single hosts as it resets the
+ * iterator.
+ *
+ * @param[in] hosts The hosts collection to reverse.
+ */
+void
+gvm_hosts_reverse (gvm_hosts_t *hosts)
+{
+  size_t i, j;
+  if (hosts == NULL)
+    return;
+
+  if (hosts->count == 0)
+    {
+      /* Reverse the order of the spans and of the hosts inside them. */
+      hosts->perm_bits = 0;
+      for (i = hosts->span; i < hosts->spans->len; i++)
+        g_array_index (hosts->spans, struct gvm_hosts_span, i).reversed ^=
+          TRUE;
+      for (i = hosts->span, j = hosts->spans->len - 1;
+           hosts->spans->len && i < j; i++, j--)
+        {
+          struct gvm_hosts_span tmp;
+
+          tmp = g_array_index (hosts->spans, struct gvm_hosts_span, i);
+          g_array_index (hosts->spans, struct gvm_hosts_span, i) =
+            g_array_index (hosts->spans, struct gvm_hosts_span, j);
+          g_array_index (hosts->spans, struct gvm_hosts_span, j) = tmp;
+        }
+      hosts->current = 0;
+      return;
+    }
+
+  gvm_hosts_expand (hosts);
+  for (i = 0, j = hosts->count - 1; i < j; i++, j--)
+    {
+      gvm_host_t *tmp = hosts->hosts[i];
+      hosts->hosts[i] = hosts->hosts[j];
+      hosts->hosts[j] = tmp;
+    }
+  hosts->current = 0;
+  gvm_hosts_index_invalidate (hosts);
+}
+
+/**
+ * @brief Number of threads resolving hostnames or addresses concurrently.
+ * 1 or less resolves them one by one.
+ */
+static unsigned int resolve_threads = 1;
+
+/**
+ * @brief Number of seconds after which a hostname or address being resolved
+ * is given up on, with concurrent resolution. 0 means no timeout.
+ */
+static unsigned int resolve_timeout = 0;
+
+/**
+ * @brief Function resolving a hostname to a list of struct in6_addr.
+ */
+static GSList *(*resolve_list_func) (const char *) = gvm_resolve_list;
+
+/**
+ * @brief Sets the function used by @ref gvm_hosts_resolve to resolve
+ * hostnames, for tests and benchmarks.
+ *
+ * @param[in] func  Function returning a list of struct in6_addr for a
+ *                  hostname, to be freed with g_free. NULL restores
+ *                  gvm_resolve_list.
+ */
+void
+gvm_hosts_set_resolve_func (GSList *(*func) (const char *))
+{
+  resolve_list_func = func ? func : gvm_resolve_list;
+}
+
+/**
+ * @brief Cache of reverse lookups, from IPv6 (or IPv4-mapped) address to
+ * hostname, or to an empty string for addresses without one.
+ */
+static GHashTable *reverse_lookup_cache = NULL;
+
+G_LOCK_DEFINE_STATIC (reverse_lookup_cache);
+
+/**
+ * @brief Sets the concurrency of the hostnames resolution of
+ * @ref gvm_hosts_resolve and of the reverse lookups of the
+ * gvm_hosts_reverse_lookup_* filters.
+ *
+ * @param[in] threads Number of lookups run concurrently. 0 or 1 runs them
+ *                    one by one, which is the default.
+ * @param[in] timeout Seconds after which a lookup is given up on when run
+ *                    concurrently. 0 means no timeout.
+ */
+void
+gvm_hosts_resolve_set_concurrency (unsigned int threads, unsigned int timeout)
+{
+  resolve_threads = threads;
+  resolve_timeout = timeout;
+}
+
+/**
+ * @brief Clears the cache of the reverse lookups done by the
+ * gvm_hosts_reverse_lookup_* filters.
+ */
+void
+gvm_hosts_reverse_lookup_cache_clear (void)
+{
+  G_LOCK (reverse_lookup_cache);
+  if (reverse_lookup_cache)
+    g_hash_table_destroy (reverse_lookup_cache);
+  reverse_lookup_cache = NULL;
+  G_UNLOCK (reverse_lookup_cache);
+}
+
+/**
+ * @brief Hashes an IPv6 address.
+ */
+static guint
+in6_addr_hash (gconstpointer key)
+{
+  const guint32 *words = key;
+
+  return words[0] ^ words[1] ^ words[2] ^ words[3];
+}
+
+/**
+ * @brief Compares two IPv6 addresses.
+ */
+static gboolean
+in6_addr_equal (gconstpointer a, gconstpointer b)
+{
+  return memcmp (a, b, sizeof (struct in6_addr)) == 0;
+}
+
+/**
+ * @brief A lookup run by a resolver thread.
+ */
+struct resolve_query
+{
+  gpointer input;  /**< What to resolve. */
+  gpointer result; /**< Result of the lookup. */
+  gint64 started;  /**< Monotonic time at which the lookup started, or 0. */
+  int done;        /**< Whether the lookup is over. */
+  int timed_out;   /**< Whether the result was given up on. */
+};
+
+/**
+ * @brief State shared by the resolver threads. It outlives the resolution
+ * when a query times out, until the last thread is done.
+ */
+struct resolve_context
+{
+  GMutex mutex;                  /**< Protects the queries. */
+  GCond cond;                    /**< Signaled when a query is done. */
+  gint refcount;                 /**< References from caller and threads. */
+  struct resolve_query *queries; /**< Queries. */
+  size_t count;                  /**< Number of queries. */
+  gpointer (*resolve) (gpointer); /**< Lookup function. */
+  GDestroyNotify free_input;      /**< Frees a query input. */
+  GDestroyNotify free_result;     /**< Frees a query result. */
+};
+
+/**
+ * @brief Releases a reference to a resolver context.
+ *
+ * @param[in] context Resolver context.
+ */
+static void
+resolve_context_unref (struct resolve_context *context)
+{
+  size_t i;
+
+  if (!g_atomic_int_dec_and_test (&context->refcount))
+    return;
+
+  for (i = 0; i < context->count; i++)
+    {
+      context->free_input (context->queries[i].input);
+      if (context->queries[i].result)
+        context->free_result (context->queries[i].result);
+    }
+  g_free (context->queries);
+  g_mutex_clear (&context->mutex);
+  g_cond_clear (&context->cond);
+  g_free (context);
+}
+
+/**
+ * @brief Runs a lookup, in a resolver thread.
+ *
+ * @param[in] data      Query to resolve.
+ * @param[in] user_data Resolver context.
+ */
+static void
+resolve_worker (gpointer data, gpointer user_data)
+{
+  struct resolve_query *query = data;
+  struct resolve_context *context = user_data;
+  gpointer result;
+
+  g_mutex_lock (&context->mutex);
+  query->started = g_get_monotonic_time ();
+  g_mutex_unlock (&context->mutex);
+
+  result = context->resolve (query->input);
+
+  g_mutex_lock (&context->mutex);
+  query->result = result;
+  query->done = 1;
+  g_cond_signal (&context->cond);
+  g_mutex_unlock (&context->mutex);
+  resolve_context_unref (context);
+}
+
+/**
+ * @brief Runs lookups, concurrently if so configured.
+ *
+ * @param[in] inputs      Inputs of the lookups. Freed with free_input.
+ * @param[in] count       Number of lookups.
+ * @param[in] resolve     Lookup function. Must be thread safe.
+ * @param[in] free_input  Function to free an input.
+ * @param[in] free_result Function to free a result.
+ *
+ * @return Array of count results, NULL for the lookups which failed or
+ * timed out. To be freed with g_free after freeing the results.
+ */
+static gpointer *
+gvm_resolve_concurrent (gpointer *inputs, size_t count,
+                        gpointer (*resolve) (gpointer),
+                        GDestroyNotify free_input, GDestroyNotify free_result)
+{
+  struct resolve_context *context = NULL;
+  GThreadPool *pool = NULL;
+  gpointer *results;
+  size_t i;
+
+  results = g_malloc0_n (count ? count : 1, sizeof (*results));
+  if (resolve_threads > 1 && count > 1)
+    {
+      context = g_malloc0 (sizeof (*context));
+      g_mutex_init (&context->mutex);
+      g_cond_init (&context->cond);
+      context->refcount = 1;
+      context->count = count;
+      context->resolve = resolve;
+      context->free_input = free_input;
+      context->free_result = free_result;
+      context->queries = g_malloc0_n (count, sizeof (*context->queries));
+      for (i = 0; i < count; i++)
+        context->queries[i].input = inputs[i];
+      pool = g_thread_pool_new (resolve_worker, context,
+                                MIN (resolve_threads, count), FALSE, NULL);
+      if (pool == NULL)
+        {
+          /* Keep the inputs for the serial lookups. */
+          context->count = 0;
+          resolve_context_unref (context);
+        }
+    }
+  if (pool == NULL)
+    {
+      for (i = 0; i < count; i++)
+        {
+          results[i] = resolve (inputs[i]);
+          free_input (inputs[i]);
+        }
+      return results;
+    }
+
+  for (i = 0; i < count; i++)
+    {
+      g_atomic_int_inc (&context->refcount);
+      g_thread_pool_push (pool, &context->queries[i], NULL);
+    }
+
+  g_mutex_lock (&context->mutex);
+  for (;;)
+    {
+      gint64 now = g_get_monotonic_time ();
+      size_t remaining = 0;
+
+      for (i = 0; i < count; i++)
+        {
+          struct resolve_query *query = &context->queries[i];
+
+          if (query->done || query->timed_out)
+            continue;
+          if (resolve_timeout && query->started
+              && now - query->started
+                   >= (gint64) resolve_timeout * G_TIME_SPAN_SECOND)
+            {
+              g_debug ("%s: Lookup %zu timed out", __func__, i);
+              query->timed_out = 1;
+              continue;
+            }
+          remaining++;
+        }
+      if (remaining == 0)
+        break;
+      if (resolve_timeout)
+        g_cond_wait_until (&context->cond, &context->mutex,
+                           now + 100 * G_TIME_SPAN_MILLISECOND);
+      else
+        g_cond_wait (&context->cond, &context->mutex);
+    }
+  for (i = 0; i < count; i++)
+    if (!context->queries[i].timed_out)
+      {
+        results[i] = context->queries[i].result;
+        context->queries[i].result = NULL;
+      }
+  g_mutex_unlock (&context->mutex);
+
+  /* Threads still running timed out lookups release the context when they
+   * are done. */
+  g_thread_pool_free (pool, FALSE, FALSE);
+  resolve_context_unref (context);
+  return results;
+}
+
+/**
+ * @brief Lookup function resolving a hostname, for gvm_resolve_concurrent.
+ *
+ * @param[in] name Hostname.
+ *
+ * @return List of struct in6_addr.
+ */
+static gpointer
+resolve_name (gpointer name)
+{
+  return resolve_list_func (name);
+}
+
+/**
+ * @brief Frees a list of addresses, for gvm_resolve_concurrent.
+ *
+ * @param[in] list List of struct in6_addr.
+ */
+static void
+resolve_list_free (gpointer list)
+{
+  g_slist_free_full (list, g_free);
+}
+
+/**
+ * @brief Lookup function doing a cached reverse lookup of a host, for
+ * gvm_resolve_concurrent.
  *
- * @param[in] hosts The hosts collection to shuffle.
+ * @param[in] host Host object.
+ *
+ * @return Hostname, NULL if none.
  */
-void
-gvm_hosts_shuffle (gvm_hosts_t *hosts)
+static gpointer
+reverse_lookup_host (gpointer host)
 {
-  size_t i = 0;
-  GRand *rand;
-
-  if (hosts == NULL)
-    return;
+  struct in6_addr addr6, *key;
+  const gchar *cached;
+  gchar *name;
+  int cache = gvm_host_type (host) != HOST_TYPE_NAME
+              && gvm_host_get_addr6 (host, &addr6) == 0;
 
-  /* Shuffle the array. */
-  rand = g_rand_new ();
-  for (i = 0; i < hosts->count; i++)
+  if (cache)
     {
-      void *tmp;
-      int j = g_rand_int_range (rand, 0, hosts->count);
-
-      tmp = hosts->hosts[i];
-      hosts->hosts[i] = hosts->hosts[j];
-      hosts->hosts[j] = tmp;
+      G_LOCK (reverse_lookup_cache);
+      cached = reverse_lookup_cache
+                 ? g_hash_table_lookup (reverse_lookup_cache, &addr6)
+                 : NULL;
+      name = cached ? g_strdup (cached) : NULL;
+      G_UNLOCK (reverse_lookup_cache);
+      if (cached)
+        {
+          if (*name)
+            return name;
+          g_free (name);
+          return NULL;
+        }
     }
 
-  hosts->current = 0;
-  g_rand_free (rand);
+  name = gvm_host_reverse_lookup (host);
+  if (cache)
+    {
+      G_LOCK (reverse_lookup_cache);
+      if (reverse_lookup_cache == NULL)
+        reverse_lookup_cache = g_hash_table_new_full (
+          in6_addr_hash, in6_addr_equal, g_free, g_free);
+      key = g_malloc (sizeof (addr6));
+      memcpy (key, &addr6, sizeof (addr6));
+      g_hash_table_replace (reverse_lookup_cache, key,
+                            g_strdup (name ? name : ""));
+      G_UNLOCK (reverse_lookup_cache);
+    }
+  return name;
 }
 
 /**
- * @brief Reverses the order of the hosts objects in the collection.
- * Not to be used while iterating over the single hosts as it resets the
- * iterator.
+ * @brief Does the reverse lookups of all the hosts of a collection,
+ * concurrently if so configured.
  *
- * @param[in] hosts The hosts collection to reverse.
+ * @param[in] hosts The hosts collection, fully materialized.
+ *
+ * @return Array of hosts->count hostnames, NULL for the hosts without one.
+ * To be freed with g_free after freeing the hostnames.
  */
-void
-gvm_hosts_reverse (gvm_hosts_t *hosts)
+static gchar **
+gvm_hosts_reverse_lookup_all (gvm_hosts_t *hosts)
 {
-  size_t i, j;
-  if (hosts == NULL)
-    return;
+  gpointer *inputs;
+  gchar **names;
+  size_t i;
 
-  for (i = 0, j = hosts->count - 1; i < j; i++, j--)
-    {
-      gvm_host_t *tmp = hosts->hosts[i];
-      hosts->hosts[i] = hosts->hosts[j];
-      hosts->hosts[j] = tmp;
-    }
-  hosts->current = 0;
+  inputs = g_malloc0_n (hosts->count ? hosts->count : 1, sizeof (*inputs));
+  for (i = 0; i < hosts->count; i++)
+    inputs[i] = gvm_duplicate_host (hosts->hosts[i]);
+  names = (gchar **) gvm_resolve_concurrent (
+    inputs, hosts->count, reverse_lookup_host, gvm_host_free, g_free);
+  g_free (inputs);
+  return names;
 }
 
 /**
@@ -1439,9 +2948,31 @@ gvm_hosts_reverse (gvm_hosts_t *hosts)
 GSList *
 gvm_hosts_resolve (gvm_hosts_t *hosts)
 {
-  size_t i, new_entries = 0, resolved = 0;
-  GSList *unresolved = NULL;
+  size_t i, new_entries = 0, resolved = 0, count = 0;
+  GSList *unresolved = NULL, **lists;
+  gpointer *names;
+
+  /* Ranges of addresses have nothing to resolve. */
+  for (i = hosts->span; i < hosts->spans->len; i++)
+    if (g_array_index (hosts->spans, struct gvm_hosts_span, i).type
+        == HOST_TYPE_NAME)
+      break;
+  if (hosts->count == 0 && i == hosts->spans->len)
+    {
+      hosts->current = 0;
+      return NULL;
+    }
+
+  gvm_hosts_expand (hosts);
+  names = g_malloc0_n (hosts->count ? hosts->count : 1, sizeof (*names));
+  for (i = 0; i < hosts->count; i++)
+    if (hosts->hosts[i]->type == HOST_TYPE_NAME)
+      names[count++] = g_strdup (hosts->hosts[i]->name);
+  lists = (GSList **) gvm_resolve_concurrent (names, count, resolve_name,
+                                              g_free, resolve_list_free);
+  g_free (names);
 
+  count = 0;
   for (i = 0; i < hosts->count; i++)
     {
       GSList *list, *tmp;
@@ -1450,7 +2981,7 @@ gvm_hosts_resolve (gvm_hosts_t *hosts)
       if (host->type != HOST_TYPE_NAME)
         continue;
 
-      list = tmp = gvm_resolve_list (host->name);
+      list = tmp = lists[count++];
       while (tmp)
         {
           /* Create a new host for each IP address. */
@@ -1486,6 +3017,7 @@ gvm_hosts_resolve (gvm_hosts_t *hosts)
       gvm_host_free (host);
       g_slist_free_full (list, g_free);
     }
+  g_free (lists);
   if (resolved)
     gvm_hosts_fill_gaps (hosts);
   hosts->count -= resolved;
@@ -1507,47 +3039,196 @@ gvm_hosts_resolve (gvm_hosts_t *hosts)
 int
 gvm_vhosts_exclude (gvm_host_t *host, const char *excluded_str)
 {
-  GSList *vhost;
-  char **excluded;
+  GSList *vhost, *prev = NULL;
+  GHashTable *excluded_set;
+  char **excluded, **tmp;
   int ret = 0;
 
   if (!host || !excluded_str)
     return ret;
 
-  vhost = host->vhosts;
   excluded = g_strsplit (excluded_str, ",", 0);
   if (!excluded || !*excluded)
     {
       g_strfreev (excluded);
       return ret;
     }
+  /* Match each vhost against a set of the excluded names, so that the cost
+   * is linear in the number of vhosts plus the number of names. */
+  excluded_set = g_hash_table_new (vhost_value_hash, vhost_value_equal);
+  for (tmp = excluded; *tmp; tmp++)
+    g_hash_table_add (excluded_set, g_strstrip (*tmp));
+
+  vhost = host->vhosts;
   while (vhost)
     {
-      char **tmp = excluded;
-      char *value = ((gvm_vhost_t *) vhost->data)->value;
+      GSList *next = vhost->next;
+      gvm_vhost_t *data = vhost->data;
 
-      while (*tmp)
+      if (!g_hash_table_contains (excluded_set, data->value))
         {
-          if (!strcasecmp (value, g_strstrip (*tmp)))
-            {
-              gvm_vhost_free (vhost->data);
-              host->vhosts = vhost = g_slist_delete_link (host->vhosts, vhost);
-              ret++;
-              break;
-            }
-          tmp++;
-          if (!*tmp)
-            {
-              vhost = vhost->next;
-              break;
-            }
+          prev = vhost;
+          vhost = next;
+          continue;
         }
+      if (host->vhosts_set
+          && g_hash_table_lookup (host->vhosts_set, data->value) == data)
+        g_hash_table_remove (host->vhosts_set, data->value);
+      gvm_vhost_free (data);
+      g_slist_free_1 (vhost);
+      if (prev)
+        prev->next = next;
+      else
+        host->vhosts = next;
+      vhost = next;
+      ret++;
     }
+  g_hash_table_destroy (excluded_set);
   g_strfreev (excluded);
 
   return ret;
 }
 
+/**
+ * @brief Set of hosts to match hosts against: hostnames in a hash table and
+ * IP addresses as a sorted set of intervals.
+ */
+struct host_filter
+{
+  GHashTable *names; /**< Hostnames. */
+  GSequence *set;    /**< Sorted set of span_interval. */
+};
+
+/**
+ * @brief Initializes a hosts filter from a hosts collection, without
+ * materializing its pending ranges.
+ *
+ * @param[out] filter Filter to initialize.
+ * @param[in]  hosts  Hosts to match against. Must outlive the filter.
+ */
+static void
+host_filter_init (struct host_filter *filter, const gvm_hosts_t *hosts)
+{
+  size_t i;
+
+  filter->names = g_hash_table_new (g_str_hash, g_str_equal);
+  filter->set = g_sequence_new (g_free);
+  for (i = 0; i < hosts->count; i++)
+    {
+      const gvm_host_t *host = hosts->hosts[i];
+      struct gvm_hosts_span span = {0};
+
+      if (host->type == HOST_TYPE_NAME)
+        {
+          g_hash_table_add (filter->names, host->name);
+          continue;
+        }
+      span.type = host->type;
+      span.size = 1;
+      host_span_addr (host, &span.first);
+      span_set_add (filter->set, &span);
+    }
+  for (i = hosts->span; i < hosts->spans->len; i++)
+    {
+      const struct gvm_hosts_span *span;
+
+      span = &g_array_index (hosts->spans, struct gvm_hosts_span, i);
+      if (span->type == HOST_TYPE_NAME)
+        {
+          if (span->host)
+            g_hash_table_add (filter->names, span->host->name);
+        }
+      else if (span->host)
+        {
+          struct gvm_hosts_span single = *span;
+
+          single.size = 1;
+          host_span_addr (span->host, &single.first);
+          span_set_add (filter->set, &single);
+        }
+      else
+        span_set_add (filter->set, span);
+    }
+}
+
+/**
+ * @brief Frees the resources of a hosts filter.
+ *
+ * @param[in] filter Filter to clear.
+ */
+static void
+host_filter_clear (struct host_filter *filter)
+{
+  g_hash_table_destroy (filter->names);
+  g_sequence_free (filter->set);
+}
+
+/**
+ * @brief Checks whether a host matches a hosts filter.
+ *
+ * @param[in] filter Hosts filter.
+ * @param[in] host   Host to check.
+ *
+ * @return 1 if the host matches, 0 otherwise.
+ */
+static int
+host_filter_match (const struct host_filter *filter, const gvm_host_t *host)
+{
+  struct span_interval probe, *interval;
+  GSequenceIter *iter;
+
+  if (host->type == HOST_TYPE_NAME)
+    return g_hash_table_contains (filter->names, host->name);
+
+  probe.type = host->type;
+  host_span_addr (host, &probe.first);
+  iter = g_sequence_search (filter->set, &probe, span_interval_cmp, NULL);
+  if (g_sequence_iter_is_begin (iter))
+    return 0;
+  interval = g_sequence_get (g_sequence_iter_prev (iter));
+  return interval->type == probe.type
+         && span_addr_cmp (&interval->last, &probe.first) >= 0;
+}
+
+/**
+ * @brief Excludes the hosts matching a filter from the pending spans of a
+ * hosts collection, without materializing them.
+ *
+ * @param[in,out] hosts   The hosts collection from which to exclude.
+ * @param[in]     filter  The hosts to exclude.
+ *
+ * @return Number of excluded hosts.
+ */
+static size_t
+gvm_hosts_exclude_spans (gvm_hosts_t *hosts, const struct host_filter *filter)
+{
+  GArray *spans;
+  size_t i, excluded = 0;
+
+  spans = g_array_new (FALSE, FALSE, sizeof (struct gvm_hosts_span));
+  for (i = hosts->span; i < hosts->spans->len; i++)
+    {
+      struct gvm_hosts_span *span;
+
+      span = &g_array_index (hosts->spans, struct gvm_hosts_span, i);
+      if (span->type == HOST_TYPE_NAME)
+        {
+          if (host_filter_match (filter, span->host))
+            {
+              gvm_host_free (span->host);
+              excluded++;
+            }
+          else
+            g_array_append_val (spans, *span);
+          continue;
+        }
+      excluded += span->size - span_subtract (filter->set, span, spans);
+    }
+
+  gvm_hosts_set_spans (hosts, spans);
+  return excluded;
+}
+
 /**
  * @brief Excludes a set of hosts provided as a string from a hosts collection.
  * Not to be used while iterating over the single hosts as it resets the
@@ -1564,10 +3245,11 @@ gvm_hosts_exclude_with_max (gvm_hosts_t *hosts, const char *excluded_str,
                             unsigned int max_hosts)
 {
   /**
-   * Uses a hash table in order to exclude hosts in O(N+M) time.
+   * Matches against sorted address intervals and a hash table of hostnames,
+   * in O((N+M) log M) time.
    */
   gvm_hosts_t *excluded_hosts;
-  GHashTable *name_table;
+  struct host_filter filter;
   size_t excluded = 0, i;
 
   if (hosts == NULL || excluded_str == NULL)
@@ -1583,42 +3265,28 @@ gvm_hosts_exclude_with_max (gvm_hosts_t *hosts, const char *excluded_str,
       return 0;
     }
 
-  /* Hash host values from excluded hosts list. */
-  name_table = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
-  for (i = 0; i < excluded_hosts->count; i++)
-    {
-      gchar *name;
-
-      if ((name = gvm_host_value_str (excluded_hosts->hosts[i])))
-        g_hash_table_insert (name_table, name, hosts);
-    }
-
-  /* Check for hosts values in hash table. */
-  for (i = 0; i < hosts->count; i++)
+  host_filter_init (&filter, excluded_hosts);
+  if (gvm_hosts_spans_only (hosts))
+    excluded = gvm_hosts_exclude_spans (hosts, &filter);
+  else
     {
-      gchar *name;
-
-      if ((name = gvm_host_value_str (hosts->hosts[i])))
-        {
-          if (g_hash_table_lookup (name_table, name))
-            {
-              gvm_host_free (hosts->hosts[i]);
-              hosts->hosts[i] = NULL;
-              excluded++;
-              g_free (name);
-              continue;
-            }
-          g_free (name);
-        }
+      gvm_hosts_expand (hosts);
+      for (i = 0; i < hosts->count; i++)
+        if (host_filter_match (&filter, hosts->hosts[i]))
+          {
+            gvm_host_free (hosts->hosts[i]);
+            hosts->hosts[i] = NULL;
+            excluded++;
+          }
+      if (excluded)
+        gvm_hosts_fill_gaps (hosts);
+      hosts->count -= excluded;
     }
 
   /* Cleanup. */
-  if (excluded)
-    gvm_hosts_fill_gaps (hosts);
-  hosts->count -= excluded;
   hosts->removed += excluded;
   hosts->current = 0;
-  g_hash_table_destroy (name_table);
+  host_filter_clear (&filter);
   gvm_hosts_free (excluded_hosts);
   return excluded;
 }
@@ -1640,10 +3308,11 @@ gvm_hosts_allowed_only (gvm_hosts_t *hosts, const char *deny_hosts_str,
                         const char *allow_hosts_str)
 {
   /**
-   * Uses a hash table in order to exclude hosts in O(N+M) time.
+   * Matches against sorted address intervals and a hash table of hostnames,
+   * in O((N+M) log M) time.
    */
   gvm_hosts_t *allowed_hosts, *denied_hosts;
-  GHashTable *name_allow_table = NULL, *name_deny_table = NULL;
+  struct host_filter allow_filter, deny_filter;
   GSList *removed = NULL;
   size_t excluded = 0, i;
 
@@ -1657,63 +3326,38 @@ gvm_hosts_allowed_only (gvm_hosts_t *hosts, const char *deny_hosts_str,
     return NULL;
 
   if (gvm_hosts_count (denied_hosts) == 0)
-    gvm_hosts_free (denied_hosts);
-  else
     {
-      /* Hash host values from denied hosts list. */
-      name_deny_table =
-        g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
-      for (i = 0; i < denied_hosts->count; i++)
-        {
-          gchar *name;
-
-          if ((name = gvm_host_value_str (denied_hosts->hosts[i])))
-            g_hash_table_insert (name_deny_table, name, hosts);
-        }
+      gvm_hosts_free (denied_hosts);
+      denied_hosts = NULL;
     }
-  if (gvm_hosts_count (allowed_hosts) == 0)
-    gvm_hosts_free (allowed_hosts);
   else
+    host_filter_init (&deny_filter, denied_hosts);
+  if (gvm_hosts_count (allowed_hosts) == 0)
     {
-      /* Hash host values from allowed hosts list. */
-      name_allow_table =
-        g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
-      for (i = 0; i < allowed_hosts->count; i++)
-        {
-          gchar *name;
-
-          if ((name = gvm_host_value_str (allowed_hosts->hosts[i])))
-            g_hash_table_insert (name_allow_table, name, hosts);
-        }
+      gvm_hosts_free (allowed_hosts);
+      allowed_hosts = NULL;
     }
+  else
+    host_filter_init (&allow_filter, allowed_hosts);
 
-  /* Check for authorized hosts in hash table and create a list of removed
-   * hosts. */
+  /* Check for authorized hosts and create a list of removed hosts. The
+   * removed hosts are returned, so the hosts are materialized. */
+  gvm_hosts_expand (hosts);
   for (i = 0; i < hosts->count; i++)
     {
-      gchar *name;
+      gvm_host_t *host = hosts->hosts[i];
 
-      if ((name = gvm_host_value_str (hosts->hosts[i])))
+      if ((denied_hosts != NULL && host_filter_match (&deny_filter, host))
+          || (allowed_hosts != NULL
+              && !host_filter_match (&allow_filter, host)))
         {
-          if (denied_hosts != NULL
-              && g_hash_table_lookup (name_deny_table, name))
-            {
-              gvm_host_free (hosts->hosts[i]);
-              hosts->hosts[i] = NULL;
-              excluded++;
-              removed = g_slist_prepend (removed, name);
-              continue;
-            }
-          else if (allowed_hosts != NULL
-                   && !g_hash_table_lookup (name_allow_table, name))
-            {
-              gvm_host_free (hosts->hosts[i]);
-              hosts->hosts[i] = NULL;
-              excluded++;
-              removed = g_slist_prepend (removed, name);
-              continue;
-            }
-          g_free (name);
+          gchar *name;
+
+          if ((name = gvm_host_value_str (host)))
+            removed = g_slist_prepend (removed, name);
+          gvm_host_free (host);
+          hosts->hosts[i] = NULL;
+          excluded++;
         }
     }
 
@@ -1724,14 +3368,16 @@ gvm_hosts_allowed_only (gvm_hosts_t *hosts, const char *deny_hosts_str,
   hosts->count -= excluded;
   hosts->removed += excluded;
   hosts->current = 0;
-  if (name_allow_table != NULL)
-    g_hash_table_destroy (name_allow_table);
-  if (name_deny_table != NULL)
-    g_hash_table_destroy (name_deny_table);
   if (allowed_hosts != NULL)
-    gvm_hosts_free (allowed_hosts);
+    {
+      host_filter_clear (&allow_filter);
+      gvm_hosts_free (allowed_hosts);
+    }
   if (denied_hosts != NULL)
-    gvm_hosts_free (denied_hosts);
+    {
+      host_filter_clear (&deny_filter);
+      gvm_hosts_free (denied_hosts);
+    }
   return removed;
 }
 
@@ -1898,8 +3544,6 @@ host_name_verify (gvm_host_t *host, const char *value)
 void
 gvm_host_add_reverse_lookup (gvm_host_t *host)
 {
-  GSList *vhosts;
-  gvm_vhost_t *vhost;
   char *value;
 
   if (!host || host->type == HOST_TYPE_NAME)
@@ -1914,18 +3558,122 @@ gvm_host_add_reverse_lookup (gvm_host_t *host)
       return;
     }
   /* Don't add vhost, if already in the list. */
-  vhosts = host->vhosts;
-  while (vhosts)
+  gvm_host_add_vhost (host, value, g_strdup ("Reverse-DNS"));
+}
+
+/**
+ * @brief Indexes the vhosts of a host by value.
+ *
+ * Afterwards gvm_host_find_vhost and gvm_host_add_vhost cost the same
+ * whatever the number of vhosts, which suits hosts with many vhosts.  The
+ * functions of this module keep the index up to date, so the vhosts of an
+ * indexed host must only be changed through them.
+ *
+ * @param[in] host  The host whose vhosts to index.
+ */
+void
+gvm_host_index_vhosts (gvm_host_t *host)
+{
+  if (host == NULL || host->vhosts_set)
+    return;
+  host->vhosts_set = vhosts_set_new (host->vhosts);
+}
+
+/**
+ * @brief Finds a vhost of a host, ignoring case.
+ *
+ * @param[in] host   The host.
+ * @param[in] value  Vhost value to look for.
+ *
+ * @return The vhost, NULL if the host has none with this value.
+ */
+gvm_vhost_t *
+gvm_host_find_vhost (const gvm_host_t *host, const char *value)
+{
+  const GSList *vhosts;
+
+  if (host == NULL || value == NULL)
+    return NULL;
+  if (host->vhosts_set)
+    return g_hash_table_lookup (host->vhosts_set, value);
+  for (vhosts = host->vhosts; vhosts; vhosts = vhosts->next)
+    if (!strcasecmp (((gvm_vhost_t *) vhosts->data)->value, value))
+      return vhosts->data;
+  return NULL;
+}
+
+/**
+ * @brief Adds a vhost to a host, unless the host already has it.
+ *
+ * The vhost is added at the head of the vhosts list, like the reverse-lookup
+ * and DNS-resolution vhosts.
+ *
+ * @param[in] host    The host to which we add the vhost.
+ * @param[in] value   Vhost value.  Freed if not added.
+ * @param[in] source  Source of the value.  Freed if not added.
+ *
+ * @return 0 if added, 1 if the host already has this vhost, -1 if error.
+ */
+int
+gvm_host_add_vhost (gvm_host_t *host, char *value, char *source)
+{
+  gvm_vhost_t *vhost;
+
+  if (host == NULL || value == NULL || gvm_host_find_vhost (host, value))
     {
-      if (!strcasecmp (((gvm_vhost_t *) vhosts->data)->value, value))
-        {
-          g_free (value);
-          return;
-        }
-      vhosts = vhosts->next;
+      g_free (value);
+      g_free (source);
+      return host && value ? 1 : -1;
+    }
+  vhost = gvm_vhost_new (value, source);
+  host->vhosts = g_slist_prepend (host->vhosts, vhost);
+  if (host->vhosts_set)
+    g_hash_table_insert (host->vhosts_set, vhost->value, vhost);
+  return 0;
+}
+
+/**
+ * @brief Gets the vhosts of a host, in order.
+ *
+ * @param[in] host  The host.
+ *
+ * @return List of gvm_vhost_t, owned by the host.
+ */
+const GSList *
+gvm_host_vhosts (const gvm_host_t *host)
+{
+  return host ? host->vhosts : NULL;
+}
+
+/**
+ * @brief Moves the vhosts of a host to the end of the vhosts of another
+ * host, except those the other host already has, which are freed.
+ *
+ * Costs a single pass over each list.
+ *
+ * @param[in] host   The host receiving the vhosts.
+ * @param[in] other  The host giving its vhosts, which has none afterwards.
+ *
+ * @return Number of vhosts added to host.
+ */
+unsigned int
+gvm_host_merge_vhosts (gvm_host_t *host, gvm_host_t *other)
+{
+  struct vhosts_merge merge;
+  unsigned int added;
+
+  if (host == NULL || other == NULL || host == other || !other->vhosts)
+    return 0;
+  if (other->vhosts_set)
+    {
+      g_hash_table_destroy (other->vhosts_set);
+      other->vhosts_set = NULL;
     }
-  vhost = gvm_vhost_new (value, g_strdup ("Reverse-DNS"));
-  host->vhosts = g_slist_prepend (host->vhosts, vhost);
+  vhosts_merge_init (&merge, &host->vhosts, host->vhosts_set);
+  added = vhosts_merge_add (&merge, other->vhosts);
+  other->vhosts = NULL;
+  vhosts_merge_clear (&merge);
+  return added;
 }
 
 /**
@@ -1942,13 +3690,16 @@ gvm_hosts_reverse_lookup_only_excluded (gvm_hosts_t *hosts)
 {
   size_t i, count = 0;
   gvm_hosts_t *excluded = gvm_hosts_new ("");
+  gchar **names;
 
   if (hosts == NULL)
     return NULL;
+  gvm_hosts_expand (hosts);
 
+  names = gvm_hosts_reverse_lookup_all (hosts);
   for (i = 0; i < hosts->count; i++)
     {
-      gchar *name = gvm_host_reverse_lookup (hosts->hosts[i]);
+      gchar *name = names[i];
 
       if (name == NULL)
         {
@@ -1960,6 +3711,7 @@ gvm_hosts_reverse_lookup_only_excluded (gvm_hosts_t *hosts)
       else
         g_free (name);
     }
+  g_free (names);
 
   if (count)
     gvm_hosts_fill_gaps (hosts);
@@ -2012,17 +3764,20 @@ gvm_hosts_reverse_lookup_unify_excluded (gvm_hosts_t *hosts)
   size_t i, count = 0;
   GHashTable *name_table;
   gvm_hosts_t *excluded = NULL;
+  gchar **names;
 
   if (hosts == NULL)
     return NULL;
 
+  gvm_hosts_expand (hosts);
   excluded = gvm_hosts_new ("");
   name_table = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  names = gvm_hosts_reverse_lookup_all (hosts);
   for (i = 0; i < hosts->count; i++)
     {
       gchar *name;
 
-      if ((name = gvm_host_reverse_lookup (hosts->hosts[i])))
+      if ((name = names[i]))
         {
           if (g_hash_table_lookup (name_table, name))
             {
@@ -2040,6 +3795,7 @@ gvm_hosts_reverse_lookup_unify_excluded (gvm_hosts_t *hosts)
         }
     }
 
+  g_free (names);
   if (count)
     gvm_hosts_fill_gaps (hosts);
   g_hash_table_destroy (name_table);
@@ -2082,7 +3838,35 @@ gvm_hosts_reverse_lookup_unify (gvm_hosts_t *hosts)
 unsigned int
 gvm_hosts_count (const gvm_hosts_t *hosts)
 {
-  return hosts ? hosts->count : 0;
+  return hosts ? hosts->count + hosts->span_hosts : 0;
+}
+
+/**
+ * @brief Counts the single hosts of a hosts string, as a hosts collection
+ * created from it would hold, after removal of the duplicates.
+ *
+ * Ranges are counted arithmetically, without creating a host object per
+ * address, so this is cheap even for huge targets.
+ *
+ * @param[in]  hosts_str  The hosts string.
+ * @param[out] count      Number of hosts.
+ *
+ * @return 0 if success, -1 if hosts_str is invalid.
+ */
+int
+gvm_hosts_count_str (const gchar *hosts_str, guint64 *count)
+{
+  gvm_hosts_t *hosts;
+
+  if (count == NULL)
+    return -1;
+
+  hosts = gvm_hosts_new (hosts_str);
+  if (hosts == NULL)
+    return -1;
+  *count = hosts->count + hosts->span_hosts;
+  gvm_hosts_free (hosts);
+  return 0;
 }
 
 /**
@@ -2113,9 +3897,540 @@ gvm_hosts_duplicated (const gvm_hosts_t *hosts)
   return hosts ? hosts->duplicated : 0;
 }
 
+/**
+ * @brief Packed hosts list: parallel arrays of addresses and types, with
+ * side tables for the few hosts that have a name or vhosts.
+ */
+struct gvm_hosts_packed
+{
+  struct in6_addr *addrs; /**< Addresses, IPv4 ones as IPv4-mapped. */
+  guint8 *types;          /**< Host types. */
+  size_t count;           /**< Number of hosts. */
+  size_t size;            /**< Allocated number of entries. */
+  GHashTable *names;      /**< Index to hostname, for hostnames. */
+  GHashTable *vhosts;     /**< Index to GSList of gvm_vhost_t. */
+};
+
+/**
+ * @brief Frees a vhosts list of a packed hosts list.
+ *
+ * @param[in] vhosts List of gvm_vhost_t.
+ */
+static void
+packed_vhosts_free (gpointer vhosts)
+{
+  g_slist_free_full (vhosts, gvm_vhost_free);
+}
+
+/**
+ * @brief Creates an empty packed hosts list.
+ *
+ * @param[in] size  Number of entries to allocate.
+ *
+ * @return New packed hosts list.
+ */
+static gvm_hosts_packed_t *
+gvm_hosts_packed_new (size_t size)
+{
+  gvm_hosts_packed_t *packed;
+
+  packed = g_malloc0 (sizeof (*packed));
+  packed->size = size ? size : 1;
+  packed->addrs = g_malloc0_n (packed->size, sizeof (*packed->addrs));
+  packed->types = g_malloc0_n (packed->size, sizeof (*packed->types));
+  packed->names = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+                                         g_free);
+  packed->vhosts = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+                                          packed_vhosts_free);
+  return packed;
+}
+
+/**
+ * @brief Appends a host object to a packed hosts list.
+ *
+ * @param[in] packed  Packed hosts list, with room for the host.
+ * @param[in] host    Host to copy.
+ */
+static void
+gvm_hosts_packed_add (gvm_hosts_packed_t *packed, const gvm_host_t *host)
+{
+  size_t i = packed->count++;
+
+  packed->types[i] = host->type;
+  if (host->type == HOST_TYPE_NAME)
+    g_hash_table_insert (packed->names, GUINT_TO_POINTER (i),
+                         g_strdup (host->name));
+  else if (host->type == HOST_TYPE_IPV4)
+    ipv4_as_ipv6 (&host->addr, &packed->addrs[i]);
+  else
+    packed->addrs[i] = host->addr6;
+  if (host->vhosts)
+    g_hash_table_insert (
+      packed->vhosts, GUINT_TO_POINTER (i),
+      g_slist_copy_deep (host->vhosts, gvm_duplicate_vhost, NULL));
+}
+
+/**
+ * @brief Appends a host of a span to a packed hosts list.
+ *
+ * @param[in] packed  Packed hosts list, with room for the host.
+ * @param[in] span    Span of the host.
+ * @param[in] k       Index of the host in the span.
+ */
+static void
+gvm_hosts_packed_add_span (gvm_hosts_packed_t *packed,
+                           const struct gvm_hosts_span *span, guint64 k)
+{
+  struct span_addr addr;
+  struct in6_addr *addr6;
+
+  if (span->host)
+    {
+      gvm_hosts_packed_add (packed, span->host);
+      return;
+    }
+
+  addr = span_addr_at (span, k);
+  addr6 = &packed->addrs[packed->count];
+  packed->types[packed->count++] = span->type;
+  if (span->type == HOST_TYPE_IPV4)
+    {
+      struct in_addr addr4;
+
+      addr4.s_addr = htonl ((uint32_t) addr.lo);
+      ipv4_as_ipv6 (&addr4, addr6);
+    }
+  else
+    span_addr_to_in6 (&addr, addr6);
+}
+
+/**
+ * @brief Creates a packed copy of a hosts collection, without materializing
+ * its pending ranges.
+ *
+ * A packed list takes 17 bytes per host, so that a 64k hosts target fits in
+ * about 1 MB, and keeps the addresses contiguous for cache friendly
+ * iteration, sort and deduplication.
+ *
+ * @param[in] hosts The hosts collection.
+ *
+ * @return Packed hosts list to be freed with @ref gvm_hosts_packed_free, NULL
+ * if error.
+ */
+gvm_hosts_packed_t *
+gvm_hosts_pack (const gvm_hosts_t *hosts)
+{
+  gvm_hosts_packed_t *packed;
+  size_t i;
+
+  if (hosts == NULL)
+    return NULL;
+
+  packed = gvm_hosts_packed_new (gvm_hosts_count (hosts));
+  for (i = 0; i < hosts->count; i++)
+    gvm_hosts_packed_add (packed, hosts->hosts[i]);
+  if (hosts->perm_bits)
+    {
+      guint64 next = hosts->perm_next, n;
+
+      for (n = 0; n < hosts->span_hosts; n++)
+        {
+          const struct gvm_hosts_span *span;
+          guint64 k;
+
+          span = gvm_hosts_perm_span (hosts, &next, &k);
+          gvm_hosts_packed_add_span (packed, span, k);
+        }
+      return packed;
+    }
+  for (i = hosts->span; i < hosts->spans->len; i++)
+    {
+      const struct gvm_hosts_span *span;
+      guint64 k;
+
+      span = &g_array_index (hosts->spans, struct gvm_hosts_span, i);
+      for (k = span->pos; k < span->size; k++)
+        gvm_hosts_packed_add_span (packed, span, k);
+    }
+  return packed;
+}
+
+/**
+ * @brief Frees a packed hosts list.
+ *
+ * @param[in] packed  Packed hosts list.
+ */
+void
+gvm_hosts_packed_free (gvm_hosts_packed_t *packed)
+{
+  if (packed == NULL)
+    return;
+
+  g_free (packed->addrs);
+  g_free (packed->types);
+  g_hash_table_destroy (packed->names);
+  g_hash_table_destroy (packed->vhosts);
+  g_free (packed);
+}
+
+/**
+ * @brief Gets the number of hosts of a packed hosts list.
+ *
+ * @param[in] packed  Packed hosts list.
+ *
+ * @return Number of hosts.
+ */
+size_t
+gvm_hosts_packed_count (const gvm_hosts_packed_t *packed)
+{
+  return packed ? packed->count : 0;
+}
+
+/**
+ * @brief Gets the type of a host of a packed hosts list.
+ *
+ * @param[in] packed  Packed hosts list.
+ * @param[in] index   Index of the host.
+ *
+ * @return Host type, -1 if error.
+ */
+int
+gvm_hosts_packed_type (const gvm_hosts_packed_t *packed, size_t index)
+{
+  if (packed == NULL || index >= packed->count)
+    return -1;
+  return packed->types[index];
+}
+
+/**
+ * @brief Gets the address of a host of a packed hosts list. IPv4 addresses
+ * are returned as IPv4-mapped IPv6 addresses.
+ *
+ * @param[in]  packed  Packed hosts list.
+ * @param[in]  index   Index of the host.
+ * @param[out] ip6     Buffer to store the address.
+ *
+ * @return 0 if success, -1 if error or if the host is a hostname.
+ */
+int
+gvm_hosts_packed_get_addr6 (const gvm_hosts_packed_t *packed, size_t index,
+                            struct in6_addr *ip6)
+{
+  if (packed == NULL || ip6 == NULL || index >= packed->count
+      || packed->types[index] == HOST_TYPE_NAME)
+    return -1;
+  memcpy (ip6, &packed->addrs[index], sizeof (*ip6));
+  return 0;
+}
+
+/**
+ * @brief Gets the hostname of a host of a packed hosts list.
+ *
+ * @param[in] packed  Packed hosts list.
+ * @param[in] index   Index of the host.
+ *
+ * @return Hostname, NULL if error or if the host is an IP address.
+ */
+const gchar *
+gvm_hosts_packed_name (const gvm_hosts_packed_t *packed, size_t index)
+{
+  if (packed == NULL || index >= packed->count)
+    return NULL;
+  return g_hash_table_lookup (packed->names, GUINT_TO_POINTER (index));
+}
+
+/**
+ * @brief Gets the vhosts of a host of a packed hosts list.
+ *
+ * @param[in] packed  Packed hosts list.
+ * @param[in] index   Index of the host.
+ *
+ * @return List of gvm_vhost_t, owned by the packed hosts list.
+ */
+const GSList *
+gvm_hosts_packed_vhosts (const gvm_hosts_packed_t *packed, size_t index)
+{
+  if (packed == NULL || index >= packed->count)
+    return NULL;
+  return g_hash_table_lookup (packed->vhosts, GUINT_TO_POINTER (index));
+}
+
+/**
+ * @brief Creates a host object from a host of a packed hosts list.
+ *
+ * @param[in] packed  Packed hosts list.
+ * @param[in] index   Index of the host.
+ *
+ * @return New host to be freed with gvm_host_free, NULL if error.
+ */
+gvm_host_t *
+gvm_hosts_packed_host (const gvm_hosts_packed_t *packed, size_t index)
+{
+  gvm_host_t *host;
+  const GSList *vhosts;
+
+  if (packed == NULL || index >= packed->count)
+    return NULL;
+
+  host = gvm_host_new ();
+  host->type = packed->types[index];
+  if (host->type == HOST_TYPE_NAME)
+    host->name = g_strdup (gvm_hosts_packed_name (packed, index));
+  else if (host->type == HOST_TYPE_IPV4)
+    host->addr.s_addr = packed->addrs[index].s6_addr32[3];
+  else
+    host->addr6 = packed->addrs[index];
+  vhosts = gvm_hosts_packed_vhosts (packed, index);
+  if (vhosts)
+    host->vhosts =
+      g_slist_copy_deep ((GSList *) vhosts, gvm_duplicate_vhost, NULL);
+  return host;
+}
+
+/**
+ * @brief Compares two hosts of a packed hosts list, given their indexes.
+ *
+ * IP addresses sort by type then by address, before hostnames.
+ */
+static gint
+packed_host_cmp (gconstpointer a, gconstpointer b, gpointer data)
+{
+  const gvm_hosts_packed_t *packed = data;
+  size_t ia = *(const size_t *) a, ib = *(const size_t *) b;
+  int ret;
+
+  if (packed->types[ia] != packed->types[ib])
+    {
+      if (packed->types[ia] == HOST_TYPE_NAME)
+        return 1;
+      if (packed->types[ib] == HOST_TYPE_NAME)
+        return -1;
+      return packed->types[ia] < packed->types[ib] ? -1 : 1;
+    }
+  if (packed->types[ia] == HOST_TYPE_NAME)
+    ret = g_strcmp0 (gvm_hosts_packed_name (packed, ia),
+                     gvm_hosts_packed_name (packed, ib));
+  else
+    ret = memcmp (&packed->addrs[ia], &packed->addrs[ib],
+                  sizeof (struct in6_addr));
+  if (ret == 0)
+    /* Keep the sort stable. */
+    return ia < ib ? -1 : 1;
+  return ret;
+}
+
+/**
+ * @brief Sorts the hosts of a packed hosts list: IPv4 then IPv6 addresses in
+ * ascending order, then hostnames in alphabetical order.
+ *
+ * @param[in] packed  Packed hosts list.
+ */
+void
+gvm_hosts_packed_sort (gvm_hosts_packed_t *packed)
+{
+  struct in6_addr *addrs;
+  guint8 *types;
+  GHashTable *names, *vhosts;
+  size_t *order, i;
+
+  if (packed == NULL || packed->count < 2)
+    return;
+
+  order = g_malloc_n (packed->count, sizeof (*order));
+  for (i = 0; i < packed->count; i++)
+    order[i] = i;
+  g_qsort_with_data (order, packed->count, sizeof (*order), packed_host_cmp,
+                     packed);
+
+  addrs = g_malloc_n (packed->size, sizeof (*addrs));
+  types = g_malloc_n (packed->size, sizeof (*types));
+  names = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
+  vhosts = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+                                  packed_vhosts_free);
+  for (i = 0; i < packed->count; i++)
+    {
+      gpointer old = GUINT_TO_POINTER (order[i]), value;
+
+      addrs[i] = packed->addrs[order[i]];
+      types[i] = packed->types[order[i]];
+      if ((value = g_hash_table_lookup (packed->names, old)))
+        {
+          g_hash_table_steal (packed->names, old);
+          g_hash_table_insert (names, GUINT_TO_POINTER (i), value);
+        }
+      if ((value = g_hash_table_lookup (packed->vhosts, old)))
+        {
+          g_hash_table_steal (packed->vhosts, old);
+          g_hash_table_insert (vhosts, GUINT_TO_POINTER (i), value);
+        }
+    }
+  g_free (order);
+  g_free (packed->addrs);
+  g_free (packed->types);
+  g_hash_table_destroy (packed->names);
+  g_hash_table_destroy (packed->vhosts);
+  packed->addrs = addrs;
+  packed->types = types;
+  packed->names = names;
+  packed->vhosts = vhosts;
+}
+
+/**
+ * @brief Sorts a packed hosts list and removes its duplicate hosts, merging
+ * their vhosts into the kept host.
+ *
+ * @param[in] packed  Packed hosts list.
+ *
+ * @return Number of removed hosts.
+ */
+size_t
+gvm_hosts_packed_deduplicate (gvm_hosts_packed_t *packed)
+{
+  struct vhosts_merge merge = {NULL, NULL, NULL};
+  GSList *merged = NULL;
+  size_t i, kept = 0;
+
+  if (packed == NULL || packed->count < 2)
+    return 0;
+
+  gvm_hosts_packed_sort (packed);
+  for (i = 1; i <= packed->count; i++)
+    {
+      gpointer key = GUINT_TO_POINTER (i), value;
+      int same;
+
+      if (i == packed->count)
+        same = 0;
+      else if (packed->types[i] != packed->types[kept])
+        same = 0;
+      else if (packed->types[i] == HOST_TYPE_NAME)
+        same = !g_strcmp0 (gvm_hosts_packed_name (packed, i),
+                           gvm_hosts_packed_name (packed, kept));
+      else
+        same = !memcmp (&packed->addrs[i], &packed->addrs[kept],
+                        sizeof (struct in6_addr));
+
+      if (same)
+        {
+          g_hash_table_remove (packed->names, key);
+          if ((value = g_hash_table_lookup (packed->vhosts, key)))
+            {
+              g_hash_table_steal (packed->vhosts, key);
+              /* The duplicates follow the kept host: merge their vhosts
+               * into a list of its own until the next kept host. */
+              if (merge.set == NULL)
+                {
+                  merged = g_hash_table_lookup (packed->vhosts,
+                                                GUINT_TO_POINTER (kept));
+                  g_hash_table_steal (packed->vhosts, GUINT_TO_POINTER (kept));
+                  vhosts_merge_init (&merge, &merged, NULL);
+                }
+              vhosts_merge_add (&merge, value);
+            }
+          continue;
+        }
+
+      if (merge.set)
+        {
+          g_hash_table_insert (packed->vhosts, GUINT_TO_POINTER (kept),
+                               merged);
+          vhosts_merge_clear (&merge);
+          merged = NULL;
+        }
+      if (i == packed->count)
+        break;
+
+      /* Move the host down to the next kept slot. */
+      kept++;
+      packed->addrs[kept] = packed->addrs[i];
+      packed->types[kept] = packed->types[i];
+      if (kept == i)
+        continue;
+      if ((value = g_hash_table_lookup (packed->names, key)))
+        {
+          g_hash_table_steal (packed->names, key);
+          g_hash_table_insert (packed->names, GUINT_TO_POINTER (kept), value);
+        }
+      if ((value = g_hash_table_lookup (packed->vhosts, key)))
+        {
+          g_hash_table_steal (packed->vhosts, key);
+          g_hash_table_insert (packed->vhosts, GUINT_TO_POINTER (kept),
+                               value);
+        }
+    }
+
+  i = packed->count - (kept + 1);
+  packed->count = kept + 1;
+  return i;
+}
+
+/**
+ * @brief Hashes a host object by value, ignoring the case of hostnames.
+ *
+ * @param[in] key Host object.
+ *
+ * @return Hash of the host.
+ */
+static guint
+gvm_host_index_hash (gconstpointer key)
+{
+  const gvm_host_t *host = key;
+
+  if (host->type == HOST_TYPE_NAME)
+    {
+      const char *p;
+      guint hash = 5381;
+
+      for (p = host->name; *p; p++)
+        hash = hash * 33 + g_ascii_tolower (*p);
+      return hash;
+    }
+  return gvm_host_key_hash (key);
+}
+
+/**
+ * @brief Compares two host objects by value, ignoring the case of
+ * hostnames.
+ *
+ * @param[in] a First host object.
+ * @param[in] b Second host object.
+ *
+ * @return TRUE if they are equal.
+ */
+static gboolean
+gvm_host_index_equal (gconstpointer a, gconstpointer b)
+{
+  const gvm_host_t *host_a = a, *host_b = b;
+
+  if (host_a->type == HOST_TYPE_NAME && host_b->type == HOST_TYPE_NAME)
+    return g_ascii_strcasecmp (host_a->name, host_b->name) == 0;
+  return gvm_host_key_equal (a, b);
+}
+
+/**
+ * @brief Builds the index of a hosts collection, from host value to the
+ * position + 1 of its first occurrence in the hosts array.
+ *
+ * @param[in] hosts Hosts collection, fully materialized.
+ */
+static void
+gvm_hosts_index_build (gvm_hosts_t *hosts)
+{
+  size_t i;
+
+  hosts->index = g_hash_table_new (gvm_host_index_hash, gvm_host_index_equal);
+  for (i = 0; i < hosts->count; i++)
+    if (!g_hash_table_contains (hosts->index, hosts->hosts[i]))
+      g_hash_table_insert (hosts->index, hosts->hosts[i],
+                           GSIZE_TO_POINTER (i + 1));
+}
+
 /**
  * @brief  Find the gvm_host_t from a gvm_hosts_t structure.
  *
+ * Lookups go through an index of the hosts built on the first call, and
+ * rebuilt after the hosts collection changes.
+ *
  * @param[in] host  The host object.
  * @param[in] addr  Optional pointer to ip address. Could be used so that host
  *                  isn't resolved multiple times when type is HOST_TYPE_NAME.
@@ -2127,43 +4442,44 @@ gvm_host_t *
 gvm_host_find_in_hosts (const gvm_host_t *host, const struct in6_addr *addr,
                         const gvm_hosts_t *hosts)
 {
-  char *host_str;
-  size_t i;
+  gpointer found, position = NULL;
 
   if (host == NULL || hosts == NULL)
     return NULL;
 
-  host_str = gvm_host_value_str (host);
-
-  for (i = 0; i < hosts->count; i++)
-    {
-      gvm_host_t *current_host = hosts->hosts[i];
-      char *tmp = gvm_host_value_str (current_host);
+  /* The returned host must be part of the hosts array. */
+  gvm_hosts_expand ((gvm_hosts_t *) hosts);
+  if (hosts->index == NULL)
+    gvm_hosts_index_build ((gvm_hosts_t *) hosts);
 
-      if (strcasecmp (host_str, tmp) == 0)
-        {
-          g_free (host_str);
-          g_free (tmp);
-          return current_host;
-        }
-      g_free (tmp);
+  if (host->type == HOST_TYPE_NAME || host->type == HOST_TYPE_IPV4
+      || host->type == HOST_TYPE_IPV6)
+    position = g_hash_table_lookup (hosts->index, host);
 
-      /* Hostnames in hosts list shouldn't be resolved. */
-      if (addr && gvm_host_type (current_host) != HOST_TYPE_NAME)
+  /* Hostnames in hosts list shouldn't be resolved. */
+  if (addr)
+    {
+      gvm_host_t probe = {0};
+
+      probe.type = HOST_TYPE_IPV6;
+      memcpy (&probe.addr6, addr, sizeof (probe.addr6));
+      found = g_hash_table_lookup (hosts->index, &probe);
+      if (found && (!position || found < position))
+        position = found;
+      if (IN6_IS_ADDR_V4MAPPED (addr))
         {
-          struct in6_addr tmpaddr;
-          gvm_host_get_addr6 (current_host, &tmpaddr);
-
-          if (memcmp (addr->s6_addr, &tmpaddr.s6_addr, 16) == 0)
-            {
-              g_free (host_str);
-              return current_host;
-            }
+          probe.type = HOST_TYPE_IPV4;
+          memcpy (&probe.addr, &addr->s6_addr32[3], sizeof (probe.addr));
+          found = g_hash_table_lookup (hosts->index, &probe);
+          if (found && (!position || found < position))
+            position = found;
         }
     }
 
-  g_free (host_str);
-  return NULL;
+  if (position == NULL)
+    return NULL;
+  /* The first matching host, as the index keeps the first occurrences. */
+  return hosts->hosts[GPOINTER_TO_SIZE (position) - 1];
 }
 
 /**
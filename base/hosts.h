@@ -48,6 +48,7 @@ enum host_type
 typedef struct gvm_host gvm_host_t;
 typedef struct gvm_vhost gvm_vhost_t;
 typedef struct gvm_hosts gvm_hosts_t;
+typedef struct gvm_hosts_packed gvm_hosts_packed_t;
 
 /* Data structures. */
 
@@ -67,6 +68,8 @@ struct gvm_host
   };
   enum host_type type; /**< HOST_TYPE_NAME, HOST_TYPE_IPV4 or HOST_TYPE_IPV6. */
   GSList *vhosts;      /**< List of hostnames/vhosts attached to this host. */
+  GHashTable *vhosts_set; /**< Optional index of the vhosts by value, or
+                               NULL.  See gvm_host_index_vhosts. */
 };
 
 /**
@@ -93,6 +96,15 @@ struct gvm_hosts
   size_t count;       /**< Number of single host objects in hosts list. */
   size_t removed;     /**< Number of duplicate/excluded values. */
   size_t duplicated;  /**< Number of duplicated values. */
+  GArray *spans;      /**< Address ranges not yet materialized as hosts. */
+  size_t span;        /**< Index of the first pending span. */
+  size_t span_hosts;  /**< Number of hosts in the pending spans. */
+  GHashTable *index;  /**< Lazily built index of the hosts, or NULL. */
+  guint32 perm_keys[4]; /**< Round keys of the shuffling permutation. */
+  guint64 perm_next;    /**< Next index to permute, when shuffled. */
+  guint64 perm_total;   /**< Number of hosts in the permutation. */
+  int perm_bits;        /**< Half width of the permutation domain, 0 if the
+                             pending spans aren't shuffled. */
 };
 
 /* Function prototypes. */
@@ -126,6 +138,18 @@ gvm_hosts_add (gvm_hosts_t *, gvm_host_t *);
 GSList *
 gvm_hosts_resolve (gvm_hosts_t *);
 
+void
+gvm_hosts_resolve_set_concurrency (unsigned int, unsigned int);
+
+void
+gvm_hosts_set_parse_threads (unsigned int);
+
+void
+gvm_hosts_reverse_lookup_cache_clear (void);
+
+void
+gvm_hosts_set_resolve_func (GSList *(*) (const char *));
+
 int
 gvm_hosts_exclude (gvm_hosts_t *, const char *);
 
@@ -156,12 +180,46 @@ gvm_hosts_reverse_lookup_unify_excluded (gvm_hosts_t *);
 unsigned int
 gvm_hosts_count (const gvm_hosts_t *);
 
+int
+gvm_hosts_count_str (const gchar *, guint64 *);
+
 unsigned int
 gvm_hosts_removed (const gvm_hosts_t *);
 
 unsigned int
 gvm_hosts_duplicated (const gvm_hosts_t *);
 
+gvm_hosts_packed_t *
+gvm_hosts_pack (const gvm_hosts_t *);
+
+void
+gvm_hosts_packed_free (gvm_hosts_packed_t *);
+
+size_t
+gvm_hosts_packed_count (const gvm_hosts_packed_t *);
+
+int
+gvm_hosts_packed_type (const gvm_hosts_packed_t *, size_t);
+
+int
+gvm_hosts_packed_get_addr6 (const gvm_hosts_packed_t *, size_t,
+                            struct in6_addr *);
+
+const gchar *
+gvm_hosts_packed_name (const gvm_hosts_packed_t *, size_t);
+
+const GSList *
+gvm_hosts_packed_vhosts (const gvm_hosts_packed_t *, size_t);
+
+gvm_host_t *
+gvm_hosts_packed_host (const gvm_hosts_packed_t *, size_t);
+
+void
+gvm_hosts_packed_sort (gvm_hosts_packed_t *);
+
+size_t
+gvm_hosts_packed_deduplicate (gvm_hosts_packed_t *);
+
 /* gvm_host_t related */
 
 gvm_host_t *
@@ -193,6 +251,21 @@ gvm_host_get_addr6 (const gvm_host_t *, struct in6_addr *);
 void
 gvm_host_add_reverse_lookup (gvm_host_t *);
 
+void
+gvm_host_index_vhosts (gvm_host_t *);
+
+int
+gvm_host_add_vhost (gvm_host_t *, char *, char *);
+
+gvm_vhost_t *
+gvm_host_find_vhost (const gvm_host_t *, const char *);
+
+const GSList *
+gvm_host_vhosts (const gvm_host_t *);
+
+unsigned int
+gvm_host_merge_vhosts (gvm_host_t *, gvm_host_t *);
+
 void gvm_host_free (gpointer);
 
 gpointer gvm_duplicate_vhost (gconstpointer, gpointer);
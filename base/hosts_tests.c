@@ -270,6 +270,473 @@ Ensure (hosts, gvm_hosts_allowed_only)
   gvm_hosts_free (hosts);
 }
 
+Ensure (hosts, gvm_hosts_ranges_are_materialized_lazily)
+{
+  gvm_hosts_t *hosts;
+  gvm_host_t *host;
+  gchar *value;
+
+  hosts = gvm_hosts_new ("10.0.0.0/12");
+  assert_that (gvm_hosts_count (hosts), is_equal_to (1048574));
+  assert_that (hosts->count, is_equal_to (0));
+  gvm_hosts_free (hosts);
+
+  hosts = gvm_hosts_new ("192.168.0.1-10, 192.168.0.5-15");
+  assert_that (gvm_hosts_count (hosts), is_equal_to (15));
+  assert_that (gvm_hosts_duplicated (hosts), is_equal_to (5));
+  assert_that (gvm_hosts_exclude (hosts, "192.168.0.3-4"), is_equal_to (2));
+  assert_that (gvm_hosts_count (hosts), is_equal_to (13));
+  assert_that (hosts->count, is_equal_to (0));
+
+  host = gvm_hosts_next (hosts);
+  value = gvm_host_value_str (host);
+  assert_that (value, is_equal_to_string ("192.168.0.1"));
+  g_free (value);
+  host = gvm_hosts_next (hosts);
+  host = gvm_hosts_next (hosts);
+  value = gvm_host_value_str (host);
+  assert_that (value, is_equal_to_string ("192.168.0.5"));
+  g_free (value);
+  assert_that (hosts->count, is_equal_to (3));
+  gvm_hosts_free (hosts);
+
+  hosts = gvm_hosts_new ("192.168.0.1-3");
+  gvm_hosts_reverse (hosts);
+  host = gvm_hosts_next (hosts);
+  value = gvm_host_value_str (host);
+  assert_that (value, is_equal_to_string ("192.168.0.3"));
+  g_free (value);
+  gvm_hosts_free (hosts);
+}
+
+Ensure (hosts, gvm_hosts_pack_sorts_and_deduplicates)
+{
+  gvm_hosts_t *hosts;
+  gvm_hosts_packed_t *packed;
+  gvm_host_t *host;
+  struct in6_addr ip6;
+  gchar *value;
+
+  hosts = gvm_hosts_new ("192.168.0.3, example.org, 192.168.0.1-2");
+  gvm_hosts_add (hosts, gvm_host_from_str ("192.168.0.2"));
+  packed = gvm_hosts_pack (hosts);
+  assert_that (gvm_hosts_packed_count (packed), is_equal_to (5));
+  assert_that (gvm_hosts_packed_type (packed, 1), is_equal_to (HOST_TYPE_NAME));
+  assert_that (gvm_hosts_packed_name (packed, 1),
+               is_equal_to_string ("example.org"));
+  assert_that (gvm_hosts_packed_get_addr6 (packed, 1, &ip6), is_equal_to (-1));
+
+  assert_that (gvm_hosts_packed_deduplicate (packed), is_equal_to (1));
+  assert_that (gvm_hosts_packed_count (packed), is_equal_to (4));
+  host = gvm_hosts_packed_host (packed, 0);
+  value = gvm_host_value_str (host);
+  assert_that (value, is_equal_to_string ("192.168.0.1"));
+  g_free (value);
+  gvm_host_free (host);
+  assert_that (gvm_hosts_packed_type (packed, 3), is_equal_to (HOST_TYPE_NAME));
+
+  gvm_hosts_packed_free (packed);
+  gvm_hosts_free (hosts);
+}
+
+Ensure (hosts, gvm_hosts_exclude_matches_intervals_and_names)
+{
+  gvm_hosts_t *hosts;
+  GSList *removed;
+
+  hosts = gvm_hosts_new ("192.168.0.1-5, example.org, ::1");
+  /* Materializes the hosts. */
+  gvm_hosts_add (hosts, gvm_host_from_str ("10.0.0.1"));
+  assert_that (gvm_hosts_count (hosts), is_equal_to (8));
+
+  assert_that (gvm_hosts_exclude (hosts, "192.168.0.2-3, example.org, ::1"),
+               is_equal_to (4));
+  assert_that (gvm_hosts_count (hosts), is_equal_to (4));
+
+  removed = gvm_hosts_allowed_only (hosts, "192.168.0.5", "192.168.0.0/24");
+  assert_that (g_slist_length (removed), is_equal_to (2));
+  assert_that (gvm_hosts_count (hosts), is_equal_to (2));
+  g_slist_free_full (removed, g_free);
+  gvm_hosts_free (hosts);
+}
+
+Ensure (hosts, gvm_hosts_new_parses_large_lists_in_parallel)
+{
+  gvm_hosts_t *hosts;
+  gvm_host_t *host;
+  GString *str;
+  gchar *value;
+  int i;
+
+  str = g_string_new (" example.org,\n");
+  for (i = 0; i < 40000; i++)
+    g_string_append_printf (str, "10.%d.%d.%d , ", i >> 16, (i >> 8) & 255,
+                            i & 255);
+  g_string_append (str, "10.0.0.1\n192.168.0.1-4");
+
+  gvm_hosts_set_parse_threads (4);
+  hosts = gvm_hosts_new (str->str);
+  assert_that (hosts, is_not_null);
+  /* The duplicate 10.0.0.1 is removed. */
+  assert_that (gvm_hosts_count (hosts), is_equal_to (1 + 40000 + 4));
+  host = gvm_hosts_next (hosts);
+  assert_that (gvm_host_type (host), is_equal_to (HOST_TYPE_NAME));
+  value = gvm_host_value_str (gvm_hosts_next (hosts));
+  assert_that (value, is_equal_to_string ("10.0.0.0"));
+  g_free (value);
+  gvm_hosts_free (hosts);
+
+  assert_that (gvm_hosts_new_with_max (str->str, 40000), is_null);
+  g_string_append (str, ",10.0.0.256.1");
+  assert_that (gvm_hosts_new (str->str), is_null);
+  gvm_hosts_set_parse_threads (1);
+  assert_that (gvm_hosts_new (str->str), is_null);
+
+  g_string_free (str, TRUE);
+}
+
+Ensure (hosts, gvm_host_vhosts_are_deduplicated)
+{
+  gvm_host_t *host, *other;
+  const GSList *vhosts;
+
+  host = gvm_host_from_str ("192.168.0.1");
+  other = gvm_host_from_str ("192.168.0.1");
+  assert_that (gvm_host_add_vhost (host, g_strdup ("a.example.org"),
+                                   g_strdup ("Forward-DNS")),
+               is_equal_to (0));
+  gvm_host_index_vhosts (host);
+  assert_that (gvm_host_add_vhost (host, g_strdup ("A.Example.org"),
+                                   g_strdup ("Reverse-DNS")),
+               is_equal_to (1));
+  assert_that (gvm_host_add_vhost (host, g_strdup ("b.example.org"),
+                                   g_strdup ("Forward-DNS")),
+               is_equal_to (0));
+
+  gvm_host_add_vhost (other, g_strdup ("c.example.org"), g_strdup ("TLS"));
+  gvm_host_add_vhost (other, g_strdup ("B.example.org"), g_strdup ("TLS"));
+  assert_that (gvm_host_merge_vhosts (host, other), is_equal_to (1));
+  assert_that (gvm_host_vhosts (other), is_null);
+
+  /* Most recently added first, then the merged ones. */
+  vhosts = gvm_host_vhosts (host);
+  assert_that (g_slist_length ((GSList *) vhosts), is_equal_to (3));
+  assert_that (((gvm_vhost_t *) vhosts->data)->value,
+               is_equal_to_string ("b.example.org"));
+  assert_that (((gvm_vhost_t *) vhosts->next->next->data)->value,
+               is_equal_to_string ("c.example.org"));
+  assert_that (gvm_host_find_vhost (host, "C.EXAMPLE.ORG"), is_not_null);
+
+  assert_that (gvm_vhosts_exclude (host, "c.example.org, A.example.org"),
+               is_equal_to (2));
+  assert_that (gvm_host_find_vhost (host, "c.example.org"), is_null);
+  assert_that (gvm_host_find_vhost (host, "b.example.org"), is_not_null);
+  assert_that (g_slist_length ((GSList *) gvm_host_vhosts (host)),
+               is_equal_to (1));
+
+  gvm_host_free (other);
+  gvm_host_free (host);
+}
+
+Ensure (hosts, gvm_host_find_in_hosts_uses_index)
+{
+  gvm_hosts_t *hosts;
+  gvm_host_t *host, *found;
+  struct in6_addr addr6;
+
+  hosts = gvm_hosts_new ("192.168.0.1-20, Example.org");
+  host = gvm_host_from_str ("192.168.0.7");
+  found = gvm_host_find_in_hosts (host, NULL, hosts);
+  assert_that (found, is_equal_to (hosts->hosts[6]));
+  gvm_host_get_addr6 (host, &addr6);
+  gvm_host_free (host);
+
+  host = gvm_host_from_str ("example.org");
+  assert_that (gvm_host_find_in_hosts (host, &addr6, hosts),
+               is_equal_to (found));
+  gvm_host_free (host);
+
+  host = gvm_host_from_str ("192.168.0.21");
+  assert_that (gvm_host_in_hosts (host, NULL, hosts), is_equal_to (0));
+  gvm_hosts_add (hosts, gvm_host_from_str ("192.168.0.21"));
+  assert_that (gvm_host_in_hosts (host, NULL, hosts), is_equal_to (1));
+  gvm_host_free (host);
+  gvm_hosts_free (hosts);
+}
+
+Ensure (hosts, gvm_hosts_shuffle_permutes_ranges_lazily)
+{
+  gvm_hosts_t *hosts;
+  gvm_host_t *host;
+  GHashTable *seen;
+
+  hosts = gvm_hosts_new ("192.168.0.0/24, 10.0.0.1-10, example.org");
+  gvm_hosts_shuffle (hosts);
+  assert_that (hosts->count, is_equal_to (0));
+  assert_that (gvm_hosts_count (hosts), is_equal_to (265));
+
+  seen = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  while ((host = gvm_hosts_next (hosts)))
+    g_hash_table_add (seen, gvm_host_value_str (host));
+  assert_that (g_hash_table_size (seen), is_equal_to (265));
+  assert_that (g_hash_table_contains (seen, "example.org"), is_true);
+  assert_that (g_hash_table_contains (seen, "10.0.0.10"), is_true);
+  assert_that (gvm_hosts_count (hosts), is_equal_to (265));
+
+  g_hash_table_destroy (seen);
+  gvm_hosts_free (hosts);
+}
+
+/**
+ * @brief Get the values of the materialized hosts of a collection.
+ *
+ * @param[in] hosts Hosts collection.
+ *
+ * @return Values separated by commas, to be freed with g_free.
+ */
+static gchar *
+hosts_values (gvm_hosts_t *hosts)
+{
+  GString *str = g_string_new ("");
+
+  for (size_t i = 0; i < hosts->count; i++)
+    {
+      gchar *value = gvm_host_value_str (hosts->hosts[i]);
+
+      g_string_append_printf (str, "%s%s", i ? "," : "", value);
+      g_free (value);
+    }
+  return g_string_free (str, FALSE);
+}
+
+Ensure (hosts, gvm_hosts_deduplicate_merges_addresses_and_names)
+{
+  gvm_hosts_t *hosts;
+  gvm_host_t *host;
+  gchar *values;
+
+  hosts = gvm_hosts_new ("192.168.0.1, 2001:db8::1, example.org");
+  host = gvm_host_from_str ("2001:db8::1");
+  gvm_host_add_vhost (host, g_strdup ("v6.example.org"), g_strdup ("TLS"));
+  gvm_hosts_add (hosts, host);
+  gvm_hosts_add (hosts, gvm_host_from_str ("192.168.0.1"));
+  gvm_hosts_add (hosts, gvm_host_from_str ("example.org"));
+  gvm_hosts_add (hosts, gvm_host_from_str ("2001:db8::2"));
+  gvm_hosts_add (hosts, gvm_host_from_str ("192.168.0.2"));
+  gvm_hosts_add (hosts, gvm_host_from_str ("example.com"));
+  gvm_hosts_add (hosts, gvm_host_from_str ("2001:db8::1"));
+
+  gvm_hosts_deduplicate (hosts);
+  values = hosts_values (hosts);
+  assert_that (values, is_equal_to_string ("192.168.0.1,2001:db8::1,"
+                                           "example.org,2001:db8::2,"
+                                           "192.168.0.2,example.com"));
+  g_free (values);
+  assert_that (gvm_hosts_count (hosts), is_equal_to (6));
+  assert_that (gvm_hosts_duplicated (hosts), is_equal_to (4));
+  /* The vhosts of a duplicate go to the host kept. */
+  assert_that (gvm_host_find_vhost (hosts->hosts[1], "v6.example.org"),
+               is_not_null);
+  gvm_hosts_free (hosts);
+}
+
+Ensure (hosts, gvm_hosts_deduplicate_fills_gaps_at_edges)
+{
+  gvm_hosts_t *hosts;
+  gchar *values;
+
+  /* Duplicates right after the first host and at the end. */
+  hosts = gvm_hosts_new ("192.168.0.1");
+  gvm_hosts_add (hosts, gvm_host_from_str ("192.168.0.1"));
+  gvm_hosts_add (hosts, gvm_host_from_str ("192.168.0.1"));
+  gvm_hosts_add (hosts, gvm_host_from_str ("192.168.0.2"));
+  gvm_hosts_add (hosts, gvm_host_from_str ("192.168.0.3"));
+  gvm_hosts_add (hosts, gvm_host_from_str ("192.168.0.3"));
+  gvm_hosts_deduplicate (hosts);
+  values = hosts_values (hosts);
+  assert_that (values,
+               is_equal_to_string ("192.168.0.1,192.168.0.2,192.168.0.3"));
+  g_free (values);
+  for (size_t i = hosts->count; i < 6; i++)
+    assert_that (hosts->hosts[i], is_null);
+  gvm_hosts_free (hosts);
+
+  /* Only duplicates after the first host. */
+  hosts = gvm_hosts_new ("2001:db8::1");
+  for (int i = 0; i < 3; i++)
+    gvm_hosts_add (hosts, gvm_host_from_str ("2001:db8::1"));
+  gvm_hosts_deduplicate (hosts);
+  assert_that (hosts->count, is_equal_to (1));
+  for (size_t i = 1; i < 4; i++)
+    assert_that (hosts->hosts[i], is_null);
+  assert_that (gvm_hosts_next (hosts), is_not_null);
+  assert_that (gvm_hosts_next (hosts), is_null);
+  gvm_hosts_free (hosts);
+}
+
+/**
+ * @brief Resolver of the tests, without DNS.
+ *
+ * @param[in] name Hostname.
+ *
+ * @return List of struct in6_addr.
+ */
+static GSList *
+fake_resolve_list (const char *name)
+{
+  const char *addrs[2] = {NULL, NULL};
+  GSList *list = NULL;
+
+  if (!strcmp (name, "a.example"))
+    addrs[0] = "::ffff:192.0.2.2";
+  else if (!strcmp (name, "b.example"))
+    {
+      addrs[0] = "::ffff:192.0.2.2";
+      addrs[1] = "2001:db8::1";
+    }
+  for (int i = 0; i < 2 && addrs[i]; i++)
+    {
+      struct in6_addr *addr = g_malloc0 (sizeof (*addr));
+
+      inet_pton (AF_INET6, addrs[i], addr);
+      list = g_slist_append (list, addr);
+    }
+  return list;
+}
+
+Ensure (hosts, gvm_hosts_resolve_keeps_order_when_concurrent)
+{
+  unsigned int threads[] = {0, 4};
+
+  gvm_hosts_set_resolve_func (fake_resolve_list);
+  for (size_t i = 0; i < G_N_ELEMENTS (threads); i++)
+    {
+      gvm_hosts_t *hosts;
+      GSList *unresolved;
+      gchar *values;
+
+      gvm_hosts_resolve_set_concurrency (threads[i], 5);
+      hosts = gvm_hosts_new (
+        "192.0.2.1-192.0.2.3, a.example, unknown.example, b.example");
+      assert_that (gvm_hosts_count (hosts), is_equal_to (6));
+
+      unresolved = gvm_hosts_resolve (hosts);
+      assert_that (g_slist_length (unresolved), is_equal_to (1));
+      assert_that (unresolved->data, is_equal_to_string ("unknown.example"));
+      g_slist_free_full (unresolved, g_free);
+
+      values = hosts_values (hosts);
+      assert_that (values, is_equal_to_string ("192.0.2.1,192.0.2.2,"
+                                               "192.0.2.3,2001:db8::1"));
+      g_free (values);
+      assert_that (gvm_hosts_count (hosts), is_equal_to (4));
+      assert_that (gvm_hosts_removed (hosts), is_equal_to (3));
+      /* The Forward-DNS vhosts of the duplicates are kept. */
+      assert_that (gvm_host_find_vhost (hosts->hosts[1], "a.example"),
+                   is_not_null);
+      assert_that (gvm_host_find_vhost (hosts->hosts[1], "b.example"),
+                   is_not_null);
+      assert_that (gvm_host_find_vhost (hosts->hosts[3], "b.example"),
+                   is_not_null);
+      gvm_hosts_free (hosts);
+    }
+  gvm_hosts_resolve_set_concurrency (0, 0);
+  gvm_hosts_set_resolve_func (NULL);
+}
+
+Ensure (hosts, gvm_hosts_resolve_leaves_ranges_lazy)
+{
+  gvm_hosts_t *hosts;
+
+  gvm_hosts_set_resolve_func (fake_resolve_list);
+  gvm_hosts_resolve_set_concurrency (4, 0);
+  hosts = gvm_hosts_new ("192.0.2.0/24, 2001:db8::1-2001:db8::ff");
+  assert_that (gvm_hosts_resolve (hosts), is_null);
+  assert_that (hosts->count, is_equal_to (0));
+  assert_that (gvm_hosts_count (hosts), is_equal_to (254 + 255));
+  assert_that (gvm_hosts_removed (hosts), is_equal_to (0));
+  gvm_hosts_free (hosts);
+  gvm_hosts_resolve_set_concurrency (0, 0);
+  gvm_hosts_set_resolve_func (NULL);
+}
+
+/**
+ * @brief Put the result of a reverse lookup in the cache, to avoid DNS.
+ *
+ * @param[in] addr_str Address.
+ * @param[in] name     Hostname, "" for none.
+ */
+static void
+cache_reverse_lookup (const char *addr_str, const char *name)
+{
+  gvm_host_t *host = gvm_host_from_str (addr_str);
+  struct in6_addr *key = g_malloc0 (sizeof (*key));
+
+  gvm_host_get_addr6 (host, key);
+  if (reverse_lookup_cache == NULL)
+    reverse_lookup_cache =
+      g_hash_table_new_full (in6_addr_hash, in6_addr_equal, g_free, g_free);
+  g_hash_table_replace (reverse_lookup_cache, key, g_strdup (name));
+  gvm_host_free (host);
+}
+
+Ensure (hosts, gvm_hosts_reverse_lookup_filters_keep_order)
+{
+  unsigned int threads[] = {0, 4};
+
+  for (size_t i = 0; i < G_N_ELEMENTS (threads); i++)
+    {
+      gvm_hosts_t *hosts, *excluded;
+      gchar *values;
+
+      cache_reverse_lookup ("192.0.2.1", "a.example");
+      cache_reverse_lookup ("192.0.2.2", "a.example");
+      cache_reverse_lookup ("192.0.2.3", "b.example");
+      cache_reverse_lookup ("192.0.2.4", "");
+      gvm_hosts_resolve_set_concurrency (threads[i], 5);
+
+      hosts = gvm_hosts_new ("192.0.2.1-192.0.2.4");
+      assert_that (gvm_hosts_count (hosts), is_equal_to (4));
+      assert_that (gvm_hosts_reverse_lookup_unify (hosts), is_equal_to (1));
+      values = hosts_values (hosts);
+      assert_that (values,
+                   is_equal_to_string ("192.0.2.1,192.0.2.3,192.0.2.4"));
+      g_free (values);
+      assert_that (gvm_hosts_count (hosts), is_equal_to (3));
+
+      excluded = gvm_hosts_reverse_lookup_only_excluded (hosts);
+      values = hosts_values (excluded);
+      assert_that (values, is_equal_to_string ("192.0.2.4"));
+      g_free (values);
+      gvm_hosts_free (excluded);
+      values = hosts_values (hosts);
+      assert_that (values, is_equal_to_string ("192.0.2.1,192.0.2.3"));
+      g_free (values);
+      assert_that (gvm_hosts_count (hosts), is_equal_to (2));
+      assert_that (gvm_hosts_removed (hosts), is_equal_to (2));
+      gvm_hosts_free (hosts);
+
+      gvm_hosts_reverse_lookup_cache_clear ();
+      assert_that (reverse_lookup_cache, is_null);
+    }
+  gvm_hosts_resolve_set_concurrency (0, 0);
+}
+
+Ensure (hosts, gvm_hosts_count_str_counts_ranges)
+{
+  guint64 count = 0;
+
+  assert_that (gvm_hosts_count_str ("192.168.0.0/24, 192.168.0.1-10, "
+                                    "2001:db8::/120, example.org",
+                                    &count),
+               is_equal_to (0));
+  assert_that (count, is_equal_to (509));
+  assert_that (gvm_hosts_count_str ("2001:db8::/64", &count), is_equal_to (0));
+  assert_that (count == G_GUINT64_CONSTANT (18446744073709551614), is_true);
+  assert_that (gvm_hosts_count_str ("a.123", &count), is_equal_to (-1));
+  assert_that (gvm_hosts_new_with_max ("10.0.0.0/8", 1000), is_null);
+}
+
 /* Test suite. */
 
 int
@@ -305,6 +772,27 @@ main (int argc, char **argv)
 
   add_test_with_context (suite, hosts, gvm_hosts_move_host_to_end);
   add_test_with_context (suite, hosts, gvm_hosts_allowed_only);
+  add_test_with_context (suite, hosts,
+                         gvm_hosts_ranges_are_materialized_lazily);
+  add_test_with_context (suite, hosts, gvm_hosts_pack_sorts_and_deduplicates);
+  add_test_with_context (suite, hosts,
+                         gvm_hosts_exclude_matches_intervals_and_names);
+  add_test_with_context (suite, hosts,
+                         gvm_hosts_new_parses_large_lists_in_parallel);
+  add_test_with_context (suite, hosts, gvm_host_vhosts_are_deduplicated);
+  add_test_with_context (suite, hosts, gvm_host_find_in_hosts_uses_index);
+  add_test_with_context (suite, hosts,
+                         gvm_hosts_shuffle_permutes_ranges_lazily);
+  add_test_with_context (suite, hosts, gvm_hosts_count_str_counts_ranges);
+  add_test_with_context (suite, hosts,
+                         gvm_hosts_deduplicate_merges_addresses_and_names);
+  add_test_with_context (suite, hosts,
+                         gvm_hosts_deduplicate_fills_gaps_at_edges);
+  add_test_with_context (suite, hosts,
+                         gvm_hosts_resolve_keeps_order_when_concurrent);
+  add_test_with_context (suite, hosts, gvm_hosts_resolve_leaves_ranges_lazy);
+  add_test_with_context (suite, hosts,
+                         gvm_hosts_reverse_lookup_filters_keep_order);
 
   if (argc > 1)
     return run_single_test (suite, argv[1], create_text_reporter ());
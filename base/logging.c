@@ -49,6 +49,7 @@ typedef struct
   GIOChannel *log_channel;       ///< Gio Channel - FD holder for logfile.
   gchar *syslog_facility;        ///< Syslog facility to use for syslog logging.
   gchar *syslog_ident;           ///< Syslog ident to use for syslog logging.
+  gchar *log_format;             ///< Output format, "text" or "json".
   gchar *prepend_separator; ///< If prependstring has %s, used this symbol as
                             ///< separator.
 } gvm_logging_t;
@@ -135,6 +136,519 @@ facility_int_from_string (const gchar *facility)
   return LOG_LOCAL0;
 }
 
+/**
+ * @brief Settings of a log domain, resolved from the log configuration.
+ */
+typedef struct
+{
+  gchar *prepend_template;         ///< Conversions of the prepend string.
+  const gchar *time_format;        ///< Format for strftime, for %t.
+  const gchar *log_separator;      ///< Separator, for %s.
+  const gchar *log_file;           ///< Where to log to.
+  GLogLevelFlags default_level;    ///< Least severe level logged.
+  const gchar *syslog_facility;    ///< Syslog facility.
+  const gchar *syslog_ident;       ///< Syslog ident.
+  gvm_logging_t *log_domain_entry; ///< Entry holding the channel, or NULL.
+  gboolean json;                   ///< Whether to output JSON lines.
+} log_settings_t;
+
+/**
+ * @brief Parse a prepend string into a template.
+ *
+ * Only the conversions of the prepend string are output, so the template
+ * is the letters of the conversions, in order.
+ *
+ * @param prepend_format  Prepend string, with %t, %s and %p.
+ *
+ * @return Template, free with g_free.
+ */
+static gchar *
+log_prepend_template (const gchar *prepend_format)
+{
+  GString *template = g_string_new ("");
+  const gchar *tmp = prepend_format;
+
+  while (*tmp != '\0')
+    {
+      if (*tmp == '%' && (tmp[1] == 'p' || tmp[1] == 't' || tmp[1] == 's'))
+        {
+          g_string_append_c (template, tmp[1]);
+          tmp += 2;
+        }
+      else
+        tmp++;
+    }
+  return g_string_free (template, FALSE);
+}
+
+/**
+ * @brief Set log settings to the defaults.
+ *
+ * @param settings  Settings.
+ */
+static void
+log_settings_defaults (log_settings_t *settings)
+{
+  settings->prepend_template = NULL;
+  settings->time_format = "%Y-%m-%d %Hh%M.%S %Z";
+  settings->log_separator = ":";
+  settings->log_file = "-";
+  settings->default_level = G_LOG_LEVEL_DEBUG;
+  settings->syslog_facility = "local0";
+  settings->syslog_ident = NULL;
+  settings->log_domain_entry = NULL;
+  settings->json = FALSE;
+}
+
+/**
+ * @brief Apply the group '*' of a log configuration to log settings.
+ *
+ * @param gvm_log_config_list  Log configuration.
+ * @param settings             Settings.
+ * @param prepend_format       Prepend string, updated.
+ */
+static void
+log_settings_apply_default_group (GSList *gvm_log_config_list,
+                                  log_settings_t *settings,
+                                  const gchar **prepend_format)
+{
+  GSList *log_domain_list_tmp;
+
+  for (log_domain_list_tmp = gvm_log_config_list; log_domain_list_tmp;
+       log_domain_list_tmp = g_slist_next (log_domain_list_tmp))
+    {
+      gvm_logging_t *log_domain_entry = log_domain_list_tmp->data;
+
+      /* Override defaults if the current linklist group name is '*'. */
+      if (g_ascii_strcasecmp (log_domain_entry->log_domain, "*") == 0)
+        {
+          settings->log_domain_entry = log_domain_entry;
+
+          /* Override defaults if the group items are not null. */
+          if (log_domain_entry->prepend_string)
+            *prepend_format = log_domain_entry->prepend_string;
+          if (log_domain_entry->prepend_time_format)
+            settings->time_format = log_domain_entry->prepend_time_format;
+          if (log_domain_entry->log_file)
+            settings->log_file = log_domain_entry->log_file;
+          if (log_domain_entry->default_level)
+            settings->default_level = *log_domain_entry->default_level;
+          if (log_domain_entry->syslog_facility)
+            settings->syslog_facility = log_domain_entry->syslog_facility;
+          if (log_domain_entry->prepend_separator)
+            settings->log_separator = log_domain_entry->prepend_separator;
+          if (log_domain_entry->log_format)
+            settings->json =
+              g_ascii_strcasecmp (log_domain_entry->log_format, "json") == 0;
+          return;
+        }
+    }
+}
+
+/**
+ * @brief Apply the group of a log domain to log settings.
+ *
+ * @param log_domain_entry  Group of the log domain.
+ * @param settings          Settings.
+ * @param prepend_format    Prepend string, updated.
+ */
+static void
+log_settings_apply_group (gvm_logging_t *log_domain_entry,
+                          log_settings_t *settings,
+                          const gchar **prepend_format)
+{
+  settings->log_domain_entry = log_domain_entry;
+  if (log_domain_entry->prepend_string)
+    *prepend_format = log_domain_entry->prepend_string;
+  settings->time_format = log_domain_entry->prepend_time_format;
+  settings->log_file = log_domain_entry->log_file;
+  if (log_domain_entry->default_level)
+    settings->default_level = *log_domain_entry->default_level;
+  settings->syslog_facility = log_domain_entry->syslog_facility;
+  settings->syslog_ident = log_domain_entry->syslog_ident;
+  if (log_domain_entry->prepend_separator)
+    settings->log_separator = log_domain_entry->prepend_separator;
+  if (log_domain_entry->log_format)
+    settings->json =
+      g_ascii_strcasecmp (log_domain_entry->log_format, "json") == 0;
+}
+
+/**
+ * @brief Resolve the settings of a log domain from a log configuration.
+ *
+ * The group '*' overrides the defaults, and the group of the domain
+ * overrides both.
+ *
+ * @param gvm_log_config_list  Log configuration.
+ * @param log_domain           Log domain, NULL for the defaults.
+ * @param settings             Settings.  Free the template with g_free.
+ */
+static void
+log_settings_resolve (GSList *gvm_log_config_list, const char *log_domain,
+                      log_settings_t *settings)
+{
+  const gchar *prepend_format = "%t %s %p - ";
+  GSList *log_domain_list_tmp;
+
+  log_settings_defaults (settings);
+  if (gvm_log_config_list != NULL && log_domain != NULL)
+    {
+      log_settings_apply_default_group (gvm_log_config_list, settings,
+                                        &prepend_format);
+      for (log_domain_list_tmp = gvm_log_config_list; log_domain_list_tmp;
+           log_domain_list_tmp = g_slist_next (log_domain_list_tmp))
+        {
+          gvm_logging_t *log_domain_entry = log_domain_list_tmp->data;
+
+          /* Search for the log domain in the link list. */
+          if (g_ascii_strcasecmp (log_domain_entry->log_domain, log_domain)
+              == 0)
+            {
+              log_settings_apply_group (log_domain_entry, settings,
+                                        &prepend_format);
+              break;
+            }
+        }
+    }
+  settings->prepend_template = log_prepend_template (prepend_format);
+}
+
+/**
+ * @brief Free log settings.
+ *
+ * @param settings  Settings.
+ */
+static void
+log_settings_free (gpointer settings)
+{
+  if (settings == NULL)
+    return;
+  g_free (((log_settings_t *) settings)->prepend_template);
+  g_free (settings);
+}
+
+/**
+ * @brief Hash a log domain, ignoring case.
+ *
+ * @param key  Log domain.
+ *
+ * @return Hash.
+ */
+static guint
+log_domain_hash (gconstpointer key)
+{
+  const gchar *next;
+  guint hash = 5381;
+
+  for (next = key; *next; next++)
+    hash = (hash << 5) + hash + g_ascii_tolower (*next);
+  return hash;
+}
+
+/**
+ * @brief Compare log domains, ignoring case.
+ *
+ * @param one  Log domain.
+ * @param two  Other log domain.
+ *
+ * @return TRUE if equal, else FALSE.
+ */
+static gboolean
+log_domain_equal (gconstpointer one, gconstpointer two)
+{
+  return g_ascii_strcasecmp (one, two) == 0;
+}
+
+static GSList *log_settings_list = NULL;      ///< Configuration compiled.
+static GHashTable *log_settings = NULL;       ///< Settings by log domain.
+static log_settings_t *log_settings_other;    ///< Settings of other domains.
+static log_settings_t *log_settings_nodomain; ///< Settings without domain.
+
+/**
+ * @brief Drop the compiled log settings.
+ */
+static void
+log_settings_clear (void)
+{
+  if (log_settings)
+    g_hash_table_destroy (log_settings);
+  log_settings = NULL;
+  log_settings_free (log_settings_other);
+  log_settings_other = NULL;
+  log_settings_free (log_settings_nodomain);
+  log_settings_nodomain = NULL;
+  log_settings_list = NULL;
+}
+
+/**
+ * @brief Compile a log configuration into settings per log domain.
+ *
+ * @param gvm_log_config_list  Log configuration.
+ */
+static void
+log_settings_compile (GSList *gvm_log_config_list)
+{
+  GSList *log_domain_list_tmp;
+  const gchar *prepend_format = "%t %s %p - ";
+  log_settings_t other;
+
+  log_settings_clear ();
+  if (gvm_log_config_list == NULL)
+    return;
+
+  log_settings_nodomain = g_new (log_settings_t, 1);
+  log_settings_resolve (NULL, NULL, log_settings_nodomain);
+
+  log_settings_defaults (&other);
+  log_settings_apply_default_group (gvm_log_config_list, &other,
+                                    &prepend_format);
+  log_settings_other = g_new (log_settings_t, 1);
+  *log_settings_other = other;
+  log_settings_other->prepend_template = log_prepend_template (prepend_format);
+
+  log_settings = g_hash_table_new_full (log_domain_hash, log_domain_equal,
+                                        NULL, log_settings_free);
+  for (log_domain_list_tmp = gvm_log_config_list; log_domain_list_tmp;
+       log_domain_list_tmp = g_slist_next (log_domain_list_tmp))
+    {
+      gvm_logging_t *log_domain_entry = log_domain_list_tmp->data;
+      const gchar *domain_prepend_format = prepend_format;
+      log_settings_t *settings;
+
+      /* The first group of a domain wins, as in a search of the list. */
+      if (g_hash_table_contains (log_settings, log_domain_entry->log_domain))
+        continue;
+      settings = g_new (log_settings_t, 1);
+      *settings = other;
+      log_settings_apply_group (log_domain_entry, settings,
+                                &domain_prepend_format);
+      settings->prepend_template = log_prepend_template (domain_prepend_format);
+      g_hash_table_insert (log_settings, log_domain_entry->log_domain,
+                           settings);
+    }
+  log_settings_list = gvm_log_config_list;
+}
+
+/**
+ * @brief Look up the compiled settings of a log domain.
+ *
+ * @param gvm_log_config_list  Log configuration.
+ * @param log_domain           Log domain.
+ *
+ * @return Settings, or NULL if the configuration is not compiled.
+ */
+static const log_settings_t *
+log_settings_lookup (GSList *gvm_log_config_list, const char *log_domain)
+{
+  log_settings_t *settings;
+
+  if (gvm_log_config_list == NULL || gvm_log_config_list != log_settings_list)
+    return NULL;
+  if (log_domain == NULL)
+    return log_settings_nodomain;
+  settings = g_hash_table_lookup (log_settings, log_domain);
+  return settings ? settings : log_settings_other;
+}
+
+/**
+ * @brief Time formatted for log messages, cached per thread.
+ */
+typedef struct
+{
+  time_t second;  ///< Second formatted.
+  gchar *format;  ///< Format used.
+  gchar text[80]; ///< Formatted time.
+} log_time_t;
+
+/**
+ * @brief Free a cached time.
+ *
+ * @param cache  Cached time.
+ */
+static void
+log_time_free (gpointer cache)
+{
+  g_free (((log_time_t *) cache)->format);
+  g_free (cache);
+}
+
+static GPrivate log_time_cache = G_PRIVATE_INIT (log_time_free);
+
+/**
+ * @brief Get the current time for a log message.
+ *
+ * The formats used have a resolution of a second, so the time is formatted
+ * once per second for each thread.
+ *
+ * @param time_format  Format for strftime.
+ *
+ * @return Formatted time, valid until the next call in the thread.
+ */
+static const gchar *
+log_time (const gchar *time_format)
+{
+  log_time_t *cache;
+  time_t now;
+
+  cache = g_private_get (&log_time_cache);
+  if (cache == NULL)
+    {
+      cache = g_new0 (log_time_t, 1);
+      g_private_set (&log_time_cache, cache);
+    }
+
+  now = time (NULL);
+  if (cache->format == NULL || cache->second != now
+      || strcmp (cache->format, time_format))
+    {
+      struct tm ts;
+
+      if (cache->format == NULL || strcmp (cache->format, time_format))
+        {
+          g_free (cache->format);
+          cache->format = g_strdup (time_format);
+        }
+      localtime_r (&now, &ts);
+      if (strftime (cache->text, sizeof (cache->text), time_format, &ts) == 0)
+        cache->text[0] = '\0';
+      cache->second = now;
+    }
+  return cache->text;
+}
+
+/**
+ * @brief Append a string to a JSON string, escaped.
+ *
+ * @param line    Line.
+ * @param string  String.
+ * @param length  Length of string.
+ */
+static void
+log_json_append_escaped (GString *line, const gchar *string, gsize length)
+{
+  const gchar *end = string + length;
+
+  for (; string < end; string++)
+    switch (*string)
+      {
+      case '"':
+        g_string_append (line, "\\\"");
+        break;
+      case '\\':
+        g_string_append (line, "\\\\");
+        break;
+      case '\n':
+        g_string_append (line, "\\n");
+        break;
+      case '\r':
+        g_string_append (line, "\\r");
+        break;
+      case '\t':
+        g_string_append (line, "\\t");
+        break;
+      default:
+        if ((guchar) *string < 0x20)
+          g_string_append_printf (line, "\\u%04x", (guchar) *string);
+        else
+          g_string_append_c (line, *string);
+        break;
+      }
+}
+
+/**
+ * @brief Append a JSON string member to a JSON object.
+ *
+ * @param line    Line.
+ * @param name    Name of the member.
+ * @param string  String, NULL for null.
+ */
+static void
+log_json_append_member (GString *line, const gchar *name, const gchar *string)
+{
+  g_string_append_printf (line, ",\"%s\":", name);
+  if (string == NULL)
+    {
+      g_string_append (line, "null");
+      return;
+    }
+  g_string_append_c (line, '"');
+  log_json_append_escaped (line, string, strlen (string));
+  g_string_append_c (line, '"');
+}
+
+static GMutex log_rate_mutex; ///< Lock for the rate limits.
+
+/**
+ * @brief Check the rate limit of a log call site.
+ *
+ * Allows burst messages per interval, and counts the others.
+ *
+ * @param rate      Rate limit state of the call site.
+ * @param interval  Interval, in seconds.
+ * @param burst     Messages allowed per interval.
+ *
+ * @return -1 to suppress the message, else the number of messages suppressed
+ *         since the last one allowed.
+ */
+int
+gvm_log_rate_check (gvm_log_rate_t *rate, guint interval, guint burst)
+{
+  gint64 now;
+  int suppressed;
+
+  now = g_get_monotonic_time ();
+  g_mutex_lock (&log_rate_mutex);
+  if (rate->count == 0 || now - rate->window >= (gint64) interval * 1000000)
+    {
+      rate->window = now;
+      rate->count = 0;
+    }
+  if (rate->count >= burst)
+    {
+      rate->suppressed++;
+      g_mutex_unlock (&log_rate_mutex);
+      return -1;
+    }
+  rate->count++;
+  suppressed = rate->suppressed;
+  rate->suppressed = 0;
+  g_mutex_unlock (&log_rate_mutex);
+  return suppressed;
+}
+
+/**
+ * @brief Get the tag of a log level.
+ *
+ * @param log_level  Log level.
+ *
+ * @return Tag.
+ */
+static const gchar *
+log_level_tag (GLogLevelFlags log_level)
+{
+  switch (log_level)
+    {
+    case G_LOG_FLAG_RECURSION:
+      return "RECURSION";
+    case G_LOG_FLAG_FATAL:
+      return "FATAL";
+    case G_LOG_LEVEL_ERROR:
+      return "ERROR";
+    case G_LOG_LEVEL_CRITICAL:
+      return "CRITICAL";
+    case G_LOG_LEVEL_WARNING:
+      return "WARNING";
+    case G_LOG_LEVEL_MESSAGE:
+      return "MESSAGE";
+    case G_LOG_LEVEL_INFO:
+      return "   INFO";
+    case G_LOG_LEVEL_DEBUG:
+      return "  DEBUG";
+    default:
+      return "UNKNOWN";
+    }
+}
+
 /**
  * @brief Loads parameters from a config file into a linked list.
  *
@@ -196,6 +710,7 @@ load_log_configuration (gchar *config_file)
       log_domain_entry->syslog_facility = NULL;
       log_domain_entry->syslog_ident = NULL;
       log_domain_entry->prepend_separator = NULL;
+      log_domain_entry->log_format = NULL;
 
       /* Look for the prepend string. */
       if (g_key_file_has_key (key_file, *group, "prepend", &error))
@@ -211,6 +726,13 @@ load_log_configuration (gchar *config_file)
             g_key_file_get_value (key_file, *group, "separator", &error);
         }
 
+      /* Look for the output format string. */
+      if (g_key_file_has_key (key_file, *group, "format", &error))
+        {
+          log_domain_entry->log_format =
+            g_key_file_get_value (key_file, *group, "format", &error);
+        }
+
       /* Look for the prepend time format string. */
       if (g_key_file_has_key (key_file, *group, "prepend_time_format", &error))
         {
@@ -278,6 +800,9 @@ free_log_configuration (GSList *log_domain_list)
 {
   GSList *log_domain_list_tmp;
 
+  if (log_domain_list == log_settings_list)
+    log_settings_clear ();
+
   /* Free the struct fields then the struct and then go the next
    * item in the link list.
    */
@@ -299,6 +824,7 @@ free_log_configuration (GSList *log_domain_list)
       g_free (log_domain_entry->default_level);
       g_free (log_domain_entry->syslog_ident);
       g_free (log_domain_entry->prepend_separator);
+      g_free (log_domain_entry->log_format);
 
       /* Drop the reference to the GIOChannel. */
       if (log_domain_entry->log_channel)
@@ -421,279 +947,68 @@ free_log_reference (void)
 }
 
 /**
- * @brief Creates the formatted string and outputs it to the log destination.
- *
- * @param log_domain A string containing the message's log domain.
- * @param log_level  Flags defining the message's log level.
- * @param message    A string containing the log message.
- * @param gvm_log_config_list A pointer to the configuration linked list.
+ * @brief A formatted log message on its way to the log destination.
  */
-void
-gvm_log_func (const char *log_domain, GLogLevelFlags log_level,
-              const char *message, gpointer gvm_log_config_list)
+typedef struct
 {
-  gchar *prepend;
-  gchar *prepend_buf;
-  gchar *prepend_tmp;
-  gchar *prepend_tmp1;
-  gchar *tmp;
-  gchar *tmpstr;
-  int messagelen;
+  gchar *line;                     ///< Formatted line.
+  gchar *message;                  ///< Message alone, for syslog, else NULL.
+  GLogLevelFlags log_level;        ///< Level of the message.
+  const gchar *log_file;           ///< Where to log to.
+  const gchar *syslog_facility;    ///< Syslog facility.
+  const gchar *syslog_ident;       ///< Syslog ident.
+  gvm_logging_t *log_domain_entry; ///< Entry holding the channel, or NULL.
+} log_record_t;
 
-  /* For link list operations. */
-  GSList *log_domain_list_tmp;
-  gvm_logging_t *log_domain_entry = NULL;
+/**
+ * @brief Check whether a log file means syslog.
+ *
+ * @param log_file  Log file.
+ *
+ * @return TRUE if syslog, else FALSE.
+ */
+static gboolean
+log_file_is_syslog (const gchar *log_file)
+{
+  return log_file && g_ascii_strcasecmp (log_file, "-")
+         && g_ascii_strcasecmp (log_file, "syslog") == 0;
+}
 
-  /* Channel to log through. */
-  GIOChannel *channel;
+/**
+ * @brief Write a log record to its destination.
+ *
+ * The caller must hold the log lock.
+ *
+ * @param record  Log record.
+ */
+static void
+log_write (const log_record_t *record)
+{
+  const gchar *log_file = record->log_file;
   GError *error = NULL;
 
-  /* The default parameters to be used. The group '*' will override
-   * these defaults if it's found.
-   */
-  gchar *prepend_format = "%t %s %p - ";
-  gchar *time_format = "%Y-%m-%d %Hh%M.%S %Z";
-  gchar *log_separator = ":";
-  gchar *log_file = "-";
-  GLogLevelFlags default_level = G_LOG_LEVEL_DEBUG;
-  channel = NULL;
-  gchar *syslog_facility = "local0";
-  gchar *syslog_ident = NULL;
-
-  /* Let's load the default configuration file directives from the
-   * linked list. Scanning the link list twice is inefficient but
-   * leaves the source cleaner.
-   */
-  if (gvm_log_config_list != NULL && log_domain != NULL)
+  /* Output everything to stderr if logfile is "-". */
+  if (g_ascii_strcasecmp (log_file, "-") == 0)
     {
-      /* Go to the head of the list. */
-      log_domain_list_tmp = (GSList *) gvm_log_config_list;
-
-      while (log_domain_list_tmp != NULL)
-        {
-          gvm_logging_t *entry;
-
-          entry = log_domain_list_tmp->data;
+      fprintf (stderr, "%s", record->line);
+      fflush (stderr);
+    }
+  /* Output everything to syslog if logfile is "syslog" */
+  else if (g_ascii_strcasecmp (log_file, "syslog") == 0)
+    {
+      int facility = facility_int_from_string (record->syslog_facility);
+      int syslog_level = LOG_INFO;
+      const char *message = record->message;
+      int messagelen;
 
-          /* Override defaults if the current linklist group name is '*'. */
-          if (g_ascii_strcasecmp (entry->log_domain, "*") == 0)
-            {
-              /* Get the list data for later use. */
-              log_domain_entry = entry;
-
-              /* Override defaults if the group items are not null. */
-              if (log_domain_entry->prepend_string)
-                prepend_format = log_domain_entry->prepend_string;
-              if (log_domain_entry->prepend_time_format)
-                time_format = log_domain_entry->prepend_time_format;
-              if (log_domain_entry->log_file)
-                log_file = log_domain_entry->log_file;
-              if (log_domain_entry->default_level)
-                default_level = *log_domain_entry->default_level;
-              if (log_domain_entry->log_channel)
-                channel = log_domain_entry->log_channel;
-              if (log_domain_entry->syslog_facility)
-                syslog_facility = log_domain_entry->syslog_facility;
-              if (log_domain_entry->prepend_separator)
-                log_separator = log_domain_entry->prepend_separator;
-              break;
-            }
+      messagelen = message ? strlen (message) : 0;
+      if (messagelen > 1 && message[messagelen - 1] == '\n')
+        messagelen--;
 
-          /* Go to the next item. */
-          log_domain_list_tmp = g_slist_next (log_domain_list_tmp);
-        }
-    }
+      openlog (record->syslog_ident, LOG_CONS | LOG_PID | LOG_NDELAY,
+               facility);
 
-  /* Let's load the configuration file directives if a linked list item for
-   * the log domain group exists.
-   */
-  if (gvm_log_config_list != NULL && log_domain != NULL)
-    {
-      /* Go to the head of the list. */
-      log_domain_list_tmp = (GSList *) gvm_log_config_list;
-
-      while (log_domain_list_tmp != NULL)
-        {
-          gvm_logging_t *entry;
-
-          entry = log_domain_list_tmp->data;
-
-          /* Search for the log domain in the link list. */
-          if (g_ascii_strcasecmp (entry->log_domain, log_domain) == 0)
-            {
-              /* Get the list data which is an gvm_logging_t struct. */
-              log_domain_entry = entry;
-
-              /* Get the struct contents. */
-              if (log_domain_entry->prepend_string)
-                prepend_format = log_domain_entry->prepend_string;
-              time_format = log_domain_entry->prepend_time_format;
-              log_file = log_domain_entry->log_file;
-              if (log_domain_entry->default_level)
-                default_level = *log_domain_entry->default_level;
-              channel = log_domain_entry->log_channel;
-              syslog_facility = log_domain_entry->syslog_facility;
-              syslog_ident = log_domain_entry->syslog_ident;
-              if (log_domain_entry->prepend_separator)
-                log_separator = log_domain_entry->prepend_separator;
-              break;
-            }
-
-          /* Go to the next item. */
-          log_domain_list_tmp = g_slist_next (log_domain_list_tmp);
-        }
-    }
-
-  /* If the current log entry is less severe than the specified log level,
-   * let's exit.
-   */
-  if (default_level < log_level)
-    return;
-
-  /* Prepend buf is a newly allocated empty string. Makes life easier. */
-  prepend_buf = g_strdup ("");
-
-  /* Make the tmp pointer (for iteration) point to the format string. */
-  tmp = prepend_format;
-
-  while (*tmp != '\0')
-    {
-      /* If the current char is a % and the next one is a p, get the pid. */
-      if ((*tmp == '%') && (*(tmp + 1) == 'p'))
-        {
-          if (reference)
-            {
-              prepend_tmp =
-                g_strdup_printf ("%s%d%s%s", prepend_buf, (int) getpid (),
-                                 log_separator, reference);
-            }
-          else
-            {
-              /* Use g_strdup, a new string returned. Store it in a tmp var
-               * until we free the old one. */
-              prepend_tmp =
-                g_strdup_printf ("%s%d", prepend_buf, (int) getpid ());
-            }
-          /* Free the old string. */
-          g_free (prepend_buf);
-          /* Point the buf ptr to the new string. */
-          prepend_buf = prepend_tmp;
-          /* Skip over the two chars we've processed '%p'. */
-          tmp += 2;
-        }
-      else if ((*tmp == '%') && (*(tmp + 1) == 't'))
-        {
-          /* Get time returns a newly allocated string.
-           * Store it in a tmp var.
-           */
-          prepend_tmp1 = get_time (time_format);
-          /* Use g_strdup. New string returned. Store it in a tmp var until
-           * we free the old one.
-           */
-          prepend_tmp = g_strdup_printf ("%s%s", prepend_buf, prepend_tmp1);
-          /* Free the time tmp var. */
-          g_free (prepend_tmp1);
-          /* Free the old string. */
-          g_free (prepend_buf);
-          /* Point the buf ptr to the new string. */
-          prepend_buf = prepend_tmp;
-          /* Skip over the two chars we've processed '%t.' */
-          tmp += 2;
-        }
-      else if ((*tmp == '%') && (*(tmp + 1) == 's'))
-        {
-          /* Use g_strdup. New string returned. Store it in a tmp var until
-           * we free the old one.
-           */
-          prepend_tmp = g_strdup_printf ("%s%s", prepend_buf, log_separator);
-          /* Free the old string. */
-          g_free (prepend_buf);
-          /* Point the buf ptr to the new string. */
-          prepend_buf = prepend_tmp;
-          /* Skip over the two chars we've processed '%s.' */
-          tmp += 2;
-        }
-      else
-        {
-          /* Jump to the next character. */
-          tmp++;
-        }
-    }
-
-  /* Step through all possible messages prefixing them with an appropriate
-   * tag.
-   */
-  switch (log_level)
-    {
-    case G_LOG_FLAG_RECURSION:
-      prepend = g_strdup_printf ("RECURSION%s%s", log_separator, prepend_buf);
-      break;
-
-    case G_LOG_FLAG_FATAL:
-      prepend = g_strdup_printf ("FATAL%s%s", log_separator, prepend_buf);
-      break;
-
-    case G_LOG_LEVEL_ERROR:
-      prepend = g_strdup_printf ("ERROR%s%s", log_separator, prepend_buf);
-      break;
-
-    case G_LOG_LEVEL_CRITICAL:
-      prepend = g_strdup_printf ("CRITICAL%s%s", log_separator, prepend_buf);
-      break;
-
-    case G_LOG_LEVEL_WARNING:
-      prepend = g_strdup_printf ("WARNING%s%s", log_separator, prepend_buf);
-      break;
-
-    case G_LOG_LEVEL_MESSAGE:
-      prepend = g_strdup_printf ("MESSAGE%s%s", log_separator, prepend_buf);
-      break;
-
-    case G_LOG_LEVEL_INFO:
-      prepend = g_strdup_printf ("   INFO%s%s", log_separator, prepend_buf);
-      break;
-
-    case G_LOG_LEVEL_DEBUG:
-      prepend = g_strdup_printf ("  DEBUG%s%s", log_separator, prepend_buf);
-      break;
-
-    default:
-      prepend = g_strdup_printf ("UNKNOWN%s%s", log_separator, prepend_buf);
-      break;
-    }
-
-  /* If the current log entry is more severe than the specified log
-   * level, print out the message.  In case MESSAGE already ends in a
-   * LF and there is not only the LF, remove the LF to avoid empty
-   * lines in the log.
-   */
-  messagelen = message ? strlen (message) : 0;
-  if (messagelen > 1 && message[messagelen - 1] == '\n')
-    messagelen--;
-  tmpstr = g_strdup_printf ("%s%s%s%s %.*s\n", log_domain ? log_domain : "",
-                            log_separator, prepend, log_separator, messagelen,
-                            message);
-  g_free (prepend);
-
-  if (log_level <= G_LOG_LEVEL_WARNING)
-    gvm_sentry_log (message);
-
-  gvm_log_lock ();
-  /* Output everything to stderr if logfile is "-". */
-  if (g_ascii_strcasecmp (log_file, "-") == 0)
-    {
-      fprintf (stderr, "%s", tmpstr);
-      fflush (stderr);
-    }
-  /* Output everything to syslog if logfile is "syslog" */
-  else if (g_ascii_strcasecmp (log_file, "syslog") == 0)
-    {
-      int facility = facility_int_from_string (syslog_facility);
-      int syslog_level = LOG_INFO;
-
-      openlog (syslog_ident, LOG_CONS | LOG_PID | LOG_NDELAY, facility);
-
-      switch (log_level)
+      switch (record->log_level)
         {
         case G_LOG_FLAG_FATAL:
           syslog_level = LOG_ALERT;
@@ -748,9 +1063,13 @@ gvm_log_func (const char *log_domain, GLogLevelFlags log_level,
     }
   else
     {
+      GIOChannel *channel = NULL;
+
       /* Open a channel and store it in the struct or
        * retrieve and use an already existing channel.
        */
+      if (record->log_domain_entry)
+        channel = record->log_domain_entry->log_channel;
       if (channel == NULL)
         {
           channel = g_io_channel_new_file (log_file, "a", &error);
@@ -774,8 +1093,6 @@ gvm_log_func (const char *log_domain, GLogLevelFlags log_level,
                   g_warning ("Failed to create log file directory %s: %s", dir,
                              strerror (errno));
                   g_free (log);
-                  g_free (tmpstr);
-                  g_free (prepend_buf);
                   return;
                 }
               g_free (log);
@@ -791,16 +1108,520 @@ gvm_log_func (const char *log_domain, GLogLevelFlags log_level,
             }
 
           /* Store it in the struct for later use. */
-          if (log_domain_entry != NULL)
-            log_domain_entry->log_channel = channel;
+          if (record->log_domain_entry != NULL)
+            record->log_domain_entry->log_channel = channel;
         }
-      g_io_channel_write_chars (channel, (const gchar *) tmpstr, -1, NULL,
-                                &error);
+      g_io_channel_write_chars (channel, (const gchar *) record->line, -1,
+                                NULL, &error);
       g_io_channel_flush (channel, NULL);
     }
+}
+
+/**
+ * @brief Maximum number of records the log writer thread writes at once.
+ */
+#define LOG_BATCH 64
+
+/**
+ * @brief Slot of the asynchronous log queue.
+ */
+typedef struct
+{
+  gint sequence;       ///< Position the slot is ready for, see log_push.
+  log_record_t record; ///< Record.
+} log_slot_t;
+
+static log_slot_t *log_ring = NULL;     ///< Asynchronous log queue.
+static guint log_ring_mask;             ///< Size of the queue, minus one.
+static gint log_ring_head;              ///< Next position to claim.
+static gint log_ring_tail;              ///< Next position to write.
+static gint log_ring_written;           ///< Number of records written.
+static gint log_async_running = 0;      ///< Whether messages go to the queue.
+static gint log_producers = 0;          ///< Threads pushing to the queue.
+static gint log_dropped = 0;            ///< Messages dropped for a full queue.
+static gint log_writer_waiting = 0;     ///< Whether the writer sleeps.
+static gvm_log_overflow_t log_overflow; ///< What to do when full.
+static GThread *log_writer = NULL;      ///< Writer thread.
+static GMutex log_writer_mutex;         ///< Lock for the conditions.
+static GCond log_writer_cond;           ///< Wakes the writer.
+static GCond log_flush_cond;            ///< Signals written records.
+static pid_t log_async_pid;             ///< Process which started the writer.
+
+/**
+ * @brief Check whether the log writer thread was started by a parent process.
+ *
+ * A forked child only inherits the queue, not the writer thread, so queued
+ * messages would never be written and a full queue would never drain.
+ *
+ * @return TRUE in a child forked after gvm_log_async_start, else FALSE.
+ */
+static gboolean
+log_async_forked (void)
+{
+  return log_writer != NULL && log_async_pid != getpid ();
+}
+
+/**
+ * @brief Drop the log queue inherited from the parent, in a forked child.
+ *
+ * The queue is of no use without the writer, which cannot be joined.
+ */
+static void
+log_async_forget (void)
+{
+  g_atomic_int_set (&log_async_running, 0);
+  log_writer = NULL;
+  g_free (log_ring);
+  log_ring = NULL;
+}
+
+/**
+ * @brief Wake the log writer thread if it sleeps.
+ */
+static void
+log_writer_wake (void)
+{
+  if (g_atomic_int_get (&log_writer_waiting))
+    {
+      g_mutex_lock (&log_writer_mutex);
+      g_cond_signal (&log_writer_cond);
+      g_mutex_unlock (&log_writer_mutex);
+    }
+}
+
+/**
+ * @brief Push a record to the asynchronous log queue.
+ *
+ * The queue is a bounded ring in which each slot carries the position it is
+ * ready for.  A producer claims a position by advancing the head with a
+ * compare and exchange, fills the slot and then publishes it by setting its
+ * sequence, so producers never take a lock.
+ *
+ * @param record  Record.  The line is taken over, the message is copied.
+ *
+ * @return TRUE if the record was queued or dropped, FALSE if the record has
+ *         to be written directly.
+ */
+static gboolean
+log_push (log_record_t *record)
+{
+  gvm_log_overflow_t overflow = log_overflow;
+  log_slot_t *slot;
+  gint pos;
+
+  g_atomic_int_inc (&log_producers);
+  if (!g_atomic_int_get (&log_async_running) || log_async_forked ())
+    {
+      g_atomic_int_dec_and_test (&log_producers);
+      return FALSE;
+    }
+
+  /* The writer must not wait for itself. */
+  if (g_thread_self () == log_writer)
+    overflow = GVM_LOG_OVERFLOW_DROP;
+
+  pos = g_atomic_int_get (&log_ring_head);
+  while (1)
+    {
+      gint diff;
+
+      slot = &log_ring[(guint) pos & log_ring_mask];
+      diff = (gint) ((guint) g_atomic_int_get (&slot->sequence) - (guint) pos);
+      if (diff == 0)
+        {
+          if (g_atomic_int_compare_and_exchange (&log_ring_head, pos,
+                                                 (gint) ((guint) pos + 1)))
+            break;
+        }
+      else if (diff < 0)
+        {
+          /* Full. */
+          if (overflow == GVM_LOG_OVERFLOW_DROP)
+            {
+              g_atomic_int_inc (&log_dropped);
+              g_free (record->line);
+              g_atomic_int_dec_and_test (&log_producers);
+              return TRUE;
+            }
+          log_writer_wake ();
+          g_usleep (100);
+        }
+      pos = g_atomic_int_get (&log_ring_head);
+    }
+
+  slot->record = *record;
+  slot->record.message = g_strdup (record->message);
+  g_atomic_int_set (&slot->sequence, (gint) ((guint) pos + 1));
+  g_atomic_int_dec_and_test (&log_producers);
+  log_writer_wake ();
+  return TRUE;
+}
+
+/**
+ * @brief Check whether the next record of the log queue is published.
+ *
+ * @return TRUE if a record is ready, else FALSE.
+ */
+static gboolean
+log_ring_ready (void)
+{
+  log_slot_t *slot = &log_ring[(guint) log_ring_tail & log_ring_mask];
+
+  return g_atomic_int_get (&slot->sequence)
+         == (gint) ((guint) log_ring_tail + 1);
+}
+
+/**
+ * @brief Take the published records from the log queue.
+ *
+ * Only the writer thread takes records.
+ *
+ * @param batch  Array for the records.
+ * @param size   Size of the array.
+ *
+ * @return Number of records taken.
+ */
+static int
+log_ring_pop (log_record_t *batch, int size)
+{
+  int count = 0;
+
+  while (count < size && log_ring_ready ())
+    {
+      log_slot_t *slot = &log_ring[(guint) log_ring_tail & log_ring_mask];
+
+      batch[count++] = slot->record;
+      /* Free the slot for the producer one lap later. */
+      g_atomic_int_set (&slot->sequence, (gint) ((guint) log_ring_tail
+                                                 + log_ring_mask + 1));
+      log_ring_tail = (gint) ((guint) log_ring_tail + 1);
+    }
+  return count;
+}
+
+/**
+ * @brief Write a batch of log records.
+ *
+ * Consecutive lines for the same file or stderr are written at once.
+ *
+ * @param batch  Records.
+ * @param count  Number of records.
+ * @param lines  Buffer for the lines.
+ */
+static void
+log_write_batch (log_record_t *batch, int count, GString *lines)
+{
+  int index = 0;
+
+  gvm_log_lock ();
+  while (index < count)
+    {
+      log_record_t merged = batch[index];
+      int next = index + 1;
+
+      if (!log_file_is_syslog (merged.log_file))
+        {
+          g_string_assign (lines, merged.line);
+          while (next < count && batch[next].log_file == merged.log_file
+                 && batch[next].log_domain_entry == merged.log_domain_entry)
+            g_string_append (lines, batch[next++].line);
+          merged.line = lines->str;
+        }
+      log_write (&merged);
+      index = next;
+    }
+  gvm_log_unlock ();
+
+  for (index = 0; index < count; index++)
+    {
+      g_free (batch[index].line);
+      g_free (batch[index].message);
+    }
+}
+
+/**
+ * @brief Run the log writer thread.
+ *
+ * @param data  Unused.
+ *
+ * @return NULL.
+ */
+static gpointer
+log_writer_run (gpointer data)
+{
+  log_record_t batch[LOG_BATCH];
+  GString *lines = g_string_sized_new (LOG_BATCH * 128);
+
+  (void) data;
+  while (1)
+    {
+      int count = log_ring_pop (batch, LOG_BATCH);
+
+      if (count)
+        {
+          log_write_batch (batch, count, lines);
+          g_atomic_int_add (&log_ring_written, count);
+          g_mutex_lock (&log_writer_mutex);
+          g_cond_broadcast (&log_flush_cond);
+          g_mutex_unlock (&log_writer_mutex);
+          continue;
+        }
+
+      /* Stopped, and no producer can still publish. */
+      if (!g_atomic_int_get (&log_async_running)
+          && g_atomic_int_get (&log_producers) == 0 && !log_ring_ready ())
+        break;
+
+      g_mutex_lock (&log_writer_mutex);
+      g_atomic_int_set (&log_writer_waiting, 1);
+      if (!log_ring_ready ())
+        g_cond_wait_until (&log_writer_cond, &log_writer_mutex,
+                           g_get_monotonic_time () + G_TIME_SPAN_SECOND / 10);
+      g_atomic_int_set (&log_writer_waiting, 0);
+      g_mutex_unlock (&log_writer_mutex);
+    }
+  g_string_free (lines, TRUE);
+  return NULL;
+}
+
+/**
+ * @brief Start writing log messages from a writer thread.
+ *
+ * After this gvm_log_func only formats messages and queues them, and a
+ * dedicated thread writes them in batches, so logging does not wait for
+ * slow log files or syslog.  Fatal messages are still written directly,
+ * after the queue.
+ *
+ * The log configuration must stay alive until gvm_log_async_stop.
+ *
+ * @param capacity  Number of messages the queue holds, rounded up to a power
+ *                  of two.
+ * @param overflow  What to do with a message when the queue is full.
+ *
+ * In a child forked after the start, messages are written directly until
+ * the writer is started again in the child.
+ *
+ * @return 0 on success, -1 if already started.
+ */
+int
+gvm_log_async_start (guint capacity, gvm_log_overflow_t overflow)
+{
+  guint size, index;
+
+  if (log_async_forked ())
+    log_async_forget ();
+  if (log_writer)
+    return -1;
+
+  size = 64;
+  while (size < capacity && size < (1U << 30))
+    size <<= 1;
+  log_ring = g_malloc0 (size * sizeof (*log_ring));
+  for (index = 0; index < size; index++)
+    log_ring[index].sequence = (gint) index;
+  log_ring_mask = size - 1;
+  log_ring_head = 0;
+  log_ring_tail = 0;
+  log_ring_written = 0;
+  log_overflow = overflow;
+  g_atomic_int_set (&log_dropped, 0);
+  log_async_pid = getpid ();
+  g_atomic_int_set (&log_async_running, 1);
+  log_writer = g_thread_new ("gvm-log-writer", log_writer_run, NULL);
+  return 0;
+}
+
+/**
+ * @brief Wait until the queued log messages are written.
+ */
+void
+gvm_log_async_flush (void)
+{
+  gint target;
+
+  if (log_writer == NULL || g_thread_self () == log_writer
+      || log_async_forked ())
+    return;
+
+  target = g_atomic_int_get (&log_ring_head);
+  g_mutex_lock (&log_writer_mutex);
+  g_cond_signal (&log_writer_cond);
+  while ((gint) ((guint) g_atomic_int_get (&log_ring_written) - (guint) target)
+         < 0)
+    g_cond_wait_until (&log_flush_cond, &log_writer_mutex,
+                       g_get_monotonic_time () + G_TIME_SPAN_SECOND / 10);
+  g_mutex_unlock (&log_writer_mutex);
+}
+
+/**
+ * @brief Write the queued log messages and stop the writer thread.
+ *
+ * Messages are written directly again afterwards.
+ */
+void
+gvm_log_async_stop (void)
+{
+  guint dropped;
+
+  if (log_writer == NULL || g_thread_self () == log_writer)
+    return;
+  if (log_async_forked ())
+    {
+      log_async_forget ();
+      return;
+    }
+
+  g_atomic_int_set (&log_async_running, 0);
+  g_mutex_lock (&log_writer_mutex);
+  g_cond_signal (&log_writer_cond);
+  g_mutex_unlock (&log_writer_mutex);
+  g_thread_join (log_writer);
+  log_writer = NULL;
+  g_free (log_ring);
+  log_ring = NULL;
+
+  dropped = g_atomic_int_get (&log_dropped);
+  if (dropped)
+    g_warning ("%s: dropped %u log messages for a full queue", __func__,
+               dropped);
+}
+
+/**
+ * @brief Get the number of log messages dropped for a full queue.
+ *
+ * @return Number of messages dropped since gvm_log_async_start.
+ */
+guint
+gvm_log_async_dropped (void)
+{
+  return g_atomic_int_get (&log_dropped);
+}
+
+/**
+ * @brief Creates the formatted string and outputs it to the log destination.
+ *
+ * @param log_domain A string containing the message's log domain.
+ * @param log_level  Flags defining the message's log level.
+ * @param message    A string containing the log message.
+ * @param gvm_log_config_list A pointer to the configuration linked list.
+ */
+void
+gvm_log_func (const char *log_domain, GLogLevelFlags log_level,
+              const char *message, gpointer gvm_log_config_list)
+{
+  const log_settings_t *settings;
+  log_settings_t resolved;
+  GString *line;
+  const gchar *tmp, *level_tag;
+  int messagelen;
+
+  /* Message on its way to the log destination. */
+  log_record_t record;
+
+  /* The settings are compiled by setup_log_handlers, other configurations
+   * are resolved for each message.
+   */
+  settings = log_settings_lookup (gvm_log_config_list, log_domain);
+  if (settings == NULL)
+    {
+      log_settings_resolve (gvm_log_config_list, log_domain, &resolved);
+      settings = &resolved;
+    }
+
+  /* If the current log entry is less severe than the specified log level,
+   * let's exit.
+   */
+  if (settings->default_level < log_level)
+    {
+      if (settings == &resolved)
+        g_free (resolved.prepend_template);
+      return;
+    }
+
+  /* In case MESSAGE already ends in a LF and there is not only the LF,
+   * remove the LF to avoid empty lines in the log.
+   */
+  messagelen = message ? strlen (message) : 0;
+  if (messagelen > 1 && message[messagelen - 1] == '\n')
+    messagelen--;
+
+  /* The whole line goes into one buffer. */
+  line = g_string_sized_new (128 + messagelen);
+  level_tag = log_level_tag (log_level);
+  if (settings->json)
+    {
+      g_string_append (line, "{\"time\":\"");
+      g_string_append (line, log_time ("%Y-%m-%dT%H:%M:%S%z"));
+      g_string_append_c (line, '"');
+      log_json_append_member (line, "domain", log_domain);
+      while (*level_tag == ' ')
+        level_tag++;
+      log_json_append_member (line, "level", level_tag);
+      g_string_append_printf (line, ",\"pid\":%d", (int) getpid ());
+      log_json_append_member (line, "reference", reference);
+      g_string_append (line, ",\"message\":\"");
+      if (message)
+        log_json_append_escaped (line, message, messagelen);
+      g_string_append (line, "\"}\n");
+    }
+  else
+    {
+      if (log_domain)
+        g_string_append (line, log_domain);
+      g_string_append (line, settings->log_separator);
+      g_string_append (line, level_tag);
+      g_string_append (line, settings->log_separator);
+      for (tmp = settings->prepend_template; *tmp != '\0'; tmp++)
+        switch (*tmp)
+          {
+          case 'p':
+            g_string_append_printf (line, "%d", (int) getpid ());
+            if (reference)
+              {
+                g_string_append (line, settings->log_separator);
+                g_string_append (line, reference);
+              }
+            break;
+          case 't':
+            g_string_append (line, log_time (settings->time_format));
+            break;
+          case 's':
+            g_string_append (line, settings->log_separator);
+            break;
+          }
+      g_string_append (line, settings->log_separator);
+      g_string_append_c (line, ' ');
+      if (message)
+        g_string_append_len (line, message, messagelen);
+      g_string_append_c (line, '\n');
+    }
+
+  if (log_level <= G_LOG_LEVEL_WARNING)
+    gvm_sentry_log (message);
+
+  record.line = g_string_free (line, FALSE);
+  record.message = NULL;
+  record.log_level = log_level;
+  record.log_file = settings->log_file;
+  record.syslog_facility = settings->syslog_facility;
+  record.syslog_ident = settings->syslog_ident;
+  record.log_domain_entry = settings->log_domain_entry;
+  if (log_file_is_syslog (settings->log_file))
+    record.message = (gchar *) message;
+  if (settings == &resolved)
+    g_free (resolved.prepend_template);
+
+  /* Fatal messages may be the last, so they go out directly, after the
+   * queue. */
+  if (log_level & (G_LOG_FLAG_FATAL | G_LOG_LEVEL_ERROR))
+    gvm_log_async_flush ();
+  else if (log_push (&record))
+    return;
+
+  gvm_log_lock ();
+  log_write (&record);
   gvm_log_unlock ();
-  g_free (tmpstr);
-  g_free (prepend_buf);
+  g_free (record.line);
 }
 
 /**
@@ -890,6 +1711,8 @@ setup_log_handlers (GSList *gvm_log_config_list)
   int err;
   int ret = 0;
 
+  log_settings_compile (gvm_log_config_list);
+
   if (gvm_log_config_list != NULL)
     {
       /* Go to the head of the list. */
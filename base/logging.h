@@ -45,6 +45,60 @@ gvm_log_lock (void);
 void
 gvm_log_unlock (void);
 
+/**
+ * @brief What to do with a log message when the asynchronous queue is full.
+ */
+typedef enum
+{
+  GVM_LOG_OVERFLOW_DROP,  ///< Drop the message and count it.
+  GVM_LOG_OVERFLOW_BLOCK, ///< Wait for room in the queue.
+} gvm_log_overflow_t;
+
+int
+gvm_log_async_start (guint, gvm_log_overflow_t);
+
+void
+gvm_log_async_flush (void);
+
+void
+gvm_log_async_stop (void);
+
+guint
+gvm_log_async_dropped (void);
+
+/**
+ * @brief Rate limit state of a log call site.
+ */
+typedef struct
+{
+  gint64 window;    ///< Start of the current interval, monotonic.
+  guint count;      ///< Messages allowed in the interval.
+  guint suppressed; ///< Messages suppressed since the last one allowed.
+} gvm_log_rate_t;
+
+int
+gvm_log_rate_check (gvm_log_rate_t *, guint, guint);
+
+/**
+ * @brief Log a message, at most burst times per interval seconds.
+ *
+ * The limit is per call site.  The first message allowed after others were
+ * suppressed is preceded by a message with the number suppressed.
+ */
+#define gvm_log_limited(level, interval, burst, ...)                          \
+  do                                                                          \
+    {                                                                         \
+      static gvm_log_rate_t gvm_log_rate = {0, 0, 0};                         \
+      int gvm_log_suppressed =                                                \
+        gvm_log_rate_check (&gvm_log_rate, interval, burst);                  \
+      if (gvm_log_suppressed > 0)                                             \
+        g_log (G_LOG_DOMAIN, level, "%s:%d: %d messages suppressed",          \
+               __FILE__, __LINE__, gvm_log_suppressed);                       \
+      if (gvm_log_suppressed >= 0)                                            \
+        g_log (G_LOG_DOMAIN, level, __VA_ARGS__);                             \
+    }                                                                         \
+  while (0)
+
 void
 set_log_reference (char *);
 
@@ -0,0 +1,298 @@
+/* SPDX-FileCopyrightText: 2026 Greenbone AG
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/**
+ * @file
+ * @brief Implementation of the memory accounting of the subsystems.
+ *
+ * The counters are updated with atomic operations, without locks, so that
+ * the accounting can stay enabled on production scans.  When it is off an
+ * allocation costs a single load of the flag.
+ */
+
+#include "memstats.h"
+
+#include <string.h>       /* for memset() */
+#include <sys/resource.h> /* for getrusage() */
+
+#undef G_LOG_DOMAIN
+/**
+ * @brief GLib log domain.
+ */
+#define G_LOG_DOMAIN "libgvm base"
+
+/**
+ * @brief Whether the accounting is enabled.
+ */
+static volatile int memstats_enabled = 0;
+
+/**
+ * @brief Counters of the subsystems.
+ */
+static gvm_memstats_t memstats[GVM_MEM_MAX];
+
+/**
+ * @brief Names of the subsystems, in the log line.
+ */
+static const char *memstats_names[GVM_MEM_MAX] = {
+  "hosts", "entities", "nvti", "kb", "boreas"};
+
+/**
+ * @brief State of the periodic log thread.
+ */
+static struct
+{
+  GMutex mutex;    /**< Protects the fields. */
+  GCond cond;      /**< Signalled to stop the thread. */
+  GThread *thread; /**< Log thread, NULL if not running. */
+  gboolean stop;   /**< Whether the thread should stop. */
+  gint64 interval; /**< Time between two log lines, in microseconds. */
+} memstats_log;
+
+/**
+ * @brief Enable or disable the memory accounting.
+ *
+ * @param[in]  enable  1 to enable, 0 to disable.
+ */
+void
+gvm_memstats_enable (int enable)
+{
+  g_atomic_int_set (&memstats_enabled, enable ? 1 : 0);
+}
+
+/**
+ * @brief Check whether the memory accounting is enabled.
+ *
+ * @return 1 if enabled, 0 otherwise.
+ */
+int
+gvm_memstats_enabled (void)
+{
+  return g_atomic_int_get (&memstats_enabled);
+}
+
+/**
+ * @brief Count an allocation of a subsystem.
+ *
+ * @param[in]  subsystem  Subsystem.
+ * @param[in]  size       Size of the allocated object, in bytes.
+ */
+void
+gvm_memstats_alloc (gvm_mem_subsystem_t subsystem, size_t size)
+{
+  gvm_memstats_t *stats;
+  gint64 live, peak;
+
+  if (!g_atomic_int_get (&memstats_enabled) || subsystem >= GVM_MEM_MAX)
+    return;
+
+  stats = &memstats[subsystem];
+  __atomic_add_fetch (&stats->allocs, 1, __ATOMIC_RELAXED);
+  live = __atomic_add_fetch (&stats->live, (gint64) size, __ATOMIC_RELAXED);
+  peak = __atomic_load_n (&stats->peak, __ATOMIC_RELAXED);
+  while (live > peak
+         && !__atomic_compare_exchange_n (&stats->peak, &peak, live, TRUE,
+                                          __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    ;
+}
+
+/**
+ * @brief Count a free of a subsystem.
+ *
+ * @param[in]  subsystem  Subsystem.
+ * @param[in]  size       Size of the freed object, as counted when it was
+ *                        allocated.
+ */
+void
+gvm_memstats_free (gvm_mem_subsystem_t subsystem, size_t size)
+{
+  gvm_memstats_t *stats;
+
+  if (!g_atomic_int_get (&memstats_enabled) || subsystem >= GVM_MEM_MAX)
+    return;
+
+  stats = &memstats[subsystem];
+  __atomic_add_fetch (&stats->frees, 1, __ATOMIC_RELAXED);
+  __atomic_sub_fetch (&stats->live, (gint64) size, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Get the counters of a subsystem.
+ *
+ * @param[in]   subsystem  Subsystem.
+ * @param[out]  stats      Counters.
+ */
+void
+gvm_memstats_get (gvm_mem_subsystem_t subsystem, gvm_memstats_t *stats)
+{
+  if (!stats)
+    return;
+  memset (stats, 0, sizeof (*stats));
+  if (subsystem >= GVM_MEM_MAX)
+    return;
+
+  stats->live = MAX (
+    __atomic_load_n (&memstats[subsystem].live, __ATOMIC_RELAXED), 0);
+  stats->peak = __atomic_load_n (&memstats[subsystem].peak, __ATOMIC_RELAXED);
+  stats->allocs =
+    __atomic_load_n (&memstats[subsystem].allocs, __ATOMIC_RELAXED);
+  stats->frees = __atomic_load_n (&memstats[subsystem].frees, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Get the name of a subsystem.
+ *
+ * @param[in]  subsystem  Subsystem.
+ *
+ * @return Name, NULL for an invalid subsystem.
+ */
+const char *
+gvm_memstats_name (gvm_mem_subsystem_t subsystem)
+{
+  if (subsystem >= GVM_MEM_MAX)
+    return NULL;
+  return memstats_names[subsystem];
+}
+
+/**
+ * @brief Reset the counters of all subsystems.
+ *
+ * Only meant for when the accounted objects are freed, like between scans.
+ */
+void
+gvm_memstats_reset (void)
+{
+  for (int i = 0; i < GVM_MEM_MAX; i++)
+    {
+      __atomic_store_n (&memstats[i].live, 0, __ATOMIC_RELAXED);
+      __atomic_store_n (&memstats[i].peak, 0, __ATOMIC_RELAXED);
+      __atomic_store_n (&memstats[i].allocs, 0, __ATOMIC_RELAXED);
+      __atomic_store_n (&memstats[i].frees, 0, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief Describe the counters of the subsystems with allocations.
+ *
+ * Ends with the peak resident set size of the process, which includes the
+ * memory not accounted by the subsystems.
+ *
+ * @return Description like "hosts live=1024 peak=2048 allocs=16 frees=8,
+ *         maxrss=10240 KiB", to be freed with g_free.
+ */
+gchar *
+gvm_memstats_str (void)
+{
+  GString *str = g_string_new ("");
+  struct rusage usage;
+
+  for (int i = 0; i < GVM_MEM_MAX; i++)
+    {
+      gvm_memstats_t stats;
+
+      gvm_memstats_get (i, &stats);
+      if (!stats.allocs && !stats.frees)
+        continue;
+      g_string_append_printf (str,
+                              "%s live=%" G_GINT64_FORMAT
+                              " peak=%" G_GINT64_FORMAT
+                              " allocs=%" G_GUINT64_FORMAT
+                              " frees=%" G_GUINT64_FORMAT ", ",
+                              memstats_names[i], stats.live, stats.peak,
+                              stats.allocs, stats.frees);
+    }
+  if (getrusage (RUSAGE_SELF, &usage) == 0)
+    g_string_append_printf (str, "maxrss=%ld KiB", usage.ru_maxrss);
+  else if (str->len)
+    g_string_truncate (str, str->len - 2);
+  return g_string_free (str, FALSE);
+}
+
+/**
+ * @brief Thread function logging the counters periodically.
+ *
+ * @param[in]  data  Unused.
+ *
+ * @return NULL.
+ */
+static gpointer
+memstats_log_run (gpointer data)
+{
+  (void) data;
+
+  g_mutex_lock (&memstats_log.mutex);
+  while (!memstats_log.stop)
+    {
+      gint64 end = g_get_monotonic_time () + memstats_log.interval;
+      gchar *str;
+
+      while (!memstats_log.stop
+             && g_cond_wait_until (&memstats_log.cond, &memstats_log.mutex,
+                                   end))
+        ;
+      if (memstats_log.stop)
+        break;
+      str = gvm_memstats_str ();
+      g_message ("Memory: %s", str);
+      g_free (str);
+    }
+  g_mutex_unlock (&memstats_log.mutex);
+  return NULL;
+}
+
+/**
+ * @brief Start logging the counters periodically, with g_message.
+ *
+ * Enables the accounting.  A running log thread is kept, with the new
+ * interval.
+ *
+ * @param[in]  interval  Seconds between two log lines.
+ *
+ * @return 0 on success, -1 if interval is 0.
+ */
+int
+gvm_memstats_log_start (unsigned int interval)
+{
+  if (interval == 0)
+    return -1;
+
+  gvm_memstats_enable (1);
+  g_mutex_lock (&memstats_log.mutex);
+  memstats_log.interval = (gint64) interval * G_USEC_PER_SEC;
+  if (!memstats_log.thread)
+    {
+      memstats_log.stop = FALSE;
+      memstats_log.thread =
+        g_thread_new ("gvm memstats", memstats_log_run, NULL);
+    }
+  g_mutex_unlock (&memstats_log.mutex);
+  return 0;
+}
+
+/**
+ * @brief Stop logging the counters, logging them a last time.
+ *
+ * The accounting stays enabled.
+ */
+void
+gvm_memstats_log_stop (void)
+{
+  GThread *thread;
+  gchar *str;
+
+  g_mutex_lock (&memstats_log.mutex);
+  thread = memstats_log.thread;
+  memstats_log.thread = NULL;
+  memstats_log.stop = TRUE;
+  g_cond_signal (&memstats_log.cond);
+  g_mutex_unlock (&memstats_log.mutex);
+  if (!thread)
+    return;
+
+  g_thread_join (thread);
+  str = gvm_memstats_str ();
+  g_message ("Memory: %s", str);
+  g_free (str);
+}
@@ -0,0 +1,77 @@
+/* SPDX-FileCopyrightText: 2026 Greenbone AG
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/**
+ * @file
+ * @brief Memory accounting of the subsystems of the libraries.
+ *
+ * The accounting is off by default.  Once enabled with gvm_memstats_enable,
+ * the subsystems count the bytes of the objects they allocate and free, so
+ * that the live bytes, the peak and the number of allocations of each can be
+ * queried or logged periodically.  The accounting should be enabled before
+ * the objects are allocated: freeing objects allocated before lowers the
+ * live bytes of a subsystem, which are reported as 0 at least.
+ */
+
+#ifndef _GVM_MEMSTATS_H
+#define _GVM_MEMSTATS_H
+
+#include <glib.h>
+
+/**
+ * @brief Subsystems with accounted memory.
+ */
+typedef enum
+{
+  GVM_MEM_HOSTS = 0, /**< Hosts, vhosts and hosts collections. */
+  GVM_MEM_ENTITIES,  /**< XML entities and entity arenas. */
+  GVM_MEM_NVTI,      /**< NVT Infos. */
+  GVM_MEM_KB,        /**< Items of KB replies. */
+  GVM_MEM_BOREAS,    /**< Address sets of the alive detection. */
+  GVM_MEM_MAX        /**< Boundary checking. */
+} gvm_mem_subsystem_t;
+
+/**
+ * @brief Memory counters of a subsystem.
+ */
+typedef struct
+{
+  gint64 live;    /**< Bytes allocated and not freed. */
+  gint64 peak;    /**< Highest value of live. */
+  guint64 allocs; /**< Number of allocations. */
+  guint64 frees;  /**< Number of frees. */
+} gvm_memstats_t;
+
+void
+gvm_memstats_enable (int);
+
+int
+gvm_memstats_enabled (void);
+
+void
+gvm_memstats_alloc (gvm_mem_subsystem_t, size_t);
+
+void
+gvm_memstats_free (gvm_mem_subsystem_t, size_t);
+
+void
+gvm_memstats_get (gvm_mem_subsystem_t, gvm_memstats_t *);
+
+const char *
+gvm_memstats_name (gvm_mem_subsystem_t);
+
+void
+gvm_memstats_reset (void);
+
+gchar *
+gvm_memstats_str (void);
+
+int
+gvm_memstats_log_start (unsigned int);
+
+void
+gvm_memstats_log_stop (void);
+
+#endif /* not _GVM_MEMSTATS_H */
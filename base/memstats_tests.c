@@ -0,0 +1,74 @@
+/* SPDX-FileCopyrightText: 2026 Greenbone AG
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "memstats.c"
+
+#include <cgreen/cgreen.h>
+#include <cgreen/mocks.h>
+
+Describe (memstats);
+BeforeEach (memstats)
+{
+  gvm_memstats_reset ();
+}
+AfterEach (memstats)
+{
+  gvm_memstats_enable (0);
+}
+
+Ensure (memstats, nothing_is_counted_when_disabled)
+{
+  gvm_memstats_t stats;
+
+  gvm_memstats_alloc (GVM_MEM_HOSTS, 100);
+  gvm_memstats_get (GVM_MEM_HOSTS, &stats);
+  assert_that (stats.allocs, is_equal_to (0));
+  assert_that (stats.live, is_equal_to (0));
+}
+
+Ensure (memstats, live_bytes_and_peak_are_counted)
+{
+  gvm_memstats_t stats;
+  gchar *str;
+
+  gvm_memstats_enable (1);
+  gvm_memstats_alloc (GVM_MEM_KB, 100);
+  gvm_memstats_alloc (GVM_MEM_KB, 50);
+  gvm_memstats_free (GVM_MEM_KB, 100);
+  gvm_memstats_alloc (GVM_MEM_KB, 20);
+
+  gvm_memstats_get (GVM_MEM_KB, &stats);
+  assert_that (stats.live, is_equal_to (70));
+  assert_that (stats.peak, is_equal_to (150));
+  assert_that (stats.allocs, is_equal_to (3));
+  assert_that (stats.frees, is_equal_to (1));
+
+  /* Frees of objects allocated before the accounting do not go below 0. */
+  gvm_memstats_free (GVM_MEM_NVTI, 10);
+  gvm_memstats_get (GVM_MEM_NVTI, &stats);
+  assert_that (stats.live, is_equal_to (0));
+
+  str = gvm_memstats_str ();
+  assert_that (str, begins_with_string ("kb live=70 peak=150 allocs=3 "
+                                        "frees=1, nvti live=0"));
+  g_free (str);
+  assert_that (gvm_memstats_name (GVM_MEM_MAX), is_null);
+}
+
+int
+main (int argc, char **argv)
+{
+  TestSuite *suite;
+
+  suite = create_test_suite ();
+
+  add_test_with_context (suite, memstats, nothing_is_counted_when_disabled);
+  add_test_with_context (suite, memstats, live_bytes_and_peak_are_counted);
+
+  if (argc > 1)
+    return run_single_test (suite, argv[1], create_text_reporter ());
+
+  return run_test_suite (suite, create_text_reporter ());
+}
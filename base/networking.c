@@ -21,7 +21,12 @@
 #include <stdlib.h>     /* for atoi, strtol */
 #include <string.h>     /* for memcpy, bzero, strchr, strlen, strcmp, strncpy */
 #include <sys/socket.h> /* for AF_INET, AF_INET6, AF_UNSPEC, sockaddr_storage */
-#include <unistd.h>     /* for close */
+#include <unistd.h>     /* for close, getpid */
+
+#ifdef __linux__
+#include <linux/netlink.h>   /* for sockaddr_nl, NLMSG_OK, NETLINK_ROUTE */
+#include <linux/rtnetlink.h> /* for rtmsg, RTM_GETROUTE, RTMGRP_IPV4_ROUTE */
+#endif
 
 #ifdef __FreeBSD__
 #include <netinet/in.h>
@@ -328,6 +333,312 @@ sockaddr_as_str (const struct sockaddr_storage *addr, char *str)
     }
 }
 
+/* Resolver cache. */
+
+/** Address resolved by getaddrinfo. */
+struct resolve_addr
+{
+  int family;           /**< AF_INET or AF_INET6. */
+  struct in6_addr addr; /**< Address, IPv4 ones in the first 4 bytes. */
+};
+
+/** Entry of the resolver cache. */
+struct resolve_cache_entry
+{
+  gchar *key;                 /**< Family and lowercase name. */
+  int error;                  /**< getaddrinfo error, 0 for a positive one. */
+  struct resolve_addr *addrs; /**< Resolved addresses. */
+  size_t count;               /**< Number of addresses. */
+  gint64 expires;             /**< Monotonic time of expiry. */
+  GList *link;                /**< Link in the insertion queue. */
+};
+
+/**
+ * @brief Resolver cache of gvm_resolve and gvm_resolve_list.
+ */
+static struct
+{
+  GHashTable *entries;        /**< Entries by key. */
+  GQueue queue;               /**< Keys, oldest first, for the size bound. */
+  gboolean disabled;          /**< Whether the cache is opted out of. */
+  unsigned int positive_ttl;  /**< Lifetime of resolved names, seconds. */
+  unsigned int negative_ttl;  /**< Lifetime of unknown names, seconds. */
+  unsigned int max_entries;   /**< Maximum number of entries. */
+  gvm_resolve_cache_stats_t stats; /**< Counters. */
+} resolve_cache = {NULL, G_QUEUE_INIT, FALSE, 300, 30, 4096, {0, 0, 0, 0, 0}};
+
+G_LOCK_DEFINE_STATIC (resolve_cache);
+
+/**
+ * @brief Frees an entry of the resolver cache.
+ *
+ * @param[in]  data  Entry.
+ */
+static void
+resolve_cache_entry_free (gpointer data)
+{
+  struct resolve_cache_entry *entry = data;
+
+  g_queue_delete_link (&resolve_cache.queue, entry->link);
+  g_free (entry->addrs);
+  g_free (entry->key);
+  g_free (entry);
+}
+
+/**
+ * @brief Looks up a name in the resolver cache.
+ *
+ * @param[in]   key    Cache key.
+ * @param[out]  addrs  Copy of the addresses, to be freed by the caller.
+ * @param[out]  count  Number of addresses.
+ * @param[out]  error  getaddrinfo error of the entry.
+ *
+ * @return TRUE if an entry was found, FALSE otherwise.
+ */
+static gboolean
+resolve_cache_get (const gchar *key, struct resolve_addr **addrs,
+                   size_t *count, int *error)
+{
+  struct resolve_cache_entry *entry;
+  gboolean found = FALSE;
+
+  G_LOCK (resolve_cache);
+  entry = resolve_cache.entries
+            ? g_hash_table_lookup (resolve_cache.entries, key)
+            : NULL;
+  if (entry && entry->expires <= g_get_monotonic_time ())
+    {
+      g_hash_table_remove (resolve_cache.entries, key);
+      entry = NULL;
+    }
+  if (entry)
+    {
+      *error = entry->error;
+      *count = entry->count;
+      *addrs = g_malloc (entry->count * sizeof (**addrs));
+      if (entry->count)
+        memcpy (*addrs, entry->addrs, entry->count * sizeof (**addrs));
+      if (entry->error)
+        resolve_cache.stats.negative_hits++;
+      else
+        resolve_cache.stats.hits++;
+      found = TRUE;
+    }
+  else
+    resolve_cache.stats.misses++;
+  G_UNLOCK (resolve_cache);
+  return found;
+}
+
+/**
+ * @brief Adds the result of a getaddrinfo call to the resolver cache.
+ *
+ * Names that do not exist are cached for the negative TTL. Other errors, like
+ * temporary failures, are not cached.
+ *
+ * @param[in]  key    Cache key.
+ * @param[in]  addrs  Addresses.
+ * @param[in]  count  Number of addresses.
+ * @param[in]  error  getaddrinfo error.
+ */
+static void
+resolve_cache_put (const gchar *key, const struct resolve_addr *addrs,
+                   size_t count, int error)
+{
+  struct resolve_cache_entry *entry;
+  unsigned int ttl;
+
+  if (error != 0 && error != EAI_NONAME
+#ifdef EAI_NODATA
+      && error != EAI_NODATA
+#endif
+  )
+    return;
+
+  G_LOCK (resolve_cache);
+  ttl = error ? resolve_cache.negative_ttl : resolve_cache.positive_ttl;
+  if (resolve_cache.disabled || ttl == 0 || resolve_cache.max_entries == 0)
+    {
+      G_UNLOCK (resolve_cache);
+      return;
+    }
+  if (resolve_cache.entries == NULL)
+    resolve_cache.entries = g_hash_table_new_full (
+      g_str_hash, g_str_equal, NULL, resolve_cache_entry_free);
+
+  g_hash_table_remove (resolve_cache.entries, key);
+  while (g_hash_table_size (resolve_cache.entries)
+         >= resolve_cache.max_entries)
+    {
+      g_hash_table_remove (resolve_cache.entries,
+                           g_queue_peek_head (&resolve_cache.queue));
+      resolve_cache.stats.evictions++;
+    }
+
+  entry = g_malloc0 (sizeof (*entry));
+  entry->key = g_strdup (key);
+  entry->error = error;
+  entry->count = count;
+  if (count)
+    {
+      entry->addrs = g_malloc (count * sizeof (*addrs));
+      memcpy (entry->addrs, addrs, count * sizeof (*addrs));
+    }
+  entry->expires = g_get_monotonic_time () + (gint64) ttl * G_USEC_PER_SEC;
+  g_queue_push_tail (&resolve_cache.queue, entry->key);
+  entry->link = g_queue_peek_tail_link (&resolve_cache.queue);
+  g_hash_table_insert (resolve_cache.entries, entry->key, entry);
+  G_UNLOCK (resolve_cache);
+}
+
+/**
+ * @brief Resolves a hostname with getaddrinfo, through the resolver cache.
+ *
+ * Numeric addresses bypass the cache.
+ *
+ * @param[in]   name    Hostname to resolve.
+ * @param[in]   family  AF_INET, AF_INET6 or AF_UNSPEC.
+ * @param[out]  count   Number of addresses.
+ * @param[out]  error   getaddrinfo error, 0 on success.
+ *
+ * @return Addresses in the order of getaddrinfo, to be freed with g_free.
+ */
+static struct resolve_addr *
+resolve_addrs (const char *name, int family, size_t *count, int *error)
+{
+  struct addrinfo hints, *info, *p;
+  struct resolve_addr *addrs = NULL;
+  struct in6_addr numeric;
+  gchar *key = NULL, *lower;
+  size_t size = 0;
+
+  *count = 0;
+  if (!resolve_cache.disabled && inet_pton (AF_INET, name, &numeric) != 1
+      && inet_pton (AF_INET6, name, &numeric) != 1)
+    {
+      lower = g_ascii_strdown (name, -1);
+      key = g_strdup_printf ("%d/%s", family, lower);
+      g_free (lower);
+      if (resolve_cache_get (key, &addrs, count, error))
+        {
+          g_free (key);
+          return addrs;
+        }
+    }
+
+  bzero (&hints, sizeof (hints));
+  hints.ai_family = family;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_protocol = 0;
+  *error = getaddrinfo (name, NULL, &hints, &info);
+  if (*error == 0)
+    {
+      for (p = info; p; p = p->ai_next)
+        {
+          if (p->ai_family != AF_INET && p->ai_family != AF_INET6)
+            continue;
+          if (*count == size)
+            {
+              size = size ? size * 2 : 4;
+              addrs = g_realloc_n (addrs, size, sizeof (*addrs));
+            }
+          memset (&addrs[*count], 0, sizeof (*addrs));
+          addrs[*count].family = p->ai_family;
+          if (p->ai_family == AF_INET)
+            memcpy (&addrs[*count].addr,
+                    &((struct sockaddr_in *) p->ai_addr)->sin_addr,
+                    sizeof (struct in_addr));
+          else
+            memcpy (&addrs[*count].addr,
+                    &((struct sockaddr_in6 *) p->ai_addr)->sin6_addr,
+                    sizeof (struct in6_addr));
+          (*count)++;
+        }
+      freeaddrinfo (info);
+    }
+
+  if (key)
+    resolve_cache_put (key, addrs, *count, *error);
+  g_free (key);
+  return addrs;
+}
+
+/**
+ * @brief Opts in or out of the resolver cache.
+ *
+ * The cache is enabled by default. Disabling it also empties it.
+ *
+ * @param[in]  enabled  Whether to cache the results of the resolver.
+ */
+void
+gvm_resolve_cache_set_enabled (int enabled)
+{
+  G_LOCK (resolve_cache);
+  resolve_cache.disabled = !enabled;
+  if (resolve_cache.disabled && resolve_cache.entries)
+    g_hash_table_remove_all (resolve_cache.entries);
+  G_UNLOCK (resolve_cache);
+}
+
+/**
+ * @brief Sets the lifetimes and the size bound of the resolver cache.
+ *
+ * Defaults are 300 and 30 seconds and 4096 entries. Existing entries keep
+ * their expiry.
+ *
+ * @param[in]  positive_ttl  Seconds to cache resolved names, 0 not to.
+ * @param[in]  negative_ttl  Seconds to cache unknown names, 0 not to.
+ * @param[in]  max_entries   Maximum number of entries, the oldest ones being
+ *                           evicted first.
+ */
+void
+gvm_resolve_cache_set_limits (unsigned int positive_ttl,
+                              unsigned int negative_ttl,
+                              unsigned int max_entries)
+{
+  G_LOCK (resolve_cache);
+  resolve_cache.positive_ttl = positive_ttl;
+  resolve_cache.negative_ttl = negative_ttl;
+  resolve_cache.max_entries = max_entries;
+  while (resolve_cache.entries
+         && g_hash_table_size (resolve_cache.entries) > max_entries)
+    {
+      g_hash_table_remove (resolve_cache.entries,
+                           g_queue_peek_head (&resolve_cache.queue));
+      resolve_cache.stats.evictions++;
+    }
+  G_UNLOCK (resolve_cache);
+}
+
+/**
+ * @brief Empties the resolver cache.
+ */
+void
+gvm_resolve_cache_clear (void)
+{
+  G_LOCK (resolve_cache);
+  if (resolve_cache.entries)
+    g_hash_table_remove_all (resolve_cache.entries);
+  G_UNLOCK (resolve_cache);
+}
+
+/**
+ * @brief Gets the counters of the resolver cache.
+ *
+ * @param[out]  stats  Counters, with the current number of entries.
+ */
+void
+gvm_resolve_cache_get_stats (gvm_resolve_cache_stats_t *stats)
+{
+  if (stats == NULL)
+    return;
+  G_LOCK (resolve_cache);
+  *stats = resolve_cache.stats;
+  stats->entries =
+    resolve_cache.entries ? g_hash_table_size (resolve_cache.entries) : 0;
+  G_UNLOCK (resolve_cache);
+}
+
 /**
  * @brief Returns a list of addresses that a hostname resolves to.
  *
@@ -338,40 +649,27 @@ sockaddr_as_str (const struct sockaddr_storage *addr, char *str)
 GSList *
 gvm_resolve_list (const char *name)
 {
-  struct addrinfo hints, *info, *p;
+  struct resolve_addr *addrs;
   GSList *list = NULL;
+  size_t count, i;
+  int error;
 
   if (name == NULL)
     return NULL;
 
-  bzero (&hints, sizeof (hints));
-  hints.ai_family = AF_UNSPEC;
-  hints.ai_socktype = SOCK_STREAM;
-  hints.ai_protocol = 0;
-  if ((getaddrinfo (name, NULL, &hints, &info)) != 0)
-    return NULL;
-
-  p = info;
-  while (p)
+  addrs = resolve_addrs (name, AF_UNSPEC, &count, &error);
+  for (i = 0; i < count; i++)
     {
       struct in6_addr dst;
 
-      if (p->ai_family == AF_INET)
-        {
-          struct sockaddr_in *addrin = (struct sockaddr_in *) p->ai_addr;
-          ipv4_as_ipv6 (&(addrin->sin_addr), &dst);
-          list = g_slist_prepend (list, memdup (&dst, sizeof (dst)));
-        }
-      else if (p->ai_family == AF_INET6)
-        {
-          struct sockaddr_in6 *addrin = (struct sockaddr_in6 *) p->ai_addr;
-          memcpy (&dst, &(addrin->sin6_addr), sizeof (struct in6_addr));
-          list = g_slist_prepend (list, memdup (&dst, sizeof (dst)));
-        }
-      p = p->ai_next;
+      if (addrs[i].family == AF_INET)
+        ipv4_as_ipv6 ((struct in_addr *) &addrs[i].addr, &dst);
+      else
+        memcpy (&dst, &addrs[i].addr, sizeof (struct in6_addr));
+      list = g_slist_prepend (list, memdup (&dst, sizeof (dst)));
     }
 
-  freeaddrinfo (info);
+  g_free (addrs);
   return list;
 }
 
@@ -388,46 +686,33 @@ gvm_resolve_list (const char *name)
 int
 gvm_resolve (const char *name, void *dst, int family)
 {
-  struct addrinfo hints, *info, *p;
+  struct resolve_addr *addrs;
+  size_t count, i;
+  int error;
 
   if (name == NULL || dst == NULL
       || (family != AF_INET && family != AF_INET6 && family != AF_UNSPEC))
     return -1;
 
-  bzero (&hints, sizeof (hints));
-  hints.ai_family = family;
-  hints.ai_socktype = SOCK_STREAM;
-  hints.ai_protocol = 0;
-  if ((getaddrinfo (name, NULL, &hints, &info)) != 0)
+  addrs = resolve_addrs (name, family, &count, &error);
+  if (error)
     return -1;
 
-  p = info;
-  while (p)
+  for (i = 0; i < count; i++)
     {
-      if (p->ai_family == family || family == AF_UNSPEC)
+      if (addrs[i].family == family || family == AF_UNSPEC)
         {
-          if (p->ai_family == AF_INET && family == AF_UNSPEC)
-            {
-              struct sockaddr_in *addrin = (struct sockaddr_in *) p->ai_addr;
-              ipv4_as_ipv6 (&(addrin->sin_addr), dst);
-            }
-          else if (p->ai_family == AF_INET)
-            {
-              struct sockaddr_in *addrin = (struct sockaddr_in *) p->ai_addr;
-              memcpy (dst, &(addrin->sin_addr), sizeof (struct in_addr));
-            }
-          else if (p->ai_family == AF_INET6)
-            {
-              struct sockaddr_in6 *addrin = (struct sockaddr_in6 *) p->ai_addr;
-              memcpy (dst, &(addrin->sin6_addr), sizeof (struct in6_addr));
-            }
+          if (addrs[i].family == AF_INET && family == AF_UNSPEC)
+            ipv4_as_ipv6 ((struct in_addr *) &addrs[i].addr, dst);
+          else if (addrs[i].family == AF_INET)
+            memcpy (dst, &addrs[i].addr, sizeof (struct in_addr));
+          else
+            memcpy (dst, &addrs[i].addr, sizeof (struct in6_addr));
           break;
         }
-
-      p = p->ai_next;
     }
 
-  freeaddrinfo (info);
+  g_free (addrs);
   return 0;
 }
 
@@ -743,6 +1028,185 @@ port_in_port_ranges (int pnum, port_protocol_t ptype, array_t *pranges)
   return 0;
 }
 
+/**
+ * @brief Gets the bitmap of a protocol in a port set.
+ *
+ * @param[in]  set    Port set.
+ * @param[in]  ptype  Port type.
+ *
+ * @return Bitmap, NULL if ptype is neither TCP nor UDP.
+ */
+static const guint64 *
+port_set_bitmap (const port_set_t *set, port_protocol_t ptype)
+{
+  if (ptype == PORT_PROTOCOL_TCP)
+    return set->tcp;
+  if (ptype == PORT_PROTOCOL_UDP)
+    return set->udp;
+  return NULL;
+}
+
+/**
+ * @brief Compiles a port ranges array into a port set, for constant time
+ * lookups.
+ *
+ * @param[in]  pranges  Array of port ranges, as from port_range_ranges.
+ *
+ * @return Port set to be freed with port_set_free, NULL if pranges is NULL.
+ */
+port_set_t *
+port_set_new (array_t *pranges)
+{
+  port_set_t *set;
+  unsigned int i;
+
+  if (pranges == NULL)
+    return NULL;
+
+  set = g_malloc0 (sizeof (*set));
+  for (i = 0; i < pranges->len; i++)
+    {
+      range_t *range = (range_t *) g_ptr_array_index (pranges, i);
+      guint64 *bitmap = (guint64 *) port_set_bitmap (set, range->type);
+      int port, start, end;
+
+      if (bitmap == NULL)
+        continue;
+      start = MAX (range->start, 0);
+      end = MIN (range->end, 65535);
+      port = start;
+      /* Set the bits one by one up to a word boundary, then whole words. */
+      while (port <= end && port % 64)
+        {
+          bitmap[port / 64] |= G_GUINT64_CONSTANT (1) << (port % 64);
+          port++;
+        }
+      while (port + 63 <= end)
+        {
+          bitmap[port / 64] = G_MAXUINT64;
+          port += 64;
+        }
+      while (port <= end)
+        {
+          bitmap[port / 64] |= G_GUINT64_CONSTANT (1) << (port % 64);
+          port++;
+        }
+    }
+  return set;
+}
+
+/**
+ * @brief Creates a port set from a port_range string.
+ *
+ * @param[in]   port_range  Valid port_range string.
+ *
+ * @return Port set to be freed with port_set_free, NULL if port_range is
+ * invalid or NULL.
+ */
+port_set_t *
+port_range_port_set (const char *port_range)
+{
+  array_t *ranges;
+  port_set_t *set;
+
+  ranges = port_range_ranges (port_range);
+  if (ranges == NULL)
+    return NULL;
+  set = port_set_new (ranges);
+  array_free (ranges);
+  return set;
+}
+
+/**
+ * @brief Frees a port set.
+ *
+ * @param[in]  set  Port set.
+ */
+void
+port_set_free (port_set_t *set)
+{
+  g_free (set);
+}
+
+/**
+ * @brief Checks if a port num is in a port set.
+ *
+ * @param[in]  pnum   Port number.
+ * @param[in]  ptype  Port type.
+ * @param[in]  set    Port set.
+ *
+ * @return 1 if port in port set, 0 otherwise.
+ */
+int
+port_in_port_set (int pnum, port_protocol_t ptype, const port_set_t *set)
+{
+  const guint64 *bitmap;
+
+  if (set == NULL || pnum < 0 || pnum > 65535)
+    return 0;
+  bitmap = port_set_bitmap (set, ptype);
+  if (bitmap == NULL)
+    return 0;
+  return (bitmap[pnum / 64] >> (pnum % 64)) & 1;
+}
+
+/**
+ * @brief Counts the ports of a protocol in a port set.
+ *
+ * @param[in]  set    Port set.
+ * @param[in]  ptype  Port type.
+ *
+ * @return Number of ports.
+ */
+int
+port_set_count (const port_set_t *set, port_protocol_t ptype)
+{
+  const guint64 *bitmap;
+  int i, count = 0;
+
+  if (set == NULL || (bitmap = port_set_bitmap (set, ptype)) == NULL)
+    return 0;
+  for (i = 0; i < 1024; i++)
+    count += __builtin_popcountll (bitmap[i]);
+  return count;
+}
+
+/**
+ * @brief Gets the next port of a protocol in a port set.
+ *
+ * To iterate: for (p = port_set_next (set, t, 0); p >= 0;
+ * p = port_set_next (set, t, p + 1)).
+ *
+ * @param[in]  set    Port set.
+ * @param[in]  ptype  Port type.
+ * @param[in]  from   Port to start from, included.
+ *
+ * @return Lowest port >= from in the set, -1 if none.
+ */
+int
+port_set_next (const port_set_t *set, port_protocol_t ptype, int from)
+{
+  const guint64 *bitmap;
+  guint64 word;
+  int i;
+
+  if (set == NULL || (bitmap = port_set_bitmap (set, ptype)) == NULL
+      || from > 65535)
+    return -1;
+  if (from < 0)
+    from = 0;
+
+  i = from / 64;
+  word = bitmap[i] & (G_MAXUINT64 << (from % 64));
+  while (!word)
+    {
+      if (++i == 1024)
+        return -1;
+      word = bitmap[i];
+    }
+  return i * 64 + __builtin_ctzll (word);
+}
+
 /**
  * @brief Checks if IPv6 support is enabled.
  *
@@ -976,11 +1440,602 @@ get_routes (void)
   return routes;
 }
 
+/**
+ * @brief Frees a list of route_entry structs.
+ *
+ * @param[in]  routes  List from get_routes.
+ */
+static void
+routes_free (GSList *routes)
+{
+  GSList *routes_p;
+
+  for (routes_p = routes; routes_p; routes_p = routes_p->next)
+    {
+      g_free (((route_entry_t *) (routes_p->data))->interface);
+      g_free (routes_p->data);
+    }
+  g_slist_free (routes);
+}
+
+/** Route of the routing cache. */
+struct route_info
+{
+  gchar interface[IFNAMSIZ]; /**< Name of the outgoing interface. */
+  guint32 metric;            /**< Metric, lower is preferred. */
+};
+
+/** Node of a path compressed binary trie of route prefixes. */
+struct route_node
+{
+  guint8 key[16];               /**< Prefix, the bits past plen are zero. */
+  int plen;                     /**< Prefix length in bits. */
+  int has_route;                /**< Whether route is set. */
+  struct route_info route;      /**< Route of the prefix. */
+  struct route_node *child[2];  /**< Subtries by the bit after the prefix. */
+};
+
+/**
+ * @brief Routing cache, loaded via netlink and invalidated by route change
+ * notifications.
+ */
+static struct
+{
+  struct route_node *v4; /**< Trie of the IPv4 routes. */
+  struct route_node *v6; /**< Trie of the IPv6 routes. */
+  int monitor;           /**< Netlink socket for route notifications. */
+  pid_t pid;             /**< Process owning the monitor socket. */
+  gboolean valid;        /**< Whether the tries can be used. */
+} route_cache = {NULL, NULL, -1, 0, FALSE};
+
+G_LOCK_DEFINE_STATIC (route_cache);
+
+/**
+ * @brief Gets a bit of a route key.
+ *
+ * @param[in]  key  Key.
+ * @param[in]  bit  Bit index, 0 being the most significant bit.
+ *
+ * @return Bit.
+ */
+static int
+route_key_bit (const guint8 *key, int bit)
+{
+  return (key[bit / 8] >> (7 - bit % 8)) & 1;
+}
+
+/**
+ * @brief Counts the leading bits two route keys have in common.
+ *
+ * @param[in]  a    First key.
+ * @param[in]  b    Second key.
+ * @param[in]  max  Maximum number of bits to compare.
+ *
+ * @return Number of common leading bits, at most max.
+ */
+static int
+route_key_common (const guint8 *a, const guint8 *b, int max)
+{
+  int bit = 0;
+
+  while (bit < max)
+    {
+      guint8 diff = a[bit / 8] ^ b[bit / 8];
+
+      if (diff)
+        {
+          bit += __builtin_clz (diff) - 24;
+          break;
+        }
+      bit += 8;
+    }
+  return MIN (bit, max);
+}
+
+/**
+ * @brief Creates a route trie node.
+ *
+ * @param[in]  key   Key, only the first plen bits are used.
+ * @param[in]  plen  Prefix length.
+ * @param[in]  info  Route of the prefix, NULL for none.
+ *
+ * @return New node.
+ */
+static struct route_node *
+route_node_new (const guint8 *key, int plen, const struct route_info *info)
+{
+  struct route_node *node = g_malloc0 (sizeof (*node));
+
+  memcpy (node->key, key, (plen + 7) / 8);
+  if (plen % 8)
+    node->key[plen / 8] &= 0xff << (8 - plen % 8);
+  node->plen = plen;
+  if (info)
+    {
+      node->route = *info;
+      node->has_route = 1;
+    }
+  return node;
+}
+
+/**
+ * @brief Adds a route to a route trie.
+ *
+ * Of several routes to the same prefix the one with the lowest metric is
+ * kept, the last one added on equal metrics.
+ *
+ * @param[in]  link  Root of the trie.
+ * @param[in]  key   Prefix.
+ * @param[in]  plen  Prefix length.
+ * @param[in]  info  Route.
+ */
+static void
+route_trie_insert (struct route_node **link, const guint8 *key, int plen,
+                   const struct route_info *info)
+{
+  struct route_node *node, *leaf, *glue;
+  int common = 0;
+
+  while ((node = *link) != NULL)
+    {
+      common = route_key_common (node->key, key, MIN (node->plen, plen));
+      if (common < node->plen)
+        break;
+      if (node->plen == plen)
+        {
+          if (!node->has_route || info->metric <= node->route.metric)
+            {
+              node->route = *info;
+              node->has_route = 1;
+            }
+          return;
+        }
+      link = &node->child[route_key_bit (key, node->plen)];
+    }
+
+  leaf = route_node_new (key, plen, info);
+  if (node == NULL)
+    *link = leaf;
+  else if (common == plen)
+    {
+      /* The new prefix covers the node. */
+      leaf->child[route_key_bit (node->key, plen)] = node;
+      *link = leaf;
+    }
+  else
+    {
+      /* The prefixes diverge after common bits. */
+      glue = route_node_new (key, common, NULL);
+      glue->child[route_key_bit (key, common)] = leaf;
+      glue->child[route_key_bit (node->key, common)] = node;
+      *link = glue;
+    }
+}
+
+/**
+ * @brief Finds the route with the longest prefix matching an address.
+ *
+ * @param[in]  node  Root of the trie.
+ * @param[in]  addr  Address.
+ * @param[in]  bits  Length of the address in bits.
+ *
+ * @return Route, NULL if no prefix matches.
+ */
+static const struct route_info *
+route_trie_lookup (const struct route_node *node, const guint8 *addr,
+                   int bits)
+{
+  const struct route_info *best = NULL;
+
+  while (node && route_key_common (node->key, addr, node->plen) == node->plen)
+    {
+      if (node->has_route)
+        best = &node->route;
+      if (node->plen >= bits)
+        break;
+      node = node->child[route_key_bit (addr, node->plen)];
+    }
+  return best;
+}
+
+/**
+ * @brief Frees a route trie.
+ *
+ * @param[in]  node  Root of the trie.
+ */
+static void
+route_trie_free (struct route_node *node)
+{
+  if (node == NULL)
+    return;
+  route_trie_free (node->child[0]);
+  route_trie_free (node->child[1]);
+  g_free (node);
+}
+
+/**
+ * @brief Frees the routes of the routing cache.
+ */
+static void
+route_cache_drop (void)
+{
+  route_trie_free (route_cache.v4);
+  route_trie_free (route_cache.v6);
+  route_cache.v4 = route_cache.v6 = NULL;
+  route_cache.valid = FALSE;
+}
+
+/**
+ * @brief Loads the IPv4 routes of /proc/net/route into the routing cache.
+ */
+static void
+route_cache_load_proc (void)
+{
+  GSList *routes, *routes_p;
+
+  routes = get_routes ();
+  for (routes_p = routes; routes_p; routes_p = routes_p->next)
+    {
+      route_entry_t *entry = routes_p->data;
+      struct route_info info;
+      guint32 dest = entry->dest;
+      guint8 key[16] = {0};
+
+      memset (&info, 0, sizeof (info));
+      g_strlcpy (info.interface, entry->interface, sizeof (info.interface));
+      memcpy (key, &dest, sizeof (dest));
+      route_trie_insert (&route_cache.v4, key,
+                         __builtin_popcountl (entry->mask & 0xffffffff),
+                         &info);
+    }
+  routes_free (routes);
+}
+
+#ifdef __linux__
+/**
+ * @brief Adds the route of a RTM_NEWROUTE message to the routing cache.
+ *
+ * Only the unicast routes of the main table are used, as in /proc/net/route.
+ *
+ * @param[in]  nlh  Netlink message.
+ */
+static void
+route_cache_add_netlink (struct nlmsghdr *nlh)
+{
+  struct rtmsg *rtm = NLMSG_DATA (nlh);
+  struct route_info info;
+  struct rtattr *rta;
+  guint8 key[16] = {0};
+  guint32 table;
+  int len, ifindex = 0;
+
+  if ((rtm->rtm_family != AF_INET && rtm->rtm_family != AF_INET6)
+      || rtm->rtm_type != RTN_UNICAST)
+    return;
+
+  memset (&info, 0, sizeof (info));
+  table = rtm->rtm_table;
+  len = RTM_PAYLOAD (nlh);
+  for (rta = RTM_RTA (rtm); RTA_OK (rta, len); rta = RTA_NEXT (rta, len))
+    {
+      switch (rta->rta_type)
+        {
+        case RTA_DST:
+          memcpy (key, RTA_DATA (rta), MIN ((size_t) RTA_PAYLOAD (rta), 16));
+          break;
+        case RTA_OIF:
+          ifindex = *(int *) RTA_DATA (rta);
+          break;
+        case RTA_PRIORITY:
+          info.metric = *(guint32 *) RTA_DATA (rta);
+          break;
+        case RTA_TABLE:
+          table = *(guint32 *) RTA_DATA (rta);
+          break;
+        case RTA_MULTIPATH:
+          /* Use the first next hop. */
+          if (ifindex == 0
+              && (size_t) RTA_PAYLOAD (rta) >= sizeof (struct rtnexthop))
+            ifindex = ((struct rtnexthop *) RTA_DATA (rta))->rtnh_ifindex;
+          break;
+        }
+    }
+
+  if (table != RT_TABLE_MAIN || ifindex == 0
+      || if_indextoname (ifindex, info.interface) == NULL)
+    return;
+  route_trie_insert (rtm->rtm_family == AF_INET ? &route_cache.v4
+                                                : &route_cache.v6,
+                     key, rtm->rtm_dst_len, &info);
+}
+#endif
+
+/**
+ * @brief Loads the routing table into the routing cache via netlink.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+route_cache_load_netlink (void)
+{
+#ifdef __linux__
+  struct
+  {
+    struct nlmsghdr nlh;
+    struct rtmsg rtm;
+  } req;
+  struct sockaddr_nl addr;
+  guint32 buf[8192];
+  int fd, ret = -1;
+
+  fd = socket (AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+  if (fd < 0)
+    return -1;
+
+  memset (&req, 0, sizeof (req));
+  req.nlh.nlmsg_len = NLMSG_LENGTH (sizeof (struct rtmsg));
+  req.nlh.nlmsg_type = RTM_GETROUTE;
+  req.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+  req.nlh.nlmsg_seq = 1;
+  req.rtm.rtm_family = AF_UNSPEC;
+  memset (&addr, 0, sizeof (addr));
+  addr.nl_family = AF_NETLINK;
+  if (sendto (fd, &req, req.nlh.nlmsg_len, 0, (struct sockaddr *) &addr,
+              sizeof (addr))
+      < 0)
+    goto out;
+
+  while (1)
+    {
+      struct nlmsghdr *nlh;
+      int len;
+
+      len = recv (fd, buf, sizeof (buf), 0);
+      if (len < 0 && errno == EINTR)
+        continue;
+      if (len <= 0)
+        goto out;
+      for (nlh = (struct nlmsghdr *) buf; NLMSG_OK (nlh, len);
+           nlh = NLMSG_NEXT (nlh, len))
+        {
+          if (nlh->nlmsg_type == NLMSG_DONE)
+            {
+              ret = 0;
+              goto out;
+            }
+          if (nlh->nlmsg_type == NLMSG_ERROR)
+            goto out;
+          if (nlh->nlmsg_type == RTM_NEWROUTE)
+            route_cache_add_netlink (nlh);
+        }
+    }
+
+out:
+  close (fd);
+  if (ret)
+    g_debug ("%s: Failed to dump the routing table: %s", __func__,
+             strerror (errno));
+  return ret;
+#else
+  return -1;
+#endif
+}
+
+/**
+ * @brief Opens the netlink socket notifying of route and link changes.
+ *
+ * @return Non-blocking socket, -1 on error.
+ */
+static int
+route_cache_monitor_open (void)
+{
+#ifdef __linux__
+  struct sockaddr_nl addr;
+  int fd;
+
+  fd = socket (AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC | SOCK_NONBLOCK,
+               NETLINK_ROUTE);
+  if (fd < 0)
+    return -1;
+  memset (&addr, 0, sizeof (addr));
+  addr.nl_family = AF_NETLINK;
+  addr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_ROUTE | RTMGRP_IPV6_ROUTE;
+  if (bind (fd, (struct sockaddr *) &addr, sizeof (addr)) < 0)
+    {
+      close (fd);
+      return -1;
+    }
+  return fd;
+#else
+  return -1;
+#endif
+}
+
+/**
+ * @brief Drains the pending notifications of the monitor socket.
+ *
+ * @return TRUE if the routes may have changed since the last call.
+ */
+static gboolean
+route_cache_changed (void)
+{
+  guint32 buf[1024];
+  gboolean changed = FALSE;
+
+  if (route_cache.monitor < 0)
+    return TRUE;
+
+  while (1)
+    {
+      ssize_t len = recv (route_cache.monitor, buf, sizeof (buf), 0);
+
+      if (len > 0 || (len < 0 && errno == EINTR))
+        changed |= len > 0;
+      else if (len < 0 && errno == ENOBUFS)
+        /* Notifications were dropped. */
+        changed = TRUE;
+      else if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        break;
+      else
+        {
+          close (route_cache.monitor);
+          route_cache.monitor = -1;
+          return TRUE;
+        }
+    }
+  return changed;
+}
+
+/**
+ * @brief Reloads the routing cache.
+ *
+ * Without netlink the cache falls back to /proc/net/route and is reloaded on
+ * every lookup.
+ */
+static void
+route_cache_reload (void)
+{
+  route_cache_drop ();
+
+  /* A forked child must not share the notifications with its parent. */
+  if (route_cache.pid != getpid ())
+    {
+      if (route_cache.monitor >= 0)
+        close (route_cache.monitor);
+      route_cache.monitor = -1;
+      route_cache.pid = getpid ();
+    }
+  /* Subscribe before dumping, to see the changes made during the dump. */
+  if (route_cache.monitor < 0)
+    route_cache.monitor = route_cache_monitor_open ();
+
+  if (route_cache.monitor >= 0 && route_cache_load_netlink () == 0)
+    {
+      route_cache.valid = TRUE;
+      return;
+    }
+  route_cache_drop ();
+  route_cache_load_proc ();
+}
+
+/**
+ * @brief Finds the route to an address in the routing cache.
+ *
+ * @param[in]   family  Address family, AF_INET or AF_INET6.
+ * @param[in]   addr    Address, struct in_addr or struct in6_addr.
+ * @param[out]  info    Route found.
+ *
+ * @return 0 if a route was found, -1 otherwise.
+ */
+static int
+route_cache_lookup (int family, const void *addr, struct route_info *info)
+{
+  const struct route_info *found;
+  guint8 key[16] = {0};
+
+  memcpy (key, addr, family == AF_INET ? 4 : 16);
+
+  G_LOCK (route_cache);
+  if (route_cache.pid != getpid () || route_cache_changed ()
+      || !route_cache.valid)
+    route_cache_reload ();
+  found = family == AF_INET ? route_trie_lookup (route_cache.v4, key, 32)
+                            : route_trie_lookup (route_cache.v6, key, 128);
+  if (found)
+    *info = *found;
+  G_UNLOCK (route_cache);
+
+  return found ? 0 : -1;
+}
+
+/**
+ * @brief Empties the routing cache of gvm_routethrough.
+ *
+ * The cache is reloaded on the next lookup.  Route changes are noticed
+ * without this, so this is only needed to release the memory.
+ */
+void
+gvm_routes_cache_clear (void)
+{
+  G_LOCK (route_cache);
+  route_cache_drop ();
+  G_UNLOCK (route_cache);
+}
+
+/**
+ * @brief Sets the source address for a route.
+ *
+ * Uses the global source address if set, else an address of the interface,
+ * for IPv6 preferably not a link-local one.
+ *
+ * @param[in]   family          Address family, AF_INET or AF_INET6.
+ * @param[in]   ifaddr          Interface addresses.
+ * @param[in]   interface       Outgoing interface.
+ * @param[out]  storage_source  Source address.
+ */
+static void
+routethrough_set_source (int family, struct ifaddrs *ifaddr,
+                         const char *interface,
+                         struct sockaddr_storage *storage_source)
+{
+  struct sockaddr_in *sin_src_p = (struct sockaddr_in *) storage_source;
+  struct sockaddr_in6 *sin6_src_p = (struct sockaddr_in6 *) storage_source;
+  struct ifaddrs *ifa;
+  gboolean found = FALSE;
+
+  if (family == AF_INET)
+    {
+      struct in_addr global_src;
+
+      gvm_source_addr (&global_src);
+      if (global_src.s_addr != INADDR_ANY)
+        {
+          sin_src_p->sin_addr.s_addr = global_src.s_addr;
+          return;
+        }
+    }
+  else
+    {
+      struct in6_addr global_src6;
+
+      gvm_source_addr6 (&global_src6);
+      if (!IN6_IS_ADDR_UNSPECIFIED (&global_src6))
+        {
+          memcpy (&sin6_src_p->sin6_addr, &global_src6, sizeof (global_src6));
+          return;
+        }
+    }
+
+  for (ifa = ifaddr; ifa != NULL; ifa = ifa->ifa_next)
+    {
+      if (ifa->ifa_addr == NULL || ifa->ifa_addr->sa_family != family
+          || g_strcmp0 (interface, ifa->ifa_name))
+        continue;
+      if (family == AF_INET)
+        {
+          sin_src_p->sin_addr.s_addr =
+            ((struct sockaddr_in *) (ifa->ifa_addr))->sin_addr.s_addr;
+          return;
+        }
+      if (!found
+          || !IN6_IS_ADDR_LINKLOCAL (
+            &((struct sockaddr_in6 *) (ifa->ifa_addr))->sin6_addr))
+        {
+          memcpy (&sin6_src_p->sin6_addr,
+                  &((struct sockaddr_in6 *) (ifa->ifa_addr))->sin6_addr,
+                  sizeof (struct in6_addr));
+          found = TRUE;
+          if (!IN6_IS_ADDR_LINKLOCAL (&sin6_src_p->sin6_addr))
+            return;
+        }
+    }
+}
+
 /**
  * @brief Get Interface which should be used for routing to destination addr.
  *
- * This function should be used sparingly as it parses /proc/net/route for
- * every call.
+ * The routes are looked up in a cache of the routing table, loaded once via
+ * netlink and reloaded when the kernel notifies of a route change.
  *
  * @param[in]   storage_dest    Destination address.
  * @param[out]  storage_source  Source address. Is set to either address of the
@@ -996,121 +2051,70 @@ gvm_routethrough (struct sockaddr_storage *storage_dest,
 {
   struct ifaddrs *ifaddr, *ifa;
   gchar *interface_out;
+  int family;
 
   interface_out = NULL;
 
   if (!storage_dest)
     return NULL;
 
+  family = storage_dest->ss_family;
+  if (family != AF_INET && family != AF_INET6)
+    return NULL;
+
   if (getifaddrs (&ifaddr) == -1)
     {
       g_debug ("%s: getifaddr failed: %s", __func__, strerror (errno));
       return NULL;
     }
 
-  /* IPv4. */
-  if (storage_dest->ss_family == AF_INET)
+  /* Set storage_source to localhost if storage_source was supplied and
+   * return name of loopback interface. */
+  if (ip_islocalhost (storage_dest))
     {
-      GSList *routes;
-      GSList *routes_p;
-
-      routes = get_routes ();
-
-      /* Set storage_source to localhost if storage_source was supplied and
-       * return name of loopback interface. */
-      if (ip_islocalhost (storage_dest))
+      // TODO: check for (storage_source->ss_family == family)
+      if (storage_source && family == AF_INET)
         {
-          // TODO: check for (storage_source->ss_family == AF_INET)
-          if (storage_source)
-            {
-              struct sockaddr_in *sin_p = (struct sockaddr_in *) storage_source;
-              sin_p->sin_addr.s_addr = htonl (0x7F000001);
-            }
-
-          for (ifa = ifaddr; ifa != NULL; ifa = ifa->ifa_next)
-            {
-              if (ifa->ifa_addr && (ifa->ifa_addr->sa_family == AF_INET)
-                  && (ifa->ifa_flags & (IFF_LOOPBACK)))
-                {
-                  interface_out = g_strdup (ifa->ifa_name);
-                  break;
-                }
-            }
+          struct sockaddr_in *sin_p = (struct sockaddr_in *) storage_source;
+          sin_p->sin_addr.s_addr = htonl (0x7F000001);
         }
-      else
+      else if (storage_source)
         {
-          struct sockaddr_in *sin_dest_p, *sin_src_p;
-          struct in_addr global_src;
-          unsigned long best_match;
-
-          /* Check if global_source_addr in use. */
-          gvm_source_addr (&global_src);
-
-          sin_dest_p = (struct sockaddr_in *) storage_dest;
-          sin_src_p = (struct sockaddr_in *) storage_source;
-          /* Check routes for matching address. Get interface name and set
-           * storage_source*/
-          for (best_match = 0, routes_p = routes; routes_p;
-               routes_p = routes_p->next)
-            {
-              if (((sin_dest_p->sin_addr.s_addr
-                    & ((route_entry_t *) (routes_p->data))->mask)
-                   == ((route_entry_t *) (routes_p->data))->dest)
-                  && (((route_entry_t *) (routes_p->data))->mask >= best_match))
-                {
-                  /* Interface of matching route.*/
-                  g_free (interface_out);
-                  interface_out =
-                    g_strdup (((route_entry_t *) (routes_p->data))->interface);
-                  best_match = ((route_entry_t *) (routes_p->data))->mask;
-
-                  if (!storage_source)
-                    continue;
-
-                  /* Set storage_source to global source if global source
-                   * present.*/
-                  if (global_src.s_addr != INADDR_ANY)
-                    sin_src_p->sin_addr.s_addr = global_src.s_addr;
-                  /* Set storage_source to addr of matching interface if no
-                   * global source present.*/
-                  else
-                    {
-                      for (ifa = ifaddr; ifa != NULL; ifa = ifa->ifa_next)
-                        {
-                          if (ifa->ifa_addr
-                              && (ifa->ifa_addr->sa_family == AF_INET)
-                              && (g_strcmp0 (interface_out, ifa->ifa_name)
-                                  == 0))
-                            {
-                              sin_src_p->sin_addr.s_addr =
-                                ((struct sockaddr_in *) (ifa->ifa_addr))
-                                  ->sin_addr.s_addr;
-                              break;
-                            }
-                        }
-                    }
-                }
-            }
+          struct sockaddr_in6 *sin6_p = (struct sockaddr_in6 *) storage_source;
+          sin6_p->sin6_addr = in6addr_loopback;
         }
-      /* Free GSList. */
-      if (routes)
+
+      for (ifa = ifaddr; ifa != NULL; ifa = ifa->ifa_next)
         {
-          for (routes_p = routes; routes_p; routes_p = routes_p->next)
+          if (ifa->ifa_addr && (ifa->ifa_addr->sa_family == family)
+              && (ifa->ifa_flags & (IFF_LOOPBACK)))
             {
-              if (((route_entry_t *) (routes_p->data))->interface)
-                g_free (((route_entry_t *) (routes_p->data))->interface);
+              interface_out = g_strdup (ifa->ifa_name);
+              break;
             }
-          g_slist_free (routes);
         }
     }
-  else if (storage_dest->ss_family == AF_INET6)
+  else
     {
-      g_warning ("%s: IPv6 not yet implemented for this function. Will be "
-                 "implemented soon. Thanks for your patience.",
-                 __func__);
+      struct route_info route;
+      const void *dest;
+
+      if (family == AF_INET)
+        dest = &((struct sockaddr_in *) storage_dest)->sin_addr;
+      else
+        dest = &((struct sockaddr_in6 *) storage_dest)->sin6_addr;
+
+      if (route_cache_lookup (family, dest, &route) == 0)
+        {
+          interface_out = g_strdup (route.interface);
+          if (storage_source)
+            routethrough_set_source (family, ifaddr, interface_out,
+                                     storage_source);
+        }
     }
 
-  return interface_out != NULL ? interface_out : NULL;
+  freeifaddrs (ifaddr);
+  return interface_out;
 }
 
 /**
@@ -1265,13 +2269,14 @@ get_ifname_from_ifaddr (struct sockaddr_storage *target_addr)
 /**
  * @brief Get the outgoing interface name for a given destination addr.
  *
- * A UDP socket is connected and its address retrieved. The address is the
- * address of the interface of the outgoing interface. Its is determined by
- * the kernel. We then search the list of interfaces for this address to
- * determine the interface name. This method has the downside that if two
- * interfaces with same addr are UP, a wrong interface might be returned because
- * we can only retrieve the interface addr which was chosen by the kernel and
- * nothing else (like e.g. interface number).
+ * The interface of the matching route of the routing cache is used if there
+ * is one. Otherwise a UDP socket is connected and its address retrieved.
+ * The address is the address of the interface of the outgoing interface. Its
+ * is determined by the kernel. We then search the list of interfaces for this
+ * address to determine the interface name. This method has the downside that
+ * if two interfaces with same addr are UP, a wrong interface might be returned
+ * because we can only retrieve the interface addr which was chosen by the
+ * kernel and nothing else (like e.g. interface number).
  *
  * @param[in]   target_addr    Destination address.
  *
@@ -1286,10 +2291,24 @@ gvm_get_outgoing_iface (struct sockaddr_storage *target_addr)
   char *out_iface_str;
 
   out_iface_str = NULL;
-  family = target_addr->ss_family;
 
   if (!target_addr)
     return NULL;
+  family = target_addr->ss_family;
+
+  if (family == AF_INET || family == AF_INET6)
+    {
+      struct route_info route;
+      const void *dest;
+
+      if (family == AF_INET)
+        dest = &((struct sockaddr_in *) target_addr)->sin_addr;
+      else
+        dest = &((struct sockaddr_in6 *) target_addr)->sin6_addr;
+      if (!ip_islocalhost (target_addr)
+          && route_cache_lookup (family, dest, &route) == 0)
+        return g_strdup (route.interface);
+    }
 
   // get a connected udp socket
   if ((sockfd = get_connected_udp_sock (target_addr)) < 0)
@@ -1298,6 +2317,7 @@ gvm_get_outgoing_iface (struct sockaddr_storage *target_addr)
   out_iface_addr.ss_family = family;
   if (get_sock_addr (sockfd, &out_iface_addr) < 0)
     return NULL;
+  close (sockfd);
   // get interface name form interface address
   out_iface_str = get_ifname_from_ifaddr (&out_iface_addr);
   return out_iface_str;
@@ -42,6 +42,28 @@ struct range
 };
 typedef struct range range_t;
 
+/**
+ * @brief A compiled set of ports: one bit per TCP and per UDP port.
+ */
+struct port_set
+{
+  guint64 tcp[1024]; /**< Bitmap of the TCP ports. */
+  guint64 udp[1024]; /**< Bitmap of the UDP ports. */
+};
+typedef struct port_set port_set_t;
+
+/**
+ * @brief Counters of the resolver cache.
+ */
+typedef struct
+{
+  guint64 hits;          /**< Lookups answered with addresses. */
+  guint64 negative_hits; /**< Lookups answered with an unknown name. */
+  guint64 misses;        /**< Lookups passed on to the resolver. */
+  guint64 evictions;     /**< Entries evicted by the size bound. */
+  guint entries;         /**< Current number of entries. */
+} gvm_resolve_cache_stats_t;
+
 int
 gvm_source_iface_init (const char *);
 
@@ -87,6 +109,18 @@ gvm_resolve_list (const char *);
 int
 gvm_resolve_as_addr6 (const char *, struct in6_addr *);
 
+void
+gvm_resolve_cache_set_enabled (int);
+
+void
+gvm_resolve_cache_set_limits (unsigned int, unsigned int, unsigned int);
+
+void
+gvm_resolve_cache_clear (void);
+
+void
+gvm_resolve_cache_get_stats (gvm_resolve_cache_stats_t *);
+
 int
 validate_port_range (const char *);
 
@@ -96,6 +130,24 @@ port_range_ranges (const char *);
 int
 port_in_port_ranges (int, port_protocol_t, array_t *);
 
+port_set_t *
+port_set_new (array_t *);
+
+port_set_t *
+port_range_port_set (const char *);
+
+void
+port_set_free (port_set_t *);
+
+int
+port_in_port_set (int, port_protocol_t, const port_set_t *);
+
+int
+port_set_count (const port_set_t *, port_protocol_t);
+
+int
+port_set_next (const port_set_t *, port_protocol_t, int);
+
 int
 ipv6_is_enabled (void);
 
@@ -105,4 +157,7 @@ gvm_routethrough (struct sockaddr_storage *, struct sockaddr_storage *);
 char *
 gvm_get_outgoing_iface (struct sockaddr_storage *);
 
+void
+gvm_routes_cache_clear (void);
+
 #endif /* not _GVM_NETWORKING_H */
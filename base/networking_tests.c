@@ -922,8 +922,79 @@ Ensure (networking, port_in_port_ranges)
                is_false);
 }
 
+Ensure (networking, port_in_port_set)
+{
+  port_set_t *set;
+
+  set = port_range_port_set ("1,10-12,10-10,T:1-2,U:10-14,U:,T:,T:60-200");
+  assert_that (set, is_not_null);
+
+  assert_that (port_in_port_set (1, PORT_PROTOCOL_TCP, set), is_true);
+  assert_that (port_in_port_set (12, PORT_PROTOCOL_TCP, set), is_true);
+  assert_that (port_in_port_set (13, PORT_PROTOCOL_UDP, set), is_true);
+  assert_that (port_in_port_set (128, PORT_PROTOCOL_TCP, set), is_true);
+  assert_that (port_in_port_set (0, PORT_PROTOCOL_TCP, set), is_false);
+  assert_that (port_in_port_set (-1, PORT_PROTOCOL_TCP, set), is_false);
+  assert_that (port_in_port_set (90000, PORT_PROTOCOL_TCP, set), is_false);
+  assert_that (port_in_port_set (1, PORT_PROTOCOL_UDP, set), is_false);
+  assert_that (port_in_port_set (13, PORT_PROTOCOL_TCP, set), is_false);
+  assert_that (port_in_port_set (12, PORT_PROTOCOL_OTHER, set), is_false);
+
+  /* 1-2, 10-12 and 60-200. */
+  assert_that (port_set_count (set, PORT_PROTOCOL_TCP), is_equal_to (146));
+  assert_that (port_set_count (set, PORT_PROTOCOL_UDP), is_equal_to (5));
+
+  assert_that (port_set_next (set, PORT_PROTOCOL_TCP, 0), is_equal_to (1));
+  assert_that (port_set_next (set, PORT_PROTOCOL_TCP, 3), is_equal_to (10));
+  assert_that (port_set_next (set, PORT_PROTOCOL_TCP, 13), is_equal_to (60));
+  assert_that (port_set_next (set, PORT_PROTOCOL_TCP, 201), is_equal_to (-1));
+  assert_that (port_set_next (set, PORT_PROTOCOL_UDP, 14), is_equal_to (14));
+
+  port_set_free (set);
+
+  assert_that (port_range_port_set ("T:-"), is_null);
+}
+
 /* Test suite. */
 
+Ensure (networking, gvm_resolve_uses_cache)
+{
+  gvm_resolve_cache_stats_t before, after;
+  struct in6_addr addr6;
+  GSList *list;
+
+  gvm_resolve_cache_clear ();
+  gvm_resolve_cache_get_stats (&before);
+
+  /* Numeric addresses bypass the cache. */
+  assert_that (gvm_resolve ("127.0.0.1", &addr6, AF_UNSPEC), is_equal_to (0));
+  gvm_resolve_cache_get_stats (&after);
+  assert_that (after.misses, is_equal_to (before.misses));
+  assert_that (after.entries, is_equal_to (0));
+
+  list = gvm_resolve_list ("localhost");
+  assert_that (list, is_not_null);
+  g_slist_free_full (list, g_free);
+  list = gvm_resolve_list ("LocalHost");
+  assert_that (list, is_not_null);
+  g_slist_free_full (list, g_free);
+
+  gvm_resolve_cache_get_stats (&after);
+  assert_that (after.misses, is_equal_to (before.misses + 1));
+  assert_that (after.hits, is_equal_to (before.hits + 1));
+  assert_that (after.entries, is_equal_to (1));
+
+  /* Opting out empties the cache and resolves every time. */
+  gvm_resolve_cache_set_enabled (0);
+  list = gvm_resolve_list ("localhost");
+  assert_that (list, is_not_null);
+  g_slist_free_full (list, g_free);
+  gvm_resolve_cache_get_stats (&after);
+  assert_that (after.hits, is_equal_to (before.hits + 1));
+  assert_that (after.entries, is_equal_to (0));
+  gvm_resolve_cache_set_enabled (1);
+}
+
 Ensure (networking, ip_islocalhost)
 {
   /* IPv4 */
@@ -1149,6 +1220,65 @@ Ensure (networking, gvm_routethrough_v4)
   // 0); assert_that (interface, is_equal_to_string ("enp0s9"));
 }
 
+/**
+ * @brief Adds an IPv4 route to a route trie.
+ */
+static void
+add_route_v4 (struct route_node **trie, const char *dest, int plen,
+              const char *interface, guint32 metric)
+{
+  struct route_info info;
+  guint8 key[16] = {0};
+
+  memset (&info, 0, sizeof (info));
+  g_strlcpy (info.interface, interface, sizeof (info.interface));
+  info.metric = metric;
+  inet_pton (AF_INET, dest, key);
+  route_trie_insert (trie, key, plen, &info);
+}
+
+/**
+ * @brief Looks up the interface of an IPv4 address in a route trie.
+ */
+static const char *
+lookup_route_v4 (struct route_node *trie, const char *addr)
+{
+  const struct route_info *info;
+  guint8 key[16] = {0};
+
+  inet_pton (AF_INET, addr, key);
+  info = route_trie_lookup (trie, key, 32);
+  return info ? info->interface : NULL;
+}
+
+Ensure (networking, route_trie_matches_longest_prefix)
+{
+  struct route_node *trie = NULL;
+
+  add_route_v4 (&trie, "192.168.0.0", 16, "eth1", 0);
+  add_route_v4 (&trie, "192.168.56.0", 24, "eth2", 0);
+  add_route_v4 (&trie, "192.168.56.128", 25, "eth3", 0);
+  add_route_v4 (&trie, "10.0.0.0", 8, "eth4", 0);
+  assert_that (lookup_route_v4 (trie, "8.8.8.8"), is_null);
+
+  add_route_v4 (&trie, "0.0.0.0", 0, "eth0", 100);
+  add_route_v4 (&trie, "0.0.0.0", 0, "wlan0", 600);
+
+  assert_that (lookup_route_v4 (trie, "8.8.8.8"), is_equal_to_string ("eth0"));
+  assert_that (lookup_route_v4 (trie, "192.168.1.1"),
+               is_equal_to_string ("eth1"));
+  assert_that (lookup_route_v4 (trie, "192.168.56.1"),
+               is_equal_to_string ("eth2"));
+  assert_that (lookup_route_v4 (trie, "192.168.56.200"),
+               is_equal_to_string ("eth3"));
+  assert_that (lookup_route_v4 (trie, "192.168.57.1"),
+               is_equal_to_string ("eth1"));
+  assert_that (lookup_route_v4 (trie, "10.1.2.3"), is_equal_to_string ("eth4"));
+  assert_that (lookup_route_v4 (trie, "11.1.2.3"), is_equal_to_string ("eth0"));
+
+  route_trie_free (trie);
+}
+
 Ensure (networking, gvm_source_addr)
 {
   struct in_addr src;
@@ -1171,6 +1301,7 @@ gvm_routethough ()
   add_test_with_context (suite, networking, ip_islocalhost);
   add_test_with_context (suite, networking, get_routes);
   add_test_with_context (suite, networking, gvm_routethrough_v4);
+  add_test_with_context (suite, networking, route_trie_matches_longest_prefix);
 
   return suite;
 }
@@ -1187,6 +1318,8 @@ main (int argc, char **argv)
   add_test_with_context (suite, networking, validate_port_range);
   add_test_with_context (suite, networking, port_range_ranges);
   add_test_with_context (suite, networking, port_in_port_ranges);
+  add_test_with_context (suite, networking, port_in_port_set);
+  add_test_with_context (suite, networking, gvm_resolve_uses_cache);
 
   if (argc > 1)
     return run_single_test (suite, argv[1], create_text_reporter ());
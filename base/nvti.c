@@ -35,6 +35,9 @@
 #define _XOPEN_SOURCE
 #include "nvti.h"
 
+#include "cvss.h"     // for get_cvss_score_from_base_metrics
+#include "memstats.h" // for gvm_memstats_alloc, gvm_memstats_free
+
 #include <stdio.h>   // for sscanf
 #include <string.h>  // for strcmp
 #include <strings.h> // for strcasecmp
@@ -373,8 +376,10 @@ typedef struct nvti
   gchar *solution_type;   /**< @brief The solution type */
   gchar *solution_method; /**< @brief The solution method */
 
-  gchar *tag;       /**< @brief List of tags attached to this NVT */
-  gchar *cvss_base; /**< @brief CVSS base score for this NVT. */
+  gchar *tag;            /**< @brief List of tags attached to this NVT */
+  GString *tag_buf;      /**< @brief Buffer of tag once tags were added */
+  GHashTable *tag_index; /**< @brief Tag values by tag name */
+  gchar *cvss_base;      /**< @brief CVSS base score for this NVT. */
 
   gchar *dependencies;   /**< @brief List of dependencies of this NVT */
   gchar *required_keys;  /**< @brief List of required KB keys of this NVT */
@@ -392,11 +397,97 @@ typedef struct nvti
   GSList *severities; /**< @brief Collection of VT severities */
   GSList *prefs;      /**< @brief Collection of NVT preferences */
 
+  double severity_score; /**< @brief Highest score of the severities */
+  const gchar *severity_vector; /**< @brief Severity vector, in tag_index */
+  double severity_vector_score; /**< @brief CVSS score of severity_vector */
+  gboolean severity_vector_scored; /**< @brief Whether the score is known */
+
   // The following are not settled yet.
   gint category; /**< @brief The category, this NVT belongs to */
   gchar *family; /**< @brief Family the NVT belongs to */
+
+  nvti_arena_t *arena; /**< @brief Arena owning the strings, or NULL */
 } nvti_t;
 
+/**
+ * @brief Arena for the strings of NVT Infos.
+ */
+struct nvti_arena
+{
+  GStringChunk *chunk; /**< @brief The strings */
+  guint refs;          /**< @brief Reference count */
+};
+
+/**
+ * @brief Copy a string for a NVT Info.
+ *
+ * @param n    The NVT Info structure.
+ * @param str  The string to copy. May be NULL.
+ *
+ * @return A copy of str, in the arena of n if any.
+ */
+static gchar *
+nvti_strdup (const nvti_t *n, const gchar *str)
+{
+  if (!str || !n->arena)
+    return g_strdup (str);
+  return g_string_chunk_insert (n->arena->chunk, str);
+}
+
+/**
+ * @brief Intern a string for a NVT Info.
+ *
+ * Meant for values shared by many NVTs, like the family. In an arena, all
+ * NVT Infos share a single copy.
+ *
+ * @param n    The NVT Info structure.
+ * @param str  The string to intern. May be NULL.
+ *
+ * @return A copy of str, the interned one in the arena of n if any.
+ */
+static gchar *
+nvti_intern (const nvti_t *n, const gchar *str)
+{
+  if (!str || !n->arena)
+    return g_strdup (str);
+  return g_string_chunk_insert_const (n->arena->chunk, str);
+}
+
+/**
+ * @brief Take a string for a NVT Info.
+ *
+ * @param n    The NVT Info structure.
+ * @param str  The string, freed if n has an arena. May be NULL.
+ *
+ * @return str, or a copy in the arena of n if any.
+ */
+static gchar *
+nvti_own (const nvti_t *n, gchar *str)
+{
+  gchar *copy;
+
+  if (!str || !n->arena)
+    return str;
+  copy = g_string_chunk_insert (n->arena->chunk, str);
+  g_free (str);
+  return copy;
+}
+
+/**
+ * @brief Free a string of a NVT Info.
+ *
+ * Strings in an arena are only released with the arena.
+ *
+ * @param n    The NVT Info structure.
+ * @param str  The string. May be NULL.
+ */
+static void
+nvti_strfree (const nvti_t *n, gchar *str)
+{
+  if (!n->arena)
+    g_free (str);
+}
+
 /**
  * @brief Add a reference to the VT Info.
  *
@@ -430,6 +521,8 @@ nvti_add_vtseverity (nvti_t *vt, vtseverity_t *s)
   if (!vt)
     return -1;
 
+  if (vt->severities == NULL || vtseverity_score (s) > vt->severity_score)
+    vt->severity_score = vtseverity_score (s);
   vt->severities = g_slist_append (vt->severities, s);
   return 0;
 }
@@ -562,9 +655,69 @@ nvtpref_default (const nvtpref_t *np)
 nvti_t *
 nvti_new (void)
 {
+  gvm_memstats_alloc (GVM_MEM_NVTI, sizeof (nvti_t));
   return (nvti_t *) g_malloc0 (sizeof (nvti_t));
 }
 
+/**
+ * @brief Create an arena for the strings of NVT Infos.
+ *
+ * The strings of the NVT Infos created with @ref nvti_new_in_arena are
+ * copied into the arena, values shared by many NVTs only once. The
+ * strings are released at once, when the arena and all its NVT Infos are
+ * freed. An arena must not be used by several threads at once.
+ *
+ * @return The arena, to be released with @ref nvti_arena_unref.
+ */
+nvti_arena_t *
+nvti_arena_new (void)
+{
+  nvti_arena_t *arena = g_malloc0 (sizeof (nvti_arena_t));
+
+  arena->chunk = g_string_chunk_new (64 * 1024);
+  arena->refs = 1;
+  return arena;
+}
+
+/**
+ * @brief Release a reference to an arena.
+ *
+ * @param arena The arena. May be NULL.
+ */
+void
+nvti_arena_unref (nvti_arena_t *arena)
+{
+  if (!arena || --arena->refs)
+    return;
+  g_string_chunk_free (arena->chunk);
+  g_free (arena);
+}
+
+/**
+ * @brief Create a new (empty) nvti structure using an arena.
+ *
+ * Replacing values of the NVT Info leaves the previous ones in the arena,
+ * so this is meant for NVT Infos which are set once, like on feed loads.
+ *
+ * @param arena The arena for the strings, which is kept until the NVT Info
+ *              is freed.
+ *
+ * @return An empty nvti structure which needs to be released using
+ *         @ref nvti_free .
+ */
+nvti_t *
+nvti_new_in_arena (nvti_arena_t *arena)
+{
+  nvti_t *n = nvti_new ();
+
+  if (arena)
+    {
+      arena->refs++;
+      n->arena = arena;
+    }
+  return n;
+}
+
 /**
  * @brief Free memory of a nvti structure.
  *
@@ -576,31 +729,41 @@ nvti_free (nvti_t *n)
   if (!n)
     return;
 
-  g_free (n->oid);
-  g_free (n->name);
-  g_free (n->summary);
-  g_free (n->insight);
-  g_free (n->affected);
-  g_free (n->impact);
-  g_free (n->solution);
-  g_free (n->solution_type);
-  g_free (n->solution_method);
-  g_free (n->tag);
-  g_free (n->cvss_base);
-  g_free (n->dependencies);
-  g_free (n->required_keys);
-  g_free (n->mandatory_keys);
-  g_free (n->excluded_keys);
-  g_free (n->required_ports);
-  g_free (n->required_udp_ports);
-  g_free (n->detection);
-  g_free (n->qod_type);
-  g_free (n->qod);
-  g_free (n->family);
+  if (!n->arena)
+    {
+      g_free (n->oid);
+      g_free (n->name);
+      g_free (n->summary);
+      g_free (n->insight);
+      g_free (n->affected);
+      g_free (n->impact);
+      g_free (n->solution);
+      g_free (n->solution_type);
+      g_free (n->solution_method);
+      if (!n->tag_buf)
+        g_free (n->tag);
+      g_free (n->cvss_base);
+      g_free (n->dependencies);
+      g_free (n->required_keys);
+      g_free (n->mandatory_keys);
+      g_free (n->excluded_keys);
+      g_free (n->required_ports);
+      g_free (n->required_udp_ports);
+      g_free (n->detection);
+      g_free (n->qod_type);
+      g_free (n->qod);
+      g_free (n->family);
+    }
   g_slist_free_full (n->refs, (void (*) (void *)) vtref_free);
   g_slist_free_full (n->severities, (void (*) (void *)) vtseverity_free);
   g_slist_free_full (n->prefs, (void (*) (void *)) nvtpref_free);
+  if (n->tag_buf)
+    g_string_free (n->tag_buf, TRUE);
+  if (n->tag_index)
+    g_hash_table_destroy (n->tag_index);
+  nvti_arena_unref (n->arena);
   g_free (n);
+  gvm_memstats_free (GVM_MEM_NVTI, sizeof (nvti_t));
 }
 
 /**
@@ -770,67 +933,132 @@ gchar *
 nvti_refs (const nvti_t *n, const gchar *type, const gchar *exclude_types,
            guint use_types)
 {
-  gchar *refs, *refs2, **exclude_item;
-  vtref_t *ref;
-  guint i, exclude;
+  gchar **exclude_item;
+  GString *refs;
+  GSList *element;
   gchar **exclude_split;
 
   if (!n)
     return NULL;
 
-  refs = NULL;
-  refs2 = NULL;
-  exclude = 0;
-
   if (exclude_types && exclude_types[0])
-    exclude_split = g_strsplit (exclude_types, ",", 0);
+    {
+      exclude_split = g_strsplit (exclude_types, ",", 0);
+      for (exclude_item = exclude_split; *exclude_item; exclude_item++)
+        g_strstrip (*exclude_item);
+    }
   else
     exclude_split = NULL;
 
-  for (i = 0; i < g_slist_length (n->refs); i++)
+  refs = g_string_new (NULL);
+  for (element = n->refs; element; element = element->next)
     {
-      ref = g_slist_nth_data (n->refs, i);
+      vtref_t *ref = element->data;
+      guint exclude = 0;
+
       if (type && strcasecmp (ref->type, type) != 0)
         continue;
 
       if (exclude_split)
-        {
-          exclude = 0;
-          for (exclude_item = exclude_split; *exclude_item; exclude_item++)
+        for (exclude_item = exclude_split; *exclude_item; exclude_item++)
+          if (strcasecmp (*exclude_item, ref->type) == 0)
             {
-              if (strcasecmp (g_strstrip (*exclude_item), ref->type) == 0)
-                {
-                  exclude = 1;
-                  break;
-                }
+              exclude = 1;
+              break;
             }
-        }
 
-      if (!exclude)
+      if (exclude)
+        continue;
+      if (refs->len)
+        g_string_append (refs, ", ");
+      if (use_types)
+        g_string_append_printf (refs, "%s:%s", ref->type, ref->ref_id);
+      else
+        g_string_append (refs, ref->ref_id);
+    }
+
+  g_strfreev (exclude_split);
+
+  /* NULL if there is no reference, as before. */
+  return g_string_free (refs, refs->len == 0);
+}
+
+/**
+ * @brief Get the CVE, BID and other references of a NVT in a single pass.
+ *
+ * The results are the same as the ones of nvti_refs with (n, "cve", "", 0),
+ * (n, "bid", "", 0) and (n, NULL, "cve,bid", 1), appended to the given
+ * strings.
+ *
+ * @param n     The NVT Info structure.
+ *
+ * @param cves  Where to append the CVE ids, comma separated. May be NULL.
+ *
+ * @param bids  Where to append the BID ids, comma separated. May be NULL.
+ *
+ * @param xrefs Where to append the other references as "type:id", comma
+ *              separated. May be NULL.
+ */
+void
+nvti_refs_split (const nvti_t *n, GString *cves, GString *bids,
+                 GString *xrefs)
+{
+  GSList *element;
+
+  if (!n)
+    return;
+
+  for (element = n->refs; element; element = element->next)
+    {
+      vtref_t *ref = element->data;
+      GString *refs;
+
+      if (strcasecmp (ref->type, "cve") == 0)
+        refs = cves;
+      else if (strcasecmp (ref->type, "bid") == 0)
+        refs = bids;
+      else
+        refs = xrefs;
+      if (refs == NULL)
+        continue;
+
+      if (refs->len)
+        g_string_append (refs, ", ");
+      if (refs == xrefs)
         {
-          if (use_types)
-            {
-              if (refs)
-                refs2 =
-                  g_strdup_printf ("%s, %s:%s", refs, ref->type, ref->ref_id);
-              else
-                refs2 = g_strdup_printf ("%s:%s", ref->type, ref->ref_id);
-            }
-          else
-            {
-              if (refs)
-                refs2 = g_strdup_printf ("%s, %s", refs, ref->ref_id);
-              else
-                refs2 = g_strdup_printf ("%s", ref->ref_id);
-            }
-          g_free (refs);
-          refs = refs2;
+          g_string_append (refs, ref->type);
+          g_string_append_c (refs, ':');
         }
+      g_string_append (refs, ref->ref_id);
     }
+}
 
-  g_strfreev (exclude_split);
+/**
+ * @brief Get the CVE, BID and other references of a NVT in a single pass.
+ *
+ * Like @ref nvti_refs_split, with the references returned as new strings.
+ *
+ * @param n     The NVT Info structure.
+ *
+ * @param cves  Return of the CVE ids, comma separated. Free with g_free.
+ *
+ * @param bids  Return of the BID ids, comma separated. Free with g_free.
+ *
+ * @param xrefs Return of the other references as "type:id", comma
+ *              separated. Free with g_free.
+ */
+void
+nvti_refs_split_str (const nvti_t *n, gchar **cves, gchar **bids,
+                     gchar **xrefs)
+{
+  GString *cve_refs = g_string_sized_new (256);
+  GString *bid_refs = g_string_sized_new (64);
+  GString *other_refs = g_string_sized_new (256);
 
-  return refs;
+  nvti_refs_split (n, cve_refs, bid_refs, other_refs);
+  *cves = g_string_free (cve_refs, FALSE);
+  *bids = g_string_free (bid_refs, FALSE);
+  *xrefs = g_string_free (other_refs, FALSE);
 }
 
 /**
@@ -864,6 +1092,8 @@ nvti_vtseverity (const nvti_t *n, guint p)
 /**
  * @brief Get the maximum severity score
  *
+ * The score is kept up to date as severities are added.
+ *
  * @param n The NVT Info structure.
  *
  * @return The severity score, -1 indicates an error.
@@ -871,19 +1101,7 @@ nvti_vtseverity (const nvti_t *n, guint p)
 double
 nvti_severity_score (const nvti_t *n)
 {
-  unsigned int i;
-  double score = -1.0;
-
-  for (i = 0; i < nvti_vtseverities_len (n); i++)
-    {
-      vtseverity_t *severity;
-
-      severity = nvti_vtseverity (n, i);
-      if (vtseverity_score (severity) > score)
-        score = vtseverity_score (severity);
-    }
-
-  return score;
+  return n && n->severities ? n->severity_score : -1.0;
 }
 
 /**
@@ -903,17 +1121,34 @@ nvti_severity_score (const nvti_t *n)
 gchar *
 nvti_severity_vector_from_tag (const nvti_t *n)
 {
-  gchar *vector;
-
-  /* Currently, only one severity_vector can be stored as tag.
-   * Therfore we just check this one. */
-  vector = nvti_get_tag (n, "severity_vector");
-  if (vector)
-    return vector;
+  return n ? g_strdup (n->severity_vector) : NULL;
+}
 
-  vector = nvti_get_tag (n, "cvss_base_vector");
+/**
+ * @brief Get the CVSS score of the severity vector of the tags.
+ *
+ * The score is computed on the first call after the tags changed, later
+ * calls return it as is.
+ *
+ * @param n The NVT Info structure.
+ *
+ * @return The score of @ref nvti_severity_vector_from_tag, -1 if there is
+ *         no vector or it is invalid.
+ */
+double
+nvti_severity_vector_score (const nvti_t *n)
+{
+  nvti_t *cache = (nvti_t *) n;
 
-  return vector;
+  if (!n || !n->severity_vector)
+    return -1.0;
+  if (!n->severity_vector_scored)
+    {
+      cache->severity_vector_score =
+        get_cvss_score_from_base_metrics (n->severity_vector);
+      cache->severity_vector_scored = TRUE;
+    }
+  return n->severity_vector_score;
 }
 
 /**
@@ -985,29 +1220,10 @@ nvti_tag (const nvti_t *n)
 gchar *
 nvti_get_tag (const nvti_t *n, const gchar *name)
 {
-  gchar **split, **point;
-
-  if (!n || n->tag == NULL || !name)
+  if (!n || n->tag_index == NULL || !name)
     return NULL;
 
-  split = g_strsplit (n->tag, "|", 0);
-  point = split;
-
-  while (*point)
-    {
-      if ((strlen (*point) > strlen (name))
-          && (strncmp (*point, name, strlen (name)) == 0)
-          && ((*point)[strlen (name)] == '='))
-        {
-          gchar *ret;
-          ret = g_strdup (*point + strlen (name) + 1);
-          g_strfreev (split);
-          return ret;
-        }
-      point++;
-    }
-  g_strfreev (split);
-  return NULL;
+  return g_strdup (g_hash_table_lookup (n->tag_index, name));
 }
 
 /**
@@ -1220,8 +1436,8 @@ nvti_set_oid (nvti_t *n, const gchar *oid)
   if (!n)
     return -1;
 
-  g_free (n->oid);
-  n->oid = g_strdup (oid);
+  nvti_strfree (n, n->oid);
+  n->oid = nvti_strdup (n, oid);
   return 0;
 }
 
@@ -1240,8 +1456,8 @@ nvti_set_name (nvti_t *n, const gchar *name)
   if (!n)
     return -1;
 
-  g_free (n->name);
-  n->name = g_strdup (name);
+  nvti_strfree (n, n->name);
+  n->name = nvti_strdup (n, name);
   return 0;
 }
 
@@ -1260,8 +1476,8 @@ nvti_put_name (nvti_t *n, gchar *name)
   if (!n)
     return -1;
 
-  g_free (n->name);
-  n->name = name;
+  nvti_strfree (n, n->name);
+  n->name = nvti_own (n, name);
   return 0;
 }
 
@@ -1280,8 +1496,8 @@ nvti_set_summary (nvti_t *n, const gchar *summary)
   if (!n)
     return -1;
 
-  g_free (n->summary);
-  n->summary = g_strdup (summary);
+  nvti_strfree (n, n->summary);
+  n->summary = nvti_strdup (n, summary);
   return 0;
 }
 
@@ -1300,8 +1516,8 @@ nvti_put_summary (nvti_t *n, gchar *summary)
   if (!n)
     return -1;
 
-  g_free (n->summary);
-  n->summary = summary;
+  nvti_strfree (n, n->summary);
+  n->summary = nvti_own (n, summary);
   return 0;
 }
 
@@ -1320,8 +1536,8 @@ nvti_set_insight (nvti_t *n, const gchar *insight)
   if (!n)
     return -1;
 
-  g_free (n->insight);
-  n->insight = g_strdup (insight);
+  nvti_strfree (n, n->insight);
+  n->insight = nvti_strdup (n, insight);
   return 0;
 }
 
@@ -1340,8 +1556,8 @@ nvti_put_insight (nvti_t *n, gchar *insight)
   if (!n)
     return -1;
 
-  g_free (n->insight);
-  n->insight = insight;
+  nvti_strfree (n, n->insight);
+  n->insight = nvti_own (n, insight);
   return 0;
 }
 
@@ -1360,8 +1576,8 @@ nvti_set_affected (nvti_t *n, const gchar *affected)
   if (!n)
     return -1;
 
-  g_free (n->affected);
-  n->affected = g_strdup (affected);
+  nvti_strfree (n, n->affected);
+  n->affected = nvti_strdup (n, affected);
   return 0;
 }
 
@@ -1380,8 +1596,8 @@ nvti_put_affected (nvti_t *n, gchar *affected)
   if (!n)
     return -1;
 
-  g_free (n->affected);
-  n->affected = affected;
+  nvti_strfree (n, n->affected);
+  n->affected = nvti_own (n, affected);
   return 0;
 }
 
@@ -1400,8 +1616,8 @@ nvti_set_impact (nvti_t *n, const gchar *impact)
   if (!n)
     return -1;
 
-  g_free (n->impact);
-  n->impact = g_strdup (impact);
+  nvti_strfree (n, n->impact);
+  n->impact = nvti_strdup (n, impact);
   return 0;
 }
 
@@ -1420,8 +1636,8 @@ nvti_put_impact (nvti_t *n, gchar *impact)
   if (!n)
     return -1;
 
-  g_free (n->impact);
-  n->impact = impact;
+  nvti_strfree (n, n->impact);
+  n->impact = nvti_own (n, impact);
   return 0;
 }
 
@@ -1478,8 +1694,8 @@ nvti_set_solution (nvti_t *n, const gchar *solution)
   if (!n)
     return -1;
 
-  g_free (n->solution);
-  n->solution = g_strdup (solution);
+  nvti_strfree (n, n->solution);
+  n->solution = nvti_strdup (n, solution);
   return 0;
 }
 
@@ -1498,8 +1714,8 @@ nvti_put_solution (nvti_t *n, gchar *solution)
   if (!n)
     return -1;
 
-  g_free (n->solution);
-  n->solution = solution;
+  nvti_strfree (n, n->solution);
+  n->solution = nvti_own (n, solution);
   return 0;
 }
 
@@ -1519,8 +1735,8 @@ nvti_set_solution_type (nvti_t *n, const gchar *solution_type)
   if (!n)
     return -1;
 
-  g_free (n->solution_type);
-  n->solution_type = g_strdup (solution_type);
+  nvti_strfree (n, n->solution_type);
+  n->solution_type = nvti_intern (n, solution_type);
   return 0;
 }
 
@@ -1540,11 +1756,82 @@ nvti_set_solution_method (nvti_t *n, const gchar *solution_method)
   if (!n)
     return -1;
 
-  g_free (n->solution_method);
-  n->solution_method = g_strdup (solution_method);
+  nvti_strfree (n, n->solution_method);
+  n->solution_method = nvti_intern (n, solution_method);
   return 0;
 }
 
+/**
+ * @brief Find the severity vector in the tag index of a NVT.
+ *
+ * Currently, only one severity_vector can be stored as tag, the
+ * cvss_base_vector tag is the fallback.
+ *
+ * @param n    The NVT Info structure.
+ */
+static void
+nvti_index_severity_vector (nvti_t *n)
+{
+  const gchar *vector = NULL;
+
+  if (n->tag_index)
+    {
+      vector = g_hash_table_lookup (n->tag_index, "severity_vector");
+      if (vector == NULL)
+        vector = g_hash_table_lookup (n->tag_index, "cvss_base_vector");
+    }
+  /* Values stay in the index until it's cleared by nvti_set_tag. */
+  if (vector != n->severity_vector)
+    {
+      n->severity_vector = vector;
+      n->severity_vector_scored = FALSE;
+    }
+}
+
+/**
+ * @brief Add tags to the tag index of a NVT.
+ *
+ * Like for a lookup in the tags string, the first value of a tag name wins.
+ *
+ * @param n    The NVT Info structure.
+ *
+ * @param tags The tags, separated by '|'.
+ */
+static void
+nvti_index_tags (nvti_t *n, const gchar *tags)
+{
+  gchar **split, **point;
+
+  if (n->tag_index == NULL && n->arena)
+    n->tag_index = g_hash_table_new (g_str_hash, g_str_equal);
+  else if (n->tag_index == NULL)
+    n->tag_index =
+      g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+  split = g_strsplit (tags, "|", 0);
+  for (point = split; *point; point++)
+    {
+      gchar *value = strchr (*point, '=');
+
+      /* Like the search of the serialized tags, a tag without value is
+       * not found. */
+      if (value == NULL || value[1] == '\0')
+        continue;
+      *value++ = '\0';
+      if (g_hash_table_contains (n->tag_index, *point))
+        continue;
+      if (n->arena)
+        /* Tag names are shared by many NVTs. */
+        g_hash_table_insert (
+          n->tag_index, g_string_chunk_insert_const (n->arena->chunk, *point),
+          g_string_chunk_insert (n->arena->chunk, value));
+      else
+        g_hash_table_insert (n->tag_index, g_strdup (*point), g_strdup (value));
+    }
+  g_strfreev (split);
+  nvti_index_severity_vector (n);
+}
+
 /**
  * @brief Add a tag to the NVT tags.
  *        The tag names "severity_date", "last_modification" and
@@ -1565,6 +1852,7 @@ int
 nvti_add_tag (nvti_t *n, const gchar *name, const gchar *value)
 {
   gchar *newvalue = NULL;
+  gsize start;
 
   if (!n)
     return -1;
@@ -1599,17 +1887,20 @@ nvti_add_tag (nvti_t *n, const gchar *name, const gchar *value)
       return 0;
     }
 
-  if (n->tag)
+  /* Appended to a buffer, as concatenating the tags one by one would copy
+   * the string each time. */
+  if (n->tag_buf == NULL)
     {
-      gchar *newtag;
-
-      newtag =
-        g_strconcat (n->tag, "|", name, "=", newvalue ? newvalue : value, NULL);
-      g_free (n->tag);
-      n->tag = newtag;
+      n->tag_buf = g_string_new (n->tag);
+      nvti_strfree (n, n->tag);
     }
-  else
-    n->tag = g_strconcat (name, "=", newvalue ? newvalue : value, NULL);
+  if (n->tag_buf->len)
+    g_string_append_c (n->tag_buf, '|');
+  start = n->tag_buf->len;
+  g_string_append_printf (n->tag_buf, "%s=%s", name,
+                          newvalue ? newvalue : value);
+  n->tag = n->tag_buf->str;
+  nvti_index_tags (n, n->tag_buf->str + start);
 
   g_free (newvalue);
 
@@ -1631,14 +1922,48 @@ nvti_set_tag (nvti_t *n, const gchar *tag)
   if (!n)
     return -1;
 
-  g_free (n->tag);
+  if (n->tag_buf)
+    g_string_free (n->tag_buf, TRUE);
+  else
+    nvti_strfree (n, n->tag);
+  n->tag_buf = NULL;
+  if (n->tag_index)
+    g_hash_table_remove_all (n->tag_index);
+  n->severity_vector = NULL;
+  n->severity_vector_scored = FALSE;
   if (tag && tag[0])
-    n->tag = g_strdup (tag);
+    {
+      n->tag = nvti_strdup (n, tag);
+      nvti_index_tags (n, tag);
+    }
   else
     n->tag = NULL;
   return 0;
 }
 
+/**
+ * @brief Set the CVSS score of the severity vector of a NVT.
+ *
+ * For a score computed before, e.g. stored with the NVT, so that
+ * @ref nvti_severity_vector_score doesn't compute it again.
+ *
+ * @param n     The NVT Info structure.
+ *
+ * @param score The score of the current severity vector.
+ *
+ * @return 0 for success, -1 if the NVT has no severity vector.
+ */
+int
+nvti_set_severity_vector_score (nvti_t *n, double score)
+{
+  if (!n || !n->severity_vector)
+    return -1;
+
+  n->severity_vector_score = score;
+  n->severity_vector_scored = TRUE;
+  return 0;
+}
+
 /**
  * @brief Set the CVSS base of an NVT.
  *
@@ -1654,9 +1979,9 @@ nvti_set_cvss_base (nvti_t *n, const gchar *cvss_base)
   if (!n)
     return -1;
 
-  g_free (n->cvss_base);
+  nvti_strfree (n, n->cvss_base);
   if (cvss_base && cvss_base[0])
-    n->cvss_base = g_strdup (cvss_base);
+    n->cvss_base = nvti_strdup (n, cvss_base);
   else
     n->cvss_base = NULL;
   return 0;
@@ -1678,9 +2003,9 @@ nvti_set_dependencies (nvti_t *n, const gchar *dependencies)
   if (!n)
     return -1;
 
-  g_free (n->dependencies);
+  nvti_strfree (n, n->dependencies);
   if (dependencies && dependencies[0])
-    n->dependencies = g_strdup (dependencies);
+    n->dependencies = nvti_strdup (n, dependencies);
   else
     n->dependencies = NULL;
   return 0;
@@ -1702,9 +2027,9 @@ nvti_set_required_keys (nvti_t *n, const gchar *required_keys)
   if (!n)
     return -1;
 
-  g_free (n->required_keys);
+  nvti_strfree (n, n->required_keys);
   if (required_keys && required_keys[0])
-    n->required_keys = g_strdup (required_keys);
+    n->required_keys = nvti_strdup (n, required_keys);
   else
     n->required_keys = NULL;
   return 0;
@@ -1726,9 +2051,9 @@ nvti_set_mandatory_keys (nvti_t *n, const gchar *mandatory_keys)
   if (!n)
     return -1;
 
-  g_free (n->mandatory_keys);
+  nvti_strfree (n, n->mandatory_keys);
   if (mandatory_keys && mandatory_keys[0])
-    n->mandatory_keys = g_strdup (mandatory_keys);
+    n->mandatory_keys = nvti_strdup (n, mandatory_keys);
   else
     n->mandatory_keys = NULL;
   return 0;
@@ -1750,9 +2075,9 @@ nvti_set_excluded_keys (nvti_t *n, const gchar *excluded_keys)
   if (!n)
     return -1;
 
-  g_free (n->excluded_keys);
+  nvti_strfree (n, n->excluded_keys);
   if (excluded_keys && excluded_keys[0])
-    n->excluded_keys = g_strdup (excluded_keys);
+    n->excluded_keys = nvti_strdup (n, excluded_keys);
   else
     n->excluded_keys = NULL;
   return 0;
@@ -1774,9 +2099,9 @@ nvti_set_required_ports (nvti_t *n, const gchar *required_ports)
   if (!n)
     return -1;
 
-  g_free (n->required_ports);
+  nvti_strfree (n, n->required_ports);
   if (required_ports && required_ports[0])
-    n->required_ports = g_strdup (required_ports);
+    n->required_ports = nvti_strdup (n, required_ports);
   else
     n->required_ports = NULL;
   return 0;
@@ -1798,9 +2123,9 @@ nvti_set_required_udp_ports (nvti_t *n, const gchar *required_udp_ports)
   if (!n)
     return -1;
 
-  g_free (n->required_udp_ports);
+  nvti_strfree (n, n->required_udp_ports);
   if (required_udp_ports && required_udp_ports[0])
-    n->required_udp_ports = g_strdup (required_udp_ports);
+    n->required_udp_ports = nvti_strdup (n, required_udp_ports);
   else
     n->required_udp_ports = NULL;
   return 0;
@@ -1821,8 +2146,8 @@ nvti_set_detection (nvti_t *n, const gchar *detection)
   if (!n)
     return -1;
 
-  g_free (n->detection);
-  n->detection = g_strdup (detection);
+  nvti_strfree (n, n->detection);
+  n->detection = nvti_strdup (n, detection);
   return 0;
 }
 
@@ -1841,8 +2166,8 @@ nvti_put_detection (nvti_t *n, gchar *detection)
   if (!n)
     return -1;
 
-  g_free (n->detection);
-  n->detection = detection;
+  nvti_strfree (n, n->detection);
+  n->detection = nvti_own (n, detection);
   return 0;
 }
 
@@ -1862,9 +2187,9 @@ nvti_set_qod_type (nvti_t *n, const gchar *qod_type)
   if (!n)
     return -1;
 
-  g_free (n->qod_type);
+  nvti_strfree (n, n->qod_type);
   if (qod_type && qod_type[0])
-    n->qod_type = g_strdup (qod_type);
+    n->qod_type = nvti_intern (n, qod_type);
   else
     n->qod_type = NULL;
   return 0;
@@ -1886,9 +2211,9 @@ nvti_set_qod (nvti_t *n, const gchar *qod)
   if (!n)
     return -1;
 
-  g_free (n->qod);
+  nvti_strfree (n, n->qod);
   if (qod && qod[0])
-    n->qod = g_strdup (qod);
+    n->qod = nvti_intern (n, qod);
   else
     n->qod = NULL;
   return 0;
@@ -1909,8 +2234,8 @@ nvti_set_family (nvti_t *n, const gchar *family)
   if (!n)
     return -1;
 
-  g_free (n->family);
-  n->family = g_strdup (family);
+  nvti_strfree (n, n->family);
+  n->family = nvti_intern (n, family);
   return 0;
 }
 
@@ -1929,8 +2254,8 @@ nvti_put_family (nvti_t *n, gchar *family)
   if (!n)
     return -1;
 
-  g_free (n->family);
-  n->family = family;
+  nvti_strfree (n, n->family);
+  n->family = nvti_own (n, family);
   return 0;
 }
 
@@ -1972,7 +2297,8 @@ int
 nvti_add_refs (nvti_t *n, const gchar *type, const gchar *ref_ids,
                const gchar *ref_text)
 {
-  gchar **split, **item;
+  gchar *copy, *id, *next;
+  GSList *refs = NULL;
 
   if (!n)
     return 1;
@@ -1980,33 +2306,33 @@ nvti_add_refs (nvti_t *n, const gchar *type, const gchar *ref_ids,
   if (!ref_ids)
     return 2;
 
-  split = g_strsplit (ref_ids, ",", 0);
-
-  for (item = split; *item; item++)
+  /* Split in place, in a single copy of the list. */
+  copy = g_strdup (ref_ids);
+  for (id = copy; id; id = next)
     {
-      gchar *id;
-
-      id = *item;
+      next = strchr (id, ',');
+      if (next)
+        *next++ = '\0';
       g_strstrip (id);
 
-      if (strcmp (id, "") == 0)
+      if (*id == '\0')
         continue;
 
       if (type)
-        {
-          nvti_add_vtref (n, vtref_new (type, id, ref_text));
-        }
+        refs = g_slist_prepend (refs, vtref_new (type, id, ref_text));
       else
         {
-          gchar **split2;
+          gchar *colon = strchr (id, ':');
 
-          split2 = g_strsplit (id, ":", 2);
-          if (split2[0] && split2[1])
-            nvti_add_vtref (n, vtref_new (split2[0], split2[1], ""));
-          g_strfreev (split2);
+          if (colon)
+            {
+              *colon = '\0';
+              refs = g_slist_prepend (refs, vtref_new (id, colon + 1, ""));
+            }
         }
     }
-  g_strfreev (split);
+  g_free (copy);
+  n->refs = g_slist_concat (n->refs, g_slist_reverse (refs));
 
   return 0;
 }
@@ -2034,11 +2360,11 @@ nvti_add_required_keys (nvti_t *n, const gchar *key)
 
   if (old)
     {
-      n->required_keys = g_strdup_printf ("%s, %s", old, key);
-      g_free (old);
+      n->required_keys = nvti_own (n, g_strdup_printf ("%s, %s", old, key));
+      nvti_strfree (n, old);
     }
   else
-    n->required_keys = g_strdup (key);
+    n->required_keys = nvti_strdup (n, key);
 
   return 0;
 }
@@ -2066,11 +2392,11 @@ nvti_add_mandatory_keys (nvti_t *n, const gchar *key)
 
   if (old)
     {
-      n->mandatory_keys = g_strdup_printf ("%s, %s", old, key);
-      g_free (old);
+      n->mandatory_keys = nvti_own (n, g_strdup_printf ("%s, %s", old, key));
+      nvti_strfree (n, old);
     }
   else
-    n->mandatory_keys = g_strdup (key);
+    n->mandatory_keys = nvti_strdup (n, key);
 
   return 0;
 }
@@ -2098,11 +2424,11 @@ nvti_add_excluded_keys (nvti_t *n, const gchar *key)
 
   if (old)
     {
-      n->excluded_keys = g_strdup_printf ("%s, %s", old, key);
-      g_free (old);
+      n->excluded_keys = nvti_own (n, g_strdup_printf ("%s, %s", old, key));
+      nvti_strfree (n, old);
     }
   else
-    n->excluded_keys = g_strdup (key);
+    n->excluded_keys = nvti_strdup (n, key);
 
   return 0;
 }
@@ -2130,11 +2456,11 @@ nvti_add_required_ports (nvti_t *n, const gchar *port)
 
   if (old)
     {
-      n->required_ports = g_strdup_printf ("%s, %s", old, port);
-      g_free (old);
+      n->required_ports = nvti_own (n, g_strdup_printf ("%s, %s", old, port));
+      nvti_strfree (n, old);
     }
   else
-    n->required_ports = g_strdup (port);
+    n->required_ports = nvti_strdup (n, port);
 
   return 0;
 }
@@ -2162,11 +2488,12 @@ nvti_add_required_udp_ports (nvti_t *n, const gchar *port)
 
   if (old)
     {
-      n->required_udp_ports = g_strdup_printf ("%s, %s", old, port);
-      g_free (old);
+      n->required_udp_ports =
+        nvti_own (n, g_strdup_printf ("%s, %s", old, port));
+      nvti_strfree (n, old);
     }
   else
-    n->required_udp_ports = g_strdup (port);
+    n->required_udp_ports = nvti_strdup (n, port);
 
   return 0;
 }
@@ -2192,6 +2519,19 @@ nvti_add_pref (nvti_t *n, nvtpref_t *np)
 
 /* Collections of nvtis. */
 
+/**
+ * @brief A collection of information records corresponding to NVTs.
+ */
+struct nvtis
+{
+  GHashTable *by_oid;      /**< @brief NVT Infos by OID, owning them */
+  int indexes;             /**< @brief Secondary indexes, NVTIS_INDEX_* */
+  GHashTable *by_cve;      /**< @brief Lists of NVT Infos by CVE id */
+  GHashTable *by_family;   /**< @brief Lists of NVT Infos by family */
+  GHashTable *by_filename; /**< @brief NVT Infos by filename */
+  GHashTable *filenames;   /**< @brief Filenames by OID */
+};
+
 /**
  * @brief Free an NVT Info, for g_hash_table_destroy.
  *
@@ -2211,8 +2551,42 @@ free_nvti_for_hash_table (gpointer nvti)
 nvtis_t *
 nvtis_new (void)
 {
-  return g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
-                                free_nvti_for_hash_table);
+  return nvtis_new_indexed (0);
+}
+
+/**
+ * @brief Make a collection of NVT Infos with secondary indexes.
+ *
+ * The indexes are updated by @ref nvtis_add, from the values the NVT Infos
+ * have when they are added.
+ *
+ * @param indexes The secondary indexes, a combination of NVTIS_INDEX_CVE,
+ *                NVTIS_INDEX_FAMILY and NVTIS_INDEX_FILENAME.
+ *
+ * @return An empty collection of NVT Infos.
+ */
+nvtis_t *
+nvtis_new_indexed (int indexes)
+{
+  nvtis_t *nvtis = g_malloc0 (sizeof (nvtis_t));
+
+  nvtis->by_oid = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                         free_nvti_for_hash_table);
+  nvtis->indexes = indexes;
+  if (indexes & NVTIS_INDEX_CVE)
+    nvtis->by_cve = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                           (GDestroyNotify) g_slist_free);
+  if (indexes & NVTIS_INDEX_FAMILY)
+    nvtis->by_family = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                              (GDestroyNotify) g_slist_free);
+  if (indexes & NVTIS_INDEX_FILENAME)
+    {
+      nvtis->by_filename =
+        g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+      nvtis->filenames =
+        g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+    }
+  return nvtis;
 }
 
 /**
@@ -2223,23 +2597,157 @@ nvtis_new (void)
 void
 nvtis_free (nvtis_t *nvtis)
 {
-  if (nvtis)
-    g_hash_table_destroy (nvtis);
+  if (!nvtis)
+    return;
+
+  if (nvtis->by_cve)
+    g_hash_table_destroy (nvtis->by_cve);
+  if (nvtis->by_family)
+    g_hash_table_destroy (nvtis->by_family);
+  if (nvtis->by_filename)
+    {
+      g_hash_table_destroy (nvtis->filenames);
+      g_hash_table_destroy (nvtis->by_filename);
+    }
+  g_hash_table_destroy (nvtis->by_oid);
+  g_free (nvtis);
+}
+
+/**
+ * @brief Add an NVT Info to a list of a secondary index.
+ *
+ * @param index The index.
+ * @param key   The key of the list.
+ * @param nvti  The NVT Info.
+ */
+static void
+nvtis_index_add (GHashTable *index, const gchar *key, nvti_t *nvti)
+{
+  GSList *list;
+
+  if (!key)
+    return;
+  list = g_hash_table_lookup (index, key);
+  if (list)
+    /* Keep the list head, which is the value in the index. */
+    list->next = g_slist_prepend (list->next, nvti);
+  else
+    g_hash_table_insert (index, g_strdup (key), g_slist_prepend (NULL, nvti));
+}
+
+/**
+ * @brief Remove an NVT Info from a list of a secondary index.
+ *
+ * @param index The index.
+ * @param key   The key of the list.
+ * @param nvti  The NVT Info.
+ */
+static void
+nvtis_index_remove (GHashTable *index, const gchar *key, nvti_t *nvti)
+{
+  GSList *list;
+
+  if (!key || !(list = g_hash_table_lookup (index, key)))
+    return;
+  if (list->data != nvti)
+    list->next = g_slist_remove (list->next, nvti);
+  else if (list->next)
+    {
+      /* Keep the list head, which is the value in the index. */
+      list->data = list->next->data;
+      list->next = g_slist_delete_link (list->next, list->next);
+    }
+  else
+    g_hash_table_remove (index, key);
+}
+
+/**
+ * @brief Update the secondary indexes of a collection for an NVT Info.
+ *
+ * @param nvtis    The collection of NVT Infos.
+ * @param nvti     The NVT Info.
+ * @param add      1 to add the NVT Info, 0 to remove it.
+ */
+static void
+nvtis_index_update (nvtis_t *nvtis, nvti_t *nvti, int add)
+{
+  void (*update) (GHashTable *, const gchar *, nvti_t *);
+  GSList *element;
+
+  update = add ? nvtis_index_add : nvtis_index_remove;
+  if (nvtis->by_family)
+    update (nvtis->by_family, nvti_family (nvti), nvti);
+  if (nvtis->by_cve)
+    for (element = nvti->refs; element; element = element->next)
+      {
+        vtref_t *ref = element->data;
+
+        if (ref->type && !strcasecmp (ref->type, "cve"))
+          update (nvtis->by_cve, ref->ref_id, nvti);
+      }
 }
 
 /**
  * @brief Add an NVT Info to a collection of NVT Infos.
  *
+ * An NVT Info of the same OID is replaced and freed.
+ *
  * @param nvtis The collection of NVT Infos.
  * @param nvti  The NVT Info to add.
  */
 void
 nvtis_add (nvtis_t *nvtis, nvti_t *nvti)
 {
-  if (nvti)
-    g_hash_table_insert (
-      nvtis, (gpointer) (nvti_oid (nvti) ? g_strdup (nvti_oid (nvti)) : NULL),
-      (gpointer) nvti);
+  nvtis_add_file (nvtis, nvti, NULL);
+}
+
+/**
+ * @brief Add an NVT Info and the name of its file to a collection.
+ *
+ * An NVT Info of the same OID is replaced and freed.
+ *
+ * @param nvtis    The collection of NVT Infos.
+ * @param nvti     The NVT Info to add.
+ * @param filename The name of the file of the NVT, for
+ *                 @ref nvtis_lookup_filename. May be NULL.
+ */
+void
+nvtis_add_file (nvtis_t *nvtis, nvti_t *nvti, const gchar *filename)
+{
+  nvti_t *old;
+  gchar *old_filename;
+
+  if (!nvti)
+    return;
+
+  old = g_hash_table_lookup (nvtis->by_oid, nvti_oid (nvti));
+  if (old && nvtis->indexes)
+    nvtis_index_update (nvtis, old, 0);
+  if (old && nvtis->by_filename)
+    {
+      old_filename = g_hash_table_lookup (nvtis->filenames, nvti_oid (old));
+      if (old_filename)
+        {
+          g_hash_table_remove (nvtis->by_filename, old_filename);
+          g_hash_table_remove (nvtis->filenames, nvti_oid (old));
+        }
+    }
+  if (nvtis->indexes)
+    nvtis_index_update (nvtis, nvti, 1);
+  g_hash_table_insert (
+    nvtis->by_oid,
+    (gpointer) (nvti_oid (nvti) ? g_strdup (nvti_oid (nvti)) : NULL),
+    (gpointer) nvti);
+
+  if (filename && nvtis->by_filename)
+    {
+      old = g_hash_table_lookup (nvtis->by_filename, filename);
+      if (old)
+        g_hash_table_remove (nvtis->filenames, nvti_oid (old));
+      g_hash_table_replace (nvtis->by_filename, g_strdup (filename), nvti);
+      g_hash_table_replace (nvtis->filenames, g_strdup (nvti_oid (nvti)),
+                            g_strdup (filename));
+    }
 }
 
 /**
@@ -2253,5 +2761,89 @@ nvtis_add (nvtis_t *nvtis, nvti_t *nvti)
 nvti_t *
 nvtis_lookup (nvtis_t *nvtis, const char *oid)
 {
-  return g_hash_table_lookup (nvtis, oid);
+  return g_hash_table_lookup (nvtis->by_oid, oid);
+}
+
+/**
+ * @brief Get the number of NVT Infos of a collection.
+ *
+ * @param nvtis The collection of NVT Infos.
+ *
+ * @return The number of NVT Infos.
+ */
+guint
+nvtis_size (nvtis_t *nvtis)
+{
+  return nvtis ? g_hash_table_size (nvtis->by_oid) : 0;
+}
+
+/**
+ * @brief Call a function for each NVT Info of a collection.
+ *
+ * The collection must not be modified by the function.
+ *
+ * @param nvtis     The collection of NVT Infos.
+ * @param func      Function called with the OID, the NVT Info and user_data.
+ * @param user_data User data to pass to func.
+ */
+void
+nvtis_foreach (nvtis_t *nvtis, GHFunc func, gpointer user_data)
+{
+  if (nvtis)
+    g_hash_table_foreach (nvtis->by_oid, func, user_data);
+}
+
+/**
+ * @brief Get the NVT Infos with a CVE reference.
+ *
+ * The collection must have been made with NVTIS_INDEX_CVE.
+ *
+ * @param nvtis The collection of NVT Infos.
+ * @param cve   The CVE id.
+ *
+ * @return The NVT Infos. Owned by the collection, valid until it's modified.
+ */
+const GSList *
+nvtis_lookup_cve (nvtis_t *nvtis, const char *cve)
+{
+  if (!nvtis || !nvtis->by_cve || !cve)
+    return NULL;
+  return g_hash_table_lookup (nvtis->by_cve, cve);
+}
+
+/**
+ * @brief Get the NVT Infos of a family.
+ *
+ * The collection must have been made with NVTIS_INDEX_FAMILY.
+ *
+ * @param nvtis  The collection of NVT Infos.
+ * @param family The family.
+ *
+ * @return The NVT Infos. Owned by the collection, valid until it's modified.
+ */
+const GSList *
+nvtis_lookup_family (nvtis_t *nvtis, const char *family)
+{
+  if (!nvtis || !nvtis->by_family || !family)
+    return NULL;
+  return g_hash_table_lookup (nvtis->by_family, family);
+}
+
+/**
+ * @brief Get the NVT Info of a file.
+ *
+ * The collection must have been made with NVTIS_INDEX_FILENAME, and the
+ * NVT Info added with @ref nvtis_add_file.
+ *
+ * @param nvtis    The collection of NVT Infos.
+ * @param filename The name of the file of the NVT.
+ *
+ * @return The NVT Info, if found, else NULL.
+ */
+nvti_t *
+nvtis_lookup_filename (nvtis_t *nvtis, const char *filename)
+{
+  if (!nvtis || !filename)
+    return NULL;
+  return g_hash_table_lookup (nvtis->by_filename, filename);
 }
@@ -52,6 +52,11 @@ typedef struct vtseverity vtseverity_t;
  */
 typedef struct nvti nvti_t;
 
+/**
+ * @brief The arena for the strings of NVT Infos.
+ */
+typedef struct nvti_arena nvti_arena_t;
+
 vtref_t *
 vtref_new (const gchar *, const gchar *, const gchar *);
 void
@@ -95,9 +100,20 @@ double
 nvti_severity_score (const nvti_t *);
 gchar *
 nvti_severity_vector_from_tag (const nvti_t *);
+double
+nvti_severity_vector_score (const nvti_t *);
 
 nvti_t *
 nvti_new (void);
+
+nvti_arena_t *
+nvti_arena_new (void);
+
+void
+nvti_arena_unref (nvti_arena_t *);
+
+nvti_t *
+nvti_new_in_arena (nvti_arena_t *);
 void
 nvti_free (nvti_t *);
 
@@ -119,6 +135,10 @@ gchar *
 nvti_insight (const nvti_t *);
 gchar *
 nvti_refs (const nvti_t *, const gchar *, const char *, guint);
+void
+nvti_refs_split (const nvti_t *, GString *, GString *, GString *);
+void
+nvti_refs_split_str (const nvti_t *, gchar **, gchar **, gchar **);
 gchar *
 nvti_solution (const nvti_t *);
 gchar *
@@ -199,6 +219,8 @@ nvti_add_tag (nvti_t *, const gchar *, const gchar *);
 int
 nvti_set_tag (nvti_t *, const gchar *);
 int
+nvti_set_severity_vector_score (nvti_t *, double);
+int
 nvti_set_cvss_base (nvti_t *, const gchar *);
 int
 nvti_set_dependencies (nvti_t *, const gchar *);
@@ -248,19 +270,53 @@ nvti_add_pref (nvti_t *, nvtpref_t *);
 
 /**
  * @brief A collection of information records corresponding to NVTs.
+ *
+ * Opaque since 22.4, it used to be a GHashTable of the NVT Infos by OID.
+ * Iterate it with @ref nvtis_foreach instead of the GHashTable functions.
+ */
+typedef struct nvtis nvtis_t;
+
+/**
+ * @brief Secondary indexes of a collection of NVT Infos.
  */
-typedef GHashTable nvtis_t;
+enum nvtis_index
+{
+  NVTIS_INDEX_CVE = 1,      /**< @brief NVT Infos by CVE id */
+  NVTIS_INDEX_FAMILY = 2,   /**< @brief NVT Infos by family */
+  NVTIS_INDEX_FILENAME = 4, /**< @brief NVT Info by filename */
+};
 
 nvtis_t *
 nvtis_new (void);
 
+nvtis_t *
+nvtis_new_indexed (int);
+
 void
 nvtis_free (nvtis_t *);
 
 void
 nvtis_add (nvtis_t *, nvti_t *);
 
+void
+nvtis_add_file (nvtis_t *, nvti_t *, const gchar *);
+
 nvti_t *
 nvtis_lookup (nvtis_t *, const char *);
 
+guint
+nvtis_size (nvtis_t *);
+
+void
+nvtis_foreach (nvtis_t *, GHFunc, gpointer);
+
+const GSList *
+nvtis_lookup_cve (nvtis_t *, const char *);
+
+const GSList *
+nvtis_lookup_family (nvtis_t *, const char *);
+
+nvti_t *
+nvtis_lookup_filename (nvtis_t *, const char *);
+
 #endif /* not _NVTI_H */
@@ -101,6 +101,47 @@ Ensure (nvti, nvti_get_tag_handles_empty_tag)
   nvti_free (nvti);
 }
 
+Ensure (nvti, nvti_get_tag_skips_tags_without_value)
+{
+  nvti_t *nvti;
+  gchar *tag;
+
+  nvti = nvti_new ();
+  nvti_set_tag (nvti, "a=|b=2|a=1");
+
+  tag = nvti_get_tag (nvti, "a");
+  assert_that (tag, is_equal_to_string ("1"));
+  g_free (tag);
+  nvti_set_tag (nvti, "a=");
+  assert_that (nvti_get_tag (nvti, "a"), is_null);
+
+  nvti_free (nvti);
+}
+
+Ensure (nvti, nvti_add_tag_updates_index_and_string)
+{
+  nvti_t *nvti;
+  gchar *tag;
+
+  nvti = nvti_new ();
+  nvti_add_tag (nvti, "a", "1");
+  nvti_add_tag (nvti, "b", "2");
+  nvti_add_tag (nvti, "a", "3");
+
+  tag = nvti_get_tag (nvti, "a");
+  assert_that (tag, is_equal_to_string ("1"));
+  g_free (tag);
+  tag = nvti_get_tag (nvti, "b");
+  assert_that (tag, is_equal_to_string ("2"));
+  g_free (tag);
+  assert_that (nvti_tag (nvti), is_equal_to_string ("a=1|b=2|a=3"));
+
+  nvti_add_tag (nvti, "c", "4");
+  assert_that (nvti_tag (nvti), is_equal_to_string ("a=1|b=2|a=3|c=4"));
+
+  nvti_free (nvti);
+}
+
 Ensure (nvti, nvti_get_tag_handles_null_nvti)
 {
   assert_that (nvti_get_tag (NULL, "example"), is_null);
@@ -118,6 +159,58 @@ Ensure (nvti, nvti_get_tag_handles_null_name)
   nvti_free (nvti);
 }
 
+/* nvti_refs */
+
+Ensure (nvti, nvti_refs_split_matches_nvti_refs)
+{
+  nvti_t *nvti;
+  GString *cves, *bids, *xrefs;
+  gchar *refs;
+
+  nvti = nvti_new ();
+  nvti_add_refs (nvti, "cve", " CVE-1, ,CVE-2 ", "");
+  nvti_add_refs (nvti, NULL, "url:http://a, bid:3,cert-bund:CB-4", "");
+
+  cves = g_string_new (NULL);
+  bids = g_string_new (NULL);
+  xrefs = g_string_new (NULL);
+  nvti_refs_split (nvti, cves, bids, xrefs);
+
+  assert_that (cves->str, is_equal_to_string ("CVE-1, CVE-2"));
+  assert_that (bids->str, is_equal_to_string ("3"));
+  assert_that (xrefs->str,
+               is_equal_to_string ("url:http://a, cert-bund:CB-4"));
+
+  refs = nvti_refs (nvti, NULL, "cve,bid", 1);
+  assert_that (refs, is_equal_to_string (xrefs->str));
+  g_free (refs);
+  assert_that (nvti_refs (nvti, "dfn-cert", "", 0), is_null);
+
+  g_string_free (cves, TRUE);
+  g_string_free (bids, TRUE);
+  g_string_free (xrefs, TRUE);
+  nvti_free (nvti);
+}
+
+Ensure (nvti, nvti_refs_split_str_returns_strings)
+{
+  nvti_t *nvti;
+  gchar *cves, *bids, *xrefs;
+
+  nvti = nvti_new ();
+  nvti_add_refs (nvti, NULL, "cve:CVE-1, bid:3, url:http://a", "");
+
+  nvti_refs_split_str (nvti, &cves, &bids, &xrefs);
+  assert_that (cves, is_equal_to_string ("CVE-1"));
+  assert_that (bids, is_equal_to_string ("3"));
+  assert_that (xrefs, is_equal_to_string ("url:http://a"));
+
+  g_free (cves);
+  g_free (bids);
+  g_free (xrefs);
+  nvti_free (nvti);
+}
+
 /* nvtis_add */
 
 Ensure (nvti, nvtis_add_does_not_use_oid_as_key)
@@ -146,6 +239,108 @@ Ensure (nvti, nvtis_add_does_not_use_oid_as_key)
   assert_that (nvtis_lookup (nvtis, "2"), is_null);
 }
 
+Ensure (nvti, nvtis_indexes_find_cve_family_and_filename)
+{
+  nvtis_t *nvtis;
+  nvti_t *nvti1, *nvti2, *nvti3;
+  const GSList *list;
+
+  nvtis = nvtis_new_indexed (NVTIS_INDEX_CVE | NVTIS_INDEX_FAMILY
+                             | NVTIS_INDEX_FILENAME);
+
+  nvti1 = nvti_new ();
+  nvti_set_oid (nvti1, "1");
+  nvti_set_family (nvti1, "General");
+  nvti_add_refs (nvti1, "cve", "CVE-2020-0001, CVE-2020-0002", "");
+  nvtis_add_file (nvtis, nvti1, "a.nasl");
+
+  nvti2 = nvti_new ();
+  nvti_set_oid (nvti2, "2");
+  nvti_set_family (nvti2, "General");
+  nvti_add_refs (nvti2, "cve", "CVE-2020-0002", "");
+  nvtis_add_file (nvtis, nvti2, "b.nasl");
+
+  assert_that (nvtis_size (nvtis), is_equal_to (2));
+  list = nvtis_lookup_family (nvtis, "General");
+  assert_that (g_slist_length ((GSList *) list), is_equal_to (2));
+  list = nvtis_lookup_cve (nvtis, "CVE-2020-0002");
+  assert_that (g_slist_length ((GSList *) list), is_equal_to (2));
+  assert_that (nvtis_lookup_cve (nvtis, "CVE-2020-0001")->data,
+               is_equal_to (nvti1));
+  assert_that (nvtis_lookup_filename (nvtis, "b.nasl"), is_equal_to (nvti2));
+
+  /* Replacing an NVT Info updates the indexes. */
+  nvti3 = nvti_new ();
+  nvti_set_oid (nvti3, "1");
+  nvti_set_family (nvti3, "Other");
+  nvtis_add_file (nvtis, nvti3, "c.nasl");
+
+  assert_that (nvtis_size (nvtis), is_equal_to (2));
+  assert_that (nvtis_lookup_cve (nvtis, "CVE-2020-0001"), is_null);
+  assert_that (nvtis_lookup_family (nvtis, "General")->data,
+               is_equal_to (nvti2));
+  assert_that (nvtis_lookup_family (nvtis, "General")->next, is_null);
+  assert_that (nvtis_lookup_filename (nvtis, "a.nasl"), is_null);
+  assert_that (nvtis_lookup_filename (nvtis, "c.nasl"), is_equal_to (nvti3));
+
+  nvtis_free (nvtis);
+}
+
+static void
+count_nvti (gpointer oid, gpointer nvti, gpointer count)
+{
+  if (!strcmp (oid, nvti_oid (nvti)))
+    (*(int *) count)++;
+}
+
+Ensure (nvti, nvtis_foreach_visits_all_nvtis)
+{
+  nvtis_t *nvtis;
+  nvti_t *nvti;
+  int count = 0;
+
+  nvtis = nvtis_new ();
+  nvti = nvti_new ();
+  nvti_set_oid (nvti, "1");
+  nvtis_add (nvtis, nvti);
+  nvti = nvti_new ();
+  nvti_set_oid (nvti, "2");
+  nvtis_add (nvtis, nvti);
+
+  nvtis_foreach (nvtis, count_nvti, &count);
+  assert_that (count, is_equal_to (2));
+
+  nvtis_free (nvtis);
+}
+
+/* nvti arena */
+
+Ensure (nvti, nvti_new_in_arena_interns_family)
+{
+  nvti_arena_t *arena;
+  nvti_t *nvti1, *nvti2;
+
+  arena = nvti_arena_new ();
+  nvti1 = nvti_new_in_arena (arena);
+  nvti2 = nvti_new_in_arena (arena);
+  nvti_arena_unref (arena);
+
+  nvti_set_family (nvti1, "General");
+  nvti_set_family (nvti2, "General");
+  nvti_set_name (nvti1, "Name");
+  nvti_add_required_keys (nvti1, "a");
+  nvti_add_required_keys (nvti1, "b");
+
+  assert_that (nvti_family (nvti1), is_equal_to_string ("General"));
+  assert_that (nvti_family (nvti1), is_equal_to (nvti_family (nvti2)));
+  assert_that (nvti_name (nvti1), is_equal_to_string ("Name"));
+  assert_that (nvti_required_keys (nvti1), is_equal_to_string ("a, b"));
+
+  nvti_free (nvti1);
+  assert_that (nvti_family (nvti2), is_equal_to_string ("General"));
+  nvti_free (nvti2);
+}
+
 /* nvti severity vector */
 
 Ensure (nvti, nvti_get_severity_vector_both)
@@ -188,6 +383,62 @@ Ensure (nvti, nvti_get_severity_vector_no_severity_vector)
   nvti_free (nvti);
 }
 
+Ensure (nvti, nvti_severity_vector_follows_tag_changes)
+{
+  nvti_t *nvti;
+
+  nvti = nvti_new ();
+  assert_that_double (nvti_severity_vector_score (nvti),
+                      is_equal_to_double (-1.0));
+  nvti_add_tag (nvti, "cvss_base_vector", "AV:N/AC:L/Au:N/C:N/I:N/A:C");
+  assert_that_double (nvti_severity_vector_score (nvti),
+                      is_equal_to_double (7.8));
+  nvti_add_tag (nvti, "severity_vector",
+                "CVSS:3.1/AV:N/AC:L/PR:N/UI:N/S:U/C:H/I:H/A:H");
+  assert_that (nvti_severity_vector_from_tag (nvti),
+               is_equal_to_string (
+                 "CVSS:3.1/AV:N/AC:L/PR:N/UI:N/S:U/C:H/I:H/A:H"));
+  assert_that_double (nvti_severity_vector_score (nvti),
+                      is_equal_to_double (9.8));
+  nvti_set_tag (nvti, "summary=none");
+  assert_that (nvti_severity_vector_from_tag (nvti), is_null);
+  assert_that_double (nvti_severity_vector_score (nvti),
+                      is_equal_to_double (-1.0));
+
+  nvti_free (nvti);
+}
+
+Ensure (nvti, nvti_set_severity_vector_score_presets_score)
+{
+  nvti_t *nvti;
+
+  nvti = nvti_new ();
+  assert_that (nvti_set_severity_vector_score (nvti, 5.0), is_equal_to (-1));
+  nvti_set_tag (nvti, "cvss_base_vector=AV:N/AC:L/Au:N/C:N/I:N/A:C");
+  assert_that (nvti_set_severity_vector_score (nvti, 5.0), is_equal_to (0));
+  assert_that_double (nvti_severity_vector_score (nvti),
+                      is_equal_to_double (5.0));
+
+  nvti_free (nvti);
+}
+
+Ensure (nvti, nvti_severity_score_is_max_of_severities)
+{
+  nvti_t *nvti;
+
+  nvti = nvti_new ();
+  assert_that_double (nvti_severity_score (nvti), is_equal_to_double (-1.0));
+  nvti_add_vtseverity (nvti, vtseverity_new ("cvss_base_v3", NULL, 0, 5.0,
+                                             "CVSS:3.1/AV:N"));
+  nvti_add_vtseverity (nvti, vtseverity_new ("cvss_base_v3", NULL, 0, 9.8,
+                                             "CVSS:3.1/AV:N"));
+  nvti_add_vtseverity (nvti, vtseverity_new ("cvss_base_v2", NULL, 0, 4.3,
+                                             "AV:N"));
+  assert_that_double (nvti_severity_score (nvti), is_equal_to_double (9.8));
+
+  nvti_free (nvti);
+}
+
 /* Test suite. */
 
 int
@@ -203,17 +454,34 @@ main (int argc, char **argv)
   add_test_with_context (suite, nvti,
                          nvti_get_tag_gets_correct_value_many_tags);
   add_test_with_context (suite, nvti, nvti_get_tag_handles_empty_tag);
+  add_test_with_context (suite, nvti, nvti_get_tag_skips_tags_without_value);
+  add_test_with_context (suite, nvti,
+                         nvti_add_tag_updates_index_and_string);
   add_test_with_context (suite, nvti, nvti_get_tag_handles_null_nvti);
   add_test_with_context (suite, nvti, nvti_get_tag_handles_null_name);
 
   add_test_with_context (suite, nvti, nvti_set_solution_method_correct);
 
+  add_test_with_context (suite, nvti, nvti_refs_split_matches_nvti_refs);
+  add_test_with_context (suite, nvti, nvti_refs_split_str_returns_strings);
+
   add_test_with_context (suite, nvti, nvtis_add_does_not_use_oid_as_key);
+  add_test_with_context (suite, nvti,
+                         nvtis_indexes_find_cve_family_and_filename);
+  add_test_with_context (suite, nvti, nvtis_foreach_visits_all_nvtis);
+
+  add_test_with_context (suite, nvti, nvti_new_in_arena_interns_family);
 
   add_test_with_context (suite, nvti, nvti_get_severity_vector_both);
   add_test_with_context (suite, nvti,
                          nvti_get_severity_vector_no_severity_vector);
   add_test_with_context (suite, nvti, nvti_get_severity_vector_no_cvss_base);
+  add_test_with_context (suite, nvti,
+                         nvti_severity_vector_follows_tag_changes);
+  add_test_with_context (suite, nvti,
+                         nvti_set_severity_vector_score_presets_score);
+  add_test_with_context (suite, nvti,
+                         nvti_severity_score_is_max_of_severities);
   add_test_with_context (suite, nvti, nvti_parse_timestamp);
 
   if (argc > 1)
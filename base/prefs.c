@@ -13,7 +13,8 @@
 
 #include "prefs.h"
 
-#include "settings.h" /* for init_settings_iterator_from_file */
+#include "networking.h" /* for port_range_ranges */
+#include "settings.h"   /* for init_settings_iterator_from_file */
 
 #include <glib.h>   /* for gchar */
 #include <stdio.h>  /* for printf() */
@@ -28,9 +29,111 @@
 
 static GHashTable *global_prefs = NULL;
 
+/**
+ * @brief A registered preference, decoded whenever its value changes.
+ */
+typedef struct
+{
+  gchar *key;        ///< Preference name.
+  prefs_type_t type; ///< Type the value is decoded as.
+  gchar *value;      ///< Copy of the value, NULL if unset.
+  int int_value;     ///< Decoded integer or boolean.
+  array_t *ports;    ///< Decoded port ranges.
+} prefs_entry_t;
+
+/**
+ * @brief Registered preferences, indexed by handle.
+ */
+static GPtrArray *prefs_entries = NULL;
+
+/**
+ * @brief Handles of the registered preferences by name, as lists.
+ */
+static GHashTable *prefs_handles = NULL;
+
+/**
+ * @brief Incremented whenever any preference changes.
+ */
+static guint prefs_gen = 0;
+
 void
 prefs_set (const gchar *, const gchar *);
 
+/**
+ * @brief Decodes a new value of a registered preference.
+ *
+ * @param entry  Registered preference.
+ * @param value  New value, NULL to unset.
+ */
+static void
+prefs_entry_update (prefs_entry_t *entry, const gchar *value)
+{
+  g_free (entry->value);
+  entry->value = g_strdup (value);
+  entry->int_value = 0;
+  if (entry->ports)
+    {
+      array_free (entry->ports);
+      entry->ports = NULL;
+    }
+  if (value == NULL)
+    return;
+
+  switch (entry->type)
+    {
+    case PREFS_TYPE_INT:
+      entry->int_value = atoi (value);
+      break;
+    case PREFS_TYPE_BOOL:
+      entry->int_value = !strcmp (value, "yes");
+      break;
+    case PREFS_TYPE_PORTS:
+      entry->ports = port_range_ranges (value);
+      break;
+    default:
+      break;
+    }
+}
+
+/**
+ * @brief Updates the registered preferences of a key to a new value.
+ *
+ * @param key    The identifier for the preference.
+ * @param value  New value, NULL to unset.
+ */
+static void
+prefs_entries_update (const gchar *key, const gchar *value)
+{
+  GSList *handles;
+
+  prefs_gen++;
+  if (prefs_handles == NULL)
+    return;
+
+  for (handles = g_hash_table_lookup (prefs_handles, key); handles;
+       handles = handles->next)
+    prefs_entry_update (
+      g_ptr_array_index (prefs_entries, GPOINTER_TO_INT (handles->data)),
+      value);
+}
+
+/**
+ * @brief Returns a registered preference.
+ *
+ * @param handle  Handle of the preference.
+ *
+ * @return The preference, NULL if the handle is invalid.
+ */
+static prefs_entry_t *
+prefs_entry_get (prefs_handle_t handle)
+{
+  if (prefs_entries == NULL || handle < 0
+      || (guint) handle >= prefs_entries->len)
+    return NULL;
+
+  return g_ptr_array_index (prefs_entries, handle);
+}
+
 /**
  * @brief Initializes the preferences structure. If it was
  *        already initialized, remove old settings and start
@@ -40,7 +143,14 @@ static void
 prefs_init (void)
 {
   if (global_prefs)
-    g_hash_table_destroy (global_prefs);
+    {
+      guint i;
+
+      g_hash_table_destroy (global_prefs);
+      for (i = 0; prefs_entries && i < prefs_entries->len; i++)
+        prefs_entry_update (g_ptr_array_index (prefs_entries, i), NULL);
+      prefs_gen++;
+    }
 
   global_prefs =
     g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
@@ -145,6 +255,7 @@ prefs_set (const gchar *key, const gchar *value)
     prefs_init ();
 
   g_hash_table_insert (global_prefs, g_strdup (key), g_strdup (value));
+  prefs_entries_update (key, value);
 }
 
 /**
@@ -190,3 +301,162 @@ prefs_dump (void)
         }
     }
 }
+
+/**
+ * @brief Register a preference for typed access by handle.
+ *
+ * The value is decoded now and again whenever it is set, so that reading it
+ * through the handle is a plain array access. Registering the same key with
+ * the same type again returns the same handle.
+ *
+ * Registration is not thread safe, it is meant to be done at start-up.
+ *
+ * @param key   The identifier for the preference.
+ * @param type  Type to decode the value as.
+ *
+ * @return Handle of the preference, -1 if key is NULL.
+ */
+prefs_handle_t
+prefs_register (const gchar *key, prefs_type_t type)
+{
+  prefs_entry_t *entry;
+  GSList *handles, *handle;
+
+  if (key == NULL)
+    return -1;
+
+  if (!global_prefs)
+    prefs_init ();
+
+  if (prefs_handles == NULL)
+    {
+      prefs_entries = g_ptr_array_new ();
+      prefs_handles = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                             (GDestroyNotify) g_slist_free);
+    }
+
+  handles = g_hash_table_lookup (prefs_handles, key);
+  for (handle = handles; handle; handle = handle->next)
+    {
+      entry = g_ptr_array_index (prefs_entries, GPOINTER_TO_INT (handle->data));
+      if (entry->type == type)
+        return GPOINTER_TO_INT (handle->data);
+    }
+
+  entry = g_malloc0 (sizeof (prefs_entry_t));
+  entry->key = g_strdup (key);
+  entry->type = type;
+  prefs_entry_update (entry, g_hash_table_lookup (global_prefs, key));
+  g_ptr_array_add (prefs_entries, entry);
+
+  /* Appending keeps the head of an existing list in the table. */
+  handle = g_slist_append (handles, GINT_TO_POINTER (prefs_entries->len - 1));
+  if (handles == NULL)
+    g_hash_table_insert (prefs_handles, g_strdup (key), handle);
+
+  return prefs_entries->len - 1;
+}
+
+/**
+ * @brief Get the generation of the preferences.
+ *
+ * The generation changes whenever any preference is set, so a caller can
+ * keep values derived from preferences as long as it stays the same.
+ *
+ * @return Generation counter.
+ */
+guint
+prefs_generation (void)
+{
+  return prefs_gen;
+}
+
+/**
+ * @brief Check whether a registered preference has a value.
+ *
+ * @param handle  Handle of the preference.
+ *
+ * @return 1 if it has a value, 0 otherwise or if the handle is invalid.
+ */
+int
+prefs_handle_is_set (prefs_handle_t handle)
+{
+  prefs_entry_t *entry = prefs_entry_get (handle);
+
+  return entry && entry->value;
+}
+
+/**
+ * @brief Get the string value of a registered preference.
+ *
+ * @param handle  Handle of the preference.
+ *
+ * @return The value, valid until the preference is set again. NULL if
+ *         the preference has no value or the handle is invalid.
+ */
+const gchar *
+prefs_handle_get (prefs_handle_t handle)
+{
+  prefs_entry_t *entry = prefs_entry_get (handle);
+
+  return entry ? entry->value : NULL;
+}
+
+/**
+ * @brief Get the integer value of a preference registered as PREFS_TYPE_INT.
+ *
+ * @param handle         Handle of the preference.
+ * @param default_value  Value to return if the preference has no value.
+ *
+ * @return The decoded value, default_value if the preference has no value,
+ *         is of another type or the handle is invalid.
+ */
+int
+prefs_handle_get_int (prefs_handle_t handle, int default_value)
+{
+  prefs_entry_t *entry = prefs_entry_get (handle);
+
+  if (entry == NULL || entry->value == NULL || entry->type != PREFS_TYPE_INT)
+    return default_value;
+
+  return entry->int_value;
+}
+
+/**
+ * @brief Get the value of a preference registered as PREFS_TYPE_BOOL.
+ *
+ * @param handle  Handle of the preference.
+ *
+ * @return 1 if the value is "yes", 0 otherwise, if the preference is of
+ *         another type or the handle is invalid.
+ */
+int
+prefs_handle_get_bool (prefs_handle_t handle)
+{
+  prefs_entry_t *entry = prefs_entry_get (handle);
+
+  if (entry == NULL || entry->type != PREFS_TYPE_BOOL)
+    return 0;
+
+  return entry->int_value;
+}
+
+/**
+ * @brief Get the port ranges of a preference registered as PREFS_TYPE_PORTS.
+ *
+ * @param handle  Handle of the preference.
+ *
+ * @return The port ranges, owned by the preferences and valid until the
+ *         preference is set again. NULL if the preference has no valid
+ *         value, is of another type or the handle is invalid.
+ */
+array_t *
+prefs_handle_get_ports (prefs_handle_t handle)
+{
+  prefs_entry_t *entry = prefs_entry_get (handle);
+
+  if (entry == NULL || entry->type != PREFS_TYPE_PORTS)
+    return NULL;
+
+  return entry->ports;
+}
@@ -13,8 +13,26 @@
 #ifndef _GVM_PREFS_H
 #define _GVM_PREFS_H
 
+#include "array.h" /* for array_t */
+
 #include <glib.h> /* for gchar */
 
+/**
+ * @brief Types a registered preference is decoded as.
+ */
+typedef enum
+{
+  PREFS_TYPE_STRING, ///< The raw string value.
+  PREFS_TYPE_INT,    ///< An integer, as atoi() would decode it.
+  PREFS_TYPE_BOOL,   ///< A boolean, "yes" is true.
+  PREFS_TYPE_PORTS,  ///< A port range list.
+} prefs_type_t;
+
+/**
+ * @brief Handle of a registered preference, -1 if invalid.
+ */
+typedef int prefs_handle_t;
+
 void
 prefs_config (const char *);
 const gchar *
@@ -31,4 +49,25 @@ prefs_nvt_timeout (const char *);
 GHashTable *
 preferences_get (void);
 
+prefs_handle_t
+prefs_register (const gchar *, prefs_type_t);
+
+guint
+prefs_generation (void);
+
+int
+prefs_handle_is_set (prefs_handle_t);
+
+const gchar *
+prefs_handle_get (prefs_handle_t);
+
+int
+prefs_handle_get_int (prefs_handle_t, int);
+
+int
+prefs_handle_get_bool (prefs_handle_t);
+
+array_t *
+prefs_handle_get_ports (prefs_handle_t);
+
 #endif /* not _GVM_PREFS_H */
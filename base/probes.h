@@ -0,0 +1,60 @@
+/* SPDX-FileCopyrightText: 2026 Greenbone AG
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/**
+ * @file
+ * @brief Static tracepoints of the libraries.
+ *
+ * With ENABLE_PROBES the macros emit SystemTap SDT (USDT) probes of the
+ * provider "libgvm", which perf, bpftrace or stap attach to at run time,
+ * e.g. "bpftrace -e 'usdt:libgvm_util.so:libgvm:redis_cmd_receive
+ * { @us = hist (arg1) }'".  A probe not attached costs a nop.  Without
+ * ENABLE_PROBES the macros only evaluate their arguments, so these must be
+ * cheap and free of side effects.
+ *
+ * Arguments must be integers or pointers; durations are in microseconds,
+ * measured with GVM_PROBE_USEC, which is 0 without ENABLE_PROBES.
+ */
+
+#ifndef _GVM_PROBES_H
+#define _GVM_PROBES_H
+
+#ifdef GVM_ENABLE_PROBES
+
+#include <sys/sdt.h> /* for DTRACE_PROBE1, ... */
+#include <time.h>    /* for clock_gettime */
+
+#define GVM_PROBE(name) DTRACE_PROBE (libgvm, name)
+#define GVM_PROBE1(name, a1) DTRACE_PROBE1 (libgvm, name, a1)
+#define GVM_PROBE2(name, a1, a2) DTRACE_PROBE2 (libgvm, name, a1, a2)
+#define GVM_PROBE3(name, a1, a2, a3) DTRACE_PROBE3 (libgvm, name, a1, a2, a3)
+
+/**
+ * @brief Gets the monotonic time for the durations of probes.
+ *
+ * @return Time in microseconds.
+ */
+static inline long long
+gvm_probe_usec (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (long long) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+#define GVM_PROBE_USEC() gvm_probe_usec ()
+
+#else
+
+#define GVM_PROBE(name) ((void) 0)
+#define GVM_PROBE1(name, a1) ((void) (a1))
+#define GVM_PROBE2(name, a1, a2) ((void) (a1), (void) (a2))
+#define GVM_PROBE3(name, a1, a2, a3) ((void) (a1), (void) (a2), (void) (a3))
+#define GVM_PROBE_USEC() 0LL
+
+#endif
+
+#endif /* not _GVM_PROBES_H */
@@ -18,6 +18,7 @@
 #include <stdio.h> /* for fclose, fgets, fopen, FILE, ferror, EOF, getc */
 #include <stdlib.h>
 #include <string.h> /* for strstr, strlen, strncmp */
+#include <sys/stat.h> /* for stat */
 
 #ifndef DIM
 #define DIM(v) (sizeof (v) / sizeof ((v)[0]))
@@ -78,11 +79,11 @@
  *   #+search[:] FILENAME
  *
  *     This searches the file with name FILENAME for a match.  The
- *     comparison is case insensitive for all ASCII characters.  This
- *     is a simple linear search and stops at the first match.
- *     Comments are not allowed in that file.  A line in that file may
- *     not be longer than 255 characters.  An example for such a file
- *     is "/usr/share/dict/words".
+ *     comparison is case insensitive for all ASCII characters.  The
+ *     file is loaded into a hash table, which is reloaded when the
+ *     file changes.  Comments are not allowed in that file.  A line
+ *     in that file may not be longer than 255 characters.  An
+ *     example for such a file is "/usr/share/dict/words".
  *
  *   #+username
  *
@@ -148,11 +149,204 @@ is_keyword (char *string, const char *keyword)
   return NULL;
 }
 
+/**
+ * @brief A file read into memory, kept until the file changes.
+ */
+typedef struct
+{
+  gchar *contents;       ///< Contents of the file.
+  gsize length;          ///< Length of the contents.
+  GHashTable *words;     ///< Words of a dictionary, or NULL.
+  dev_t dev;             ///< Device of the file.
+  ino_t ino;             ///< Inode of the file.
+  off_t size;            ///< Size of the file.
+  struct timespec mtime; ///< Modification time of the file.
+  guint generation;      ///< Number of the read, to detect reloads.
+} cached_file_t;
+
+/**
+ * @brief Files read, by name.
+ */
+static GHashTable *cached_files = NULL;
+
+/**
+ * @brief Compiled regular expressions of the pattern file, NULL if invalid.
+ */
+static GHashTable *cached_regexes = NULL;
+
+/**
+ * @brief Lock for the caches.
+ */
+static GMutex cache_mutex;
+
+/**
+ * @brief Free a cached file.
+ *
+ * @param data  Cached file.
+ */
+static void
+cached_file_free (gpointer data)
+{
+  cached_file_t *file = data;
+
+  if (file->words)
+    g_hash_table_destroy (file->words);
+  g_free (file->contents);
+  g_free (file);
+}
+
+/**
+ * @brief Free a cached regular expression.
+ *
+ * @param data  Regular expression, or NULL.
+ */
+static void
+cached_regex_free (gpointer data)
+{
+  if (data)
+    g_regex_unref (data);
+}
+
+/**
+ * @brief Put the words of a dictionary into a hash table.
+ *
+ * Lines that are too long or not terminated are skipped, like empty ones.
+ * The words are converted to ASCII lower case in place, so the hash table
+ * refers to the contents of the file.
+ *
+ * @param file  Cached file.
+ */
+static void
+cached_file_index_words (cached_file_t *file)
+{
+  gchar *line, *end;
+
+  file->words = g_hash_table_new (g_str_hash, g_str_equal);
+  end = file->contents + file->length;
+  for (line = file->contents; line < end;)
+    {
+      gchar *lf;
+      size_t len;
+
+      lf = memchr (line, '\n', end - line);
+      if (lf == NULL)
+        break; /* Incomplete last line. */
+      len = lf - line;
+      *lf = 0;
+      /* Skip lines longer than fgets would read into 256 bytes. */
+      if (len < 256 - 2)
+        {
+          if (len && line[len - 1] == '\r')
+            line[--len] = 0; /* Chop an optional CR. */
+          if (len)
+            {
+              gchar *p;
+
+              for (p = line; *p; p++)
+                *p = g_ascii_tolower (*p);
+              g_hash_table_add (file->words, line);
+            }
+        }
+      line = lf + 1;
+    }
+}
+
+/**
+ * @brief Get a file from the cache, reading it if it changed.
+ *
+ * Must be called with the cache lock held.
+ *
+ * @param fname       Name of the file.
+ * @param dictionary  Whether the file is a dictionary of words.
+ *
+ * @return The cached file, or NULL with errno set on error.
+ */
+static cached_file_t *
+cached_file_get (const char *fname, gboolean dictionary)
+{
+  static guint generation = 0;
+  cached_file_t *file;
+  struct stat st;
+  GError *error = NULL;
+
+  if (stat (fname, &st))
+    return NULL;
+
+  if (cached_files == NULL)
+    cached_files =
+      g_hash_table_new_full (g_str_hash, g_str_equal, g_free, cached_file_free);
+
+  file = g_hash_table_lookup (cached_files, fname);
+  if (file && file->dev == st.st_dev && file->ino == st.st_ino
+      && file->size == st.st_size && file->mtime.tv_sec == st.st_mtim.tv_sec
+      && file->mtime.tv_nsec == st.st_mtim.tv_nsec
+      && (file->words != NULL) == dictionary)
+    return file;
+
+  file = g_malloc0 (sizeof (cached_file_t));
+  if (!g_file_get_contents (fname, &file->contents, &file->length, &error))
+    {
+      g_free (file);
+      g_error_free (error);
+      errno = EIO;
+      return NULL;
+    }
+  file->dev = st.st_dev;
+  file->ino = st.st_ino;
+  file->size = st.st_size;
+  file->mtime = st.st_mtim;
+  file->generation = ++generation;
+  if (dictionary)
+    cached_file_index_words (file);
+  g_hash_table_replace (cached_files, g_strdup (fname), file);
+  return file;
+}
+
+/**
+ * @brief Match a password against a regular expression of the pattern file.
+ *
+ * The regular expression is compiled once.  Must be called with the cache
+ * lock held.
+ *
+ * @param pattern   Regular expression.
+ * @param password  Password.
+ *
+ * @return TRUE if the password matches, FALSE if not or if the regular
+ *         expression is invalid.
+ */
+static gboolean
+pattern_regex_match (const char *pattern, const char *password)
+{
+  GRegex *regex;
+
+  if (cached_regexes == NULL)
+    cached_regexes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                            cached_regex_free);
+
+  if (!g_hash_table_lookup_extended (cached_regexes, pattern, NULL,
+                                     (gpointer *) &regex))
+    {
+      GError *error = NULL;
+
+      regex = g_regex_new (pattern, G_REGEX_CASELESS, 0, &error);
+      if (regex == NULL)
+        {
+          g_warning ("%s: %s", __func__, error->message);
+          g_error_free (error);
+        }
+      g_hash_table_insert (cached_regexes, g_strdup (pattern), regex);
+    }
+
+  return regex && g_regex_match (regex, password, 0, NULL);
+}
+
 /**
  * @brief Search a file for a matching line
  *
  * This is a case insensitive search for a password in a file.  The
- * file is assumed to be a simple LF delimited list of words.
+ * file is assumed to be a simple LF delimited list of words.  The
+ * words are kept in a hash table until the file changes.  Must be
+ * called with the cache lock held.
  *
  * @param fname    Name of the file to search.
  * @param password Password to search for.
@@ -163,47 +357,18 @@ is_keyword (char *string, const char *keyword)
 static int
 search_file (const char *fname, const char *password)
 {
-  FILE *fp;
-  int c;
-  char line[256];
+  cached_file_t *file;
+  gchar *folded;
+  int found;
 
-  fp = fopen (fname, "r");
-  if (!fp)
+  file = cached_file_get (fname, TRUE);
+  if (file == NULL)
     return -1;
 
-  while (fgets (line, DIM (line) - 1, fp))
-    {
-      size_t len;
-
-      len = strlen (line);
-      if (!len || line[len - 1] != '\n')
-        {
-          /* Incomplete last line or line too long.  Eat until end of
-             line. */
-          while ((c = getc (fp)) != EOF && c != '\n')
-            ;
-          continue;
-        }
-      line[--len] = 0; /* Chop the LF. */
-      if (len && line[len - 1] == '\r')
-        line[--len] = 0; /* Chop an optional CR. */
-      if (!len)
-        continue; /* Empty */
-      if (!g_ascii_strcasecmp (line, password))
-        {
-          fclose (fp);
-          return 1; /* Found.  */
-        }
-    }
-  if (ferror (fp))
-    {
-      int save_errno = errno;
-      fclose (fp);
-      errno = save_errno;
-      return -1; /* Read error.  */
-    }
-  fclose (fp);
-  return 0; /* Not found.  */
+  folded = g_ascii_strdown (password, -1);
+  found = g_hash_table_contains (file->words, folded);
+  g_free (folded);
+  return found ? 1 : 0;
 }
 
 /**
@@ -313,7 +478,7 @@ parse_pattern_line (char *line, const char *fname, int lineno, char **descp,
       n = strlen (line);
       if (n && line[n - 1] == '/')
         line[n - 1] = 0;
-      if (((!g_regex_match_simple (line, password, G_REGEX_CASELESS, 0)) ^ rev))
+      if (((!pattern_regex_match (line, password)) ^ rev))
         ret = NULL;
       else if (*descp)
         ret = g_strdup_printf ("Weak password (%s)", *descp);
@@ -349,11 +514,13 @@ char *
 gvm_validate_password (const char *password, const char *username)
 {
   const char *patternfile = PWPOLICY_FILE_NAME;
+  static guint regexes_generation = 0;
+  cached_file_t *file;
   char *ret;
-  FILE *fp;
   int lineno;
   char line[256];
   char *desc = NULL;
+  const gchar *next, *end;
 
   if (disable_password_policy)
     return NULL;
@@ -361,28 +528,43 @@ gvm_validate_password (const char *password, const char *username)
   if (!password || !*password)
     return g_strdup ("Empty password");
 
-  fp = fopen (patternfile, "r");
-  if (!fp)
+  g_mutex_lock (&cache_mutex);
+  file = cached_file_get (patternfile, FALSE);
+  if (!file)
     {
+      g_mutex_unlock (&cache_mutex);
       g_warning ("error opening '%s': %s", patternfile, g_strerror (errno));
       return policy_checking_failed ();
     }
+  /* The regular expressions of an older pattern file are not needed. */
+  if (cached_regexes && regexes_generation != file->generation)
+    g_hash_table_remove_all (cached_regexes);
+  regexes_generation = file->generation;
+
   lineno = 0;
   ret = NULL;
-  while (fgets (line, DIM (line) - 1, fp))
+  end = file->contents + file->length;
+  for (next = file->contents; next < end;)
     {
+      const gchar *lf;
       size_t len;
 
       lineno++;
-      len = strlen (line);
-      if (!len || line[len - 1] != '\n')
+      /* Read at most DIM (line) - 2 bytes per line, as fgets would. */
+      len = MIN ((size_t) (end - next), DIM (line) - 2);
+      lf = memchr (next, '\n', len);
+      if (lf == NULL)
         {
           g_warning ("error reading '%s', line %d: %s", patternfile, lineno,
-                     len ? "line too long" : "line without a LF");
+                     len == DIM (line) - 2 ? "line too long"
+                                           : "line without a LF");
           ret = policy_checking_failed ();
           break;
         }
-      line[--len] = 0; /* Chop the LF. */
+      len = lf - next;
+      memcpy (line, next, len);
+      line[len] = 0;
+      next = lf + 1;
       if (len && line[len - 1] == '\r')
         line[--len] = 0; /* Chop an optional CR. */
       ret = parse_pattern_line (line, patternfile, lineno, &desc, password,
@@ -392,8 +574,8 @@ gvm_validate_password (const char *password, const char *username)
 
       bzero (line, sizeof (line));
     }
+  g_mutex_unlock (&cache_mutex);
 
-  fclose (fp);
   g_free (desc);
   return ret;
 }
@@ -11,7 +11,8 @@
 #include "strings.h"
 
 #include <assert.h> /* for assert */
-#include <glib.h>   /* for g_free, g_strconcat, gchar, g_strdup, g_strndup */
+#include <glib.h>   /* for g_free, g_realloc, gchar, g_strdup, g_strndup */
+#include <string.h> /* for memcpy, strlen */
 
 #undef G_LOG_DOMAIN
 /**
@@ -19,14 +20,37 @@
  */
 #define G_LOG_DOMAIN "libgvm base"
 
+/**
+ * @brief Append memory to a string variable in place.
+ *
+ * The string is reallocated, which lets the allocator grow it without
+ * copying where it can.
+ *
+ * @param[in]  var     The address of a string variable holding a string.
+ * @param[in]  string  The memory to append.
+ * @param[in]  length  The length of the memory.
+ */
+static void
+append_in_place (gchar **var, const gchar *string, gsize length)
+{
+  gsize old_length = strlen (*var);
+
+  *var = g_realloc (*var, old_length + length + 1);
+  memcpy (*var + old_length, string, length);
+  (*var)[old_length + length] = '\0';
+}
+
 /**
  * @brief Append a string to a string variable.
  *
  * When the variable is NULL store a copy of the given string in the variable.
  *
- * When the variable already contains a string replace the string with a new
- * string that is the concatenation of the two, freeing the old string.  It is
- * up to the caller to free the given string if it was dynamically allocated.
+ * When the variable already contains a string append the given string to it,
+ * reallocating the string in the variable.  It is up to the caller to free
+ * the given string if it was dynamically allocated.
+ *
+ * Building a long string with many appends should use a
+ * gvm_string_builder_t instead, which does not rescan the string each time.
  *
  * @param[in]  var     The address of a string variable, that is, a pointer to
  *                     a string.
@@ -36,11 +60,7 @@ void
 gvm_append_string (gchar **var, const gchar *string)
 {
   if (*var)
-    {
-      char *old = *var;
-      *var = g_strconcat (old, string, NULL);
-      g_free (old);
-    }
+    append_in_place (var, string, strlen (string));
   else
     *var = g_strdup (string);
 }
@@ -50,9 +70,9 @@ gvm_append_string (gchar **var, const gchar *string)
  *
  * When the variable is NULL store a copy of the given string in the variable.
  *
- * When the variable already contains a string replace the string with a new
- * string that is the concatenation of the two, freeing the old string.  It is
- * up to the caller to free the given string if it was dynamically allocated.
+ * When the variable already contains a string append the given string to it,
+ * reallocating the string in the variable.  It is up to the caller to free
+ * the given string if it was dynamically allocated.
  *
  * The string must be NULL terminated, and the given length must be the
  * actual length of the string.
@@ -66,11 +86,7 @@ void
 gvm_append_text (gchar **var, const gchar *string, gsize length)
 {
   if (*var)
-    {
-      char *old = *var;
-      *var = g_strconcat (old, string, NULL);
-      g_free (old);
-    }
+    append_in_place (var, string, length);
   else
     *var = g_strndup (string, length);
 }
@@ -90,6 +106,79 @@ gvm_free_string_var (gchar **var)
   *var = NULL;
 }
 
+/**
+ * @brief Append a string of a known length to a string builder.
+ *
+ * The buffer at least doubles when it has to grow, so building a string of
+ * any length takes linear time.
+ *
+ * @param[in]  builder  The string builder.
+ * @param[in]  string   The string to append.  Need not be NULL terminated.
+ * @param[in]  length   The number of bytes of string to append.
+ */
+void
+gvm_string_builder_append_len (gvm_string_builder_t *builder,
+                               const gchar *string, gsize length)
+{
+  if (builder->len + length + 1 > builder->allocated)
+    {
+      gsize allocated = MAX (builder->allocated * 2, 64);
+
+      while (allocated < builder->len + length + 1)
+        allocated *= 2;
+      builder->str = g_realloc (builder->str, allocated);
+      builder->allocated = allocated;
+    }
+  memcpy (builder->str + builder->len, string, length);
+  builder->len += length;
+  builder->str[builder->len] = '\0';
+}
+
+/**
+ * @brief Append a string to a string builder.
+ *
+ * @param[in]  builder  The string builder.
+ * @param[in]  string   The NULL terminated string to append.
+ */
+void
+gvm_string_builder_append (gvm_string_builder_t *builder, const gchar *string)
+{
+  gvm_string_builder_append_len (builder, string, strlen (string));
+}
+
+/**
+ * @brief Take the string out of a string builder.
+ *
+ * The builder is left empty and can be reused.
+ *
+ * @param[in]  builder  The string builder.
+ *
+ * @return The string, to be freed with g_free. NULL if nothing was appended.
+ */
+gchar *
+gvm_string_builder_steal (gvm_string_builder_t *builder)
+{
+  gchar *str = builder->str;
+
+  builder->str = NULL;
+  builder->len = 0;
+  builder->allocated = 0;
+  return str;
+}
+
+/**
+ * @brief Free the string of a string builder.
+ *
+ * The builder is left empty and can be reused.
+ *
+ * @param[in]  builder  The string builder.
+ */
+void
+gvm_string_builder_free (gvm_string_builder_t *builder)
+{
+  g_free (gvm_string_builder_steal (builder));
+}
+
 /**
  * @brief "Strip" space and newline characters from either end of some memory.
  *
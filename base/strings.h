@@ -13,6 +13,27 @@
 
 #include <glib.h>
 
+/**
+ * @brief A string built up by appending, growing its buffer by doubling.
+ *
+ * The str member is NULL or a normal NULL terminated string, so it can be
+ * used wherever a string variable built with gvm_append_string is.
+ */
+typedef struct
+{
+  gchar *str;      ///< The string, NULL while nothing was appended.
+  gsize len;       ///< Length of the string.
+  gsize allocated; ///< Size of the buffer of the string.
+} gvm_string_builder_t;
+
+/**
+ * @brief Initializer of an empty gvm_string_builder_t.
+ */
+#define GVM_STRING_BUILDER_INIT \
+  {                             \
+    NULL, 0, 0                  \
+  }
+
 void
 gvm_append_string (gchar **, const gchar *);
 void
@@ -20,6 +41,15 @@ gvm_append_text (gchar **, const gchar *, gsize);
 void
 gvm_free_string_var (gchar **);
 
+void
+gvm_string_builder_append (gvm_string_builder_t *, const gchar *);
+void
+gvm_string_builder_append_len (gvm_string_builder_t *, const gchar *, gsize);
+gchar *
+gvm_string_builder_steal (gvm_string_builder_t *);
+void
+gvm_string_builder_free (gvm_string_builder_t *);
+
 char *
 gvm_strip_space (char *, char *);
 
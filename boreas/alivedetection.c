@@ -42,6 +42,203 @@
 
 scanner_t scanner;
 
+/* Minimum time to wait for replies after the last ping with the adaptive
+ * wait, in microseconds. */
+#define ADAPTIVE_WAIT_MIN 100000
+
+/* Time to wait for the replies to the all-nodes echo requests before the
+ * neighbor solicitations, in microseconds. */
+#define NDP_ALL_NODES_WAIT 200000
+
+/**
+ * @brief Send the pings of the alive tests to the targets without reply.
+ *
+ * @param pool        Pool of sender threads.
+ * @param alive_test  Alive tests.
+ * @param start       Index of the first target.
+ * @param end         Index after the last target.
+ * @param settle      Whether to wait half a second after a test.
+ */
+static void
+send_pings (send_pool_t *pool, alive_test_t alive_test, int start, int end,
+            gboolean settle)
+{
+  if (alive_test & ALIVE_TEST_ICMP)
+    {
+      g_debug ("%s: ICMP Ping", __func__);
+      alive_stats_set_method (ALIVE_TEST_ICMP);
+      send_pool_run (pool, send_icmp, start, end);
+      send_pool_drain (pool, ALIVE_TEST_ICMP);
+      if (settle)
+        usleep (500000);
+    }
+  if (alive_test & ALIVE_TEST_TCP_SYN_SERVICE)
+    {
+      g_debug ("%s: TCP-SYN Service Ping", __func__);
+      alive_stats_set_method (ALIVE_TEST_TCP_SYN_SERVICE);
+      scanner.tcp_flag = TH_SYN; /* SYN */
+      send_pool_run (pool, send_tcp, start, end);
+      send_pool_drain (pool, ALIVE_TEST_TCP_SYN_SERVICE);
+      if (settle)
+        usleep (500000);
+    }
+  if (alive_test & ALIVE_TEST_TCP_ACK_SERVICE)
+    {
+      g_debug ("%s: TCP-ACK Service Ping", __func__);
+      alive_stats_set_method (ALIVE_TEST_TCP_ACK_SERVICE);
+      scanner.tcp_flag = TH_ACK; /* ACK */
+      send_pool_run (pool, send_tcp, start, end);
+      send_pool_drain (pool, ALIVE_TEST_TCP_ACK_SERVICE);
+      if (settle)
+        usleep (500000);
+    }
+  if (alive_test & ALIVE_TEST_ARP)
+    {
+      g_debug ("%s: ARP Ping", __func__);
+      alive_stats_set_method (ALIVE_TEST_ARP);
+      /* The hosts on the local links which answer the all-nodes echo request
+       * are not solicited one by one. */
+      if (scanner.ndp_links && start == 0)
+        {
+          send_ndp_all_nodes (&scanner);
+          usleep (NDP_ALL_NODES_WAIT);
+        }
+      send_pool_run (pool, send_arp, start, end);
+      send_pool_drain (pool, ALIVE_TEST_ARP);
+    }
+}
+
+/**
+ * @brief Get the number of alive hosts which count for the progress.
+ *
+ * The alive hosts above the max_scan_hosts limit are counted as dead.
+ *
+ * @return Number of alive hosts.
+ */
+static int
+progress_alive_hosts (void)
+{
+  int alive = g_hash_table_size (scanner.hosts_data->alivehosts);
+
+  if (scanner.scan_restrictions->max_scan_hosts_reached)
+    alive = MIN (alive, scanner.scan_restrictions->max_scan_hosts);
+  return alive;
+}
+
+/**
+ * @brief Send the dead hosts among the checked targets to ospd-openvas.
+ *
+ * The dead hosts are the checked targets which are not alive, minus the
+ * dead hosts already sent.
+ *
+ * @param checked   Number of targets checked.
+ * @param reported  Number of dead hosts sent so far, updated.
+ */
+static void
+send_dead_hosts_progress (int checked, int *reported)
+{
+  int dead = checked - progress_alive_hosts () - *reported;
+
+  if (dead > 0)
+    {
+      send_dead_hosts_to_ospd_openvas (dead);
+      *reported += dead;
+    }
+}
+
+/**
+ * @brief Send the pings of the alive tests in batches of targets, sending
+ * the dead hosts to ospd-openvas while sending.
+ *
+ * All the alive tests are sent to one batch before the next is started.
+ * Every "alive_test_progress_interval" milliseconds (1000 by default) the
+ * targets sent before the previous update are sent as checked, so that
+ * their replies have had one interval to arrive.
+ *
+ * @param pool              Pool of sender threads.
+ * @param alive_test        Alive tests.
+ * @param number_of_targets Number of targets.
+ * @param reported          Number of dead hosts sent, updated.
+ */
+static void
+send_pings_with_progress (send_pool_t *pool, alive_test_t alive_test,
+                          int number_of_targets, int *reported)
+{
+  int batch = 1000;
+  int checked = 0;
+  gint64 interval, last;
+  const gchar *tmp;
+
+  tmp = prefs_get ("alive_test_progress_interval");
+  interval = (tmp ? atoi (tmp) : 1000) * (gint64) 1000;
+  last = g_get_monotonic_time ();
+  for (int packets_send = 0; packets_send < number_of_targets;)
+    {
+      gint64 now;
+
+      send_pings (pool, alive_test, packets_send, packets_send + batch, FALSE);
+      packets_send = MIN (packets_send + batch, number_of_targets);
+
+      now = g_get_monotonic_time ();
+      if (now - last >= interval)
+        {
+          send_dead_hosts_progress (checked, reported);
+          checked = packets_send;
+          last = now;
+        }
+    }
+}
+
+/**
+ * @brief Wait for the replies to the sent pings.
+ *
+ * Waits at most the "test_alive_wait_timeout", and not at all once all the
+ * targets are alive. With the adaptive wait, the wait ends as well once the
+ * retransmission timeout computed from the round trip times has passed
+ * since the last ping or reply. Without round trip time samples, for
+ * example if no host replied, the whole timeout is waited.
+ *
+ * @param number_of_targets Number of targets.
+ * @param adaptive          Whether to end the wait on the round trip times.
+ * @param backoff           Factor of the retransmission timeout.
+ */
+static void
+wait_for_replies (int number_of_targets, gboolean adaptive, int backoff)
+{
+  gint64 start, end;
+
+  if (!adaptive)
+    {
+      for (unsigned int i = 0; i < get_alive_test_wait_timeout (); i++)
+        {
+          if (number_of_targets
+              == (int) g_hash_table_size (scanner.hosts_data->alivehosts))
+            break;
+          sleep (1); // 1 second is the minimum wait time
+        }
+      return;
+    }
+
+  start = g_get_monotonic_time ();
+  end = start + (gint64) get_alive_test_wait_timeout () * G_USEC_PER_SEC;
+  while (number_of_targets
+         != (int) g_hash_table_size (scanner.hosts_data->alivehosts))
+    {
+      gint64 now = g_get_monotonic_time ();
+      gint64 deadline = rtt_estimator_deadline (scanner.rtt, start, backoff);
+
+      if (deadline)
+        deadline = CLAMP (deadline, start + ADAPTIVE_WAIT_MIN, end);
+      else
+        deadline = end;
+      if (now >= deadline)
+        break;
+      usleep (MIN (deadline - now, 10000));
+    }
+  g_debug ("%s: waited %" G_GINT64_FORMAT " ms for replies", __func__,
+           (g_get_monotonic_time () - start) / 1000);
+}
+
 /**
  * @brief Scan function starts a sniffing thread which waits for packets to
  * arrive and sends pings to hosts we want to test. Blocks until Scan is
@@ -56,17 +253,19 @@ static int
 scan (alive_test_t alive_test)
 {
   int number_of_targets;
-  int number_of_dead_hosts;
   pthread_t sniffer_thread_id;
+  send_pool_t *pool;
+  gboolean adaptive;
+  sniffer_stats_t capture_stats;
+  gchar *stats;
   GHashTableIter target_hosts_iter;
   gpointer key, value;
   struct timeval start_time, end_time;
   int scandb_id;
   gchar *scan_id;
-  /* Following variables are only relevant if only ICMP was chosen. */
-  int remaining_batch = 0;
-  int prev_alive = 0;
-  gboolean limit_reached_handled = FALSE; /* Scan restrictions related. */
+  /* Number of dead hosts sent to ospd-openvas so far. */
+  int reported = 0;
+  gboolean progress;
 
   gettimeofday (&start_time, NULL);
   number_of_targets = g_hash_table_size (scanner.hosts_data->targethosts);
@@ -76,6 +275,13 @@ scan (alive_test_t alive_test)
   g_message ("Alive scan %s started: Target has %d hosts", scan_id,
              number_of_targets);
 
+  alive_stats_reset ();
+  /* Push the alive hosts on the queue from a separate thread, so that the
+   * sniffer does not wait for the KB. */
+  host_publisher_start (scanner.main_kb);
+  /* Send the dead hosts to ospd-openvas without waiting for the KB. */
+  results_publisher_start ();
+
   /* Check first if consider alive test method is set. In case that
    * there is no scan restrictions, no other test will be performed, because
    * it doesn't make sense.
@@ -99,126 +305,39 @@ scan (alive_test_t alive_test)
       goto finish_alive_test;
     }
 
+  /* Measure the round trip times to end the wait for replies early. */
+  adaptive = prefs_get_bool ("alive_test_adaptive_wait");
+  if (adaptive)
+    {
+      scanner.rtt = rtt_estimator_new ();
+      send_record_times (scanner.hosts_data->targets_set);
+    }
+
   /* Sniffer thread needed if any alive test besides ALIVE_TEST_CONSIDER_ALIVE
    * was chosen. */
   if (alive_test != ALIVE_TEST_CONSIDER_ALIVE)
     {
       sniffer_thread_id = 0;
-      start_sniffer_thread (&scanner, &sniffer_thread_id);
+      start_sniffer_thread (&scanner, alive_test, &sniffer_thread_id);
     }
 
-  /* Continuously send dead hosts to ospd if only ICMP was chosen instead of
-   * sending all at once at the end. This is done for displaying a progressbar
-   * that increases gradually. */
-  if (alive_test == ALIVE_TEST_ICMP)
-    {
-      g_hash_table_iter_init (&target_hosts_iter,
-                              scanner.hosts_data->targethosts);
-      int batch = 1000;
-      int curr_alive = 0;
-      prev_alive = 0;
-      /* Number of hosts in last batch. Depending on the total number of hosts
-       * the last batch size maybe be double the normal size. Info about the
-       * last batch is send after all hosts were checked and we waited for last
-       * packets to arrive.*/
-      remaining_batch = number_of_targets;
-      for (int packets_send = 0;
-           g_hash_table_iter_next (&target_hosts_iter, &key, &value);)
-        {
-          send_icmp (key, value, &scanner);
-          packets_send++;
-          /* Send dead hosts update after batch number of packets were send and
-           * we still have more than batch size packets remaining. */
-          if (packets_send % batch == 0
-              && (number_of_targets - packets_send) > batch)
-            {
-              /* The number of dead hosts we have to send to ospd is the batch
-               * size minus the newly found alive hosts. The newly found alive
-               * hosts is the diff between the current total of alive hosts and
-               * the total of the last batch. */
-              curr_alive = g_hash_table_size (scanner.hosts_data->alivehosts);
-              number_of_dead_hosts = batch - (curr_alive - prev_alive);
-
-              /* If the max_scan_hosts limit was reached we can not tell ospd
-               * the true number of dead hosts. The number of alive hosts which
-               * are above the max_scan_hosts limit are not to be subtracted
-               * form the dead hosts to send. They are considered as dead hosts
-               * for the progress bar.*/
-              if (scanner.scan_restrictions->max_scan_hosts_reached)
-                {
-                  /* Handle the case where we reach the max_scan_hosts for the
-                   * first time. We may have to consider some of the new alive
-                   * hosts as dead because of the restriction. E.g
-                   * curr_alive=110 prev_alive=90 max_scan_hosts=100 batch=100.
-                   * Normally we would send 80 as dead in this batch (20 new
-                   * alive hosts) but because of the restriction we send 90 as
-                   * dead. The 10 hosts which are over the limit are considered
-                   * as dead.
-                   * After this limit case was handled we just always send the
-                   * complete batch as dead hosts.*/
-                  if (!limit_reached_handled)
-                    {
-                      /* Number of alive hosts until limit was reached. */
-                      int last_hosts_considered_as_alive =
-                        scanner.scan_restrictions->max_scan_hosts - prev_alive;
-                      number_of_dead_hosts =
-                        batch - last_hosts_considered_as_alive;
-                      send_dead_hosts_to_ospd_openvas (number_of_dead_hosts);
-                      remaining_batch -= batch;
-                      limit_reached_handled = TRUE;
-                    }
-                  else
-                    {
-                      send_dead_hosts_to_ospd_openvas (batch);
-                      remaining_batch -= batch;
-                    }
-                }
-              else
-                {
-                  send_dead_hosts_to_ospd_openvas (number_of_dead_hosts);
-                  remaining_batch -= batch;
-                }
-              prev_alive = curr_alive;
-            }
-        }
-    }
-  else if (alive_test & ALIVE_TEST_ICMP)
-    {
-      g_debug ("%s: ICMP Ping", __func__);
-      g_hash_table_foreach (scanner.hosts_data->targethosts, send_icmp,
-                            &scanner);
-      wait_until_so_sndbuf_empty (scanner.icmpv4soc, 10);
-      wait_until_so_sndbuf_empty (scanner.icmpv6soc, 10);
-      usleep (500000);
-    }
-  if (alive_test & ALIVE_TEST_TCP_SYN_SERVICE)
-    {
-      g_debug ("%s: TCP-SYN Service Ping", __func__);
-      scanner.tcp_flag = TH_SYN; /* SYN */
-      g_hash_table_foreach (scanner.hosts_data->targethosts, send_tcp,
-                            &scanner);
-      wait_until_so_sndbuf_empty (scanner.tcpv4soc, 10);
-      wait_until_so_sndbuf_empty (scanner.tcpv6soc, 10);
-      usleep (500000);
-    }
-  if (alive_test & ALIVE_TEST_TCP_ACK_SERVICE)
-    {
-      g_debug ("%s: TCP-ACK Service Ping", __func__);
-      scanner.tcp_flag = TH_ACK; /* ACK */
-      g_hash_table_foreach (scanner.hosts_data->targethosts, send_tcp,
-                            &scanner);
-      wait_until_so_sndbuf_empty (scanner.tcpv4soc, 10);
-      wait_until_so_sndbuf_empty (scanner.tcpv6soc, 10);
-      usleep (500000);
-    }
-  if (alive_test & ALIVE_TEST_ARP)
-    {
-      g_debug ("%s: ARP Ping", __func__);
-      g_hash_table_foreach (scanner.hosts_data->targethosts, send_arp,
-                            &scanner);
-      wait_until_so_sndbuf_empty (scanner.arpv4soc, 10);
-      wait_until_so_sndbuf_empty (scanner.arpv6soc, 10);
-    }
+  /* The sender threads inherit the CPUs of this thread. */
+  thread_cpus_apply (scanner.sender_cpus);
+
+  /* The targets are partitioned between the sender threads. */
+  pool = send_pool_new (&scanner, alive_test);
+
+  /* Continuously send dead hosts to ospd instead of sending all at once at
+   * the end. This is done for displaying a progressbar that increases
+   * gradually. Not possible if hosts checked may still become alive
+   * afterwards, because they are considered alive or the pings will be
+   * retransmitted. */
+  progress = !(alive_test & ALIVE_TEST_CONSIDER_ALIVE)
+             && !prefs_get_bool ("alive_test_retransmit");
+  if (progress)
+    send_pings_with_progress (pool, alive_test, number_of_targets, &reported);
+  else
+    send_pings (pool, alive_test, 0, number_of_targets, !adaptive);
   if (alive_test & ALIVE_TEST_CONSIDER_ALIVE)
     {
       g_debug ("%s: Consider Alive", __func__);
@@ -239,63 +358,34 @@ scan (alive_test_t alive_test)
         "%s: all ping packets have been sent, wait a bit for rest of replies.",
         __func__);
 
-      for (unsigned int i = 0; i < get_alive_test_wait_timeout (); i++)
+      wait_for_replies (number_of_targets, adaptive, 1);
+      if (prefs_get_bool ("alive_test_retransmit")
+          && number_of_targets
+               != (int) g_hash_table_size (scanner.hosts_data->alivehosts))
         {
-          if (number_of_targets
-              == (int) g_hash_table_size (scanner.hosts_data->alivehosts))
-            break;
-          sleep (1); // 1 second is the minimum wait time
+          g_debug ("%s: retransmit pings to hosts without reply.", __func__);
+          send_pings (pool, alive_test, 0, number_of_targets, !adaptive);
+          wait_for_replies (number_of_targets, adaptive, 2);
         }
       stop_sniffer_thread (&scanner, sniffer_thread_id);
+      get_sniffer_stats (&capture_stats);
+      alive_stats_set_capture (capture_stats.received, capture_stats.dropped);
     }
+  send_pool_free (pool);
+  send_record_times (NULL);
+  rtt_estimator_free (scanner.rtt);
+  scanner.rtt = NULL;
 
 finish_alive_test:
-  /* If only ICMP was specified we continuously send updates about dead hosts to
-   * ospd while checking the hosts. We now only have to send the dead hosts of
-   * the last batch. This is done here to catch the last alive hosts which may
-   * have arrived after all packets were already sent.
-   * Else send total number of dead host at once.*/
-  if (alive_test == ALIVE_TEST_ICMP)
-    {
-      if (scanner.scan_restrictions->max_scan_hosts_reached)
-        {
-          /* We reached the max_scan_host limit in the last batch. For detailed
-           * description look at the first time where limit_reached_handled is
-           * used.*/
-          if (!limit_reached_handled)
-            {
-              /* Number of alive hosts until limit was reached. */
-              int last_hosts_considered_as_alive =
-                scanner.scan_restrictions->max_scan_hosts - prev_alive;
-              number_of_dead_hosts =
-                remaining_batch - last_hosts_considered_as_alive;
-              send_dead_hosts_to_ospd_openvas (number_of_dead_hosts);
-            }
-          else
-            {
-              send_dead_hosts_to_ospd_openvas (remaining_batch);
-            }
-        }
-      else
-        {
-          int curr_alive = g_hash_table_size (scanner.hosts_data->alivehosts);
-          number_of_dead_hosts = remaining_batch - (curr_alive - prev_alive);
-          send_dead_hosts_to_ospd_openvas (number_of_dead_hosts);
-        }
-    }
-  else
-    {
-      number_of_dead_hosts =
-        number_of_targets - g_hash_table_size (scanner.hosts_data->alivehosts);
-
-      /* Send number of dead hosts to ospd-openvas. We need to consider the scan
-       * restrictions.*/
-      if (scanner.scan_restrictions->max_scan_hosts_reached)
-        send_dead_hosts_to_ospd_openvas (
-          number_of_targets - scanner.scan_restrictions->max_scan_hosts);
-      else
-        send_dead_hosts_to_ospd_openvas (number_of_dead_hosts);
-    }
+  host_publisher_stop ();
+
+  /* Send the dead hosts not sent while checking the hosts. This is done here
+   * to catch the last alive hosts which may have arrived after all packets
+   * were already sent. We need to consider the scan restrictions. Hosts
+   * already sent as dead may have replied since, so the remainder can be
+   * negative, in which case nothing is sent. */
+  send_dead_hosts_progress (number_of_targets, &reported);
+  results_publisher_stop ();
 
   gettimeofday (&end_time, NULL);
 
@@ -303,6 +393,10 @@ finish_alive_test:
              scan_id, end_time.tv_sec - start_time.tv_sec,
              g_hash_table_size (scanner.hosts_data->alivehosts),
              number_of_targets);
+  stats = alive_stats_to_json ();
+  g_message ("Alive scan %s statistics: %s", scan_id, stats);
+  g_free (stats);
+  alive_stats_publish (scanner.main_kb);
   g_free (scan_id);
 
   return 0;
@@ -327,6 +421,8 @@ alive_detection_init (gvm_hosts_t *hosts, alive_test_t alive_test)
   const gchar *port_list = NULL;
   GPtrArray *portranges_array = NULL;
   boreas_error_t error = NO_ERROR;
+  const char *sniffer_cpus, *sender_cpus;
+  char *iface = NULL;
 
   /* Scanner */
 
@@ -334,6 +430,12 @@ alive_detection_init (gvm_hosts_t *hosts, alive_test_t alive_test)
   if ((error = set_all_needed_sockets (&scanner, alive_test)) != 0)
     return error;
 
+  /* Solicit IPv6 neighbors on the local links through multicast. */
+  scanner.ndp_links = NULL;
+  if ((alive_test & ALIVE_TEST_ARP)
+      && prefs_get_bool ("alive_test_ndp_multicast"))
+    scanner.ndp_links = ndp_links_new ();
+
   /* Do not print results in stdout. Only set for command line clients*/
   scanner.print_results = 0;
 
@@ -354,16 +456,33 @@ alive_detection_init (gvm_hosts_t *hosts, alive_test_t alive_test)
   scanner.hosts_data->targethosts =
     g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
 
+  scanner.hosts_data->targets_set = addr_set_new (gvm_hosts_count (hosts));
+  scanner.hosts_data->alive_set = addr_set_new (gvm_hosts_count (hosts));
+
   /* put all hosts we want to check in hashtable */
   gvm_host_t *host;
   for (host = gvm_hosts_next (hosts); host; host = gvm_hosts_next (hosts))
     {
+      struct in6_addr addr6;
+
       g_hash_table_insert (scanner.hosts_data->targethosts,
                            gvm_host_value_str (host), host);
+      if (gvm_host_get_addr6 (host, &addr6) == 0)
+        addr_set_add (scanner.hosts_data->targets_set, &addr6);
     }
   /* reset hosts iter */
   hosts->current = 0;
 
+  /* CPUs of the threads, with "auto" the ones local to the interface to the
+   * targets. */
+  sniffer_cpus = prefs_get ("alive_test_sniffer_cpus");
+  sender_cpus = prefs_get ("alive_test_sender_cpus");
+  if (!g_strcmp0 (sniffer_cpus, "auto") || !g_strcmp0 (sender_cpus, "auto"))
+    iface = targets_iface (scanner.hosts_data);
+  scanner.sniffer_cpus = thread_cpus_new (sniffer_cpus, iface);
+  scanner.sender_cpus = thread_cpus_new (sender_cpus, iface);
+  g_free (iface);
+
   /* Init ports used for scanning. */
   scanner.ports = NULL;
 
@@ -454,11 +573,19 @@ alive_detection_free (void *error)
 
   /* Ports array. */
   g_array_free (scanner.ports, TRUE);
+  if (scanner.ndp_links)
+    g_array_free (scanner.ndp_links, TRUE);
+  scanner.ndp_links = NULL;
+  thread_cpus_free (scanner.sniffer_cpus);
+  thread_cpus_free (scanner.sender_cpus);
+  scanner.sniffer_cpus = scanner.sender_cpus = NULL;
 
   g_hash_table_destroy (scanner.hosts_data->alivehosts);
   /* targethosts: (ipstr, gvm_host_t *)
    * gvm_host_t are freed by caller of start_alive_detection()! */
   g_hash_table_destroy (scanner.hosts_data->targethosts);
+  addr_set_free (scanner.hosts_data->targets_set);
+  addr_set_free (scanner.hosts_data->alive_set);
   g_free (scanner.hosts_data);
 
   /* Set error. */
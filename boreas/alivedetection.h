@@ -30,12 +30,17 @@
 #define ALIVE_DETECTION_QUEUE "alive_detection"
 /* Signal to put on ALIVE_DETECTION_QUEUE if alive detection finished. */
 #define ALIVE_DETECTION_FINISHED "alive_detection_finished"
+/* Key of the statistics of the alive detection. */
+#define ALIVE_DETECTION_STATS "internal/alive_detection/stats"
 
 void *
 start_alive_detection (void *);
 
 typedef struct hosts_data hosts_data_t;
+typedef struct addr_set addr_set_t;
+typedef struct rtt_estimator rtt_estimator_t;
 typedef struct scan_restrictions scan_restrictions_t;
+typedef struct thread_cpus thread_cpus_t;
 
 /**
  * @brief The scanner struct holds data which is used frequently by the alive
@@ -63,6 +68,17 @@ struct scanner
   pcap_t *pcap_handle;
   hosts_data_t *hosts_data;
   scan_restrictions_t *scan_restrictions;
+  /* Round trip times of the pings, NULL if not measured. */
+  rtt_estimator_t *rtt;
+  /* IPv6 prefixes of the local links (ndp_link_t), NULL if neighbors are
+   * not solicited through multicast. */
+  GArray *ndp_links;
+  /* ARP request template of the interface to the targets, NULL if ARP
+   * requests are not sent on the AF_PACKET socket. */
+  struct arp_template *arp_template;
+  /* CPUs of the capture and of the sender threads, NULL if not restricted. */
+  thread_cpus_t *sniffer_cpus;
+  thread_cpus_t *sender_cpus;
   /* 0 do not print in stdout, 1 print in stdout used for cmd line cli. */
   int print_results;
 };
@@ -81,6 +97,10 @@ struct hosts_data
   /* Hashtable of the form (ip_str, gvm_host_t *). The gvm_host_t pointers point
    * to hosts which are to be freed by the caller of start_alive_detection(). */
   GHashTable *targethosts;
+  /* Addresses of targethosts, for the lookup of captured replies. */
+  addr_set_t *targets_set;
+  /* Addresses of the hosts marked alive by captured replies. */
+  addr_set_t *alive_set;
 };
 
 /* Max_scan_hosts related struct. */
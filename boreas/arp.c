@@ -16,12 +16,16 @@
 
 #include "../base/networking.h" /* for gvm_source_addr() */
 
+#include <arpa/inet.h>
 #include <errno.h>
 #include <glib.h>
 #include <ifaddrs.h>
 #include <libnet.h>
 #include <limits.h>
+#include <net/ethernet.h>
 #include <net/if.h>
+#include <net/if_arp.h>
+#include <netinet/if_ether.h> /* for struct ether_arp */
 #include <netinet/in.h>
 #include <pcap.h>
 #include <stdio.h>
@@ -57,6 +61,19 @@ static const uint8_t ethnull[ETH_ALEN] = {0, 0, 0, 0, 0, 0};
 static const uint8_t ethxmas[ETH_ALEN] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
 static const char *ip_broadcast = "255.255.255.255";
 
+/* Offset of the target IP address in an ARP request frame. */
+#define ARP_FRAME_TPA 38
+
+/**
+ * @brief ARP request frame prebuilt for an interface.
+ */
+struct arp_template
+{
+  char ifname[IF_NAMESIZE];     /**< Interface, empty if not built. */
+  int ifindex;                  /**< Index of the interface. */
+  uint8_t frame[ARP_FRAME_LEN]; /**< Frame without the target IP. */
+};
+
 /**
  * @brief Strip newline at end of string.
  *
@@ -170,6 +187,168 @@ format_mac (const unsigned char *mac, char *buf, size_t bufsize)
   return buf;
 }
 
+/**
+ * @brief Get the interface to use if none is found for a target.
+ *
+ * @return Name of the first interface found by pcap, empty if none.
+ */
+static const char *
+get_default_ifname (void)
+{
+  static char ifname_default[IF_NAMESIZE] = {0};
+  static gsize init = 0;
+
+  if (g_once_init_enter (&init))
+    {
+      char pcap_ebuf[PCAP_ERRBUF_SIZE];
+      pcap_if_t *alldevsp = NULL;
+
+      if (pcap_findalldevs (&alldevsp, pcap_ebuf) < 0)
+        g_message ("%s: Error pcap_findalldevs(): %s", __func__, pcap_ebuf);
+      if (alldevsp != NULL)
+        {
+          g_strlcpy (ifname_default, alldevsp->name, IF_NAMESIZE);
+          pcap_freealldevs (alldevsp);
+        }
+      g_once_init_leave (&init, 1);
+    }
+  return ifname_default;
+}
+
+/**
+ * @brief Build the ARP request template of an interface.
+ *
+ * @param soc       Socket for the interface ioctls.
+ * @param ifname    Interface.
+ * @param template  Template to build.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+arp_template_build (int soc, const char *ifname, arp_template_t *template)
+{
+  struct ifreq ifr;
+  struct ether_header *eth = (struct ether_header *) template->frame;
+  struct ether_arp *arp =
+    (struct ether_arp *) (template->frame + sizeof (struct ether_header));
+  uint32_t src = 0;
+
+  memset (template, 0, sizeof (*template));
+  memset (&ifr, 0, sizeof (ifr));
+  g_strlcpy (ifr.ifr_name, ifname, sizeof (ifr.ifr_name));
+  if (ioctl (soc, SIOCGIFINDEX, &ifr) < 0)
+    {
+      g_warning ("%s: SIOCGIFINDEX on %s: %s", __func__, ifname,
+                 strerror (errno));
+      return -1;
+    }
+  template->ifindex = ifr.ifr_ifindex;
+  if (ioctl (soc, SIOCGIFHWADDR, &ifr) < 0)
+    {
+      g_warning ("%s: SIOCGIFHWADDR on %s: %s", __func__, ifname,
+                 strerror (errno));
+      return -1;
+    }
+  memcpy (eth->ether_shost, ifr.ifr_hwaddr.sa_data, ETH_ALEN);
+
+  /* The openvas source address if set, else the one of the interface. */
+  gvm_source_addr (&src);
+  if (src == INADDR_ANY)
+    {
+      if (ioctl (soc, SIOCGIFADDR, &ifr) < 0)
+        {
+          g_warning ("%s: Unable to get the IPv4 address of interface %s: %s",
+                     __func__, ifname, strerror (errno));
+          return -1;
+        }
+      src = ((struct sockaddr_in *) &ifr.ifr_addr)->sin_addr.s_addr;
+    }
+
+  memcpy (eth->ether_dhost, ethxmas, ETH_ALEN);
+  eth->ether_type = htons (ETHERTYPE_ARP);
+  arp->arp_hrd = htons (ARPHRD_ETHER);
+  arp->arp_pro = htons (ETHERTYPE_IP);
+  arp->arp_hln = ETH_ALEN;
+  arp->arp_pln = IP_ALEN;
+  arp->arp_op = htons (ARPOP_REQUEST);
+  memcpy (arp->arp_sha, eth->ether_shost, ETH_ALEN);
+  memcpy (arp->arp_spa, &src, IP_ALEN);
+  memcpy (arp->arp_tha, ethnull, ETH_ALEN);
+  g_strlcpy (template->ifname, ifname, sizeof (template->ifname));
+  return 0;
+}
+
+/**
+ * @brief Create the ARP request template of the interface to the targets.
+ *
+ * The interface, its MAC and the source address are resolved once, so that
+ * the requests of a scan only differ by their target address.
+ *
+ * @param soc     Socket for the interface ioctls.
+ * @param ifname  Interface, NULL for the default one.
+ *
+ * @return Template, to be freed with arp_template_free(). NULL on error.
+ */
+arp_template_t *
+arp_template_new (int soc, const char *ifname)
+{
+  arp_template_t *template;
+
+  if (!ifname)
+    ifname = get_default_ifname ();
+  if (!*ifname)
+    {
+      g_warning ("%s: Gave up looking for interface to use for ARP.",
+                 __func__);
+      return NULL;
+    }
+
+  template = g_malloc0 (sizeof (*template));
+  if (arp_template_build (soc, ifname, template))
+    {
+      g_free (template);
+      return NULL;
+    }
+  return template;
+}
+
+/**
+ * @brief Free an ARP request template.
+ *
+ * @param template  Template, may be NULL.
+ */
+void
+arp_template_free (arp_template_t *template)
+{
+  g_free (template);
+}
+
+/**
+ * @brief Build an ARP request frame for an IPv4 address, to be sent on an
+ * AF_PACKET socket.
+ *
+ * The frame is copied from the template, so only the target address is set
+ * per host.
+ *
+ * @param[in]  template  Template of the outgoing interface.
+ * @param[in]  dst       Target address.
+ * @param[out] frame     Frame, ARP_FRAME_LEN bytes.
+ * @param[out] addr      Link layer destination of the frame.
+ */
+void
+arp_build_request_v4 (const arp_template_t *template, struct in_addr dst,
+                      uint8_t *frame, struct sockaddr_ll *addr)
+{
+  memcpy (frame, template->frame, ARP_FRAME_LEN);
+  memcpy (frame + ARP_FRAME_TPA, &dst.s_addr, IP_ALEN);
+  memset (addr, 0, sizeof (*addr));
+  addr->sll_family = AF_PACKET;
+  addr->sll_protocol = htons (ETH_P_ARP);
+  addr->sll_ifindex = template->ifindex;
+  addr->sll_halen = ETH_ALEN;
+  memcpy (addr->sll_addr, ethxmas, ETH_ALEN);
+}
+
 /**
  * @brief  Send ARP who-has.
  */
@@ -224,10 +403,6 @@ send_arp_v4 (const char *dst_str)
   char *target = NULL;
   char mac_debug_buf[128];
 
-  char pcap_ebuf[PCAP_ERRBUF_SIZE];
-  pcap_if_t *alldevsp = NULL;
-  /* default interface when no interface is found via arp_lookupdev() */
-  static char ifname_default[IF_NAMESIZE] = {0};
   /* interface used for previous ping */
   static char ifname_prev[IF_NAMESIZE] = {0};
 
@@ -247,18 +422,6 @@ send_arp_v4 (const char *dst_str)
       do_libnet_init (ifname, 0);
     }
 
-  /* init default interface if not already done */
-  if (!*ifname_default)
-    {
-      if (pcap_findalldevs (&alldevsp, pcap_ebuf) < 0)
-        g_message ("%s: Error pcap_findalldevs(): %s", __func__, pcap_ebuf);
-      if (alldevsp != NULL)
-        {
-          memcpy (ifname_default, alldevsp->name, IF_NAMESIZE);
-          pcap_freealldevs (alldevsp);
-        }
-    }
-
   /* Make sure dstip and dst_str like each other */
   if (!xresolve (libnet, dst_str, LIBNET_DONT_RESOLVE, &dstip))
     {
@@ -286,9 +449,9 @@ send_arp_v4 (const char *dst_str)
         }
       if (!ifname)
         {
-          /* Only set ifname if ifname_default str is not empty. */
-          if (*ifname_default)
-            ifname = g_strdup (ifname_default);
+          /* Only set ifname if the default interface is not empty. */
+          if (*get_default_ifname ())
+            ifname = g_strdup (get_default_ifname ());
         }
       if (!ifname)
         {
@@ -6,7 +6,27 @@
 #ifndef ARP_H
 #define ARP_H
 
+#include <netinet/in.h>       /* for struct in_addr */
+#include <netpacket/packet.h> /* for struct sockaddr_ll */
+#include <stdint.h>
+
+/* Size of an ARP request frame, padded to the Ethernet minimum. */
+#define ARP_FRAME_LEN 60
+
 void
 send_arp_v4 (const char *);
 
+/* ARP request frame prebuilt for an interface. */
+typedef struct arp_template arp_template_t;
+
+arp_template_t *
+arp_template_new (int, const char *);
+
+void
+arp_template_free (arp_template_t *);
+
+void
+arp_build_request_v4 (const arp_template_t *, struct in_addr, uint8_t *,
+                      struct sockaddr_ll *);
+
 #endif /* not ARP_H */
@@ -5,12 +5,14 @@
 
 #include "boreas_io.h"
 
-#include "../base/prefs.h" /* for prefs_get() */
+#include "../base/prefs.h"  /* for prefs_get() */
+#include "../base/probes.h" /* for GVM_PROBE2 */
 #include "alivedetection.h"
 #include "util.h"
 
 #include <glib/gprintf.h>
 #include <stdlib.h>
+#include <string.h>
 
 #undef G_LOG_DOMAIN
 /**
@@ -21,6 +23,59 @@
 /* how long (in sec) to wait for replies after last packet was sent */
 #define WAIT_FOR_REPLIES_TIMEOUT 3
 
+/* Number of hosts the queue of the publisher holds, a power of 2. */
+#define PUBLISH_QUEUE_SIZE 4096
+/* Maximum number of hosts the publisher pushes at once. */
+#define PUBLISH_BATCH_MAX 256
+/* Maximum time a host waits for the publisher, in microseconds. */
+#define PUBLISH_INTERVAL 50000
+
+/* Alive test methods with sending statistics. */
+enum stats_method
+{
+  STATS_ICMP,
+  STATS_TCP_SYN,
+  STATS_TCP_ACK,
+  STATS_ARP,
+  STATS_METHODS
+};
+
+/**
+ * @brief Statistics of the sending of one alive test method.
+ */
+struct method_stats
+{
+  guint64 sent;          /**< Probes sent. */
+  guint64 send_errors;   /**< Probes the kernel refused. */
+  guint64 throttle_usec; /**< Time the senders waited for the rate limits. */
+};
+
+/**
+ * @brief Statistics of an alive detection, updated by all its threads.
+ */
+static struct
+{
+  gint64 start;                               /**< Start of the scan. */
+  int method;                                 /**< Method being sent. */
+  struct method_stats methods[STATS_METHODS]; /**< Sending, by method. */
+  guint64 received;        /**< Packets received by the sniffer. */
+  guint64 from_targets;    /**< Of which, packets of target hosts. */
+  guint64 kernel_received; /**< Packets the capture saw in the kernel. */
+  guint64 kernel_dropped;  /**< Packets the capture dropped in the kernel. */
+  guint64 published;       /**< Hosts pushed by the publisher. */
+  guint64 publish_batches; /**< Pushes of the publisher. */
+  guint64 publish_usec;    /**< Time spent in the pushes. */
+  guint64 publish_max_usec; /**< Longest push. */
+} alive_stats;
+
+/* Names of the methods in the statistics. */
+static const char *stats_method_names[STATS_METHODS] = {"icmp", "tcp_syn",
+                                                        "tcp_ack", "arp"};
+
+/* Time between the statistics put in the KB while scanning, in seconds,
+ * 0 for none. Read from the "alive_test_stats_interval" preference. */
+static int stats_interval = 0;
+
 scan_restrictions_t scan_restrictions;
 
 /**
@@ -75,6 +130,88 @@ inc_alive_hosts_count ()
   return;
 }
 
+/**
+ * @brief Asynchronous connection to the main KB for the results sent to
+ * ospd-openvas, NULL if not open.
+ */
+static kb_async_t results_kb = NULL;
+
+/**
+ * @brief Open the asynchronous connection for the results sent to
+ * ospd-openvas.
+ *
+ * Until results_publisher_stop() is called, the results are queued on the
+ * connection, so that the scan does not wait for the KB. If the connection
+ * cannot be opened, every result opens a connection of its own, as before.
+ */
+void
+results_publisher_start (void)
+{
+  const gchar *db_address = prefs_get ("db_address");
+  const gchar *dbid = prefs_get ("ov_maindbid");
+
+  if (results_kb || !db_address || !dbid)
+    return;
+  if ((results_kb = kb_async_new (db_address, atoi (dbid), NULL)) == NULL)
+    g_debug ("%s: Sending the results on a connection of their own.",
+             __func__);
+}
+
+/**
+ * @brief Wait until the queued results are pushed and close the
+ * asynchronous connection.
+ */
+void
+results_publisher_stop (void)
+{
+  kb_async_free (results_kb);
+  results_kb = NULL;
+}
+
+/**
+ * @brief Completion callback of the results pushed asynchronously.
+ *
+ * @param rc   0 if the result was pushed.
+ * @param data Unused.
+ */
+static void
+result_pushed (int rc, void *data)
+{
+  (void) data;
+  if (rc)
+    g_warning ("%s: Could not push a result on the main kb.", __func__);
+}
+
+/**
+ * @brief Send a result to ospd-openvas.
+ *
+ * @param msg Result message.
+ *
+ * @return 0 on success, -2 if the result could not be pushed, -3 if the main
+ * kb could not be connected.
+ */
+static int
+push_result (const char *msg)
+{
+  kb_t main_kb;
+  int err = 0;
+
+  if (results_kb)
+    return kb_async_push_str (results_kb, "internal/results", msg,
+                              result_pushed, NULL)
+             ? -2
+             : 0;
+
+  main_kb =
+    kb_direct_conn (prefs_get ("db_address"), atoi (prefs_get ("ov_maindbid")));
+  if (!main_kb)
+    return -3;
+  if (kb_item_push_str (main_kb, "internal/results", msg) != 0)
+    err = -2;
+  kb_lnk_reset (main_kb);
+  return err;
+}
+
 /**
  * @brief Send Message about not vuln scanned alive hosts to ospd-openvas.
  *
@@ -84,42 +221,75 @@ inc_alive_hosts_count ()
 static int
 send_limit_msg (int num_not_scanned_hosts)
 {
+  char buf[256];
   int err;
-  int dbid;
-  kb_t main_kb = NULL;
-
-  err = 0;
 
   if (num_not_scanned_hosts < 0)
     return -1;
 
-  dbid = atoi (prefs_get ("ov_maindbid"));
-  if ((main_kb = kb_direct_conn (prefs_get ("db_address"), dbid)))
+  g_snprintf (buf, 256,
+              "ERRMSG||| ||| ||| ||| |||Maximum number of allowed scans "
+              "reached. There may still be alive hosts available which are "
+              "not scanned. Number of alive hosts not scanned: [%d]",
+              num_not_scanned_hosts);
+  err = push_result (buf);
+  if (err == -2)
+    g_warning ("%s: kb_item_push_str() failed to push "
+               "error message.",
+               __func__);
+  else if (err == -3)
+    g_warning ("%s: Boreas was unable to connect to the Redis db.Info about "
+               "number of alive hosts could not be sent.",
+               __func__);
+
+  return err;
+}
+
+/**
+ * @brief Transform a string popped from the queue of alive hosts into a host.
+ *
+ * @param host_str  String popped from the queue, freed by this function.
+ * @param alive_deteciton_finished  Set to TRUE if host_str is the finish
+ * signal.
+ * @return  The host, NULL if host_str is the finish signal or invalid.
+ */
+static gvm_host_t *
+host_from_queue_str (gchar *host_str, gboolean *alive_deteciton_finished)
+{
+  /* complete host to be returned */
+  gvm_host_t *host = NULL;
+
+  /* check for finish signal/string */
+  if (g_strcmp0 (host_str, ALIVE_DETECTION_FINISHED) == 0)
     {
-      char buf[256];
-      g_snprintf (buf, 256,
-                  "ERRMSG||| ||| ||| ||| |||Maximum number of allowed scans "
-                  "reached. There may still be alive hosts available which are "
-                  "not scanned. Number of alive hosts not scanned: [%d]",
-                  num_not_scanned_hosts);
-      if (kb_item_push_str (main_kb, "internal/results", buf) != 0)
+      /* Send Error message if max_scan_hosts was reached. */
+      if (max_scan_hosts_reached ())
         {
-          g_warning ("%s: kb_item_push_str() failed to push "
-                     "error message.",
-                     __func__);
-          err = -2;
+          int num_not_scanned_hosts;
+
+          num_not_scanned_hosts =
+            get_alive_hosts_count () - get_max_scan_hosts ();
+          if (0 != num_not_scanned_hosts)
+            {
+              send_limit_msg (num_not_scanned_hosts);
+            }
         }
-      kb_lnk_reset (main_kb);
-    }
-  else
-    {
-      g_warning ("%s: Boreas was unable to connect to the Redis db.Info about "
-                 "number of alive hosts could not be sent.",
-                 __func__);
-      err = -3;
+      g_debug ("%s: Boreas already finished scanning and we reached the "
+               "end of the Queue of alive hosts.",
+               __func__);
+      g_free (host_str);
+      *alive_deteciton_finished = TRUE;
+      return NULL;
     }
 
-  return err;
+  /* probably got host */
+  host = gvm_host_from_str (host_str);
+  if (!host)
+    g_warning ("%s: Could not transform IP string \"%s\" into "
+               "internal representation.",
+               __func__, host_str);
+  g_free (host_str);
+  return host;
 }
 
 /**
@@ -141,6 +311,9 @@ send_limit_msg (int num_not_scanned_hosts)
 gvm_host_t *
 get_host_from_queue (kb_t alive_hosts_kb, gboolean *alive_deteciton_finished)
 {
+  /* string representation of an ip address or ALIVE_DETECTION_FINISHED */
+  gchar *host_str = NULL;
+
   /* redis connection not established yet */
   if (!alive_hosts_kb)
     {
@@ -148,64 +321,115 @@ get_host_from_queue (kb_t alive_hosts_kb, gboolean *alive_deteciton_finished)
       return NULL;
     }
 
-  /* string representation of an ip address or ALIVE_DETECTION_FINISHED */
-  gchar *host_str = NULL;
-  /* complete host to be returned */
-  gvm_host_t *host = NULL;
-
   /* try to get item from db, string needs to be freed, NULL on empty or
    * error
    */
   host_str = kb_item_pop_str (alive_hosts_kb, (ALIVE_DETECTION_QUEUE));
   if (!host_str)
+    return NULL;
+
+  return host_from_queue_str (host_str, alive_deteciton_finished);
+}
+
+/**
+ * @brief Get new host from alive detection scanner, waiting for one.
+ *
+ * Like get_host_from_queue(), but if the queue is empty it waits until the
+ * alive detection scanner puts a host or the finish signal on it, instead of
+ * returning NULL right away. This saves polling the queue.
+ *
+ * @param alive_hosts_kb  Redis connection for accessing the queue on which the
+ * alive detection scanner puts found hosts.
+ * @param alive_deteciton_finished  Status of alive detection process.
+ * @param timeout  Seconds to wait at most, 0 to wait forever.
+ * @return  If valid alive host is found return a gvm_host_t. If alive scanner
+ * finished NULL is returned and alive_deteciton_finished set. On error, on
+ * timeout or if the popped host is invalid return NULL.
+ */
+gvm_host_t *
+get_host_from_queue_wait (kb_t alive_hosts_kb,
+                          gboolean *alive_deteciton_finished, int timeout)
+{
+  gchar *host_str;
+
+  if (!alive_hosts_kb)
     {
+      g_debug ("%s: connection to redis is not valid", __func__);
       return NULL;
     }
-  /* got some string from redis queue */
-  else
+
+  host_str =
+    kb_item_pop_str_blocking (alive_hosts_kb, ALIVE_DETECTION_QUEUE, timeout);
+  if (!host_str)
+    return NULL;
+
+  return host_from_queue_str (host_str, alive_deteciton_finished);
+}
+
+/**
+ * @brief Get several new hosts from alive detection scanner at once.
+ *
+ * Pops up to max hosts with one request. If the queue is empty, waits for a
+ * first host like get_host_from_queue_wait() does. Invalid hosts are skipped.
+ * If the finish signal is popped, alive_deteciton_finished is set to TRUE and
+ * the hosts popped before it are returned.
+ *
+ * @param alive_hosts_kb  Redis connection for accessing the queue on which the
+ * alive detection scanner puts found hosts.
+ * @param alive_deteciton_finished  Status of alive detection process.
+ * @param hosts  Array of at least max hosts, where to store the hosts.
+ * @param max  Maximum number of hosts to get.
+ * @param timeout  Seconds to wait at most if the queue is empty, 0 to wait
+ * forever, -1 not to wait.
+ * @return  Number of hosts stored in hosts, -1 on error.
+ */
+int
+get_hosts_from_queue (kb_t alive_hosts_kb, gboolean *alive_deteciton_finished,
+                      gvm_host_t **hosts, int max, int timeout)
+{
+  gchar **host_strs;
+  int count, i, n = 0;
+
+  if (!alive_hosts_kb)
     {
-      /* check for finish signal/string */
-      if (g_strcmp0 (host_str, ALIVE_DETECTION_FINISHED) == 0)
-        {
-          /* Send Error message if max_scan_hosts was reached. */
-          if (max_scan_hosts_reached ())
-            {
-              int num_not_scanned_hosts;
-
-              num_not_scanned_hosts =
-                get_alive_hosts_count () - get_max_scan_hosts ();
-              if (0 != num_not_scanned_hosts)
-                {
-                  send_limit_msg (num_not_scanned_hosts);
-                }
-            }
-          g_debug ("%s: Boreas already finished scanning and we reached the "
-                   "end of the Queue of alive hosts.",
-                   __func__);
-          g_free (host_str);
-          *alive_deteciton_finished = TRUE;
-          return NULL;
-        }
-      /* probably got host */
-      else
-        {
-          host = gvm_host_from_str (host_str);
+      g_debug ("%s: connection to redis is not valid", __func__);
+      return -1;
+    }
+  if (max <= 0)
+    return 0;
 
-          if (!host)
-            {
-              g_warning ("%s: Could not transform IP string \"%s\" into "
-                         "internal representation.",
-                         __func__, host_str);
-              g_free (host_str);
-              return NULL;
-            }
-          else
-            {
-              g_free (host_str);
-              return host;
-            }
+  host_strs = g_malloc0_n (max, sizeof (gchar *));
+  count = kb_item_pop_str_many (alive_hosts_kb, ALIVE_DETECTION_QUEUE, max,
+                                host_strs);
+  if (count == 0 && timeout >= 0)
+    {
+      host_strs[0] = kb_item_pop_str_blocking (
+        alive_hosts_kb, ALIVE_DETECTION_QUEUE, timeout);
+      count = host_strs[0] ? 1 : 0;
+    }
+  if (count < 0)
+    {
+      g_free (host_strs);
+      return -1;
+    }
+
+  for (i = 0; i < count; i++)
+    {
+      gvm_host_t *host;
+
+      /* The finish signal is the last item put on the queue. */
+      if (*alive_deteciton_finished)
+        {
+          g_free (host_strs[i]);
+          continue;
         }
+      host = host_from_queue_str (host_strs[i], alive_deteciton_finished);
+      if (host)
+        hosts[n++] = host;
     }
+  g_free (host_strs);
+
+  return n;
 }
 
 /**
@@ -217,12 +441,256 @@ get_host_from_queue (kb_t alive_hosts_kb, gboolean *alive_deteciton_finished)
 void
 put_host_on_queue (kb_t kb, char *addr_str)
 {
-  if (kb_item_push_str (kb, ALIVE_DETECTION_QUEUE, addr_str) != 0)
+  long long start = GVM_PROBE_USEC ();
+  int ret;
+
+  ret = kb_item_push_str (kb, ALIVE_DETECTION_QUEUE, addr_str);
+  GVM_PROBE2 (put_host_on_queue, ret, GVM_PROBE_USEC () - start);
+  if (ret != 0)
     g_debug ("%s: kb_item_push_str() failed. Could not push \"%s\" on queue of "
              "hosts to be considered as alive.",
              __func__, addr_str);
 }
 
+/**
+ * @brief Lock-free handoff of a host from the sniffer to the publisher.
+ */
+struct publish_cell
+{
+  guint64 seq; /**< Position the cell can be written or read at. */
+  gchar *host; /**< Host address string. */
+};
+
+/**
+ * @brief Publisher of the alive hosts on the alive detection queue.
+ *
+ * The hosts are handed over in a bounded lock-free queue, as in D. Vyukov's
+ * bounded MPMC queue, read by the single publisher thread. The publisher
+ * pushes the hosts on the KB in pipelined batches.
+ */
+struct publisher
+{
+  struct publish_cell cells[PUBLISH_QUEUE_SIZE]; /**< Queue. */
+  guint64 head;    /**< Next position to write at. */
+  guint64 tail;    /**< Next position to read at, only used by the thread. */
+  kb_t kb;         /**< KB to push the hosts on. */
+  GThread *thread; /**< Publisher thread. */
+  int stop;        /**< Whether the thread is to push the rest and exit. */
+};
+
+static struct publisher *publisher = NULL;
+
+/**
+ * @brief Put a host in the queue of the publisher.
+ *
+ * @param pub  Publisher.
+ * @param host Host address string, owned by the queue on success.
+ *
+ * @return TRUE on success, FALSE if the queue is full.
+ */
+static gboolean
+publisher_enqueue (struct publisher *pub, gchar *host)
+{
+  guint64 pos = __atomic_load_n (&pub->head, __ATOMIC_RELAXED);
+  struct publish_cell *cell;
+
+  for (;;)
+    {
+      gint64 diff;
+
+      cell = &pub->cells[pos & (PUBLISH_QUEUE_SIZE - 1)];
+      diff = (gint64) (__atomic_load_n (&cell->seq, __ATOMIC_ACQUIRE) - pos);
+      if (diff == 0)
+        {
+          if (__atomic_compare_exchange_n (&pub->head, &pos, pos + 1, TRUE,
+                                           __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            break;
+        }
+      else if (diff < 0)
+        return FALSE;
+      else
+        pos = __atomic_load_n (&pub->head, __ATOMIC_RELAXED);
+    }
+  cell->host = host;
+  __atomic_store_n (&cell->seq, pos + 1, __ATOMIC_RELEASE);
+  return TRUE;
+}
+
+/**
+ * @brief Take a host from the queue of the publisher.
+ *
+ * Only to be called by the publisher thread.
+ *
+ * @param pub  Publisher.
+ *
+ * @return Host address string to be freed, NULL if the queue is empty.
+ */
+static gchar *
+publisher_dequeue (struct publisher *pub)
+{
+  struct publish_cell *cell = &pub->cells[pub->tail & (PUBLISH_QUEUE_SIZE - 1)];
+  gchar *host;
+
+  if (__atomic_load_n (&cell->seq, __ATOMIC_ACQUIRE) != pub->tail + 1)
+    return NULL;
+  host = cell->host;
+  __atomic_store_n (&cell->seq, pub->tail + PUBLISH_QUEUE_SIZE,
+                    __ATOMIC_RELEASE);
+  pub->tail++;
+  return host;
+}
+
+/**
+ * @brief Push hosts on the alive detection queue and free them.
+ *
+ * @param kb    KB to use.
+ * @param hosts Host address strings.
+ * @param count Number of hosts.
+ */
+static void
+publisher_push (kb_t kb, gchar **hosts, size_t count)
+{
+  gint64 start = g_get_monotonic_time ();
+  guint64 usec;
+  int failed;
+
+  failed = kb_item_push_str_many (kb, ALIVE_DETECTION_QUEUE,
+                                  (const char **) hosts, count);
+  usec = g_get_monotonic_time () - start;
+  alive_stats.published += count;
+  alive_stats.publish_batches++;
+  alive_stats.publish_usec += usec;
+  alive_stats.publish_max_usec = MAX (alive_stats.publish_max_usec, usec);
+  if (failed != 0)
+    g_debug ("%s: kb_item_push_str_many() failed. Could not push %d of %zu "
+             "hosts on queue of hosts to be considered as alive.",
+             __func__, failed, count);
+  for (size_t i = 0; i < count; i++)
+    g_free (hosts[i]);
+}
+
+/**
+ * @brief Thread function of the publisher.
+ *
+ * Pushes the queued hosts once PUBLISH_BATCH_MAX hosts are queued or the
+ * first of them waited PUBLISH_INTERVAL microseconds. Puts the statistics in
+ * the KB every stats_interval seconds.
+ *
+ * @param data Publisher.
+ *
+ * @return NULL.
+ */
+static gpointer
+publisher_run (gpointer data)
+{
+  struct publisher *pub = data;
+  gchar *hosts[PUBLISH_BATCH_MAX];
+  size_t count = 0;
+  gint64 first = 0, last_stats = g_get_monotonic_time ();
+
+  for (;;)
+    {
+      gboolean stop = __atomic_load_n (&pub->stop, __ATOMIC_ACQUIRE);
+      gchar *host = NULL;
+
+      /* The publisher owns the KB connection, so it puts the periodic
+       * statistics as well. */
+      if (stats_interval > 0
+          && g_get_monotonic_time () - last_stats
+               >= (gint64) stats_interval * G_USEC_PER_SEC)
+        {
+          alive_stats_publish (pub->kb);
+          last_stats = g_get_monotonic_time ();
+        }
+
+      while (count < PUBLISH_BATCH_MAX
+             && (host = publisher_dequeue (pub)) != NULL)
+        {
+          if (count == 0)
+            first = g_get_monotonic_time ();
+          hosts[count++] = host;
+        }
+      if (count
+          && (count == PUBLISH_BATCH_MAX || stop
+              || g_get_monotonic_time () - first >= PUBLISH_INTERVAL))
+        {
+          publisher_push (pub->kb, hosts, count);
+          count = 0;
+        }
+      /* The stop flag was read before the queue was emptied, so no host
+       * queued before the stop is left behind. */
+      if (stop && count == 0 && host == NULL)
+        break;
+      if (host == NULL)
+        g_usleep (1000);
+    }
+  return NULL;
+}
+
+/**
+ * @brief Start publishing the alive hosts on the alive detection queue from a
+ * separate thread.
+ *
+ * Until host_publisher_stop() is called, handle_scan_restrictions() hands the
+ * alive hosts to the publisher thread instead of pushing them on the KB
+ * itself. The KB connection must not be used by other threads meanwhile.
+ *
+ * @param kb KB to push the hosts on.
+ */
+void
+host_publisher_start (kb_t kb)
+{
+  struct publisher *pub;
+
+  if (publisher || !kb)
+    return;
+  pub = g_malloc0 (sizeof (*pub));
+  for (guint64 i = 0; i < PUBLISH_QUEUE_SIZE; i++)
+    pub->cells[i].seq = i;
+  pub->kb = kb;
+  pub->thread = g_thread_new ("boreas publisher", publisher_run, pub);
+  publisher = pub;
+}
+
+/**
+ * @brief Push the hosts handed to the publisher and stop its thread.
+ *
+ * Must not be called while hosts may still be handed to the publisher.
+ */
+void
+host_publisher_stop (void)
+{
+  struct publisher *pub = publisher;
+
+  if (!pub)
+    return;
+  publisher = NULL;
+  __atomic_store_n (&pub->stop, 1, __ATOMIC_RELEASE);
+  g_thread_join (pub->thread);
+  g_free (pub);
+}
+
+/**
+ * @brief Hand a host to the publisher, waiting while its queue is full.
+ *
+ * @param addr_str Host address string.
+ *
+ * @return TRUE if the host was handed over, FALSE if no publisher is running.
+ */
+static gboolean
+host_publisher_publish (const char *addr_str)
+{
+  struct publisher *pub = publisher;
+  gchar *host;
+
+  if (!pub)
+    return FALSE;
+  host = g_strdup (addr_str);
+  while (!publisher_enqueue (pub, host))
+    g_usleep (100);
+  return TRUE;
+}
+
 /**
  * @brief Checks if the finish signal is already set.
  *
@@ -298,6 +766,9 @@ put_finish_signal_on_queue (void *error)
   boreas_error_t error_out;
   int kb_item_push_str_err;
 
+  /* The alive hosts are to be on the queue before the finish signal. */
+  host_publisher_stop ();
+
   error_out = NO_ERROR;
   if (fin_msg_already_on_queue)
     {
@@ -374,7 +845,10 @@ handle_scan_restrictions (scanner_t *scanner, gchar *addr_str)
       /* Print host on command line if no kb is available. No kb available could
        * mean that boreas is used as commandline tool.*/
       if (kb != NULL)
-        put_host_on_queue (kb, addr_str);
+        {
+          if (!host_publisher_publish (addr_str))
+            put_host_on_queue (kb, addr_str);
+        }
       else
         {
           if (scanner->print_results == 1)
@@ -406,26 +880,15 @@ handle_scan_restrictions (scanner_t *scanner, gchar *addr_str)
 void
 send_dead_hosts_to_ospd_openvas (int count_dead_hosts)
 {
-  kb_t main_kb;
-  int maindbid;
   char dead_host_msg_to_ospd_openvas[2048];
 
-  maindbid = atoi (prefs_get ("ov_maindbid"));
-  main_kb = kb_direct_conn (prefs_get ("db_address"), maindbid);
-
-  if (!main_kb)
-    {
-      g_debug ("%s: Could not connect to main_kb for sending dead hosts to "
-               "ospd-openvas.",
-               __func__);
-    }
-
   snprintf (dead_host_msg_to_ospd_openvas,
             sizeof (dead_host_msg_to_ospd_openvas),
             "DEADHOST||| ||| ||| ||| |||%d", count_dead_hosts);
-  kb_item_push_str (main_kb, "internal/results", dead_host_msg_to_ospd_openvas);
-
-  kb_lnk_reset (main_kb);
+  if (push_result (dead_host_msg_to_ospd_openvas) == -3)
+    g_debug ("%s: Could not connect to main_kb for sending dead hosts to "
+             "ospd-openvas.",
+             __func__);
 }
 
 /**
@@ -514,3 +977,163 @@ get_alive_test_wait_timeout (void)
 
   return WAIT_FOR_REPLIES_TIMEOUT;
 }
+
+/**
+ * @brief Reset the statistics of the alive detection, at the start of a scan.
+ */
+void
+alive_stats_reset (void)
+{
+  const char *tmp;
+
+  memset (&alive_stats, 0, sizeof (alive_stats));
+  alive_stats.start = g_get_monotonic_time ();
+  stats_interval =
+    (tmp = prefs_get ("alive_test_stats_interval")) != NULL ? atoi (tmp) : 0;
+}
+
+/**
+ * @brief Set the alive test method the following probes are sent for.
+ *
+ * @param method ALIVE_TEST_ICMP, ALIVE_TEST_TCP_SYN_SERVICE,
+ *               ALIVE_TEST_TCP_ACK_SERVICE or ALIVE_TEST_ARP.
+ */
+void
+alive_stats_set_method (alive_test_t method)
+{
+  int index = STATS_ICMP;
+
+  if (method == ALIVE_TEST_TCP_SYN_SERVICE)
+    index = STATS_TCP_SYN;
+  else if (method == ALIVE_TEST_TCP_ACK_SERVICE)
+    index = STATS_TCP_ACK;
+  else if (method == ALIVE_TEST_ARP)
+    index = STATS_ARP;
+  __atomic_store_n (&alive_stats.method, index, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Count sent probes of the current method.
+ *
+ * @param sent   Number of probes sent.
+ * @param errors Number of probes which could not be sent.
+ */
+void
+alive_stats_count_sent (unsigned int sent, unsigned int errors)
+{
+  struct method_stats *stats =
+    &alive_stats.methods[__atomic_load_n (&alive_stats.method,
+                                          __ATOMIC_RELAXED)];
+
+  __atomic_fetch_add (&stats->sent, sent, __ATOMIC_RELAXED);
+  __atomic_fetch_add (&stats->send_errors, errors, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Count time a sender waited for the rate limits.
+ *
+ * @param usec Time in microseconds.
+ */
+void
+alive_stats_count_throttle (gint64 usec)
+{
+  struct method_stats *stats =
+    &alive_stats.methods[__atomic_load_n (&alive_stats.method,
+                                          __ATOMIC_RELAXED)];
+
+  if (usec > 0)
+    __atomic_fetch_add (&stats->throttle_usec, usec, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Count a packet received by the sniffer.
+ *
+ * @param from_target Whether the packet is from a target host.
+ */
+void
+alive_stats_count_reply (gboolean from_target)
+{
+  __atomic_fetch_add (&alive_stats.received, 1, __ATOMIC_RELAXED);
+  if (from_target)
+    __atomic_fetch_add (&alive_stats.from_targets, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Set the counters of the capture in the kernel.
+ *
+ * @param received Packets the capture received.
+ * @param dropped  Packets the capture dropped.
+ */
+void
+alive_stats_set_capture (guint64 received, guint64 dropped)
+{
+  alive_stats.kernel_received = received;
+  alive_stats.kernel_dropped = dropped;
+}
+
+/**
+ * @brief Get the statistics of the alive detection as JSON object.
+ *
+ * @return JSON string, to be freed with g_free.
+ */
+gchar *
+alive_stats_to_json (void)
+{
+  GString *json = g_string_new ("{");
+
+  g_string_append_printf (
+    json, "\"elapsed_ms\": %" G_GINT64_FORMAT ", \"methods\": {",
+    (g_get_monotonic_time () - alive_stats.start) / 1000);
+  for (int i = 0; i < STATS_METHODS; i++)
+    {
+      struct method_stats *stats = &alive_stats.methods[i];
+
+      g_string_append_printf (
+        json,
+        "%s\"%s\": {\"sent\": %" G_GUINT64_FORMAT
+        ", \"send_errors\": %" G_GUINT64_FORMAT
+        ", \"throttle_ms\": %" G_GUINT64_FORMAT "}",
+        i ? ", " : "", stats_method_names[i],
+        __atomic_load_n (&stats->sent, __ATOMIC_RELAXED),
+        __atomic_load_n (&stats->send_errors, __ATOMIC_RELAXED),
+        __atomic_load_n (&stats->throttle_usec, __ATOMIC_RELAXED) / 1000);
+    }
+  g_string_append_printf (
+    json,
+    "}, \"received\": %" G_GUINT64_FORMAT ", \"filtered\": %" G_GUINT64_FORMAT
+    ", \"kernel_received\": %" G_GUINT64_FORMAT
+    ", \"kernel_dropped\": %" G_GUINT64_FORMAT
+    ", \"published\": %" G_GUINT64_FORMAT
+    ", \"publish_batches\": %" G_GUINT64_FORMAT
+    ", \"publish_avg_us\": %" G_GUINT64_FORMAT
+    ", \"publish_max_us\": %" G_GUINT64_FORMAT "}",
+    __atomic_load_n (&alive_stats.received, __ATOMIC_RELAXED),
+    __atomic_load_n (&alive_stats.received, __ATOMIC_RELAXED)
+      - __atomic_load_n (&alive_stats.from_targets, __ATOMIC_RELAXED),
+    alive_stats.kernel_received, alive_stats.kernel_dropped,
+    alive_stats.published, alive_stats.publish_batches,
+    alive_stats.publish_batches
+      ? alive_stats.publish_usec / alive_stats.publish_batches
+      : 0,
+    alive_stats.publish_max_usec);
+  return g_string_free (json, FALSE);
+}
+
+/**
+ * @brief Put the statistics of the alive detection in the KB.
+ *
+ * They are set under "internal/alive_detection/stats", replacing the ones
+ * set before, for ospd-openvas to pick up.
+ *
+ * @param kb KB to use, NULL to only log them.
+ */
+void
+alive_stats_publish (kb_t kb)
+{
+  gchar *json = alive_stats_to_json ();
+
+  g_debug ("%s: %s", __func__, json);
+  if (kb && kb_item_set_str (kb, ALIVE_DETECTION_STATS, json, 0) != 0)
+    g_debug ("%s: Could not set the alive detection statistics.", __func__);
+  g_free (json);
+}
@@ -14,9 +14,21 @@
 gvm_host_t *
 get_host_from_queue (kb_t, gboolean *);
 
+gvm_host_t *
+get_host_from_queue_wait (kb_t, gboolean *, int);
+
+int
+get_hosts_from_queue (kb_t, gboolean *, gvm_host_t **, int, int);
+
 void
 put_host_on_queue (kb_t, char *);
 
+void
+host_publisher_start (kb_t);
+
+void
+host_publisher_stop (void);
+
 void
 put_finish_signal_on_queue (void *);
 
@@ -24,6 +36,12 @@ void realloc_finish_signal_on_queue (kb_t);
 
 int finish_signal_on_queue (kb_t);
 
+void
+results_publisher_start (void);
+
+void
+results_publisher_stop (void);
+
 void
 send_dead_hosts_to_ospd_openvas (int);
 
@@ -48,4 +66,30 @@ get_alive_test_wait_timeout (void);
 int
 get_alive_hosts_count (void);
 
+/* Statistics of the alive detection. */
+
+void
+alive_stats_reset (void);
+
+void
+alive_stats_set_method (alive_test_t);
+
+void
+alive_stats_count_sent (unsigned int, unsigned int);
+
+void
+alive_stats_count_throttle (gint64);
+
+void
+alive_stats_count_reply (gboolean);
+
+void
+alive_stats_set_capture (guint64, guint64);
+
+gchar *
+alive_stats_to_json (void);
+
+void
+alive_stats_publish (kb_t);
+
 #endif /* not BOREAS_IO_H */
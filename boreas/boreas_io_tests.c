@@ -21,6 +21,139 @@ Ensure (boreas_io, dummy_test)
   assert_that (0, is_equal_to (0));
 }
 
+static const char *queue_items[] = {"192.168.0.1", "not an ip", "192.168.0.2",
+                                    ALIVE_DETECTION_FINISHED, "192.168.0.3"};
+
+static int
+queue_pop_str_many (kb_t kb, const char *name, size_t count, char **values)
+{
+  size_t i;
+
+  (void) kb;
+  (void) name;
+  for (i = 0; i < count && i < G_N_ELEMENTS (queue_items); i++)
+    values[i] = g_strdup (queue_items[i]);
+  return i;
+}
+
+static const struct kb_operations queue_ops = {
+  .kb_pop_str_many = queue_pop_str_many};
+
+Ensure (boreas_io, get_hosts_from_queue_stops_at_finish_signal)
+{
+  struct kb queue_kb = {.kb_ops = &queue_ops};
+  gvm_host_t *hosts[8];
+  gboolean finished = FALSE;
+  int count, i;
+
+  count = get_hosts_from_queue (&queue_kb, &finished, hosts, 8, -1);
+  assert_that (count, is_equal_to (2));
+  assert_that (finished, is_true);
+  for (i = 0; i < count; i++)
+    {
+      gchar *addr = gvm_host_value_str (hosts[i]);
+
+      assert_that (addr, is_equal_to_string (i ? "192.168.0.2"
+                                                : "192.168.0.1"));
+      g_free (addr);
+      gvm_host_free (hosts[i]);
+    }
+}
+
+Ensure (boreas_io, get_hosts_from_queue_respects_max)
+{
+  struct kb queue_kb = {.kb_ops = &queue_ops};
+  gvm_host_t *hosts[1];
+  gboolean finished = FALSE;
+
+  assert_that (get_hosts_from_queue (&queue_kb, &finished, hosts, 1, -1),
+               is_equal_to (1));
+  assert_that (finished, is_false);
+  gvm_host_free (hosts[0]);
+}
+
+Ensure (boreas_io, get_hosts_from_queue_fails_without_kb)
+{
+  gvm_host_t *hosts[1];
+  gboolean finished = FALSE;
+
+  assert_that (get_hosts_from_queue (NULL, &finished, hosts, 1, -1),
+               is_equal_to (-1));
+}
+
+static GPtrArray *pushed_items;
+
+static int
+queue_push_str_many (kb_t kb, const char *name, const char **values,
+                     size_t count)
+{
+  (void) kb;
+  (void) name;
+  for (size_t i = 0; i < count; i++)
+    g_ptr_array_add (pushed_items, g_strdup (values[i]));
+  return 0;
+}
+
+static const struct kb_operations push_ops = {
+  .kb_push_str_many = queue_push_str_many};
+
+Ensure (boreas_io, host_publisher_pushes_hosts_in_order)
+{
+  struct kb push_kb = {.kb_ops = &push_ops};
+  scanner_t scanner = {0};
+  gchar addr[32];
+
+  pushed_items = g_ptr_array_new_with_free_func (g_free);
+  scanner.main_kb = &push_kb;
+  init_scan_restrictions (&scanner, 5000);
+
+  host_publisher_start (&push_kb);
+  for (int i = 0; i < 10000; i++)
+    {
+      g_snprintf (addr, sizeof (addr), "10.0.%d.%d", i / 256, i % 256);
+      handle_scan_restrictions (&scanner, addr);
+    }
+  host_publisher_stop ();
+
+  /* Only max_scan_hosts hosts are put on the queue. */
+  assert_that (pushed_items->len, is_equal_to (5000));
+  assert_that (get_alive_hosts_count (), is_equal_to (10000));
+  assert_that (scanner.scan_restrictions->max_scan_hosts_reached, is_true);
+  for (int i = 0; i < 5000; i++)
+    {
+      g_snprintf (addr, sizeof (addr), "10.0.%d.%d", i / 256, i % 256);
+      assert_that (g_ptr_array_index (pushed_items, i),
+                   is_equal_to_string (addr));
+    }
+  g_ptr_array_free (pushed_items, TRUE);
+}
+
+Ensure (boreas_io, alive_stats_counts_by_method)
+{
+  gchar *json;
+
+  alive_stats_reset ();
+  alive_stats_set_method (ALIVE_TEST_TCP_SYN_SERVICE);
+  alive_stats_count_sent (5, 1);
+  alive_stats_set_method (ALIVE_TEST_ARP);
+  alive_stats_count_sent (2, 0);
+  alive_stats_count_reply (TRUE);
+  alive_stats_count_reply (FALSE);
+  alive_stats_set_capture (10, 3);
+
+  json = alive_stats_to_json ();
+  assert_that (json, contains_string ("\"icmp\": {\"sent\": 0, "
+                                      "\"send_errors\": 0"));
+  assert_that (json, contains_string ("\"tcp_syn\": {\"sent\": 5, "
+                                      "\"send_errors\": 1"));
+  assert_that (json, contains_string ("\"arp\": {\"sent\": 2, "
+                                      "\"send_errors\": 0"));
+  assert_that (json, contains_string ("\"received\": 2, \"filtered\": 1, "
+                                      "\"kernel_received\": 10, "
+                                      "\"kernel_dropped\": 3"));
+  g_free (json);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -29,6 +162,14 @@ main (int argc, char **argv)
   suite = create_test_suite ();
 
   add_test_with_context (suite, boreas_io, dummy_test);
+  add_test_with_context (suite, boreas_io,
+                         get_hosts_from_queue_stops_at_finish_signal);
+  add_test_with_context (suite, boreas_io, get_hosts_from_queue_respects_max);
+  add_test_with_context (suite, boreas_io,
+                         get_hosts_from_queue_fails_without_kb);
+  add_test_with_context (suite, boreas_io,
+                         host_publisher_pushes_hosts_in_order);
+  add_test_with_context (suite, boreas_io, alive_stats_counts_by_method);
 
   if (argc > 1)
     return run_single_test (suite, argv[1], create_text_reporter ());
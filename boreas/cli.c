@@ -25,12 +25,23 @@
 
 static unsigned int wait_timeout = 0;
 
+/**
+ * @brief Target list of a batch, see run_cli_batch.
+ */
+struct cli_batch_list
+{
+  GPtrArray *hosts; /**< Value strings of the hosts of the list. */
+  gboolean done;    /**< Whether the result of the list was reported. */
+};
+
 static boreas_error_t
-init_cli (scanner_t *scanner, gvm_hosts_t *hosts, alive_test_t alive_test,
+init_cli (scanner_t *scanner, gvm_hosts_t **hosts,
+          struct cli_batch_list *lists, size_t count, alive_test_t alive_test,
           const gchar *port_list, const int print_results)
 {
   GPtrArray *portranges_array;
   gvm_host_t *host;
+  size_t number = 0;
   int error;
 
   portranges_array = NULL;
@@ -40,14 +51,30 @@ init_cli (scanner_t *scanner, gvm_hosts_t *hosts, alive_test_t alive_test,
   scanner->print_results = print_results;
 
   /* hosts_data */
+  for (size_t i = 0; i < count; i++)
+    number += gvm_hosts_count (hosts[i]);
   scanner->hosts_data = g_malloc0 (sizeof (hosts_data_t));
   scanner->hosts_data->alivehosts =
     g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
   scanner->hosts_data->targethosts =
     g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
-  for (host = gvm_hosts_next (hosts); host; host = gvm_hosts_next (hosts))
-    g_hash_table_insert (scanner->hosts_data->targethosts,
-                         gvm_host_value_str (host), host);
+  scanner->hosts_data->targets_set = addr_set_new (number);
+  scanner->hosts_data->alive_set = addr_set_new (number);
+  /* The targets of all the lists are probed together. A host in several
+   * lists is probed once. */
+  for (size_t i = 0; i < count; i++)
+    for (host = gvm_hosts_next (hosts[i]); host;
+         host = gvm_hosts_next (hosts[i]))
+      {
+        struct in6_addr addr6;
+
+        if (lists)
+          g_ptr_array_add (lists[i].hosts, gvm_host_value_str (host));
+        g_hash_table_insert (scanner->hosts_data->targethosts,
+                             gvm_host_value_str (host), host);
+        if (gvm_host_get_addr6 (host, &addr6) == 0)
+          addr_set_add (scanner->hosts_data->targets_set, &addr6);
+      }
 
   /* Sockets. */
   if ((error = set_all_needed_sockets (scanner, alive_test)) != 0)
@@ -83,64 +110,73 @@ free_cli (scanner_t *scanner, alive_test_t alive_test)
     }
   g_hash_table_destroy (scanner->hosts_data->alivehosts);
   g_hash_table_destroy (scanner->hosts_data->targethosts);
+  addr_set_free (scanner->hosts_data->targets_set);
+  addr_set_free (scanner->hosts_data->alive_set);
   g_free (scanner->hosts_data);
 
   return close_err;
 }
 
-static boreas_error_t
-run_cli_scan (scanner_t *scanner, alive_test_t alive_test)
+/**
+ * @brief Send the pings of the alive tests to all targets.
+ *
+ * @param scanner     Scanner.
+ * @param alive_test  Alive tests.
+ */
+static void
+send_cli_pings (scanner_t *scanner, alive_test_t alive_test)
 {
-  int error;
-  int number_of_dead_hosts;
-  int number_of_targets;
-  pthread_t sniffer_thread_id;
-  struct timeval start_time, end_time;
-
-  gettimeofday (&start_time, NULL);
-  number_of_targets = g_hash_table_size (scanner->hosts_data->targethosts);
-
-  if (scanner->print_results == 1)
-    printf ("Alive scan started: Target has %d hosts.\n", number_of_targets);
-
-  error = start_sniffer_thread (scanner, &sniffer_thread_id);
-  if (error)
-    return error;
+  send_pool_t *pool = send_pool_new (scanner, alive_test);
 
   if (alive_test & (ALIVE_TEST_ICMP))
     {
-      g_hash_table_foreach (scanner->hosts_data->targethosts, send_icmp,
-                            scanner);
-      wait_until_so_sndbuf_empty (scanner->icmpv4soc, 10);
-      wait_until_so_sndbuf_empty (scanner->icmpv6soc, 10);
+      send_pool_run (pool, send_icmp, 0, G_MAXUINT);
+      send_pool_drain (pool, ALIVE_TEST_ICMP);
       usleep (500000);
     }
   if (alive_test & (ALIVE_TEST_TCP_SYN_SERVICE))
     {
       scanner->tcp_flag = 0x02; /* SYN */
-      g_hash_table_foreach (scanner->hosts_data->targethosts, send_tcp,
-                            scanner);
-      wait_until_so_sndbuf_empty (scanner->tcpv4soc, 10);
-      wait_until_so_sndbuf_empty (scanner->tcpv6soc, 10);
+      send_pool_run (pool, send_tcp, 0, G_MAXUINT);
+      send_pool_drain (pool, ALIVE_TEST_TCP_SYN_SERVICE);
       usleep (500000);
     }
   if (alive_test & (ALIVE_TEST_TCP_ACK_SERVICE))
     {
       scanner->tcp_flag = 0x10; /* ACK */
-      g_hash_table_foreach (scanner->hosts_data->targethosts, send_tcp,
-                            scanner);
-      wait_until_so_sndbuf_empty (scanner->tcpv4soc, 10);
-      wait_until_so_sndbuf_empty (scanner->tcpv6soc, 10);
+      send_pool_run (pool, send_tcp, 0, G_MAXUINT);
+      send_pool_drain (pool, ALIVE_TEST_TCP_ACK_SERVICE);
       usleep (500000);
     }
   if (alive_test & (ALIVE_TEST_ARP))
     {
-      g_hash_table_foreach (scanner->hosts_data->targethosts, send_arp,
-                            scanner);
-      wait_until_so_sndbuf_empty (scanner->arpv4soc, 10);
-      wait_until_so_sndbuf_empty (scanner->arpv6soc, 10);
+      send_pool_run (pool, send_arp, 0, G_MAXUINT);
+      send_pool_drain (pool, ALIVE_TEST_ARP);
       usleep (500000);
     }
+  send_pool_free (pool);
+}
+
+static boreas_error_t
+run_cli_scan (scanner_t *scanner, alive_test_t alive_test)
+{
+  int error;
+  int number_of_dead_hosts;
+  int number_of_targets;
+  pthread_t sniffer_thread_id;
+  struct timeval start_time, end_time;
+
+  gettimeofday (&start_time, NULL);
+  number_of_targets = g_hash_table_size (scanner->hosts_data->targethosts);
+
+  if (scanner->print_results == 1)
+    printf ("Alive scan started: Target has %d hosts.\n", number_of_targets);
+
+  error = start_sniffer_thread (scanner, alive_test, &sniffer_thread_id);
+  if (error)
+    return error;
+
+  send_cli_pings (scanner, alive_test);
 
   if (wait_timeout > 0 && wait_timeout <= 20)
     sleep (wait_timeout);
@@ -178,7 +214,8 @@ run_cli_extended (gvm_hosts_t *hosts, alive_test_t alive_test,
 
   wait_timeout = timeout;
 
-  init_err = init_cli (&scanner, hosts, alive_test, port_list, print_results);
+  init_err = init_cli (&scanner, &hosts, NULL, 1, alive_test, port_list,
+                       print_results);
   if (init_err)
     {
       printf ("Error initializing scanner.\n");
@@ -202,6 +239,121 @@ run_cli_extended (gvm_hosts_t *hosts, alive_test_t alive_test,
   return NO_ERROR;
 }
 
+/**
+ * @brief Report the result of a target list of a batch if it is complete.
+ *
+ * @param scanner   Scanner.
+ * @param lists     Target lists.
+ * @param index     Index of the list to report.
+ * @param complete  Whether to report the list even if hosts are missing.
+ * @param func      Function receiving the result.
+ * @param data      Data for func.
+ *
+ * @return 1 if the list was reported, else 0.
+ */
+static int
+report_cli_batch_list (scanner_t *scanner, struct cli_batch_list *lists,
+                       size_t index, gboolean complete,
+                       cli_batch_result_func_t func, gpointer data)
+{
+  struct cli_batch_list *list = &lists[index];
+  GPtrArray *alive;
+
+  if (list->done)
+    return 0;
+  alive = g_ptr_array_new ();
+  for (guint i = 0; i < list->hosts->len; i++)
+    if (g_hash_table_contains (scanner->hosts_data->alivehosts,
+                               g_ptr_array_index (list->hosts, i)))
+      g_ptr_array_add (alive, g_ptr_array_index (list->hosts, i));
+  if (complete || alive->len == list->hosts->len)
+    {
+      func (index, alive, data);
+      list->done = TRUE;
+    }
+  g_ptr_array_free (alive, TRUE);
+  return list->done;
+}
+
+/**
+ * @brief Alive test several independent target lists at once.
+ *
+ * Instead of a run per list, the lists share one set of sockets and one
+ * sniffer thread and their hosts are probed together, with a single wait for
+ * the replies. The result of a list is reported as soon as all its hosts are
+ * alive, else at the end of the wait.
+ *
+ * @param hosts       Target lists.
+ * @param count       Number of target lists.
+ * @param alive_test  Alive test methods.
+ * @param port_list   Ports for the TCP pings.
+ * @param timeout     Time to wait for replies in seconds, 0 for the
+ *                    "alive_test_wait_timeout".
+ * @param func        Function receiving the index and the alive hosts, as
+ *                    value strings, of each list. Called once per list.
+ * @param data        Data for func.
+ *
+ * @return NO_ERROR (0) on success, boreas_error_t on error.
+ */
+boreas_error_t
+run_cli_batch (gvm_hosts_t **hosts, size_t count, alive_test_t alive_test,
+               const gchar *port_list, const unsigned int timeout,
+               cli_batch_result_func_t func, gpointer data)
+{
+  scanner_t scanner = {0};
+  struct cli_batch_list *lists;
+  pthread_t sniffer_thread_id;
+  boreas_error_t error;
+  boreas_error_t free_err;
+  gint64 end;
+  size_t reported = 0;
+
+  lists = g_malloc0_n (count, sizeof (*lists));
+  for (size_t i = 0; i < count; i++)
+    lists[i].hosts = g_ptr_array_new_with_free_func (g_free);
+
+  error = init_cli (&scanner, hosts, lists, count, alive_test, port_list, 0);
+  if (error)
+    {
+      g_warning ("%s: Error initializing scanner.", __func__);
+      free_err = NO_ERROR;
+      goto free_lists;
+    }
+  error = start_sniffer_thread (&scanner, alive_test, &sniffer_thread_id);
+  if (error)
+    {
+      g_warning ("%s: Error starting the sniffer.", __func__);
+      goto free_scanner;
+    }
+
+  send_cli_pings (&scanner, alive_test);
+
+  /* Wait for the replies, reporting the lists with all hosts alive. */
+  end = g_get_monotonic_time ()
+        + (timeout > 0 ? timeout : get_alive_test_wait_timeout ())
+            * G_USEC_PER_SEC;
+  while (reported < count && g_get_monotonic_time () < end)
+    {
+      for (size_t i = 0; i < count; i++)
+        reported += report_cli_batch_list (&scanner, lists, i, FALSE, func,
+                                           data);
+      usleep (100000);
+    }
+
+  stop_sniffer_thread (&scanner, sniffer_thread_id);
+  for (size_t i = 0; i < count; i++)
+    report_cli_batch_list (&scanner, lists, i, TRUE, func, data);
+
+free_scanner:
+  free_err = free_cli (&scanner, alive_test);
+free_lists:
+  for (size_t i = 0; i < count; i++)
+    g_ptr_array_free (lists[i].hosts, TRUE);
+  g_free (lists);
+
+  return error ? error : free_err;
+}
+
 /**
  * @brief Scan all specified hosts in ip_str list.
  *
@@ -235,7 +387,8 @@ is_host_alive (const char *ip_str, int *count)
    * validated by openvas so we don't do it here again. */
   port_list = prefs_get ("port_range");
 
-  init_err = init_cli (&scanner, hosts, alive_test, port_list, print_results);
+  init_err = init_cli (&scanner, &hosts, NULL, 1, alive_test, port_list,
+                       print_results);
   if (init_err)
     {
       printf ("Error initializing scanner.\n");
@@ -16,6 +16,18 @@ run_cli_extended (gvm_hosts_t *, alive_test_t, const gchar *,
 boreas_error_t
 run_cli (gvm_hosts_t *, alive_test_t, const gchar *);
 
+/**
+ * @brief Function receiving the result of a target list of run_cli_batch.
+ *
+ * Receives the index of the list, the alive hosts of the list as value
+ * strings, valid during the call, and the data given to run_cli_batch.
+ */
+typedef void (*cli_batch_result_func_t) (size_t, GPtrArray *, gpointer);
+
+boreas_error_t
+run_cli_batch (gvm_hosts_t **, size_t, alive_test_t, const gchar *,
+               const unsigned int, cli_batch_result_func_t, gpointer);
+
 boreas_error_t
 is_host_alive (const char *, int *);
 
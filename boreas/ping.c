@@ -3,10 +3,14 @@
  * SPDX-License-Identifier: GPL-2.0-or-later
  */
 
+#define _GNU_SOURCE /* for sendmmsg */
+
 #include "ping.h"
 
-#include "../base/prefs.h" /* for prefs_get() */
+#include "../base/prefs.h"  /* for prefs_get() */
+#include "../base/probes.h" /* for GVM_PROBE3 */
 #include "arp.h"
+#include "boreas_io.h" /* for alive_stats_count_sent() */
 #include "util.h"
 
 #include <arpa/inet.h>
@@ -19,11 +23,13 @@
 #include <netinet/ip6.h>
 #include <netinet/ip_icmp.h>
 #include <netinet/tcp.h>
+#include <netpacket/packet.h> /* for struct sockaddr_ll */
 #include <stdlib.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/uio.h> /* for struct iovec */
 #include <unistd.h>
 
 #undef G_LOG_DOMAIN
@@ -54,6 +60,90 @@ struct pseudohdr
   struct tcphdr tcpheader;
 };
 
+/* Default number of packets sent with one sendmmsg call. */
+#define SEND_BATCH_DEFAULT 64
+/* Maximum number of packets sent with one sendmmsg call (UIO_MAXIOV). */
+#define SEND_BATCH_MAX 1024
+/* Maximum size of a queued packet. */
+#define SEND_PACKET_MAX 128
+
+/**
+ * @brief Packets queued for a socket, sent together with sendmmsg.
+ */
+struct send_batch
+{
+  int soc;               /**< Socket of the queued packets. */
+  int so_sndbuf;         /**< Size of the empty send buffer, -1 if unknown. */
+  int init;              /**< Whether so_sndbuf was queried. */
+  unsigned int count;    /**< Number of queued packets. */
+  struct mmsghdr *msgs;  /**< Message headers. */
+  struct iovec *iovs;    /**< Packet buffers of the messages. */
+  struct sockaddr_in6 *addrs; /**< Destinations, sockaddr_in for IPv4. */
+  u_char (*packets)[SEND_PACKET_MAX]; /**< Packets. */
+};
+
+/* Batches of the sending thread, by type of the socket they are sent on. */
+static __thread struct send_batch send_batches[UDPV6 + 1];
+
+/* Addresses to record the send times of the pings for, NULL if none. */
+static addr_set_t *send_times = NULL;
+
+/* Maximum number of sender threads. */
+#define SEND_THREADS_MAX 64
+
+/**
+ * @brief Sender thread of a pool, with its own sockets.
+ */
+struct send_worker
+{
+  scanner_t scanner;   /**< Copy of the scanner, with the worker's sockets. */
+  GThread *thread;     /**< Thread of the current run. */
+  send_pool_t *pool;   /**< Pool of the worker. */
+  guint index;         /**< Index of the worker in the pool. */
+};
+
+/**
+ * @brief Pool of sender threads, partitioning the targets between them.
+ */
+struct send_pool
+{
+  scanner_t *scanner;           /**< Scanner. */
+  alive_test_t alive_test;      /**< Tests the worker sockets are open for. */
+  GPtrArray *keys;              /**< Targets, as keys of targethosts. */
+  GPtrArray *values;            /**< Targets, as gvm_host_t. */
+  guint threads;                /**< Number of workers, 1 for no threads. */
+  struct send_worker *workers;  /**< Workers, NULL for no threads. */
+  arp_template_t *arp_template; /**< ARP template built by the pool. */
+  GHFunc func;                  /**< Send function of the current run. */
+  guint start;                  /**< First target of the current run. */
+  guint end;                    /**< End of the targets of the current run. */
+};
+
+/**
+ * @brief Get the number of packets to send at once, from the
+ * "alive_test_send_batch" preference.
+ *
+ * @return Batch size, between 1 and SEND_BATCH_MAX.
+ */
+static unsigned int
+send_batch_size (void)
+{
+  static unsigned int size = 0;
+  const char *tmp;
+
+  if (size == 0)
+    {
+      int pref = (tmp = prefs_get ("alive_test_send_batch")) != NULL
+                   ? atoi (tmp)
+                   : SEND_BATCH_DEFAULT;
+
+      if (pref <= 0)
+        pref = SEND_BATCH_DEFAULT;
+      size = MIN (pref, SEND_BATCH_MAX);
+    }
+  return size;
+}
+
 /**
  * @brief Get the size of the socket send buffer.
  *
@@ -121,6 +211,481 @@ throttle (int soc, int so_sndbuf)
   return;
 }
 
+/**
+ * @brief Get the pacer of the sent packets.
+ *
+ * It is configured by the "alive_test_pps" (packets per second),
+ * "alive_test_bps" (bytes per second) and "alive_test_subnet_pps" (packets
+ * per second to one /24 or /64 subnet) preferences.
+ *
+ * @return Pacer, NULL if no rate is set.
+ */
+static pacer_t *
+send_pacer (void)
+{
+  static pacer_t *pacer = NULL;
+  static gsize init = 0;
+  const char *tmp;
+
+  /* The pacer is shared by all sender threads. */
+  if (g_once_init_enter (&init))
+    {
+      double pps, bps, subnet_pps;
+
+      pps = (tmp = prefs_get ("alive_test_pps")) != NULL ? atof (tmp) : 0;
+      bps = (tmp = prefs_get ("alive_test_bps")) != NULL ? atof (tmp) : 0;
+      subnet_pps =
+        (tmp = prefs_get ("alive_test_subnet_pps")) != NULL ? atof (tmp) : 0;
+      pacer = pacer_new (pps, bps, subnet_pps);
+      if (pacer)
+        g_debug ("%s: Pacing pings to %g packets/s, %g bytes/s and %g "
+                 "packets/s per subnet (0 for no limit)",
+                 __func__, pps, bps, subnet_pps);
+      g_once_init_leave (&init, 1);
+    }
+  return pacer;
+}
+
+/**
+ * @brief Set the addresses to record the times the pings are sent in.
+ *
+ * @param set Set of the target addresses, NULL to stop recording.
+ */
+void
+send_record_times (addr_set_t *set)
+{
+  send_times = set;
+}
+
+/**
+ * @brief Record the send time of a ping.
+ *
+ * @param dst Destination, sockaddr_in or sockaddr_in6. Others are skipped.
+ */
+static void
+record_send_time (const struct sockaddr *dst)
+{
+  struct in6_addr addr;
+
+  if (!send_times)
+    return;
+  if (dst->sa_family == AF_INET)
+    {
+      memset (&addr, 0, sizeof (addr));
+      addr.s6_addr32[2] = htonl (0xffff);
+      addr.s6_addr32[3] = ((const struct sockaddr_in *) dst)->sin_addr.s_addr;
+    }
+  else if (dst->sa_family == AF_INET6)
+    addr = ((const struct sockaddr_in6 *) dst)->sin6_addr;
+  else
+    return;
+  addr_set_set_time (send_times, &addr, g_get_monotonic_time ());
+}
+
+/**
+ * @brief Send the queued packets of a batch.
+ *
+ * With a pacer the packets are sent as fast as it allows, else the sending is
+ * throttled on the fill level of the send buffer. Packets the kernel refuses
+ * are skipped with a warning, like failed sendto calls were.
+ *
+ * @param batch Batch to send.
+ */
+static void
+send_batch_flush (struct send_batch *batch)
+{
+  pacer_t *pacer = send_pacer ();
+  unsigned int sent = 0;
+
+  if (batch->count == 0)
+    return;
+
+  /* Get size of empty SO_SNDBUF */
+  if (!batch->init)
+    {
+      if (get_so_sndbuf (batch->soc, &batch->so_sndbuf) == 0)
+        batch->init = 1;
+    }
+
+  while (sent < batch->count)
+    {
+      unsigned int count = 0;
+      gint64 throttled;
+      int ret;
+
+      gint64 start = g_get_monotonic_time ();
+
+      if (pacer)
+        {
+          /* Send the packets allowed now, waiting for at least one. */
+          while (sent + count < batch->count)
+            {
+              struct msghdr *hdr = &batch->msgs[sent + count].msg_hdr;
+              gint64 wait;
+
+              wait = pacer_reserve (pacer, hdr->msg_name,
+                                    hdr->msg_iov->iov_len);
+              if (wait == 0)
+                count++;
+              else if (count)
+                break;
+              else
+                pacer_sleep (wait);
+            }
+        }
+      else
+        {
+          /* Throttle speed if needed */
+          throttle (batch->soc, batch->so_sndbuf);
+          count = batch->count - sent;
+        }
+      throttled = g_get_monotonic_time () - start;
+      alive_stats_count_throttle (throttled);
+
+      ret = sendmmsg (batch->soc, batch->msgs + sent, count, MSG_NOSIGNAL);
+      GVM_PROBE3 (boreas_send_batch, count, ret, throttled);
+      if (ret < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          g_warning ("%s: sendmmsg(): %s", __func__, strerror (errno));
+          alive_stats_count_sent (0, 1);
+          ret = 1;
+        }
+      else
+        {
+          alive_stats_count_sent (ret, 0);
+          for (int i = 0; i < ret; i++)
+            record_send_time (batch->msgs[sent + i].msg_hdr.msg_name);
+        }
+      sent += ret;
+    }
+  batch->count = 0;
+}
+
+/**
+ * @brief Queue a packet, sending the batch once full.
+ *
+ * @param type    Type of the socket, selecting the batch.
+ * @param soc     Socket to use for sending.
+ * @param packet  Packet, at most SEND_PACKET_MAX bytes.
+ * @param len     Length of the packet.
+ * @param dst     Destination, sockaddr_in or sockaddr_in6.
+ * @param dstlen  Length of the destination.
+ */
+static void
+send_batch_add (socket_type_t type, int soc, const void *packet, size_t len,
+                const void *dst, socklen_t dstlen)
+{
+  struct send_batch *batch = &send_batches[type];
+  unsigned int size = send_batch_size ();
+  struct msghdr *hdr;
+
+  if (batch->msgs == NULL)
+    {
+      batch->msgs = g_malloc0_n (size, sizeof (*batch->msgs));
+      batch->iovs = g_malloc0_n (size, sizeof (*batch->iovs));
+      batch->addrs = g_malloc0_n (size, sizeof (*batch->addrs));
+      batch->packets = g_malloc0_n (size, sizeof (*batch->packets));
+    }
+  if (batch->count && batch->soc != soc)
+    send_batch_flush (batch);
+  if (batch->soc != soc)
+    {
+      batch->soc = soc;
+      batch->init = 0;
+      batch->so_sndbuf = -1;
+    }
+
+  memcpy (batch->packets[batch->count], packet, MIN (len, SEND_PACKET_MAX));
+  memcpy (&batch->addrs[batch->count], dst, dstlen);
+  batch->iovs[batch->count].iov_base = batch->packets[batch->count];
+  batch->iovs[batch->count].iov_len = MIN (len, SEND_PACKET_MAX);
+  hdr = &batch->msgs[batch->count].msg_hdr;
+  memset (hdr, 0, sizeof (*hdr));
+  hdr->msg_name = &batch->addrs[batch->count];
+  hdr->msg_namelen = dstlen;
+  hdr->msg_iov = &batch->iovs[batch->count];
+  hdr->msg_iovlen = 1;
+
+  if (++batch->count == size)
+    send_batch_flush (batch);
+}
+
+/**
+ * @brief Send all queued ping packets of the thread.
+ *
+ * Called at the end of every run over the targets, so that a partial batch
+ * does not wait for the next alive test.
+ */
+static void
+send_flush (void)
+{
+  for (unsigned int i = 0; i < G_N_ELEMENTS (send_batches); i++)
+    send_batch_flush (&send_batches[i]);
+}
+
+/**
+ * @brief Send all queued ping packets of the thread and free its batches.
+ *
+ * Is to be called before a sender thread exits, and by the thread which
+ * sent with a single-threaded pool when the pool is freed.
+ */
+static void
+send_batches_free (void)
+{
+  send_flush ();
+  for (unsigned int i = 0; i < G_N_ELEMENTS (send_batches); i++)
+    {
+      g_free (send_batches[i].msgs);
+      g_free (send_batches[i].iovs);
+      g_free (send_batches[i].addrs);
+      g_free (send_batches[i].packets);
+      memset (&send_batches[i], 0, sizeof (send_batches[i]));
+    }
+}
+
+/**
+ * @brief Close the open sockets of a worker.
+ *
+ * @param worker Worker.
+ */
+static void
+send_worker_close (struct send_worker *worker)
+{
+  int *socs[] = {&worker->scanner.tcpv4soc,  &worker->scanner.tcpv6soc,
+                 &worker->scanner.icmpv4soc, &worker->scanner.icmpv6soc,
+                 &worker->scanner.arpv4soc,  &worker->scanner.arpv6soc,
+                 &worker->scanner.udpv4soc,  &worker->scanner.udpv6soc};
+
+  for (unsigned int i = 0; i < G_N_ELEMENTS (socs); i++)
+    {
+      if (*socs[i] >= 0)
+        close (*socs[i]);
+      *socs[i] = -1;
+    }
+}
+
+/**
+ * @brief Create a pool of sender threads.
+ *
+ * The number of threads is set by the "alive_test_send_threads" preference.
+ * Every thread gets its own sockets for the given alive tests, so that the
+ * threads do not share send buffers. All threads share the pacer of the
+ * sent packets. With a single thread the packets are sent by the caller of
+ * send_pool_run(), on the sockets of the scanner.
+ *
+ * @param scanner    Scanner, with the targets to send to.
+ * @param alive_test Alive tests the pool is used for.
+ *
+ * @return New pool, to be freed with send_pool_free().
+ */
+send_pool_t *
+send_pool_new (scanner_t *scanner, alive_test_t alive_test)
+{
+  send_pool_t *pool;
+  GHashTableIter iter;
+  gpointer key, value;
+  const char *tmp;
+  int threads;
+
+  pool = g_malloc0 (sizeof (*pool));
+  pool->scanner = scanner;
+  pool->alive_test = alive_test;
+  pool->keys = g_ptr_array_new ();
+  pool->values = g_ptr_array_new ();
+  g_hash_table_iter_init (&iter, scanner->hosts_data->targethosts);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      g_ptr_array_add (pool->keys, key);
+      g_ptr_array_add (pool->values, value);
+    }
+
+  /* The interface to the targets is resolved once, the ARP requests of the
+   * scan are copies of a single template. */
+  if ((alive_test & ALIVE_TEST_ARP) && scanner->arpv4soc >= 0
+      && !scanner->arp_template)
+    {
+      char *iface = targets_iface (scanner->hosts_data);
+
+      pool->arp_template = arp_template_new (scanner->arpv4soc, iface);
+      scanner->arp_template = pool->arp_template;
+      g_free (iface);
+    }
+
+  threads = (tmp = prefs_get ("alive_test_send_threads")) != NULL ? atoi (tmp)
+                                                                  : 1;
+  threads = CLAMP (threads, 1, SEND_THREADS_MAX);
+  pool->threads = 1;
+  if (threads == 1)
+    return pool;
+
+  pool->workers = g_malloc0_n (threads, sizeof (*pool->workers));
+  for (pool->threads = 0; pool->threads < (guint) threads; pool->threads++)
+    {
+      struct send_worker *worker = &pool->workers[pool->threads];
+      boreas_error_t error;
+
+      worker->scanner = *scanner;
+      worker->pool = pool;
+      worker->index = pool->threads;
+      send_worker_close (worker);
+      if ((error = set_all_needed_sockets (&worker->scanner, alive_test)) != 0)
+        {
+          g_warning ("%s: Could not open the sockets of sender thread %u. %s",
+                     __func__, pool->threads, str_boreas_error (error));
+          send_worker_close (worker);
+          break;
+        }
+    }
+  if (pool->threads <= 1)
+    {
+      /* Send on the sockets of the scanner instead. */
+      if (pool->threads == 1)
+        send_worker_close (&pool->workers[0]);
+      g_free (pool->workers);
+      pool->workers = NULL;
+      pool->threads = 1;
+    }
+  else
+    g_debug ("%s: Sending pings with %u threads", __func__, pool->threads);
+  return pool;
+}
+
+/**
+ * @brief Free a pool of sender threads, closing the sockets of its workers.
+ *
+ * Sends the packets still queued by the calling thread and frees its batches.
+ *
+ * @param pool Pool, may be NULL.
+ */
+void
+send_pool_free (send_pool_t *pool)
+{
+  if (!pool)
+    return;
+  send_batches_free ();
+  for (guint i = 0; pool->workers && i < pool->threads; i++)
+    send_worker_close (&pool->workers[i]);
+  g_free (pool->workers);
+  if (pool->arp_template)
+    {
+      pool->scanner->arp_template = NULL;
+      arp_template_free (pool->arp_template);
+    }
+  g_ptr_array_free (pool->keys, TRUE);
+  g_ptr_array_free (pool->values, TRUE);
+  g_free (pool);
+}
+
+/**
+ * @brief Get the number of targets of a pool of sender threads.
+ *
+ * @param pool Pool.
+ *
+ * @return Number of targets.
+ */
+guint
+send_pool_size (const send_pool_t *pool)
+{
+  return pool->keys->len;
+}
+
+/**
+ * @brief Thread function of a worker, sending to its share of the targets.
+ *
+ * The targets are dealt round robin, so that each worker gets about the same
+ * number of targets of every subnet.
+ *
+ * @param data Worker.
+ *
+ * @return NULL.
+ */
+static gpointer
+send_worker_run (gpointer data)
+{
+  struct send_worker *worker = data;
+  send_pool_t *pool = worker->pool;
+
+  for (guint i = pool->start + worker->index; i < pool->end;
+       i += pool->threads)
+    pool->func (g_ptr_array_index (pool->keys, i),
+                g_ptr_array_index (pool->values, i), &worker->scanner);
+  send_batches_free ();
+  return NULL;
+}
+
+/**
+ * @brief Send to a range of the targets of a pool, with all its threads.
+ *
+ * Returns once all the packets are handed to the kernel.
+ *
+ * @param pool  Pool.
+ * @param func  Send function called for every target, like send_icmp.
+ * @param start First target.
+ * @param end   End of the targets, at most send_pool_size().
+ */
+void
+send_pool_run (send_pool_t *pool, GHFunc func, guint start, guint end)
+{
+  end = MIN (end, send_pool_size (pool));
+  if (!pool->workers)
+    {
+      for (guint i = start; i < end; i++)
+        func (g_ptr_array_index (pool->keys, i),
+              g_ptr_array_index (pool->values, i), pool->scanner);
+      send_flush ();
+      return;
+    }
+
+  pool->func = func;
+  pool->start = start;
+  pool->end = end;
+  for (guint i = 0; i < pool->threads; i++)
+    {
+      /* The TCP flag may have changed since the worker was created. */
+      pool->workers[i].scanner.tcp_flag = pool->scanner->tcp_flag;
+      pool->workers[i].thread =
+        g_thread_new ("boreas sender", send_worker_run, &pool->workers[i]);
+    }
+  for (guint i = 0; i < pool->threads; i++)
+    g_thread_join (pool->workers[i].thread);
+}
+
+/**
+ * @brief Wait until the send buffers of the sockets of an alive test are
+ * empty, for all the sockets of a pool.
+ *
+ * @param pool       Pool.
+ * @param alive_test Alive test whose sockets to wait for.
+ */
+void
+send_pool_drain (send_pool_t *pool, alive_test_t alive_test)
+{
+  for (guint i = 0; i < pool->threads; i++)
+    {
+      scanner_t *scanner =
+        pool->workers ? &pool->workers[i].scanner : pool->scanner;
+
+      if (alive_test & ALIVE_TEST_ICMP)
+        {
+          wait_until_so_sndbuf_empty (scanner->icmpv4soc, 10);
+          wait_until_so_sndbuf_empty (scanner->icmpv6soc, 10);
+        }
+      if (alive_test
+          & (ALIVE_TEST_TCP_SYN_SERVICE | ALIVE_TEST_TCP_ACK_SERVICE))
+        {
+          wait_until_so_sndbuf_empty (scanner->tcpv4soc, 10);
+          wait_until_so_sndbuf_empty (scanner->tcpv6soc, 10);
+        }
+      if (alive_test & ALIVE_TEST_ARP)
+        {
+          wait_until_so_sndbuf_empty (scanner->arpv4soc, 10);
+          wait_until_so_sndbuf_empty (scanner->arpv6soc, 10);
+        }
+    }
+}
+
 /**
  * @brief Send icmp ping.
  *
@@ -137,10 +702,6 @@ send_icmp_v6 (int soc, struct in6_addr *dst, int type)
   int datalen = 56;
   struct icmp6_hdr *icmp6;
 
-  /* Throttling related variables */
-  static int so_sndbuf = -1; // socket send buffer
-  static int init = -1;
-
   icmp6 = (struct icmp6_hdr *) sendbuf;
   icmp6->icmp6_type = type; /* ND_NEIGHBOR_SOLICIT or ICMP6_ECHO_REQUEST */
   icmp6->icmp6_code = 0;
@@ -156,21 +717,161 @@ send_icmp_v6 (int soc, struct in6_addr *dst, int type)
   soca.sin6_family = AF_INET6;
   soca.sin6_addr = *dst;
 
-  /* Get size of empty SO_SNDBUF */
-  if (init == -1)
+  send_batch_add (type == ND_NEIGHBOR_SOLICIT ? ARPV6 : ICMPV6, soc, sendbuf,
+                  len, &soca, sizeof (struct sockaddr_in6));
+}
+
+/**
+ * @brief Send a neighbor solicitation to the solicited-node multicast group of
+ * a target on a local link.
+ *
+ * Unlike a unicast solicitation it needs no neighbor cache entry of the
+ * target, and only the hosts sharing the low 24 bits of the target address
+ * receive it.
+ *
+ * @param soc  Socket to use for sending.
+ * @param dst  Target address.
+ * @param link Local link of the target.
+ */
+static void
+send_ns_v6 (int soc, const struct in6_addr *dst, const ndp_link_t *link)
+{
+  struct sockaddr_in6 soca;
+  uint8_t sendbuf[sizeof (struct nd_neighbor_solicit) + 8];
+  struct nd_neighbor_solicit *ns;
+  size_t len = sizeof (struct nd_neighbor_solicit);
+
+  memset (sendbuf, 0, sizeof (sendbuf));
+  ns = (struct nd_neighbor_solicit *) sendbuf;
+  ns->nd_ns_type = ND_NEIGHBOR_SOLICIT;
+  ns->nd_ns_target = *dst;
+  /* With the link-layer address the target answers without a solicitation
+   * of its own. */
+  if (link->has_mac)
     {
-      if (get_so_sndbuf (soc, &so_sndbuf) == 0)
-        init = 1;
+      struct nd_opt_hdr *opt = (struct nd_opt_hdr *) (sendbuf + len);
+
+      opt->nd_opt_type = ND_OPT_SOURCE_LINKADDR;
+      opt->nd_opt_len = 1;
+      memcpy (opt + 1, link->mac, sizeof (link->mac));
+      len += 8;
     }
-  /* Throttle speed if needed */
-  throttle (soc, so_sndbuf);
 
-  if (sendto (soc, sendbuf, len, MSG_NOSIGNAL, (struct sockaddr *) &soca,
-              sizeof (struct sockaddr_in6))
-      < 0)
+  memset (&soca, 0, sizeof (struct sockaddr_in6));
+  soca.sin6_family = AF_INET6;
+  ndp_solicited_node (dst, &soca.sin6_addr);
+  soca.sin6_scope_id = link->ifindex;
+
+  /* The replies come from the target, not from the multicast group. */
+  if (send_times)
+    addr_set_set_time (send_times, dst, g_get_monotonic_time ());
+  send_batch_add (ARPV6, soc, sendbuf, len, &soca,
+                  sizeof (struct sockaddr_in6));
+}
+
+/**
+ * @brief Send an echo request to the all-nodes multicast group of a local
+ * link.
+ *
+ * The request is sent from the address of the link in its prefix, so that
+ * the hosts reply from their addresses in the prefix, not from their
+ * link-local ones.
+ *
+ * @param soc  Socket to use for sending.
+ * @param link Local link.
+ */
+static void
+send_all_nodes_echo (int soc, const ndp_link_t *link)
+{
+  struct sockaddr_in6 soca;
+  struct icmp6_hdr icmp6;
+  struct iovec iov;
+  struct msghdr msg;
+  union
+  {
+    struct cmsghdr hdr;
+    char buf[CMSG_SPACE (sizeof (struct in6_pktinfo))];
+  } control;
+  struct cmsghdr *cmsg;
+  struct in6_pktinfo *info;
+
+  memset (&icmp6, 0, sizeof (icmp6));
+  icmp6.icmp6_type = ICMP6_ECHO_REQUEST;
+  icmp6.icmp6_id = 234;
+
+  memset (&soca, 0, sizeof (struct sockaddr_in6));
+  soca.sin6_family = AF_INET6;
+  inet_pton (AF_INET6, "ff02::1", &soca.sin6_addr);
+  soca.sin6_scope_id = link->ifindex;
+
+  iov.iov_base = &icmp6;
+  iov.iov_len = sizeof (icmp6);
+  memset (&msg, 0, sizeof (msg));
+  memset (&control, 0, sizeof (control));
+  msg.msg_name = &soca;
+  msg.msg_namelen = sizeof (soca);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof (control.buf);
+  cmsg = CMSG_FIRSTHDR (&msg);
+  cmsg->cmsg_level = IPPROTO_IPV6;
+  cmsg->cmsg_type = IPV6_PKTINFO;
+  cmsg->cmsg_len = CMSG_LEN (sizeof (struct in6_pktinfo));
+  info = (struct in6_pktinfo *) CMSG_DATA (cmsg);
+  info->ipi6_addr = link->addr;
+  info->ipi6_ifindex = link->ifindex;
+
+  pacer_wait (send_pacer (), (struct sockaddr *) &soca, sizeof (icmp6));
+  if (sendmsg (soc, &msg, 0) < 0)
     {
-      g_warning ("%s: sendto(): %s", __func__, strerror (errno));
+      g_debug ("%s: sendmsg to link %u failed: %s", __func__, link->ifindex,
+               strerror (errno));
+      alive_stats_count_sent (0, 1);
     }
+  else
+    alive_stats_count_sent (1, 0);
+}
+
+/**
+ * @brief Send an echo request to the all-nodes multicast group of every
+ * local link with IPv6 targets.
+ *
+ * One request is answered by all the hosts of a link which answer echo
+ * requests, so that the solicitations of send_arp() are skipped for them.
+ *
+ * @param scanner Scanner, with the local links in ndp_links.
+ */
+void
+send_ndp_all_nodes (scanner_t *scanner)
+{
+  GArray *links = scanner->ndp_links;
+  GHashTableIter iter;
+  gpointer key, value;
+  gboolean *used;
+
+  if (!links || scanner->arpv6soc < 0)
+    return;
+
+  used = g_new0 (gboolean, links->len);
+  g_hash_table_iter_init (&iter, scanner->hosts_data->targethosts);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      struct in6_addr addr6;
+      const ndp_link_t *link;
+
+      if (gvm_host_get_addr6 ((gvm_host_t *) value, &addr6) < 0
+          || IN6_IS_ADDR_V4MAPPED (&addr6))
+        continue;
+      if ((link = ndp_links_find (links, &addr6)) != NULL)
+        used[link - (ndp_link_t *) links->data] = TRUE;
+    }
+  for (guint i = 0; i < links->len; i++)
+    if (used[i])
+      send_all_nodes_echo (scanner->arpv6soc,
+                           &g_array_index (links, ndp_link_t, i));
+  send_flush ();
+  g_free (used);
 }
 
 /**
@@ -190,10 +891,6 @@ send_icmp_v4 (int soc, struct in_addr *dst)
   int datalen = 56;
   struct icmphdr *icmp;
 
-  /* Throttling related variables */
-  static int so_sndbuf = -1; // socket send buffer
-  static int init = -1;
-
   icmp = (struct icmphdr *) sendbuf;
   icmp->type = ICMP_ECHO;
   icmp->code = 0;
@@ -206,21 +903,8 @@ send_icmp_v4 (int soc, struct in_addr *dst)
   soca.sin_family = AF_INET;
   soca.sin_addr = *dst;
 
-  /* Get size of empty SO_SNDBUF */
-  if (init == -1)
-    {
-      if (get_so_sndbuf (soc, &so_sndbuf) == 0)
-        init = 1;
-    }
-  /* Throttle speed if needed */
-  throttle (soc, so_sndbuf);
-
-  if (sendto (soc, sendbuf, len, MSG_NOSIGNAL, (const struct sockaddr *) &soca,
-              sizeof (struct sockaddr_in))
-      < 0)
-    {
-      g_warning ("%s: sendto(): %s", __func__, strerror (errno));
-    }
+  send_batch_add (ICMPV4, soc, sendbuf, len, &soca,
+                  sizeof (struct sockaddr_in));
 }
 
 /**
@@ -239,7 +923,7 @@ send_icmp (gpointer key, gpointer value, gpointer scanner_p)
   struct in6_addr *dst6_p = &dst6;
   struct in_addr dst4;
   struct in_addr *dst4_p = &dst4;
-  static int count = 0;
+  static __thread int count = 0;
   int icmp_retries, grace_period = 0;
   const char *tmp;
   if ((icmp_retries =
@@ -258,7 +942,10 @@ send_icmp (gpointer key, gpointer value, gpointer scanner_p)
       if (g_hash_table_contains (scanner->hosts_data->alivehosts, key))
         return;
       if (++count % BURST == 0)
-        usleep (BURST_TIMEOUT);
+        {
+          send_flush ();
+          usleep (BURST_TIMEOUT);
+        }
 
       if (gvm_host_get_addr6 ((gvm_host_t *) value, dst6_p) < 0)
         g_warning ("%s: could not get addr6 from gvm_host_t", __func__);
@@ -277,16 +964,156 @@ send_icmp (gpointer key, gpointer value, gpointer scanner_p)
           send_icmp_v4 (scanner->icmpv4soc, dst4_p);
         }
       if (grace_period > 0)
-        usleep (grace_period);
+        {
+          send_flush ();
+          usleep (grace_period);
+        }
     }
 }
 
+/**
+ * @brief TCP ping packet for one source address and TCP flag.
+ *
+ * The destination address, port and sequence number of the packet are zero,
+ * and the TCP checksum is of the packet with these zero fields. They are
+ * patched in for every ping, updating the checksum incrementally.
+ */
+struct tcp_template
+{
+  int valid;           /**< Whether the template is built. */
+  struct in6_addr src; /**< Source address, IPv4 address in the last word. */
+  uint8_t tcp_flag;    /**< TH_SYN or TH_ACK. */
+  uint16_t sum;        /**< TCP checksum of the template. */
+  /** Packet, IPv4 packets are shorter. */
+  u_char packet[sizeof (struct ip6_hdr) + sizeof (struct tcphdr)];
+};
+
+/* Templates of the sending thread. */
+static __thread struct tcp_template tcp_template_v4, tcp_template_v6;
+
+/**
+ * @brief Get the IPv6 TCP ping template, building it if needed.
+ *
+ * @param src      Source address.
+ * @param tcp_flag TH_SYN or TH_ACK.
+ *
+ * @return Template.
+ */
+static struct tcp_template *
+get_tcp_template_v6 (const struct in6_addr *src, uint8_t tcp_flag)
+{
+  struct tcp_template *template = &tcp_template_v6;
+  struct ip6_hdr *ip = (struct ip6_hdr *) template->packet;
+  struct tcphdr *tcp =
+    (struct tcphdr *) (template->packet + sizeof (struct ip6_hdr));
+  struct v6pseudohdr pseudoheader;
+
+  if (template->valid && template->tcp_flag == tcp_flag
+      && IN6_ARE_ADDR_EQUAL (&template->src, src))
+    return template;
+
+  memset (template->packet, 0, sizeof (template->packet));
+  /* IPv6 */
+  ip->ip6_flow = htonl ((6 << 28) | (0 << 20) | 0);
+  ip->ip6_plen = htons (20); // TCP_HDRLEN
+  ip->ip6_nxt = IPPROTO_TCP;
+  ip->ip6_hops = 255; // max value
+  ip->ip6_src = *src;
+
+  /* TCP */
+  tcp->th_sport = htons (FILTER_PORT);
+  tcp->th_seq = htonl (0);
+  tcp->th_ack = htonl (0);
+  tcp->th_x2 = 0;
+  tcp->th_off = 20 / 4; // TCP_HDRLEN / 4 (size of tcphdr in 32 bit words)
+  tcp->th_flags = tcp_flag; // TH_SYN or TH_ACK
+  tcp->th_win = htons (65535);
+  tcp->th_urp = htons (0);
+  tcp->th_sum = 0;
+
+  /* CKsum */
+  memset (&pseudoheader, 0, 38 + sizeof (struct tcphdr));
+  memcpy (&pseudoheader.s6addr, &ip->ip6_src, sizeof (struct in6_addr));
+  pseudoheader.protocol = IPPROTO_TCP;
+  pseudoheader.length = htons (sizeof (struct tcphdr));
+  memcpy ((char *) &pseudoheader.tcpheader, (char *) tcp,
+          sizeof (struct tcphdr));
+  template->sum =
+    in_cksum ((unsigned short *) &pseudoheader, 38 + sizeof (struct tcphdr));
+
+  template->src = *src;
+  template->tcp_flag = tcp_flag;
+  template->valid = 1;
+  return template;
+}
+
+/**
+ * @brief Get the IPv4 TCP ping template, building it if needed.
+ *
+ * @param src      Source address.
+ * @param tcp_flag TH_SYN or TH_ACK.
+ *
+ * @return Template.
+ */
+static struct tcp_template *
+get_tcp_template_v4 (const struct in_addr *src, uint8_t tcp_flag)
+{
+  struct tcp_template *template = &tcp_template_v4;
+  struct ip *ip = (struct ip *) template->packet;
+  struct tcphdr *tcp =
+    (struct tcphdr *) (template->packet + sizeof (struct ip));
+  struct pseudohdr pseudoheader;
+
+  if (template->valid && template->tcp_flag == tcp_flag
+      && template->src.s6_addr32[3] == src->s_addr)
+    return template;
+
+  memset (template->packet, 0, sizeof (template->packet));
+  /* IP */
+  ip->ip_hl = 5;
+  ip->ip_off = htons (0);
+  ip->ip_v = 4;
+  ip->ip_tos = 0;
+  ip->ip_p = IPPROTO_TCP;
+  ip->ip_ttl = 0x40;
+  ip->ip_src = *src;
+  ip->ip_sum = 0;
+
+  /* TCP */
+  tcp->th_sport = htons (FILTER_PORT);
+  tcp->th_flags = tcp_flag; // TH_SYN TH_ACK;
+  tcp->th_ack = 0;
+  tcp->th_x2 = 0;
+  tcp->th_off = 5;
+  tcp->th_win = 2048;
+  tcp->th_urp = 0;
+  tcp->th_sum = 0;
+
+  /* CKsum */
+  memset (&pseudoheader, 0, 12 + sizeof (struct tcphdr));
+  pseudoheader.saddr.s_addr = ip->ip_src.s_addr;
+  pseudoheader.protocol = IPPROTO_TCP;
+  pseudoheader.length = htons (sizeof (struct tcphdr));
+  memcpy ((char *) &pseudoheader.tcpheader, (char *) tcp,
+          sizeof (struct tcphdr));
+  template->sum =
+    in_cksum ((unsigned short *) &pseudoheader, 12 + sizeof (struct tcphdr));
+
+  memset (&template->src, 0, sizeof (template->src));
+  template->src.s6_addr32[3] = src->s_addr;
+  template->tcp_flag = tcp_flag;
+  template->valid = 1;
+  return template;
+}
+
 /**
  * @brief Send tcp ping.
  *
- * @param soc Socket to use for sending.
- * @param dst Destination address to send to.
- * @param tcp_flag  TH_SYN or TH_ACK.
+ * The packets are built from the template of the source address and TCP
+ * flag. Only the destination address and port are patched in.
+ *
+ * @param scanner Scanner struct which includes all needed data for tcp_v6 ping.
+ * @param dst_p   Destination address to send to.
  */
 static void
 send_tcp_v6 (scanner_t *scanner, struct in6_addr *dst_p)
@@ -294,10 +1121,9 @@ send_tcp_v6 (scanner_t *scanner, struct in6_addr *dst_p)
   boreas_error_t error;
   struct sockaddr_in6 soca;
   struct in6_addr src;
-
-  /* Throttling related variables */
-  static int so_sndbuf = -1; // socket send buffer
-  static int init = -1;
+  struct tcp_template *template;
+  static const struct in6_addr zero6;
+  uint16_t sum;
 
   GArray *ports = scanner->ports;
   int *udpv6soc = &(scanner->udpv6soc);
@@ -324,75 +1150,37 @@ send_tcp_v6 (scanner_t *scanner, struct in6_addr *dst_p)
   if (ports->len == 0)
     return;
 
+  template = get_tcp_template_v6 (&src, tcp_flag);
+  memcpy (packet, template->packet, sizeof (packet));
+  ip->ip6_dst = *dst_p;
+  sum = in_cksum_update (template->sum, &zero6, dst_p, sizeof (*dst_p));
+
+  memset (&soca, 0, sizeof (soca));
+  soca.sin6_family = AF_INET6;
+  soca.sin6_addr = ip->ip6_dst;
+
   /* For ports in ports array send packet. */
   for (guint i = 0; i < ports->len; i++)
     {
-      memset (packet, 0, sizeof (packet));
-      /* IPv6 */
-      ip->ip6_flow = htonl ((6 << 28) | (0 << 20) | 0);
-      ip->ip6_plen = htons (20); // TCP_HDRLEN
-      ip->ip6_nxt = IPPROTO_TCP;
-      ip->ip6_hops = 255; // max value
-
-      ip->ip6_src = src;
-      ip->ip6_dst = *dst_p;
-
-      /* TCP */
-      tcp->th_sport = htons (FILTER_PORT);
       tcp->th_dport = htons (g_array_index (ports, uint16_t, i));
-      tcp->th_seq = htonl (0);
-      tcp->th_ack = htonl (0);
-      tcp->th_x2 = 0;
-      tcp->th_off = 20 / 4; // TCP_HDRLEN / 4 (size of tcphdr in 32 bit words)
-      tcp->th_flags = tcp_flag; // TH_SYN or TH_ACK
-      tcp->th_win = htons (65535);
-      tcp->th_urp = htons (0);
-      tcp->th_sum = 0;
-
-      /* CKsum */
-      {
-        struct v6pseudohdr pseudoheader;
-
-        memset (&pseudoheader, 0, 38 + sizeof (struct tcphdr));
-        memcpy (&pseudoheader.s6addr, &ip->ip6_src, sizeof (struct in6_addr));
-        memcpy (&pseudoheader.d6addr, &ip->ip6_dst, sizeof (struct in6_addr));
-
-        pseudoheader.protocol = IPPROTO_TCP;
-        pseudoheader.length = htons (sizeof (struct tcphdr));
-        memcpy ((char *) &pseudoheader.tcpheader, (char *) tcp,
-                sizeof (struct tcphdr));
-        tcp->th_sum = in_cksum ((unsigned short *) &pseudoheader,
-                                38 + sizeof (struct tcphdr));
-      }
-
-      memset (&soca, 0, sizeof (soca));
-      soca.sin6_family = AF_INET6;
-      soca.sin6_addr = ip->ip6_dst;
-
-      /* Get size of empty SO_SNDBUF */
-      if (init == -1)
-        {
-          if (get_so_sndbuf (soc, &so_sndbuf) == 0)
-            init = 1;
-        }
-      /* Throttle speed if needed */
-      throttle (soc, so_sndbuf);
+      tcp->th_sum = in_cksum_update (sum, &zero6, &tcp->th_dport,
+                                     sizeof (tcp->th_dport));
 
       /*  TCP_HDRLEN(20) IP6_HDRLEN(40) */
-      if (sendto (soc, (const void *) ip, 40 + 20, MSG_NOSIGNAL,
-                  (struct sockaddr *) &soca, sizeof (struct sockaddr_in6))
-          < 0)
-        {
-          g_warning ("%s: sendto():  %s", __func__, strerror (errno));
-        }
+      send_batch_add (TCPV6, soc, ip, 40 + 20, &soca,
+                      sizeof (struct sockaddr_in6));
     }
 }
 
 /**
  * @brief Send tcp ping.
  *
+ * The packets are built from the template of the source address and TCP
+ * flag. Only the destination address, port, IP ID and sequence number are
+ * patched in.
+ *
  * @param scanner Scanner struct which includes all needed data for tcp_v4 ping.
- * @param dst Destination address to send to.
+ * @param dst_p   Destination address to send to.
  */
 static void
 send_tcp_v4 (scanner_t *scanner, struct in_addr *dst_p)
@@ -400,10 +1188,9 @@ send_tcp_v4 (scanner_t *scanner, struct in_addr *dst_p)
   boreas_error_t error;
   struct sockaddr_in soca;
   struct in_addr src;
-
-  /* Throttling related variables */
-  static int so_sndbuf = -1; // socket send buffer
-  static int init = -1;
+  struct tcp_template *template;
+  static const uint32_t zero;
+  uint16_t sum;
 
   int soc = scanner->tcpv4soc;          /* Socket used for sending. */
   GArray *ports = scanner->ports;       /* Ports to ping. */
@@ -429,72 +1216,28 @@ send_tcp_v4 (scanner_t *scanner, struct in_addr *dst_p)
       return;
     }
 
+  template = get_tcp_template_v4 (&src, tcp_flag);
+  memcpy (packet, template->packet, sizeof (packet));
+  ip->ip_dst = *dst_p;
+  sum = in_cksum_update (template->sum, &zero, dst_p, sizeof (*dst_p));
+
+  memset (&soca, 0, sizeof (soca));
+  soca.sin_family = AF_INET;
+  soca.sin_addr = ip->ip_dst;
+
   /* For ports in ports array send packet. */
   for (guint i = 0; i < ports->len; i++)
     {
-      memset (packet, 0, sizeof (packet));
-      /* IP */
-      ip->ip_hl = 5;
-      ip->ip_off = htons (0);
-      ip->ip_v = 4;
-      ip->ip_tos = 0;
-      ip->ip_p = IPPROTO_TCP;
       ip->ip_id = rand ();
-      ip->ip_ttl = 0x40;
-      ip->ip_src = src;
-      ip->ip_dst = *dst_p;
-      ip->ip_sum = 0;
-
-      /* TCP */
-      tcp->th_sport = htons (FILTER_PORT);
-      tcp->th_flags = tcp_flag; // TH_SYN TH_ACK;
       tcp->th_dport = htons (g_array_index (ports, uint16_t, i));
       tcp->th_seq = rand ();
-      tcp->th_ack = 0;
-      tcp->th_x2 = 0;
-      tcp->th_off = 5;
-      tcp->th_win = 2048;
-      tcp->th_urp = 0;
-      tcp->th_sum = 0;
-
-      /* CKsum */
-      {
-        struct in_addr source, dest;
-        struct pseudohdr pseudoheader;
-        source.s_addr = ip->ip_src.s_addr;
-        dest.s_addr = ip->ip_dst.s_addr;
-
-        memset (&pseudoheader, 0, 12 + sizeof (struct tcphdr));
-        pseudoheader.saddr.s_addr = source.s_addr;
-        pseudoheader.daddr.s_addr = dest.s_addr;
-
-        pseudoheader.protocol = IPPROTO_TCP;
-        pseudoheader.length = htons (sizeof (struct tcphdr));
-        memcpy ((char *) &pseudoheader.tcpheader, (char *) tcp,
-                sizeof (struct tcphdr));
-        tcp->th_sum = in_cksum ((unsigned short *) &pseudoheader,
-                                12 + sizeof (struct tcphdr));
-      }
-
-      memset (&soca, 0, sizeof (soca));
-      soca.sin_family = AF_INET;
-      soca.sin_addr = ip->ip_dst;
-
-      /* Get size of empty SO_SNDBUF */
-      if (init == -1)
-        {
-          if (get_so_sndbuf (soc, &so_sndbuf) == 0)
-            init = 1;
-        }
-      /* Throttle speed if needed */
-      throttle (soc, so_sndbuf);
+      /* The dport and seq of the template are zero. */
+      tcp->th_sum = in_cksum_update (sum, &zero, &tcp->th_dport,
+                                     sizeof (tcp->th_dport));
+      tcp->th_sum = in_cksum_update (tcp->th_sum, &zero, &tcp->th_seq,
+                                     sizeof (tcp->th_seq));
 
-      if (sendto (soc, (const void *) ip, 40, MSG_NOSIGNAL,
-                  (struct sockaddr *) &soca, sizeof (soca))
-          < 0)
-        {
-          g_warning ("%s: sendto(): %s", __func__, strerror (errno));
-        }
+      send_batch_add (TCPV4, soc, ip, 40, &soca, sizeof (soca));
     }
 }
 
@@ -514,7 +1257,7 @@ send_tcp (gpointer key, gpointer value, gpointer scanner_p)
   struct in6_addr *dst6_p = &dst6;
   struct in_addr dst4;
   struct in_addr *dst4_p = &dst4;
-  static int count = 0;
+  static __thread int count = 0;
 
   scanner = (scanner_t *) scanner_p;
 
@@ -523,7 +1266,10 @@ send_tcp (gpointer key, gpointer value, gpointer scanner_p)
 
   count++;
   if (count % BURST == 0)
-    usleep (BURST_TIMEOUT);
+    {
+      send_flush ();
+      usleep (BURST_TIMEOUT);
+    }
 
   if (gvm_host_get_addr6 ((gvm_host_t *) value, dst6_p) < 0)
     g_warning ("%s: could not get addr6 from gvm_host_t", __func__);
@@ -557,7 +1303,8 @@ send_arp (gpointer host_value_str, gpointer value, gpointer scanner_p)
   scanner_t *scanner;
   struct in6_addr dst6;
   struct in6_addr *dst6_p = &dst6;
-  static int count = 0;
+  static __thread int count = 0;
+  static GMutex arp_mutex;
 
   scanner = (scanner_t *) scanner_p;
 
@@ -566,7 +1313,10 @@ send_arp (gpointer host_value_str, gpointer value, gpointer scanner_p)
 
   count++;
   if (count % BURST == 0)
-    usleep (BURST_TIMEOUT);
+    {
+      send_flush ();
+      usleep (BURST_TIMEOUT);
+    }
 
   if (gvm_host_get_addr6 ((gvm_host_t *) value, dst6_p) < 0)
     g_warning ("%s: could not get addr6 from gvm_host_t", __func__);
@@ -577,13 +1327,35 @@ send_arp (gpointer host_value_str, gpointer value, gpointer scanner_p)
     }
   if (IN6_IS_ADDR_V4MAPPED (dst6_p) != 1)
     {
+      const ndp_link_t *link = ndp_links_find (scanner->ndp_links, dst6_p);
+
       /* IPv6 does simulate ARP by using the Neighbor Discovery Protocol with
-       * ICMPv6. */
-      send_icmp_v6 (scanner->arpv6soc, dst6_p, ND_NEIGHBOR_SOLICIT);
+       * ICMPv6. Targets on a local link are solicited through multicast. */
+      if (link)
+        send_ns_v6 (scanner->arpv6soc, dst6_p, link);
+      else
+        send_icmp_v6 (scanner->arpv6soc, dst6_p, ND_NEIGHBOR_SOLICIT);
     }
   else
     {
       char ipv4_str[INET_ADDRSTRLEN];
+      uint8_t frame[ARP_FRAME_LEN];
+      struct sockaddr_ll addr;
+      struct in_addr dst4;
+      gint64 start;
+
+      /* Queue a prebuilt frame on the AF_PACKET socket, sent in batches like
+       * the other pings. */
+      dst4.s_addr = dst6_p->s6_addr32[3];
+      if (scanner->arp_template)
+        {
+          arp_build_request_v4 (scanner->arp_template, dst4, frame, &addr);
+          if (send_times)
+            addr_set_set_time (send_times, dst6_p, g_get_monotonic_time ());
+          send_batch_add (ARPV4, scanner->arpv4soc, frame, sizeof (frame),
+                          &addr, sizeof (addr));
+          return;
+        }
 
       /* Need to transform the IPv6 mapped IPv4 address back to an IPv4 string.
        * We can not just use the host_value_str as it might be an IPv4 mapped
@@ -595,6 +1367,15 @@ send_arp (gpointer host_value_str, gpointer value, gpointer scanner_p)
           g_warning ("%s: Error: %s. Skipping ARP ping for '%s'", __func__,
                      strerror (errno), (char *) host_value_str);
         }
+      start = g_get_monotonic_time ();
+      pacer_wait (send_pacer (), NULL, ARP_FRAME_LEN);
+      alive_stats_count_throttle (g_get_monotonic_time () - start);
+      /* send_arp_v4 uses the global libnet context. */
+      g_mutex_lock (&arp_mutex);
       send_arp_v4 (ipv4_str);
+      g_mutex_unlock (&arp_mutex);
+      alive_stats_count_sent (1, 0);
+      if (send_times)
+        addr_set_set_time (send_times, dst6_p, g_get_monotonic_time ());
     }
 }
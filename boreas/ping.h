@@ -6,6 +6,8 @@
 #ifndef BOREAS_PING_H
 #define BOREAS_PING_H
 
+#include "alivedetection.h"
+
 #include <glib.h>
 
 void send_icmp (gpointer, gpointer, gpointer);
@@ -14,4 +16,29 @@ void send_tcp (gpointer, gpointer, gpointer);
 
 void send_arp (gpointer, gpointer, gpointer);
 
+void
+send_ndp_all_nodes (scanner_t *);
+
+void
+send_record_times (addr_set_t *);
+
+/* Pools of sender threads. */
+
+typedef struct send_pool send_pool_t;
+
+send_pool_t *
+send_pool_new (scanner_t *, alive_test_t);
+
+void
+send_pool_free (send_pool_t *);
+
+guint
+send_pool_size (const send_pool_t *);
+
+void
+send_pool_run (send_pool_t *, GHFunc, guint, guint);
+
+void
+send_pool_drain (send_pool_t *, alive_test_t);
+
 #endif /* not BOREAS_PING_H */
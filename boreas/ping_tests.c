@@ -21,6 +21,120 @@ Ensure (ping, dummy_test)
   assert_that (0, is_equal_to (0));
 }
 
+static void
+count_target (gpointer key, gpointer value, gpointer scanner_p)
+{
+  (void) key;
+  (void) scanner_p;
+  g_atomic_int_inc ((gint *) value);
+}
+
+Ensure (ping, send_pool_visits_every_target_once)
+{
+  scanner_t scanner;
+  hosts_data_t hosts_data;
+  send_pool_t *pool;
+  gint counts[1000];
+
+  memset (&scanner, 0, sizeof (scanner));
+  memset (counts, 0, sizeof (counts));
+  hosts_data.targethosts =
+    g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  for (int i = 0; i < 1000; i++)
+    g_hash_table_insert (hosts_data.targethosts, g_strdup_printf ("%d", i),
+                         &counts[i]);
+  scanner.hosts_data = &hosts_data;
+
+  prefs_set ("alive_test_send_threads", "4");
+  pool = send_pool_new (&scanner, 0);
+  assert_that (send_pool_size (pool), is_equal_to (1000));
+  send_pool_run (pool, count_target, 0, 300);
+  send_pool_run (pool, count_target, 300, 2000);
+  for (int i = 0; i < 1000; i++)
+    assert_that (counts[i], is_equal_to (1));
+  send_pool_free (pool);
+
+  prefs_set ("alive_test_send_threads", "1");
+  pool = send_pool_new (&scanner, 0);
+  send_pool_run (pool, count_target, 0, 1000);
+  for (int i = 0; i < 1000; i++)
+    assert_that (counts[i], is_equal_to (2));
+  send_pool_free (pool);
+
+  g_hash_table_destroy (hosts_data.targethosts);
+}
+
+static struct sockaddr_in partial_batch_dst;
+
+static void
+queue_udp (gpointer key, gpointer value, gpointer scanner_p)
+{
+  scanner_t *scanner = scanner_p;
+
+  (void) value;
+  send_batch_add (UDPV4, scanner->udpv4soc, key, strlen (key) + 1,
+                  &partial_batch_dst, sizeof (partial_batch_dst));
+}
+
+static int
+count_received (int soc)
+{
+  char buf[16];
+  int count = 0;
+
+  while (recv (soc, buf, sizeof (buf), MSG_DONTWAIT) > 0)
+    count++;
+  return count;
+}
+
+Ensure (ping, send_pool_sends_partial_batch)
+{
+  scanner_t scanner;
+  hosts_data_t hosts_data;
+  send_pool_t *pool;
+  socklen_t len = sizeof (partial_batch_dst);
+  int soc;
+
+  memset (&scanner, 0, sizeof (scanner));
+  memset (&partial_batch_dst, 0, sizeof (partial_batch_dst));
+  partial_batch_dst.sin_family = AF_INET;
+  partial_batch_dst.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+  soc = socket (AF_INET, SOCK_DGRAM, 0);
+  assert_that (soc, is_not_equal_to (-1));
+  assert_that (bind (soc, (struct sockaddr *) &partial_batch_dst, len),
+               is_equal_to (0));
+  assert_that (
+    getsockname (soc, (struct sockaddr *) &partial_batch_dst, &len),
+    is_equal_to (0));
+  scanner.udpv4soc = socket (AF_INET, SOCK_DGRAM, 0);
+  assert_that (scanner.udpv4soc, is_not_equal_to (-1));
+
+  hosts_data.targethosts =
+    g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  for (int i = 0; i < 3; i++)
+    g_hash_table_insert (hosts_data.targethosts, g_strdup_printf ("%d", i),
+                         NULL);
+  scanner.hosts_data = &hosts_data;
+
+  /* Fewer packets than a batch are sent at the end of the targets. */
+  prefs_set ("alive_test_send_threads", "1");
+  pool = send_pool_new (&scanner, 0);
+  assert_that (send_batch_size (), is_greater_than (3));
+  send_pool_run (pool, queue_udp, 0, G_MAXUINT);
+  g_usleep (10000);
+  assert_that (count_received (soc), is_equal_to (3));
+
+  /* Packets queued out of a run are sent when the pool is freed. */
+  queue_udp ("x", NULL, &scanner);
+  send_pool_free (pool);
+  g_usleep (10000);
+  assert_that (count_received (soc), is_equal_to (1));
+
+  g_hash_table_destroy (hosts_data.targethosts);
+  close (scanner.udpv4soc);
+  close (soc);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -29,6 +143,8 @@ main (int argc, char **argv)
   suite = create_test_suite ();
 
   add_test_with_context (suite, ping, dummy_test);
+  add_test_with_context (suite, ping, send_pool_visits_every_target_once);
+  add_test_with_context (suite, ping, send_pool_sends_partial_batch);
 
   if (argc > 1)
     return run_single_test (suite, argv[1], create_text_reporter ());
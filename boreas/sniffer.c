@@ -5,16 +5,26 @@
 
 #include "sniffer.h"
 
+#include "../base/prefs.h"  /* for prefs_get() */
+#include "../base/probes.h" /* for GVM_PROBE1 */
 #include "alivedetection.h"
 #include "boreas_io.h"
+#include "util.h" /* for addr_set_contains(), rtt_estimator_add() */
 
 #include <arpa/inet.h>
 #include <errno.h>
 #include <glib.h>
+#include <linux/filter.h>    /* for sock_fprog, SKF_AD_OFF */
+#include <linux/if_ether.h>  /* for ETH_P_ALL */
+#include <linux/if_packet.h> /* for tpacket_req3, TPACKET_V3 */
 #include <net/if_arp.h>
+#include <netinet/icmp6.h> /* for ND_NEIGHBOR_ADVERT */
 #include <netinet/ip.h>
+#include <poll.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
 #include <unistd.h>
 
 #undef G_LOG_DOMAIN
@@ -30,11 +40,56 @@
   "(ip6 or ip or arp) and (ip6[40]=129 or icmp[icmptype] == icmp-echoreply " \
   "or dst port " ASSTR (FILTER_PORT) " or arp[6:2]=2)"
 
+/* Maximum number of IPv4 networks the capture filter accepts replies from. */
+#define FILTER_MAX_NETS 32
+
+/**
+ * @brief IPv4 network of the capture filter.
+ */
+struct filter_net
+{
+  uint32_t base; /**< First address, in host byte order. */
+  int bits;      /**< Number of host bits, 32 minus the prefix length. */
+};
+
 /* Conditional variable and mutex to make sure sniffer thread already started
  * before sending out pings. */
 pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
 pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
 
+/* Size of the blocks of a capture ring. */
+#define RING_BLOCK_SIZE (1 << 18)
+/* Number of blocks of a capture ring. */
+#define RING_BLOCK_NR 16
+/* Frame size of a capture ring, only used for the ring geometry. */
+#define RING_FRAME_SIZE 2048
+/* Maximum number of capture threads to fan the replies out to. */
+#define RING_MAX_THREADS 16
+/* Length of the Linux cooked capture header the filter is compiled for. */
+#define SLL_HDR_LEN 16
+
+/**
+ * @brief Capture ring of an AF_PACKET socket, using TPACKET_V3.
+ */
+struct capture_ring
+{
+  int soc;           /**< AF_PACKET socket. */
+  u_char *map;       /**< Mapped ring. */
+  size_t map_len;    /**< Size of the mapped ring. */
+  pthread_t thread;  /**< Thread processing the ring. */
+  scanner_t *scanner; /**< Scanner the replies are for. */
+};
+
+/* Capture rings, none if pcap is used. */
+static struct capture_ring rings[RING_MAX_THREADS];
+static int rings_count = 0;
+/* Set to stop the ring threads. */
+static volatile gint rings_stop = 0;
+/* Serializes the reply handling of several ring threads. */
+static GMutex reply_mutex;
+/* Counters of the last capture. */
+static sniffer_stats_t sniffer_stats;
+
 /**
  * @brief open a new pcap handle ad set provided filter.
  *
@@ -99,87 +154,582 @@ open_live (char *iface, char *filter)
 }
 
 /**
- * @brief Processes single packets captured by pcap. Is a callback function.
+ * @brief Cover sorted IPv4 addresses with as few networks as possible.
+ *
+ * The addresses are first truncated to their network of shift host bits,
+ * then adjacent networks are merged like in a route aggregation.
+ *
+ * @param[in]  addrs  Addresses in host byte order, sorted ascending.
+ * @param[in]  count  Number of addresses.
+ * @param[in]  shift  Host bits of the networks, 0 for single addresses.
+ * @param[out] nets   Networks, room for count networks.
+ *
+ * @return Number of networks.
+ */
+static guint
+aggregate_nets (const uint32_t *addrs, guint count, int shift,
+                struct filter_net *nets)
+{
+  guint top = 0;
+
+  for (guint i = 0; i < count; i++)
+    {
+      uint32_t base = shift ? addrs[i] >> shift << shift : addrs[i];
+
+      if (top && nets[top - 1].base == base)
+        continue;
+      nets[top].base = base;
+      nets[top].bits = shift;
+      top++;
+      /* Merge the two last networks while they are the halves of one. */
+      while (top >= 2 && nets[top - 1].bits == nets[top - 2].bits
+             && nets[top - 2].bits < 31
+             && !(nets[top - 2].base & (1u << nets[top - 2].bits))
+             && nets[top - 1].base
+                  == nets[top - 2].base + (1u << nets[top - 2].bits))
+        {
+          nets[top - 2].bits++;
+          top--;
+        }
+    }
+  return top;
+}
+
+/**
+ * @brief Compare two IPv4 addresses, for sorting.
+ *
+ * @param a First address.
+ * @param b Second address.
+ *
+ * @return Negative, 0 or positive like strcmp.
+ */
+static gint
+compare_addrs (gconstpointer a, gconstpointer b)
+{
+  uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+
+  return x < y ? -1 : x > y;
+}
+
+/**
+ * @brief Build a capture filter for the replies to the alive tests.
+ *
+ * Only the reply types of the selected methods are accepted, and IPv4 replies
+ * only from the networks of the targets. If the targets need more than
+ * FILTER_MAX_NETS networks, the networks are widened until they fit.
+ *
+ * @param addrs       IPv4 targets in host byte order, sorted ascending.
+ * @param count       Number of IPv4 targets.
+ * @param ipv6        Whether there are IPv6 targets.
+ * @param alive_test  Alive test methods, 0 for all.
+ * @param ndp         Whether the ARP test sends all-nodes echo requests.
+ *
+ * @return Filter, to be freed with g_free.
+ */
+static gchar *
+build_filter_str (const uint32_t *addrs, guint count, gboolean ipv6,
+                  alive_test_t alive_test, gboolean ndp)
+{
+  GString *filter = g_string_new ("");
+  GPtrArray *v4 = g_ptr_array_new (), *v6 = g_ptr_array_new ();
+  struct filter_net *nets;
+  guint number = 0;
+
+  alive_test &= ALIVE_TEST_ICMP | ALIVE_TEST_TCP_SYN_SERVICE
+                | ALIVE_TEST_TCP_ACK_SERVICE | ALIVE_TEST_ARP;
+  if (!alive_test)
+    alive_test = ALIVE_TEST_ICMP | ALIVE_TEST_TCP_SYN_SERVICE | ALIVE_TEST_ARP;
+  if (alive_test & ALIVE_TEST_ICMP)
+    {
+      g_ptr_array_add (v4, "icmp[icmptype] == icmp-echoreply");
+      g_ptr_array_add (v6, "ip6[40] == 129");
+    }
+  if (alive_test & (ALIVE_TEST_TCP_SYN_SERVICE | ALIVE_TEST_TCP_ACK_SERVICE))
+    {
+      g_ptr_array_add (v4, "dst port " ASSTR (FILTER_PORT));
+      g_ptr_array_add (v6, "dst port " ASSTR (FILTER_PORT));
+    }
+  if (alive_test & ALIVE_TEST_ARP)
+    {
+      g_ptr_array_add (v4, "arp[6:2] == 2");
+      /* Neighbor advertisements. */
+      g_ptr_array_add (v6, "ip6[40] == 136");
+      /* Replies to the all-nodes echo requests. */
+      if (ndp && !(alive_test & ALIVE_TEST_ICMP))
+        g_ptr_array_add (v6, "ip6[40] == 129");
+    }
+
+  /* Networks of the IPv4 targets, none if they do not fit. */
+  nets = g_malloc_n (MAX (count, 1), sizeof (*nets));
+  for (int shift = 0; count && shift < 32; shift++)
+    if ((number = aggregate_nets (addrs, count, shift, nets))
+        <= FILTER_MAX_NETS)
+      break;
+  if (number > FILTER_MAX_NETS)
+    number = 0;
+
+  if (count)
+    {
+      g_string_append (filter, "((ip or arp) and ");
+      if (number)
+        {
+          g_string_append (filter, "(");
+          for (guint i = 0; i < number; i++)
+            {
+              uint32_t base = htonl (nets[i].base);
+              char str[INET_ADDRSTRLEN];
+
+              inet_ntop (AF_INET, &base, str, sizeof (str));
+              g_string_append_printf (filter, "%ssrc net %s/%d",
+                                      i ? " or " : "", str,
+                                      32 - nets[i].bits);
+            }
+          g_string_append (filter, ") and ");
+        }
+      g_string_append (filter, "(");
+      for (guint i = 0; i < v4->len; i++)
+        g_string_append_printf (filter, "%s%s", i ? " or " : "",
+                                (char *) g_ptr_array_index (v4, i));
+      g_string_append (filter, "))");
+    }
+  if (ipv6)
+    {
+      g_string_append_printf (filter, "%s(ip6 and (", count ? " or " : "");
+      for (guint i = 0; i < v6->len; i++)
+        g_string_append_printf (filter, "%s%s", i ? " or " : "",
+                                (char *) g_ptr_array_index (v6, i));
+      g_string_append (filter, "))");
+    }
+
+  g_free (nets);
+  g_ptr_array_free (v4, TRUE);
+  g_ptr_array_free (v6, TRUE);
+  return g_string_free (filter, FALSE);
+}
+
+/**
+ * @brief Build the capture filter for the targets of a scanner.
+ *
+ * Falls back to the generic FILTER_STR if there are no targets or the filter
+ * does not compile.
+ *
+ * @param scanner     Pointer to scanner struct.
+ * @param alive_test  Alive test methods.
+ *
+ * @return Filter, to be freed with g_free.
+ */
+static gchar *
+build_filter (scanner_t *scanner, alive_test_t alive_test)
+{
+  GHashTableIter iter;
+  gpointer key, value;
+  GArray *addrs;
+  gboolean ipv6 = FALSE;
+  struct bpf_program prog;
+  pcap_t *dead;
+  gchar *filter = NULL;
+
+  addrs = g_array_new (FALSE, FALSE, sizeof (uint32_t));
+  g_hash_table_iter_init (&iter, scanner->hosts_data->targethosts);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      struct in6_addr addr6;
+
+      if (gvm_host_get_addr6 ((gvm_host_t *) value, &addr6) < 0)
+        continue;
+      if (IN6_IS_ADDR_V4MAPPED (&addr6))
+        {
+          uint32_t addr = ntohl (addr6.s6_addr32[3]);
+
+          g_array_append_val (addrs, addr);
+        }
+      else
+        ipv6 = TRUE;
+    }
+  g_array_sort (addrs, compare_addrs);
+
+  if (addrs->len || ipv6)
+    filter = build_filter_str ((uint32_t *) addrs->data, addrs->len, ipv6,
+                               alive_test, scanner->ndp_links != NULL);
+  g_array_free (addrs, TRUE);
+
+  dead = pcap_open_dead (DLT_LINUX_SLL, 1500);
+  if (filter && dead)
+    {
+      if (pcap_compile (dead, &prog, filter, 1, PCAP_NETMASK_UNKNOWN) < 0)
+        {
+          g_debug ("%s: %s: %s", __func__, filter, pcap_geterr (dead));
+          g_free (filter);
+          filter = NULL;
+        }
+      else
+        pcap_freecode (&prog);
+    }
+  if (dead)
+    pcap_close (dead);
+  if (!filter)
+    filter = g_strdup (FILTER_STR);
+  g_debug ("%s: Capture filter: %s", __func__, filter);
+  return filter;
+}
+
+/**
+ * @brief Processes a single captured reply.
  *
  * For every packet we check if it is ipv4 ipv6 or arp and extract the sender ip
  * address. This ip address is then inserted into the alive_hosts table if not
  * already present and if in the target table.
  *
- * @param user_data Pointer to scanner.
- * @param header
- * @param packet  Packet to process.
+ * @param scanner Pointer to scanner.
+ * @param packet  Packet to process, starting at the network header.
+ * @param len     Captured length of the packet.
  *
  * TODO: simplify and read https://tools.ietf.org/html/rfc826
  */
 static void
-got_packet (u_char *user_data,
-            __attribute__ ((unused)) const struct pcap_pkthdr *header,
-            const u_char *packet)
+handle_reply (scanner_t *scanner, const u_char *packet, size_t len)
 {
   struct ip *ip;
   unsigned int version;
-  scanner_t *scanner;
   hosts_data_t *hosts_data;
-  gchar *addr_str = NULL;
+  struct in6_addr sniffed_addr;
+  gchar addr_str[INET6_ADDRSTRLEN];
+  gboolean from_target;
+
+  GVM_PROBE1 (got_packet, len);
+  if (len < 24)
+    return;
 
-  ip = (struct ip *) (packet + 16);
+  ip = (struct ip *) packet;
   version = ip->ip_v;
-  scanner = (scanner_t *) user_data;
   hosts_data = (hosts_data_t *) scanner->hosts_data;
 
+  /* IPv4 addresses are kept as IPv4-mapped IPv6 addresses, like in the
+   * target set. */
+  memset (&sniffed_addr, 0, sizeof (sniffed_addr));
   if (version == 4)
     {
-      addr_str = g_malloc0 (INET_ADDRSTRLEN);
-      struct in_addr sniffed_addr;
-      /* was +26 (14 ETH + 12 IP) originally but was off by 2 somehow */
-      memcpy (&sniffed_addr.s_addr, packet + 26 + 2, 4);
-      if (inet_ntop (AF_INET, (const char *) &sniffed_addr, addr_str,
-                     INET_ADDRSTRLEN)
-          == NULL)
-        g_debug (
-          "%s: Failed to transform IPv4 address into string representation: %s",
-          __func__, strerror (errno));
+      /* Source address of the IP header. */
+      sniffed_addr.s6_addr[10] = sniffed_addr.s6_addr[11] = 0xff;
+      memcpy (sniffed_addr.s6_addr + 12, packet + 12, 4);
     }
   else if (version == 6)
     {
-      addr_str = g_malloc0 (INET6_ADDRSTRLEN);
-      struct in6_addr sniffed_addr;
-      /* (14 ETH + 8 IP + offset 2)  */
-      memcpy (&sniffed_addr.s6_addr, packet + 24, 16);
-      if (inet_ntop (AF_INET6, (const char *) &sniffed_addr, addr_str,
-                     INET6_ADDRSTRLEN)
-          == NULL)
-        g_debug ("%s: Failed to transform IPv6 into string representation: %s",
-                 __func__, strerror (errno));
+      /* Source address of the IPv6 header. Neighbor advertisements name
+       * the target address, which is not always their source address. */
+      if (packet[6] == IPPROTO_ICMPV6 && len >= 64
+          && packet[40] == ND_NEIGHBOR_ADVERT)
+        memcpy (&sniffed_addr.s6_addr, packet + 48, 16);
+      else
+        memcpy (&sniffed_addr.s6_addr, packet + 8, 16);
     }
   /* TODO: check collision situations.
    * everything not ipv4/6 is regarded as arp.
    * It may be possible to get other types then arp replies in which case the
-   * ip from inet_ntop should be bogus. */
+   * ip should be bogus. */
   else
     {
       /* TODO: at the moment offset of 6 is set but arp header has variable
        * sized field. */
       /* read rfc https://tools.ietf.org/html/rfc826 for exact length or how
       to get it */
-      struct arphdr *arp =
-        (struct arphdr *) (packet + 14 + 2 + 6 + sizeof (struct arphdr));
-      addr_str = g_malloc0 (INET_ADDRSTRLEN);
-      if (inet_ntop (AF_INET, (const char *) arp, addr_str, INET_ADDRSTRLEN)
-          == NULL)
-        g_debug ("%s: Failed to transform IP into string representation: %s",
-                 __func__, strerror (errno));
-    }
-  /* Only put unique hosts on queue and in hash table. Use short circuit
-   * evaluation to not add hosts to the hash table which are not in our
-   * target list.*/
-  if ((g_hash_table_contains (hosts_data->targethosts, addr_str) == TRUE)
-      && (g_hash_table_add (hosts_data->alivehosts, g_strdup (addr_str))))
-    {
-      /* handle max_scan_hosts related restrictions. */
-      handle_scan_restrictions (scanner, addr_str);
-    }
-  g_free (addr_str);
+      sniffed_addr.s6_addr[10] = sniffed_addr.s6_addr[11] = 0xff;
+      memcpy (sniffed_addr.s6_addr + 12, packet + 6 + sizeof (struct arphdr),
+              4);
+    }
+
+  /* Only put unique hosts on queue and in hash table. Replies of hosts which
+   * are not in our target list or already alive are dropped without any
+   * allocation, only new alive hosts are turned into strings. */
+  if (rings_count > 1)
+    g_mutex_lock (&reply_mutex);
+  from_target = addr_set_contains (hosts_data->targets_set, &sniffed_addr);
+  alive_stats_count_reply (from_target);
+  if (from_target && addr_set_add (hosts_data->alive_set, &sniffed_addr))
+    {
+      /* The first reply of a host is a round trip time sample. */
+      if (scanner->rtt)
+        {
+          gint64 now = g_get_monotonic_time ();
+          gint64 sent = addr_set_get_time (hosts_data->targets_set,
+                                           &sniffed_addr);
+
+          if (sent)
+            rtt_estimator_add (scanner->rtt, now - sent, now);
+        }
+      if (IN6_IS_ADDR_V4MAPPED (&sniffed_addr))
+        inet_ntop (AF_INET, sniffed_addr.s6_addr + 12, addr_str,
+                   sizeof (addr_str));
+      else
+        inet_ntop (AF_INET6, &sniffed_addr, addr_str, sizeof (addr_str));
+      /* Hosts considered alive may already be in alivehosts. */
+      if (g_hash_table_add (hosts_data->alivehosts, g_strdup (addr_str)))
+        /* handle max_scan_hosts related restrictions. */
+        handle_scan_restrictions (scanner, addr_str);
+    }
+  if (rings_count > 1)
+    g_mutex_unlock (&reply_mutex);
+}
+
+/**
+ * @brief Processes single packets captured by pcap. Is a callback function.
+ *
+ * @param user_data Pointer to scanner.
+ * @param header    Header with the captured length.
+ * @param packet    Packet to process, with a Linux cooked capture header.
+ */
+static void
+got_packet (u_char *user_data, const struct pcap_pkthdr *header,
+            const u_char *packet)
+{
+  if (header->caplen < SLL_HDR_LEN)
+    return;
+  handle_reply ((scanner_t *) user_data, packet + SLL_HDR_LEN,
+                header->caplen - SLL_HDR_LEN);
+}
+
+/**
+ * @brief Adapts a BPF program compiled for Linux cooked captures to a
+ * SOCK_DGRAM packet socket, where packets start at the network header.
+ *
+ * Loads from the cooked header are mapped to the ancillary data of the
+ * kernel, as libpcap does for its "any" device.
+ *
+ * @param prog  BPF program.
+ *
+ * @return 0 on success, -1 if the program loads unsupported header fields.
+ */
+static int
+fix_filter_offsets (struct bpf_program *prog)
+{
+  for (unsigned int i = 0; i < prog->bf_len; i++)
+    {
+      struct bpf_insn *insn = &prog->bf_insns[i];
+      int class = BPF_CLASS (insn->code), mode = BPF_MODE (insn->code);
+
+      if ((class != BPF_LD && class != BPF_LDX)
+          || (mode != BPF_ABS && mode != BPF_IND && mode != BPF_MSH))
+        continue;
+      if (insn->k >= SLL_HDR_LEN)
+        insn->k -= SLL_HDR_LEN;
+      else if (insn->k == 0 && mode == BPF_ABS)
+        insn->k = SKF_AD_OFF + SKF_AD_PKTTYPE;
+      else if (insn->k == 14 && mode == BPF_ABS)
+        insn->k = SKF_AD_OFF + SKF_AD_PROTOCOL;
+      else
+        return -1;
+    }
+  return 0;
+}
+
+/**
+ * @brief Processes the captured packets of a ring until stopped.
+ *
+ * The kernel hands over whole blocks of packets, which are processed at once
+ * and returned.
+ *
+ * @param ring_p Pointer to the capture ring.
+ */
+static void *
+ring_thread (void *ring_p)
+{
+  struct capture_ring *ring = ring_p;
+  unsigned int block = 0;
+
+  while (!g_atomic_int_get (&rings_stop))
+    {
+      struct tpacket_block_desc *desc =
+        (struct tpacket_block_desc *) (ring->map + block * RING_BLOCK_SIZE);
+      struct tpacket3_hdr *hdr;
+
+      if (!(desc->hdr.bh1.block_status & TP_STATUS_USER))
+        {
+          struct pollfd pfd = {.fd = ring->soc, .events = POLLIN | POLLERR};
+
+          poll (&pfd, 1, 100);
+          continue;
+        }
+
+      hdr = (struct tpacket3_hdr *) ((u_char *) desc
+                                     + desc->hdr.bh1.offset_to_first_pkt);
+      for (unsigned int i = 0; i < desc->hdr.bh1.num_pkts; i++)
+        {
+          handle_reply (ring->scanner, (u_char *) hdr + hdr->tp_net,
+                        hdr->tp_snaplen);
+          hdr = (struct tpacket3_hdr *) ((u_char *) hdr + hdr->tp_next_offset);
+        }
+
+      __sync_synchronize ();
+      desc->hdr.bh1.block_status = TP_STATUS_KERNEL;
+      block = (block + 1) % RING_BLOCK_NR;
+    }
+  return NULL;
+}
+
+/**
+ * @brief Open a capture ring on all interfaces.
+ *
+ * @param ring    Ring to set up.
+ * @param filter  Filter to attach, adapted by fix_filter_offsets.
+ * @param fanout  Fanout group id, -1 for no fanout.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+open_ring (struct capture_ring *ring, struct sock_fprog *filter, int fanout)
+{
+  struct tpacket_req3 req;
+  struct sockaddr_ll addr;
+  int version = TPACKET_V3;
+
+  /* No protocol until bound, so that nothing is captured unfiltered. */
+  ring->soc = socket (AF_PACKET, SOCK_DGRAM, 0);
+  if (ring->soc < 0)
+    {
+      g_debug ("%s: socket(): %s", __func__, strerror (errno));
+      return -1;
+    }
+
+  memset (&req, 0, sizeof (req));
+  req.tp_block_size = RING_BLOCK_SIZE;
+  req.tp_block_nr = RING_BLOCK_NR;
+  req.tp_frame_size = RING_FRAME_SIZE;
+  req.tp_frame_nr = RING_BLOCK_SIZE / RING_FRAME_SIZE * RING_BLOCK_NR;
+  /* Hand over partially filled blocks after 50 ms. */
+  req.tp_retire_blk_tov = 50;
+  if (setsockopt (ring->soc, SOL_PACKET, PACKET_VERSION, &version,
+                  sizeof (version))
+        < 0
+      || setsockopt (ring->soc, SOL_PACKET, PACKET_RX_RING, &req, sizeof (req))
+           < 0
+      || setsockopt (ring->soc, SOL_SOCKET, SO_ATTACH_FILTER, filter,
+                     sizeof (*filter))
+           < 0)
+    {
+      g_debug ("%s: setsockopt(): %s", __func__, strerror (errno));
+      close (ring->soc);
+      return -1;
+    }
+
+  ring->map_len = (size_t) RING_BLOCK_SIZE * RING_BLOCK_NR;
+  ring->map = mmap (NULL, ring->map_len, PROT_READ | PROT_WRITE, MAP_SHARED,
+                    ring->soc, 0);
+  if (ring->map == MAP_FAILED)
+    {
+      g_debug ("%s: mmap(): %s", __func__, strerror (errno));
+      close (ring->soc);
+      return -1;
+    }
+
+  memset (&addr, 0, sizeof (addr));
+  addr.sll_family = AF_PACKET;
+  addr.sll_protocol = htons (ETH_P_ALL);
+  addr.sll_ifindex = 0;
+  if (bind (ring->soc, (struct sockaddr *) &addr, sizeof (addr)) < 0)
+    {
+      g_debug ("%s: bind(): %s", __func__, strerror (errno));
+      munmap (ring->map, ring->map_len);
+      close (ring->soc);
+      return -1;
+    }
+
+  if (fanout >= 0)
+    {
+      int arg = fanout | (PACKET_FANOUT_HASH << 16);
+
+      if (setsockopt (ring->soc, SOL_PACKET, PACKET_FANOUT, &arg, sizeof (arg))
+          < 0)
+        {
+          g_debug ("%s: PACKET_FANOUT: %s", __func__, strerror (errno));
+          munmap (ring->map, ring->map_len);
+          close (ring->soc);
+          return -1;
+        }
+    }
+  return 0;
+}
+
+/**
+ * @brief Close a capture ring, adding its counters to the sniffer stats.
+ *
+ * @param ring Ring.
+ */
+static void
+close_ring (struct capture_ring *ring)
+{
+  struct tpacket_stats_v3 stats;
+  socklen_t len = sizeof (stats);
+
+  if (getsockopt (ring->soc, SOL_PACKET, PACKET_STATISTICS, &stats, &len)
+      == 0)
+    {
+      sniffer_stats.received += stats.tp_packets;
+      sniffer_stats.dropped += stats.tp_drops;
+    }
+  munmap (ring->map, ring->map_len);
+  close (ring->soc);
+}
+
+/**
+ * @brief Open the capture rings, optionally fanning out to several threads.
+ *
+ * The number of threads comes from the "alive_test_capture_threads"
+ * preference, 1 by default.
+ *
+ * @param scanner     Pointer to scanner struct.
+ * @param filter_str  Capture filter.
+ *
+ * @return Number of rings opened, 0 on error.
+ */
+static int
+open_rings (scanner_t *scanner, const char *filter_str)
+{
+  struct bpf_program prog;
+  struct sock_fprog filter;
+  pcap_t *dead;
+  const char *tmp;
+  int threads, fanout;
+
+  threads = (tmp = prefs_get ("alive_test_capture_threads")) != NULL
+              ? atoi (tmp)
+              : 1;
+  threads = CLAMP (threads, 1, RING_MAX_THREADS);
+
+  dead = pcap_open_dead (DLT_LINUX_SLL, 1500);
+  if (dead == NULL)
+    return 0;
+  if (pcap_compile (dead, &prog, filter_str, 1, PCAP_NETMASK_UNKNOWN) < 0)
+    {
+      g_warning ("%s: %s", __func__, pcap_geterr (dead));
+      pcap_close (dead);
+      return 0;
+    }
+  pcap_close (dead);
+  if (fix_filter_offsets (&prog) < 0)
+    {
+      g_debug ("%s: Filter not supported on packet sockets", __func__);
+      pcap_freecode (&prog);
+      return 0;
+    }
+  filter.len = prog.bf_len;
+  filter.filter = (struct sock_filter *) prog.bf_insns;
+
+  fanout = threads > 1 ? (getpid () & 0xffff) : -1;
+  for (rings_count = 0; rings_count < threads; rings_count++)
+    {
+      rings[rings_count].scanner = scanner;
+      if (open_ring (&rings[rings_count], &filter, fanout) < 0)
+        break;
+    }
+  pcap_freecode (&prog);
+
+  if (rings_count < threads)
+    {
+      while (rings_count > 0)
+        close_ring (&rings[--rings_count]);
+      return 0;
+    }
+  return rings_count;
 }
 
 /**
@@ -197,6 +747,12 @@ sniffer_thread (void *scanner_p)
   pthread_cond_signal (&cond);
   pthread_mutex_unlock (&mutex);
 
+  if (rings_count)
+    {
+      ring_thread (&rings[0]);
+      pthread_exit (0);
+    }
+
   /* reads packets until error or pcap_breakloop() */
   if ((ret =
          pcap_loop (scanner->pcap_handle, -1, got_packet, (u_char *) scanner))
@@ -233,7 +789,10 @@ stop_sniffer_thread (scanner_t *scanner, pthread_t sniffer_thread_id)
   g_debug ("%s: Try to stop thread which is sniffing for alive hosts. ",
            __func__);
   /* Try to break loop in sniffer thread. */
-  pcap_breakloop (scanner->pcap_handle);
+  if (rings_count)
+    g_atomic_int_set (&rings_stop, 1);
+  else
+    pcap_breakloop (scanner->pcap_handle);
   /* Give thread chance to exit on its own. */
   for (waited = 0;
        waited < max_grace && pthread_kill (sniffer_thread_id, 0) != ESRCH;
@@ -261,11 +820,30 @@ stop_sniffer_thread (scanner_t *scanner, pthread_t sniffer_thread_id)
 
   g_debug ("%s: Stopped thread which was sniffing for alive hosts.", __func__);
 
+  /* Join the other ring threads and close the rings. */
+  for (int i = 1; i < rings_count; i++)
+    pthread_join (rings[i].thread, NULL);
+  for (int i = 0; i < rings_count; i++)
+    close_ring (&rings[i]);
+  rings_count = 0;
+  g_atomic_int_set (&rings_stop, 0);
+
   /* close handle */
   if (scanner->pcap_handle != NULL)
     {
+      struct pcap_stat stats;
+
+      if (pcap_stats (scanner->pcap_handle, &stats) == 0)
+        {
+          sniffer_stats.received += stats.ps_recv;
+          sniffer_stats.dropped += stats.ps_drop;
+        }
       pcap_close (scanner->pcap_handle);
+      scanner->pcap_handle = NULL;
     }
+  g_debug ("%s: Received %" G_GUINT64_FORMAT " packets, dropped %"
+           G_GUINT64_FORMAT,
+           __func__, sniffer_stats.received, sniffer_stats.dropped);
 
   return err;
 }
@@ -274,21 +852,52 @@ stop_sniffer_thread (scanner_t *scanner, pthread_t sniffer_thread_id)
  * @brief Start up the sniffer thread.
  *
  * @param scanner Pointer to scanner struct.
+ * @param alive_test Alive test methods the replies are captured for.
  * @param sniffer_thread_id pthread_t thread id.
  *
  * @return 0 on success, other on Error.
  */
 int
-start_sniffer_thread (scanner_t *scanner, pthread_t *sniffer_thread_id)
+start_sniffer_thread (scanner_t *scanner, alive_test_t alive_test,
+                      pthread_t *sniffer_thread_id)
 {
+  const char *capture = prefs_get ("alive_test_capture");
+  thread_cpus_t *saved_cpus = NULL;
+  gchar *filter;
   int err;
 
-  scanner->pcap_handle = open_live (NULL, FILTER_STR);
-  if (scanner->pcap_handle == NULL)
+  memset (&sniffer_stats, 0, sizeof (sniffer_stats));
+
+  /* The capture threads inherit the CPUs, and the capture rings are
+   * allocated on their node. */
+  if (scanner->sniffer_cpus && (saved_cpus = thread_cpus_get ()) != NULL)
+    thread_cpus_apply (scanner->sniffer_cpus);
+
+  /* Only let the replies to the probes pass the kernel. */
+  filter = build_filter (scanner, alive_test);
+
+  /* Use capture rings unless pcap is asked for, falling back to pcap. */
+  if (g_strcmp0 (capture, "pcap") && open_rings (scanner, filter))
     {
-      g_warning ("%s: Unable to open valid pcap handle.", __func__);
-      return -1;
+      g_debug ("%s: Capturing with %d TPACKET_V3 ring(s)", __func__,
+               rings_count);
+      for (int i = 1; i < rings_count; i++)
+        if (pthread_create (&rings[i].thread, NULL, ring_thread, &rings[i]))
+          g_warning ("%s: pthread_create() failed for ring %d.", __func__, i);
+    }
+  else
+    {
+      scanner->pcap_handle = open_live (NULL, filter);
+      if (scanner->pcap_handle == NULL)
+        {
+          g_warning ("%s: Unable to open valid pcap handle.", __func__);
+          g_free (filter);
+          thread_cpus_apply (saved_cpus);
+          thread_cpus_free (saved_cpus);
+          return -1;
+        }
     }
+  g_free (filter);
 
   /* Start sniffer thread. */
   pthread_mutex_lock (&mutex);
@@ -305,5 +914,20 @@ start_sniffer_thread (scanner_t *scanner, pthread_t *sniffer_thread_id)
   pthread_mutex_destroy (&mutex);
   pthread_cond_destroy (&cond);
 
+  thread_cpus_apply (saved_cpus);
+  thread_cpus_free (saved_cpus);
   return err;
 }
+
+/**
+ * @brief Get the counters of the last capture, final once the sniffer thread
+ * is stopped.
+ *
+ * @param[out] stats Received and dropped packets.
+ */
+void
+get_sniffer_stats (sniffer_stats_t *stats)
+{
+  if (stats)
+    *stats = sniffer_stats;
+}
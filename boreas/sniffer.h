@@ -10,10 +10,22 @@
 
 #include <pcap.h>
 
+/**
+ * @brief Counters of the sniffer.
+ */
+typedef struct
+{
+  guint64 received; /**< Packets passing the filter. */
+  guint64 dropped;  /**< Packets dropped by the kernel. */
+} sniffer_stats_t;
+
 int
-start_sniffer_thread (scanner_t *, pthread_t *);
+start_sniffer_thread (scanner_t *, alive_test_t, pthread_t *);
 
 int
 stop_sniffer_thread (scanner_t *, pthread_t);
 
+void
+get_sniffer_stats (sniffer_stats_t *);
+
 #endif /* not BOREAS_SNIFFER_H */
@@ -21,6 +21,64 @@ Ensure (sniffer, dummy_test)
   assert_that (0, is_equal_to (0));
 }
 
+Ensure (sniffer, fix_filter_offsets_maps_cooked_header)
+{
+  struct bpf_insn insns[] = {
+    /* ldh [14], the protocol of the cooked header. */
+    {BPF_LD | BPF_H | BPF_ABS, 0, 0, 14},
+    /* ldxb 4*([16]&0xf), the IPv4 header length. */
+    {BPF_LDX | BPF_B | BPF_MSH, 0, 0, 16},
+    /* ldh [x + 18], the destination port. */
+    {BPF_LD | BPF_H | BPF_IND, 0, 0, 18},
+    {BPF_RET | BPF_K, 0, 0, 1500},
+  };
+  struct bpf_insn unsupported[] = {
+    /* ld [6], part of the link layer address. */
+    {BPF_LD | BPF_W | BPF_ABS, 0, 0, 6},
+  };
+  struct bpf_program prog = {G_N_ELEMENTS (insns), insns};
+
+  assert_that (fix_filter_offsets (&prog), is_equal_to (0));
+  assert_that (insns[0].k, is_equal_to (SKF_AD_OFF + SKF_AD_PROTOCOL));
+  assert_that (insns[1].k, is_equal_to (0));
+  assert_that (insns[2].k, is_equal_to (2));
+  assert_that (insns[3].k, is_equal_to (1500));
+
+  prog.bf_len = G_N_ELEMENTS (unsupported);
+  prog.bf_insns = unsupported;
+  assert_that (fix_filter_offsets (&prog), is_equal_to (-1));
+}
+
+Ensure (sniffer, build_filter_str_covers_the_target_networks)
+{
+  uint32_t addrs[1025];
+  gchar *filter;
+
+  /* 10.0.0.0/22 as a whole and 192.168.1.1. */
+  for (unsigned int i = 0; i < 1024; i++)
+    addrs[i] = 0x0a000000 + i;
+  addrs[1024] = 0xc0a80101;
+
+  filter = build_filter_str (addrs, 1024, FALSE, ALIVE_TEST_ICMP, FALSE);
+  assert_that (filter, is_equal_to_string (
+                         "((ip or arp) and (src net 10.0.0.0/22) and "
+                         "(icmp[icmptype] == icmp-echoreply))"));
+  g_free (filter);
+
+  filter = build_filter_str (addrs, 1025, TRUE, ALIVE_TEST_ARP, FALSE);
+  assert_that (filter,
+               is_equal_to_string (
+                 "((ip or arp) and (src net 10.0.0.0/22 or src net "
+                 "192.168.1.1/32) and (arp[6:2] == 2)) or (ip6 and (ip6[40] "
+                 "== 136))"));
+  g_free (filter);
+
+  filter = build_filter_str (NULL, 0, TRUE, ALIVE_TEST_ARP, TRUE);
+  assert_that (filter, is_equal_to_string (
+                         "(ip6 and (ip6[40] == 136 or ip6[40] == 129))"));
+  g_free (filter);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -29,6 +87,9 @@ main (int argc, char **argv)
   suite = create_test_suite ();
 
   add_test_with_context (suite, sniffer, dummy_test);
+  add_test_with_context (suite, sniffer, fix_filter_offsets_maps_cooked_header);
+  add_test_with_context (suite, sniffer,
+                         build_filter_str_covers_the_target_networks);
 
   if (argc > 1)
     return run_single_test (suite, argv[1], create_text_reporter ());
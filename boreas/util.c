@@ -3,8 +3,11 @@
  * SPDX-License-Identifier: GPL-2.0-or-later
  */
 
+#define _GNU_SOURCE /* for pthread_setaffinity_np(), CPU_SET() */
+
 #include "util.h"
 
+#include "../base/memstats.h"   /* for gvm_memstats_alloc */
 #include "../base/networking.h" /* for range_t */
 
 #include <errno.h>
@@ -14,10 +17,13 @@
 #include <net/ethernet.h>
 #include <net/if.h>           /* for if_nametoindex() */
 #include <netpacket/packet.h> /* for sockaddr_ll */
+#include <pthread.h>          /* for pthread_setaffinity_np() */
+#include <sched.h>            /* for cpu_set_t */
 #include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
+#include <time.h> /* for clock_gettime(), nanosleep() */
 #include <unistd.h>
 
 #undef G_LOG_DOMAIN
@@ -29,6 +35,57 @@
 static boreas_error_t
 set_socket (socket_type_t, int *);
 
+/* Time the buckets of a pacer can save up tokens for, in nanoseconds. */
+#define PACER_BURST_NS 10000000
+
+/**
+ * @brief Token bucket.
+ */
+struct token_bucket
+{
+  double rate;   /**< Tokens added per second, 0 for no limit. */
+  double tokens; /**< Available tokens, negative for a debt. */
+  gint64 last;   /**< Time of the last refill in nanoseconds. */
+};
+
+/**
+ * @brief Token bucket pacer of sent packets.
+ */
+struct pacer
+{
+  GMutex mutex;                /**< Serializes the senders. */
+  struct token_bucket packets; /**< Packets per second. */
+  struct token_bucket bytes;   /**< Bytes per second. */
+  double subnet_rate;          /**< Packets per second per subnet, 0 if none. */
+  GHashTable *subnets;         /**< Buckets by subnet. */
+};
+
+/**
+ * @brief Open addressed hash set of IPv6 and IPv4-mapped addresses.
+ */
+struct addr_set
+{
+  struct in6_addr *addrs; /**< Slots. */
+  guint8 *used;           /**< Whether a slot is used. */
+  gint64 *times;          /**< Times of the addresses, 0 if none. */
+  size_t capacity;        /**< Number of slots, a power of 2. */
+  size_t count;           /**< Number of addresses in the set. */
+};
+
+/**
+ * @brief Estimator of the round trip time of the pings.
+ *
+ * Smoothes the samples as the TCP retransmission timer of RFC 6298.
+ */
+struct rtt_estimator
+{
+  GMutex mutex;      /**< Serializes the sniffer threads. */
+  guint64 samples;   /**< Number of samples. */
+  gint64 srtt;       /**< Smoothed round trip time in microseconds. */
+  gint64 rttvar;     /**< Round trip time variation in microseconds. */
+  gint64 last_reply; /**< Time of the last sample. */
+};
+
 /**
  * @brief Checksum calculation.
  *
@@ -68,6 +125,37 @@ in_cksum (uint16_t *addr, int len)
   return (answer);
 }
 
+/**
+ * @brief Update an Internet checksum for changed data, as in RFC 1624.
+ *
+ * @param sum Checksum of the data with the old bytes, as from in_cksum().
+ * @param old Old bytes, at an even offset of the data.
+ * @param new New bytes.
+ * @param len Number of changed bytes, even.
+ *
+ * @return Checksum of the data with the new bytes.
+ */
+uint16_t
+in_cksum_update (uint16_t sum, const void *old, const void *new, size_t len)
+{
+  const uint8_t *old_bytes = old, *new_bytes = new;
+  uint32_t acc = (uint16_t) ~sum;
+
+  /* HC' = ~(~HC + ~m + m'), equation 3 of RFC 1624. */
+  for (size_t i = 0; i + 1 < len; i += 2)
+    {
+      uint16_t old_word, new_word;
+
+      memcpy (&old_word, old_bytes + i, 2);
+      memcpy (&new_word, new_bytes + i, 2);
+      acc += (uint16_t) ~old_word;
+      acc += new_word;
+    }
+  acc = (acc >> 16) + (acc & 0xffff);
+  acc += (acc >> 16);
+  return ~acc;
+}
+
 /**
  * @brief Get the source mac address of the given interface
  * or of the first non lo interface.
@@ -498,6 +586,22 @@ set_socket (socket_type_t socket_type, int *scanner_socket)
                        strerror (errno));
             error = BOREAS_OPENING_SOCKET_FAILED;
           }
+        else if (socket_type == ARPV6)
+          {
+            int hops = 255;
+
+            /* Neighbor discovery messages with another hop limit are
+             * dropped by the receivers. */
+            if (setsockopt (soc, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, &hops,
+                            sizeof (hops))
+                  < 0
+                || setsockopt (soc, IPPROTO_IPV6, IPV6_UNICAST_HOPS, &hops,
+                               sizeof (hops))
+                     < 0)
+              g_debug ("%s: failed to set the hop limit of the ARPV6 "
+                       "socket: %s",
+                       __func__, strerror (errno));
+          }
       }
       break;
     case ARPV4:
@@ -572,6 +676,48 @@ set_all_needed_sockets (scanner_t *scanner, alive_test_t alive_test)
   return error;
 }
 
+/**
+ * @brief Get the outgoing interface to the targets.
+ *
+ * @param hosts_data  Hosts data, with the targets.
+ *
+ * @return Name of the interface to the first target, to be freed with
+ *         g_free(). NULL if unknown.
+ */
+char *
+targets_iface (hosts_data_t *hosts_data)
+{
+  GHashTableIter iter;
+  gpointer key, value;
+
+  g_hash_table_iter_init (&iter, hosts_data->targethosts);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      struct sockaddr_storage target_addr;
+      struct in6_addr addr6;
+
+      if (gvm_host_get_addr6 ((gvm_host_t *) value, &addr6) < 0)
+        continue;
+      memset (&target_addr, 0, sizeof (target_addr));
+      if (IN6_IS_ADDR_V4MAPPED (&addr6))
+        {
+          struct sockaddr_in *sin = (struct sockaddr_in *) &target_addr;
+
+          sin->sin_family = AF_INET;
+          sin->sin_addr.s_addr = addr6.s6_addr32[3];
+        }
+      else
+        {
+          struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *) &target_addr;
+
+          sin6->sin6_family = AF_INET6;
+          sin6->sin6_addr = addr6;
+        }
+      return gvm_get_outgoing_iface (&target_addr);
+    }
+  return NULL;
+}
+
 /**
  * @brief Subtract two hashtables and count the remaining elements.
  *
@@ -602,6 +748,822 @@ count_difference (GHashTable *hashtable_A, GHashTable *hashtable_B)
   return count;
 }
 
+/**
+ * @brief Get the size of an address set, for the memory accounting.
+ *
+ * @param set Address set.
+ *
+ * @return Size in bytes.
+ */
+static size_t
+addr_set_size (const addr_set_t *set)
+{
+  return sizeof (*set)
+         + set->capacity
+             * (sizeof (*set->addrs) + sizeof (*set->used)
+                + sizeof (*set->times));
+}
+
+/**
+ * @brief Create an address set.
+ *
+ * The set is sized once for the expected number of addresses so that lookups
+ * of captured replies never allocate.
+ *
+ * @param expected Expected number of addresses.
+ *
+ * @return New address set, to be freed with addr_set_free().
+ */
+addr_set_t *
+addr_set_new (size_t expected)
+{
+  addr_set_t *set = g_malloc0 (sizeof (*set));
+
+  /* Keep the load factor at most 1/2. */
+  set->capacity = 16;
+  while (set->capacity < expected * 2)
+    set->capacity *= 2;
+  set->addrs = g_malloc0 (set->capacity * sizeof (*set->addrs));
+  set->used = g_malloc0 (set->capacity);
+  set->times = g_malloc0 (set->capacity * sizeof (*set->times));
+  gvm_memstats_alloc (GVM_MEM_BOREAS, addr_set_size (set));
+  return set;
+}
+
+/**
+ * @brief Free an address set.
+ *
+ * @param set Address set, may be NULL.
+ */
+void
+addr_set_free (addr_set_t *set)
+{
+  if (!set)
+    return;
+  gvm_memstats_free (GVM_MEM_BOREAS, addr_set_size (set));
+  g_free (set->addrs);
+  g_free (set->used);
+  g_free (set->times);
+  g_free (set);
+}
+
+/**
+ * @brief Get the first slot to probe for an address.
+ *
+ * @param set  Address set.
+ * @param addr Address.
+ *
+ * @return Slot index.
+ */
+static size_t
+addr_set_slot (const addr_set_t *set, const struct in6_addr *addr)
+{
+  guint64 high, low, hash;
+
+  memcpy (&high, addr->s6_addr, 8);
+  memcpy (&low, addr->s6_addr + 8, 8);
+  hash = (high ^ (low * G_GUINT64_CONSTANT (0x9e3779b97f4a7c15)))
+         * G_GUINT64_CONSTANT (0xff51afd7ed558ccd);
+  return (hash ^ (hash >> 32)) & (set->capacity - 1);
+}
+
+/**
+ * @brief Find the slot of an address, or the free slot it would go into.
+ *
+ * @param set  Address set.
+ * @param addr Address.
+ *
+ * @return Slot index.
+ */
+static size_t
+addr_set_find (const addr_set_t *set, const struct in6_addr *addr)
+{
+  size_t i = addr_set_slot (set, addr);
+
+  while (set->used[i] && memcmp (&set->addrs[i], addr, sizeof (*addr)))
+    i = (i + 1) & (set->capacity - 1);
+  return i;
+}
+
+/**
+ * @brief Add an address to an address set.
+ *
+ * @param set  Address set.
+ * @param addr Address, IPv4 addresses as IPv4-mapped IPv6 addresses.
+ *
+ * @return TRUE if the address was added, FALSE if it was already in the set.
+ */
+gboolean
+addr_set_add (addr_set_t *set, const struct in6_addr *addr)
+{
+  size_t i;
+
+  if ((set->count + 1) * 2 > set->capacity)
+    {
+      /* Grow, only happens when more addresses than expected are added. */
+      struct in6_addr *addrs = set->addrs;
+      guint8 *used = set->used;
+      gint64 *times = set->times;
+      size_t capacity = set->capacity, j;
+
+      set->capacity *= 2;
+      set->addrs = g_malloc0 (set->capacity * sizeof (*set->addrs));
+      set->used = g_malloc0 (set->capacity);
+      set->times = g_malloc0 (set->capacity * sizeof (*set->times));
+      for (j = 0; j < capacity; j++)
+        if (used[j])
+          {
+            i = addr_set_find (set, &addrs[j]);
+            set->addrs[i] = addrs[j];
+            set->used[i] = 1;
+            set->times[i] = times[j];
+          }
+      g_free (addrs);
+      g_free (used);
+      g_free (times);
+    }
+
+  i = addr_set_find (set, addr);
+  if (set->used[i])
+    return FALSE;
+  set->addrs[i] = *addr;
+  set->used[i] = 1;
+  set->count++;
+  return TRUE;
+}
+
+/**
+ * @brief Check if an address is in an address set.
+ *
+ * @param set  Address set.
+ * @param addr Address, IPv4 addresses as IPv4-mapped IPv6 addresses.
+ *
+ * @return TRUE if the address is in the set, else FALSE.
+ */
+gboolean
+addr_set_contains (const addr_set_t *set, const struct in6_addr *addr)
+{
+  return set->used[addr_set_find (set, addr)] ? TRUE : FALSE;
+}
+
+/**
+ * @brief Set the time of an address of an address set.
+ *
+ * Can be called while other threads get the times, but not while addresses
+ * are added.
+ *
+ * @param set  Address set.
+ * @param addr Address, IPv4 addresses as IPv4-mapped IPv6 addresses.
+ * @param time Time.
+ *
+ * @return TRUE if the address is in the set, else FALSE.
+ */
+gboolean
+addr_set_set_time (addr_set_t *set, const struct in6_addr *addr, gint64 time)
+{
+  size_t i = addr_set_find (set, addr);
+
+  if (!set->used[i])
+    return FALSE;
+  __atomic_store_n (&set->times[i], time, __ATOMIC_RELAXED);
+  return TRUE;
+}
+
+/**
+ * @brief Get the time of an address of an address set.
+ *
+ * @param set  Address set.
+ * @param addr Address, IPv4 addresses as IPv4-mapped IPv6 addresses.
+ *
+ * @return Time set with addr_set_set_time(), 0 if none.
+ */
+gint64
+addr_set_get_time (const addr_set_t *set, const struct in6_addr *addr)
+{
+  size_t i = addr_set_find (set, addr);
+
+  if (!set->used[i])
+    return 0;
+  return __atomic_load_n (&set->times[i], __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Create a round trip time estimator.
+ *
+ * @return New estimator, to be freed with rtt_estimator_free().
+ */
+rtt_estimator_t *
+rtt_estimator_new (void)
+{
+  rtt_estimator_t *rtt = g_malloc0 (sizeof (*rtt));
+
+  g_mutex_init (&rtt->mutex);
+  return rtt;
+}
+
+/**
+ * @brief Free a round trip time estimator.
+ *
+ * @param rtt Estimator, may be NULL.
+ */
+void
+rtt_estimator_free (rtt_estimator_t *rtt)
+{
+  if (!rtt)
+    return;
+  g_mutex_clear (&rtt->mutex);
+  g_free (rtt);
+}
+
+/**
+ * @brief Add a round trip time sample to an estimator.
+ *
+ * @param rtt    Estimator.
+ * @param sample Round trip time in microseconds.
+ * @param now    Time of the reply in microseconds.
+ */
+void
+rtt_estimator_add (rtt_estimator_t *rtt, gint64 sample, gint64 now)
+{
+  if (sample < 0)
+    return;
+
+  g_mutex_lock (&rtt->mutex);
+  if (rtt->samples++ == 0)
+    {
+      rtt->srtt = sample;
+      rtt->rttvar = sample / 2;
+    }
+  else
+    {
+      /* Gains of 1/4 for the variation and 1/8 for the mean. */
+      rtt->rttvar = (3 * rtt->rttvar + ABS (rtt->srtt - sample)) / 4;
+      rtt->srtt = (7 * rtt->srtt + sample) / 8;
+    }
+  rtt->last_reply = MAX (rtt->last_reply, now);
+  g_mutex_unlock (&rtt->mutex);
+}
+
+/**
+ * @brief Get the time after which no more replies are expected.
+ *
+ * @param rtt     Estimator.
+ * @param after   Time the last ping was sent, in microseconds.
+ * @param backoff Factor of the retransmission timeout, 1 for the first try.
+ *
+ * @return Time of the last reply or the given time, whichever is later, plus
+ *         backoff times the retransmission timeout of RFC 6298, that is the
+ *         smoothed round trip time plus four times its variation. 0 if there
+ *         are no samples yet.
+ */
+gint64
+rtt_estimator_deadline (rtt_estimator_t *rtt, gint64 after, int backoff)
+{
+  gint64 deadline = 0;
+
+  g_mutex_lock (&rtt->mutex);
+  if (rtt->samples)
+    deadline = MAX (rtt->last_reply, after)
+               + backoff * (rtt->srtt + 4 * rtt->rttvar);
+  g_mutex_unlock (&rtt->mutex);
+  return deadline;
+}
+
+/**
+ * @brief Get the link-layer address of an interface.
+ *
+ * @param ifaddr  Addresses of the interfaces, from getifaddrs().
+ * @param name    Name of the interface.
+ * @param[out] link  Link to set the address of.
+ */
+static void
+ndp_link_set_mac (struct ifaddrs *ifaddr, const char *name, ndp_link_t *link)
+{
+  for (struct ifaddrs *ifa = ifaddr; ifa; ifa = ifa->ifa_next)
+    {
+      const struct sockaddr_ll *sll;
+
+      if (!ifa->ifa_addr || ifa->ifa_addr->sa_family != AF_PACKET
+          || strcmp (ifa->ifa_name, name))
+        continue;
+      sll = (const struct sockaddr_ll *) ifa->ifa_addr;
+      if (sll->sll_halen != sizeof (link->mac))
+        continue;
+      memcpy (link->mac, sll->sll_addr, sizeof (link->mac));
+      link->has_mac = TRUE;
+      return;
+    }
+}
+
+/**
+ * @brief Get the IPv6 prefixes of the local links.
+ *
+ * Link-local addresses and prefixes without neighbors, like the ones of
+ * loopback interfaces, are skipped.
+ *
+ * @return Array of ndp_link_t, to be freed with g_array_free(). NULL if there
+ *         are no prefixes.
+ */
+GArray *
+ndp_links_new (void)
+{
+  struct ifaddrs *ifaddr;
+  GArray *links;
+
+  if (getifaddrs (&ifaddr) < 0)
+    {
+      g_debug ("%s: getifaddrs failed: %s", __func__, strerror (errno));
+      return NULL;
+    }
+
+  links = g_array_new (FALSE, TRUE, sizeof (ndp_link_t));
+  for (struct ifaddrs *ifa = ifaddr; ifa; ifa = ifa->ifa_next)
+    {
+      const struct in6_addr *addr, *mask;
+      ndp_link_t link;
+
+      if (!ifa->ifa_addr || !ifa->ifa_netmask
+          || ifa->ifa_addr->sa_family != AF_INET6
+          || !(ifa->ifa_flags & IFF_UP) || (ifa->ifa_flags & IFF_LOOPBACK))
+        continue;
+      addr = &((const struct sockaddr_in6 *) ifa->ifa_addr)->sin6_addr;
+      mask = &((const struct sockaddr_in6 *) ifa->ifa_netmask)->sin6_addr;
+      if (IN6_IS_ADDR_LINKLOCAL (addr))
+        continue;
+
+      memset (&link, 0, sizeof (link));
+      if ((link.ifindex = if_nametoindex (ifa->ifa_name)) == 0)
+        continue;
+      link.addr = *addr;
+      for (int i = 0; i < 16; i++)
+        {
+          link.prefix.s6_addr[i] = addr->s6_addr[i] & mask->s6_addr[i];
+          link.prefixlen += __builtin_popcount (mask->s6_addr[i]);
+        }
+      if (link.prefixlen == 128)
+        continue;
+      ndp_link_set_mac (ifaddr, ifa->ifa_name, &link);
+      g_array_append_val (links, link);
+    }
+  freeifaddrs (ifaddr);
+
+  if (links->len == 0)
+    {
+      g_array_free (links, TRUE);
+      return NULL;
+    }
+  return links;
+}
+
+/**
+ * @brief Find the local link of an address.
+ *
+ * @param links  Links from ndp_links_new(), may be NULL.
+ * @param addr   IPv6 address.
+ *
+ * @return Link with the longest prefix of the address, NULL if the address
+ *         is not on a local link.
+ */
+const ndp_link_t *
+ndp_links_find (GArray *links, const struct in6_addr *addr)
+{
+  const ndp_link_t *best = NULL;
+
+  if (!links || !addr)
+    return NULL;
+  for (guint i = 0; i < links->len; i++)
+    {
+      const ndp_link_t *link = &g_array_index (links, ndp_link_t, i);
+      int bytes = link->prefixlen / 8, bits = link->prefixlen % 8;
+
+      if (best && best->prefixlen >= link->prefixlen)
+        continue;
+      if (memcmp (addr->s6_addr, link->prefix.s6_addr, bytes))
+        continue;
+      if (bits
+          && (addr->s6_addr[bytes] & (0xff00 >> bits))
+               != link->prefix.s6_addr[bytes])
+        continue;
+      best = link;
+    }
+  return best;
+}
+
+/**
+ * @brief Get the solicited-node multicast address of an address.
+ *
+ * This is ff02::1:ff00:0/104 with the low 24 bits of the address.
+ *
+ * @param addr       IPv6 address.
+ * @param[out] group Solicited-node multicast address.
+ */
+void
+ndp_solicited_node (const struct in6_addr *addr, struct in6_addr *group)
+{
+  memset (group, 0, sizeof (*group));
+  group->s6_addr[0] = 0xff;
+  group->s6_addr[1] = 0x02;
+  group->s6_addr[11] = 0x01;
+  group->s6_addr[12] = 0xff;
+  memcpy (group->s6_addr + 13, addr->s6_addr + 13, 3);
+}
+
+/**
+ * @brief CPUs to run threads on.
+ */
+struct thread_cpus
+{
+  cpu_set_t set; /**< CPUs. */
+};
+
+/**
+ * @brief Parse a list of CPUs, like "0-3,8".
+ *
+ * This is the format of the taskset command and of the CPU lists in sysfs.
+ *
+ * @param list     List of CPUs.
+ * @param[out] set CPUs of the list.
+ *
+ * @return Number of CPUs, -1 if the list is invalid.
+ */
+static int
+thread_cpus_parse (const char *list, cpu_set_t *set)
+{
+  gchar **ranges;
+  int ret = 0;
+
+  CPU_ZERO (set);
+  ranges = g_strsplit (list, ",", -1);
+  for (gchar **range = ranges; *range && ret >= 0; range++)
+    {
+      char *end;
+      long first, last;
+
+      g_strstrip (*range);
+      if (**range == '\0')
+        continue;
+      first = last = strtol (*range, &end, 10);
+      if (*end == '-')
+        last = strtol (end + 1, &end, 10);
+      if (*end != '\0' || first < 0 || last < first || last >= CPU_SETSIZE)
+        ret = -1;
+      else
+        for (long cpu = first; cpu <= last; cpu++)
+          CPU_SET (cpu, set);
+    }
+  g_strfreev (ranges);
+  if (ret < 0)
+    return -1;
+  return CPU_COUNT (set);
+}
+
+/**
+ * @brief Create the CPUs to run the threads of a kind on.
+ *
+ * With "auto" these are the CPUs local to the network interface, on the NUMA
+ * node of the interface, as listed by the kernel in sysfs. Otherwise the
+ * specification is a list of CPUs like "0-3,8".
+ *
+ * @param spec   Specification, NULL or empty for no restriction.
+ * @param iface  Name of the outgoing interface, used with "auto". May be
+ *               NULL.
+ *
+ * @return CPUs, to be freed with thread_cpus_free(). NULL if the threads are
+ *         not restricted, because of the specification or an error.
+ */
+thread_cpus_t *
+thread_cpus_new (const char *spec, const char *iface)
+{
+  thread_cpus_t *cpus;
+  gchar *list = NULL;
+  int count;
+
+  if (spec == NULL || *spec == '\0')
+    return NULL;
+
+  if (!strcmp (spec, "auto"))
+    {
+      gchar *path;
+
+      if (iface == NULL)
+        {
+          g_debug ("%s: No interface to place the threads on", __func__);
+          return NULL;
+        }
+      path = g_build_filename ("/sys/class/net", iface, "device",
+                               "local_cpulist", NULL);
+      if (!g_file_get_contents (path, &list, NULL, NULL))
+        {
+          g_debug ("%s: No local CPUs known for %s", __func__, iface);
+          g_free (path);
+          return NULL;
+        }
+      g_free (path);
+      spec = list;
+    }
+
+  cpus = g_malloc0 (sizeof (*cpus));
+  count = thread_cpus_parse (spec, &cpus->set);
+  if (count <= 0)
+    {
+      g_warning ("%s: Invalid list of CPUs '%s'", __func__, spec);
+      g_free (cpus);
+      cpus = NULL;
+    }
+  else
+    g_debug ("%s: Threads placed on %d CPUs (%s)", __func__, count, spec);
+  g_free (list);
+  return cpus;
+}
+
+/**
+ * @brief Free CPUs to run threads on.
+ *
+ * @param cpus CPUs, may be NULL.
+ */
+void
+thread_cpus_free (thread_cpus_t *cpus)
+{
+  g_free (cpus);
+}
+
+/**
+ * @brief Get the CPUs the calling thread may run on.
+ *
+ * @return CPUs, to be freed with thread_cpus_free(). NULL on error.
+ */
+thread_cpus_t *
+thread_cpus_get (void)
+{
+  thread_cpus_t *cpus = g_malloc0 (sizeof (*cpus));
+
+  if (pthread_getaffinity_np (pthread_self (), sizeof (cpus->set), &cpus->set))
+    {
+      g_free (cpus);
+      return NULL;
+    }
+  return cpus;
+}
+
+/**
+ * @brief Restrict the calling thread to CPUs.
+ *
+ * The thread is moved to one of the CPUs at once, so that the memory it
+ * touches first is allocated on their node. Threads created afterwards by
+ * the thread inherit the CPUs.
+ *
+ * @param cpus CPUs, NULL to keep the CPUs of the thread.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int
+thread_cpus_apply (const thread_cpus_t *cpus)
+{
+  int err;
+
+  if (cpus == NULL)
+    return 0;
+  err = pthread_setaffinity_np (pthread_self (), sizeof (cpus->set),
+                                &cpus->set);
+  if (err)
+    {
+      g_warning ("%s: Could not set the CPU affinity: %s", __func__,
+                 strerror (err));
+      return -1;
+    }
+  return 0;
+}
+
+/**
+ * @brief Get the monotonic time in nanoseconds.
+ *
+ * @return Time.
+ */
+static gint64
+pacer_now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (gint64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * @brief Initialise a token bucket, full.
+ *
+ * @param bucket Bucket.
+ * @param rate   Tokens added per second, 0 for no limit.
+ * @param now    Current time in nanoseconds.
+ */
+static void
+token_bucket_init (struct token_bucket *bucket, double rate, gint64 now)
+{
+  bucket->rate = rate > 0 ? rate : 0;
+  bucket->tokens = MAX (1, bucket->rate * PACER_BURST_NS / 1e9);
+  bucket->last = now;
+}
+
+/**
+ * @brief Refill a token bucket and get the time until tokens are available.
+ *
+ * A bucket lends the tokens missing to a request larger than the bucket once
+ * it is full, so that any request is eventually granted.
+ *
+ * @param bucket Bucket.
+ * @param need   Tokens needed.
+ * @param now    Current time in nanoseconds.
+ *
+ * @return 0 if the tokens are available, else nanoseconds to wait.
+ */
+static gint64
+token_bucket_wait (struct token_bucket *bucket, double need, gint64 now)
+{
+  double capacity;
+
+  if (bucket->rate == 0)
+    return 0;
+
+  capacity = MAX (1, bucket->rate * PACER_BURST_NS / 1e9);
+  bucket->tokens += (now - bucket->last) * bucket->rate / 1e9;
+  bucket->tokens = MIN (bucket->tokens, capacity);
+  bucket->last = now;
+
+  need = MIN (need, capacity);
+  if (bucket->tokens >= need)
+    return 0;
+  return (gint64) ((need - bucket->tokens) * 1e9 / bucket->rate) + 1;
+}
+
+/**
+ * @brief Create a pacer.
+ *
+ * There is one bucket per /24 IPv4 or /64 IPv6 subnet for the subnet limit.
+ *
+ * @param pps         Packets per second, 0 for no limit.
+ * @param bps         Bytes per second, 0 for no limit.
+ * @param subnet_pps  Packets per second to one subnet, 0 for no limit.
+ *
+ * @return Pacer to free with pacer_free, NULL if none of the limits is set.
+ */
+pacer_t *
+pacer_new (double pps, double bps, double subnet_pps)
+{
+  pacer_t *pacer;
+  gint64 now = pacer_now ();
+
+  if (pps <= 0 && bps <= 0 && subnet_pps <= 0)
+    return NULL;
+
+  pacer = g_malloc0 (sizeof (*pacer));
+  g_mutex_init (&pacer->mutex);
+  token_bucket_init (&pacer->packets, pps, now);
+  token_bucket_init (&pacer->bytes, bps, now);
+  if (subnet_pps > 0)
+    {
+      pacer->subnet_rate = subnet_pps;
+      pacer->subnets =
+        g_hash_table_new_full (g_int64_hash, g_int64_equal, g_free, g_free);
+    }
+  return pacer;
+}
+
+/**
+ * @brief Free a pacer.
+ *
+ * @param pacer Pacer.
+ */
+void
+pacer_free (pacer_t *pacer)
+{
+  if (pacer == NULL)
+    return;
+  if (pacer->subnets)
+    g_hash_table_destroy (pacer->subnets);
+  g_mutex_clear (&pacer->mutex);
+  g_free (pacer);
+}
+
+/**
+ * @brief Get the subnet bucket of a destination, creating it if needed.
+ *
+ * @param pacer Pacer with a subnet limit.
+ * @param dst   Destination, sockaddr_in or sockaddr_in6.
+ * @param now   Current time in nanoseconds.
+ *
+ * @return Bucket, NULL for other families.
+ */
+static struct token_bucket *
+pacer_subnet (pacer_t *pacer, const struct sockaddr *dst, gint64 now)
+{
+  struct token_bucket *bucket;
+  gint64 subnet;
+
+  if (dst->sa_family == AF_INET)
+    subnet =
+      G_GINT64_CONSTANT (0xffff00000000)
+      | (ntohl (((struct sockaddr_in *) dst)->sin_addr.s_addr) & 0xffffff00);
+  else if (dst->sa_family == AF_INET6)
+    memcpy (&subnet, &((struct sockaddr_in6 *) dst)->sin6_addr, 8);
+  else
+    return NULL;
+
+  bucket = g_hash_table_lookup (pacer->subnets, &subnet);
+  if (bucket == NULL)
+    {
+      gint64 *key = g_malloc (sizeof (*key));
+
+      *key = subnet;
+      bucket = g_malloc0 (sizeof (*bucket));
+      token_bucket_init (bucket, pacer->subnet_rate, now);
+      g_hash_table_insert (pacer->subnets, key, bucket);
+    }
+  return bucket;
+}
+
+/**
+ * @brief Reserve the sending of a packet at a given time.
+ *
+ * @param pacer Pacer.
+ * @param dst   Destination, NULL to ignore the subnet limit.
+ * @param len   Length of the packet.
+ * @param now   Current time in nanoseconds.
+ *
+ * @return 0 if the packet may be sent now, else nanoseconds to wait before
+ *         trying again. Nothing is reserved in that case.
+ */
+static gint64
+pacer_reserve_at (pacer_t *pacer, const struct sockaddr *dst, size_t len,
+                  gint64 now)
+{
+  struct token_bucket *subnet = NULL;
+  gint64 wait;
+
+  g_mutex_lock (&pacer->mutex);
+  wait = token_bucket_wait (&pacer->packets, 1, now);
+  wait = MAX (wait, token_bucket_wait (&pacer->bytes, len, now));
+  if (pacer->subnets && dst && (subnet = pacer_subnet (pacer, dst, now)))
+    wait = MAX (wait, token_bucket_wait (subnet, 1, now));
+  if (wait == 0)
+    {
+      pacer->packets.tokens -= 1;
+      pacer->bytes.tokens -= len;
+      if (subnet)
+        subnet->tokens -= 1;
+    }
+  g_mutex_unlock (&pacer->mutex);
+  return wait;
+}
+
+/**
+ * @brief Reserve the sending of a packet.
+ *
+ * @param pacer Pacer, NULL for no limit.
+ * @param dst   Destination, NULL to ignore the subnet limit.
+ * @param len   Length of the packet.
+ *
+ * @return 0 if the packet may be sent now, else nanoseconds to wait before
+ *         trying again. Nothing is reserved in that case.
+ */
+gint64
+pacer_reserve (pacer_t *pacer, const struct sockaddr *dst, size_t len)
+{
+  if (pacer == NULL)
+    return 0;
+  return pacer_reserve_at (pacer, dst, len, pacer_now ());
+}
+
+/**
+ * @brief Sleep for a number of nanoseconds.
+ *
+ * @param ns Nanoseconds.
+ */
+void
+pacer_sleep (gint64 ns)
+{
+  struct timespec ts;
+
+  ts.tv_sec = ns / 1000000000;
+  ts.tv_nsec = ns % 1000000000;
+  while (nanosleep (&ts, &ts) == -1 && errno == EINTR)
+    ;
+}
+
+/**
+ * @brief Wait until a packet may be sent and reserve its sending.
+ *
+ * @param pacer Pacer, NULL for no limit.
+ * @param dst   Destination, NULL to ignore the subnet limit.
+ * @param len   Length of the packet.
+ */
+void
+pacer_wait (pacer_t *pacer, const struct sockaddr *dst, size_t len)
+{
+  gint64 wait;
+
+  while ((wait = pacer_reserve (pacer, dst, len)) > 0)
+    pacer_sleep (wait);
+}
+
 /**
  * @brief Check if socket send buffer is empty.
  *
@@ -626,20 +1588,25 @@ so_sndbuf_empty (int soc, int *err)
 /**
  * @brief Wait until socket send buffer empty or timeout reached.
  *
+ * The buffer is polled after 1 ms first, the interval doubling up to 100 ms,
+ * so that a quickly drained buffer is not waited for long.
+ *
  * @param soc     Socket.
  * @param timeout Timeout in seconds.
  */
 void
 wait_until_so_sndbuf_empty (int soc, int timeout)
 {
-  int cnt = 0;
+  gint64 deadline = pacer_now () + (gint64) timeout * 1000000000;
+  gint64 interval = 1000000;
   int err = 0;
   int empty;
 
   empty = so_sndbuf_empty (soc, &err);
-  for (; !empty && (err != -1) && (cnt / 10 != timeout);
-       empty = so_sndbuf_empty (soc, &err), cnt++)
+  while (!empty && err != -1 && pacer_now () < deadline)
     {
-      usleep (100000);
+      pacer_sleep (interval);
+      interval = MIN (interval * 2, 100000000);
+      empty = so_sndbuf_empty (soc, &err);
     }
 }
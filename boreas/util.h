@@ -14,6 +14,9 @@
 uint16_t
 in_cksum (uint16_t *addr, int len);
 
+uint16_t
+in_cksum_update (uint16_t, const void *, const void *, size_t);
+
 int
 get_source_mac_addr (char *, uint8_t *);
 
@@ -34,6 +37,101 @@ close_all_needed_sockets (scanner_t *, alive_test_t);
 void
 wait_until_so_sndbuf_empty (int, int);
 
+char *
+targets_iface (hosts_data_t *);
+
+/* Pacing of sent packets. */
+
+typedef struct pacer pacer_t;
+
+pacer_t *
+pacer_new (double, double, double);
+
+void
+pacer_free (pacer_t *);
+
+gint64
+pacer_reserve (pacer_t *, const struct sockaddr *, size_t);
+
+void
+pacer_wait (pacer_t *, const struct sockaddr *, size_t);
+
+void
+pacer_sleep (gint64);
+
+/* Sets of addresses. */
+
+addr_set_t *
+addr_set_new (size_t);
+
+void
+addr_set_free (addr_set_t *);
+
+gboolean
+addr_set_add (addr_set_t *, const struct in6_addr *);
+
+gboolean
+addr_set_contains (const addr_set_t *, const struct in6_addr *);
+
+gboolean
+addr_set_set_time (addr_set_t *, const struct in6_addr *, gint64);
+
+gint64
+addr_set_get_time (const addr_set_t *, const struct in6_addr *);
+
+/* Estimation of round trip times. */
+
+rtt_estimator_t *
+rtt_estimator_new (void);
+
+void
+rtt_estimator_free (rtt_estimator_t *);
+
+void
+rtt_estimator_add (rtt_estimator_t *, gint64, gint64);
+
+gint64
+rtt_estimator_deadline (rtt_estimator_t *, gint64, int);
+
+/* IPv6 prefixes of the local links. */
+
+/**
+ * @brief IPv6 prefix of a local link, on which neighbors are solicited
+ * through multicast.
+ */
+typedef struct ndp_link
+{
+  struct in6_addr prefix; /**< Prefix, with the host bits cleared. */
+  struct in6_addr addr;   /**< Address of the interface in the prefix. */
+  int prefixlen;          /**< Length of the prefix in bits. */
+  unsigned int ifindex;   /**< Index of the interface. */
+  uint8_t mac[6];         /**< Link-layer address of the interface. */
+  gboolean has_mac;       /**< Whether the link-layer address is known. */
+} ndp_link_t;
+
+GArray *
+ndp_links_new (void);
+
+const ndp_link_t *
+ndp_links_find (GArray *, const struct in6_addr *);
+
+void
+ndp_solicited_node (const struct in6_addr *, struct in6_addr *);
+
+/* Placement of threads on CPUs. */
+
+thread_cpus_t *
+thread_cpus_new (const char *, const char *);
+
+void
+thread_cpus_free (thread_cpus_t *);
+
+thread_cpus_t *
+thread_cpus_get (void);
+
+int
+thread_cpus_apply (const thread_cpus_t *);
+
 /* Misc hashtable functions. */
 
 int
@@ -77,7 +77,7 @@ Ensure (util, set_all_needed_sockets)
   alive_test = ALIVE_TEST_TCP_ACK_SERVICE | ALIVE_TEST_ICMP | ALIVE_TEST_ARP
                | ALIVE_TEST_CONSIDER_ALIVE | ALIVE_TEST_TCP_SYN_SERVICE;
   expect (__wrap_socket, will_return (5), times (8));
-  expect (__wrap_setsockopt, will_return (5), times (10));
+  expect (__wrap_setsockopt, will_return (5), times (12));
   set_all_needed_sockets (&scanner, alive_test);
 
   /* Only one method set. */
@@ -207,6 +207,174 @@ Ensure (util, fill_ports_array)
   g_array_free (ports_garray, TRUE);
 }
 
+Ensure (util, pacer_limits_packet_rate)
+{
+  struct sockaddr_in dst1 = {.sin_family = AF_INET};
+  struct sockaddr_in dst2 = {.sin_family = AF_INET};
+  struct sockaddr *sa1 = (struct sockaddr *) &dst1;
+  struct sockaddr *sa2 = (struct sockaddr *) &dst2;
+  pacer_t *pacer;
+  gint64 now;
+
+  assert_that (pacer_new (0, 0, 0), is_null);
+
+  /* 1000 packets per second, buckets hold 10 ms worth of tokens. */
+  pacer = pacer_new (1000, 0, 0);
+  now = pacer->packets.last;
+  for (int i = 0; i < 10; i++)
+    assert_that (pacer_reserve_at (pacer, NULL, 40, now), is_equal_to (0));
+  assert_that (pacer_reserve_at (pacer, NULL, 40, now), is_greater_than (0));
+  assert_that (pacer_reserve_at (pacer, NULL, 40, now + 1000000),
+               is_equal_to (0));
+  pacer_free (pacer);
+
+  /* One packet per second to a /24 subnet. */
+  pacer = pacer_new (0, 0, 1);
+  now = pacer->packets.last;
+  dst1.sin_addr.s_addr = inet_addr ("192.168.0.1");
+  dst2.sin_addr.s_addr = inet_addr ("192.168.1.1");
+  assert_that (pacer_reserve_at (pacer, sa1, 40, now), is_equal_to (0));
+  dst1.sin_addr.s_addr = inet_addr ("192.168.0.2");
+  assert_that (pacer_reserve_at (pacer, sa1, 40, now), is_greater_than (0));
+  assert_that (pacer_reserve_at (pacer, sa2, 40, now), is_equal_to (0));
+  assert_that (pacer_reserve_at (pacer, sa1, 40, now + 1000000000),
+               is_equal_to (0));
+  pacer_free (pacer);
+}
+
+Ensure (util, in_cksum_update_matches_in_cksum)
+{
+  uint16_t data[26], sum;
+  uint32_t addr = inet_addr ("192.168.0.1");
+  uint16_t port = htons (443);
+  static const uint32_t zero;
+
+  for (int i = 0; i < 26; i++)
+    data[i] = i * 0x1234;
+  memset (&data[8], 0, 4);
+  memset (&data[11], 0, 2);
+  sum = in_cksum (data, sizeof (data));
+
+  memcpy (&data[8], &addr, 4);
+  memcpy (&data[11], &port, 2);
+  sum = in_cksum_update (sum, &zero, &addr, 4);
+  sum = in_cksum_update (sum, &zero, &port, 2);
+  assert_that (sum, is_equal_to (in_cksum (data, sizeof (data))));
+}
+
+Ensure (util, addr_set_finds_added_addresses)
+{
+  addr_set_t *set;
+  struct in6_addr addr;
+  int i;
+
+  set = addr_set_new (2);
+  memset (&addr, 0, sizeof (addr));
+  assert_that (addr_set_contains (set, &addr), is_false);
+
+  /* Add more addresses than expected to make the set grow. */
+  for (i = 0; i < 1000; i++)
+    {
+      addr.s6_addr32[3] = htonl (i);
+      assert_that (addr_set_add (set, &addr), is_true);
+    }
+  for (i = 0; i < 1000; i++)
+    {
+      addr.s6_addr32[3] = htonl (i);
+      assert_that (addr_set_contains (set, &addr), is_true);
+      assert_that (addr_set_add (set, &addr), is_false);
+    }
+  addr.s6_addr32[3] = htonl (1000);
+  assert_that (addr_set_contains (set, &addr), is_false);
+  addr.s6_addr32[0] = htonl (1);
+  addr.s6_addr32[3] = htonl (1);
+  assert_that (addr_set_contains (set, &addr), is_false);
+  addr_set_free (set);
+}
+
+Ensure (util, rtt_estimator_computes_deadline)
+{
+  rtt_estimator_t *rtt;
+  addr_set_t *set;
+  struct in6_addr addr;
+
+  rtt = rtt_estimator_new ();
+  assert_that (rtt_estimator_deadline (rtt, 1000, 1), is_equal_to (0));
+
+  /* srtt = 100, rttvar = 50. */
+  rtt_estimator_add (rtt, 100, 500);
+  assert_that (rtt_estimator_deadline (rtt, 1000, 1), is_equal_to (1300));
+  assert_that (rtt_estimator_deadline (rtt, 1000, 2), is_equal_to (1600));
+  assert_that (rtt_estimator_deadline (rtt, 0, 1), is_equal_to (800));
+
+  /* rttvar = (3 * 50 + 100) / 4 = 62, srtt = (7 * 100 + 200) / 8 = 112. */
+  rtt_estimator_add (rtt, 200, 2000);
+  assert_that (rtt_estimator_deadline (rtt, 1000, 1),
+               is_equal_to (2000 + 112 + 4 * 62));
+  rtt_estimator_free (rtt);
+
+  set = addr_set_new (1);
+  memset (&addr, 0, sizeof (addr));
+  assert_that (addr_set_set_time (set, &addr, 42), is_false);
+  addr_set_add (set, &addr);
+  assert_that (addr_set_get_time (set, &addr), is_equal_to (0));
+  assert_that (addr_set_set_time (set, &addr, 42), is_true);
+  assert_that (addr_set_get_time (set, &addr), is_equal_to (42));
+  addr_set_free (set);
+}
+
+Ensure (util, ndp_links_find_the_link_of_an_address)
+{
+  GArray *links;
+  ndp_link_t link;
+  struct in6_addr addr, group, expected;
+
+  links = g_array_new (FALSE, TRUE, sizeof (ndp_link_t));
+  memset (&link, 0, sizeof (link));
+  inet_pton (AF_INET6, "2001:db8::", &link.prefix);
+  link.prefixlen = 32;
+  link.ifindex = 1;
+  g_array_append_val (links, link);
+  inet_pton (AF_INET6, "2001:db8:1:0:8000::", &link.prefix);
+  link.prefixlen = 65;
+  link.ifindex = 2;
+  g_array_append_val (links, link);
+
+  inet_pton (AF_INET6, "2001:db8:1:0:8000::5", &addr);
+  assert_that (ndp_links_find (links, &addr)->ifindex, is_equal_to (2));
+  inet_pton (AF_INET6, "2001:db8:1::5", &addr);
+  assert_that (ndp_links_find (links, &addr)->ifindex, is_equal_to (1));
+  inet_pton (AF_INET6, "2001:db9::5", &addr);
+  assert_that (ndp_links_find (links, &addr), is_null);
+  assert_that (ndp_links_find (NULL, &addr), is_null);
+  g_array_free (links, TRUE);
+
+  inet_pton (AF_INET6, "2001:db8::1:4567:89ab", &addr);
+  inet_pton (AF_INET6, "ff02::1:ff67:89ab", &expected);
+  ndp_solicited_node (&addr, &group);
+  assert_that (memcmp (&group, &expected, sizeof (group)), is_equal_to (0));
+}
+
+Ensure (util, thread_cpus_parse_cpu_lists)
+{
+  cpu_set_t set;
+  thread_cpus_t *cpus;
+
+  assert_that (thread_cpus_parse ("0-3,8\n", &set), is_equal_to (5));
+  assert_that (CPU_ISSET (3, &set), is_true);
+  assert_that (CPU_ISSET (4, &set), is_false);
+  assert_that (CPU_ISSET (8, &set), is_true);
+  assert_that (thread_cpus_parse ("2", &set), is_equal_to (1));
+  assert_that (thread_cpus_parse ("3-1", &set), is_equal_to (-1));
+  assert_that (thread_cpus_parse ("a", &set), is_equal_to (-1));
+
+  assert_that (thread_cpus_new (NULL, NULL), is_null);
+  assert_that (thread_cpus_new ("auto", NULL), is_null);
+  cpus = thread_cpus_new ("0", NULL);
+  assert_that (cpus, is_not_null);
+  thread_cpus_free (cpus);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -219,6 +387,12 @@ main (int argc, char **argv)
   add_test_with_context (suite, util, set_socket);
   add_test_with_context (suite, util, get_source_addr_v4);
   add_test_with_context (suite, util, get_source_addr_v6);
+  add_test_with_context (suite, util, pacer_limits_packet_rate);
+  add_test_with_context (suite, util, in_cksum_update_matches_in_cksum);
+  add_test_with_context (suite, util, addr_set_finds_added_addresses);
+  add_test_with_context (suite, util, rtt_estimator_computes_deadline);
+  add_test_with_context (suite, util, ndp_links_find_the_link_of_an_address);
+  add_test_with_context (suite, util, thread_cpus_parse_cpu_lists);
 
   if (argc > 1)
     return run_single_test (suite, argv[1], create_text_reporter ());
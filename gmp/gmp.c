@@ -19,7 +19,9 @@
 
 #include <errno.h>  /* for ERANGE, errno */
 #include <stdlib.h> /* for NULL, strtol, atoi */
+#include <string.h> /* for memchr, strcmp */
 #include <strings.h>
+#include <unistd.h> /* for write */
 
 #undef G_LOG_DOMAIN
 /**
@@ -1367,27 +1369,16 @@ gmp_get_targets (gnutls_session_t *session, const char *id, int tasks,
 }
 
 /**
- * @brief Get a report (generic version).
- *
- * FIXME: Using the according opts it should be possible to generate
- * any type of get_reports request defined by the spec.
+ * @brief Send a get_reports command.
  *
- * @param[in]  session   Pointer to GNUTLS session.
- * @param[in]  opts      Struct containing the options to apply.
- * @param[out] response  Report.  On success contains GET_REPORT response.
+ * @param[in]  session  Pointer to GNUTLS session.
+ * @param[in]  opts     Struct containing the options to apply.
  *
- * @return 0 on success, 2 on timeout, -1 or GMP response code on error.
+ * @return 0 on success, -1 on error.
  */
-int
-gmp_get_report_ext (gnutls_session_t *session, gmp_get_report_opts_t opts,
-                    entity_t *response)
+static int
+gmp_send_get_report (gnutls_session_t *session, gmp_get_report_opts_t opts)
 {
-  int ret;
-  const char *status_code;
-
-  if (response == NULL)
-    return -1;
-
   if (gvm_server_sendf (
         session,
         "<get_reports"
@@ -1433,6 +1424,33 @@ gmp_get_report_ext (gnutls_session_t *session, gmp_get_report_opts_t opts,
         GMP_FMT_BOOL_ATTRIB (opts, result_hosts_only),
         GMP_FMT_BOOL_ATTRIB (opts, ignore_pagination)))
     return -1;
+  return 0;
+}
+
+/**
+ * @brief Get a report (generic version).
+ *
+ * FIXME: Using the according opts it should be possible to generate
+ * any type of get_reports request defined by the spec.
+ *
+ * @param[in]  session   Pointer to GNUTLS session.
+ * @param[in]  opts      Struct containing the options to apply.
+ * @param[out] response  Report.  On success contains GET_REPORT response.
+ *
+ * @return 0 on success, 2 on timeout, -1 or GMP response code on error.
+ */
+int
+gmp_get_report_ext (gnutls_session_t *session, gmp_get_report_opts_t opts,
+                    entity_t *response)
+{
+  int ret;
+  const char *status_code;
+
+  if (response == NULL)
+    return -1;
+
+  if (gmp_send_get_report (session, opts))
+    return -1;
 
   *response = NULL;
   switch (try_read_entity (session, opts.timeout, response))
@@ -1467,6 +1485,348 @@ gmp_get_report_ext (gnutls_session_t *session, gmp_get_report_opts_t opts,
   return ret;
 }
 
+/**
+ * @brief What a streamed report writes.
+ */
+typedef enum
+{
+  REPORT_STREAM_UNKNOWN, ///< Report element not seen yet.
+  REPORT_STREAM_RAW,     ///< The response as read, for XML formats.
+  REPORT_STREAM_BASE64,  ///< The decoded text of the report element.
+  REPORT_STREAM_NONE,    ///< Nothing, for error responses.
+} report_stream_mode_t;
+
+/**
+ * @brief State of a streamed report.
+ */
+typedef struct
+{
+  GMarkupParseContext *context; ///< Parser for the markup.
+  report_stream_mode_t mode;    ///< What to write.
+  GString *held;                ///< Response read before the mode is known.
+  int depth;                    ///< Depth of the current element, root is 1.
+  int in_base64;                ///< Whether in the text of the report.
+  gint base64_state;            ///< State of the base64 decoder.
+  guint base64_save;            ///< Saved bits of the base64 decoder.
+  gchar *status;                ///< Status of the response.
+  int done;                     ///< Whether the response is complete.
+  int failed;                   ///< Whether writing failed.
+  gmp_report_write_func_t func; ///< Function to write with.
+  gpointer func_data;           ///< Data for func.
+} report_stream_t;
+
+/**
+ * @brief Handle the start of an element of a streamed report.
+ *
+ * @param[in]  context           Parser context.
+ * @param[in]  element_name      Element name.
+ * @param[in]  attribute_names   Attribute names.
+ * @param[in]  attribute_values  Attribute values.
+ * @param[in]  user_data         Report stream.
+ * @param[in]  error             Error parameter.
+ */
+static void
+report_stream_start_element (GMarkupParseContext *context,
+                             const gchar *element_name,
+                             const gchar **attribute_names,
+                             const gchar **attribute_values,
+                             gpointer user_data, GError **error)
+{
+  report_stream_t *stream = user_data;
+  int index;
+
+  (void) context;
+  (void) error;
+
+  stream->depth++;
+  if (stream->depth == 1)
+    {
+      for (index = 0; attribute_names[index]; index++)
+        if (strcmp (attribute_names[index], "status") == 0)
+          stream->status = g_strdup (attribute_values[index]);
+      if (stream->status == NULL || stream->status[0] != '2')
+        stream->mode = REPORT_STREAM_NONE;
+    }
+  else if (stream->depth == 2 && stream->mode == REPORT_STREAM_UNKNOWN
+           && strcmp (element_name, "report") == 0)
+    {
+      const char *content_type = NULL;
+
+      for (index = 0; attribute_names[index]; index++)
+        if (strcmp (attribute_names[index], "content_type") == 0)
+          content_type = attribute_values[index];
+      if (content_type && strcmp (content_type, "text/xml"))
+        {
+          stream->mode = REPORT_STREAM_BASE64;
+          stream->in_base64 = 1;
+        }
+      else
+        stream->mode = REPORT_STREAM_RAW;
+    }
+}
+
+/**
+ * @brief Handle the end of an element of a streamed report.
+ *
+ * @param[in]  context       Parser context.
+ * @param[in]  element_name  Element name.
+ * @param[in]  user_data     Report stream.
+ * @param[in]  error         Error parameter.
+ */
+static void
+report_stream_end_element (GMarkupParseContext *context,
+                           const gchar *element_name, gpointer user_data,
+                           GError **error)
+{
+  report_stream_t *stream = user_data;
+
+  (void) context;
+  (void) element_name;
+  (void) error;
+
+  stream->in_base64 = 0;
+  stream->depth--;
+  if (stream->depth == 0)
+    stream->done = 1;
+}
+
+/**
+ * @brief Write bytes of a streamed report.
+ *
+ * @param[in]  stream  Report stream.
+ * @param[in]  bytes   Bytes.
+ * @param[in]  count   Number of bytes.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+report_stream_write (report_stream_t *stream, const void *bytes, gsize count)
+{
+  if (count && stream->func (bytes, count, stream->func_data))
+    {
+      stream->failed = 1;
+      return -1;
+    }
+  return 0;
+}
+
+/**
+ * @brief Decode base64 text of a streamed report and write it.
+ *
+ * @param[in]  stream  Report stream.
+ * @param[in]  text    Base64 text.
+ * @param[in]  count   Length of text.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+report_stream_decode (report_stream_t *stream, const char *text, gsize count)
+{
+  guchar decoded[4096];
+
+  while (count)
+    {
+      /* Each 4 input bytes decode to at most 3, plus 3 saved bytes. */
+      gsize piece = MIN (count, 4 * ((sizeof (decoded) - 3) / 3));
+      gsize length;
+
+      length = g_base64_decode_step (text, piece, decoded,
+                                     &stream->base64_state,
+                                     &stream->base64_save);
+      if (report_stream_write (stream, decoded, length))
+        return -1;
+      text += piece;
+      count -= piece;
+    }
+  return 0;
+}
+
+/**
+ * @brief Handle a chunk of a streamed report.
+ *
+ * The base64 text of the report is decoded as it arrives instead of going
+ * to the parser, which would collect it.  Until the report element is seen
+ * the chunk goes to the parser a tag at a time, so that the text after it
+ * can be taken out.
+ *
+ * @param[in]  bytes  Chunk.
+ * @param[in]  count  Size of chunk.
+ * @param[in]  data   Report stream.
+ *
+ * @return 1 when the response is complete, 0 to read more, -1 on write error,
+ *         -2 on parse error.
+ */
+static int
+report_stream_chunk (const char *bytes, gsize count, gpointer data)
+{
+  report_stream_t *stream = data;
+  const char *end = bytes + count;
+
+  while (bytes < end && !stream->done)
+    {
+      const char *stop;
+      GError *error = NULL;
+
+      if (stream->in_base64)
+        {
+          stop = memchr (bytes, '<', end - bytes);
+          if (stop)
+            stream->in_base64 = 0;
+          else
+            stop = end;
+          if (report_stream_decode (stream, bytes, stop - bytes))
+            return -1;
+          bytes = stop;
+          continue;
+        }
+
+      if (stream->mode == REPORT_STREAM_UNKNOWN)
+        {
+          stop = memchr (bytes, '>', end - bytes);
+          stop = stop ? stop + 1 : end;
+          g_string_append_len (stream->held, bytes, stop - bytes);
+        }
+      else
+        stop = end;
+
+      if (!g_markup_parse_context_parse (stream->context, bytes, stop - bytes,
+                                         &error))
+        {
+          g_warning ("%s: %s", __func__, error->message);
+          g_error_free (error);
+          return -2;
+        }
+
+      if (stream->mode == REPORT_STREAM_RAW)
+        {
+          if (stream->held->len)
+            {
+              /* The held bytes include this piece. */
+              if (report_stream_write (stream, stream->held->str,
+                                       stream->held->len))
+                return -1;
+              g_string_truncate (stream->held, 0);
+            }
+          else if (report_stream_write (stream, bytes, stop - bytes))
+            return -1;
+        }
+      else if (stream->mode != REPORT_STREAM_UNKNOWN)
+        g_string_truncate (stream->held, 0);
+      bytes = stop;
+    }
+  return stream->done ? 1 : 0;
+}
+
+/**
+ * @brief Get a report, writing it while reading it.
+ *
+ * For a report format that gives XML the response is written as read.  For
+ * other formats the content of the report is decoded from base64 and
+ * written.  The memory used does not depend on the size of the report.
+ *
+ * Nothing is written for an error response.
+ *
+ * @param[in]  session    Pointer to GNUTLS session.
+ * @param[in]  opts       Struct containing the options to apply.
+ * @param[in]  func       Function to write the report with.
+ * @param[in]  func_data  Data for func.
+ *
+ * @return 0 on success, 2 on timeout, -1 or GMP response code on error.
+ */
+int
+gmp_get_report_stream (gnutls_session_t *session, gmp_get_report_opts_t opts,
+                       gmp_report_write_func_t func, gpointer func_data)
+{
+  GMarkupParser parser = {report_stream_start_element,
+                          report_stream_end_element, NULL, NULL, NULL};
+  report_stream_t stream;
+  int ret;
+
+  if (func == NULL)
+    return -1;
+
+  if (gmp_send_get_report (session, opts))
+    return -1;
+
+  memset (&stream, 0, sizeof (stream));
+  stream.mode = REPORT_STREAM_UNKNOWN;
+  stream.held = g_string_new ("");
+  stream.func = func;
+  stream.func_data = func_data;
+  stream.context = g_markup_parse_context_new (&parser, 0, &stream, NULL);
+
+  ret = try_read_chunks (session, opts.timeout, report_stream_chunk, &stream);
+  if (ret == -4)
+    ret = 2;
+  else if (ret)
+    ret = -1;
+  else if (stream.failed || stream.status == NULL)
+    ret = -1;
+  else if (stream.status[0] != '2')
+    {
+      errno = 0;
+      ret = (int) strtol (stream.status, NULL, 10);
+      if (errno == ERANGE || ret == 0)
+        ret = -1;
+    }
+
+  g_markup_parse_context_free (stream.context);
+  g_string_free (stream.held, TRUE);
+  g_free (stream.status);
+  return ret;
+}
+
+/**
+ * @brief Write a piece of a report to a file descriptor.
+ *
+ * @param[in]  bytes  Piece of the report.
+ * @param[in]  count  Size of the piece.
+ * @param[in]  data   Pointer to the file descriptor.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+report_write_fd (const void *bytes, gsize count, gpointer data)
+{
+  int fd = *(int *) data;
+  const char *next = bytes;
+
+  while (count)
+    {
+      ssize_t written = write (fd, next, count);
+
+      if (written < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          g_warning ("%s: failed to write report: %s", __func__,
+                     strerror (errno));
+          return -1;
+        }
+      next += written;
+      count -= written;
+    }
+  return 0;
+}
+
+/**
+ * @brief Get a report, writing it to a file descriptor while reading it.
+ *
+ * See gmp_get_report_stream.
+ *
+ * @param[in]  session  Pointer to GNUTLS session.
+ * @param[in]  opts     Struct containing the options to apply.
+ * @param[in]  fd       File descriptor to write the report to.
+ *
+ * @return 0 on success, 2 on timeout, -1 or GMP response code on error.
+ */
+int
+gmp_get_report_fd (gnutls_session_t *session, gmp_get_report_opts_t opts,
+                   int fd)
+{
+  return gmp_get_report_stream (session, opts, report_write_fd, &fd);
+}
+
 /**
  * @brief Delete a port list.
  *
@@ -2030,3 +2390,582 @@ gmp_get_system_reports_ext (gnutls_session_t *session,
   /* Read and check the response. */
   return gmp_check_response (session, reports);
 }
+
+/**
+ * @brief Most commands of a batch waiting for their responses.
+ */
+#define GMP_BATCH_WINDOW 16
+
+/**
+ * @brief Most bytes of commands of a batch waiting for their responses.
+ *
+ * The commands in flight must fit in the send buffer of the socket, else
+ * writing them could block while the manager is blocked writing a response.
+ */
+#define GMP_BATCH_WINDOW_BYTES (32 * 1024)
+
+/**
+ * @brief Batch of GMP commands sent back to back.
+ */
+struct gmp_batch
+{
+  GPtrArray *commands;  ///< Commands.
+  GPtrArray *responses; ///< Response of each command, NULL if none.
+  GArray *statuses;     ///< Status of each command.
+};
+
+/**
+ * @brief Create a batch of GMP commands.
+ *
+ * @return New batch, free with gmp_batch_free.
+ */
+gmp_batch_t *
+gmp_batch_new (void)
+{
+  gmp_batch_t *batch = g_malloc (sizeof (*batch));
+
+  batch->commands = g_ptr_array_new_with_free_func (g_free);
+  batch->responses =
+    g_ptr_array_new_with_free_func ((GDestroyNotify) free_entity);
+  batch->statuses = g_array_new (FALSE, FALSE, sizeof (int));
+  return batch;
+}
+
+/**
+ * @brief Free a batch of GMP commands, with the responses.
+ *
+ * @param[in]  batch  Batch.
+ */
+void
+gmp_batch_free (gmp_batch_t *batch)
+{
+  if (batch == NULL)
+    return;
+  g_ptr_array_free (batch->commands, TRUE);
+  g_ptr_array_free (batch->responses, TRUE);
+  g_array_free (batch->statuses, TRUE);
+  g_free (batch);
+}
+
+/**
+ * @brief Add a command to a batch.
+ *
+ * @param[in]  batch    Batch.
+ * @param[in]  command  Command, NUL terminated.  Freed with the batch.
+ *
+ * @return Index of the command in the batch.
+ */
+static int
+gmp_batch_append (gmp_batch_t *batch, gchar *command)
+{
+  int status = -1;
+
+  g_ptr_array_add (batch->commands, command);
+  g_ptr_array_add (batch->responses, NULL);
+  g_array_append_val (batch->statuses, status);
+  return batch->commands->len - 1;
+}
+
+/**
+ * @brief Add a command to a batch.
+ *
+ * @param[in]  batch   Batch.
+ * @param[in]  format  Format string for the command.
+ * @param[in]  ...     Arguments for the format string.
+ *
+ * @return Index of the command in the batch.
+ */
+int
+gmp_batch_add (gmp_batch_t *batch, const char *format, ...)
+{
+  va_list args;
+  gchar *command;
+
+  va_start (args, format);
+  command = g_strdup_vprintf (format, args);
+  va_end (args);
+  return gmp_batch_append (batch, command);
+}
+
+/**
+ * @brief Add a command to a batch, escaping the arguments for XML.
+ *
+ * @param[in]  batch   Batch.
+ * @param[in]  format  Format string for the command.
+ * @param[in]  ...     Arguments for the format string.
+ *
+ * @return Index of the command in the batch.
+ */
+int
+gmp_batch_add_xml (gmp_batch_t *batch, const char *format, ...)
+{
+  va_list args;
+  gchar *command;
+
+  va_start (args, format);
+  command = g_markup_vprintf_escaped (format, args);
+  va_end (args);
+  return gmp_batch_append (batch, command);
+}
+
+/**
+ * @brief Get the number of commands in a batch.
+ *
+ * @param[in]  batch  Batch.
+ *
+ * @return Number of commands.
+ */
+int
+gmp_batch_length (gmp_batch_t *batch)
+{
+  return batch->commands->len;
+}
+
+/**
+ * @brief Get the statuses of the commands of a batch that has run.
+ *
+ * A status is 0 on success, the GMP response code on error, or -1 if
+ * there was no response.
+ *
+ * @param[in]  batch  Batch.
+ *
+ * @return Array of gmp_batch_length statuses, owned by the batch.
+ */
+const int *
+gmp_batch_statuses (gmp_batch_t *batch)
+{
+  return (const int *) batch->statuses->data;
+}
+
+/**
+ * @brief Get the response to a command of a batch that has run.
+ *
+ * @param[in]  batch  Batch.
+ * @param[in]  index  Index of the command.
+ *
+ * @return Response, owned by the batch, NULL if none.
+ */
+entity_t
+gmp_batch_response (gmp_batch_t *batch, int index)
+{
+  if (index < 0 || (guint) index >= batch->responses->len)
+    return NULL;
+  return g_ptr_array_index (batch->responses, index);
+}
+
+/**
+ * @brief State of a running batch.
+ */
+typedef struct
+{
+  gvm_connection_t *connection; ///< Connection to the manager.
+  gmp_batch_t *batch;           ///< Batch.
+  guint sent;                   ///< Number of commands sent.
+  guint received;               ///< Number of responses received.
+  gsize in_flight;              ///< Bytes of the commands waiting.
+  entity_parser_t *parser;      ///< Parser of the next response.
+} gmp_batch_run_t;
+
+/**
+ * @brief Send the commands of a batch that fit in the window.
+ *
+ * @param[in]  run  Running batch.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+gmp_batch_send (gmp_batch_run_t *run)
+{
+  struct iovec iov[GMP_BATCH_WINDOW];
+  int count = 0;
+
+  while (run->sent < run->batch->commands->len
+         && run->sent - run->received < GMP_BATCH_WINDOW)
+    {
+      gchar *command = g_ptr_array_index (run->batch->commands, run->sent);
+      gsize length = strlen (command);
+
+      /* Always let one command go, however big. */
+      if (run->sent > run->received
+          && run->in_flight + length > GMP_BATCH_WINDOW_BYTES)
+        break;
+      iov[count].iov_base = command;
+      iov[count].iov_len = length;
+      count++;
+      run->in_flight += length;
+      run->sent++;
+    }
+  if (count && gvm_connection_sendv (run->connection, iov, count))
+    return -1;
+  return 0;
+}
+
+/**
+ * @brief Handle a chunk of the responses to a batch.
+ *
+ * @param[in]  bytes  Chunk.
+ * @param[in]  count  Size of chunk.
+ * @param[in]  data   Running batch.
+ *
+ * @return 1 when all responses are in, 0 to read more, -1 on send error, -2
+ *         on parse error.
+ */
+static int
+gmp_batch_chunk (const char *bytes, gsize count, gpointer data)
+{
+  gmp_batch_run_t *run = data;
+
+  while (count)
+    {
+      const char *status;
+      entity_t response;
+      gsize used;
+      int ret;
+
+      if (run->parser == NULL)
+        run->parser = entity_parser_new ();
+      ret = entity_parser_feed_part (run->parser, bytes, count, &used);
+      bytes += used;
+      count -= used;
+      if (ret < 0)
+        return -2;
+      if (ret == 0)
+        break;
+
+      response = entity_parser_take (run->parser);
+      entity_parser_free (run->parser);
+      run->parser = NULL;
+
+      status = entity_attribute (response, "status");
+      if (status && status[0] == '2')
+        ret = 0;
+      else if (status && status[0])
+        {
+          errno = 0;
+          ret = (int) strtol (status, NULL, 10);
+          if (errno == ERANGE || ret == 0)
+            ret = -1;
+        }
+      else
+        ret = -1;
+      g_array_index (run->batch->statuses, int, run->received) = ret;
+      g_ptr_array_index (run->batch->responses, run->received) = response;
+
+      run->in_flight -=
+        strlen (g_ptr_array_index (run->batch->commands, run->received));
+      run->received++;
+      if (run->received == run->batch->commands->len)
+        return 1;
+      if (gmp_batch_send (run))
+        return -1;
+    }
+  return 0;
+}
+
+/**
+ * @brief Run a batch of GMP commands on a connection.
+ *
+ * Writes the commands back to back and reads the responses in order, so
+ * that the commands do not each wait for the round trip of the one before.
+ * Only a window of commands is in flight at once.  The statuses and
+ * responses of the commands are available from the batch afterwards.
+ *
+ * A batch can only run once.
+ *
+ * @param[in]  connection  Connection to the manager, authenticated.
+ * @param[in]  batch       Batch.
+ *
+ * @return Number of commands that failed, -1 if the connection failed.
+ */
+int
+gmp_batch_run (gvm_connection_t *connection, gmp_batch_t *batch)
+{
+  gmp_batch_run_t run;
+  const int *statuses;
+  int ret, failed;
+  guint index;
+
+  if (connection == NULL || batch == NULL)
+    return -1;
+  if (batch->commands->len == 0)
+    return 0;
+
+  memset (&run, 0, sizeof (run));
+  run.connection = connection;
+  run.batch = batch;
+  ret = gmp_batch_send (&run);
+  if (ret == 0)
+    ret = try_read_chunks_c (connection, 0, gmp_batch_chunk, &run);
+  entity_parser_free (run.parser);
+  if (ret)
+    return -1;
+
+  failed = 0;
+  statuses = gmp_batch_statuses (batch);
+  for (index = 0; index < batch->commands->len; index++)
+    if (statuses[index])
+      failed++;
+  return failed;
+}
+
+/**
+ * @brief Pooled GMP session.
+ */
+typedef struct
+{
+  gvm_connection_t *connection; ///< Authenticated connection.
+  gchar *key;                   ///< Key of the credentials.
+  gint64 idle_since;            ///< Monotonic time when last given back.
+} gmp_pooled_session_t;
+
+/**
+ * @brief Pool of authenticated GMP sessions.
+ */
+struct gmp_session_pool
+{
+  GMutex mutex;               ///< Lock for idle and leased.
+  GHashTable *idle;           ///< Idle sessions, a GQueue per key.
+  GHashTable *leased;         ///< Leased sessions, by connection.
+  gmp_connect_func_t connect; ///< Function to open connections.
+  gpointer connect_data;      ///< Data for connect.
+  int max_idle;               ///< Maximum idle sessions per key.
+  int idle_timeout;           ///< Seconds after which idle sessions close.
+};
+
+/**
+ * @brief Close a pooled session.
+ *
+ * @param[in]  session  Session.
+ */
+static void
+pooled_session_free (gmp_pooled_session_t *session)
+{
+  if (session == NULL)
+    return;
+  gvm_connection_close (session->connection);
+  g_free (session->connection);
+  g_free (session->key);
+  g_free (session);
+}
+
+/**
+ * @brief Free a queue of idle sessions.
+ *
+ * @param[in]  queue  GQueue of sessions.
+ */
+static void
+idle_sessions_free (gpointer queue)
+{
+  g_queue_free_full (queue, (GDestroyNotify) pooled_session_free);
+}
+
+/**
+ * @brief Create a pool of authenticated GMP sessions.
+ *
+ * @param[in]  connect       Function that opens a new connection to the
+ *                           manager.
+ * @param[in]  connect_data  Data for connect.
+ * @param[in]  max_idle      Maximum idle sessions kept per credentials.
+ * @param[in]  idle_timeout  Seconds after which an idle session is closed,
+ *                           0 to keep idle sessions open.
+ *
+ * @return New pool, free with gmp_session_pool_free.
+ */
+gmp_session_pool_t *
+gmp_session_pool_new (gmp_connect_func_t connect, gpointer connect_data,
+                      int max_idle, int idle_timeout)
+{
+  gmp_session_pool_t *pool;
+
+  if (connect == NULL)
+    return NULL;
+
+  pool = g_malloc0 (sizeof (*pool));
+  g_mutex_init (&pool->mutex);
+  pool->idle =
+    g_hash_table_new_full (g_str_hash, g_str_equal, g_free, idle_sessions_free);
+  pool->leased = g_hash_table_new (g_direct_hash, g_direct_equal);
+  pool->connect = connect;
+  pool->connect_data = connect_data;
+  pool->max_idle = max_idle;
+  pool->idle_timeout = idle_timeout;
+  return pool;
+}
+
+/**
+ * @brief Free a pool of GMP sessions, closing the idle sessions.
+ *
+ * Sessions still leased are left open, for the caller to close with
+ * gvm_connection_close and free.
+ *
+ * @param[in]  pool  Pool.
+ */
+void
+gmp_session_pool_free (gmp_session_pool_t *pool)
+{
+  GHashTableIter iter;
+  gpointer session;
+
+  if (pool == NULL)
+    return;
+  g_hash_table_iter_init (&iter, pool->leased);
+  while (g_hash_table_iter_next (&iter, NULL, &session))
+    {
+      g_free (((gmp_pooled_session_t *) session)->key);
+      g_free (session);
+    }
+  g_hash_table_destroy (pool->idle);
+  g_hash_table_destroy (pool->leased);
+  g_mutex_clear (&pool->mutex);
+  g_free (pool);
+}
+
+/**
+ * @brief Get the pool key of credentials.
+ *
+ * The password only goes in as a hash, so that the key does not hold it.
+ *
+ * @param[in]  username  Username.
+ * @param[in]  password  Password.
+ *
+ * @return Key, free with g_free.
+ */
+static gchar *
+session_pool_key (const char *username, const char *password)
+{
+  gchar *hash, *key;
+
+  hash = g_compute_checksum_for_string (G_CHECKSUM_SHA256, password, -1);
+  key = g_strdup_printf ("%s\n%s", username, hash);
+  g_free (hash);
+  return key;
+}
+
+/**
+ * @brief Lease an authenticated session from a pool.
+ *
+ * An idle session of the same credentials is reused if the manager still
+ * answers a ping on it, else a new connection is opened and authenticated.
+ * Give the session back with gmp_session_pool_release.
+ *
+ * @param[in]   pool        Pool.
+ * @param[in]   username    Username.
+ * @param[in]   password    Password.
+ * @param[out]  connection  Authenticated connection.
+ *
+ * @return 0 on success, 1 if manager closed connection, 2 if auth failed,
+ *         3 on timeout, -1 on error.
+ */
+int
+gmp_session_pool_lease (gmp_session_pool_t *pool, const char *username,
+                        const char *password, gvm_connection_t **connection)
+{
+  gmp_authenticate_info_opts_t opts;
+  gmp_pooled_session_t *session = NULL;
+  GQueue *queue;
+  gchar *key;
+  gint64 now;
+  int ret;
+
+  if (pool == NULL || username == NULL || password == NULL
+      || connection == NULL)
+    return -1;
+  *connection = NULL;
+
+  key = session_pool_key (username, password);
+  now = g_get_monotonic_time ();
+  while (1)
+    {
+      g_mutex_lock (&pool->mutex);
+      queue = g_hash_table_lookup (pool->idle, key);
+      session = queue ? g_queue_pop_tail (queue) : NULL;
+      g_mutex_unlock (&pool->mutex);
+      if (session == NULL)
+        break;
+
+      /* Check outside the lock, a ping is a round trip. */
+      if ((pool->idle_timeout <= 0
+           || now - session->idle_since
+                < (gint64) pool->idle_timeout * G_USEC_PER_SEC)
+          && gmp_ping_c (session->connection, 0, NULL) == 0)
+        break;
+      pooled_session_free (session);
+    }
+
+  if (session == NULL)
+    {
+      session = g_malloc0 (sizeof (*session));
+      session->connection = pool->connect (pool->connect_data);
+      if (session->connection == NULL)
+        {
+          g_free (session);
+          g_free (key);
+          return -1;
+        }
+      opts = gmp_authenticate_info_opts_defaults;
+      opts.username = username;
+      opts.password = password;
+      ret = gmp_authenticate_info_ext_c (session->connection, opts);
+      if (ret)
+        {
+          pooled_session_free (session);
+          g_free (key);
+          return ret;
+        }
+      session->key = key;
+    }
+  else
+    g_free (key);
+
+  g_mutex_lock (&pool->mutex);
+  g_hash_table_insert (pool->leased, session->connection, session);
+  g_mutex_unlock (&pool->mutex);
+  *connection = session->connection;
+  return 0;
+}
+
+/**
+ * @brief Give a leased session back to its pool.
+ *
+ * A session on which a command failed should be given back as broken, so
+ * that it is closed instead of leased again.  Sessions beyond the idle
+ * limit of the pool are closed too.
+ *
+ * @param[in]  pool        Pool.
+ * @param[in]  connection  Connection from gmp_session_pool_lease.
+ * @param[in]  broken      Whether the session is unusable.
+ */
+void
+gmp_session_pool_release (gmp_session_pool_t *pool,
+                          gvm_connection_t *connection, int broken)
+{
+  gmp_pooled_session_t *session;
+  GQueue *queue;
+
+  if (pool == NULL || connection == NULL)
+    return;
+
+  g_mutex_lock (&pool->mutex);
+  session = g_hash_table_lookup (pool->leased, connection);
+  if (session)
+    g_hash_table_remove (pool->leased, connection);
+  if (session && !broken)
+    {
+      queue = g_hash_table_lookup (pool->idle, session->key);
+      if (queue == NULL)
+        {
+          queue = g_queue_new ();
+          g_hash_table_insert (pool->idle, g_strdup (session->key), queue);
+        }
+      if (g_queue_get_length (queue) < (guint) pool->max_idle)
+        {
+          session->idle_since = g_get_monotonic_time ();
+          g_queue_push_tail (queue, session);
+          session = NULL;
+        }
+    }
+  g_mutex_unlock (&pool->mutex);
+
+  /* Close outside the lock, a TLS close can take a while. */
+  pooled_session_free (session);
+}
@@ -349,6 +349,20 @@ gmp_get_targets (gnutls_session_t *, const char *, int, int, entity_t *);
 int
 gmp_get_report_ext (gnutls_session_t *, gmp_get_report_opts_t, entity_t *);
 
+/**
+ * @brief Function called with each piece of a streamed report.
+ *
+ * Returns 0 on success, -1 to give up.
+ */
+typedef int (*gmp_report_write_func_t) (const void *, gsize, gpointer);
+
+int
+gmp_get_report_stream (gnutls_session_t *, gmp_get_report_opts_t,
+                       gmp_report_write_func_t, gpointer);
+
+int
+gmp_get_report_fd (gnutls_session_t *, gmp_get_report_opts_t, int);
+
 int
 gmp_delete_port_list_ext (gnutls_session_t *, const char *, gmp_delete_opts_t);
 
@@ -398,4 +412,59 @@ int
 gmp_get_system_reports_ext (gnutls_session_t *, gmp_get_system_reports_opts_t,
                             entity_t *);
 
+/**
+ * @brief Batch of GMP commands sent back to back.
+ */
+typedef struct gmp_batch gmp_batch_t;
+
+gmp_batch_t *
+gmp_batch_new (void);
+
+void
+gmp_batch_free (gmp_batch_t *);
+
+int
+gmp_batch_add (gmp_batch_t *, const char *, ...)
+  __attribute__ ((format (printf, 2, 3)));
+
+int
+gmp_batch_add_xml (gmp_batch_t *, const char *, ...);
+
+int
+gmp_batch_length (gmp_batch_t *);
+
+int
+gmp_batch_run (gvm_connection_t *, gmp_batch_t *);
+
+const int *
+gmp_batch_statuses (gmp_batch_t *);
+
+entity_t
+gmp_batch_response (gmp_batch_t *, int);
+
+/**
+ * @brief Function that opens a new connection to the manager.
+ *
+ * Returns a connection allocated with g_malloc, or NULL on error.
+ */
+typedef gvm_connection_t *(*gmp_connect_func_t) (gpointer);
+
+/**
+ * @brief Pool of authenticated GMP sessions.
+ */
+typedef struct gmp_session_pool gmp_session_pool_t;
+
+gmp_session_pool_t *
+gmp_session_pool_new (gmp_connect_func_t, gpointer, int, int);
+
+void
+gmp_session_pool_free (gmp_session_pool_t *);
+
+int
+gmp_session_pool_lease (gmp_session_pool_t *, const char *, const char *,
+                        gvm_connection_t **);
+
+void
+gmp_session_pool_release (gmp_session_pool_t *, gvm_connection_t *, int);
+
 #endif /* not _GVM_GMP_H */
@@ -10,11 +10,16 @@
 
 #include "osp.h"
 
-#include "../base/hosts.h"       /* for gvm_get_host_type */
-#include "../util/serverutils.h" /* for gvm_server_close, gvm_server_open_w... */
+#include "../base/hosts.h"         /* for gvm_get_host_type */
+#include "../base/probes.h"        /* for GVM_PROBE1, GVM_PROBE2 */
+#include "../util/compressutils.h" /* for gvm_compress, gvm_uncompress */
+#include "../util/serverutils.h"   /* for gvm_server_close, gvm_server_o... */
 
 #include <assert.h>        /* for assert */
+#include <arpa/inet.h>     /* for htonl, ntohl */
+#include <errno.h>         /* for errno, EINTR */
 #include <gnutls/gnutls.h> /* for gnutls_session_int, gnutls_session_t */
+#include <poll.h>          /* for poll */
 #include <stdarg.h>        /* for va_list */
 #include <stdio.h>         /* for FILE, fprintf and related functions */
 #include <stdlib.h>        /* for NULL, atoi */
@@ -38,6 +43,43 @@ struct osp_connection
   int socket;               /**< Socket. */
   char *host;               /**< Host. */
   int port;                 /**< Port. */
+  int broken;               /**< Whether a command failed on it. */
+  int compress;             /**< Whether messages are compressed frames. */
+  gchar *pool_key;          /**< Key in the pool it came from, or NULL. */
+  gint64 idle_since;        /**< When it was returned to the pool. */
+  osp_metadata_cache_t *metadata_cache; /**< Cache of metadata, or NULL. */
+};
+
+/**
+ * @brief Pool of idle OSP connections.
+ */
+struct osp_connection_pool
+{
+  GMutex mutex;     /**< Lock for idle. */
+  GHashTable *idle; /**< Idle connections, a GQueue per key, newest last. */
+  int max_idle;     /**< Maximum idle connections per key. */
+  int idle_timeout; /**< Seconds after which idle connections are closed. */
+};
+
+/**
+ * @brief Cache of the metadata replies of OSP servers.
+ */
+struct osp_metadata_cache
+{
+  GMutex mutex;          /**< Lock for endpoints. */
+  GHashTable *endpoints; /**< Replies, a GHashTable per "host:port", of
+                              struct osp_metadata_reply per command. */
+  GHashTable *versions;  /**< VT feed version per "host:port". */
+  int ttl;               /**< Seconds after which a reply is stale. */
+};
+
+/**
+ * @brief Cached metadata reply of an OSP server.
+ */
+struct osp_metadata_reply
+{
+  gchar *xml;  /**< Reply. */
+  gint64 time; /**< When it was received, monotonic. */
 };
 
 /**
@@ -111,6 +153,158 @@ static int
 osp_send_command_str (osp_connection_t *, gchar **, const char *, ...)
   __attribute__ ((__format__ (__printf__, 3, 4)));
 
+static int
+osp_send_command_stream (osp_connection_t *, int, entity_stream_func_t,
+                         gpointer, entity_t *, const char *, ...)
+  __attribute__ ((__format__ (__printf__, 6, 7)));
+
+#ifndef OSP_FRAME_MAX
+/**
+ * @brief Largest compressed frame and uncompressed message accepted from a
+ *        server.
+ */
+#define OSP_FRAME_MAX (512 * 1024 * 1024)
+#endif
+
+/**
+ * @brief Read exactly a given number of bytes from an OSP server.
+ *
+ * @param[in]   connection  Connection to OSP server.
+ * @param[out]  buffer      Buffer for the bytes.
+ * @param[in]   length      Number of bytes to read.
+ *
+ * @return 0 on success, -1 on error or end of file.
+ */
+static int
+osp_read_exact (osp_connection_t *connection, void *buffer, gsize length)
+{
+  char *next = buffer;
+
+  while (length > 0)
+    {
+      ssize_t count;
+
+      if (*connection->host == '/')
+        {
+          count = read (connection->socket, next, length);
+          if (count < 0 && errno == EINTR)
+            continue;
+        }
+      else
+        {
+          count = gnutls_record_recv (connection->session, next, length);
+          if (count == GNUTLS_E_INTERRUPTED || count == GNUTLS_E_AGAIN)
+            continue;
+        }
+      if (count <= 0)
+        return -1;
+      next += count;
+      length -= count;
+    }
+  return 0;
+}
+
+/**
+ * @brief Send a message to an OSP server as a compressed frame.
+ *
+ * A frame is the length of the compressed message as 4 bytes in network
+ * order, followed by the message compressed with gvm_compress.
+ *
+ * @param[in]  connection  Connection to OSP server.
+ * @param[in]  message     Message.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+osp_write_frame (osp_connection_t *connection, const char *message)
+{
+  unsigned long length;
+  struct iovec iov[2];
+  guint32 header;
+  void *frame;
+  int ret;
+
+  frame = gvm_compress (message, strlen (message), &length);
+  if (frame == NULL || length > OSP_FRAME_MAX)
+    {
+      g_free (frame);
+      return -1;
+    }
+  header = htonl (length);
+  iov[0].iov_base = &header;
+  iov[0].iov_len = sizeof (header);
+  iov[1].iov_base = frame;
+  iov[1].iov_len = length;
+  if (*connection->host == '/')
+    ret = gvm_socket_sendv (connection->socket, iov, 2);
+  else
+    ret = gvm_server_sendv (&connection->session, iov, 2);
+  g_free (frame);
+  return ret ? -1 : 0;
+}
+
+/**
+ * @brief Read a compressed frame from an OSP server.
+ *
+ * @param[in]  connection  Connection to OSP server.
+ *
+ * @return Uncompressed message, NULL on error.
+ */
+static gchar *
+osp_read_frame (osp_connection_t *connection)
+{
+  unsigned long length;
+  guint32 header;
+  void *frame;
+  gchar *message;
+
+  if (osp_read_exact (connection, &header, sizeof (header)))
+    return NULL;
+  header = ntohl (header);
+  if (header == 0 || header > OSP_FRAME_MAX)
+    {
+      g_warning ("%s: bad frame length %u", __func__, header);
+      return NULL;
+    }
+  frame = g_malloc (header);
+  if (osp_read_exact (connection, frame, header))
+    {
+      g_free (frame);
+      return NULL;
+    }
+  /* The result has a zero byte after the data. */
+  message = gvm_uncompress_max (frame, header, OSP_FRAME_MAX, &length);
+  g_free (frame);
+  if (message == NULL)
+    g_warning ("%s: bad frame, or larger than %d bytes uncompressed",
+               __func__, OSP_FRAME_MAX);
+  return message;
+}
+
+/**
+ * @brief Send a command to an OSP server and read the reply, compressed.
+ *
+ * @param[in]  connection  Connection to OSP server.
+ * @param[in]  fmt         OSP Command to send.
+ * @param[in]  ap          Args for fmt.
+ *
+ * @return Reply, NULL on error.
+ */
+static gchar *
+osp_exchange_compressed (osp_connection_t *connection, const char *fmt,
+                         va_list ap)
+{
+  gchar *command;
+  int ret;
+
+  command = g_strdup_vprintf (fmt, ap);
+  ret = osp_write_frame (connection, command);
+  g_free (command);
+  if (ret)
+    return NULL;
+  return osp_read_frame (connection);
+}
+
 /**
  * @brief Open a new connection to an OSP server.
  *
@@ -196,6 +390,7 @@ int
 osp_send_command (osp_connection_t *connection, entity_t *response,
                   const char *fmt, ...)
 {
+  long long start = GVM_PROBE_USEC ();
   va_list ap;
   int rc = 1;
 
@@ -203,8 +398,22 @@ osp_send_command (osp_connection_t *connection, entity_t *response,
 
   if (!connection || !fmt || !response)
     goto out;
+  connection->broken = 1;
+  GVM_PROBE1 (osp_send_command_start, connection->compress);
 
-  if (*connection->host == '/')
+  if (connection->compress)
+    {
+      gchar *reply = osp_exchange_compressed (connection, fmt, ap);
+      int ret;
+
+      if (reply == NULL)
+        goto out;
+      ret = parse_entity (reply, response);
+      g_free (reply);
+      if (ret)
+        goto out;
+    }
+  else if (*connection->host == '/')
     {
       if (gvm_socket_vsendf (connection->socket, fmt, ap) == -1)
         goto out;
@@ -220,8 +429,10 @@ osp_send_command (osp_connection_t *connection, entity_t *response,
     }
 
   rc = 0;
+  connection->broken = 0;
 
 out:
+  GVM_PROBE2 (osp_send_command_end, rc, GVM_PROBE_USEC () - start);
   va_end (ap);
 
   return rc;
@@ -251,6 +462,17 @@ osp_send_command_str (osp_connection_t *connection, gchar **str,
 
   if (!connection || !fmt)
     goto out;
+  connection->broken = 1;
+
+  if (connection->compress)
+    {
+      *str = osp_exchange_compressed (connection, fmt, ap);
+      if (*str == NULL)
+        goto out;
+      rc = 0;
+      connection->broken = 0;
+      goto out;
+    }
 
   if (*connection->host == '/')
     {
@@ -274,30 +496,564 @@ osp_send_command_str (osp_connection_t *connection, gchar **str,
     goto out;
 
   rc = 0;
+  connection->broken = 0;
 
 out:
   va_end (ap);
 
-  return rc;
+  return rc;
+}
+
+/**
+ * @brief Send a command to an OSP server, streaming the elements of the
+ * @brief response at one depth.
+ *
+ * @param[in]   connection  Connection to OSP server.
+ * @param[in]   depth       Depth of the elements to stream, root is 0.
+ * @param[in]   func        Function called with each element at depth,
+ *                          which is freed after the call.
+ * @param[in]   func_data   Data for func.
+ * @param[out]  response    Rest of the response from OSP server.
+ * @param[in]   fmt         OSP Command to send.
+ *
+ * @return 0 and response, 1 if error.
+ */
+static int
+osp_send_command_stream (osp_connection_t *connection, int depth,
+                         entity_stream_func_t func, gpointer func_data,
+                         entity_t *response, const char *fmt, ...)
+{
+  va_list ap;
+  int rc;
+  gvm_connection_t conn;
+
+  rc = 1;
+
+  va_start (ap, fmt);
+
+  if (!connection || !fmt || !response)
+    goto out;
+  connection->broken = 1;
+
+  if (connection->compress)
+    {
+      gchar *reply = osp_exchange_compressed (connection, fmt, ap);
+      int ret;
+
+      if (reply == NULL)
+        goto out;
+      /* The whole reply is in memory already, stream it from the tree. */
+      ret = parse_entity (reply, response);
+      g_free (reply);
+      if (ret)
+        goto out;
+      entity_stream_children (*response, depth, func, func_data);
+      rc = 0;
+      connection->broken = 0;
+      goto out;
+    }
+
+  if (*connection->host == '/')
+    {
+      if (gvm_socket_vsendf (connection->socket, fmt, ap) == -1)
+        goto out;
+      conn.tls = 0;
+    }
+  else
+    {
+      if (gvm_server_vsendf (&connection->session, fmt, ap) == -1)
+        goto out;
+      conn.tls = 1;
+    }
+
+  conn.socket = connection->socket;
+  conn.session = connection->session;
+  conn.host_string = connection->host;
+  conn.port = connection->port;
+
+  if (try_read_entity_stream_c (&conn, 0, depth, func, func_data, response))
+    goto out;
+
+  rc = 0;
+  connection->broken = 0;
+
+out:
+  va_end (ap);
+
+  return rc;
+}
+
+/**
+ * @brief Close a connection to an OSP server.
+ *
+ * @param[in]   connection  Connection to OSP server to close.
+ */
+void
+osp_connection_close (osp_connection_t *connection)
+{
+  if (!connection)
+    return;
+
+  if (*connection->host == '/')
+    close (connection->socket);
+  else
+    gvm_server_close (connection->socket, connection->session);
+  g_free (connection->host);
+  g_free (connection->pool_key);
+  g_free (connection);
+}
+
+/**
+ * @brief Switch a connection to an OSP server to compressed messages.
+ *
+ * Sends set_compression with method zlib.  If the server accepts, all
+ * further commands and replies on the connection are compressed frames,
+ * handled inside the osp_* functions.  Servers that do not know the
+ * command reject it and the connection stays uncompressed.  Only useful
+ * with servers that keep connections open for several commands.
+ *
+ * @param[in]  connection  Connection to OSP server.
+ *
+ * @return 0 if compressed, 1 if not.
+ */
+int
+osp_connection_set_compression (osp_connection_t *connection)
+{
+  entity_t entity;
+  const char *status;
+  int accepted;
+
+  if (!connection)
+    return 1;
+  if (connection->compress)
+    return 0;
+
+  if (osp_send_command (connection, &entity,
+                        "<set_compression method='zlib'/>"))
+    return 1;
+  status = entity_attribute (entity, "status");
+  accepted = status && strcmp (status, "200") == 0;
+  free_entity (entity);
+  if (!accepted)
+    return 1;
+  connection->compress = 1;
+  return 0;
+}
+
+/**
+ * @brief Free a queue of idle connections, closing them.
+ *
+ * @param[in]  queue  Queue.
+ */
+static void
+idle_queue_free (gpointer queue)
+{
+  g_queue_free_full (queue, (GDestroyNotify) osp_connection_close);
+}
+
+/**
+ * @brief Create a pool of idle OSP connections.
+ *
+ * Connections taken with osp_connection_pool_get and given back with
+ * osp_connection_pool_put are kept open for the next command to the same
+ * server, saving the connect and TLS handshake.  A server that closes the
+ * connection after each command still works, the closed connections are
+ * noticed and dropped when taken.
+ *
+ * @param[in]  max_idle      Maximum idle connections kept per server.
+ * @param[in]  idle_timeout  Seconds after which an idle connection is
+ *                           closed, 0 for no limit.
+ *
+ * @return New pool.
+ */
+osp_connection_pool_t *
+osp_connection_pool_new (int max_idle, int idle_timeout)
+{
+  osp_connection_pool_t *pool;
+
+  pool = g_malloc0 (sizeof (*pool));
+  g_mutex_init (&pool->mutex);
+  pool->idle =
+    g_hash_table_new_full (g_str_hash, g_str_equal, g_free, idle_queue_free);
+  pool->max_idle = max_idle > 0 ? max_idle : 1;
+  pool->idle_timeout = idle_timeout;
+  return pool;
+}
+
+/**
+ * @brief Free a pool, closing its idle connections.
+ *
+ * @param[in]  pool  Pool.
+ */
+void
+osp_connection_pool_free (osp_connection_pool_t *pool)
+{
+  if (!pool)
+    return;
+
+  g_hash_table_destroy (pool->idle);
+  g_mutex_clear (&pool->mutex);
+  g_free (pool);
+}
+
+/**
+ * @brief Get the pool key of a server.
+ *
+ * @param[in]   host    Host of OSP server.
+ * @param[in]   port    Port of OSP server.
+ * @param[in]   cacert  CA public key.
+ * @param[in]   cert    Client public key.
+ * @param[in]   key     Client private key.
+ *
+ * @return Key, hashing the certificates, to not keep the private key.
+ */
+static gchar *
+pool_key (const char *host, int port, const char *cacert, const char *cert,
+          const char *key)
+{
+  GChecksum *checksum;
+  gchar *pool_key;
+
+  checksum = g_checksum_new (G_CHECKSUM_SHA256);
+  g_checksum_update (checksum, (const guchar *) (cacert ? cacert : ""), -1);
+  g_checksum_update (checksum, (const guchar *) "\n--\n", -1);
+  g_checksum_update (checksum, (const guchar *) (cert ? cert : ""), -1);
+  g_checksum_update (checksum, (const guchar *) "\n--\n", -1);
+  g_checksum_update (checksum, (const guchar *) (key ? key : ""), -1);
+  pool_key = g_strdup_printf ("%s:%d:%s", host ? host : "", port,
+                              g_checksum_get_string (checksum));
+  g_checksum_free (checksum);
+  return pool_key;
+}
+
+/**
+ * @brief Check whether an idle connection is still usable.
+ *
+ * The server sends nothing between commands, so anything to read means it
+ * closed the connection, or at least that the connection is out of step.
+ *
+ * @param[in]  connection  Idle connection.
+ *
+ * @return 1 if usable, else 0.
+ */
+static int
+connection_alive (osp_connection_t *connection)
+{
+  struct pollfd pfd;
+
+  if (*connection->host != '/'
+      && gnutls_record_check_pending (connection->session) > 0)
+    return 0;
+  pfd.fd = connection->socket;
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+  return poll (&pfd, 1, 0) == 0;
+}
+
+/**
+ * @brief Get a connection to an OSP server from a pool.
+ *
+ * Reuses the newest idle connection to the server that still works, else
+ * opens a new one.
+ *
+ * @param[in]   pool    Pool.
+ * @param[in]   host    Host of OSP server.
+ * @param[in]   port    Port of OSP server.
+ * @param[in]   cacert  CA public key.
+ * @param[in]   cert    Client public key.
+ * @param[in]   key     Client private key.
+ *
+ * @return Connection, to give back with osp_connection_pool_put, NULL if
+ *         error.
+ */
+osp_connection_t *
+osp_connection_pool_get (osp_connection_pool_t *pool, const char *host,
+                         int port, const char *cacert, const char *cert,
+                         const char *key)
+{
+  osp_connection_t *connection = NULL;
+  GSList *stale = NULL;
+  GQueue *queue;
+  gchar *key_string;
+  gint64 now;
+
+  if (!pool)
+    return NULL;
+
+  key_string = pool_key (host, port, cacert, cert, key);
+  now = g_get_monotonic_time ();
+  g_mutex_lock (&pool->mutex);
+  queue = g_hash_table_lookup (pool->idle, key_string);
+  while (queue && (connection = g_queue_pop_tail (queue)))
+    {
+      if ((pool->idle_timeout <= 0
+           || now - connection->idle_since
+                < (gint64) pool->idle_timeout * G_USEC_PER_SEC)
+          && connection_alive (connection))
+        break;
+      stale = g_slist_prepend (stale, connection);
+      connection = NULL;
+    }
+  g_mutex_unlock (&pool->mutex);
+
+  /* Close outside the lock, a TLS close can take a while. */
+  g_slist_free_full (stale, (GDestroyNotify) osp_connection_close);
+
+  if (connection == NULL)
+    {
+      connection = osp_connection_new (host, port, cacert, cert, key);
+      if (connection == NULL)
+        {
+          g_free (key_string);
+          return NULL;
+        }
+      connection->pool_key = key_string;
+    }
+  else
+    g_free (key_string);
+  return connection;
+}
+
+/**
+ * @brief Give a connection back to the pool it came from.
+ *
+ * Connections on which a command failed are closed, as are connections
+ * beyond the idle limit of the pool.
+ *
+ * @param[in]  pool        Pool.
+ * @param[in]  connection  Connection from osp_connection_pool_get.
+ */
+void
+osp_connection_pool_put (osp_connection_pool_t *pool,
+                         osp_connection_t *connection)
+{
+  GQueue *queue;
+
+  if (!connection)
+    return;
+  if (!pool || !connection->pool_key || connection->broken)
+    {
+      osp_connection_close (connection);
+      return;
+    }
+
+  connection->idle_since = g_get_monotonic_time ();
+  connection->metadata_cache = NULL;
+  g_mutex_lock (&pool->mutex);
+  queue = g_hash_table_lookup (pool->idle, connection->pool_key);
+  if (queue == NULL)
+    {
+      queue = g_queue_new ();
+      g_hash_table_insert (pool->idle, g_strdup (connection->pool_key), queue);
+    }
+  if (g_queue_get_length (queue) < (guint) pool->max_idle)
+    {
+      g_queue_push_tail (queue, connection);
+      connection = NULL;
+    }
+  g_mutex_unlock (&pool->mutex);
+
+  if (connection)
+    osp_connection_close (connection);
+}
+
+/**
+ * @brief Free a cached metadata reply.
+ *
+ * @param[in]  reply  Reply.
+ */
+static void
+metadata_reply_free (gpointer reply)
+{
+  g_free (((struct osp_metadata_reply *) reply)->xml);
+  g_free (reply);
+}
+
+/**
+ * @brief Create a cache of the metadata replies of OSP servers.
+ *
+ * The replies to the commands which only change when a server restarts or
+ * its VT feed is updated, like get_version, get_scanner_details,
+ * check_feed and the VTs version, are kept per server.  They are dropped
+ * when older than ttl, when a command to the server fails, and when a
+ * fresh VTs version of the server differs from the one they were cached
+ * with.  With a pool of connections, a cached command costs neither a
+ * connect nor a round trip.
+ *
+ * @param[in]  ttl  Seconds after which a reply is stale.
+ *
+ * @return New cache.
+ */
+osp_metadata_cache_t *
+osp_metadata_cache_new (int ttl)
+{
+  osp_metadata_cache_t *cache;
+
+  cache = g_malloc0 (sizeof (*cache));
+  g_mutex_init (&cache->mutex);
+  cache->endpoints = g_hash_table_new_full (
+    g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_hash_table_destroy);
+  cache->versions =
+    g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  cache->ttl = ttl > 0 ? ttl : 0;
+  return cache;
+}
+
+/**
+ * @brief Free a metadata cache.
+ *
+ * Connections using the cache must not be used for commands afterwards.
+ *
+ * @param[in]  cache  Cache.
+ */
+void
+osp_metadata_cache_free (osp_metadata_cache_t *cache)
+{
+  if (!cache)
+    return;
+
+  g_hash_table_destroy (cache->endpoints);
+  g_hash_table_destroy (cache->versions);
+  g_mutex_clear (&cache->mutex);
+  g_free (cache);
+}
+
+/**
+ * @brief Drop all the replies of a metadata cache.
+ *
+ * @param[in]  cache  Cache.
+ */
+void
+osp_metadata_cache_clear (osp_metadata_cache_t *cache)
+{
+  if (!cache)
+    return;
+
+  g_mutex_lock (&cache->mutex);
+  g_hash_table_remove_all (cache->endpoints);
+  g_hash_table_remove_all (cache->versions);
+  g_mutex_unlock (&cache->mutex);
 }
 
 /**
- * @brief Close a connection to an OSP server.
+ * @brief Make a connection use a metadata cache.
  *
- * @param[in]   connection  Connection to OSP server to close.
+ * The cache is shared by all connections to all servers, and must outlive
+ * them.  Connections given back to a pool stop using it.
+ *
+ * @param[in]  connection  Connection to OSP server.
+ * @param[in]  cache       Cache, NULL to stop using one.
  */
 void
-osp_connection_close (osp_connection_t *connection)
+osp_connection_set_metadata_cache (osp_connection_t *connection,
+                                   osp_metadata_cache_t *cache)
 {
-  if (!connection)
-    return;
+  if (connection)
+    connection->metadata_cache = cache;
+}
 
-  if (*connection->host == '/')
-    close (connection->socket);
-  else
-    gvm_server_close (connection->socket, connection->session);
-  g_free (connection->host);
-  g_free (connection);
+/**
+ * @brief Command getting the VTs version, which the metadata cache uses to
+ * notice feed updates.
+ */
+#define OSP_VTS_VERSION_COMMAND "<get_vts version_only='1'/>"
+
+/**
+ * @brief Send a metadata command to an OSP server, or get its cached reply.
+ *
+ * @param[in]   connection  Connection to OSP server.
+ * @param[out]  response    Response from OSP server.
+ * @param[in]   command     OSP Command to send.
+ *
+ * @return 0 and response, 1 if error.
+ */
+static int
+osp_send_command_cached (osp_connection_t *connection, entity_t *response,
+                         const char *command)
+{
+  osp_metadata_cache_t *cache;
+  struct osp_metadata_reply *reply;
+  GHashTable *replies;
+  const char *status;
+  gchar *endpoint, *xml = NULL;
+  gint64 now;
+
+  cache = connection ? connection->metadata_cache : NULL;
+  if (cache == NULL)
+    return osp_send_command (connection, response, "%s", command);
+
+  endpoint = g_strdup_printf ("%s:%d", connection->host, connection->port);
+  now = g_get_monotonic_time ();
+  g_mutex_lock (&cache->mutex);
+  replies = g_hash_table_lookup (cache->endpoints, endpoint);
+  reply = replies ? g_hash_table_lookup (replies, command) : NULL;
+  if (reply && now - reply->time < (gint64) cache->ttl * G_USEC_PER_SEC)
+    xml = g_strdup (reply->xml);
+  g_mutex_unlock (&cache->mutex);
+  if (xml)
+    {
+      int ret = parse_entity (xml, response);
+
+      g_free (xml);
+      if (ret == 0)
+        {
+          g_free (endpoint);
+          return 0;
+        }
+    }
+
+  if (osp_send_command_str (connection, &xml, "%s", command)
+      || parse_entity (xml, response))
+    {
+      /* The server may have restarted. */
+      g_mutex_lock (&cache->mutex);
+      g_hash_table_remove (cache->endpoints, endpoint);
+      g_hash_table_remove (cache->versions, endpoint);
+      g_mutex_unlock (&cache->mutex);
+      g_free (xml);
+      g_free (endpoint);
+      return 1;
+    }
+
+  status = entity_attribute (*response, "status");
+  if (status == NULL || *status != '2')
+    {
+      g_free (xml);
+      g_free (endpoint);
+      return 0;
+    }
+
+  g_mutex_lock (&cache->mutex);
+  if (strcmp (command, OSP_VTS_VERSION_COMMAND) == 0)
+    {
+      const char *version, *cached;
+
+      version = entity_attribute (entity_child (*response, "vts"),
+                                  "vts_version");
+      cached = g_hash_table_lookup (cache->versions, endpoint);
+      if (g_strcmp0 (version, cached))
+        {
+          /* The feed changed, so may have all the other metadata. */
+          g_hash_table_remove (cache->endpoints, endpoint);
+          g_hash_table_insert (cache->versions, g_strdup (endpoint),
+                               g_strdup (version));
+        }
+    }
+  replies = g_hash_table_lookup (cache->endpoints, endpoint);
+  if (replies == NULL)
+    {
+      replies = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                       metadata_reply_free);
+      g_hash_table_insert (cache->endpoints, g_strdup (endpoint), replies);
+    }
+  reply = g_malloc (sizeof (*reply));
+  reply->xml = xml;
+  reply->time = now;
+  g_hash_table_replace (replies, g_strdup (command), reply);
+  g_mutex_unlock (&cache->mutex);
+
+  g_free (endpoint);
+  return 0;
 }
 
 /**
@@ -325,7 +1081,7 @@ osp_check_feed (osp_connection_t *connection, int *lockfile_in_use,
   if (!connection)
     return 1;
 
-  if (osp_send_command (connection, &entity, "<check_feed/>"))
+  if (osp_send_command_cached (connection, &entity, "<check_feed/>"))
     return 1;
 
   status = entity_attribute (entity, "status");
@@ -417,7 +1173,7 @@ osp_get_version (osp_connection_t *connection, char **s_name, char **s_version,
   if (!connection)
     return 1;
 
-  if (osp_send_command (connection, &entity, "<get_version/>"))
+  if (osp_send_command_cached (connection, &entity, "<get_version/>"))
     return 1;
 
   child = entity_child (entity, "scanner");
@@ -499,14 +1255,11 @@ osp_get_vts_version (osp_connection_t *connection, char **vts_version,
   entity_t entity, vts;
   const char *version;
   const char *status, *status_text;
-  osp_get_vts_opts_t get_vts_opts;
 
   if (!connection)
     return 1;
 
-  get_vts_opts = osp_get_vts_opts_default;
-  get_vts_opts.version_only = 1;
-  if (osp_get_vts_ext (connection, get_vts_opts, &entity))
+  if (osp_send_command_cached (connection, &entity, OSP_VTS_VERSION_COMMAND))
     return 1;
 
   status = entity_attribute (entity, "status");
@@ -650,7 +1403,7 @@ osp_get_vts_ext (osp_connection_t *connection, osp_get_vts_opts_t opts,
 
   if (opts.version_only == 1)
     {
-      if (osp_send_command (connection, vts, "<get_vts version_only='1'/>"))
+      if (osp_send_command (connection, vts, OSP_VTS_VERSION_COMMAND))
         return 1;
       return 0;
     }
@@ -707,6 +1460,46 @@ osp_get_vts_ext_str (osp_connection_t *connection, osp_get_vts_opts_t opts,
   return 0;
 }
 
+/**
+ * @brief Get filtered set of VTs from an OSP server, one VT at a time.
+ *
+ * Each VT is parsed as it arrives and passed to func, then freed, so that
+ * the whole collection is never in memory at once.
+ *
+ * @param[in]   connection  Connection to an OSP server.
+ * @param[in]   opts        Struct containing the options to apply.
+ * @param[in]   func        Function called with each vt element, which must
+ *                          not keep it.
+ * @param[in]   func_data   Data for func.
+ * @param[out]  response    The response without the vt elements, for the
+ *                          status and the attributes of vts.
+ *
+ * @return 0 if success, 1 if error.
+ */
+int
+osp_get_vts_stream (osp_connection_t *connection, osp_get_vts_opts_t opts,
+                    entity_stream_func_t func, gpointer func_data,
+                    entity_t *response)
+{
+  if (!connection)
+    return 1;
+
+  if (func == NULL || response == NULL)
+    return 1;
+
+  /* get_vts_response > vts > vt. */
+  if (opts.version_only == 1)
+    return osp_send_command_stream (connection, 2, func, func_data, response,
+                                    "<get_vts version_only='1'/>");
+
+  if (opts.filter)
+    return osp_send_command_stream (connection, 2, func, func_data, response,
+                                    "<get_vts filter='%s'/>", opts.filter);
+
+  return osp_send_command_stream (connection, 2, func, func_data, response,
+                                  "<get_vts/>");
+}
+
 /**
  * @brief Delete a scan from an OSP server.
  *
@@ -807,6 +1600,33 @@ osp_get_performance_ext (osp_connection_t *connection,
   return 0;
 }
 
+/**
+ * @brief Get the scan status from its name in OSP.
+ *
+ * @param[in]  str  Name of the status, or NULL.
+ *
+ * @return Status, OSP_SCAN_STATUS_ERROR if unknown.
+ */
+static osp_scan_status_t
+osp_scan_status_from_str (const char *str)
+{
+  if (str == NULL)
+    return OSP_SCAN_STATUS_ERROR;
+  if (!strcmp (str, "queued"))
+    return OSP_SCAN_STATUS_QUEUED;
+  if (!strcmp (str, "init"))
+    return OSP_SCAN_STATUS_INIT;
+  if (!strcmp (str, "running"))
+    return OSP_SCAN_STATUS_RUNNING;
+  if (!strcmp (str, "stopped"))
+    return OSP_SCAN_STATUS_STOPPED;
+  if (!strcmp (str, "finished"))
+    return OSP_SCAN_STATUS_FINISHED;
+  if (!strcmp (str, "interrupted"))
+    return OSP_SCAN_STATUS_INTERRUPTED;
+  return OSP_SCAN_STATUS_ERROR;
+}
+
 /**
  * @brief Get a scan status from an OSP server
  *
@@ -858,43 +1678,180 @@ osp_get_scan_status_ext (osp_connection_t *connection,
       return status;
     }
 
-  if (!strcmp (entity_attribute (child, "status"), "queued"))
-    status = OSP_SCAN_STATUS_QUEUED;
-  else if (!strcmp (entity_attribute (child, "status"), "init"))
-    status = OSP_SCAN_STATUS_INIT;
-  else if (!strcmp (entity_attribute (child, "status"), "running"))
-    status = OSP_SCAN_STATUS_RUNNING;
-  else if (!strcmp (entity_attribute (child, "status"), "stopped"))
-    status = OSP_SCAN_STATUS_STOPPED;
-  else if (!strcmp (entity_attribute (child, "status"), "finished"))
-    status = OSP_SCAN_STATUS_FINISHED;
-  else if (!strcmp (entity_attribute (child, "status"), "interrupted"))
-    status = OSP_SCAN_STATUS_INTERRUPTED;
+  status = osp_scan_status_from_str (entity_attribute (child, "status"));
 
   free_entity (entity);
   return status;
 }
 
 /**
- * @brief Get a scan from an OSP server, optionally removing the results.
+ * @brief Set the status of a batch entry from a scan element.
+ *
+ * @param[in]  entry  Entry.
+ * @param[in]  scan   Scan element.
+ */
+static void
+scan_status_entry_set (osp_scan_status_entry_t *entry, entity_t scan)
+{
+  const char *progress;
+
+  entry->status = osp_scan_status_from_str (entity_attribute (scan, "status"));
+  progress = entity_attribute (scan, "progress");
+  entry->progress = progress ? atoi (progress) : -1;
+}
+
+/**
+ * @brief Data for streaming the scans of a batch status query.
+ */
+typedef struct
+{
+  GHashTable *entries; /**< Entries of the batch, by scan ID. */
+  int found;           /**< Number of entries set. */
+} scans_status_batch_t;
+
+/**
+ * @brief Set the batch entry of a streamed scan, if it has one.
+ *
+ * @param[in]  scan  Scan element.
+ * @param[in]  data  Batch.
+ */
+static void
+scans_status_batch_scan (entity_t scan, gpointer data)
+{
+  scans_status_batch_t *batch = data;
+  osp_scan_status_entry_t *entry;
+  const char *id;
+
+  id = entity_attribute (scan, "id");
+  if (id == NULL)
+    return;
+  entry = g_hash_table_lookup (batch->entries, id);
+  if (entry == NULL || entry->progress != -1)
+    return;
+  scan_status_entry_set (entry, scan);
+  batch->found++;
+}
+
+/**
+ * @brief Get the status and progress of several scans from an OSP server.
+ *
+ * Asks for all scans with one get_scans without a scan_id, streaming the
+ * scans so that unrelated ones are not kept.  If the server does not
+ * support that, falls back to one get_scans per scan.
+ *
+ * @param[in]      connection  Connection to an OSP server.
+ * @param[in,out]  scans       Entries with the scan IDs to get.  Status and
+ *                             progress are set, to OSP_SCAN_STATUS_ERROR and
+ *                             -1 for scans the server does not know.
+ * @param[in]      count       Number of entries.
+ * @param[out]     error       Pointer to error, if any.
+ *
+ * @return Number of scans found, -1 if error.
+ */
+int
+osp_get_scans_status_batch (osp_connection_t *connection,
+                            osp_scan_status_entry_t *scans, int count,
+                            char **error)
+{
+  scans_status_batch_t batch;
+  entity_t entity;
+  const char *status;
+  int index, rc;
+
+  if (!connection || (count > 0 && !scans))
+    {
+      if (error)
+        *error = g_strdup ("Couldn't send get_scans command "
+                           "to scanner. Not valid connection");
+      return -1;
+    }
+
+  batch.entries = g_hash_table_new (g_str_hash, g_str_equal);
+  batch.found = 0;
+  for (index = 0; index < count; index++)
+    {
+      assert (scans[index].scan_id);
+      scans[index].status = OSP_SCAN_STATUS_ERROR;
+      scans[index].progress = -1;
+      g_hash_table_insert (batch.entries, (gpointer) scans[index].scan_id,
+                           &scans[index]);
+    }
+
+  /* get_scans_response > scan. */
+  rc = osp_send_command_stream (connection, 1, scans_status_batch_scan, &batch,
+                                &entity,
+                                "<get_scans details='0' pop_results='0'/>");
+  g_hash_table_destroy (batch.entries);
+  if (rc)
+    {
+      if (error)
+        *error = g_strdup ("Couldn't send get_scans command to scanner");
+      return -1;
+    }
+  status = entity_attribute (entity, "status");
+  if (status && strcmp (status, "200") == 0)
+    {
+      free_entity (entity);
+      return batch.found;
+    }
+  free_entity (entity);
+
+  /* Older servers need a scan_id. */
+  batch.found = 0;
+  for (index = 0; index < count; index++)
+    {
+      entity_t scan;
+
+      if (osp_send_command (connection, &entity,
+                            "<get_scans scan_id='%s'"
+                            " details='0'"
+                            " pop_results='0'/>",
+                            scans[index].scan_id))
+        {
+          if (error)
+            *error = g_strdup ("Couldn't send get_scans command to scanner");
+          return -1;
+        }
+      scan = entity_child (entity, "scan");
+      if (scan)
+        {
+          scan_status_entry_set (&scans[index], scan);
+          batch.found++;
+        }
+      free_entity (entity);
+    }
+  return batch.found;
+}
+
+/**
+ * @brief Get a scan from an OSP server, with options for the results.
+ *
+ * With a result function the results are passed to it one at a time while
+ * the response is read, and are not in the report.  With max_results a
+ * poll with pop_results leaves the results beyond the maximum for the next
+ * poll.
  *
  * @param[in]   connection  Connection to an OSP server.
- * @param[in]   scan_id     ID of scan to get.
- * @param[out]  report_xml  Scans report.
- * @param[in]   details     0 for no scan details, 1 otherwise.
- * @param[in]   pop_results 0 to leave results, 1 to pop results from scanner.
+ * @param[in]   opts        Options.
+ * @param[out]  report_xml  Scan report as a string, or NULL.
+ * @param[out]  response    Parsed response, to free with free_entity, or
+ *                          NULL.  The scan is its scan child.
  * @param[out]  error       Pointer to error, if any.
  *
  * @return Scan progress if success, -1 if error.
  */
 int
-osp_get_scan_pop (osp_connection_t *connection, const char *scan_id,
-                  char **report_xml, int details, int pop_results, char **error)
+osp_get_scan_pop_ext (osp_connection_t *connection,
+                      osp_get_scan_pop_opts_t opts, char **report_xml,
+                      entity_t *response, char **error)
 {
   entity_t entity, child;
+  GString *command;
   int progress;
   int rc;
 
+  if (response)
+    *response = NULL;
   if (!connection)
     {
       if (error)
@@ -902,12 +1859,24 @@ osp_get_scan_pop (osp_connection_t *connection, const char *scan_id,
                            "to scanner. Not valid connection");
       return -1;
     }
-  assert (scan_id);
-  rc = osp_send_command (connection, &entity,
-                         "<get_scans scan_id='%s'"
-                         " details='%d'"
-                         " pop_results='%d'/>",
-                         scan_id, pop_results ? 1 : 0, details ? 1 : 0);
+  assert (opts.scan_id);
+
+  command = g_string_new ("");
+  g_string_printf (command,
+                   "<get_scans scan_id='%s' details='%d' pop_results='%d'",
+                   opts.scan_id, opts.details ? 1 : 0,
+                   opts.pop_results ? 1 : 0);
+  if (opts.max_results > 0)
+    g_string_append_printf (command, " max_results='%d'", opts.max_results);
+  g_string_append (command, "/>");
+  /* get_scans_response > scan > results > result. */
+  if (opts.result_func)
+    rc = osp_send_command_stream (connection, 3, opts.result_func,
+                                  opts.result_func_data, &entity, "%s",
+                                  command->str);
+  else
+    rc = osp_send_command (connection, &entity, "%s", command->str);
+  g_string_free (command, TRUE);
   if (rc)
     {
       if (error)
@@ -935,10 +1904,38 @@ osp_get_scan_pop (osp_connection_t *connection, const char *scan_id,
       print_entity_to_string (child, string);
       *report_xml = g_string_free (string, FALSE);
     }
-  free_entity (entity);
+  if (response)
+    *response = entity;
+  else
+    free_entity (entity);
   return progress;
 }
 
+/**
+ * @brief Get a scan from an OSP server, optionally removing the results.
+ *
+ * @param[in]   connection  Connection to an OSP server.
+ * @param[in]   scan_id     ID of scan to get.
+ * @param[out]  report_xml  Scans report.
+ * @param[in]   details     0 for no scan details, 1 otherwise.
+ * @param[in]   pop_results 0 to leave results, 1 to pop results from scanner.
+ * @param[out]  error       Pointer to error, if any.
+ *
+ * @return Scan progress if success, -1 if error.
+ */
+int
+osp_get_scan_pop (osp_connection_t *connection, const char *scan_id,
+                  char **report_xml, int details, int pop_results, char **error)
+{
+  osp_get_scan_pop_opts_t opts;
+
+  opts = osp_get_scan_pop_opts_default;
+  opts.scan_id = scan_id;
+  opts.details = details;
+  opts.pop_results = pop_results;
+  return osp_get_scan_pop_ext (connection, opts, report_xml, NULL, error);
+}
+
 /**
  * @brief Get a scan from an OSP server.
  *
@@ -1012,25 +2009,24 @@ osp_stop_scan (osp_connection_t *connection, const char *scan_id, char **error)
  *
  * @param[in]     key      Tag name for xml element.
  * @param[in]     value    Text for xml element.
- * @param[in,out] pstr     Parameters as xml concatenated xml elements.
+ * @param[in,out] xml      String to append the xml element to.
  *
  */
 static void
-option_concat_as_xml (gpointer key, gpointer value, gpointer pstr)
+option_concat_as_xml (gpointer key, gpointer value, gpointer xml)
 {
-  char *options_str, *tmp, *key_escaped, *value_escaped;
-
-  options_str = *(char **) pstr;
-
-  key_escaped = g_markup_escape_text ((char *) key, -1);
-  value_escaped = g_markup_escape_text ((char *) value, -1);
-  tmp = g_strdup_printf ("%s<%s>%s</%s>", options_str ? options_str : "",
-                         key_escaped, value_escaped, key_escaped);
-
-  g_free (options_str);
-  g_free (key_escaped);
-  g_free (value_escaped);
-  *(char **) pstr = tmp;
+  GString *string = xml;
+  gsize key_start, key_len;
+
+  g_string_append_c (string, '<');
+  key_start = string->len;
+  xml_string_append_escaped (string, (char *) key, -1);
+  key_len = string->len - key_start;
+  g_string_append_c (string, '>');
+  xml_string_append_escaped (string, (char *) value, -1);
+  g_string_append_len (string, "</", 2);
+  g_string_append_len (string, string->str + key_start, key_len);
+  g_string_append_c (string, '>');
 }
 
 /**
@@ -1051,7 +2047,7 @@ osp_start_scan (osp_connection_t *connection, const char *target,
                 char **error)
 {
   entity_t entity;
-  char *options_str = NULL;
+  GString *options_str;
   int status;
   int rc;
 
@@ -1065,15 +2061,16 @@ osp_start_scan (osp_connection_t *connection, const char *target,
 
   assert (target);
   /* Construct options string. */
+  options_str = g_string_new ("");
   if (options)
-    g_hash_table_foreach (options, option_concat_as_xml, &options_str);
+    g_hash_table_foreach (options, option_concat_as_xml, options_str);
 
   rc = osp_send_command (connection, &entity,
                          "<start_scan target='%s' ports='%s' scan_id='%s'>"
                          "<scanner_params>%s</scanner_params></start_scan>",
                          target, ports ? ports : "", scan_id ? scan_id : "",
-                         options_str ? options_str : "");
-  g_free (options_str);
+                         options_str->str);
+  g_string_free (options_str, TRUE);
   if (rc)
     {
       if (error)
@@ -1130,6 +2127,51 @@ credential_append_as_xml (osp_credential_t *credential, GString *xml_string)
   xml_string_append (xml_string, "</credential>");
 }
 
+/**
+ * @brief Append an element with text as XML.
+ *
+ * @param[in,out] xml_string  XML string buffer to append to.
+ * @param[in]     name        Name of the element.
+ * @param[in]     text        Text of the element, NULL for none.
+ */
+static void
+element_append_as_xml (GString *xml_string, const char *name,
+                       const char *text)
+{
+  g_string_append_c (xml_string, '<');
+  g_string_append (xml_string, name);
+  g_string_append_c (xml_string, '>');
+  xml_string_append_escaped (xml_string, text, -1);
+  g_string_append_len (xml_string, "</", 2);
+  g_string_append (xml_string, name);
+  g_string_append_c (xml_string, '>');
+}
+
+/**
+ * @brief Estimate the size of targets as XML.
+ *
+ * @param[in]  targets  List of targets.
+ *
+ * @return Size of the hosts and ports of the targets, plus some markup.
+ */
+static gsize
+targets_xml_size (GSList *targets)
+{
+  gsize size = 0;
+
+  for (; targets; targets = targets->next)
+    {
+      osp_target_t *target = targets->data;
+
+      size += 512;
+      size += target->hosts ? strlen (target->hosts) : 0;
+      size += target->exclude_hosts ? strlen (target->exclude_hosts) : 0;
+      size += target->finished_hosts ? strlen (target->finished_hosts) : 0;
+      size += target->ports ? strlen (target->ports) : 0;
+    }
+  return size;
+}
+
 /**
  * @brief Concatenate a target as XML.
  *
@@ -1140,16 +2182,11 @@ credential_append_as_xml (osp_credential_t *credential, GString *xml_string)
 static void
 target_append_as_xml (osp_target_t *target, GString *xml_string)
 {
-  xml_string_append (xml_string,
-                     "<target>"
-                     "<hosts>%s</hosts>"
-                     "<exclude_hosts>%s</exclude_hosts>"
-                     "<finished_hosts>%s</finished_hosts>"
-                     "<ports>%s</ports>",
-                     target->hosts ? target->hosts : "",
-                     target->exclude_hosts ? target->exclude_hosts : "",
-                     target->finished_hosts ? target->finished_hosts : "",
-                     target->ports ? target->ports : "");
+  g_string_append (xml_string, "<target>");
+  element_append_as_xml (xml_string, "hosts", target->hosts);
+  element_append_as_xml (xml_string, "exclude_hosts", target->exclude_hosts);
+  element_append_as_xml (xml_string, "finished_hosts", target->finished_hosts);
+  element_append_as_xml (xml_string, "ports", target->ports);
 
   /* Alive test specified as bitfield */
   if (target->alive_test > 0)
@@ -1201,7 +2238,9 @@ target_append_as_xml (osp_target_t *target, GString *xml_string)
 static void
 vt_group_append_as_xml (osp_vt_group_t *vt_group, GString *xml_string)
 {
-  xml_string_append (xml_string, "<vt_group filter=\"%s\"/>", vt_group->filter);
+  g_string_append (xml_string, "<vt_group filter=\"");
+  xml_string_append_escaped (xml_string, vt_group->filter, -1);
+  g_string_append (xml_string, "\"/>");
 }
 
 /**
@@ -1215,8 +2254,11 @@ vt_group_append_as_xml (osp_vt_group_t *vt_group, GString *xml_string)
 static void
 vt_value_append_as_xml (gpointer id, gchar *value, GString *xml_string)
 {
-  xml_string_append (xml_string, "<vt_value id=\"%s\">%s</vt_value>",
-                     id ? id : "", value ? value : "");
+  g_string_append (xml_string, "<vt_value id=\"");
+  xml_string_append_escaped (xml_string, id, -1);
+  g_string_append (xml_string, "\">");
+  xml_string_append_escaped (xml_string, value, -1);
+  g_string_append (xml_string, "</vt_value>");
 }
 
 /**
@@ -1228,10 +2270,49 @@ vt_value_append_as_xml (gpointer id, gchar *value, GString *xml_string)
 static void
 vt_single_append_as_xml (osp_vt_single_t *vt_single, GString *xml_string)
 {
-  xml_string_append (xml_string, "<vt_single id=\"%s\">", vt_single->vt_id);
+  g_string_append (xml_string, "<vt_single id=\"");
+  xml_string_append_escaped (xml_string, vt_single->vt_id, -1);
+  g_string_append (xml_string, "\">");
   g_hash_table_foreach (vt_single->vt_values, (GHFunc) vt_value_append_as_xml,
                         xml_string);
-  xml_string_append (xml_string, "</vt_single>");
+  g_string_append (xml_string, "</vt_single>");
+}
+
+/**
+ * @brief Size of the pieces of a start_scan command sent to the scanner.
+ */
+#define START_SCAN_CHUNK (64 * 1024)
+
+/**
+ * @brief Send the buffered part of a start_scan command to an OSP server.
+ *
+ * Does nothing while the buffer is smaller than the threshold, or when the
+ * connection is compressed, because a frame holds the whole command.
+ *
+ * @param[in]      connection  Connection to OSP server.
+ * @param[in,out]  xml         Buffered part of the command.  Emptied when
+ *                             sent.
+ * @param[in]      threshold   Minimum size to send.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+start_scan_flush (osp_connection_t *connection, GString *xml, gsize threshold)
+{
+  struct iovec iov;
+  int ret;
+
+  if (connection->compress || xml->len == 0 || xml->len < threshold)
+    return 0;
+
+  iov.iov_base = xml->str;
+  iov.iov_len = xml->len;
+  if (*connection->host == '/')
+    ret = gvm_socket_sendv (connection->socket, &iov, 1);
+  else
+    ret = gvm_server_sendv (&connection->session, &iov, 1);
+  g_string_truncate (xml, 0);
+  return ret ? -1 : 0;
 }
 
 /**
@@ -1247,15 +2328,11 @@ int
 osp_start_scan_ext (osp_connection_t *connection, osp_start_scan_opts_t opts,
                     char **error)
 {
-  gchar *scanner_params_xml = NULL;
   GString *xml;
   GSList *list_item;
-  int list_count;
   int rc, status;
   entity_t entity;
-  gchar *cmd;
-  char filename[] = "/tmp/osp-cmd-XXXXXX";
-  int fd;
+  gsize size;
 
   if (!connection)
     {
@@ -1265,70 +2342,74 @@ osp_start_scan_ext (osp_connection_t *connection, osp_start_scan_opts_t opts,
       return -1;
     }
 
-  fd = mkstemp (filename);
-  FILE *file = fdopen (fd, "w");
+  /* A compressed frame needs the whole command, otherwise the buffer only
+   * has to hold one chunk and the piece that crosses it. */
+  size = 10240 + targets_xml_size (opts.targets);
+  if (connection->compress)
+    size += 128 * g_slist_length (opts.vts);
+  else
+    size = MIN (size, 2 * START_SCAN_CHUNK);
+  xml = g_string_sized_new (size);
+
+  connection->broken = 1;
+  rc = 1;
 
-  xml = g_string_sized_new (10240);
-  g_string_append (xml, "<start_scan");
-  xml_string_append (xml, " scan_id=\"%s\">", opts.scan_id ? opts.scan_id : "");
+  g_string_append (xml, "<start_scan scan_id=\"");
+  xml_string_append_escaped (xml, opts.scan_id, -1);
+  g_string_append (xml, "\">");
 
   g_string_append (xml, "<targets>");
-  g_slist_foreach (opts.targets, (GFunc) target_append_as_xml, xml);
+  for (list_item = opts.targets; list_item; list_item = list_item->next)
+    {
+      target_append_as_xml (list_item->data, xml);
+      if (start_scan_flush (connection, xml, START_SCAN_CHUNK))
+        goto out;
+    }
   g_string_append (xml, "</targets>");
 
   g_string_append (xml, "<scanner_params>");
   if (opts.scanner_params)
-    {
-      scanner_params_xml = NULL;
-      g_hash_table_foreach (opts.scanner_params, (GHFunc) option_concat_as_xml,
-                            &scanner_params_xml);
-      if (scanner_params_xml)
-        g_string_append (xml, scanner_params_xml);
-      g_free (scanner_params_xml);
-    }
+    g_hash_table_foreach (opts.scanner_params, (GHFunc) option_concat_as_xml,
+                          xml);
   g_string_append (xml, "</scanner_params>");
 
   g_string_append (xml, "<vt_selection>");
   g_slist_foreach (opts.vt_groups, (GFunc) vt_group_append_as_xml, xml);
-
-  fprintf (file, "%s", xml->str);
-
-  g_string_free (xml, TRUE);
-
-  xml = g_string_new ("");
-  list_item = opts.vts;
-  list_count = 0;
-  while (list_item)
+  for (list_item = opts.vts; list_item; list_item = list_item->next)
     {
-      list_count++;
       vt_single_append_as_xml (list_item->data, xml);
-
-      list_item = list_item->next;
-
-      if (list_count == 1000)
-        {
-          fprintf (file, "%s", xml->str);
-
-          g_string_free (xml, TRUE);
-          xml = g_string_new ("");
-          list_count = 0;
-        }
+      if (start_scan_flush (connection, xml, START_SCAN_CHUNK))
+        goto out;
     }
-
   g_string_append (xml, "</vt_selection>");
   g_string_append (xml, "</start_scan>");
 
-  fprintf (file, "%s", xml->str);
-  fflush (file);
-  fclose (file);
-  g_string_free (xml, TRUE);
-
-  g_file_get_contents (filename, &cmd, NULL, NULL);
+  if (connection->compress)
+    {
+      gchar *reply;
 
-  rc = osp_send_command (connection, &entity, "%s", cmd);
+      if (osp_write_frame (connection, xml->str))
+        goto out;
+      reply = osp_read_frame (connection);
+      if (reply == NULL)
+        goto out;
+      rc = parse_entity (reply, &entity);
+      g_free (reply);
+    }
+  else
+    {
+      if (start_scan_flush (connection, xml, 0))
+        goto out;
+      if (*connection->host == '/')
+        rc = read_entity_s (connection->socket, &entity);
+      else
+        rc = read_entity (&connection->session, &entity);
+    }
+  if (rc == 0)
+    connection->broken = 0;
 
-  g_free (cmd);
-  unlink (filename);
+out:
+  g_string_free (xml, TRUE);
 
   if (rc)
     {
@@ -1443,7 +2524,8 @@ osp_get_scanner_details (osp_connection_t *connection, char **desc,
 
   assert (connection);
 
-  if (osp_send_command (connection, &entity, "<get_scanner_details/>"))
+  if (osp_send_command_cached (connection, &entity,
+                               "<get_scanner_details/>"))
     return 1;
   if (params)
     {
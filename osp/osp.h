@@ -19,6 +19,10 @@
 
 typedef struct osp_connection osp_connection_t;
 
+typedef struct osp_connection_pool osp_connection_pool_t;
+
+typedef struct osp_metadata_cache osp_metadata_cache_t;
+
 typedef struct osp_credential osp_credential_t;
 
 typedef struct osp_target osp_target_t;
@@ -61,6 +65,13 @@ typedef struct
   const char *scan_id; ///< UUID of the scan which get the status from.
 } osp_get_scan_status_opts_t;
 
+typedef struct
+{
+  const char *scan_id;      ///< UUID of the scan.
+  osp_scan_status_t status; ///< Status of the scan.
+  int progress;             ///< Progress of the scan, -1 if unknown.
+} osp_scan_status_entry_t;
+
 typedef struct
 {
   int start;    /**< Start interval. */
@@ -79,6 +90,35 @@ osp_connection_new (const char *, int, const char *, const char *,
 void
 osp_connection_close (osp_connection_t *);
 
+int
+osp_connection_set_compression (osp_connection_t *);
+
+osp_connection_pool_t *
+osp_connection_pool_new (int, int);
+
+void
+osp_connection_pool_free (osp_connection_pool_t *);
+
+osp_connection_t *
+osp_connection_pool_get (osp_connection_pool_t *, const char *, int,
+                         const char *, const char *, const char *);
+
+void
+osp_connection_pool_put (osp_connection_pool_t *, osp_connection_t *);
+
+osp_metadata_cache_t *
+osp_metadata_cache_new (int);
+
+void
+osp_metadata_cache_free (osp_metadata_cache_t *);
+
+void
+osp_metadata_cache_clear (osp_metadata_cache_t *);
+
+void
+osp_connection_set_metadata_cache (osp_connection_t *,
+                                   osp_metadata_cache_t *);
+
 /* OSP commands */
 int
 osp_check_feed (osp_connection_t *, int *, int *, char **, char **);
@@ -114,6 +154,10 @@ osp_get_vts_ext (osp_connection_t *, osp_get_vts_opts_t, entity_t *);
 int
 osp_get_vts_ext_str (osp_connection_t *, osp_get_vts_opts_t, gchar **);
 
+int
+osp_get_vts_stream (osp_connection_t *, osp_get_vts_opts_t,
+                    entity_stream_func_t, gpointer, entity_t *);
+
 int
 osp_start_scan (osp_connection_t *, const char *, const char *, GHashTable *,
                 const char *, char **);
@@ -136,10 +180,34 @@ osp_get_scan (osp_connection_t *, const char *, char **, int, char **);
 int
 osp_get_scan_pop (osp_connection_t *, const char *, char **, int, int, char **);
 
+typedef struct
+{
+  const char *scan_id;              ///< UUID of the scan to get.
+  int details;                      ///< Whether to get the scan details.
+  int pop_results;                  ///< Whether to remove the results got.
+  int max_results;                  ///< Maximum results to get, 0 for all.
+  entity_stream_func_t result_func; ///< Function for each result, or NULL.
+  gpointer result_func_data;        ///< Data for result_func.
+} osp_get_scan_pop_opts_t;
+
+/**
+ * @brief Sensible default values for osp_get_scan_pop_opts_t
+ */
+static const osp_get_scan_pop_opts_t osp_get_scan_pop_opts_default = {
+  NULL, 0, 0, 0, NULL, NULL};
+
+int
+osp_get_scan_pop_ext (osp_connection_t *, osp_get_scan_pop_opts_t, char **,
+                      entity_t *, char **);
+
 osp_scan_status_t
 osp_get_scan_status_ext (osp_connection_t *, osp_get_scan_status_opts_t,
                          char **);
 
+int
+osp_get_scans_status_batch (osp_connection_t *, osp_scan_status_entry_t *, int,
+                            char **);
+
 int
 osp_delete_scan (osp_connection_t *, const char *);
 
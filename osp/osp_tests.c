@@ -3,6 +3,9 @@
  * SPDX-License-Identifier: GPL-2.0-or-later
  */
 
+/* Small enough for the tests to exceed it. */
+#define OSP_FRAME_MAX (64 * 1024)
+
 #include "osp.c"
 
 #include <cgreen/cgreen.h>
@@ -26,6 +29,422 @@ Ensure (osp, osp_new_conn_ret_null)
   assert_that (osp_connection_new ("/my/socket", 0, NULL, NULL, NULL), is_null);
 }
 
+Ensure (osp, osp_connection_pool_reuses_live_connections)
+{
+  osp_connection_pool_t *pool;
+  osp_connection_t *first, *second;
+  struct sockaddr_un addr;
+  gchar *dir, *path;
+  int listener, peer;
+
+  dir = g_dir_make_tmp ("osp-pool-XXXXXX", NULL);
+  assert_that (dir, is_not_null);
+  path = g_build_filename (dir, "ospd.sock", NULL);
+  memset (&addr, 0, sizeof (addr));
+  addr.sun_family = AF_UNIX;
+  g_strlcpy (addr.sun_path, path, sizeof (addr.sun_path));
+  listener = socket (AF_UNIX, SOCK_STREAM, 0);
+  assert_that (bind (listener, (struct sockaddr *) &addr, sizeof (addr)),
+               is_equal_to (0));
+  assert_that (listen (listener, 4), is_equal_to (0));
+
+  pool = osp_connection_pool_new (2, 0);
+  first = osp_connection_pool_get (pool, path, 0, NULL, NULL, NULL);
+  assert_that (first, is_not_null);
+  peer = accept (listener, NULL, NULL);
+  osp_connection_pool_put (pool, first);
+
+  /* Still open, so it is handed out again. */
+  second = osp_connection_pool_get (pool, path, 0, NULL, NULL, NULL);
+  assert_that (second, is_equal_to (first));
+  osp_connection_pool_put (pool, second);
+
+  /* Closed by the server, so it is replaced. */
+  close (peer);
+  second = osp_connection_pool_get (pool, path, 0, NULL, NULL, NULL);
+  assert_that (second, is_not_null);
+  assert_that (second->socket, is_not_equal_to (-1));
+  assert_that (connection_alive (second), is_true);
+  osp_connection_pool_put (pool, second);
+
+  osp_connection_pool_free (pool);
+  close (listener);
+  unlink (path);
+  rmdir (dir);
+  g_free (path);
+  g_free (dir);
+}
+
+/**
+ * @brief Collect the id of a streamed VT.
+ *
+ * @param[in]  vt    VT element.
+ * @param[in]  data  GPtrArray of ids.
+ */
+static void
+collect_vt_id (entity_t vt, gpointer data)
+{
+  g_ptr_array_add (data, g_strdup (entity_attribute (vt, "id")));
+}
+
+/**
+ * @brief Collect the name of a streamed result.
+ *
+ * @param[in]  result  Result element.
+ * @param[in]  data    GPtrArray of names.
+ */
+static void
+collect_name (entity_t result, gpointer data)
+{
+  g_ptr_array_add (data, g_strdup (entity_attribute (result, "name")));
+}
+
+Ensure (osp, osp_get_vts_stream_calls_func_per_vt)
+{
+  osp_connection_t connection;
+  osp_get_vts_opts_t opts;
+  entity_t response;
+  GPtrArray *ids;
+  int sockets[2];
+  const char *xml;
+
+  xml = "<get_vts_response status=\"200\"><vts total=\"2\">"
+        "<vt id=\"1.2.3\"><name>a</name></vt>"
+        "<vt id=\"1.2.4\"><name>b</name></vt>"
+        "</vts></get_vts_response>";
+  assert_that (socketpair (AF_UNIX, SOCK_STREAM, 0, sockets), is_equal_to (0));
+  assert_that (write (sockets[1], xml, strlen (xml)),
+               is_equal_to (strlen (xml)));
+
+  memset (&connection, 0, sizeof (connection));
+  connection.socket = sockets[0];
+  connection.host = "/ospd.sock";
+  opts = osp_get_vts_opts_default;
+  ids = g_ptr_array_new_with_free_func (g_free);
+  assert_that (
+    osp_get_vts_stream (&connection, opts, collect_vt_id, ids, &response),
+    is_equal_to (0));
+  close (sockets[0]);
+  close (sockets[1]);
+
+  assert_that (ids->len, is_equal_to (2));
+  assert_that (g_ptr_array_index (ids, 0), is_equal_to_string ("1.2.3"));
+  assert_that (g_ptr_array_index (ids, 1), is_equal_to_string ("1.2.4"));
+  assert_that (entity_attribute (response, "status"),
+               is_equal_to_string ("200"));
+  assert_that (entity_attribute (entity_child (response, "vts"), "total"),
+               is_equal_to_string ("2"));
+  assert_that (entity_child (entity_child (response, "vts"), "vt"), is_null);
+
+  g_ptr_array_free (ids, TRUE);
+  free_entity (response);
+}
+
+Ensure (osp, osp_get_scan_pop_ext_streams_bounded_results)
+{
+  osp_connection_t connection;
+  osp_get_scan_pop_opts_t opts;
+  entity_t response;
+  GPtrArray *ids;
+  int sockets[2];
+  char command[256];
+  ssize_t count;
+  const char *xml;
+
+  xml = "<get_scans_response status=\"200\"><scan id=\"s1\" progress=\"40\">"
+        "<results><result name=\"a\">x</result><result name=\"b\">y</result>"
+        "</results></scan></get_scans_response>";
+  assert_that (socketpair (AF_UNIX, SOCK_STREAM, 0, sockets), is_equal_to (0));
+  assert_that (write (sockets[1], xml, strlen (xml)),
+               is_equal_to (strlen (xml)));
+
+  memset (&connection, 0, sizeof (connection));
+  connection.socket = sockets[0];
+  connection.host = "/ospd.sock";
+  opts = osp_get_scan_pop_opts_default;
+  opts.scan_id = "s1";
+  opts.pop_results = 1;
+  opts.max_results = 2;
+  opts.result_func = collect_name;
+  ids = g_ptr_array_new_with_free_func (g_free);
+  opts.result_func_data = ids;
+  assert_that (osp_get_scan_pop_ext (&connection, opts, NULL, &response, NULL),
+               is_equal_to (40));
+
+  count = read (sockets[1], command, sizeof (command) - 1);
+  assert_that (count, is_greater_than (0));
+  command[count] = '\0';
+  assert_that (command, is_equal_to_string ("<get_scans scan_id='s1'"
+                                            " details='0' pop_results='1'"
+                                            " max_results='2'/>"));
+  close (sockets[0]);
+  close (sockets[1]);
+
+  assert_that (ids->len, is_equal_to (2));
+  assert_that (g_ptr_array_index (ids, 0), is_equal_to_string ("a"));
+  assert_that (g_ptr_array_index (ids, 1), is_equal_to_string ("b"));
+  assert_that (entity_child (response, "scan"), is_not_null);
+  assert_that (
+    entity_child (entity_child (entity_child (response, "scan"), "results"),
+                  "result"),
+    is_null);
+
+  g_ptr_array_free (ids, TRUE);
+  free_entity (response);
+}
+
+/**
+ * @brief Write a message as a compressed frame, as a server would.
+ *
+ * @param[in]  socket   Socket.
+ * @param[in]  message  Message.
+ */
+static void
+write_frame (int socket, const char *message)
+{
+  unsigned long length;
+  guint32 header;
+  void *frame;
+
+  frame = gvm_compress (message, strlen (message), &length);
+  header = htonl (length);
+  assert_that (write (socket, &header, sizeof (header)),
+               is_equal_to (sizeof (header)));
+  assert_that (write (socket, frame, length), is_equal_to (length));
+  g_free (frame);
+}
+
+Ensure (osp, osp_connection_set_compression_switches_to_frames)
+{
+  osp_connection_t connection;
+  entity_t vts;
+  int sockets[2];
+  char plain[64];
+  guint32 header;
+  unsigned long length;
+  void *frame;
+  gchar *command;
+  const char *accept_xml;
+
+  accept_xml = "<set_compression_response status=\"200\"/>";
+  assert_that (socketpair (AF_UNIX, SOCK_STREAM, 0, sockets), is_equal_to (0));
+  assert_that (write (sockets[1], accept_xml, strlen (accept_xml)),
+               is_equal_to (strlen (accept_xml)));
+
+  memset (&connection, 0, sizeof (connection));
+  connection.socket = sockets[0];
+  connection.host = "/ospd.sock";
+  assert_that (osp_connection_set_compression (&connection), is_equal_to (0));
+  assert_that (read (sockets[1], plain, sizeof (plain)),
+               is_equal_to (strlen ("<set_compression method='zlib'/>")));
+
+  write_frame (sockets[1], "<get_vts_response status=\"200\"><vts/>"
+                           "</get_vts_response>");
+  assert_that (osp_get_vts (&connection, &vts), is_equal_to (0));
+  assert_that (entity_attribute (vts, "status"), is_equal_to_string ("200"));
+  free_entity (vts);
+
+  /* The command went out as a frame too. */
+  assert_that (read (sockets[1], &header, sizeof (header)),
+               is_equal_to (sizeof (header)));
+  frame = g_malloc (ntohl (header));
+  assert_that (read (sockets[1], frame, ntohl (header)),
+               is_equal_to (ntohl (header)));
+  command = gvm_uncompress (frame, ntohl (header), &length);
+  assert_that (command, is_equal_to_string ("<get_vts/>"));
+  g_free (command);
+  g_free (frame);
+
+  close (sockets[0]);
+  close (sockets[1]);
+}
+
+Ensure (osp, osp_read_frame_rejects_too_large_messages)
+{
+  osp_connection_t connection;
+  int sockets[2];
+  gchar *message, *large;
+
+  assert_that (socketpair (AF_UNIX, SOCK_STREAM, 0, sockets), is_equal_to (0));
+  memset (&connection, 0, sizeof (connection));
+  connection.socket = sockets[0];
+  connection.host = "/ospd.sock";
+
+  /* Compresses to far less than OSP_FRAME_MAX. */
+  large = g_strnfill (OSP_FRAME_MAX + 1, 'a');
+  write_frame (sockets[1], large);
+  assert_that (osp_read_frame (&connection), is_null);
+  g_free (large);
+
+  large = g_strnfill (OSP_FRAME_MAX, 'a');
+  write_frame (sockets[1], large);
+  message = osp_read_frame (&connection);
+  assert_that (message, is_equal_to_string (large));
+  g_free (message);
+  g_free (large);
+
+  close (sockets[0]);
+  close (sockets[1]);
+}
+
+Ensure (osp, osp_get_scans_status_batch_uses_one_command)
+{
+  osp_connection_t connection;
+  osp_scan_status_entry_t scans[3];
+  int sockets[2];
+  char command[128];
+  ssize_t count;
+  const char *xml;
+
+  xml = "<get_scans_response status=\"200\">"
+        "<scan id=\"a\" status=\"running\" progress=\"10\"/>"
+        "<scan id=\"other\" status=\"finished\" progress=\"100\"/>"
+        "<scan id=\"b\" status=\"queued\" progress=\"0\"/>"
+        "</get_scans_response>";
+  assert_that (socketpair (AF_UNIX, SOCK_STREAM, 0, sockets), is_equal_to (0));
+  assert_that (write (sockets[1], xml, strlen (xml)),
+               is_equal_to (strlen (xml)));
+
+  memset (&connection, 0, sizeof (connection));
+  connection.socket = sockets[0];
+  connection.host = "/ospd.sock";
+  memset (scans, 0, sizeof (scans));
+  scans[0].scan_id = "b";
+  scans[1].scan_id = "missing";
+  scans[2].scan_id = "a";
+  assert_that (osp_get_scans_status_batch (&connection, scans, 3, NULL),
+               is_equal_to (2));
+
+  count = read (sockets[1], command, sizeof (command) - 1);
+  assert_that (count, is_greater_than (0));
+  command[count] = '\0';
+  assert_that (command,
+               is_equal_to_string ("<get_scans details='0' pop_results='0'/>"));
+  close (sockets[0]);
+  close (sockets[1]);
+
+  assert_that (scans[0].status, is_equal_to (OSP_SCAN_STATUS_QUEUED));
+  assert_that (scans[0].progress, is_equal_to (0));
+  assert_that (scans[1].status, is_equal_to (OSP_SCAN_STATUS_ERROR));
+  assert_that (scans[1].progress, is_equal_to (-1));
+  assert_that (scans[2].status, is_equal_to (OSP_SCAN_STATUS_RUNNING));
+  assert_that (scans[2].progress, is_equal_to (10));
+}
+
+Ensure (osp, osp_metadata_cache_answers_repeated_commands)
+{
+  osp_connection_t connection;
+  osp_metadata_cache_t *cache;
+  char *name, *version, command[128];
+  int sockets[2];
+  ssize_t count;
+  const char *xml;
+
+  xml = "<get_version_response status=\"200\">"
+        "<protocol><name>OSP</name><version>1.2</version></protocol>"
+        "<daemon><name>ospd</name><version>21.4</version></daemon>"
+        "<scanner><name>openvas</name><version>22.4</version></scanner>"
+        "</get_version_response>";
+  assert_that (socketpair (AF_UNIX, SOCK_STREAM, 0, sockets), is_equal_to (0));
+  assert_that (write (sockets[1], xml, strlen (xml)),
+               is_equal_to (strlen (xml)));
+
+  memset (&connection, 0, sizeof (connection));
+  connection.socket = sockets[0];
+  connection.host = "/ospd.sock";
+  cache = osp_metadata_cache_new (60);
+  osp_connection_set_metadata_cache (&connection, cache);
+
+  assert_that (osp_get_version (&connection, &name, &version, NULL, NULL,
+                                NULL, NULL),
+               is_equal_to (0));
+  assert_that (name, is_equal_to_string ("openvas"));
+  g_free (name);
+  g_free (version);
+
+  /* The server has no second reply, so this one comes from the cache. */
+  assert_that (osp_get_version (&connection, &name, &version, NULL, NULL,
+                                NULL, NULL),
+               is_equal_to (0));
+  assert_that (version, is_equal_to_string ("22.4"));
+  g_free (name);
+  g_free (version);
+
+  count = recv (sockets[1], command, sizeof (command) - 1, MSG_DONTWAIT);
+  assert_that (count, is_equal_to (strlen ("<get_version/>")));
+
+  osp_metadata_cache_free (cache);
+  close (sockets[0]);
+  close (sockets[1]);
+}
+
+Ensure (osp, osp_start_scan_ext_sends_command_in_pieces)
+{
+  osp_connection_t connection;
+  osp_start_scan_opts_t opts;
+  GSList *vts = NULL;
+  GString *command;
+  int sockets[2], index;
+  char buffer[4096];
+  const char *xml;
+  char *error = NULL;
+
+  xml = "<start_scan_response status=\"200\"/>";
+  assert_that (socketpair (AF_UNIX, SOCK_STREAM, 0, sockets), is_equal_to (0));
+  assert_that (write (sockets[1], xml, strlen (xml)),
+               is_equal_to (strlen (xml)));
+
+  /* Enough VTs for more than one piece. */
+  for (index = 0; index < 1000; index++)
+    {
+      gchar *id = g_strdup_printf ("1.3.6.1.4.1.25623.1.0.%d", index);
+      osp_vt_single_t *vt = osp_vt_single_new (id);
+
+      osp_vt_single_add_value (vt, "1", "a<b");
+      vts = g_slist_prepend (vts, vt);
+      g_free (id);
+    }
+
+  memset (&connection, 0, sizeof (connection));
+  connection.socket = sockets[0];
+  connection.host = "/ospd.sock";
+  memset (&opts, 0, sizeof (opts));
+  opts.scan_id = "scan\"1";
+  opts.targets =
+    g_slist_prepend (NULL, osp_target_new ("a&b", "22", NULL, 0, 0, 0));
+  opts.vts = vts;
+  assert_that (osp_start_scan_ext (&connection, opts, &error),
+               is_equal_to (0));
+  assert_that (error, is_null);
+  assert_that (connection.broken, is_equal_to (0));
+
+  command = g_string_new ("");
+  while (!g_str_has_suffix (command->str, "</start_scan>"))
+    {
+      ssize_t count = read (sockets[1], buffer, sizeof (buffer));
+
+      assert_that (count, is_greater_than (0));
+      g_string_append_len (command, buffer, count);
+    }
+  close (sockets[0]);
+  close (sockets[1]);
+
+  assert_that (command->len, is_greater_than (START_SCAN_CHUNK));
+  assert_that (g_str_has_prefix (command->str, "<start_scan scan_id=\"scan"
+                                               "&quot;1\"><targets><target>"
+                                               "<hosts>a&amp;b</hosts>"),
+               is_true);
+  assert_that (strstr (command->str,
+                       "<vt_single id=\"1.3.6.1.4.1.25623.1.0.0\">"
+                       "<vt_value id=\"1\">a&lt;b</vt_value></vt_single>"
+                       "</vt_selection></start_scan>"),
+               is_not_null);
+
+  g_string_free (command, TRUE);
+  g_slist_free_full (opts.targets, (GDestroyNotify) osp_target_free);
+  g_slist_free_full (vts, (GDestroyNotify) osp_vt_single_free);
+}
+
 Ensure (osp, osp_get_vts_no_vts_ret_error)
 {
   osp_connection_t *conn = g_malloc0 (sizeof (*conn));
@@ -96,7 +515,22 @@ main (int argc, char **argv)
   add_test_with_context (suite, osp, osp_new_target_never_returns_null);
   add_test_with_context (suite, osp, osp_get_vts_no_conn_ret_error);
   add_test_with_context (suite, osp, osp_get_vts_no_vts_ret_error);
+  add_test_with_context (suite, osp, osp_get_vts_stream_calls_func_per_vt);
+  add_test_with_context (suite, osp,
+                         osp_start_scan_ext_sends_command_in_pieces);
+  add_test_with_context (suite, osp,
+                         osp_get_scans_status_batch_uses_one_command);
+  add_test_with_context (suite, osp,
+                         osp_connection_set_compression_switches_to_frames);
+  add_test_with_context (suite, osp,
+                         osp_read_frame_rejects_too_large_messages);
+  add_test_with_context (suite, osp,
+                         osp_get_scan_pop_ext_streams_bounded_results);
   add_test_with_context (suite, osp, osp_new_conn_ret_null);
+  add_test_with_context (suite, osp,
+                         osp_metadata_cache_answers_repeated_commands);
+  add_test_with_context (suite, osp,
+                         osp_connection_pool_reuses_live_connections);
   add_test_with_context (suite, osp, osp_target_add_alive_test_methods);
   add_test_with_context (suite, osp, target_append_as_xml);
 
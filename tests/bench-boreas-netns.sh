@@ -0,0 +1,84 @@
+#!/bin/sh
+# SPDX-FileCopyrightText: 2026 Greenbone AG
+#
+# SPDX-License-Identifier: GPL-2.0-or-later
+
+# Benchmark of the alive detection in two network namespaces connected by a
+# veth pair. bench-boreas responds in one of them for the alive part of the
+# targets, with netem adding latency and loss, while bench-boreas scans from
+# the other one. Prints one JSON line per target range. Needs root.
+#
+# Usage: bench-boreas-netns.sh [path/to/bench-boreas]
+#
+# Environment:
+#   TARGETS  Space separated target ranges, in 10.0.0.0/8
+#            (default "10.1.0.0/20 10.2.0.0/16").
+#   METHODS  Comma separated icmp, syn, ack and arp (default "icmp").
+#   ALIVE    Part of the targets alive, in permille (default 100).
+#   DELAY    Latency added to the replies, netem syntax (default "1ms").
+#   LOSS     Loss of the replies, netem syntax (default "0%").
+#   TIMEOUT  Time to wait for replies, in seconds (default 1).
+#
+# With arp in the methods the targets are on-link, else they are routed
+# through the responder.
+
+set -e
+
+BENCH=${1:-./bench-boreas}
+TARGETS=${TARGETS:-"10.1.0.0/20 10.2.0.0/16"}
+METHODS=${METHODS:-icmp}
+ALIVE=${ALIVE:-100}
+DELAY=${DELAY:-1ms}
+LOSS=${LOSS:-0%}
+TIMEOUT=${TIMEOUT:-1}
+
+SCAN_NS=boreas-bench-scan
+RESP_NS=boreas-bench-resp
+RESPONDER=
+
+cleanup ()
+{
+  [ -n "$RESPONDER" ] && kill "$RESPONDER" 2> /dev/null || true
+  ip netns del "$SCAN_NS" 2> /dev/null || true
+  ip netns del "$RESP_NS" 2> /dev/null || true
+}
+trap cleanup EXIT INT TERM
+
+cleanup
+ip netns add "$SCAN_NS"
+ip netns add "$RESP_NS"
+ip link add bench-scan netns "$SCAN_NS" type veth peer name bench-resp \
+  netns "$RESP_NS"
+
+ip -n "$SCAN_NS" link set lo up
+ip -n "$SCAN_NS" addr add 192.168.254.1/30 dev bench-scan
+ip -n "$SCAN_NS" link set bench-scan up
+ip -n "$RESP_NS" link set lo up
+ip -n "$RESP_NS" addr add 192.168.254.2/30 dev bench-resp
+ip -n "$RESP_NS" link set bench-resp up
+ip netns exec "$RESP_NS" tc qdisc add dev bench-resp root netem \
+  delay "$DELAY" loss "$LOSS" limit 100000
+
+case "$METHODS" in
+  *arp*)
+    # On-link targets, each one needs a neighbour entry. The limit of the
+    # neighbour table can only be set in the initial namespace.
+    sysctl -q -w net.ipv4.neigh.default.gc_thresh3=131072 \
+      || echo "Could not raise the neighbour table limit." >&2
+    for range in $TARGETS; do
+      ip -n "$SCAN_NS" route add "$range" dev bench-scan
+    done
+    ;;
+  *)
+    ip -n "$SCAN_NS" route add 10.0.0.0/8 via 192.168.254.2
+    ;;
+esac
+
+ip netns exec "$RESP_NS" "$BENCH" respond bench-resp "$ALIVE" &
+RESPONDER=$!
+sleep 1
+
+for range in $TARGETS; do
+  ip netns exec "$SCAN_NS" "$BENCH" scan "$range" "$METHODS" "$ALIVE" \
+    "$TIMEOUT"
+done
@@ -0,0 +1,448 @@
+/* SPDX-FileCopyrightText: 2026 Greenbone AG
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/**
+ * @file
+ * @brief Stand-alone benchmark of the alive detection "boreas".
+ *
+ * The benchmark has two parts, meant to run in two network namespaces
+ * connected by a veth pair, as set up by bench-boreas-netns.sh:
+ *
+ * bench-boreas respond iface alive_permille
+ *   Answers the ICMP echo requests, TCP probes and ARP requests to the IPv4
+ *   addresses considered alive, alive_permille of the addresses in
+ *   10.0.0.0/8, on iface.
+ *   Latency and loss are added with netem on the interface.
+ *
+ * bench-boreas scan targets methods alive_permille [timeout]
+ *   Runs the alive detection of the CLI on the targets with the methods, a
+ *   comma separated list of icmp, syn, ack and arp, and prints one JSON object
+ *   with the time to complete, the probes per second and the recall.
+ */
+
+#include "../base/hosts.h"       /* for gvm_hosts_new, gvm_hosts_next, ... */
+#include "../boreas/boreas_io.h" /* for alive_stats_to_json */
+#include "../boreas/cli.h"       /* for run_cli_extended */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <glib.h>
+#include <linux/if_ether.h> /* for ETH_P_ALL */
+#include <net/ethernet.h>
+#include <net/if.h>           /* for if_nametoindex */
+#include <netinet/if_ether.h> /* for struct ether_arp */
+#include <netinet/ip.h>
+#include <netinet/ip_icmp.h>
+#include <netinet/tcp.h>
+#include <netpacket/packet.h> /* for struct sockaddr_ll */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * @brief Tells whether an IPv4 address is to be considered alive.
+ *
+ * The responder and the scanner decide the same way, so that the scanner
+ * knows the alive hosts it should find. Only addresses in 10.0.0.0/8 are
+ * alive, so that the responder leaves the addresses of the link alone.
+ *
+ * @param addr     Address, in network byte order.
+ * @param permille Part of the addresses alive, in permille.
+ *
+ * @return 1 if alive, else 0.
+ */
+static int
+is_alive (uint32_t addr, int permille)
+{
+  uint32_t x = ntohl (addr);
+
+  if (x >> 24 != 10)
+    return 0;
+  x ^= x >> 16;
+  x *= 0x45d9f3b;
+  x ^= x >> 16;
+  return (int) (x % 1000) < permille;
+}
+
+/**
+ * @brief Computes the internet checksum of a buffer.
+ *
+ * @param data  Buffer.
+ * @param len   Length of the buffer.
+ * @param sum   Sum to start with, for a pseudo header.
+ *
+ * @return Checksum.
+ */
+static uint16_t
+checksum (const void *data, size_t len, uint32_t sum)
+{
+  const uint8_t *p = data;
+
+  for (; len > 1; p += 2, len -= 2)
+    sum += (p[0] << 8) | p[1];
+  if (len)
+    sum += p[0] << 8;
+  while (sum >> 16)
+    sum = (sum & 0xffff) + (sum >> 16);
+  return htons (~sum & 0xffff);
+}
+
+/**
+ * @brief Turns an ARP request to an alive address into its reply.
+ *
+ * @param frame    Frame, replaced by the reply.
+ * @param len      Length of the frame.
+ * @param permille Part of the addresses alive, in permille.
+ *
+ * @return 1 if the frame is to be sent back, else 0.
+ */
+static int
+respond_arp (uint8_t *frame, size_t len, int permille)
+{
+  struct ether_header *eth = (struct ether_header *) frame;
+  struct ether_arp *arp = (struct ether_arp *) (eth + 1);
+  uint32_t target;
+
+  if (len < sizeof (*eth) + sizeof (*arp)
+      || ntohs (arp->arp_op) != ARPOP_REQUEST)
+    return 0;
+  memcpy (&target, arp->arp_tpa, 4);
+  if (!is_alive (target, permille))
+    return 0;
+
+  memcpy (eth->ether_dhost, arp->arp_sha, ETH_ALEN);
+  /* Locally administered MAC derived from the address. */
+  eth->ether_shost[0] = 0x02;
+  eth->ether_shost[1] = 0x00;
+  memcpy (eth->ether_shost + 2, &target, 4);
+  arp->arp_op = htons (ARPOP_REPLY);
+  memcpy (arp->arp_tha, arp->arp_sha, ETH_ALEN);
+  memcpy (arp->arp_tpa, arp->arp_spa, 4);
+  memcpy (arp->arp_sha, eth->ether_shost, ETH_ALEN);
+  memcpy (arp->arp_spa, &target, 4);
+  return 1;
+}
+
+/**
+ * @brief Turns an ICMP echo request or TCP probe to an alive address into
+ * its reply.
+ *
+ * TCP probes get a RST, which the sniffer takes as a sign of life like a
+ * SYN-ACK.
+ *
+ * @param frame    Frame, replaced by the reply.
+ * @param len      Length of the frame.
+ * @param permille Part of the addresses alive, in permille.
+ *
+ * @return 1 if the frame is to be sent back, else 0.
+ */
+static int
+respond_ip (uint8_t *frame, size_t len, int permille)
+{
+  struct ether_header *eth = (struct ether_header *) frame;
+  struct ip *ip = (struct ip *) (eth + 1);
+  uint8_t mac[ETH_ALEN];
+  struct in_addr addr;
+  size_t hlen, plen;
+
+  if (len < sizeof (*eth) + sizeof (*ip))
+    return 0;
+  hlen = ip->ip_hl * 4;
+  plen = ntohs (ip->ip_len);
+  if (hlen < sizeof (*ip) || plen < hlen || sizeof (*eth) + plen > len
+      || !is_alive (ip->ip_dst.s_addr, permille))
+    return 0;
+
+  if (ip->ip_p == IPPROTO_ICMP && plen >= hlen + ICMP_MINLEN)
+    {
+      struct icmp *icmp = (struct icmp *) ((uint8_t *) ip + hlen);
+
+      if (icmp->icmp_type != ICMP_ECHO)
+        return 0;
+      icmp->icmp_type = ICMP_ECHOREPLY;
+      icmp->icmp_cksum = 0;
+      icmp->icmp_cksum = checksum (icmp, plen - hlen, 0);
+    }
+  else if (ip->ip_p == IPPROTO_TCP && plen >= hlen + sizeof (struct tcphdr))
+    {
+      struct tcphdr *tcp = (struct tcphdr *) ((uint8_t *) ip + hlen);
+      uint16_t port = tcp->th_sport;
+      uint32_t sum;
+
+      if (tcp->th_flags & TH_RST)
+        return 0;
+      tcp->th_sport = tcp->th_dport;
+      tcp->th_dport = port;
+      tcp->th_ack = htonl (ntohl (tcp->th_seq) + 1);
+      tcp->th_seq = 0;
+      tcp->th_off = sizeof (*tcp) / 4;
+      tcp->th_flags = TH_RST | TH_ACK;
+      tcp->th_win = 0;
+      tcp->th_urp = 0;
+      plen = hlen + sizeof (*tcp);
+      tcp->th_sum = 0;
+      /* Pseudo header, with the addresses yet to be swapped. */
+      sum = (ntohl (ip->ip_src.s_addr) >> 16)
+            + (ntohl (ip->ip_src.s_addr) & 0xffff)
+            + (ntohl (ip->ip_dst.s_addr) >> 16)
+            + (ntohl (ip->ip_dst.s_addr) & 0xffff) + IPPROTO_TCP
+            + sizeof (*tcp);
+      tcp->th_sum = checksum (tcp, sizeof (*tcp), sum);
+    }
+  else
+    return 0;
+
+  addr = ip->ip_src;
+  ip->ip_src = ip->ip_dst;
+  ip->ip_dst = addr;
+  ip->ip_len = htons (plen);
+  ip->ip_ttl = 64;
+  ip->ip_sum = 0;
+  ip->ip_sum = checksum (ip, hlen, 0);
+  memcpy (mac, eth->ether_dhost, ETH_ALEN);
+  memcpy (eth->ether_dhost, eth->ether_shost, ETH_ALEN);
+  memcpy (eth->ether_shost, mac, ETH_ALEN);
+  return 1;
+}
+
+/**
+ * @brief Runs the responder until killed.
+ *
+ * @param ifname   Interface to answer on.
+ * @param permille Part of the addresses alive, in permille.
+ *
+ * @return 1 on error.
+ */
+static int
+respond (const char *ifname, int permille)
+{
+  struct sockaddr_ll addr;
+  uint8_t frame[2048];
+  int soc;
+
+  soc = socket (AF_PACKET, SOCK_RAW, htons (ETH_P_ALL));
+  if (soc < 0)
+    {
+      perror ("socket");
+      return 1;
+    }
+  memset (&addr, 0, sizeof (addr));
+  addr.sll_family = AF_PACKET;
+  addr.sll_protocol = htons (ETH_P_ALL);
+  addr.sll_ifindex = if_nametoindex (ifname);
+  if (addr.sll_ifindex == 0
+      || bind (soc, (struct sockaddr *) &addr, sizeof (addr)) < 0)
+    {
+      perror (ifname);
+      close (soc);
+      return 1;
+    }
+
+  for (;;)
+    {
+      struct sockaddr_ll from;
+      socklen_t fromlen = sizeof (from);
+      ssize_t len;
+      int reply = 0;
+
+      len = recvfrom (soc, frame, sizeof (frame), 0, (struct sockaddr *) &from,
+                      &fromlen);
+      if (len < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          perror ("recvfrom");
+          break;
+        }
+      /* Skip the replies sent by ourselves. */
+      if (from.sll_pkttype == PACKET_OUTGOING
+          || (size_t) len < sizeof (struct ether_header))
+        continue;
+
+      switch (ntohs (((struct ether_header *) frame)->ether_type))
+        {
+        case ETHERTYPE_ARP:
+          reply = respond_arp (frame, len, permille);
+          break;
+        case ETHERTYPE_IP:
+          reply = respond_ip (frame, len, permille);
+          break;
+        }
+      if (reply
+          && sendto (soc, frame, len, 0, (struct sockaddr *) &from, fromlen)
+               < 0)
+        perror ("sendto");
+    }
+  close (soc);
+  return 1;
+}
+
+/**
+ * @brief Parses a comma separated list of methods.
+ *
+ * @param str  Methods.
+ *
+ * @return Alive test methods, 0 for an invalid list.
+ */
+static alive_test_t
+parse_methods (const char *str)
+{
+  gchar **names = g_strsplit (str, ",", -1);
+  alive_test_t methods = 0;
+
+  for (gchar **name = names; *name; name++)
+    {
+      if (!strcmp (*name, "icmp"))
+        methods |= ALIVE_TEST_ICMP;
+      else if (!strcmp (*name, "syn"))
+        methods |= ALIVE_TEST_TCP_SYN_SERVICE;
+      else if (!strcmp (*name, "ack"))
+        methods |= ALIVE_TEST_TCP_ACK_SERVICE;
+      else if (!strcmp (*name, "arp"))
+        methods |= ALIVE_TEST_ARP;
+      else
+        {
+          methods = 0;
+          break;
+        }
+    }
+  g_strfreev (names);
+  return methods;
+}
+
+/**
+ * @brief Sums the probes sent in the statistics of the alive detection.
+ *
+ * @param stats Statistics, as JSON.
+ *
+ * @return Number of probes sent.
+ */
+static guint64
+probes_sent (const char *stats)
+{
+  guint64 sent = 0;
+  const char *p = stats;
+
+  while ((p = strstr (p, "\"sent\": ")))
+    {
+      p += strlen ("\"sent\": ");
+      sent += g_ascii_strtoull (p, NULL, 10);
+    }
+  return sent;
+}
+
+/**
+ * @brief Runs the alive detection of the CLI and prints the results.
+ *
+ * @param targets  Targets.
+ * @param methods  Methods, comma separated.
+ * @param permille Part of the addresses alive in the responder, in permille.
+ * @param timeout  Time to wait for replies, in seconds.
+ *
+ * @return 0 on success, 1 on error.
+ */
+static int
+scan (const char *targets, const char *methods, int permille, int timeout)
+{
+  alive_test_t alive_test = parse_methods (methods);
+  gvm_hosts_t *hosts;
+  gvm_host_t *host;
+  int expected = 0, found = 0, true_positives = 0, number;
+  FILE *results;
+  int saved_stdout;
+  struct timespec start, end;
+  double seconds;
+  char line[256];
+  gchar *stats;
+
+  if (!alive_test)
+    {
+      fprintf (stderr, "Invalid methods: %s\n", methods);
+      return 1;
+    }
+
+  /* The alive hosts to find. */
+  hosts = gvm_hosts_new (targets);
+  if (!hosts)
+    {
+      fprintf (stderr, "Invalid targets: %s\n", targets);
+      return 1;
+    }
+  number = gvm_hosts_count (hosts);
+  while ((host = gvm_hosts_next (hosts)))
+    if (host->type == HOST_TYPE_IPV4 && is_alive (host->addr.s_addr, permille))
+      expected++;
+  gvm_hosts_free (hosts);
+  hosts = gvm_hosts_new (targets);
+
+  /* The CLI prints the alive hosts on stdout, catch them in a file. */
+  results = tmpfile ();
+  if (!results)
+    {
+      perror ("tmpfile");
+      gvm_hosts_free (hosts);
+      return 1;
+    }
+  fflush (stdout);
+  saved_stdout = dup (STDOUT_FILENO);
+  dup2 (fileno (results), STDOUT_FILENO);
+
+  alive_stats_reset ();
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  run_cli_extended (hosts, alive_test, NULL, timeout);
+  clock_gettime (CLOCK_MONOTONIC, &end);
+  seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+  stats = alive_stats_to_json ();
+
+  fflush (stdout);
+  dup2 (saved_stdout, STDOUT_FILENO);
+  close (saved_stdout);
+
+  rewind (results);
+  while (fgets (line, sizeof (line), results))
+    {
+      struct in_addr addr;
+
+      line[strcspn (line, "\n")] = '\0';
+      if (inet_pton (AF_INET, line, &addr) != 1)
+        continue;
+      found++;
+      if (is_alive (addr.s_addr, permille))
+        true_positives++;
+    }
+  fclose (results);
+
+  printf ("{\"targets\": \"%s\", \"hosts\": %d, \"methods\": \"%s\", "
+          "\"timeout\": %d, \"seconds\": %.3f, \"probes_per_s\": %.0f, "
+          "\"expected_alive\": %d, \"found\": %d, \"true_positives\": %d, "
+          "\"recall\": %.4f, \"stats\": %s}\n",
+          targets, number, methods, timeout, seconds,
+          seconds > 0 ? probes_sent (stats) / seconds : 0.0, expected, found,
+          true_positives, expected ? (double) true_positives / expected : 1.0,
+          stats);
+  fflush (stdout);
+  g_free (stats);
+  gvm_hosts_free (hosts);
+  return 0;
+}
+
+int
+main (int argc, char **argv)
+{
+  if (argc == 4 && !strcmp (argv[1], "respond"))
+    return respond (argv[2], atoi (argv[3]));
+  if ((argc == 5 || argc == 6) && !strcmp (argv[1], "scan"))
+    return scan (argv[2], argv[3], atoi (argv[4]),
+                 argc == 6 ? atoi (argv[5]) : 1);
+
+  fprintf (stderr,
+           "Usage: %s respond iface alive_permille\n"
+           "       %s scan targets methods alive_permille [timeout]\n",
+           argv[0], argv[0]);
+  return 1;
+}
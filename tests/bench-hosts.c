@@ -0,0 +1,277 @@
+/* SPDX-FileCopyrightText: 2026 Greenbone AG
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/**
+ * @file
+ * @brief Stand-alone benchmark of the module "hosts".
+ *
+ * Runs the costliest hosts collection operations and prints one JSON object
+ * per benchmark on stdout, with the time per operation, the change of the
+ * heap bytes in use over the benchmark and the peak RSS of the process.
+ *
+ * Usage: bench-hosts [scale], scale multiplying the iterations (default 1).
+ */
+
+#include "../base/hosts.h" /* for gvm_hosts_new, gvm_hosts_exclude, ... */
+
+#include <arpa/inet.h>    /* for htonl */
+#include <glib.h>         /* for GString, g_str_hash */
+#include <malloc.h>       /* for mallinfo2 */
+#include <netinet/in.h>   /* for in6_addr */
+#include <stdio.h>        /* for printf */
+#include <stdlib.h>       /* for atoi */
+#include <string.h>       /* for memset */
+#include <sys/resource.h> /* for getrusage */
+#include <time.h>         /* for clock_gettime */
+
+/**
+ * @brief Gets the monotonic time in nanoseconds.
+ *
+ * @return Time.
+ */
+static gint64
+now_ns (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (gint64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * @brief Gets the heap bytes in use.
+ *
+ * @return Bytes, 0 if unknown.
+ */
+static long long
+heap_bytes (void)
+{
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 33)
+  return mallinfo2 ().uordblks;
+#else
+  return 0;
+#endif
+}
+
+/**
+ * @brief Prints the result of a benchmark.
+ *
+ * @param[in] name    Benchmark name.
+ * @param[in] ops     Number of operations run.
+ * @param[in] elapsed Elapsed time in nanoseconds.
+ * @param[in] heap    Heap bytes in use before the benchmark.
+ */
+static void
+report (const char *name, long ops, gint64 elapsed, long long heap)
+{
+  struct rusage usage;
+
+  getrusage (RUSAGE_SELF, &usage);
+  printf ("{\"name\": \"%s\", \"ops\": %ld, \"ns_per_op\": %.1f, "
+          "\"heap_bytes_delta\": %lld, \"peak_rss_kb\": %ld}\n",
+          name, ops, ops ? (double) elapsed / ops : 0.0, heap_bytes () - heap,
+          usage.ru_maxrss);
+  fflush (stdout);
+}
+
+/**
+ * @brief Stub resolver returning one IPv4-mapped address per hostname.
+ *
+ * @param[in] name  Hostname.
+ *
+ * @return List of one struct in6_addr.
+ */
+static GSList *
+stub_resolve_list (const char *name)
+{
+  struct in6_addr *addr6 = g_malloc0 (sizeof (*addr6));
+
+  addr6->s6_addr32[2] = htonl (0xffff);
+  addr6->s6_addr32[3] = htonl (0x0a000000 | (g_str_hash (name) & 0xffffff));
+  return g_slist_prepend (NULL, addr6);
+}
+
+/**
+ * @brief Benchmarks creating collections from large ranges.
+ *
+ * @param[in] name      Benchmark name.
+ * @param[in] hosts_str Hosts string.
+ * @param[in] ops       Number of operations.
+ * @param[in] iterate   Whether to iterate over all the hosts.
+ */
+static void
+bench_new (const char *name, const char *hosts_str, long ops, int iterate)
+{
+  long long heap = heap_bytes ();
+  gint64 start = now_ns ();
+  long i;
+
+  for (i = 0; i < ops; i++)
+    {
+      gvm_hosts_t *hosts = gvm_hosts_new (hosts_str);
+
+      if (iterate)
+        while (gvm_hosts_next (hosts))
+          ;
+      gvm_hosts_free (hosts);
+    }
+  report (name, ops, now_ns () - start, heap);
+}
+
+/**
+ * @brief Benchmarks excluding hosts.
+ *
+ * @param[in] name         Benchmark name.
+ * @param[in] ops          Number of operations.
+ * @param[in] materialize  Whether to materialize the hosts first.
+ */
+static void
+bench_exclude (const char *name, long ops, int materialize)
+{
+  long long heap = heap_bytes ();
+  gint64 elapsed = 0;
+  long i;
+
+  for (i = 0; i < ops; i++)
+    {
+      gvm_hosts_t *hosts = gvm_hosts_new ("10.0.0.0/16");
+      gint64 start;
+
+      if (materialize)
+        gvm_hosts_add (hosts, gvm_host_from_str ("192.168.0.1"));
+      start = now_ns ();
+      gvm_hosts_exclude (hosts, "10.0.128.0/17, 10.0.0.1-10, example.org");
+      elapsed += now_ns () - start;
+      gvm_hosts_free (hosts);
+    }
+  report (name, ops, elapsed, heap);
+}
+
+/**
+ * @brief Benchmarks deduplication of overlapping specifications.
+ *
+ * @param[in] ops  Number of operations.
+ */
+static void
+bench_deduplicate (long ops)
+{
+  GString *str = g_string_new ("");
+  long long heap = heap_bytes ();
+  gint64 start;
+  long i;
+
+  for (i = 0; i < 1000; i++)
+    g_string_append_printf (str, "10.0.%ld.1-100,10.0.%ld.50-150,", i % 256,
+                            i % 256);
+  start = now_ns ();
+  for (i = 0; i < ops; i++)
+    gvm_hosts_free (gvm_hosts_new (str->str));
+  report ("deduplicate_spans", ops, now_ns () - start, heap);
+  g_string_free (str, TRUE);
+}
+
+/**
+ * @brief Benchmarks shuffled iteration.
+ *
+ * @param[in] ops  Number of operations.
+ */
+static void
+bench_shuffle (long ops)
+{
+  long long heap = heap_bytes ();
+  gint64 start = now_ns ();
+  long i;
+
+  for (i = 0; i < ops; i++)
+    {
+      gvm_hosts_t *hosts = gvm_hosts_new ("10.0.0.0/16");
+
+      gvm_hosts_shuffle (hosts);
+      while (gvm_hosts_next (hosts))
+        ;
+      gvm_hosts_free (hosts);
+    }
+  report ("shuffle_iterate_cidr16", ops, now_ns () - start, heap);
+}
+
+/**
+ * @brief Benchmarks resolving hostnames with the stub resolver.
+ *
+ * @param[in] ops  Number of operations.
+ */
+static void
+bench_resolve (long ops)
+{
+  GString *str = g_string_new ("");
+  long long heap = heap_bytes ();
+  gint64 elapsed = 0;
+  long i;
+
+  for (i = 0; i < 1000; i++)
+    g_string_append_printf (str, "host%ld.example,", i);
+  gvm_hosts_set_resolve_func (stub_resolve_list);
+  for (i = 0; i < ops; i++)
+    {
+      gvm_hosts_t *hosts = gvm_hosts_new (str->str);
+      GSList *unresolved;
+      gint64 start = now_ns ();
+
+      unresolved = gvm_hosts_resolve (hosts);
+      elapsed += now_ns () - start;
+      g_slist_free_full (unresolved, g_free);
+      gvm_hosts_free (hosts);
+    }
+  gvm_hosts_set_resolve_func (NULL);
+  report ("resolve_1000_names", ops, elapsed, heap);
+  g_string_free (str, TRUE);
+}
+
+/**
+ * @brief Benchmarks host lookups in a collection.
+ *
+ * @param[in] ops  Number of operations.
+ */
+static void
+bench_find (long ops)
+{
+  gvm_hosts_t *hosts = gvm_hosts_new ("10.0.0.0/20");
+  long long heap = heap_bytes ();
+  gint64 start;
+  long i;
+
+  gvm_hosts_add (hosts, gvm_host_from_str ("example.org"));
+  start = now_ns ();
+  for (i = 0; i < ops; i++)
+    {
+      gvm_host_t host;
+
+      memset (&host, 0, sizeof (host));
+      host.type = HOST_TYPE_IPV4;
+      host.addr.s_addr = htonl (0x0a000000 | (i % 4096));
+      gvm_host_find_in_hosts (&host, NULL, hosts);
+    }
+  report ("find_in_hosts_cidr20", ops, now_ns () - start, heap);
+  gvm_hosts_free (hosts);
+}
+
+int
+main (int argc, char **argv)
+{
+  long scale = argc > 1 ? atoi (argv[1]) : 1;
+
+  if (scale < 1)
+    scale = 1;
+
+  bench_new ("new_cidr8", "10.0.0.0/8", 1000 * scale, 0);
+  bench_new ("new_ipv6_cidr64", "2001:db8::/64", 1000 * scale, 0);
+  bench_new ("new_iterate_cidr16", "10.0.0.0/16", 10 * scale, 1);
+  bench_exclude ("exclude_spans", 1000 * scale, 0);
+  bench_exclude ("exclude_materialized", 10 * scale, 1);
+  bench_deduplicate (10 * scale);
+  bench_shuffle (10 * scale);
+  bench_resolve (10 * scale);
+  bench_find (100000 * scale);
+  return 0;
+}
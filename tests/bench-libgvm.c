@@ -0,0 +1,444 @@
+/* SPDX-FileCopyrightText: 2026 Greenbone AG
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/**
+ * @file
+ * @brief Micro-benchmarks of the hot paths of libgvm.
+ *
+ * Covers the XML entity parser and printer on large GMP payloads, the CVSS
+ * base score, the port ranges, the NVT info and the KB.  Prints one JSON
+ * object per benchmark on stdout, with the time and the allocations per
+ * operation and the throughput, so that runs can be compared across
+ * releases.
+ *
+ * Usage: bench-libgvm [scale [kb_path]], scale multiplying the iterations
+ * (default 1) and kb_path the Redis socket of the KB benchmarks (default
+ * KB_PATH_DEFAULT).  The KB benchmarks are reported as skipped when the
+ * socket cannot be reached.
+ */
+
+#include "../base/cvss.h"       /* for get_cvss_score_from_base_metrics */
+#include "../base/networking.h" /* for port_range_ranges, ... */
+#include "../base/nvti.h"       /* for nvti_new, nvti_refs, ... */
+#include "../util/kb.h"         /* for kb_new, kb_item_set_str, ... */
+#include "../util/xmlutils.h"   /* for parse_entity, ... */
+
+#include <glib.h>   /* for GString, gint64 */
+#include <stdio.h>  /* for printf */
+#include <stdlib.h> /* for atoi */
+#include <string.h> /* for strlen */
+#include <time.h>   /* for clock_gettime */
+
+#ifdef __GLIBC__
+/**
+ * @brief Number of allocations made by the process.
+ */
+static gint64 allocations = 0;
+
+extern void *__libc_malloc (size_t);
+extern void *__libc_calloc (size_t, size_t);
+extern void *__libc_realloc (void *, size_t);
+
+/**
+ * @brief Counting wrapper of malloc, interposed on the libraries.
+ *
+ * @param[in] size  Size.
+ *
+ * @return Allocated memory.
+ */
+void *
+malloc (size_t size)
+{
+  __atomic_add_fetch (&allocations, 1, __ATOMIC_RELAXED);
+  return __libc_malloc (size);
+}
+
+/**
+ * @brief Counting wrapper of calloc, interposed on the libraries.
+ *
+ * @param[in] nmemb  Number of members.
+ * @param[in] size   Size of a member.
+ *
+ * @return Allocated memory.
+ */
+void *
+calloc (size_t nmemb, size_t size)
+{
+  __atomic_add_fetch (&allocations, 1, __ATOMIC_RELAXED);
+  return __libc_calloc (nmemb, size);
+}
+
+/**
+ * @brief Counting wrapper of realloc, interposed on the libraries.
+ *
+ * @param[in] ptr   Memory to resize.
+ * @param[in] size  New size.
+ *
+ * @return Reallocated memory.
+ */
+void *
+realloc (void *ptr, size_t size)
+{
+  __atomic_add_fetch (&allocations, 1, __ATOMIC_RELAXED);
+  return __libc_realloc (ptr, size);
+}
+#endif
+
+/**
+ * @brief Gets the number of allocations made so far.
+ *
+ * @return Allocations, 0 if unknown.
+ */
+static gint64
+allocation_count (void)
+{
+#ifdef __GLIBC__
+  return __atomic_load_n (&allocations, __ATOMIC_RELAXED);
+#else
+  return 0;
+#endif
+}
+
+/**
+ * @brief Gets the monotonic time in nanoseconds.
+ *
+ * @return Time.
+ */
+static gint64
+now_ns (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (gint64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * @brief State of a running benchmark.
+ */
+typedef struct
+{
+  const char *name; /**< Benchmark name. */
+  gint64 start;     /**< Start time in nanoseconds. */
+  gint64 allocs;    /**< Allocations at the start. */
+} bench_t;
+
+/**
+ * @brief Starts a benchmark.
+ *
+ * @param[out] bench  Benchmark.
+ * @param[in]  name   Benchmark name.
+ */
+static void
+bench_start (bench_t *bench, const char *name)
+{
+  bench->name = name;
+  bench->allocs = allocation_count ();
+  bench->start = now_ns ();
+}
+
+/**
+ * @brief Stops a benchmark and prints its result.
+ *
+ * @param[in] bench  Benchmark.
+ * @param[in] ops    Number of operations run.
+ * @param[in] bytes  Bytes processed per operation, 0 if not applicable.
+ */
+static void
+bench_stop (bench_t *bench, long ops, long bytes)
+{
+  gint64 elapsed = now_ns () - bench->start;
+  gint64 allocs = allocation_count () - bench->allocs;
+
+  printf ("{\"name\": \"%s\", \"ops\": %ld, \"ns_per_op\": %.1f, "
+          "\"allocs_per_op\": %.1f, \"ops_per_s\": %.1f, "
+          "\"bytes_per_s\": %.1f}\n",
+          bench->name, ops, ops ? (double) elapsed / ops : 0.0,
+          ops ? (double) allocs / ops : 0.0,
+          elapsed ? ops * 1e9 / elapsed : 0.0,
+          elapsed ? (double) bytes * ops * 1e9 / elapsed : 0.0);
+  fflush (stdout);
+}
+
+/**
+ * @brief Prints a benchmark which could not run.
+ *
+ * @param[in] name    Benchmark name.
+ * @param[in] reason  Why it was skipped.
+ */
+static void
+bench_skip (const char *name, const char *reason)
+{
+  printf ("{\"name\": \"%s\", \"skipped\": \"%s\"}\n", name, reason);
+  fflush (stdout);
+}
+
+/**
+ * @brief Builds a GMP get_results response.
+ *
+ * @param[in] results  Number of results.
+ *
+ * @return Response, free with g_free.
+ */
+static gchar *
+gmp_results_payload (int results)
+{
+  GString *xml = g_string_new ("<get_results_response status=\"200\""
+                               " status_text=\"OK\">");
+  int i;
+
+  for (i = 0; i < results; i++)
+    g_string_append_printf (
+      xml,
+      "<result id=\"%08x-0000-4000-8000-000000000000\">"
+      "<name>Result %d &amp; more</name>"
+      "<host>10.0.%d.%d<asset asset_id=\"\"/></host>"
+      "<port>%d/tcp</port>"
+      "<nvt oid=\"1.3.6.1.4.1.25623.1.0.%d\"><type>nvt</type>"
+      "<name>Check %d</name><cvss_base>5.0</cvss_base>"
+      "<refs><ref type=\"cve\" id=\"CVE-2024-%04d\"/></refs></nvt>"
+      "<severity>5.0</severity><qod><value>80</value></qod>"
+      "<description>Line one\nLine two with &lt;markup&gt;</description>"
+      "</result>",
+      i, i, (i / 256) % 256, i % 256, 1 + i % 65535, i, i, i % 10000);
+  g_string_append (xml, "</get_results_response>");
+  return g_string_free (xml, FALSE);
+}
+
+/**
+ * @brief Benchmarks parsing and printing a large GMP response.
+ *
+ * @param[in] ops  Number of operations.
+ */
+static void
+bench_xml (long ops)
+{
+  gchar *payload = gmp_results_payload (1000);
+  long size = strlen (payload);
+  entity_t entity = NULL;
+  GString *out;
+  bench_t bench;
+  long i;
+
+  bench_start (&bench, "parse_entity_1000_results");
+  for (i = 0; i < ops; i++)
+    {
+      entity = NULL;
+      if (parse_entity (payload, &entity))
+        {
+          bench_skip (bench.name, "parse failed");
+          g_free (payload);
+          return;
+        }
+      if (i + 1 < ops)
+        free_entity (entity);
+    }
+  bench_stop (&bench, ops, size);
+
+  out = g_string_sized_new (size);
+  bench_start (&bench, "print_entity_to_string_1000_results");
+  for (i = 0; i < ops; i++)
+    {
+      g_string_truncate (out, 0);
+      print_entity_to_string (entity, out);
+    }
+  bench_stop (&bench, ops, out->len);
+
+  g_string_free (out, TRUE);
+  free_entity (entity);
+  g_free (payload);
+}
+
+/**
+ * @brief Benchmarks the CVSS base score of v2 and v3 vectors.
+ *
+ * @param[in] ops  Number of operations.
+ */
+static void
+bench_cvss (long ops)
+{
+  static const char *vectors[] = {
+    "AV:N/AC:L/Au:N/C:P/I:P/A:P",
+    "AV:L/AC:H/Au:M/C:N/I:C/A:N",
+    "CVSS:3.1/AV:N/AC:L/PR:N/UI:N/S:U/C:H/I:H/A:H",
+    "CVSS:3.0/AV:A/AC:H/PR:L/UI:R/S:C/C:L/I:N/A:L",
+  };
+  volatile double sum = 0;
+  bench_t bench;
+  long i;
+
+  bench_start (&bench, "get_cvss_score_from_base_metrics");
+  for (i = 0; i < ops; i++)
+    sum += get_cvss_score_from_base_metrics (vectors[i % 4]);
+  bench_stop (&bench, ops, 0);
+  (void) sum;
+}
+
+/**
+ * @brief Benchmarks parsing port ranges and looking up ports in them.
+ *
+ * @param[in] ops  Number of operations.
+ */
+static void
+bench_ports (long ops)
+{
+  GString *str = g_string_new ("T:");
+  array_t *ranges;
+  volatile int found = 0;
+  bench_t bench;
+  long i;
+
+  for (i = 0; i < 200; i++)
+    g_string_append_printf (str, "%ld-%ld,", i * 300 + 1, i * 300 + 100);
+  g_string_append (str, "U:53,123,161-162,500");
+
+  bench_start (&bench, "port_range_ranges_200_ranges");
+  for (i = 0; i < ops; i++)
+    array_free (port_range_ranges (str->str));
+  bench_stop (&bench, ops, str->len);
+
+  ranges = port_range_ranges (str->str);
+  bench_start (&bench, "port_in_port_ranges_200_ranges");
+  for (i = 0; i < ops * 100; i++)
+    found += port_in_port_ranges (1 + i % 65535, PORT_PROTOCOL_TCP, ranges);
+  bench_stop (&bench, ops * 100, 0);
+  (void) found;
+
+  array_free (ranges);
+  g_string_free (str, TRUE);
+}
+
+/**
+ * @brief Builds an NVT info with references.
+ *
+ * @param[in] index  Number of the NVT.
+ * @param[in] refs   Number of references.
+ *
+ * @return NVT info, free with nvti_free.
+ */
+static nvti_t *
+nvti_build (long index, int refs)
+{
+  nvti_t *nvti = nvti_new ();
+  gchar oid[64];
+  int i;
+
+  g_snprintf (oid, sizeof (oid), "1.3.6.1.4.1.25623.1.0.%ld", index);
+  nvti_set_oid (nvti, oid);
+  nvti_set_name (nvti, "Benchmark NVT");
+  nvti_set_tag (nvti, "cvss_base_vector=AV:N/AC:L/Au:N/C:P/I:P/A:P"
+                      "|summary=Benchmark|solution_type=VendorFix");
+  for (i = 0; i < refs; i++)
+    {
+      gchar id[32];
+
+      g_snprintf (id, sizeof (id), "CVE-2024-%04d", i);
+      nvti_add_vtref (nvti, vtref_new (i % 3 ? "cve" : "url", id, NULL));
+    }
+  return nvti;
+}
+
+/**
+ * @brief Benchmarks building NVT infos and collecting their references.
+ *
+ * @param[in] ops  Number of operations.
+ */
+static void
+bench_nvti (long ops)
+{
+  nvti_t *nvti;
+  bench_t bench;
+  long i;
+
+  bench_start (&bench, "nvti_build_20_refs");
+  for (i = 0; i < ops; i++)
+    nvti_free (nvti_build (i, 20));
+  bench_stop (&bench, ops, 0);
+
+  nvti = nvti_build (0, 20);
+  bench_start (&bench, "nvti_refs_20_refs");
+  for (i = 0; i < ops; i++)
+    g_free (nvti_refs (nvti, NULL, "url", 1));
+  bench_stop (&bench, ops, 0);
+  nvti_free (nvti);
+}
+
+/**
+ * @brief Benchmarks setting and getting items of a KB.
+ *
+ * @param[in] kb_path  Path to the KB.
+ * @param[in] ops      Number of operations.
+ */
+static void
+bench_kb (const char *kb_path, long ops)
+{
+  kb_t kb = NULL;
+  struct kb_item *items;
+  bench_t bench;
+  long i;
+
+  if (kb_new (&kb, kb_path) || kb == NULL)
+    {
+      bench_skip ("kb_item_set_str", "no kb");
+      bench_skip ("kb_item_get_str", "no kb");
+      bench_skip ("kb_item_push_str", "no kb");
+      bench_skip ("kb_item_get_all", "no kb");
+      return;
+    }
+
+  bench_start (&bench, "kb_item_set_str");
+  for (i = 0; i < ops; i++)
+    {
+      gchar name[64];
+
+      g_snprintf (name, sizeof (name), "bench/set/%ld", i % 1000);
+      kb_item_set_str (kb, name, "value", 0);
+    }
+  bench_stop (&bench, ops, 0);
+
+  bench_start (&bench, "kb_item_get_str");
+  for (i = 0; i < ops; i++)
+    {
+      gchar name[64];
+
+      g_snprintf (name, sizeof (name), "bench/set/%ld", i % 1000);
+      g_free (kb_item_get_str (kb, name));
+    }
+  bench_stop (&bench, ops, 0);
+
+  bench_start (&bench, "kb_item_push_str");
+  for (i = 0; i < ops; i++)
+    {
+      gchar value[32];
+
+      g_snprintf (value, sizeof (value), "%ld", i);
+      kb_item_push_str (kb, "bench/list", value);
+    }
+  bench_stop (&bench, ops, 0);
+
+  bench_start (&bench, "kb_item_get_all");
+  items = kb_item_get_all (kb, "bench/list");
+  bench_stop (&bench, 1, 0);
+  kb_item_free (items);
+
+  kb_delete (kb);
+}
+
+int
+main (int argc, char **argv)
+{
+  long scale = argc > 1 ? atoi (argv[1]) : 1;
+  const char *kb_path = argc > 2 ? argv[2] : KB_PATH_DEFAULT;
+
+  if (scale < 1)
+    scale = 1;
+
+  bench_xml (10 * scale);
+  bench_cvss (100000 * scale);
+  bench_ports (1000 * scale);
+  bench_nvti (10000 * scale);
+  bench_kb (kb_path, 10000 * scale);
+  return 0;
+}
@@ -0,0 +1,143 @@
+/* SPDX-FileCopyrightText: 2026 Greenbone AG
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/**
+ * @file
+ * @brief Calibration benchmark of the password based authentication.
+ *
+ * Measures pba_hash and the verification in the pool on this machine and
+ * picks the count of rounds for a target latency.  Prints one JSON object
+ * per benchmark on stdout, the last one with the count to configure.
+ *
+ * Usage: bench-pba [target_ms [threads]], target_ms being the wanted time
+ * of one hash (default 100) and threads the size of the pool (default 4).
+ */
+
+#include "../util/passwordbasedauthentication.h" /* for pba_hash, ... */
+
+#include <glib.h>   /* for gint, g_atomic_int_add */
+#include <stdio.h>  /* for printf */
+#include <stdlib.h> /* for atoi, free */
+#include <time.h>   /* for clock_gettime */
+
+/**
+ * @brief Gets the monotonic time in nanoseconds.
+ *
+ * @return Time.
+ */
+static gint64
+now_ns (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (gint64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * @brief Prints the result of a benchmark.
+ *
+ * @param[in] name    Benchmark name.
+ * @param[in] count   Rounds of the hashes.
+ * @param[in] ops     Number of operations run.
+ * @param[in] elapsed Elapsed time in nanoseconds.
+ */
+static void
+report (const char *name, unsigned int count, long ops, gint64 elapsed)
+{
+  printf ("{\"name\": \"%s\", \"count\": %u, \"ops\": %ld, "
+          "\"ns_per_op\": %.1f, \"ops_per_s\": %.1f}\n",
+          name, count, ops, ops ? (double) elapsed / ops : 0.0,
+          elapsed ? ops * 1e9 / elapsed : 0.0);
+  fflush (stdout);
+}
+
+/**
+ * @brief Benchmarks hashing with a count of rounds.
+ *
+ * @param[in] count  Rounds.
+ * @param[in] ops    Number of operations.
+ */
+static void
+bench_hash (unsigned int count, long ops)
+{
+  struct PBASettings setting = {{0}, count, PREFIX_DEFAULT};
+  gint64 start = now_ns ();
+  long i;
+
+  for (i = 0; i < ops; i++)
+    free (pba_hash (&setting, "benchmark password"));
+  report ("hash", count, ops, now_ns () - start);
+}
+
+/**
+ * @brief Counts a verification.
+ *
+ * @param[in] result  Result of the verification.
+ * @param[in] data    Counter.
+ */
+static void
+count_verified (enum pba_rc result, void *data)
+{
+  if (result == VALID)
+    g_atomic_int_add ((gint *) data, 1);
+}
+
+/**
+ * @brief Benchmarks a burst of verifications in the pool.
+ *
+ * @param[in] count    Rounds.
+ * @param[in] threads  Threads of the pool.
+ * @param[in] ops      Number of verifications.
+ */
+static void
+bench_verify_async (unsigned int count, unsigned int threads, long ops)
+{
+  struct PBASettings setting = {{0}, count, PREFIX_DEFAULT};
+  gint verified = 0;
+  gint64 start;
+  char *hash;
+  long i;
+
+  hash = pba_hash (&setting, "benchmark password");
+  if (hash == NULL || pba_pool_init (threads, ops))
+    {
+      free (hash);
+      return;
+    }
+  start = now_ns ();
+  for (i = 0; i < ops; i++)
+    pba_verify_hash_async (&setting, hash, "benchmark password",
+                           count_verified, &verified);
+  pba_pool_finalize ();
+  report ("verify_async", count, verified, now_ns () - start);
+  free (hash);
+}
+
+int
+main (int argc, char **argv)
+{
+  unsigned int target_ms = argc > 1 ? atoi (argv[1]) : 100;
+  unsigned int threads = argc > 2 ? atoi (argv[2]) : 4;
+  unsigned int count;
+
+  if (target_ms < 1)
+    target_ms = 100;
+  if (threads < 1)
+    threads = 4;
+
+  bench_hash (5000, 20);
+  bench_hash (COUNT_DEFAULT, 10);
+  bench_hash (100000, 5);
+  bench_verify_async (COUNT_DEFAULT, threads, 10 * threads);
+
+  count = pba_calibrate (target_ms);
+  if (count == 0)
+    return 1;
+  bench_hash (count, 5);
+  printf ("{\"name\": \"calibrated\", \"target_ms\": %u, \"count\": %u}\n",
+          target_ms, count);
+  return 0;
+}
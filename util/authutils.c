@@ -291,3 +291,274 @@ gvm_authenticate_classic (const gchar *username, const gchar *password,
   g_free (actual);
   return ret;
 }
+
+/**
+ * @brief Cached successful authentication.
+ */
+typedef struct
+{
+  gchar *key;      ///< Keyed hash of the credentials.
+  gchar *user_key; ///< Keyed hash of the username, for invalidation.
+  gint64 expires;  ///< When the entry expires, monotonic.
+} auth_cache_entry_t;
+
+static GHashTable *auth_cache = NULL;          ///< Entry links, by key.
+static GQueue auth_cache_order = G_QUEUE_INIT; ///< Entries, oldest first.
+static GMutex auth_cache_mutex;                ///< Lock for the cache.
+static guchar auth_cache_secret[32];           ///< Key of the keyed hash.
+static gint64 auth_cache_ttl;                  ///< Lifetime of an entry.
+static guint auth_cache_max;                   ///< Maximum entries.
+
+/**
+ * @brief Free a cache entry.
+ *
+ * @param entry  Entry.
+ */
+static void
+auth_cache_entry_free (auth_cache_entry_t *entry)
+{
+  g_free (entry->key);
+  g_free (entry->user_key);
+  g_free (entry);
+}
+
+/**
+ * @brief Remove a link of the cache and free its entry.
+ *
+ * @param link  Link in auth_cache_order.
+ */
+static void
+auth_cache_remove_link (GList *link)
+{
+  auth_cache_entry_t *entry = link->data;
+
+  g_hash_table_remove (auth_cache, entry->key);
+  g_queue_delete_link (&auth_cache_order, link);
+  auth_cache_entry_free (entry);
+}
+
+/**
+ * @brief Compute the keyed hash of the parts of a credential.
+ *
+ * The parts are separated by a NUL, so they cannot be shifted into each
+ * other.
+ *
+ * @param method    Authentication method.
+ * @param username  Username.
+ * @param context   What the result depends on, e.g. the stored hash or the
+ *                  LDAP server, or NULL.
+ * @param password  Password, or NULL for the hash of the username alone.
+ *
+ * @return Hexadecimal hash, free with g_free.
+ */
+static gchar *
+auth_cache_hash (auth_method_t method, const gchar *username,
+                 const gchar *context, const gchar *password)
+{
+  GHmac *hmac;
+  gchar *hex;
+  guchar separator = 0, method_byte = (guchar) method;
+
+  hmac = g_hmac_new (G_CHECKSUM_SHA256, auth_cache_secret,
+                     sizeof (auth_cache_secret));
+  g_hmac_update (hmac, (const guchar *) username, strlen (username));
+  if (password)
+    {
+      g_hmac_update (hmac, &separator, 1);
+      g_hmac_update (hmac, &method_byte, 1);
+      g_hmac_update (hmac, &separator, 1);
+      if (context)
+        g_hmac_update (hmac, (const guchar *) context, strlen (context));
+      g_hmac_update (hmac, &separator, 1);
+      g_hmac_update (hmac, (const guchar *) password, strlen (password));
+    }
+  hex = g_strdup (g_hmac_get_string (hmac));
+  g_hmac_unref (hmac);
+  return hex;
+}
+
+/**
+ * @brief Enable the cache of successful authentications.
+ *
+ * The cache only holds keyed hashes of the credentials, with a key chosen
+ * randomly when the cache is enabled.
+ *
+ * @param ttl          Seconds a successful authentication is remembered.
+ * @param max_entries  Maximum number of entries.
+ *
+ * @return 0 success, -1 error.
+ */
+int
+gvm_auth_cache_enable (guint ttl, guint max_entries)
+{
+  if (ttl == 0 || max_entries == 0)
+    return -1;
+  if (initialized == FALSE && gvm_auth_init ())
+    return -1;
+
+  g_mutex_lock (&auth_cache_mutex);
+  if (auth_cache == NULL)
+    {
+      auth_cache = g_hash_table_new (g_str_hash, g_str_equal);
+      gcry_randomize (auth_cache_secret, sizeof (auth_cache_secret),
+                      GCRY_STRONG_RANDOM);
+    }
+  auth_cache_ttl = (gint64) ttl * G_USEC_PER_SEC;
+  auth_cache_max = max_entries;
+  while (g_queue_get_length (&auth_cache_order) > auth_cache_max)
+    auth_cache_remove_link (auth_cache_order.head);
+  g_mutex_unlock (&auth_cache_mutex);
+  return 0;
+}
+
+/**
+ * @brief Drop all cached authentications, keeping the cache enabled.
+ */
+void
+gvm_auth_cache_invalidate (void)
+{
+  g_mutex_lock (&auth_cache_mutex);
+  while (auth_cache_order.head)
+    auth_cache_remove_link (auth_cache_order.head);
+  g_mutex_unlock (&auth_cache_mutex);
+}
+
+/**
+ * @brief Disable the cache of successful authentications and empty it.
+ */
+void
+gvm_auth_cache_disable (void)
+{
+  gvm_auth_cache_invalidate ();
+  g_mutex_lock (&auth_cache_mutex);
+  if (auth_cache)
+    g_hash_table_destroy (auth_cache);
+  auth_cache = NULL;
+  memset (auth_cache_secret, 0, sizeof (auth_cache_secret));
+  g_mutex_unlock (&auth_cache_mutex);
+}
+
+/**
+ * @brief Drop the cached authentications of a user.
+ *
+ * To be called when the password, the role or the authentication method of
+ * the user changes, or when the user is removed.
+ *
+ * @param username  Username.
+ */
+void
+gvm_auth_cache_invalidate_user (const gchar *username)
+{
+  gchar *user_key;
+  GList *link, *next;
+
+  if (username == NULL)
+    return;
+
+  g_mutex_lock (&auth_cache_mutex);
+  if (auth_cache == NULL)
+    {
+      g_mutex_unlock (&auth_cache_mutex);
+      return;
+    }
+  user_key = auth_cache_hash (0, username, NULL, NULL);
+  for (link = auth_cache_order.head; link; link = next)
+    {
+      auth_cache_entry_t *entry = link->data;
+
+      next = link->next;
+      if (strcmp (entry->user_key, user_key) == 0)
+        auth_cache_remove_link (link);
+    }
+  g_mutex_unlock (&auth_cache_mutex);
+  g_free (user_key);
+}
+
+/**
+ * @brief Check whether an authentication succeeded recently.
+ *
+ * @param method    Authentication method.
+ * @param username  Username.
+ * @param password  Password.
+ * @param context   What the result depends on, e.g. the stored hash or the
+ *                  LDAP server, or NULL.
+ *
+ * @return 1 if the same credentials were authenticated within the TTL, else
+ *         0, also when the cache is disabled.
+ */
+int
+gvm_auth_cache_check (auth_method_t method, const gchar *username,
+                      const gchar *password, const gchar *context)
+{
+  gchar *key;
+  GList *link;
+  int found = 0;
+
+  if (username == NULL || password == NULL)
+    return 0;
+
+  g_mutex_lock (&auth_cache_mutex);
+  if (auth_cache == NULL)
+    {
+      g_mutex_unlock (&auth_cache_mutex);
+      return 0;
+    }
+  key = auth_cache_hash (method, username, context, password);
+  link = g_hash_table_lookup (auth_cache, key);
+  if (link)
+    {
+      auth_cache_entry_t *entry = link->data;
+
+      if (entry->expires > g_get_monotonic_time ())
+        found = 1;
+      else
+        auth_cache_remove_link (link);
+    }
+  g_mutex_unlock (&auth_cache_mutex);
+  g_free (key);
+  return found;
+}
+
+/**
+ * @brief Remember a successful authentication.
+ *
+ * When the cache is full the oldest entry is dropped.
+ *
+ * @param method    Authentication method.
+ * @param username  Username.
+ * @param password  Password.
+ * @param context   What the result depends on, e.g. the stored hash or the
+ *                  LDAP server, or NULL.
+ */
+void
+gvm_auth_cache_add (auth_method_t method, const gchar *username,
+                    const gchar *password, const gchar *context)
+{
+  auth_cache_entry_t *entry;
+  GList *link;
+  gchar *key;
+
+  if (username == NULL || password == NULL)
+    return;
+
+  g_mutex_lock (&auth_cache_mutex);
+  if (auth_cache == NULL)
+    {
+      g_mutex_unlock (&auth_cache_mutex);
+      return;
+    }
+  key = auth_cache_hash (method, username, context, password);
+  link = g_hash_table_lookup (auth_cache, key);
+  if (link)
+    auth_cache_remove_link (link);
+  while (g_queue_get_length (&auth_cache_order) >= auth_cache_max)
+    auth_cache_remove_link (auth_cache_order.head);
+
+  entry = g_malloc (sizeof (auth_cache_entry_t));
+  entry->key = key;
+  entry->user_key = auth_cache_hash (0, username, NULL, NULL);
+  entry->expires = g_get_monotonic_time () + auth_cache_ttl;
+  g_queue_push_tail (&auth_cache_order, entry);
+  g_hash_table_insert (auth_cache, entry->key, auth_cache_order.tail);
+  g_mutex_unlock (&auth_cache_mutex);
+}
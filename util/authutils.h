@@ -53,4 +53,24 @@ gvm_auth_ldap_enabled (void);
 int
 gvm_auth_radius_enabled (void);
 
+int
+gvm_auth_cache_enable (guint, guint);
+
+void
+gvm_auth_cache_disable (void);
+
+void
+gvm_auth_cache_invalidate (void);
+
+void
+gvm_auth_cache_invalidate_user (const gchar *);
+
+int
+gvm_auth_cache_check (auth_method_t, const gchar *, const gchar *,
+                      const gchar *);
+
+void
+gvm_auth_cache_add (auth_method_t, const gchar *, const gchar *,
+                    const gchar *);
+
 #endif /* not _GVM_AUTHUTILS_H */
@@ -0,0 +1,114 @@
+/* SPDX-FileCopyrightText: 2026 Greenbone AG
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "authutils.c"
+
+#include <cgreen/cgreen.h>
+#include <cgreen/mocks.h>
+
+Describe (authutils);
+BeforeEach (authutils)
+{
+  gvm_auth_cache_enable (60, 10);
+}
+AfterEach (authutils)
+{
+  gvm_auth_cache_disable ();
+}
+
+/* gvm_auth_cache */
+
+Ensure (authutils, auth_cache_check_finds_added_credentials)
+{
+  gvm_auth_cache_add (AUTHENTICATION_METHOD_FILE, "user", "secret", "hash");
+  assert_that (gvm_auth_cache_check (AUTHENTICATION_METHOD_FILE, "user",
+                                     "secret", "hash"),
+               is_equal_to (1));
+}
+
+Ensure (authutils, auth_cache_check_misses_unknown_credentials)
+{
+  gvm_auth_cache_add (AUTHENTICATION_METHOD_FILE, "user", "secret", "hash");
+  assert_that (gvm_auth_cache_check (AUTHENTICATION_METHOD_FILE, "other",
+                                     "secret", "hash"),
+               is_equal_to (0));
+  assert_that (gvm_auth_cache_check (AUTHENTICATION_METHOD_LDAP_CONNECT,
+                                     "user", "secret", "hash"),
+               is_equal_to (0));
+  assert_that (gvm_auth_cache_check (AUTHENTICATION_METHOD_FILE, "user",
+                                     "secret", "new hash"),
+               is_equal_to (0));
+}
+
+Ensure (authutils, auth_cache_check_misses_wrong_password)
+{
+  gvm_auth_cache_add (AUTHENTICATION_METHOD_FILE, "user", "secret", "hash");
+  assert_that (gvm_auth_cache_check (AUTHENTICATION_METHOD_FILE, "user",
+                                     "wrong", "hash"),
+               is_equal_to (0));
+  assert_that (gvm_auth_cache_check (AUTHENTICATION_METHOD_FILE, "user",
+                                     "secre", "hash"),
+               is_equal_to (0));
+}
+
+Ensure (authutils, auth_cache_check_misses_expired_credentials)
+{
+  /* Expire the entries one microsecond after they are added. */
+  auth_cache_ttl = 1;
+  gvm_auth_cache_add (AUTHENTICATION_METHOD_FILE, "user", "secret", "hash");
+  g_usleep (1000);
+  assert_that (gvm_auth_cache_check (AUTHENTICATION_METHOD_FILE, "user",
+                                     "secret", "hash"),
+               is_equal_to (0));
+  assert_that (g_queue_get_length (&auth_cache_order), is_equal_to (0));
+}
+
+Ensure (authutils, auth_cache_invalidate_user_drops_its_credentials)
+{
+  gvm_auth_cache_add (AUTHENTICATION_METHOD_FILE, "user", "secret", "hash");
+  gvm_auth_cache_add (AUTHENTICATION_METHOD_FILE, "other", "secret", "hash");
+  gvm_auth_cache_invalidate_user ("user");
+  assert_that (gvm_auth_cache_check (AUTHENTICATION_METHOD_FILE, "user",
+                                     "secret", "hash"),
+               is_equal_to (0));
+  assert_that (gvm_auth_cache_check (AUTHENTICATION_METHOD_FILE, "other",
+                                     "secret", "hash"),
+               is_equal_to (1));
+}
+
+Ensure (authutils, auth_cache_check_misses_when_disabled)
+{
+  gvm_auth_cache_add (AUTHENTICATION_METHOD_FILE, "user", "secret", "hash");
+  gvm_auth_cache_disable ();
+  assert_that (gvm_auth_cache_check (AUTHENTICATION_METHOD_FILE, "user",
+                                     "secret", "hash"),
+               is_equal_to (0));
+}
+
+int
+main (int argc, char **argv)
+{
+  TestSuite *suite;
+
+  suite = create_test_suite ();
+
+  add_test_with_context (suite, authutils,
+                         auth_cache_check_finds_added_credentials);
+  add_test_with_context (suite, authutils,
+                         auth_cache_check_misses_unknown_credentials);
+  add_test_with_context (suite, authutils,
+                         auth_cache_check_misses_wrong_password);
+  add_test_with_context (suite, authutils,
+                         auth_cache_check_misses_expired_credentials);
+  add_test_with_context (suite, authutils,
+                         auth_cache_invalidate_user_drops_its_credentials);
+  add_test_with_context (suite, authutils,
+                         auth_cache_check_misses_when_disabled);
+
+  if (argc > 1)
+    return run_single_test (suite, argv[1], create_text_reporter ());
+
+  return run_test_suite (suite, create_text_reporter ());
+}
@@ -6,6 +6,11 @@
 /**
  * @file
  * @brief Functions related to data compression (gzip format.)
+ *
+ * gvm_compress, gvm_compress_gzipheader and gvm_uncompress work on a buffer
+ * in memory.  The gvm_compress_stream_t object compresses or uncompresses
+ * data pushed to it in chunks, passing the output on to a sink as it is
+ * produced, or keeping it to be pulled by the caller.
  */
 
 /**
@@ -17,8 +22,14 @@
 
 #include "compressutils.h"
 
-#include <glib.h> /* for g_free, g_malloc0 */
-#include <zlib.h> /* for z_stream, Z_NULL, Z_OK, Z_BUF_ERROR, Z_STREAM_END */
+#include <errno.h>  /* for errno, EINTR */
+#include <glib.h>   /* for g_free, g_malloc0 */
+#include <string.h> /* for memcpy, memset */
+#include <unistd.h> /* for write */
+#include <zlib.h>   /* for z_stream, Z_NULL, Z_OK, Z_BUF_ERROR, Z_STREAM_END */
+#ifdef HAVE_ZSTD
+#include <zstd.h> /* for ZSTD_CStream, ZSTD_compressStream2, ... */
+#endif
 
 #undef G_LOG_DOMAIN
 /**
@@ -26,6 +37,57 @@
  */
 #define G_LOG_DOMAIN "libgvm util"
 
+/**
+ * @brief Deflates all the input of a stream into a new buffer.
+ *
+ * The buffer starts at the deflate bound of the input and grows in place if
+ * that is ever exceeded, so the input is only deflated once.  Ends the
+ * stream.
+ *
+ * @param[in]   strm    Initialized deflate stream with the input set.
+ * @param[in]   flush   Flush mode, Z_SYNC_FLUSH or Z_FINISH.
+ * @param[out]  dstlen  Length of compressed data.
+ *
+ * @return Pointer to compressed data if success, NULL otherwise.
+ */
+static void *
+deflate_all (z_stream *strm, int flush, unsigned long *dstlen)
+{
+  unsigned long buflen;
+  unsigned char *buffer;
+
+  /* Room for the sync flush marker, which deflateBound leaves out. */
+  buflen = deflateBound (strm, strm->avail_in) + 32;
+  buffer = g_malloc0 (buflen);
+  strm->avail_out = buflen;
+  strm->next_out = buffer;
+
+  while (1)
+    {
+      int err;
+
+      err = deflate (strm, flush);
+      if (err != Z_OK && err != Z_STREAM_END && err != Z_BUF_ERROR)
+        {
+          deflateEnd (strm);
+          g_free (buffer);
+          return NULL;
+        }
+      if (strm->avail_out != 0 && (flush != Z_FINISH || err == Z_STREAM_END))
+        break;
+
+      buffer = g_realloc (buffer, buflen * 2);
+      memset (buffer + buflen, 0, buflen);
+      strm->next_out = buffer + strm->total_out;
+      strm->avail_out = buflen * 2 - strm->total_out;
+      buflen *= 2;
+    }
+
+  deflateEnd (strm);
+  *dstlen = strm->total_out;
+  return buffer;
+}
+
 /**
  * @brief Compresses data in src buffer.
  *
@@ -38,60 +100,26 @@
 void *
 gvm_compress (const void *src, unsigned long srclen, unsigned long *dstlen)
 {
-  unsigned long buflen = srclen * 2;
+  z_stream strm;
 
   if (src == NULL || dstlen == NULL)
     return NULL;
 
-  if (buflen < 30)
-    buflen = 30;
-
-  while (1)
-    {
-      int err;
-      void *buffer;
-      z_stream strm;
-
-      /* Initialize deflate state */
-      strm.zalloc = Z_NULL;
-      strm.zfree = Z_NULL;
-      strm.opaque = Z_NULL;
-      strm.avail_in = srclen;
+  /* Initialize deflate state */
+  strm.zalloc = Z_NULL;
+  strm.zfree = Z_NULL;
+  strm.opaque = Z_NULL;
+  strm.avail_in = srclen;
 #ifdef z_const
-      strm.next_in = src;
+  strm.next_in = src;
 #else
-      /* Workaround for older zlib. */
-      strm.next_in = (void *) src;
+  /* Workaround for older zlib. */
+  strm.next_in = (void *) src;
 #endif
-      if (deflateInit (&strm, Z_DEFAULT_COMPRESSION) != Z_OK)
-        return NULL;
-
-      buffer = g_malloc0 (buflen);
-      strm.avail_out = buflen;
-      strm.next_out = buffer;
-
-      err = deflate (&strm, Z_SYNC_FLUSH);
-      deflateEnd (&strm);
-      switch (err)
-        {
-        case Z_OK:
-        case Z_STREAM_END:
-          if (strm.avail_out != 0)
-            {
-              *dstlen = strm.total_out;
-              return buffer;
-            }
-          /* Fallthrough. */
-        case Z_BUF_ERROR:
-          g_free (buffer);
-          buflen *= 2;
-          break;
+  if (deflateInit (&strm, Z_DEFAULT_COMPRESSION) != Z_OK)
+    return NULL;
 
-        default:
-          g_free (buffer);
-          return NULL;
-        }
-    }
+  return deflate_all (&strm, Z_SYNC_FLUSH, dstlen);
 }
 
 /**
@@ -105,63 +133,104 @@ gvm_compress (const void *src, unsigned long srclen, unsigned long *dstlen)
  */
 void *
 gvm_uncompress (const void *src, unsigned long srclen, unsigned long *dstlen)
+{
+  return gvm_uncompress_max (src, srclen, 0, dstlen);
+}
+
+/**
+ * @brief Uncompresses data in src buffer, up to a maximum length.
+ *
+ * Protects against data which expands to much more than its length, as the
+ * uncompression fails once the output exceeds the maximum.
+ *
+ * @param[in]   src     Buffer of data to uncompress.
+ * @param[in]   srclen  Length of data to uncompress.
+ * @param[in]   maxlen  Maximum length of the uncompressed data, 0 for none.
+ * @param[out]  dstlen  Length of uncompressed data.
+ *
+ * @return Pointer to uncompressed data if success, NULL otherwise.
+ */
+void *
+gvm_uncompress_max (const void *src, unsigned long srclen,
+                    unsigned long maxlen, unsigned long *dstlen)
 {
   unsigned long buflen = srclen * 2;
+  unsigned char *buffer;
+  z_stream strm;
 
   if (src == NULL || dstlen == NULL)
     return NULL;
 
-  while (1)
-    {
-      int err;
-      void *buffer;
-      z_stream strm;
-
-      /* Initialize inflate state */
-      strm.zalloc = Z_NULL;
-      strm.zfree = Z_NULL;
-      strm.opaque = Z_NULL;
-      strm.avail_in = srclen;
+  if (buflen < 64)
+    buflen = 64;
+  /* Room for the data and the zero byte after it. */
+  if (maxlen && buflen > maxlen + 1)
+    buflen = maxlen + 1;
+
+  /* Initialize inflate state */
+  strm.zalloc = Z_NULL;
+  strm.zfree = Z_NULL;
+  strm.opaque = Z_NULL;
+  strm.avail_in = srclen;
 #ifdef z_const
-      strm.next_in = src;
+  strm.next_in = src;
 #else
-      /* Workaround for older zlib. */
-      strm.next_in = (void *) src;
+  /* Workaround for older zlib. */
+  strm.next_in = (void *) src;
 #endif
-      /*
-       * From: http://www.zlib.net/manual.html
-       * Add 32 to windowBits to enable zlib and gzip decoding with automatic
-       * header detection.
-       */
-      if (inflateInit2 (&strm, 15 + 32) != Z_OK)
-        return NULL;
-
-      buffer = g_malloc0 (buflen);
-      strm.avail_out = buflen;
-      strm.next_out = buffer;
+  /*
+   * From: http://www.zlib.net/manual.html
+   * Add 32 to windowBits to enable zlib and gzip decoding with automatic
+   * header detection.
+   */
+  if (inflateInit2 (&strm, 15 + 32) != Z_OK)
+    return NULL;
+
+  buffer = g_malloc0 (buflen);
+  strm.avail_out = buflen;
+  strm.next_out = buffer;
+
+  /* Grow the buffer in place instead of restarting, and keep at least one
+   * zero byte after the data, as callers may use it as a string. */
+  while (1)
+    {
+      unsigned long newlen;
+      int err;
 
       err = inflate (&strm, Z_SYNC_FLUSH);
-      inflateEnd (&strm);
-      switch (err)
+      if (err != Z_OK && err != Z_STREAM_END && err != Z_BUF_ERROR)
+        break;
+      if (strm.avail_out != 0)
         {
-        case Z_OK:
-        case Z_STREAM_END:
-          if (strm.avail_out != 0)
+          if (err == Z_STREAM_END || strm.avail_in == 0)
             {
               *dstlen = strm.total_out;
+              inflateEnd (&strm);
               return buffer;
             }
-          /* Fallthrough. */
-        case Z_BUF_ERROR:
-          g_free (buffer);
-          buflen *= 2;
-          break;
+          if (err == Z_BUF_ERROR)
+            break;
+        }
 
-        default:
-          g_free (buffer);
-          return NULL;
+      if (maxlen && buflen > maxlen)
+        {
+          g_debug ("%s: uncompressed data larger than %lu bytes", __func__,
+                   maxlen);
+          break;
         }
+      newlen = buflen * 2;
+      if (maxlen && newlen > maxlen + 1)
+        newlen = maxlen + 1;
+      buffer = g_realloc (buffer, newlen);
+      memset (buffer + buflen, 0, newlen - buflen);
+      strm.next_out = buffer + strm.total_out;
+      strm.avail_out = newlen - strm.total_out;
+      buflen = newlen;
     }
+
+  inflateEnd (&strm);
+  g_free (buffer);
+  return NULL;
 }
 
 /**
@@ -177,63 +246,565 @@ void *
 gvm_compress_gzipheader (const void *src, unsigned long srclen,
                          unsigned long *dstlen)
 {
-  unsigned long buflen = srclen * 2;
   int windowsBits = 15;
   int GZIP_ENCODING = 16;
+  z_stream strm;
 
   if (src == NULL || dstlen == NULL)
     return NULL;
 
-  if (buflen < 30)
-    buflen = 30;
+  /* Initialize deflate state */
+  strm.zalloc = Z_NULL;
+  strm.zfree = Z_NULL;
+  strm.opaque = Z_NULL;
+  strm.avail_in = srclen;
+#ifdef z_const
+  strm.next_in = src;
+#else
+  /* Workaround for older zlib. */
+  strm.next_in = (void *) src;
+#endif
 
-  while (1)
+  if (deflateInit2 (&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                    windowsBits | GZIP_ENCODING, 8, Z_DEFAULT_STRATEGY)
+      != Z_OK)
+    return NULL;
+
+  return deflate_all (&strm, Z_FINISH, dstlen);
+}
+
+/* Streams. */
+
+/**
+ * @brief Size of the output chunks of a stream.
+ */
+#define COMPRESS_CHUNK 16384
+
+/**
+ * @brief Operation of a stream run.
+ */
+enum stream_op
+{
+  STREAM_PUSH,  ///< Consume input.
+  STREAM_FLUSH, ///< Consume input and flush the output so far.
+  STREAM_FINISH ///< Consume input and end the stream.
+};
+
+/**
+ * @brief Streaming compressor or decompressor.
+ */
+struct gvm_compress_stream
+{
+  gvm_compress_codec_t codec; ///< Format.
+  gboolean decompress;        ///< Whether the stream uncompresses.
+  gboolean ended;             ///< Whether the end of the data was reached.
+  gboolean failed;            ///< Whether an error occurred.
+  gvm_compress_sink_t sink;   ///< Consumer of the output, NULL to pull.
+  void *sink_data;            ///< User data of the sink.
+  GByteArray *pending;        ///< Output waiting to be pulled.
+  z_stream zstrm;             ///< zlib and gzip state.
+#ifdef HAVE_ZSTD
+  ZSTD_CStream *zcs; ///< Zstandard compression state.
+  ZSTD_DStream *zds; ///< Zstandard decompression state.
+#endif
+  unsigned char out[COMPRESS_CHUNK]; ///< Output chunk.
+};
+
+/**
+ * @brief Checks whether a format is available for streams.
+ *
+ * @param[in]  codec  Format.
+ *
+ * @return TRUE if available, else FALSE.
+ */
+gboolean
+gvm_compress_codec_supported (gvm_compress_codec_t codec)
+{
+  switch (codec)
     {
-      int err;
-      void *buffer;
-      z_stream strm;
-
-      /* Initialize deflate state */
-      strm.zalloc = Z_NULL;
-      strm.zfree = Z_NULL;
-      strm.opaque = Z_NULL;
-      strm.avail_in = srclen;
+    case GVM_COMPRESS_ZLIB:
+    case GVM_COMPRESS_GZIP:
+      return TRUE;
+    case GVM_COMPRESS_ZSTD:
+#ifdef HAVE_ZSTD
+      return TRUE;
+#else
+      return FALSE;
+#endif
+    default:
+      return FALSE;
+    }
+}
+
+/**
+ * @brief Creates a stream.
+ *
+ * The output is passed to the sink as it is produced.  Without a sink it is
+ * kept in the stream until gvm_compress_stream_pull takes it.
+ *
+ * When uncompressing, GVM_COMPRESS_ZLIB and GVM_COMPRESS_GZIP both accept
+ * either of the two formats.  Concatenated gzip members or Zstandard frames
+ * are uncompressed one after the other.
+ *
+ * @param[in]  codec       Format.
+ * @param[in]  decompress  TRUE to uncompress, FALSE to compress.
+ * @param[in]  sink        Consumer of the output, or NULL.
+ * @param[in]  sink_data   User data for the sink.
+ *
+ * @return New stream, NULL if the format is not available or on error.
+ *         Free with gvm_compress_stream_free.
+ */
+gvm_compress_stream_t *
+gvm_compress_stream_new (gvm_compress_codec_t codec, gboolean decompress,
+                         gvm_compress_sink_t sink, void *sink_data)
+{
+  gvm_compress_stream_t *stream;
+  int ret;
+
+  if (!gvm_compress_codec_supported (codec))
+    return NULL;
+
+  stream = g_malloc0 (sizeof (*stream));
+  stream->codec = codec;
+  stream->decompress = decompress;
+  stream->sink = sink;
+  stream->sink_data = sink_data;
+  if (sink == NULL)
+    stream->pending = g_byte_array_new ();
+
+#ifdef HAVE_ZSTD
+  if (codec == GVM_COMPRESS_ZSTD)
+    {
+      if (decompress)
+        stream->zds = ZSTD_createDStream ();
+      else
+        stream->zcs = ZSTD_createCStream ();
+      if (stream->zds == NULL && stream->zcs == NULL)
+        {
+          gvm_compress_stream_free (stream);
+          return NULL;
+        }
+      return stream;
+    }
+#endif
+
+  stream->zstrm.zalloc = Z_NULL;
+  stream->zstrm.zfree = Z_NULL;
+  stream->zstrm.opaque = Z_NULL;
+  if (decompress)
+    /* Add 32 to windowBits to enable zlib and gzip decoding with automatic
+     * header detection. */
+    ret = inflateInit2 (&stream->zstrm, 15 + 32);
+  else
+    ret = deflateInit2 (&stream->zstrm, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                        codec == GVM_COMPRESS_GZIP ? 15 | 16 : 15, 8,
+                        Z_DEFAULT_STRATEGY);
+  if (ret != Z_OK)
+    {
+      g_byte_array_free (stream->pending, TRUE);
+      g_free (stream);
+      return NULL;
+    }
+  return stream;
+}
+
+/**
+ * @brief Sink appending to a GString.
+ *
+ * @param[in]  data       Output data.
+ * @param[in]  len        Length of data.
+ * @param[in]  sink_data  GString.
+ *
+ * @return 0.
+ */
+static int
+gstring_sink (const void *data, size_t len, void *sink_data)
+{
+  g_string_append_len (sink_data, data, len);
+  return 0;
+}
+
+/**
+ * @brief Sink writing to a file descriptor.
+ *
+ * @param[in]  data       Output data.
+ * @param[in]  len        Length of data.
+ * @param[in]  sink_data  File descriptor, as GINT_TO_POINTER.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+fd_sink (const void *data, size_t len, void *sink_data)
+{
+  int fd = GPOINTER_TO_INT (sink_data);
+  const char *pos = data;
+
+  while (len)
+    {
+      ssize_t count;
+
+      count = write (fd, pos, len);
+      if (count < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          g_warning ("%s: write: %s", __func__, g_strerror (errno));
+          return -1;
+        }
+      pos += count;
+      len -= count;
+    }
+  return 0;
+}
+
+/**
+ * @brief Creates a stream appending its output to a GString.
+ *
+ * @param[in]  codec       Format.
+ * @param[in]  decompress  TRUE to uncompress, FALSE to compress.
+ * @param[in]  out         String for the output, must outlive the stream.
+ *
+ * @return New stream, NULL on error.  Free with gvm_compress_stream_free.
+ */
+gvm_compress_stream_t *
+gvm_compress_stream_new_gstring (gvm_compress_codec_t codec,
+                                 gboolean decompress, GString *out)
+{
+  if (out == NULL)
+    return NULL;
+  return gvm_compress_stream_new (codec, decompress, gstring_sink, out);
+}
+
+/**
+ * @brief Creates a stream writing its output to a file descriptor.
+ *
+ * @param[in]  codec       Format.
+ * @param[in]  decompress  TRUE to uncompress, FALSE to compress.
+ * @param[in]  fd          File descriptor, not closed by the stream.
+ *
+ * @return New stream, NULL on error.  Free with gvm_compress_stream_free.
+ */
+gvm_compress_stream_t *
+gvm_compress_stream_new_fd (gvm_compress_codec_t codec, gboolean decompress,
+                            int fd)
+{
+  if (fd < 0)
+    return NULL;
+  return gvm_compress_stream_new (codec, decompress, fd_sink,
+                                  GINT_TO_POINTER (fd));
+}
+
+/**
+ * @brief Passes output of a stream on.
+ *
+ * @param[in]  stream  Stream.
+ * @param[in]  data    Output data.
+ * @param[in]  len     Length of data.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+stream_emit (gvm_compress_stream_t *stream, const void *data, size_t len)
+{
+  if (len == 0)
+    return 0;
+  if (stream->sink)
+    return stream->sink (data, len, stream->sink_data);
+  g_byte_array_append (stream->pending, data, len);
+  return 0;
+}
+
+/**
+ * @brief Runs a zlib or gzip stream over some input.
+ *
+ * @param[in]  stream  Stream.
+ * @param[in]  data    Input data.
+ * @param[in]  len     Length of data.
+ * @param[in]  op      Operation.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+stream_run_zlib (gvm_compress_stream_t *stream, const void *data, size_t len,
+                 enum stream_op op)
+{
+  z_stream *strm = &stream->zstrm;
+  int flush;
+
+  if (stream->decompress)
+    flush = Z_NO_FLUSH;
+  else if (op == STREAM_FINISH)
+    flush = Z_FINISH;
+  else if (op == STREAM_FLUSH)
+    flush = Z_SYNC_FLUSH;
+  else
+    flush = Z_NO_FLUSH;
+
+  /* Feed the input in pieces that fit in avail_in. */
+  do
+    {
+      uInt piece = len > G_MAXUINT ? G_MAXUINT : len;
+
 #ifdef z_const
-      strm.next_in = src;
+      strm->next_in = data;
 #else
       /* Workaround for older zlib. */
-      strm.next_in = (void *) src;
+      strm->next_in = (void *) data;
 #endif
+      strm->avail_in = piece;
+      data = (const char *) data + piece;
+      len -= piece;
 
-      if (deflateInit2 (&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
-                        windowsBits | GZIP_ENCODING, 8, Z_DEFAULT_STRATEGY)
-          != Z_OK)
-        return NULL;
+      while (1)
+        {
+          int err;
 
-      buffer = g_malloc0 (buflen);
-      strm.avail_out = buflen;
-      strm.next_out = buffer;
+          strm->next_out = stream->out;
+          strm->avail_out = COMPRESS_CHUNK;
+          if (stream->decompress)
+            err = inflate (strm, flush);
+          else
+            err = deflate (strm, len ? Z_NO_FLUSH : flush);
+          if (err != Z_OK && err != Z_STREAM_END && err != Z_BUF_ERROR)
+            return -1;
+          if (stream_emit (stream, stream->out,
+                           COMPRESS_CHUNK - strm->avail_out))
+            return -1;
 
-      err = deflate (&strm, Z_FINISH);
-      deflateEnd (&strm);
-      switch (err)
-        {
-        case Z_OK:
-        case Z_STREAM_END:
-          if (strm.avail_out != 0)
+          if (err == Z_STREAM_END)
             {
-              *dstlen = strm.total_out;
-              return buffer;
+              stream->ended = TRUE;
+              if (!stream->decompress)
+                break;
+              if (strm->avail_in == 0)
+                break;
+              /* Another gzip member follows. */
+              if (inflateReset (strm) != Z_OK)
+                return -1;
+              stream->ended = FALSE;
+              continue;
             }
-          /* Fallthrough. */
-        case Z_BUF_ERROR:
-          g_free (buffer);
-          buflen *= 2;
-          break;
+          if (strm->avail_out != 0 && strm->avail_in == 0
+              && (stream->decompress || len || flush != Z_FINISH))
+            break;
+          if (err == Z_BUF_ERROR && strm->avail_out != 0)
+            return -1;
+        }
+    }
+  while (len);
 
-        default:
-          g_free (buffer);
-          return NULL;
+  return 0;
+}
+
+#ifdef HAVE_ZSTD
+/**
+ * @brief Runs a Zstandard stream over some input.
+ *
+ * @param[in]  stream  Stream.
+ * @param[in]  data    Input data.
+ * @param[in]  len     Length of data.
+ * @param[in]  op      Operation.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+stream_run_zstd (gvm_compress_stream_t *stream, const void *data, size_t len,
+                 enum stream_op op)
+{
+  ZSTD_inBuffer in = {data, len, 0};
+  ZSTD_EndDirective mode;
+
+  if (op == STREAM_FINISH)
+    mode = ZSTD_e_end;
+  else if (op == STREAM_FLUSH)
+    mode = ZSTD_e_flush;
+  else
+    mode = ZSTD_e_continue;
+
+  /* Without input there is nothing to uncompress, and the state of the end
+   * of a frame must be kept. */
+  if (stream->decompress && len == 0)
+    return 0;
+
+  while (1)
+    {
+      ZSTD_outBuffer out = {stream->out, COMPRESS_CHUNK, 0};
+      size_t ret;
+
+      if (stream->decompress)
+        ret = ZSTD_decompressStream (stream->zds, &out, &in);
+      else
+        ret = ZSTD_compressStream2 (stream->zcs, &out, &in, mode);
+      if (ZSTD_isError (ret))
+        {
+          g_warning ("%s: %s", __func__, ZSTD_getErrorName (ret));
+          return -1;
         }
+      if (stream_emit (stream, stream->out, out.pos))
+        return -1;
+
+      if (stream->decompress)
+        {
+          /* 0 once a frame is complete and its output flushed. */
+          stream->ended = ret == 0;
+          if (in.pos == in.size && (out.pos < out.size || ret == 0))
+            break;
+        }
+      else if (mode == ZSTD_e_continue)
+        {
+          if (in.pos == in.size)
+            break;
+        }
+      else if (ret == 0)
+        {
+          /* Everything flushed, or the frame ended. */
+          stream->ended = mode == ZSTD_e_end;
+          break;
+        }
+    }
+  return 0;
+}
+#endif
+
+/**
+ * @brief Runs a stream over some input.
+ *
+ * @param[in]  stream  Stream.
+ * @param[in]  data    Input data.
+ * @param[in]  len     Length of data.
+ * @param[in]  op      Operation.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+stream_run (gvm_compress_stream_t *stream, const void *data, size_t len,
+            enum stream_op op)
+{
+  int ret;
+
+  if (stream == NULL || stream->failed || (data == NULL && len))
+    return -1;
+  /* Nothing may follow the end of compressed output. */
+  if (stream->ended && !stream->decompress)
+    return len || op != STREAM_FINISH ? -1 : 0;
+
+  if (stream->codec == GVM_COMPRESS_ZSTD)
+#ifdef HAVE_ZSTD
+    ret = stream_run_zstd (stream, data, len, op);
+#else
+    ret = -1;
+#endif
+  else
+    ret = stream_run_zlib (stream, data, len, op);
+
+  if (ret)
+    stream->failed = TRUE;
+  return ret;
+}
+
+/**
+ * @brief Pushes a chunk of input into a stream.
+ *
+ * @param[in]  stream  Stream.
+ * @param[in]  data    Input data.
+ * @param[in]  len     Length of data.
+ *
+ * @return 0 on success, -1 on error, after which the stream only fails.
+ */
+int
+gvm_compress_stream_push (gvm_compress_stream_t *stream, const void *data,
+                          size_t len)
+{
+  return stream_run (stream, data, len, STREAM_PUSH);
+}
+
+/**
+ * @brief Takes output from a stream without a sink.
+ *
+ * @param[in]  stream  Stream.
+ * @param[out] buffer  Buffer for the output.
+ * @param[in]  size    Size of buffer.
+ *
+ * @return Number of bytes written to buffer, 0 when no output is waiting,
+ *         -1 on error or for a stream with a sink.
+ */
+ssize_t
+gvm_compress_stream_pull (gvm_compress_stream_t *stream, void *buffer,
+                          size_t size)
+{
+  size_t count;
+
+  if (stream == NULL || stream->pending == NULL || (buffer == NULL && size))
+    return -1;
+
+  count = MIN (size, stream->pending->len);
+  memcpy (buffer, stream->pending->data, count);
+  g_byte_array_remove_range (stream->pending, 0, count);
+  return count;
+}
+
+/**
+ * @brief Flushes all the output a compressing stream can produce so far.
+ *
+ * The output can then be uncompressed up to the data pushed so far, at a
+ * small cost in compression.  Does nothing for uncompressing streams.
+ *
+ * @param[in]  stream  Stream.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int
+gvm_compress_stream_flush (gvm_compress_stream_t *stream)
+{
+  if (stream && stream->decompress)
+    return stream->failed ? -1 : 0;
+  return stream_run (stream, NULL, 0, STREAM_FLUSH);
+}
+
+/**
+ * @brief Ends a stream.
+ *
+ * A compressing stream writes the rest of its output.  An uncompressing
+ * stream checks that its input was complete.
+ *
+ * @param[in]  stream  Stream.
+ *
+ * @return 0 on success, -1 on error or truncated input.
+ */
+int
+gvm_compress_stream_finish (gvm_compress_stream_t *stream)
+{
+  if (stream_run (stream, NULL, 0, STREAM_FINISH))
+    return -1;
+  return stream->ended ? 0 : -1;
+}
+
+/**
+ * @brief Frees a stream.
+ *
+ * Output not yet finished or pulled is discarded.
+ *
+ * @param[in]  stream  Stream.
+ */
+void
+gvm_compress_stream_free (gvm_compress_stream_t *stream)
+{
+  if (stream == NULL)
+    return;
+
+  if (stream->codec == GVM_COMPRESS_ZSTD)
+    {
+#ifdef HAVE_ZSTD
+      ZSTD_freeCStream (stream->zcs);
+      ZSTD_freeDStream (stream->zds);
+#endif
     }
+  else if (stream->decompress)
+    inflateEnd (&stream->zstrm);
+  else
+    deflateEnd (&stream->zstrm);
+
+  if (stream->pending)
+    g_byte_array_free (stream->pending, TRUE);
+  g_free (stream);
 }
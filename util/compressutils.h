@@ -11,6 +11,9 @@
 #ifndef _GVM_COMPRESSUTILS_H
 #define _GVM_COMPRESSUTILS_H
 
+#include <glib.h>      /* for gboolean, GString */
+#include <sys/types.h> /* for size_t, ssize_t */
+
 void *
 gvm_compress (const void *, unsigned long, unsigned long *);
 
@@ -20,4 +23,59 @@ gvm_compress_gzipheader (const void *, unsigned long, unsigned long *);
 void *
 gvm_uncompress (const void *, unsigned long, unsigned long *);
 
+void *
+gvm_uncompress_max (const void *, unsigned long, unsigned long,
+                    unsigned long *);
+
+/**
+ * @brief Compression formats of a stream.
+ */
+typedef enum
+{
+  GVM_COMPRESS_ZLIB, ///< zlib format.
+  GVM_COMPRESS_GZIP, ///< gzip format.
+  GVM_COMPRESS_ZSTD  ///< Zstandard format, when built with zstd.
+} gvm_compress_codec_t;
+
+/**
+ * @brief Consumer of the output of a stream.
+ *
+ * Gets the output data, its length and the user data of the stream.  Returns
+ * 0 on success, -1 to fail the stream.
+ */
+typedef int (*gvm_compress_sink_t) (const void *, size_t, void *);
+
+/**
+ * @brief Streaming compressor or decompressor.
+ */
+typedef struct gvm_compress_stream gvm_compress_stream_t;
+
+gboolean
+gvm_compress_codec_supported (gvm_compress_codec_t);
+
+gvm_compress_stream_t *
+gvm_compress_stream_new (gvm_compress_codec_t, gboolean, gvm_compress_sink_t,
+                         void *);
+
+gvm_compress_stream_t *
+gvm_compress_stream_new_gstring (gvm_compress_codec_t, gboolean, GString *);
+
+gvm_compress_stream_t *
+gvm_compress_stream_new_fd (gvm_compress_codec_t, gboolean, int);
+
+int
+gvm_compress_stream_push (gvm_compress_stream_t *, const void *, size_t);
+
+ssize_t
+gvm_compress_stream_pull (gvm_compress_stream_t *, void *, size_t);
+
+int
+gvm_compress_stream_flush (gvm_compress_stream_t *);
+
+int
+gvm_compress_stream_finish (gvm_compress_stream_t *);
+
+void
+gvm_compress_stream_free (gvm_compress_stream_t *);
+
 #endif /* not _GVM_COMPRESSUTILS_H */
@@ -13,13 +13,22 @@
 
 #include "fileutils.h"
 
+#include <dirent.h>      /* for fdopendir, readdir, closedir */
 #include <errno.h>       /* for errno */
+#include <fcntl.h>       /* for open, openat, O_DIRECTORY, AT_REMOVEDIR */
 #include <gio/gio.h>     /* for g_file_new_for_path, GFile */
 #include <glib/gstdio.h> /* for g_lstat, g_remove */
 #include <glib/gtypes.h> /* for gsize */
+#include <stdio.h>       /* for rename */
 #include <string.h>      /* for strlen, memset, strcmp */
 #include <sys/stat.h>    /* for stat, S_ISDIR */
 #include <time.h>        /* for tm, strptime, localtime, time, time_t */
+#include <unistd.h>      /* for copy_file_range, unlinkat, close */
+#ifdef __linux__
+#include <linux/fs.h>     /* for FICLONE */
+#include <sys/ioctl.h>    /* for ioctl */
+#include <sys/sendfile.h> /* for sendfile */
+#endif
 
 #undef G_LOG_DOMAIN
 /**
@@ -109,11 +118,83 @@ gvm_file_is_readable (const char *name)
   return eaccess (name, R_OK) == 0;
 }
 
+/**
+ * @brief Removes the contents of a directory, recursively.
+ *
+ * Works relative to directory file descriptors, so each entry costs one
+ * unlinkat and no path lookups, and symbolic links are never followed.
+ *
+ * @param[in]  dir_fd    Descriptor of the directory, closed by the function.
+ * @param[in]  pathname  Name of the directory, for messages.
+ *
+ * @return 0 on success, -1 if an error occurred.
+ */
+static int
+remove_dir_contents (int dir_fd, const char *pathname)
+{
+  struct dirent *entry;
+  DIR *directory;
+  int ret = 0;
+
+  directory = fdopendir (dir_fd);
+  if (directory == NULL)
+    {
+      g_warning ("fdopendir(%s) failed - %s\n", pathname, g_strerror (errno));
+      close (dir_fd);
+      return -1;
+    }
+
+  while (ret == 0 && (errno = 0, entry = readdir (directory)))
+    {
+      gboolean is_dir;
+
+      if (strcmp (entry->d_name, ".") == 0 || strcmp (entry->d_name, "..") == 0)
+        continue;
+
+      is_dir = entry->d_type == DT_DIR;
+      if (entry->d_type == DT_UNKNOWN)
+        {
+          struct stat sb;
+
+          if (fstatat (dir_fd, entry->d_name, &sb, AT_SYMLINK_NOFOLLOW) == 0)
+            is_dir = S_ISDIR (sb.st_mode);
+        }
+
+      if (is_dir)
+        {
+          gchar *entry_path;
+          int fd;
+
+          entry_path = g_build_filename (pathname, entry->d_name, NULL);
+          fd = openat (dir_fd, entry->d_name,
+                       O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+          if (fd < 0 || remove_dir_contents (fd, entry_path)
+              || unlinkat (dir_fd, entry->d_name, AT_REMOVEDIR))
+            ret = -1;
+          g_free (entry_path);
+        }
+      else if (unlinkat (dir_fd, entry->d_name, 0))
+        ret = -1;
+
+      if (ret)
+        g_warning ("Failed to remove %s from %s! - %s", entry->d_name,
+                   pathname, g_strerror (errno));
+    }
+  if (ret == 0 && errno)
+    {
+      g_warning ("readdir(%s) failed - %s\n", pathname, g_strerror (errno));
+      ret = -1;
+    }
+
+  closedir (directory);
+  return ret;
+}
+
 /**
  * @brief Recursively removes files and directories.
  *
- * This function will recursively call itself to delete a path and any
- * contents of this path.
+ * This function will recursively delete a path and any contents of this
+ * path.  Symbolic links are removed, not followed.
  *
  * @param[in]  pathname  The name of the file to be deleted from the filesystem.
  *
@@ -124,44 +205,274 @@ gvm_file_remove_recurse (const gchar *pathname)
 {
   if (gvm_file_check_is_dir (pathname) == 1)
     {
-      GError *error = NULL;
-      GDir *directory = g_dir_open (pathname, 0, &error);
+      int fd;
 
-      if (directory == NULL)
+      fd = open (pathname, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+      if (fd < 0)
         {
-          g_warning ("g_dir_open(%s) failed - %s\n", pathname, error->message);
-          g_error_free (error);
+          g_warning ("open(%s) failed - %s\n", pathname, g_strerror (errno));
           return -1;
         }
-      else
+      if (remove_dir_contents (fd, pathname))
+        return -1;
+    }
+
+  return g_remove (pathname);
+}
+
+/**
+ * @brief State shared by the threads of a parallel removal.
+ */
+typedef struct
+{
+  const gchar *pathname; ///< Directory being emptied.
+  int dir_fd;            ///< Descriptor of the directory.
+  GPtrArray *names;      ///< Names of the entries of the directory.
+  gint next;             ///< Index of the next entry to remove.
+  gint failed;           ///< Whether a removal failed.
+} remove_job_t;
+
+/**
+ * @brief Removes entries of a directory until none are left.
+ *
+ * @param[in]  data  The remove_job_t.
+ *
+ * @return NULL.
+ */
+static gpointer
+remove_worker (gpointer data)
+{
+  remove_job_t *job = data;
+
+  while (!g_atomic_int_get (&job->failed))
+    {
+      const char *name;
+      struct stat sb;
+      gint index;
+      int ret;
+
+      index = g_atomic_int_add (&job->next, 1);
+      if (index >= (gint) job->names->len)
+        break;
+      name = g_ptr_array_index (job->names, index);
+
+      if (fstatat (job->dir_fd, name, &sb, AT_SYMLINK_NOFOLLOW) == 0
+          && S_ISDIR (sb.st_mode))
         {
-          int ret = 0;
-          const gchar *entry = NULL;
+          gchar *entry_path;
+          int fd;
+
+          entry_path = g_build_filename (job->pathname, name, NULL);
+          fd = openat (job->dir_fd, name,
+                       O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+          ret = fd < 0 || remove_dir_contents (fd, entry_path)
+                || unlinkat (job->dir_fd, name, AT_REMOVEDIR);
+          g_free (entry_path);
+        }
+      else
+        ret = unlinkat (job->dir_fd, name, 0);
 
-          while ((entry = g_dir_read_name (directory)) && (ret == 0))
-            {
-              gchar *entry_path = g_build_filename (pathname, entry, NULL);
-              ret = gvm_file_remove_recurse (entry_path);
-              g_free (entry_path);
-              if (ret != 0)
-                {
-                  g_warning ("Failed to remove %s from %s!", entry, pathname);
-                  g_dir_close (directory);
-                  return ret;
-                }
-            }
-          g_dir_close (directory);
+      if (ret)
+        {
+          g_warning ("Failed to remove %s from %s! - %s", name, job->pathname,
+                     g_strerror (errno));
+          g_atomic_int_set (&job->failed, 1);
         }
     }
+  return NULL;
+}
 
+/**
+ * @brief Recursively removes files and directories, in several threads.
+ *
+ * Like gvm_file_remove_recurse, with the entries of the directory spread
+ * over the threads.  Helps most for directories with many entries on
+ * storage that serves several requests at once.
+ *
+ * @param[in]  pathname  The name of the file to be deleted from the filesystem.
+ * @param[in]  threads   Number of threads, 1 or less to remove in the calling
+ *                       thread only.
+ *
+ * @return 0 if the name was successfully deleted, -1 if an error occurred.
+ */
+int
+gvm_file_remove_recurse_parallel (const gchar *pathname, guint threads)
+{
+  GThread **workers;
+  struct dirent *entry;
+  remove_job_t job;
+  DIR *directory;
+  guint i;
+
+  if (threads <= 1 || gvm_file_check_is_dir (pathname) != 1)
+    return gvm_file_remove_recurse (pathname);
+
+  job.pathname = pathname;
+  job.dir_fd = open (pathname, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+  if (job.dir_fd < 0)
+    {
+      g_warning ("open(%s) failed - %s\n", pathname, g_strerror (errno));
+      return -1;
+    }
+  directory = fdopendir (dup (job.dir_fd));
+  if (directory == NULL)
+    {
+      g_warning ("fdopendir(%s) failed - %s\n", pathname, g_strerror (errno));
+      close (job.dir_fd);
+      return -1;
+    }
+  job.names = g_ptr_array_new_with_free_func (g_free);
+  while ((errno = 0, entry = readdir (directory)))
+    if (strcmp (entry->d_name, ".") && strcmp (entry->d_name, ".."))
+      g_ptr_array_add (job.names, g_strdup (entry->d_name));
+  if (errno)
+    {
+      g_warning ("readdir(%s) failed - %s\n", pathname, g_strerror (errno));
+      closedir (directory);
+      g_ptr_array_free (job.names, TRUE);
+      close (job.dir_fd);
+      return -1;
+    }
+  closedir (directory);
+  job.next = 0;
+  job.failed = 0;
+
+  if (threads > job.names->len)
+    threads = MAX (job.names->len, 1);
+  workers = g_new0 (GThread *, threads);
+  for (i = 1; i < threads; i++)
+    workers[i] = g_thread_try_new ("remove", remove_worker, &job, NULL);
+  remove_worker (&job);
+  for (i = 1; i < threads; i++)
+    if (workers[i])
+      g_thread_join (workers[i]);
+  g_free (workers);
+
+  g_ptr_array_free (job.names, TRUE);
+  close (job.dir_fd);
+  if (job.failed)
+    return -1;
   return g_remove (pathname);
 }
 
+#if defined(__linux__) && defined(__GLIBC__) && __GLIBC_PREREQ(2, 27)
+/**
+ * @brief Copies the data of one file to another in the kernel.
+ *
+ * Tries a reflink first, which shares the data blocks on file systems that
+ * support it, then copy_file_range, then sendfile.
+ *
+ * @param[in]  sfd   Source, open for reading at offset 0.
+ * @param[in]  dfd   Destination, open for writing, empty.
+ * @param[in]  size  Size of the source.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+copy_fd_kernel (int sfd, int dfd, off_t size)
+{
+  off_t done = 0;
+
+#ifdef FICLONE
+  if (ioctl (dfd, FICLONE, sfd) == 0)
+    return 0;
+#endif
+
+  while (done < size)
+    {
+      ssize_t count;
+
+      count = copy_file_range (sfd, NULL, dfd, NULL, size - done, 0);
+      if (count <= 0)
+        break;
+      done += count;
+    }
+  while (done < size)
+    {
+      ssize_t count;
+
+      count = sendfile (dfd, sfd, NULL, size - done);
+      if (count <= 0)
+        return -1;
+      done += count;
+    }
+  return 0;
+}
+
+/**
+ * @brief Copies a regular file with the kernel copy calls.
+ *
+ * @param[in]  source_file  Source file name.
+ * @param[in]  dest_file    Destination file name.
+ *
+ * @return TRUE if successful, FALSE if the file must be copied otherwise.
+ */
+static gboolean
+file_copy_fast (const gchar *source_file, const gchar *dest_file)
+{
+  struct stat sst, dst;
+  int sfd, dfd;
+  gboolean rc;
+
+  sfd = open (source_file, O_RDONLY | O_CLOEXEC);
+  if (sfd < 0)
+    return FALSE;
+  /* Files of pseudo file systems may show a size of 0 despite data. */
+  if (fstat (sfd, &sst) || !S_ISREG (sst.st_mode) || sst.st_size == 0)
+    {
+      close (sfd);
+      return FALSE;
+    }
+
+  dfd = open (dest_file, O_WRONLY | O_CREAT | O_CLOEXEC | O_NOFOLLOW,
+              sst.st_mode & 0777);
+  if (dfd < 0)
+    {
+      close (sfd);
+      return FALSE;
+    }
+  /* Truncating a destination that is the source would lose the data. */
+  if (fstat (dfd, &dst) || !S_ISREG (dst.st_mode)
+      || (dst.st_dev == sst.st_dev && dst.st_ino == sst.st_ino))
+    {
+      close (sfd);
+      close (dfd);
+      return FALSE;
+    }
+
+  rc = ftruncate (dfd, 0) == 0 && fchmod (dfd, sst.st_mode & 0777) == 0
+       && copy_fd_kernel (sfd, dfd, sst.st_size) == 0;
+  close (sfd);
+  if (close (dfd))
+    rc = FALSE;
+  return rc;
+}
+#else
+/**
+ * @brief Copies a regular file with the kernel copy calls.
+ *
+ * @param[in]  source_file  Source file name.
+ * @param[in]  dest_file    Destination file name.
+ *
+ * @return FALSE, the kernel copy calls are not available.
+ */
+static gboolean
+file_copy_fast (const gchar *source_file, const gchar *dest_file)
+{
+  (void) source_file;
+  (void) dest_file;
+  return FALSE;
+}
+#endif
+
 /**
  * @brief Copies a source file into a destination file.
  *
  * If the destination file does exist already, it will be overwritten.
  *
+ * Regular files are copied in the kernel where possible, with a reflink on
+ * file systems that support it.  Everything else goes through GIO.
+ *
  * @param[in]  source_file  Source file name.
  * @param[in]  dest_file    Destination file name.
  *
@@ -174,6 +485,9 @@ gvm_file_copy (const gchar *source_file, const gchar *dest_file)
   GFile *sfile, *dfile;
   GError *error;
 
+  if (file_copy_fast (source_file, dest_file))
+    return TRUE;
+
   sfile = g_file_new_for_path (source_file);
   dfile = g_file_new_for_path (dest_file);
   error = NULL;
@@ -197,6 +511,9 @@ gvm_file_copy (const gchar *source_file, const gchar *dest_file)
  *
  * If the destination file does exist already, it will be overwritten.
  *
+ * A rename is tried first.  Regular files on another file system are copied
+ * in the kernel where possible.  Everything else goes through GIO.
+ *
  * @param[in]  source_file  Source file name.
  * @param[in]  dest_file    Destination file name.
  *
@@ -209,6 +526,17 @@ gvm_file_move (const gchar *source_file, const gchar *dest_file)
   GFile *sfile, *dfile;
   GError *error;
 
+  if (rename (source_file, dest_file) == 0)
+    return TRUE;
+  if (errno == EXDEV && file_copy_fast (source_file, dest_file))
+    {
+      if (unlink (source_file) == 0)
+        return TRUE;
+      g_warning ("%s: unlink(%s) failed - %s\n", __func__, source_file,
+                 g_strerror (errno));
+      return FALSE;
+    }
+
   sfile = g_file_new_for_path (source_file);
   dfile = g_file_new_for_path (dest_file);
   error = NULL;
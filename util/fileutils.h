@@ -30,6 +30,9 @@ gvm_file_check_is_dir (const char *name);
 int
 gvm_file_remove_recurse (const gchar *pathname);
 
+int
+gvm_file_remove_recurse_parallel (const gchar *, guint);
+
 gboolean
 gvm_file_copy (const gchar *, const gchar *);
 
@@ -277,42 +277,40 @@ gvm_gpg_import_from_string (gpgme_ctx_t ctx, const char *key_str,
 /**
  * @brief Find a key that can be used to encrypt for an email recipient.
  *
+ * Only the keys with the given fingerprints are considered, so that other
+ * keys in the same keyring are never picked.
+ *
  * @param[in]  ctx        The GPGME context.
  * @param[in]  uid_email  The recipient email address to look for.
+ * @param[in]  fprs       NULL terminated fingerprints of the candidate keys.
  *
- * @return  The key as a gpgme_key_t.
+ * @return  The key as a gpgme_key_t, to be released with gpgme_key_unref.
  */
 static gpgme_key_t
-find_email_encryption_key (gpgme_ctx_t ctx, const char *uid_email)
+find_email_encryption_key (gpgme_ctx_t ctx, const char *uid_email,
+                           gchar **fprs)
 {
   gchar *bracket_email;
-  gpgme_key_t key, found_key;
-  gpgme_error_t err;
+  gpgme_key_t found_key;
 
-  if (uid_email == NULL)
+  if (uid_email == NULL || fprs == NULL)
     return NULL;
 
   bracket_email = g_strdup_printf ("<%s>", uid_email);
 
-  err = gpgme_op_keylist_start (ctx, NULL, 0);
-  if (err)
+  found_key = NULL;
+  for (; *fprs && found_key == NULL; fprs++)
     {
-      g_free (bracket_email);
-      g_warning ("gpgme_op_keylist_start failed: %s", gpgme_strerror (err));
-      return NULL;
-    }
+      gpgme_key_t key;
+      gpgme_error_t err;
 
-  gpgme_op_keylist_next (ctx, &key);
-  if (err)
-    {
-      g_free (bracket_email);
-      g_warning ("gpgme_op_keylist_next failed: %s", gpgme_strerror (err));
-      return NULL;
-    }
+      err = gpgme_get_key (ctx, *fprs, &key, 0);
+      if (err)
+        {
+          g_warning ("gpgme_get_key failed: %s", gpgme_strerror (err));
+          continue;
+        }
 
-  found_key = NULL;
-  while (key)
-    {
       if (key->can_encrypt)
         {
           g_debug ("%s: key '%s' OK for encryption", __func__,
@@ -324,8 +322,9 @@ find_email_encryption_key (gpgme_ctx_t ctx, const char *uid_email)
             {
               g_debug ("%s: UID email: %s", __func__, uid->email);
 
-              if (strcmp (uid->email, uid_email) == 0
-                  || strstr (uid->email, bracket_email))
+              if (uid->email
+                  && (strcmp (uid->email, uid_email) == 0
+                      || strstr (uid->email, bracket_email)))
                 {
                   g_message ("%s: Found matching UID for %s", __func__,
                              uid_email);
@@ -340,63 +339,110 @@ find_email_encryption_key (gpgme_ctx_t ctx, const char *uid_email)
                    key->subkeys->fpr);
         }
 
-      err = gpgme_op_keylist_next (ctx, &key);
-      if (err & GPG_ERR_EOF)
-        break;
-      else if (err)
-        {
-          g_free (bracket_email);
-          g_warning ("gpgme_op_keylist_next failed: %s", gpgme_strerror (err));
-          return NULL;
-        }
+      if (found_key == NULL)
+        gpgme_key_unref (key);
     }
 
   if (found_key == NULL)
     g_warning ("%s: No suitable key found for %s", __func__, uid_email);
 
+  g_free (bracket_email);
   return found_key;
 }
 
 /**
- * @brief Wrapper for fread for use as a GPGME callback.
+ * @brief Size of the output buffer of an encryption.
+ */
+#define GPGME_SINK_BUFFER 65536
+
+/**
+ * @brief Buffered output of an encryption, for use as GPGME callbacks.
+ *
+ * GPGME hands over its output in small pieces, so they are gathered and
+ * written in large blocks.
+ */
+typedef struct
+{
+  int fd;                         ///< Descriptor to write to, or -1.
+  FILE *file;                     ///< Stream to write to, if fd is -1.
+  size_t len;                     ///< Number of bytes in buffer.
+  gboolean failed;                ///< Whether a write failed.
+  char buffer[GPGME_SINK_BUFFER]; ///< Output waiting to be written.
+} gpgme_sink_t;
+
+/**
+ * @brief Writes out the buffered output of a sink.
  *
- * @param[in]  handle   The file handle.
- * @param[out] buffer   The data buffer to read data into.
- * @param[in]  size     The size of the buffer.
+ * @param[in]  sink  Sink.
  *
- * @return The number of bytes read or -1 on error.
+ * @return 0 on success, -1 on error.
  */
-static ssize_t
-gvm_gpgme_fread (void *handle, void *buffer, size_t size)
+static int
+gpgme_sink_flush (gpgme_sink_t *sink)
 {
-  int ret;
-  FILE *file = (FILE *) handle;
+  const char *pos = sink->buffer;
 
-  ret = fread (buffer, 1, size, file);
-  if (ferror (file))
+  if (sink->failed)
     return -1;
-  return ret;
+
+  if (sink->fd < 0)
+    {
+      if (sink->len && fwrite (pos, 1, sink->len, sink->file) != sink->len)
+        sink->failed = TRUE;
+      sink->len = 0;
+      return sink->failed ? -1 : 0;
+    }
+
+  while (sink->len)
+    {
+      ssize_t count;
+
+      count = write (sink->fd, pos, sink->len);
+      if (count < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          g_warning ("%s: write failed: %s", __func__, strerror (errno));
+          sink->failed = TRUE;
+          return -1;
+        }
+      pos += count;
+      sink->len -= count;
+    }
+  return 0;
 }
 
 /**
- * @brief Wrapper for fread for use as a GPGME callback.
+ * @brief GPGME write callback of a sink.
  *
- * @param[in]  handle   The file handle.
- * @param[in]  buffer   The data buffer to read data into.
- * @param[in]  size     The amount of buffered data.
+ * @param[in]  handle   The sink.
+ * @param[in]  buffer   The data to write.
+ * @param[in]  size     The amount of data.
  *
- * @return The number of bytes written or -1 on error.
+ * @return The number of bytes taken or -1 on error.
  */
 static ssize_t
-gvm_gpgme_fwrite (void *handle, const void *buffer, size_t size)
+gpgme_sink_write (void *handle, const void *buffer, size_t size)
 {
-  int ret;
-  FILE *file = (FILE *) handle;
+  gpgme_sink_t *sink = handle;
 
-  ret = fwrite (buffer, 1, size, file);
-  if (ferror (file))
+  if (sink->failed)
     return -1;
-  return ret;
+  if (size > GPGME_SINK_BUFFER - sink->len && gpgme_sink_flush (sink))
+    return -1;
+  if (size >= GPGME_SINK_BUFFER)
+    {
+      /* Too large to be worth buffering. */
+      if (sink->fd < 0)
+        return fwrite (buffer, 1, size, sink->file) == size ? (ssize_t) size
+                                                            : -1;
+      memcpy (sink->buffer, buffer, GPGME_SINK_BUFFER);
+      sink->len = GPGME_SINK_BUFFER;
+      return gpgme_sink_flush (sink) ? -1 : GPGME_SINK_BUFFER;
+    }
+  memcpy (sink->buffer + sink->len, buffer, size);
+  sink->len += size;
+  return size;
 }
 
 #define CHECK_ERR(func)                                                     \
@@ -467,160 +513,493 @@ create_all_certificates_trustlist (gpgme_ctx_t ctx, const char *homedir)
 }
 
 #undef CHECK_ERR
-#define CHECK_ERR(func)                                                     \
-  if (err)                                                                  \
-    {                                                                       \
-      printf ("%s: %s failed: %s\n", __func__, func, gpgme_strerror (err)); \
-      if (plain_data)                                                       \
-        gpgme_data_release (plain_data);                                    \
-      if (encrypted_data)                                                   \
-        gpgme_data_release (encrypted_data);                                \
-      if (ctx)                                                              \
-        gpgme_release (ctx);                                                \
-      gvm_file_remove_recurse (gpg_temp_dir);                               \
-      return -1;                                                            \
-    }
 
 /**
- * @brief Encrypt a stream for a PGP public key, writing to another stream.
+ * @brief Maximum number of imports kept by an encryption context.
  *
- * The output will use ASCII armor mode and no compression.
+ * The keyring starts over once this is reached, so it cannot grow forever.
+ */
+#define ENCRYPT_CTX_MAX_IMPORTS 256
+
+/**
+ * @brief Long-lived encryption context.
+ */
+struct gvm_encrypt_ctx
+{
+  gpgme_protocol_t protocol; ///< OpenPGP or CMS.
+  gchar *homedir;            ///< Temporary GPG home directory.
+  gpgme_ctx_t ctx;           ///< GPGME context using homedir.
+  GHashTable *imports;       ///< Fingerprints of imports, by data checksum.
+  GHashTable *keys;          ///< Keys, by data checksum and email.
+  gboolean trust_stale;      ///< Whether the CMS trust list lacks imports.
+};
+
+/**
+ * @brief Releases the keyring of an encryption context.
  *
- * @param[in]  plain_file     Stream / FILE* providing the plain text.
- * @param[in]  encrypted_file Stream to write the encrypted text to.
- * @param[in]  key_str        String containing the public key or certificate.
- * @param[in]  key_len        Length of key / certificate, -1 to use strlen.
- * @param[in]  uid_email      Email address of key / certificate to use.
- * @param[in]  protocol       The protocol to use, e.g. OpenPGP or CMS.
- * @param[in]  key_types      The expected GPGME buffered data types.
+ * @param[in]  ectx  Encryption context.
+ */
+static void
+encrypt_ctx_close (gvm_encrypt_ctx_t *ectx)
+{
+  g_hash_table_remove_all (ectx->keys);
+  g_hash_table_remove_all (ectx->imports);
+  if (ectx->ctx)
+    gpgme_release (ectx->ctx);
+  ectx->ctx = NULL;
+  if (ectx->homedir)
+    gvm_file_remove_recurse (ectx->homedir);
+  g_free (ectx->homedir);
+  ectx->homedir = NULL;
+}
+
+/**
+ * @brief Sets up the keyring and GPGME context of an encryption context.
+ *
+ * @param[in]  ectx  Encryption context, closed.
  *
  * @return 0 success, -1 error.
  */
 static int
-encrypt_stream_internal (FILE *plain_file, FILE *encrypted_file,
-                         const char *key_str, ssize_t key_len,
-                         const char *uid_email, gpgme_protocol_t protocol,
-                         GArray *key_types)
+encrypt_ctx_open (gvm_encrypt_ctx_t *ectx)
 {
   char gpg_temp_dir[] = "/tmp/gvmd-gpg-XXXXXX";
-  gpgme_ctx_t ctx;
-  gpgme_data_t plain_data, encrypted_data;
-  gpgme_key_t key;
-  gpgme_key_t keys[2] = {NULL, NULL};
   gpgme_error_t err;
-  gpgme_encrypt_flags_t encrypt_flags;
-  const char *key_type_str;
-  struct gpgme_data_cbs callbacks;
 
-  ctx = NULL;
-  plain_data = NULL;
-  encrypted_data = NULL;
+  // Create temporary GPG home directory, set up context
+  if (mkdtemp (gpg_temp_dir) == NULL)
+    {
+      g_warning ("%s: mkdtemp failed\n", __func__);
+      return -1;
+    }
+  ectx->homedir = g_strdup (gpg_temp_dir);
 
-  if (uid_email == NULL || strcmp (uid_email, "") == 0)
+  err = gpgme_new (&ectx->ctx);
+  if (err == 0)
     {
-      g_warning ("%s: No email address for user identification given",
+      gpgme_set_armor (ectx->ctx, ectx->protocol != GPGME_PROTOCOL_CMS);
+      err = gpgme_ctx_set_engine_info (ectx->ctx, ectx->protocol, NULL,
+                                       ectx->homedir);
+    }
+  if (err == 0)
+    err = gpgme_set_protocol (ectx->ctx, ectx->protocol);
+  if (err == 0)
+    err = gpgme_set_keylist_mode (ectx->ctx, GPGME_KEYLIST_MODE_LOCAL);
+  if (err)
+    {
+      log_gpgme (G_LOG_LEVEL_WARNING, err, "%s: Setting up context failed",
                  __func__);
+      encrypt_ctx_close (ectx);
       return -1;
     }
 
+  gpgme_set_offline (ectx->ctx, 1);
+  if (ectx->protocol == GPGME_PROTOCOL_CMS)
+    gpgme_set_pinentry_mode (ectx->ctx, GPGME_PINENTRY_MODE_CANCEL);
+  ectx->trust_stale = FALSE;
+  return 0;
+}
+
+/**
+ * @brief Creates a long-lived encryption context.
+ *
+ * The context keeps one GPG home directory and GPGME context for all its
+ * encryptions.  Keys are imported once and then looked up by the checksum of
+ * their data, so repeated encryptions for the same recipients skip the
+ * keyring setup.
+ *
+ * A context must not be used by several threads at once.
+ *
+ * @param[in]  protocol  GPGME_PROTOCOL_OpenPGP or GPGME_PROTOCOL_CMS.
+ *
+ * @return New context, NULL on error.  Free with gvm_encrypt_ctx_free.
+ */
+gvm_encrypt_ctx_t *
+gvm_encrypt_ctx_new (gpgme_protocol_t protocol)
+{
+  gvm_encrypt_ctx_t *ectx;
+
+  if (protocol != GPGME_PROTOCOL_OpenPGP && protocol != GPGME_PROTOCOL_CMS)
+    return NULL;
+
   if (gpgme_check_version (NULL) == NULL)
     {
       g_warning ("%s: gpgme_check_version failed", __func__);
-      return -1;
+      return NULL;
     }
 
-  if (protocol == GPGME_PROTOCOL_CMS)
-    key_type_str = "certificate";
-  else
-    key_type_str = "public key";
-
-  // Create temporary GPG home directory, set up context and encryption flags
-  if (mkdtemp (gpg_temp_dir) == NULL)
+  ectx = g_malloc0 (sizeof (*ectx));
+  ectx->protocol = protocol;
+  ectx->imports =
+    g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                           (GDestroyNotify) g_strfreev);
+  ectx->keys = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                      (GDestroyNotify) gpgme_key_unref);
+  if (encrypt_ctx_open (ectx))
     {
-      g_warning ("%s: mkdtemp failed\n", __func__);
-      return -1;
+      gvm_encrypt_ctx_free (ectx);
+      return NULL;
     }
+  return ectx;
+}
 
-  err = gpgme_new (&ctx);
-  CHECK_ERR ("gpgme_new")
+/**
+ * @brief Frees an encryption context, removing its keyring.
+ *
+ * @param[in]  ectx  Encryption context.
+ */
+void
+gvm_encrypt_ctx_free (gvm_encrypt_ctx_t *ectx)
+{
+  if (ectx == NULL)
+    return;
+
+  encrypt_ctx_close (ectx);
+  g_hash_table_destroy (ectx->keys);
+  g_hash_table_destroy (ectx->imports);
+  g_free (ectx);
+}
+
+/**
+ * @brief Imports a key into an encryption context, unless already there.
+ *
+ * @param[in]  ectx      Encryption context.
+ * @param[in]  checksum  Checksum of the key data.
+ * @param[in]  key_str   String containing the public key or certificate.
+ * @param[in]  key_len   Length of key / certificate, -1 to use strlen.
+ *
+ * @return Fingerprints of the imported keys, NULL on error.
+ */
+static gchar **
+encrypt_ctx_import (gvm_encrypt_ctx_t *ectx, const gchar *checksum,
+                    const char *key_str, ssize_t key_len)
+{
+  const gpgme_data_type_t pgp_types[] = {GPGME_DATA_TYPE_PGP_KEY};
+  const gpgme_data_type_t cms_types[] = {GPGME_DATA_TYPE_X509_CERT,
+                                         GPGME_DATA_TYPE_CMS_OTHER};
+  gpgme_import_result_t import_result;
+  gpgme_import_status_t status;
+  GPtrArray *fprs;
+  GArray *key_types;
+  gchar **result;
+  int ret;
 
-  if (protocol == GPGME_PROTOCOL_CMS)
-    gpgme_set_armor (ctx, 0);
+  result = g_hash_table_lookup (ectx->imports, checksum);
+  if (result)
+    return result;
+
+  key_types = g_array_new (FALSE, FALSE, sizeof (gpgme_data_type_t));
+  if (ectx->protocol == GPGME_PROTOCOL_CMS)
+    g_array_append_vals (key_types, cms_types, G_N_ELEMENTS (cms_types));
   else
-    gpgme_set_armor (ctx, 1);
+    g_array_append_vals (key_types, pgp_types, G_N_ELEMENTS (pgp_types));
+  ret = gvm_gpg_import_many_types_from_string (ectx->ctx, key_str, key_len,
+                                               key_types);
+  g_array_free (key_types, TRUE);
+  if (ret)
+    return NULL;
 
-  err = gpgme_ctx_set_engine_info (ctx, protocol, NULL, gpg_temp_dir);
-  CHECK_ERR ("gpgme_ctx_set_engine_info")
+  /* Keys that were in the keyring already are listed too. */
+  fprs = g_ptr_array_new ();
+  import_result = gpgme_op_import_result (ectx->ctx);
+  for (status = import_result ? import_result->imports : NULL; status;
+       status = status->next)
+    if (status->result == GPG_ERR_NO_ERROR && status->fpr)
+      g_ptr_array_add (fprs, g_strdup (status->fpr));
+  g_ptr_array_add (fprs, NULL);
+  result = (gchar **) g_ptr_array_free (fprs, FALSE);
+
+  g_hash_table_insert (ectx->imports, g_strdup (checksum), result);
+  ectx->trust_stale = TRUE;
+  return result;
+}
 
-  err = gpgme_set_protocol (ctx, protocol);
-  CHECK_ERR ("gpgme_set_protocol")
+/**
+ * @brief Gets the key for an email recipient from an encryption context.
+ *
+ * @param[in]  ectx       Encryption context.
+ * @param[in]  key_str    String containing the public key or certificate.
+ * @param[in]  key_len    Length of key / certificate, -1 to use strlen.
+ * @param[in]  uid_email  Email address of key / certificate to use.
+ *
+ * @return The key, owned by the context, NULL on error.
+ */
+static gpgme_key_t
+encrypt_ctx_get_key (gvm_encrypt_ctx_t *ectx, const char *key_str,
+                     ssize_t key_len, const char *uid_email)
+{
+  const char *key_type_str;
+  gchar *checksum, *cache_key;
+  gpgme_key_t key;
+  gchar **fprs;
 
-  err = gpgme_set_keylist_mode (ctx, GPGME_KEYLIST_MODE_LOCAL);
-  CHECK_ERR ("gpgme_set_keylist_mode")
+  if (key_str == NULL)
+    return NULL;
+  if (key_len < 0)
+    key_len = strlen (key_str);
+
+  checksum = g_compute_checksum_for_data (G_CHECKSUM_SHA256,
+                                          (const guchar *) key_str, key_len);
+  cache_key = g_strdup_printf ("%s %s", checksum, uid_email);
+  key = g_hash_table_lookup (ectx->keys, cache_key);
+  if (key)
+    {
+      g_free (cache_key);
+      g_free (checksum);
+      return key;
+    }
 
-  gpgme_set_offline (ctx, 1);
+  if (ectx->protocol == GPGME_PROTOCOL_CMS)
+    key_type_str = "certificate";
+  else
+    key_type_str = "public key";
 
-  encrypt_flags = GPGME_ENCRYPT_ALWAYS_TRUST | GPGME_ENCRYPT_NO_COMPRESS;
+  if (g_hash_table_lookup (ectx->imports, checksum) == NULL
+      && g_hash_table_size (ectx->imports) >= ENCRYPT_CTX_MAX_IMPORTS)
+    {
+      // Start over with an empty keyring
+      encrypt_ctx_close (ectx);
+      if (encrypt_ctx_open (ectx))
+        {
+          g_free (cache_key);
+          g_free (checksum);
+          return NULL;
+        }
+    }
 
   // Import public key into context
-  if (gvm_gpg_import_many_types_from_string (ctx, key_str, key_len, key_types))
+  fprs = encrypt_ctx_import (ectx, checksum, key_str, key_len);
+  g_free (checksum);
+  if (fprs == NULL)
     {
       g_warning ("%s: Import of %s failed", __func__, key_type_str);
-      gpgme_release (ctx);
-      gvm_file_remove_recurse (gpg_temp_dir);
-      return -1;
+      g_free (cache_key);
+      return NULL;
     }
 
   // Get imported public key
-  key = find_email_encryption_key (ctx, uid_email);
+  key = find_email_encryption_key (ectx->ctx, uid_email, fprs);
   if (key == NULL)
     {
       g_warning ("%s: Could not find %s for encryption", __func__,
                  key_type_str);
-      gpgme_release (ctx);
-      gvm_file_remove_recurse (gpg_temp_dir);
+      g_free (cache_key);
+      return NULL;
+    }
+
+  g_hash_table_insert (ectx->keys, cache_key, key);
+  return key;
+}
+
+/**
+ * @brief Encrypts data with an encryption context.
+ *
+ * @param[in]  ectx        Encryption context.
+ * @param[in]  plain_data  GPGME data providing the plain text.
+ * @param[in]  sink        Sink for the encrypted text.
+ * @param[in]  uid_email   Email address of key / certificate to use.
+ * @param[in]  key_str     String containing the public key or certificate.
+ * @param[in]  key_len     Length of key / certificate, -1 to use strlen.
+ *
+ * @return 0 success, -1 error.
+ */
+static int
+encrypt_ctx_encrypt (gvm_encrypt_ctx_t *ectx, gpgme_data_t plain_data,
+                     gpgme_sink_t *sink, const char *uid_email,
+                     const char *key_str, ssize_t key_len)
+{
+  gpgme_key_t keys[2] = {NULL, NULL};
+  gpgme_data_t encrypted_data;
+  gpgme_encrypt_flags_t encrypt_flags;
+  struct gpgme_data_cbs callbacks;
+  gpgme_error_t err;
+
+  if (uid_email == NULL || strcmp (uid_email, "") == 0)
+    {
+      g_warning ("%s: No email address for user identification given",
+                 __func__);
       return -1;
     }
-  keys[0] = key;
 
-  // Set up data objects for input and output streams
-  err = gpgme_data_new_from_stream (&plain_data, plain_file);
-  CHECK_ERR ("gpgme_data_new_from_stream for plain text")
+  keys[0] = encrypt_ctx_get_key (ectx, key_str, key_len, uid_email);
+  if (keys[0] == NULL)
+    return -1;
+
+  if (ectx->protocol == GPGME_PROTOCOL_CMS && ectx->trust_stale)
+    {
+      if (create_all_certificates_trustlist (ectx->ctx, ectx->homedir))
+        return -1;
+      ectx->trust_stale = FALSE;
+    }
 
-  /* Create a GPGME data buffer with custom read and write functions.
+  /* Create a GPGME data buffer with custom write functions.
    *
    * This is necessary as gpgme_data_new_from_stream may cause problems
    * when trying to write to the stream after some operations. */
   memset (&callbacks, 0, sizeof (callbacks));
-  callbacks.read = gvm_gpgme_fread;
-  callbacks.write = gvm_gpgme_fwrite;
-  err = gpgme_data_new_from_cbs (&encrypted_data, &callbacks, encrypted_file);
-  CHECK_ERR ("gpgme_data_new_from_stream for encrypted text")
+  callbacks.write = gpgme_sink_write;
+  err = gpgme_data_new_from_cbs (&encrypted_data, &callbacks, sink);
+  if (err)
+    {
+      log_gpgme (G_LOG_LEVEL_WARNING, err,
+                 "%s: gpgme_data_new_from_cbs for encrypted text failed",
+                 __func__);
+      return -1;
+    }
+  if (ectx->protocol == GPGME_PROTOCOL_CMS)
+    gpgme_data_set_encoding (encrypted_data, GPGME_DATA_ENCODING_BASE64);
 
-  if (protocol == GPGME_PROTOCOL_CMS)
+  // Encrypt data
+  encrypt_flags = GPGME_ENCRYPT_ALWAYS_TRUST | GPGME_ENCRYPT_NO_COMPRESS;
+  err = gpgme_op_encrypt (ectx->ctx, keys, encrypt_flags, plain_data,
+                          encrypted_data);
+  gpgme_data_release (encrypted_data);
+  if (err)
     {
-      gpgme_data_set_encoding (encrypted_data, GPGME_DATA_ENCODING_BASE64);
+      log_gpgme (G_LOG_LEVEL_WARNING, err, "%s: gpgme_op_encrypt failed",
+                 __func__);
+      return -1;
+    }
 
-      if (create_all_certificates_trustlist (ctx, gpg_temp_dir))
-        {
-          gpgme_data_release (plain_data);
-          gpgme_data_release (encrypted_data);
-          gpgme_release (ctx);
-          gvm_file_remove_recurse (gpg_temp_dir);
-          return -1;
-        }
+  return gpgme_sink_flush (sink);
+}
+
+/**
+ * @brief Encrypts a stream with an encryption context.
+ *
+ * The output will use ASCII armor mode for OpenPGP and no compression.
+ *
+ * @param[in]  ectx            Encryption context.
+ * @param[in]  plain_file      Stream / FILE* providing the plain text.
+ * @param[in]  encrypted_file  Stream to write the encrypted text to.
+ * @param[in]  uid_email       Email address of key / certificate to use.
+ * @param[in]  key_str         String containing the public key or
+ *                             certificate.
+ * @param[in]  key_len         Length of key / certificate, -1 to use strlen.
+ *
+ * @return 0 success, -1 error.
+ */
+int
+gvm_encrypt_ctx_encrypt_stream (gvm_encrypt_ctx_t *ectx, FILE *plain_file,
+                                FILE *encrypted_file, const char *uid_email,
+                                const char *key_str, ssize_t key_len)
+{
+  gpgme_data_t plain_data;
+  gpgme_sink_t *sink;
+  gpgme_error_t err;
+  int ret;
+
+  if (ectx == NULL || plain_file == NULL || encrypted_file == NULL)
+    return -1;
+
+  err = gpgme_data_new_from_stream (&plain_data, plain_file);
+  if (err)
+    {
+      log_gpgme (G_LOG_LEVEL_WARNING, err,
+                 "%s: gpgme_data_new_from_stream for plain text failed",
+                 __func__);
+      return -1;
     }
 
-  // Encrypt data
-  err = gpgme_op_encrypt (ctx, keys, encrypt_flags, plain_data, encrypted_data);
-  CHECK_ERR ("gpgme_op_encrypt")
+  sink = g_malloc (sizeof (*sink));
+  sink->fd = -1;
+  sink->file = encrypted_file;
+  sink->len = 0;
+  sink->failed = FALSE;
+  ret = encrypt_ctx_encrypt (ectx, plain_data, sink, uid_email, key_str,
+                             key_len);
+  g_free (sink);
+  gpgme_data_release (plain_data);
+  return ret;
+}
+
+/**
+ * @brief Encrypts from a file descriptor to another with an encryption
+ *        context.
+ *
+ * The output will use ASCII armor mode for OpenPGP and no compression.  The
+ * plain text is read by GPGME directly from the descriptor and the output
+ * is written in large blocks.
+ *
+ * @param[in]  ectx          Encryption context.
+ * @param[in]  plain_fd      Descriptor providing the plain text.
+ * @param[in]  encrypted_fd  Descriptor to write the encrypted text to.
+ * @param[in]  uid_email     Email address of key / certificate to use.
+ * @param[in]  key_str       String containing the public key or certificate.
+ * @param[in]  key_len       Length of key / certificate, -1 to use strlen.
+ *
+ * @return 0 success, -1 error.
+ */
+int
+gvm_encrypt_ctx_encrypt_fd (gvm_encrypt_ctx_t *ectx, int plain_fd,
+                            int encrypted_fd, const char *uid_email,
+                            const char *key_str, ssize_t key_len)
+{
+  gpgme_data_t plain_data;
+  gpgme_sink_t *sink;
+  gpgme_error_t err;
+  int ret;
+
+  if (ectx == NULL || plain_fd < 0 || encrypted_fd < 0)
+    return -1;
+
+  err = gpgme_data_new_from_fd (&plain_data, plain_fd);
+  if (err)
+    {
+      log_gpgme (G_LOG_LEVEL_WARNING, err,
+                 "%s: gpgme_data_new_from_fd for plain text failed",
+                 __func__);
+      return -1;
+    }
 
+  sink = g_malloc (sizeof (*sink));
+  sink->fd = encrypted_fd;
+  sink->file = NULL;
+  sink->len = 0;
+  sink->failed = FALSE;
+  ret = encrypt_ctx_encrypt (ectx, plain_data, sink, uid_email, key_str,
+                             key_len);
+  g_free (sink);
   gpgme_data_release (plain_data);
-  gpgme_data_release (encrypted_data);
-  gpgme_release (ctx);
-  gvm_file_remove_recurse (gpg_temp_dir);
+  return ret;
+}
 
-  return 0;
+/**
+ * @brief Encrypt a stream for a key, writing to another stream.
+ *
+ * Uses a new encryption context for the one encryption.
+ *
+ * @param[in]  plain_file     Stream / FILE* providing the plain text.
+ * @param[in]  encrypted_file Stream to write the encrypted text to.
+ * @param[in]  key_str        String containing the public key or certificate.
+ * @param[in]  key_len        Length of key / certificate, -1 to use strlen.
+ * @param[in]  uid_email      Email address of key / certificate to use.
+ * @param[in]  protocol       The protocol to use, e.g. OpenPGP or CMS.
+ *
+ * @return 0 success, -1 error.
+ */
+static int
+encrypt_stream_internal (FILE *plain_file, FILE *encrypted_file,
+                         const char *key_str, ssize_t key_len,
+                         const char *uid_email, gpgme_protocol_t protocol)
+{
+  gvm_encrypt_ctx_t *ectx;
+  int ret;
+
+  if (uid_email == NULL || strcmp (uid_email, "") == 0)
+    {
+      g_warning ("%s: No email address for user identification given",
+                 __func__);
+      return -1;
+    }
+
+  ectx = gvm_encrypt_ctx_new (protocol);
+  if (ectx == NULL)
+    return -1;
+  ret = gvm_encrypt_ctx_encrypt_stream (ectx, plain_file, encrypted_file,
+                                        uid_email, key_str, key_len);
+  gvm_encrypt_ctx_free (ectx);
+  return ret;
 }
 
 /**
@@ -642,17 +1021,9 @@ gvm_pgp_pubkey_encrypt_stream (FILE *plain_file, FILE *encrypted_file,
                                const char *public_key_str,
                                ssize_t public_key_len)
 {
-  int ret;
-  const gpgme_data_type_t types_ptr[1] = {GPGME_DATA_TYPE_PGP_KEY};
-  GArray *key_types = g_array_new (FALSE, FALSE, sizeof (gpgme_data_type_t));
-
-  g_array_append_vals (key_types, types_ptr, 1);
-  ret = encrypt_stream_internal (plain_file, encrypted_file, public_key_str,
-                                 public_key_len, uid_email,
-                                 GPGME_PROTOCOL_OpenPGP, key_types);
-  g_array_free (key_types, TRUE);
-
-  return ret;
+  return encrypt_stream_internal (plain_file, encrypted_file, public_key_str,
+                                  public_key_len, uid_email,
+                                  GPGME_PROTOCOL_OpenPGP);
 }
 
 /**
@@ -673,16 +1044,7 @@ gvm_smime_encrypt_stream (FILE *plain_file, FILE *encrypted_file,
                           const char *uid_email, const char *certificate_str,
                           ssize_t certificate_len)
 {
-  int ret;
-  const gpgme_data_type_t types_ptr[2] = {GPGME_DATA_TYPE_X509_CERT,
-                                          GPGME_DATA_TYPE_CMS_OTHER};
-  GArray *key_types = g_array_new (FALSE, FALSE, sizeof (gpgme_data_type_t));
-
-  g_array_append_vals (key_types, types_ptr, 2);
-  ret = encrypt_stream_internal (plain_file, encrypted_file, certificate_str,
-                                 certificate_len, uid_email, GPGME_PROTOCOL_CMS,
-                                 key_types);
-  g_array_free (key_types, TRUE);
-
-  return ret;
+  return encrypt_stream_internal (plain_file, encrypted_file, certificate_str,
+                                  certificate_len, uid_email,
+                                  GPGME_PROTOCOL_CMS);
 }
@@ -37,4 +37,23 @@ gvm_pgp_pubkey_encrypt_stream (FILE *, FILE *, const char *, const char *,
 int
 gvm_smime_encrypt_stream (FILE *, FILE *, const char *, const char *, ssize_t);
 
+/**
+ * @brief Long-lived encryption context, caching imported keys.
+ */
+typedef struct gvm_encrypt_ctx gvm_encrypt_ctx_t;
+
+gvm_encrypt_ctx_t *
+gvm_encrypt_ctx_new (gpgme_protocol_t);
+
+void
+gvm_encrypt_ctx_free (gvm_encrypt_ctx_t *);
+
+int
+gvm_encrypt_ctx_encrypt_stream (gvm_encrypt_ctx_t *, FILE *, FILE *,
+                                const char *, const char *, ssize_t);
+
+int
+gvm_encrypt_ctx_encrypt_fd (gvm_encrypt_ctx_t *, int, int, const char *,
+                            const char *, ssize_t);
+
 #endif /*_GVM_GPGMEUTILS_H*/
@@ -12,13 +12,20 @@
 
 #include "kb.h"
 
+#include "../base/memstats.h" /* for gvm_memstats_alloc, gvm_memstats_free */
+#include "../base/probes.h"   /* for GVM_PROBE2, GVM_PROBE3 */
+
 #include <errno.h> /* for ENOMEM, EINVAL, EPROTO, EALREADY, ECONN... */
 #include <glib.h>  /* for g_log, g_free */
+#include <hiredis/async.h> /* for redisAsyncContext, redisAsyncCommand */
 #include <hiredis/hiredis.h> /* for redisReply, freeReplyObject, redisCommand */
+#include <poll.h>            /* for poll */
 #include <stdbool.h>         /* for bool, true, false */
 #include <stdio.h>
 #include <stdlib.h> /* for atoi */
 #include <string.h> /* for strlen, strerror, strncpy, memset */
+#include <time.h>   /* for clock_gettime */
+#include <unistd.h> /* for getpid */
 
 #undef G_LOG_DOMAIN
 /**
@@ -44,6 +51,114 @@
  */
 #define GLOBAL_DBINDEX_NAME "GVM.__GlobalDBIndex"
 
+/**
+ * @brief Name of the directory of marker keys in redis. It maps keys looked
+ *        up by redis_find to the index of the DB holding them.
+ */
+#define KB_DIRECTORY_NAME "GVM.__KeyDirectory"
+
+/**
+ * @brief Prefix of the SETs of the directory entries of each DB.
+ */
+#define KB_DIRECTORY_KEYS_PREFIX "GVM.__DirectoryKeys:"
+
+/**
+ * @brief Lua script adding a key to the directory.
+ *
+ * KEYS[1] is the directory, KEYS[2] the SET of entries of the DB. ARGV[1] is
+ * the key, ARGV[2] the DB index.
+ */
+#define KB_SCRIPT_DIRECTORY_ADD                                              \
+  "redis.call('HSET', KEYS[1], ARGV[1], ARGV[2])\n"                          \
+  "redis.call('SADD', KEYS[2], ARGV[1])\n"
+
+/**
+ * @brief Lua script removing the entries of a DB from the directory.
+ *
+ * KEYS[1] is the directory, KEYS[2] the SET of entries of the DB. ARGV[1] is
+ * the DB index. Entries which were registered again for another DB are kept.
+ */
+#define KB_SCRIPT_DIRECTORY_CLEAR                                            \
+  "for _, key in ipairs(redis.call('SMEMBERS', KEYS[2])) do\n"               \
+  "  if redis.call('HGET', KEYS[1], key) == ARGV[1] then\n"                  \
+  "    redis.call('HDEL', KEYS[1], key)\n"                                   \
+  "  end\n"                                                                  \
+  "end\n"                                                                    \
+  "redis.call('DEL', KEYS[2])\n"
+
+/**
+ * @brief Separator of the Redis servers in a sharded KB path.
+ */
+#define KB_SHARD_SEPARATOR ","
+
+/**
+ * @brief Stride of the KB indexes of consecutive shards.
+ *
+ * The KB index of a DB on the n-th server of a sharded KB path is
+ * n * KB_SHARD_STRIDE + DB number, so that kb_direct_conn can route it.
+ */
+#define KB_SHARD_STRIDE 65536
+
+/**
+ * @brief Number of names requested per SCAN iteration.
+ */
+#define KB_SCAN_COUNT 1000
+
+/**
+ * @brief Maximum number of idle connections kept per path in the pool.
+ */
+#define KB_POOL_MAX_IDLE 8
+
+/**
+ * @brief Prefix of the SET indexes used for unique list insertions.
+ */
+#define KB_UNIQUE_INDEX_PREFIX "GVM.__Unique:"
+
+/**
+ * @brief Lua script inserting a unique value into a list.
+ *
+ * KEYS[1] is the list, KEYS[2] its SET index. ARGV[1] is the value,
+ * ARGV[2] "1" to push left, ARGV[3] the expiration (0 for none) and ARGV[4]
+ * "1" to use the SET index. Without index, the value is removed with LREM
+ * before being pushed, which is O(list length). With index, LREM only runs
+ * when the value is already present. The index is rebuilt whenever its size
+ * doesn't match the list, e.g. after a write which didn't maintain it.
+ * Returns the number of removed values.
+ */
+#define KB_SCRIPT_ADD_UNIQUE                                                 \
+  "local removed = 0\n"                                                      \
+  "if ARGV[4] == '1' then\n"                                                 \
+  "  local llen = redis.call('LLEN', KEYS[1])\n"                             \
+  "  if redis.call('SCARD', KEYS[2]) ~= llen then\n"                         \
+  "    redis.call('DEL', KEYS[2])\n"                                         \
+  "    for _, v in ipairs(redis.call('LRANGE', KEYS[1], 0, -1)) do\n"        \
+  "      redis.call('SADD', KEYS[2], v)\n"                                   \
+  "    end\n"                                                                \
+  "  end\n"                                                                  \
+  "  if redis.call('SADD', KEYS[2], ARGV[1]) == 0 then\n"                    \
+  "    removed = redis.call('LREM', KEYS[1], 1, ARGV[1])\n"                  \
+  "  end\n"                                                                  \
+  "else\n"                                                                   \
+  "  removed = redis.call('LREM', KEYS[1], 1, ARGV[1])\n"                    \
+  "end\n"                                                                    \
+  "if ARGV[2] == '1' then\n"                                                 \
+  "  redis.call('LPUSH', KEYS[1], ARGV[1])\n"                                \
+  "else\n"                                                                   \
+  "  redis.call('RPUSH', KEYS[1], ARGV[1])\n"                                \
+  "end\n"                                                                    \
+  "if tonumber(ARGV[3]) > 0 then\n"                                          \
+  "  redis.call('EXPIRE', KEYS[1], ARGV[3])\n"                               \
+  "  if ARGV[4] == '1' then\n"                                               \
+  "    redis.call('EXPIRE', KEYS[2], ARGV[3])\n"                             \
+  "  end\n"                                                                  \
+  "end\n"                                                                    \
+  "return removed\n"
+
+/**
+ * @brief SHA1 of KB_SCRIPT_ADD_UNIQUE, the name of the script for EVALSHA.
+ */
+static const char *add_unique_sha = NULL;
+
 static const struct kb_operations KBRedisOperations;
 
 /**
@@ -58,16 +173,41 @@ struct kb_redis
   unsigned int db;     /**< Namespace ID number, 0 if uninitialized. */
   redisContext *rctx;  /**< Redis client context. */
   char *path;          /**< Path to the server socket. */
+  char *kb_path;       /**< Path listing all servers of a sharded KB, NULL
+                            if not sharded. */
+  unsigned int shard;  /**< Position of the server in a sharded KB path. */
+  pid_t pid;           /**< Process which established the connection. */
+  int pooled;          /**< Whether the connection is taken from the pool. */
+  int unique_index;    /**< Whether unique insertions use a SET index. */
+  int nvt_compact;     /**< Whether nvts are stored in the compact encoding. */
+  int nvt_read_compact; /**< Encoding nvts were last read in. 1 for compact,
+                             -1 for list, 0 if unknown. */
+  int lazy_free;       /**< Whether the server frees memory in the background
+                            (FLUSHDB ASYNC, UNLINK). 1 if yes, -1 if no,
+                            0 if unknown yet. */
+  redisContext *tctx;  /**< Connection receiving the invalidations of the
+                            keys read through rctx, NULL if not tracking. */
+  kb_invalidate_cb track_cb; /**< Callback of the invalidations. */
+  void *track_data;          /**< User data of track_cb. */
 };
 #define redis_kb(__kb) ((struct kb_redis *) (__kb))
 
 static int
 redis_delete_all (struct kb_redis *);
 static int redis_lnk_reset (kb_t);
+static void
+redis_track_stop (struct kb_redis *, int);
 static int
 redis_flush_all (kb_t, const char *);
 static redisReply *
 redis_cmd (struct kb_redis *kbr, const char *fmt, ...);
+static void
+kb_stats_log (void);
+
+/**
+ * @brief Whether redis_delete logs the statistics of the redis commands.
+ */
+static int kb_stats_log_delete;
 
 /**
  * @brief Attempt to atomically acquire ownership of a database.
@@ -97,6 +237,49 @@ try_database_index (struct kb_redis *kbr, int index)
   return rc;
 }
 
+/**
+ * @brief Remove the entries of a DB from the directory of marker keys.
+ *
+ * @param[in] ctx    Redis context, with the management DB selected.
+ * @param[in] index  DB index.
+ */
+static void
+redis_directory_clear (redisContext *ctx, unsigned int index)
+{
+  redisReply *rep;
+
+  rep = redisCommand (ctx, "EVAL %s 2 %s " KB_DIRECTORY_KEYS_PREFIX "%u %u",
+                      KB_SCRIPT_DIRECTORY_CLEAR, KB_DIRECTORY_NAME, index,
+                      index);
+  if (rep == NULL || rep->type == REDIS_REPLY_ERROR)
+    g_debug ("%s: couldn't clear directory entries of DB #%u: %s", __func__,
+             index, rep ? rep->str : ctx->errstr);
+  if (rep != NULL)
+    freeReplyObject (rep);
+}
+
+/**
+ * @brief Add a marker key to the directory.
+ *
+ * @param[in] ctx    Redis context, with the management DB selected.
+ * @param[in] key    Key.
+ * @param[in] index  Index of the DB holding the key.
+ */
+static void
+redis_directory_add (redisContext *ctx, const char *key, unsigned int index)
+{
+  redisReply *rep;
+
+  rep = redisCommand (ctx, "EVAL %s 2 %s " KB_DIRECTORY_KEYS_PREFIX "%u %s %u",
+                      KB_SCRIPT_DIRECTORY_ADD, KB_DIRECTORY_NAME, index, key,
+                      index);
+  if (rep == NULL || rep->type == REDIS_REPLY_ERROR)
+    g_debug ("%s: couldn't add %s to directory: %s", __func__, key,
+             rep ? rep->str : ctx->errstr);
+  if (rep != NULL)
+    freeReplyObject (rep);
+}
+
 /**
  * @brief Set the number of databases have been configured
  *        into kbr struct.
@@ -180,6 +363,9 @@ select_database (struct kb_redis *kbr)
           if (rc == 0)
             break;
         }
+      /* Entries left by a previous owner which didn't release the DB. */
+      if (kbr->db)
+        redis_directory_clear (ctx, kbr->db);
     }
 
   /* No DB available, give up. */
@@ -230,6 +416,7 @@ redis_release_db (struct kb_redis *kbr)
     }
   freeReplyObject (rep);
 
+  redis_directory_clear (ctx, kbr->db);
   rep = redisCommand (ctx, "HDEL %s %d", GLOBAL_DBINDEX_NAME, kbr->db);
   if (rep == NULL || rep->type != REDIS_REPLY_INTEGER)
     {
@@ -259,33 +446,41 @@ parse_port_of_addr (const char *addr, int tcp_indicator_len)
   return tmp + 1;
 }
 
-static redisContext *
-connect_redis (const char *addr, int len)
+/**
+ * @brief Parse a "tcp://host[:port]" redis address.
+ *
+ * @param[in]  addr  Address of the redis server.
+ * @param[in]  len   Length of addr.
+ * @param[out] port  Port of the redis server.
+ *
+ * @return Host to be freed with free(), NULL if addr is not a TCP address
+ *         (i.e. it is the path to a unix socket).
+ */
+static char *
+parse_tcp_addr (const char *addr, int len, int *port)
 {
   const char *tcp_indicator = "tcp://";
   const int tcp_indicator_len = strlen (tcp_indicator);
   const int redis_default_port = 6379;
 
-  int port, host_len;
+  int host_len;
   char *tmp, *host;
-  redisContext *result;
   static int warn_flag = 0;
 
   if (len < tcp_indicator_len + 1)
-    goto unix_connect;
+    return NULL;
   if (memcmp (addr, tcp_indicator, tcp_indicator_len) != 0)
-    goto unix_connect;
+    return NULL;
   host_len = len - tcp_indicator_len;
   if ((tmp = parse_port_of_addr (addr, tcp_indicator_len)) == NULL)
-    port = redis_default_port;
+    *port = redis_default_port;
   else
     {
-      port = atoi (tmp);
+      *port = atoi (tmp);
       host_len -= strlen (tmp) + 1;
     }
-  host = calloc (1, host_len);
+  host = calloc (1, host_len + 1);
   memmove (host, addr + tcp_indicator_len, host_len);
-  result = redisConnect (host, port);
   if (warn_flag == 0)
     {
       g_warning ("A Redis TCP connection is being used. This feature is "
@@ -293,10 +488,238 @@ connect_redis (const char *addr, int len)
                  "channel. We discourage its usage in production environments");
       warn_flag = 1;
     }
+  return host;
+}
+
+static redisContext *
+connect_redis (const char *addr, int len)
+{
+  int port;
+  char *host;
+  redisContext *result;
+
+  if ((host = parse_tcp_addr (addr, len, &port)) == NULL)
+    return redisConnectUnix (addr);
+  result = redisConnect (host, port);
   free (host);
   return result;
-unix_connect:
-  return redisConnectUnix (addr);
+}
+
+/**
+ * @brief Get the SHA1 of the unique insertion script.
+ *
+ * The digest is computed once per process instead of loading the script on
+ * every connection. The server caches the script on the first EVAL, after
+ * an EVALSHA failed with NOSCRIPT.
+ *
+ * @return SHA1 of KB_SCRIPT_ADD_UNIQUE, in hex.
+ */
+static const char *
+redis_add_unique_sha (void)
+{
+  static gsize init = 0;
+
+  if (g_once_init_enter (&init))
+    {
+      add_unique_sha = g_compute_checksum_for_string (G_CHECKSUM_SHA1,
+                                                      KB_SCRIPT_ADD_UNIQUE, -1);
+      g_once_init_leave (&init, 1);
+    }
+  return add_unique_sha;
+}
+
+/**
+ * @brief Idle redis connection kept in the connection pool.
+ */
+struct kb_pool_conn
+{
+  redisContext *rctx; /**< Redis client context. */
+  unsigned int db;    /**< Currently selected database. */
+  pid_t pid;          /**< Process which established the connection. */
+};
+
+/**
+ * @brief Pool of idle connections. Maps a path to a GSList of
+ *        struct kb_pool_conn.
+ */
+static GHashTable *kb_pool = NULL;
+
+/**
+ * @brief Lock protecting kb_pool.
+ */
+static GMutex kb_pool_lock;
+
+/**
+ * @brief Check that a redis connection is still usable.
+ *
+ * @param[in] ctx Redis context to check.
+ *
+ * @return 0 if the server answered a PING, -1 otherwise.
+ */
+static int
+redis_ping (redisContext *ctx)
+{
+  redisReply *rep;
+  int rc = -1;
+
+  rep = redisCommand (ctx, "PING");
+  if (rep && rep->type == REDIS_REPLY_STATUS
+      && !g_ascii_strcasecmp (rep->str, "PONG"))
+    rc = 0;
+  if (rep)
+    freeReplyObject (rep);
+
+  return rc;
+}
+
+/**
+ * @brief Take an idle connection to a path out of the pool.
+ *
+ * A connection with the given database selected is preferred. Connections
+ * established by another process (i.e. inherited through fork()) or failing
+ * the health check are dropped.
+ *
+ * @param[in]  path      Path to the server socket.
+ * @param[in]  db        Wanted database.
+ * @param[out] selected  Database selected on the returned connection.
+ *
+ * @return Redis context, NULL if no usable connection is in the pool.
+ */
+static redisContext *
+kb_pool_take (const char *path, unsigned int db, unsigned int *selected)
+{
+  while (1)
+    {
+      struct kb_pool_conn *conn;
+      GSList *conns, *elem, *match = NULL;
+      redisContext *ctx;
+
+      g_mutex_lock (&kb_pool_lock);
+      if (kb_pool == NULL)
+        {
+          g_mutex_unlock (&kb_pool_lock);
+          return NULL;
+        }
+      conns = g_hash_table_lookup (kb_pool, path);
+      for (elem = conns; elem; elem = elem->next)
+        if (((struct kb_pool_conn *) elem->data)->db == db)
+          {
+            match = elem;
+            break;
+          }
+      if (match == NULL)
+        match = conns;
+      if (match == NULL)
+        {
+          g_mutex_unlock (&kb_pool_lock);
+          return NULL;
+        }
+      conn = match->data;
+      conns = g_slist_delete_link (conns, match);
+      if (conns)
+        g_hash_table_insert (kb_pool, g_strdup (path), conns);
+      else
+        g_hash_table_remove (kb_pool, path);
+      g_mutex_unlock (&kb_pool_lock);
+
+      ctx = conn->rctx;
+      *selected = conn->db;
+      if (conn->pid == getpid () && redis_ping (ctx) == 0)
+        {
+          g_free (conn);
+          return ctx;
+        }
+      redisFree (ctx);
+      g_free (conn);
+    }
+}
+
+/**
+ * @brief Return an established connection to the pool.
+ *
+ * The connection is closed instead if it is in an error state or if the pool
+ * is full.
+ *
+ * @param[in] path  Path to the server socket.
+ * @param[in] ctx   Redis context to return.
+ * @param[in] db    Database selected on the connection.
+ */
+static void
+kb_pool_put (const char *path, redisContext *ctx, unsigned int db)
+{
+  struct kb_pool_conn *conn;
+  GSList *conns;
+
+  if (ctx->err)
+    {
+      redisFree (ctx);
+      return;
+    }
+
+  g_mutex_lock (&kb_pool_lock);
+  if (kb_pool == NULL)
+    kb_pool = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  conns = g_hash_table_lookup (kb_pool, path);
+  if (g_slist_length (conns) >= KB_POOL_MAX_IDLE)
+    {
+      g_mutex_unlock (&kb_pool_lock);
+      redisFree (ctx);
+      return;
+    }
+  conn = g_malloc0 (sizeof (struct kb_pool_conn));
+  conn->rctx = ctx;
+  conn->db = db;
+  conn->pid = getpid ();
+  g_hash_table_insert (kb_pool, g_strdup (path), g_slist_prepend (conns, conn));
+  g_mutex_unlock (&kb_pool_lock);
+}
+
+/**
+ * @brief Get a connection to the database of a pooled KB, from the pool if
+ *        possible.
+ *
+ * @param[in] kbr Subclass of struct kb where to save the context.
+ *
+ * @return 0 on success, -1 on connection error.
+ */
+static int
+redis_pool_connect (struct kb_redis *kbr)
+{
+  unsigned int selected = 0;
+  redisContext *ctx;
+
+  ctx = kb_pool_take (kbr->path, kbr->db, &selected);
+  if (ctx == NULL)
+    {
+      ctx = connect_redis (kbr->path, strlen (kbr->path));
+      if (ctx == NULL || ctx->err)
+        {
+          g_log (G_LOG_DOMAIN, G_LOG_LEVEL_CRITICAL,
+                 "%s: redis connection error to %s: %s", __func__, kbr->path,
+                 ctx ? ctx->errstr : strerror (ENOMEM));
+          redisFree (ctx);
+          return -1;
+        }
+    }
+
+  if (selected != kbr->db)
+    {
+      redisReply *rep;
+
+      rep = redisCommand (ctx, "SELECT %u", kbr->db);
+      if (rep == NULL || rep->type != REDIS_REPLY_STATUS)
+        {
+          if (rep != NULL)
+            freeReplyObject (rep);
+          redisFree (ctx);
+          return -1;
+        }
+      freeReplyObject (rep);
+    }
+
+  kbr->rctx = ctx;
+  kbr->pid = getpid ();
+  return 0;
 }
 
 /**
@@ -316,6 +739,9 @@ get_redis_ctx (struct kb_redis *kbr)
   if (kbr->rctx != NULL)
     return 0;
 
+  if (kbr->pooled)
+    return redis_pool_connect (kbr);
+
   kbr->rctx = connect_redis (kbr->path, strlen (kbr->path));
   if (kbr->rctx == NULL || kbr->rctx->err)
     {
@@ -335,6 +761,7 @@ get_redis_ctx (struct kb_redis *kbr)
       kbr->rctx = NULL;
       return -2;
     }
+  kbr->pid = getpid ();
 
   g_debug ("%s: connected to redis://%s/%d", __func__, kbr->path, kbr->db);
   return 0;
@@ -395,8 +822,12 @@ redis_delete (kb_t kb)
 
   kbr = redis_kb (kb);
 
+  if (kb_stats_log_delete)
+    kb_stats_log ();
+
   redis_delete_all (kbr);
   redis_release_db (kbr);
+  redis_track_stop (kbr, 0);
 
   if (kbr->rctx != NULL)
     {
@@ -405,6 +836,7 @@ redis_delete (kb_t kb)
       kbr->rctx = NULL;
     }
 
+  g_free (kbr->kb_path);
   g_free (kb);
   return 0;
 }
@@ -422,7 +854,7 @@ redis_get_kb_index (kb_t kb)
   int i;
   i = ((struct kb_redis *) kb)->db;
   if (i > 0)
-    return i;
+    return ((struct kb_redis *) kb)->shard * KB_SHARD_STRIDE + i;
   return -1;
 }
 
@@ -454,26 +886,124 @@ redis_memory_purge (kb_t kb)
 }
 
 /**
- * @brief Initialize a new Knowledge Base object.
+ * @brief Split a KB path into the paths of its Redis servers.
  *
- * @param[in] kb  Reference to a kb_t to initialize.
- * @param[in] kb_path   Path to KB.
+ * A KB path may list several servers separated by KB_SHARD_SEPARATOR, e.g.
+ * "/run/redis/a.sock,/run/redis/b.sock".  Each KB lives on one of them.
  *
- * @return 0 on success, -1 on connection error, -2 when no DB is available, -3
- * when given kb_path was NULL.
+ * @param[in]  kb_path  Path to KB.
+ * @param[out] count    Number of servers.
+ *
+ * @return NULL-terminated paths, free with g_strfreev.
+ */
+static gchar **
+redis_shard_paths (const char *kb_path, unsigned int *count)
+{
+  gchar **paths = g_strsplit (kb_path, KB_SHARD_SEPARATOR, 0);
+  unsigned int i, n = 0;
+
+  for (i = 0; paths[i]; i++)
+    {
+      g_strstrip (paths[i]);
+      if (*paths[i])
+        paths[n++] = paths[i];
+      else
+        g_free (paths[i]);
+    }
+  paths[n] = NULL;
+  *count = n;
+  return paths;
+}
+
+/**
+ * @brief Get the server and the DB of a KB index in a KB path.
+ *
+ * @param[in]  kb_path   Path to KB, possibly sharded.
+ * @param[in]  kb_index  KB index, as returned by kb_get_kb_index.
+ * @param[out] shard     Position of the server in the KB path.
+ * @param[out] db        DB number on the server.
+ *
+ * @return Path to the server, free with g_free. NULL if kb_index is not in
+ *         the KB path.
+ */
+static char *
+redis_shard_route (const char *kb_path, int kb_index, unsigned int *shard,
+                   unsigned int *db)
+{
+  gchar **paths;
+  unsigned int count;
+  char *path = NULL;
+
+  paths = redis_shard_paths (kb_path, &count);
+  if (count <= 1)
+    {
+      path = g_strdup (kb_path);
+      *shard = 0;
+      *db = kb_index;
+    }
+  else if (kb_index >= 0 && (unsigned) kb_index / KB_SHARD_STRIDE < count)
+    {
+      *shard = kb_index / KB_SHARD_STRIDE;
+      *db = kb_index % KB_SHARD_STRIDE;
+      path = g_strdup (paths[*shard]);
+    }
+  g_strfreev (paths);
+  return path;
+}
+
+/**
+ * @brief Get the number of free DBs of a Redis server.
+ *
+ * @param[in] path  Path to the server.
+ *
+ * @return Number of free DBs, -1 if the server can't be reached.
  */
 static int
-redis_new (kb_t *kb, const char *kb_path)
+redis_shard_free_dbs (const char *path)
+{
+  struct kb_redis kbr;
+  redisReply *rep;
+  int free_dbs = -1;
+
+  memset (&kbr, 0, sizeof (kbr));
+  kbr.rctx = connect_redis (path, strlen (path));
+  if (kbr.rctx == NULL || kbr.rctx->err)
+    {
+      redisFree (kbr.rctx);
+      return -1;
+    }
+  if (fetch_max_db_index (&kbr) == 0)
+    {
+      rep = redisCommand (kbr.rctx, "HLEN %s", GLOBAL_DBINDEX_NAME);
+      if (rep != NULL && rep->type == REDIS_REPLY_INTEGER)
+        /* DB 0 is the management DB. */
+        free_dbs = MAX ((long long) kbr.max_db - 1 - rep->integer, 0);
+      if (rep != NULL)
+        freeReplyObject (rep);
+    }
+  redisFree (kbr.rctx);
+  return free_dbs;
+}
+
+/**
+ * @brief Initialize a new Knowledge Base object on one Redis server.
+ *
+ * @param[in] kb     Reference to a kb_t to initialize.
+ * @param[in] path   Path to the server.
+ * @param[in] shard  Position of the server in the KB path.
+ *
+ * @return 0 on success, -1 on connection error, -2 when no DB is available.
+ */
+static int
+redis_new_shard (kb_t *kb, const char *path, unsigned int shard)
 {
   struct kb_redis *kbr;
   int rc = 0;
 
-  if (kb_path == NULL)
-    return -3;
-
   kbr = g_malloc0 (sizeof (struct kb_redis));
   kbr->kb.kb_ops = &KBRedisOperations;
-  kbr->path = g_strdup (kb_path);
+  kbr->path = g_strdup (path);
+  kbr->shard = shard;
 
   if ((rc = get_redis_ctx (kbr)) < 0)
     {
@@ -483,7 +1013,7 @@ redis_new (kb_t *kb, const char *kb_path)
   if (redis_test_connection (kbr))
     {
       g_log (G_LOG_DOMAIN, G_LOG_LEVEL_CRITICAL,
-             "%s: cannot access redis at '%s'", __func__, kb_path);
+             "%s: cannot access redis at '%s'", __func__, path);
       redis_delete ((kb_t) kbr);
       kbr = NULL;
       rc = -1;
@@ -502,137 +1032,351 @@ redis_new (kb_t *kb, const char *kb_path)
 }
 
 /**
- * @brief Connect to a Knowledge Base object with the given kb_index.
+ * @brief A Redis server of a sharded KB path and its free DBs.
+ */
+struct redis_shard_load
+{
+  unsigned int shard; /**< Position of the server in the KB path. */
+  int free_dbs;       /**< Free DBs, -1 if unreachable. */
+};
+
+/**
+ * @brief Compare two servers by decreasing number of free DBs.
  *
- * @param[in] kb_path   Path to KB.
- * @param[in] kb_index       DB index
+ * @param[in] a  Pointer to first server.
+ * @param[in] b  Pointer to second server.
  *
- * @return Knowledge Base object, NULL otherwise.
+ * @return Negative, 0 or positive like strcmp.
  */
-static kb_t
-redis_direct_conn (const char *kb_path, const int kb_index)
+static gint
+cmp_shard_load (gconstpointer a, gconstpointer b)
 {
-  struct kb_redis *kbr;
-  redisReply *rep;
+  const struct redis_shard_load *la = a, *lb = b;
 
-  if (kb_path == NULL)
-    return NULL;
+  if (la->free_dbs != lb->free_dbs)
+    return lb->free_dbs - la->free_dbs;
+  return (la->shard > lb->shard) - (la->shard < lb->shard);
+}
 
-  kbr = g_malloc0 (sizeof (struct kb_redis));
-  kbr->kb.kb_ops = &KBRedisOperations;
-  kbr->path = g_strdup (kb_path);
+/**
+ * @brief Initialize a new Knowledge Base object.
+ *
+ * With several Redis servers in kb_path, the KB is created on the server
+ * with the most free DBs, falling back to the others.
+ *
+ * @param[in] kb  Reference to a kb_t to initialize.
+ * @param[in] kb_path   Path to KB.
+ *
+ * @return 0 on success, -1 on connection error, -2 when no DB is available, -3
+ * when given kb_path was NULL.
+ */
+static int
+redis_new (kb_t *kb, const char *kb_path)
+{
+  struct redis_shard_load *loads;
+  gchar **paths;
+  unsigned int count, i;
+  int rc = -2;
 
-  kbr->rctx = connect_redis (kbr->path, strlen (kbr->path));
-  if (kbr->rctx == NULL || kbr->rctx->err)
+  if (kb_path == NULL)
+    return -3;
+
+  paths = redis_shard_paths (kb_path, &count);
+  if (count <= 1)
+    {
+      g_strfreev (paths);
+      return redis_new_shard (kb, kb_path, 0);
+    }
+
+  loads = g_malloc_n (count, sizeof (*loads));
+  for (i = 0; i < count; i++)
+    {
+      loads[i].shard = i;
+      loads[i].free_dbs = redis_shard_free_dbs (paths[i]);
+    }
+  qsort (loads, count, sizeof (*loads), cmp_shard_load);
+
+  for (i = 0; i < count; i++)
+    {
+      rc = redis_new_shard (kb, paths[loads[i].shard], loads[i].shard);
+      if (rc == 0)
+        {
+          redis_kb (*kb)->kb_path = g_strdup (kb_path);
+          g_debug ("%s: new KB on shard %u (%s), %d free DBs", __func__,
+                   loads[i].shard, paths[loads[i].shard], loads[i].free_dbs);
+          break;
+        }
+      *kb = NULL;
+    }
+
+  g_free (loads);
+  g_strfreev (paths);
+  return rc;
+}
+
+/**
+ * @brief Connect to a Knowledge Base object with the given kb_index.
+ *
+ * With several Redis servers in kb_path, kb_index selects the server too.
+ *
+ * @param[in] kb_path   Path to KB.
+ * @param[in] kb_index       DB index
+ *
+ * @return Knowledge Base object, NULL otherwise.
+ */
+static kb_t
+redis_direct_conn (const char *kb_path, const int kb_index)
+{
+  struct kb_redis *kbr;
+
+  if (kb_path == NULL)
+    return NULL;
+
+  kbr = g_malloc0 (sizeof (struct kb_redis));
+  kbr->kb.kb_ops = &KBRedisOperations;
+  kbr->pooled = 1;
+  kbr->path = redis_shard_route (kb_path, kb_index, &kbr->shard, &kbr->db);
+
+  if (kbr->path == NULL || redis_pool_connect (kbr))
     {
-      g_log (G_LOG_DOMAIN, G_LOG_LEVEL_CRITICAL,
-             "%s: redis connection error to %s: %s", __func__, kbr->path,
-             kbr->rctx ? kbr->rctx->errstr : strerror (ENOMEM));
-      redisFree (kbr->rctx);
       g_free (kbr->path);
       g_free (kbr);
       return NULL;
     }
-  kbr->db = kb_index;
-  rep = redisCommand (kbr->rctx, "SELECT %d", kb_index);
+  if (strstr (kb_path, KB_SHARD_SEPARATOR))
+    kbr->kb_path = g_strdup (kb_path);
+  return (kb_t) kbr;
+}
+
+/**
+ * @brief Compare two database indexes. Used for sorting.
+ *
+ * @param[in] a  Pointer to first index.
+ * @param[in] b  Pointer to second index.
+ *
+ * @return Negative, 0 or positive like strcmp.
+ */
+static gint
+cmp_db_index (gconstpointer a, gconstpointer b)
+{
+  unsigned int ia = *(const unsigned int *) a, ib = *(const unsigned int *) b;
+
+  return (ia > ib) - (ia < ib);
+}
+
+/**
+ * @brief Select a DB.
+ *
+ * @param[in] ctx    Redis context.
+ * @param[in] index  DB index.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+redis_select (redisContext *ctx, unsigned int index)
+{
+  redisReply *rep;
+  int rc = 0;
+
+  rep = redisCommand (ctx, "SELECT %u", index);
   if (rep == NULL || rep->type != REDIS_REPLY_STATUS)
+    rc = -1;
+  if (rep != NULL)
+    freeReplyObject (rep);
+  return rc;
+}
+
+/**
+ * @brief Find the DB holding a key with the directory of marker keys.
+ *
+ * @param[in] kbr  Subclass of struct kb, connected to the management DB.
+ * @param[in] key  Key to find.
+ *
+ * @return 0 if found, with the DB selected. 1 if not found, with the
+ *         management DB selected. -1 on error, with the connection reset.
+ */
+static int
+redis_directory_find (struct kb_redis *kbr, const char *key)
+{
+  redisReply *rep;
+  unsigned int index = 0;
+  char *tmp;
+
+  rep = redisCommand (kbr->rctx, "HGET %s %s", KB_DIRECTORY_NAME, key);
+  if (rep == NULL)
     {
-      if (rep != NULL)
-        freeReplyObject (rep);
-      redisFree (kbr->rctx);
-      kbr->rctx = NULL;
-      g_free (kbr->path);
-      g_free (kbr);
-      return NULL;
+      redis_lnk_reset ((kb_t) kbr);
+      return -1;
     }
+  if (rep->type == REDIS_REPLY_STRING)
+    index = atoi (rep->str);
   freeReplyObject (rep);
-  return (kb_t) kbr;
+  if (index == 0 || index >= kbr->max_db)
+    return 1;
+
+  if (redis_select (kbr->rctx, index))
+    {
+      redis_lnk_reset ((kb_t) kbr);
+      return -1;
+    }
+  kbr->db = index;
+  /* The entry is stale if the DB was reused without being released. */
+  tmp = kb_item_get_str (&kbr->kb, key);
+  if (tmp)
+    {
+      g_free (tmp);
+      return 0;
+    }
+  if (kbr->rctx == NULL || redis_select (kbr->rctx, 0))
+    {
+      redis_lnk_reset ((kb_t) kbr);
+      return -1;
+    }
+  kbr->db = 0;
+  return 1;
 }
 
 /**
- * @brief Find an existing Knowledge Base object with key.
+ * @brief Find an existing Knowledge Base object with key on one Redis server.
  *
- * @param[in] kb_path   Path to KB.
- * @param[in] key       Marker key to search for in KB objects.
+ * @param[in] path   Path to the server.
+ * @param[in] shard  Position of the server in the KB path.
+ * @param[in] key    Marker key to search for in KB objects.
  *
  * @return Knowledge Base object, NULL otherwise.
  */
 static kb_t
-redis_find (const char *kb_path, const char *key)
+redis_find_shard (const char *path, unsigned int shard, const char *key)
 {
   struct kb_redis *kbr;
-  unsigned int i = 1;
-
-  if (kb_path == NULL)
-    return NULL;
+  redisReply *rep;
+  GArray *indexes;
+  unsigned int i;
 
   kbr = g_malloc0 (sizeof (struct kb_redis));
   kbr->kb.kb_ops = &KBRedisOperations;
-  kbr->path = g_strdup (kb_path);
+  kbr->path = g_strdup (path);
+  kbr->shard = shard;
+  kbr->pooled = 1;
 
-  do
+  /* Connection to the management database. */
+  if (redis_pool_connect (kbr))
     {
-      redisReply *rep;
+      g_free (kbr->path);
+      g_free (kbr);
+      return NULL;
+    }
 
-      kbr->rctx = connect_redis (kbr->path, strlen (kbr->path));
-      if (kbr->rctx == NULL || kbr->rctx->err)
-        {
-          g_log (G_LOG_DOMAIN, G_LOG_LEVEL_CRITICAL,
-                 "%s: redis connection error to %s: %s", __func__, kbr->path,
-                 kbr->rctx ? kbr->rctx->errstr : strerror (ENOMEM));
-          redisFree (kbr->rctx);
-          g_free (kbr->path);
-          g_free (kbr);
-          return NULL;
-        }
+  if (kbr->max_db == 0)
+    fetch_max_db_index (kbr);
 
-      if (kbr->max_db == 0)
-        fetch_max_db_index (kbr);
+  /* Single lookup in the directory, probing the DBs is the fallback. */
+  if (key && redis_directory_find (kbr, key) == 0)
+    return (kb_t) kbr;
+  if (kbr->rctx == NULL)
+    {
+      g_free (kbr->path);
+      g_free (kbr);
+      return NULL;
+    }
 
-      kbr->db = i;
-      rep = redisCommand (kbr->rctx, "HEXISTS %s %d", GLOBAL_DBINDEX_NAME, i);
-      if (rep == NULL || rep->type != REDIS_REPLY_INTEGER || rep->integer != 1)
+  /* Get all used database indexes at once instead of probing each one. */
+  indexes = g_array_new (FALSE, FALSE, sizeof (unsigned int));
+  rep = redisCommand (kbr->rctx, "HKEYS %s", GLOBAL_DBINDEX_NAME);
+  if (rep != NULL && rep->type == REDIS_REPLY_ARRAY)
+    for (i = 0; i < rep->elements; i++)
+      {
+        unsigned int index;
+
+        if (rep->element[i]->type != REDIS_REPLY_STRING)
+          continue;
+        index = atoi (rep->element[i]->str);
+        if (index > 0 && index < kbr->max_db)
+          g_array_append_val (indexes, index);
+      }
+  if (rep != NULL)
+    freeReplyObject (rep);
+  g_array_sort (indexes, cmp_db_index);
+
+  for (i = 0; key && i < indexes->len; i++)
+    {
+      char *tmp;
+      unsigned int index = g_array_index (indexes, unsigned int, i);
+
+      rep = redisCommand (kbr->rctx, "SELECT %u", index);
+      if (rep == NULL || rep->type != REDIS_REPLY_STATUS)
         {
           if (rep != NULL)
             freeReplyObject (rep);
-          i++;
-          redisFree (kbr->rctx);
-          kbr->rctx = NULL;
-          continue;
+          break;
         }
       freeReplyObject (rep);
-      rep = redisCommand (kbr->rctx, "SELECT %u", i);
-      if (rep == NULL || rep->type != REDIS_REPLY_STATUS)
-        {
-          redisFree (kbr->rctx);
-          kbr->rctx = NULL;
-        }
-      else
+      kbr->db = index;
+
+      tmp = kb_item_get_str (&kbr->kb, key);
+      if (tmp)
         {
-          freeReplyObject (rep);
-          if (key)
+          g_free (tmp);
+          g_array_free (indexes, TRUE);
+          /* Next lookups of the key use the directory. */
+          if (redis_select (kbr->rctx, 0) == 0)
             {
-              char *tmp = kb_item_get_str (&kbr->kb, key);
-              if (tmp)
-                {
-                  g_free (tmp);
-                  return (kb_t) kbr;
-                }
+              redis_directory_add (kbr->rctx, key, index);
+              redis_select (kbr->rctx, index);
             }
-          redisFree (kbr->rctx);
+          return (kb_t) kbr;
         }
-      i++;
+      if (kbr->rctx == NULL)
+        break;
     }
-  while (i < kbr->max_db);
 
+  g_array_free (indexes, TRUE);
+  redis_lnk_reset ((kb_t) kbr);
   g_free (kbr->path);
   g_free (kbr);
   return NULL;
 }
 
+/**
+ * @brief Find an existing Knowledge Base object with key.
+ *
+ * With several Redis servers in kb_path, they are searched in order.
+ *
+ * @param[in] kb_path   Path to KB.
+ * @param[in] key       Marker key to search for in KB objects.
+ *
+ * @return Knowledge Base object, NULL otherwise.
+ */
+static kb_t
+redis_find (const char *kb_path, const char *key)
+{
+  gchar **paths;
+  unsigned int count, i;
+  kb_t kb = NULL;
+
+  if (kb_path == NULL)
+    return NULL;
+
+  paths = redis_shard_paths (kb_path, &count);
+  if (count <= 1)
+    {
+      g_strfreev (paths);
+      return redis_find_shard (kb_path, 0, key);
+    }
+  for (i = 0; kb == NULL && i < count; i++)
+    kb = redis_find_shard (paths[i], i, key);
+  if (kb)
+    redis_kb (kb)->kb_path = g_strdup (kb_path);
+  g_strfreev (paths);
+  return kb;
+}
+
 /**
  * @brief Release a KB item (or a list).
  *
+ * The memory accounting counts the items with their names, not their string
+ * values, which callers may take over.
+ *
  * @param[in] item Item or list to be release
  */
 void
@@ -645,6 +1389,7 @@ kb_item_free (struct kb_item *item)
       next = item->next;
       if (item->type == KB_TYPE_STR && item->v_str != NULL)
         g_free (item->v_str);
+      gvm_memstats_free (GVM_MEM_KB, sizeof (struct kb_item) + item->namelen);
       g_free (item);
       item = next;
     }
@@ -671,6 +1416,7 @@ redis2kbitem_single (const char *name, const redisReply *elt, int force_int)
   namelen = strlen (name) + 1;
 
   item = g_malloc0 (sizeof (struct kb_item) + namelen);
+  gvm_memstats_alloc (GVM_MEM_KB, sizeof (struct kb_item) + namelen);
   if (elt->type == REDIS_REPLY_INTEGER)
     {
       item->type = KB_TYPE_INT;
@@ -750,786 +1496,2169 @@ redis2kbitem (const char *name, const redisReply *rep)
 }
 
 /**
- * @brief Execute a redis command and get a redis reply.
- *
- * @param[in] kbr Subclass of struct kb to connect to.
- * @param[in] fmt Formatted variable argument list with the cmd to be executed.
- *
- * @return Redis reply on success, NULL otherwise.
+ * @brief Redis commands with their own statistics. Index 0 collects all
+ *        other commands, index 1 the replies of pipelined commands.
  */
-static redisReply *
-redis_cmd (struct kb_redis *kbr, const char *fmt, ...)
-{
-  redisReply *rep;
-  va_list ap, aq;
-  int retry = 0;
+static const char *kb_stats_cmds[] = {
+  "OTHER",  "PIPELINE", "BRPOP", "DEL",   "EVAL",  "EVALSHA", "EXEC",
+  "FLUSHDB", "GET",     "HKEYS", "LINDEX", "LPUSH", "LRANGE", "LTRIM",
+  "MULTI",  "PING",     "RPOP",  "RPUSH", "SAVE",  "SCAN",    "SELECT",
+  "SET",    "TYPE",     "UNLINK"};
 
-  va_start (ap, fmt);
-  do
-    {
-      if (get_redis_ctx (kbr) < 0)
-        {
-          va_end (ap);
-          return NULL;
-        }
+#define KB_STATS_CMDS (sizeof (kb_stats_cmds) / sizeof (*kb_stats_cmds))
+#define KB_STATS_PIPELINE 1
 
-      va_copy (aq, ap);
-      rep = redisvCommand (kbr->rctx, fmt, aq);
-      va_end (aq);
+/**
+ * @brief Counters of a thread.
+ */
+struct kb_stats_block
+{
+  struct kb_cmd_stats cmds[KB_STATS_CMDS]; /**< Counters by command. */
+  unsigned int pending;      /**< Pipelined replies not yet read. */
+  struct timespec last;      /**< Start of the wait for the next reply. */
+};
 
-      if (kbr->rctx->err)
-        {
-          if (rep != NULL)
-            freeReplyObject (rep);
+/**
+ * @brief Counters of all running threads. Only the owner thread increments
+ *        them, with relaxed atomic operations so that they can be read and
+ *        reset from other threads without locking the hot path.
+ */
+static GSList *kb_stats_blocks;
 
-          redis_lnk_reset ((kb_t) kbr);
-          retry = !retry;
-        }
-      else
-        retry = 0;
-    }
-  while (retry);
+/**
+ * @brief Counters of the threads which exited.
+ */
+static struct kb_stats_block kb_stats_exited;
+static GMutex kb_stats_lock;
 
-  va_end (ap);
+/**
+ * @brief Add the counters of a command to others.
+ *
+ * @param[in,out] dst  Counters to add to, only accessed by the caller.
+ * @param[in]     src  Counters to add, possibly updated by their thread.
+ */
+static void
+kb_stats_add (struct kb_cmd_stats *dst, const struct kb_cmd_stats *src)
+{
+  unsigned int i;
 
-  return rep;
+  dst->calls += __atomic_load_n (&src->calls, __ATOMIC_RELAXED);
+  dst->errors += __atomic_load_n (&src->errors, __ATOMIC_RELAXED);
+  dst->bytes_sent += __atomic_load_n (&src->bytes_sent, __ATOMIC_RELAXED);
+  dst->bytes_recv += __atomic_load_n (&src->bytes_recv, __ATOMIC_RELAXED);
+  dst->usec_total += __atomic_load_n (&src->usec_total, __ATOMIC_RELAXED);
+  for (i = 0; i < KB_STATS_HIST_BUCKETS; i++)
+    dst->hist[i] += __atomic_load_n (&src->hist[i], __ATOMIC_RELAXED);
 }
 
 /**
- * @brief Get a single KB element.
+ * @brief Release the counters of an exiting thread.
  *
- * @param[in] kb KB handle where to fetch the item.
- * @param[in] name  Name of the element to retrieve.
- * @param[in] type Desired element type.
+ * Their values are kept in the counters of the threads which exited.
  *
- * @return A struct kb_item to be freed with kb_item_free() or NULL if no
- *         element was found or on error.
+ * @param[in] data  Counters of the thread.
  */
-static struct kb_item *
-redis_get_single (kb_t kb, const char *name, enum kb_item_type type)
+static void
+kb_stats_block_free (gpointer data)
 {
-  struct kb_item *kbi;
-  struct kb_redis *kbr;
-  redisReply *rep;
+  struct kb_stats_block *block = data;
+  unsigned int i;
 
-  kbr = redis_kb (kb);
-  kbi = NULL;
+  g_mutex_lock (&kb_stats_lock);
+  kb_stats_blocks = g_slist_remove (kb_stats_blocks, block);
+  for (i = 0; i < KB_STATS_CMDS; i++)
+    kb_stats_add (&kb_stats_exited.cmds[i], &block->cmds[i]);
+  g_mutex_unlock (&kb_stats_lock);
+  g_free (block);
+}
 
-  rep = redis_cmd (kbr, "LINDEX %s -1", name);
-  if (rep == NULL || rep->type != REDIS_REPLY_STRING)
+/**
+ * @brief Counters of the current thread, freed when the thread exits.
+ */
+static GPrivate kb_stats_key = G_PRIVATE_INIT (kb_stats_block_free);
+
+static struct kb_stats_block *
+kb_stats_block (void)
+{
+  struct kb_stats_block *block = g_private_get (&kb_stats_key);
+
+  if (block == NULL)
     {
-      kbi = NULL;
-      goto out;
+      block = g_malloc0 (sizeof (struct kb_stats_block));
+      g_mutex_lock (&kb_stats_lock);
+      kb_stats_blocks = g_slist_prepend (kb_stats_blocks, block);
+      g_mutex_unlock (&kb_stats_lock);
+      g_private_set (&kb_stats_key, block);
     }
+  return block;
+}
 
-  kbi = redis2kbitem_single (name, rep, type == KB_TYPE_INT);
+/**
+ * @brief Get the statistics entry of the command of a format string.
+ */
+static unsigned int
+kb_stats_cmd (const char *fmt)
+{
+  unsigned int i;
+  size_t len = strcspn (fmt, " ");
 
-out:
-  if (rep != NULL)
-    freeReplyObject (rep);
+  for (i = 2; i < KB_STATS_CMDS; i++)
+    if (strlen (kb_stats_cmds[i]) == len
+        && !strncmp (fmt, kb_stats_cmds[i], len))
+      return i;
+  return 0;
+}
 
-  return kbi;
+static unsigned long
+kb_stats_elapsed (const struct timespec *start, struct timespec *now)
+{
+  clock_gettime (CLOCK_MONOTONIC, now);
+  return (now->tv_sec - start->tv_sec) * 1000000
+         + (now->tv_nsec - start->tv_nsec) / 1000;
 }
 
 /**
- * @brief Get a single KB string item.
- *
- * @param[in] kb  KB handle where to fetch the item.
- * @param[in] name  Name of the element to retrieve.
- *
- * @return A struct kb_item to be freed with kb_item_free() or NULL if no
- *         element was found or on error.
+ * @brief Get the payload size of a reply.
  */
-static char *
-redis_get_str (kb_t kb, const char *name)
+static size_t
+kb_stats_reply_size (const redisReply *rep)
 {
-  struct kb_item *kbi;
+  size_t i, size = 0;
 
-  kbi = redis_get_single (kb, name, KB_TYPE_STR);
-  if (kbi != NULL)
+  if (rep == NULL)
+    return 0;
+  switch (rep->type)
     {
-      char *res;
-
-      res = kbi->v_str;
-      kbi->v_str = NULL;
-      kb_item_free (kbi);
-      return res;
+    case REDIS_REPLY_STRING:
+    case REDIS_REPLY_STATUS:
+    case REDIS_REPLY_ERROR:
+      return rep->len;
+    case REDIS_REPLY_INTEGER:
+      return sizeof (rep->integer);
+    case REDIS_REPLY_ARRAY:
+      for (i = 0; i < rep->elements; i++)
+        size += kb_stats_reply_size (rep->element[i]);
+      return size;
+    default:
+      return 0;
     }
-  return NULL;
 }
 
 /**
- * @brief Push a new entry under a given key.
- *
- * @param[in] kb  KB handle where to store the item.
- * @param[in] name  Key to push to.
- * @param[in] value Value to push.
+ * @brief Record a call.
  *
- * @return 0 on success, non-null on error.
+ * @param[in] cmd   Statistics entry.
+ * @param[in] usec  Latency of the call, in microseconds.
+ * @param[in] sent  Bytes sent.
+ * @param[in] rep   Reply, NULL if no reply was received.
  */
-static int
-redis_push_str (kb_t kb, const char *name, const char *value)
+static void
+kb_stats_record (unsigned int cmd, unsigned long usec, size_t sent,
+                 const redisReply *rep)
 {
-  struct kb_redis *kbr;
-  redisReply *rep = NULL;
-  int rc = 0;
+  struct kb_cmd_stats *stats = &kb_stats_block ()->cmds[cmd];
+  unsigned int bucket = 0;
 
-  if (!value)
-    return -1;
-
-  kbr = redis_kb (kb);
-  rep = redis_cmd (kbr, "LPUSH %s %s", name, value);
-  if (!rep || rep->type == REDIS_REPLY_ERROR)
-    rc = -1;
+  while (bucket < KB_STATS_HIST_BUCKETS - 1 && (1UL << bucket) <= usec)
+    bucket++;
+  __atomic_add_fetch (&stats->calls, 1, __ATOMIC_RELAXED);
+  if (rep == NULL || rep->type == REDIS_REPLY_ERROR)
+    __atomic_add_fetch (&stats->errors, 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch (&stats->bytes_sent, sent, __ATOMIC_RELAXED);
+  __atomic_add_fetch (&stats->bytes_recv, kb_stats_reply_size (rep),
+                      __ATOMIC_RELAXED);
+  __atomic_add_fetch (&stats->usec_total, usec, __ATOMIC_RELAXED);
+  __atomic_add_fetch (&stats->hist[bucket], 1, __ATOMIC_RELAXED);
+}
 
-  if (rep)
-    freeReplyObject (rep);
+/**
+ * @brief Get an approximate latency percentile from a histogram.
+ */
+static unsigned long
+kb_stats_percentile (const struct kb_cmd_stats *stats, unsigned int percent)
+{
+  unsigned long rank, seen = 0;
+  unsigned int i;
 
-  return rc;
+  if (stats->calls == 0)
+    return 0;
+  rank = (stats->calls * percent + 99) / 100;
+  for (i = 0; i < KB_STATS_HIST_BUCKETS; i++)
+    {
+      seen += stats->hist[i];
+      if (seen >= rank)
+        return 1UL << i;
+    }
+  return 1UL << (KB_STATS_HIST_BUCKETS - 1);
 }
 
 /**
- * @brief Pops a single KB string item.
+ * @brief Get the statistics of the redis commands sent by all threads.
  *
- * @param[in] kb  KB handle where to fetch the item.
- * @param[in] name  Name of the key from where to retrieve.
+ * Counters of other threads are read while they send commands, the result is
+ * a close approximation of a snapshot.
  *
- * @return A string to be freed or NULL if list is empty or on error.
+ * @param[out] count  Number of returned entries.
+ *
+ * @return Array of the used commands, to be freed with g_free.
  */
-static char *
-redis_pop_str (kb_t kb, const char *name)
+struct kb_cmd_stats *
+kb_get_stats (size_t *count)
 {
-  struct kb_redis *kbr;
-  redisReply *rep;
-  char *value = NULL;
+  struct kb_cmd_stats *res;
+  GSList *block;
+  unsigned int i, used = 0;
 
-  kbr = redis_kb (kb);
-  rep = redis_cmd (kbr, "RPOP %s", name);
-  if (!rep)
-    return NULL;
+  res = g_malloc0 (KB_STATS_CMDS * sizeof (struct kb_cmd_stats));
+  g_mutex_lock (&kb_stats_lock);
+  for (i = 0; i < KB_STATS_CMDS; i++)
+    {
+      struct kb_cmd_stats *stats = &res[used];
 
-  if (rep->type == REDIS_REPLY_STRING)
-    value = g_strdup (rep->str);
-  freeReplyObject (rep);
+      kb_stats_add (stats, &kb_stats_exited.cmds[i]);
+      for (block = kb_stats_blocks; block; block = block->next)
+        kb_stats_add (stats,
+                      &((struct kb_stats_block *) block->data)->cmds[i]);
+      if (stats->calls == 0)
+        continue;
+      stats->cmd = kb_stats_cmds[i];
+      stats->p50_usec = kb_stats_percentile (stats, 50);
+      stats->p99_usec = kb_stats_percentile (stats, 99);
+      used++;
+    }
+  g_mutex_unlock (&kb_stats_lock);
 
-  return value;
+  if (count)
+    *count = used;
+  return res;
 }
 
 /**
- * @brief Get a single KB integer item.
- *
- * @param[in] kb  KB handle where to fetch the item.
- * @param[in] name  Name of the element to retrieve.
- *
- * @return An integer.
+ * @brief Reset the statistics of the redis commands of all threads.
  */
-static int
-redis_get_int (kb_t kb, const char *name)
+void
+kb_reset_stats (void)
 {
-  struct kb_item *kbi;
+  GSList *block;
+  unsigned int i, j;
 
-  kbi = redis_get_single (kb, name, KB_TYPE_INT);
-  if (kbi != NULL)
+  g_mutex_lock (&kb_stats_lock);
+  memset (kb_stats_exited.cmds, 0, sizeof (kb_stats_exited.cmds));
+  for (block = kb_stats_blocks; block; block = block->next)
     {
-      int res;
+      struct kb_cmd_stats *cmds = ((struct kb_stats_block *) block->data)->cmds;
 
-      res = kbi->v_int;
-      kb_item_free (kbi);
-      return res;
+      for (i = 0; i < KB_STATS_CMDS; i++)
+        {
+          __atomic_store_n (&cmds[i].calls, 0, __ATOMIC_RELAXED);
+          __atomic_store_n (&cmds[i].errors, 0, __ATOMIC_RELAXED);
+          __atomic_store_n (&cmds[i].bytes_sent, 0, __ATOMIC_RELAXED);
+          __atomic_store_n (&cmds[i].bytes_recv, 0, __ATOMIC_RELAXED);
+          __atomic_store_n (&cmds[i].usec_total, 0, __ATOMIC_RELAXED);
+          for (j = 0; j < KB_STATS_HIST_BUCKETS; j++)
+            __atomic_store_n (&cmds[i].hist[j], 0, __ATOMIC_RELAXED);
+        }
     }
-  return -1;
+  g_mutex_unlock (&kb_stats_lock);
 }
 
 /**
- * @brief Get field of a NVT.
- *
- * @param[in] kb        KB handle where to store the nvt.
- * @param[in] oid       OID of NVT to get from.
- * @param[in] position  Position of field to get.
+ * @brief Set whether deleting a KB logs the statistics of the redis commands.
  *
- * @return Value of field, NULL otherwise.
+ * @param[in] enable  1 to log them at debug level, 0 not to.
  */
-static char *
-redis_get_nvt (kb_t kb, const char *oid, enum kb_nvt_pos position)
+void
+kb_stats_log_on_delete (int enable)
 {
-  struct kb_redis *kbr;
-  redisReply *rep;
-  char *res = NULL;
-
-  kbr = redis_kb (kb);
-  if (position >= NVT_TIMESTAMP_POS)
-    rep = redis_cmd (kbr, "LINDEX filename:%s %d", oid,
-                     position - NVT_TIMESTAMP_POS);
-  else
-    rep = redis_cmd (kbr, "LINDEX nvt:%s %d", oid, position);
-  if (!rep)
-    return NULL;
-  if (rep->type == REDIS_REPLY_INTEGER)
-    res = g_strdup_printf ("%lld", rep->integer);
-  else if (rep->type == REDIS_REPLY_STRING)
-    res = g_strdup (rep->str);
-  freeReplyObject (rep);
+  kb_stats_log_delete = enable;
+}
 
-  return res;
+static void
+kb_stats_log (void)
+{
+  struct kb_cmd_stats *stats;
+  size_t count, i;
+
+  stats = kb_get_stats (&count);
+  for (i = 0; i < count; i++)
+    g_debug ("%s: %s calls=%lu errors=%lu sent=%llu recv=%llu avg=%lluus "
+             "p50=%luus p99=%luus",
+             __func__, stats[i].cmd, stats[i].calls, stats[i].errors,
+             stats[i].bytes_sent, stats[i].bytes_recv,
+             stats[i].usec_total / stats[i].calls, stats[i].p50_usec,
+             stats[i].p99_usec);
+  g_free (stats);
 }
 
 /**
- * @brief Get a full NVT.
+ * @brief Append a redis command to the output buffer, for pipelining.
  *
- * @param[in] kb        KB handle where to store the nvt.
- * @param[in] oid       OID of NVT to get.
+ * Like redisAppendCommand, but counted in the statistics. The reply must be
+ * read with redis_get_reply.
  *
- * @return nvti_t of NVT, NULL otherwise.
+ * @param[in] ctx Redis context.
+ * @param[in] fmt Format string of the command.
+ *
+ * @return REDIS_OK on success, REDIS_ERR otherwise.
  */
-static nvti_t *
-redis_get_nvt_all (kb_t kb, const char *oid)
+static int
+redis_append (redisContext *ctx, const char *fmt, ...)
 {
-  struct kb_redis *kbr;
-  redisReply *rep;
+  struct kb_stats_block *block = kb_stats_block ();
+  struct kb_cmd_stats *stats;
+  va_list ap;
+  char *cmd;
+  int len;
 
-  kbr = redis_kb (kb);
-  rep =
-    redis_cmd (kbr, "LRANGE nvt:%s %d %d", oid, NVT_FILENAME_POS, NVT_NAME_POS);
-  if (!rep)
-    return NULL;
-  if (rep->type != REDIS_REPLY_ARRAY || rep->elements != NVT_NAME_POS + 1)
-    {
-      freeReplyObject (rep);
-      return NULL;
-    }
-  else
+  va_start (ap, fmt);
+  len = redisvFormatCommand (&cmd, fmt, ap);
+  va_end (ap);
+  if (len < 0)
+    return REDIS_ERR;
+  if (redisAppendFormattedCommand (ctx, cmd, len) != REDIS_OK)
     {
-      nvti_t *nvti = nvti_new ();
-
-      nvti_set_oid (nvti, oid);
-      nvti_set_required_keys (nvti, rep->element[NVT_REQUIRED_KEYS_POS]->str);
-      nvti_set_mandatory_keys (nvti, rep->element[NVT_MANDATORY_KEYS_POS]->str);
-      nvti_set_excluded_keys (nvti, rep->element[NVT_EXCLUDED_KEYS_POS]->str);
-      nvti_set_required_udp_ports (
-        nvti, rep->element[NVT_REQUIRED_UDP_PORTS_POS]->str);
-      nvti_set_required_ports (nvti, rep->element[NVT_REQUIRED_PORTS_POS]->str);
-      nvti_set_dependencies (nvti, rep->element[NVT_DEPENDENCIES_POS]->str);
-      nvti_set_tag (nvti, rep->element[NVT_TAGS_POS]->str);
-      nvti_add_refs (nvti, "cve", rep->element[NVT_CVES_POS]->str, "");
-      nvti_add_refs (nvti, "bid", rep->element[NVT_BIDS_POS]->str, "");
-      nvti_add_refs (nvti, NULL, rep->element[NVT_XREFS_POS]->str, "");
-      nvti_set_category (nvti, atoi (rep->element[NVT_CATEGORY_POS]->str));
-      nvti_set_family (nvti, rep->element[NVT_FAMILY_POS]->str);
-      nvti_set_name (nvti, rep->element[NVT_NAME_POS]->str);
-
-      freeReplyObject (rep);
-      return nvti;
+      redisFreeCommand (cmd);
+      return REDIS_ERR;
     }
+  redisFreeCommand (cmd);
+
+  stats = &block->cmds[kb_stats_cmd (fmt)];
+  __atomic_add_fetch (&stats->calls, 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch (&stats->bytes_sent, len, __ATOMIC_RELAXED);
+  if (block->pending++ == 0)
+    clock_gettime (CLOCK_MONOTONIC, &block->last);
+  return REDIS_OK;
 }
 
 /**
- * @brief Get all items stored under a given name.
+ * @brief Read the reply of a pipelined command.
  *
- * @param[in] kb  KB handle where to fetch the items.
- * @param[in] name  Name of the elements to retrieve.
+ * Like redisGetReply, but counted in the statistics. The time waited for the
+ * reply is counted since the previous reply, or since the first command of the
+ * pipeline.
  *
- * @return Linked struct kb_item instances to be freed with kb_item_free() or
- *         NULL if no element was found or on error.
+ * @param[in]  ctx Redis context.
+ * @param[out] rep Reply.
+ *
+ * @return REDIS_OK on success, REDIS_ERR otherwise.
  */
-static struct kb_item *
-redis_get_all (kb_t kb, const char *name)
+static int
+redis_get_reply (redisContext *ctx, redisReply **rep)
 {
-  struct kb_redis *kbr;
-  struct kb_item *kbi;
-  redisReply *rep;
-
-  kbr = redis_kb (kb);
-
-  rep = redis_cmd (kbr, "LRANGE %s 0 -1", name);
-  if (rep == NULL)
-    return NULL;
-
-  kbi = redis2kbitem (name, rep);
-
-  freeReplyObject (rep);
+  struct kb_stats_block *block = kb_stats_block ();
+  struct timespec now;
+  unsigned long usec;
+  int rc;
 
-  return kbi;
+  *rep = NULL;
+  rc = redisGetReply (ctx, (void **) rep);
+  usec = kb_stats_elapsed (&block->last, &now);
+  block->last = now;
+  kb_stats_record (KB_STATS_PIPELINE, usec, 0, *rep);
+  if (rc != REDIS_OK)
+    /* The connection is broken, the remaining replies are lost. */
+    block->pending = 0;
+  else if (block->pending)
+    block->pending--;
+  return rc;
 }
 
 /**
- * @brief Get all items stored under a given pattern.
+ * @brief Execute a redis command and get a redis reply.
  *
- * @param[in] kb  KB handle where to fetch the items.
- * @param[in] pattern  '*' pattern of the elements to retrieve.
+ * The call is counted in the statistics of its command.
  *
- * @return Linked struct kb_item instances to be freed with kb_item_free() or
- *         NULL if no element was found or on error.
+ * @param[in] kbr Subclass of struct kb to connect to.
+ * @param[in] fmt Formatted variable argument list with the cmd to be executed.
+ *
+ * @return Redis reply on success, NULL otherwise.
  */
-static struct kb_item *
-redis_get_pattern (kb_t kb, const char *pattern)
+static redisReply *
+redis_cmd (struct kb_redis *kbr, const char *fmt, ...)
 {
-  struct kb_redis *kbr;
-  struct kb_item *kbi = NULL;
   redisReply *rep;
-  unsigned int i;
-
-  kbr = redis_kb (kb);
-  rep = redis_cmd (kbr, "KEYS %s", pattern);
-  if (!rep)
-    return NULL;
-  if (rep->type != REDIS_REPLY_ARRAY)
-    {
-      freeReplyObject (rep);
-      return NULL;
-    }
+  struct timespec start, end;
+  unsigned int stats_cmd = kb_stats_cmd (fmt);
+  unsigned long usec;
+  va_list ap;
+  char *cmd;
+  int len, retry = 0;
 
-  if (get_redis_ctx (kbr) < 0)
+  va_start (ap, fmt);
+  len = redisvFormatCommand (&cmd, fmt, ap);
+  va_end (ap);
+  if (len < 0)
     return NULL;
-  for (i = 0; i < rep->elements; i++)
-    redisAppendCommand (kbr->rctx, "LRANGE %s 0 -1", rep->element[i]->str);
 
-  for (i = 0; i < rep->elements; i++)
+  do
     {
-      struct kb_item *tmp;
-      redisReply *rep_range;
-
-      redisGetReply (kbr->rctx, (void **) &rep_range);
-      if (!rep)
-        continue;
-      tmp = redis2kbitem (rep->element[i]->str, rep_range);
-      if (!tmp)
+      if (get_redis_ctx (kbr) < 0)
         {
-          freeReplyObject (rep_range);
-          continue;
+          redisFreeCommand (cmd);
+          return NULL;
         }
 
-      if (kbi)
+      rep = NULL;
+      GVM_PROBE2 (redis_cmd_send, stats_cmd, len);
+      clock_gettime (CLOCK_MONOTONIC, &start);
+      if (redisAppendFormattedCommand (kbr->rctx, cmd, len) == REDIS_OK)
+        redisGetReply (kbr->rctx, (void **) &rep);
+      usec = kb_stats_elapsed (&start, &end);
+      GVM_PROBE3 (redis_cmd_receive, stats_cmd, usec,
+                  kbr->rctx->err || rep == NULL ? -1 : rep->type);
+      kb_stats_record (stats_cmd, usec, len, kbr->rctx->err ? NULL : rep);
+
+      if (kbr->rctx->err)
         {
-          struct kb_item *tmp2;
+          if (rep != NULL)
+            freeReplyObject (rep);
+          rep = NULL;
 
-          tmp2 = tmp;
-          while (tmp->next)
-            tmp = tmp->next;
-          tmp->next = kbi;
-          kbi = tmp2;
+          redis_lnk_reset ((kb_t) kbr);
+          retry = !retry;
         }
       else
-        kbi = tmp;
-      freeReplyObject (rep_range);
+        retry = 0;
     }
+  while (retry);
 
-  freeReplyObject (rep);
-  return kbi;
+  redisFreeCommand (cmd);
+
+  return rep;
 }
 
 /**
- * @brief Get all NVT OIDs.
+ * @brief Check whether an error reply means that the server doesn't support a
+ *        command or its arguments. Redis versions before 4.0 know neither
+ *        UNLINK nor FLUSHDB ASYNC.
  *
- * @param[in] kb  KB handle where to fetch the items.
+ * @param[in] rep  Reply.
  *
- * @return Linked list of all OIDs or NULL.
+ * @return 1 if unsupported, 0 otherwise.
  */
-static GSList *
-redis_get_oids (kb_t kb)
+static int
+redis_unsupported (const redisReply *rep)
+{
+  return rep->type == REDIS_REPLY_ERROR
+         && (!strncmp (rep->str, "ERR unknown command", 19)
+             || !strncmp (rep->str, "ERR wrong number of arguments", 29)
+             || !strncmp (rep->str, "ERR syntax error", 16));
+}
+
+/**
+ * @brief Get a single KB element.
+ *
+ * @param[in] kb KB handle where to fetch the item.
+ * @param[in] name  Name of the element to retrieve.
+ * @param[in] type Desired element type.
+ *
+ * @return A struct kb_item to be freed with kb_item_free() or NULL if no
+ *         element was found or on error.
+ */
+static struct kb_item *
+redis_get_single (kb_t kb, const char *name, enum kb_item_type type)
 {
+  struct kb_item *kbi;
   struct kb_redis *kbr;
   redisReply *rep;
-  GSList *list = NULL;
-  size_t i;
 
   kbr = redis_kb (kb);
-  rep = redis_cmd (kbr, "KEYS nvt:*");
-  if (!rep)
-    return NULL;
+  kbi = NULL;
 
-  if (rep->type != REDIS_REPLY_ARRAY)
+  rep = redis_cmd (kbr, "LINDEX %s -1", name);
+  if (rep == NULL || rep->type != REDIS_REPLY_STRING)
     {
-      freeReplyObject (rep);
-      return NULL;
+      kbi = NULL;
+      goto out;
     }
 
-  /* Fetch OID values from key names nvt:OID. */
-  for (i = 0; i < rep->elements; i++)
-    list = g_slist_prepend (list, g_strdup (rep->element[i]->str + 4));
-  freeReplyObject (rep);
+  kbi = redis2kbitem_single (name, rep, type == KB_TYPE_INT);
 
-  return list;
+out:
+  if (rep != NULL)
+    freeReplyObject (rep);
+
+  return kbi;
 }
 
 /**
- * @brief Count all items stored under a given pattern.
+ * @brief Get single KB elements of several names in one pipelined exchange.
  *
- * @param[in] kb  KB handle where to count the items.
- * @param[in] pattern  '*' pattern of the elements to count.
+ * @param[in]  kb     KB handle where to fetch the items.
+ * @param[in]  names  Names of the elements to retrieve.
+ * @param[in]  count  Number of names.
+ * @param[in]  type   Desired element type.
+ * @param[out] items  Array of count elements where to store the items.
  *
- * @return Count of items.
+ * @return Number of elements found, -1 on error.
  */
-static size_t
-redis_count (kb_t kb, const char *pattern)
+static int
+redis_get_many (kb_t kb, const char **names, size_t count,
+                enum kb_item_type type, struct kb_item **items)
 {
   struct kb_redis *kbr;
-  redisReply *rep;
-  size_t count;
+  size_t i;
+  int found = 0;
+
+  for (i = 0; i < count; i++)
+    items[i] = NULL;
+  if (count == 0)
+    return 0;
 
   kbr = redis_kb (kb);
+  if (get_redis_ctx (kbr) < 0)
+    return -1;
 
-  rep = redis_cmd (kbr, "KEYS %s", pattern);
-  if (rep == NULL)
-    return 0;
+  for (i = 0; i < count; i++)
+    redis_append (kbr->rctx, "LINDEX %s -1", names[i]);
 
-  if (rep->type != REDIS_REPLY_ARRAY)
+  for (i = 0; i < count; i++)
     {
+      redisReply *rep = NULL;
+
+      if (redis_get_reply (kbr->rctx, &rep) != REDIS_OK)
+        {
+          g_log (G_LOG_DOMAIN, G_LOG_LEVEL_CRITICAL,
+                 "%s: redis connection error: %s", __func__,
+                 kbr->rctx->errstr);
+          redis_lnk_reset (kb);
+          for (i = 0; i < count; i++)
+            {
+              kb_item_free (items[i]);
+              items[i] = NULL;
+            }
+          return -1;
+        }
+      if (rep->type == REDIS_REPLY_STRING)
+        {
+          items[i] = redis2kbitem_single (names[i], rep, type == KB_TYPE_INT);
+          if (items[i])
+            found++;
+        }
       freeReplyObject (rep);
-      return 0;
     }
 
-  count = rep->elements;
-  freeReplyObject (rep);
-  return count;
+  return found;
 }
 
 /**
- * @brief Delete all entries under a given name.
+ * @brief Get a single KB string item.
+ *
+ * @param[in] kb  KB handle where to fetch the item.
+ * @param[in] name  Name of the element to retrieve.
+ *
+ * @return A struct kb_item to be freed with kb_item_free() or NULL if no
+ *         element was found or on error.
+ */
+static char *
+redis_get_str (kb_t kb, const char *name)
+{
+  struct kb_item *kbi;
+
+  kbi = redis_get_single (kb, name, KB_TYPE_STR);
+  if (kbi != NULL)
+    {
+      char *res;
+
+      res = kbi->v_str;
+      kbi->v_str = NULL;
+      kb_item_free (kbi);
+      return res;
+    }
+  return NULL;
+}
+
+/**
+ * @brief Push a new entry under a given key.
  *
  * @param[in] kb  KB handle where to store the item.
- * @param[in] name  Item name.
+ * @param[in] name  Key to push to.
+ * @param[in] value Value to push.
  *
  * @return 0 on success, non-null on error.
  */
 static int
-redis_del_items (kb_t kb, const char *name)
+redis_push_str (kb_t kb, const char *name, const char *value)
 {
   struct kb_redis *kbr;
-  redisReply *rep;
+  redisReply *rep = NULL;
   int rc = 0;
 
-  kbr = redis_kb (kb);
+  if (!value)
+    return -1;
 
-  rep = redis_cmd (kbr, "DEL %s", name);
-  if (rep == NULL || rep->type == REDIS_REPLY_ERROR)
+  kbr = redis_kb (kb);
+  rep = redis_cmd (kbr, "LPUSH %s %s", name, value);
+  if (!rep || rep->type == REDIS_REPLY_ERROR)
     rc = -1;
 
-  if (rep != NULL)
+  if (rep)
     freeReplyObject (rep);
 
   return rc;
 }
 
 /**
- * @brief Insert (append) a new unique and volatile entry under a given name.
+ * @brief Number of values pushed per pipeline by redis_push_str_many.
+ */
+#define KB_PUSH_MANY_CHUNK 1000
+
+/**
+ * @brief Push several values under a given key.
  *
- * @param[in] kb  KB handle where to store the item.
- * @param[in] name  Item name.
- * @param[in] str  Item value.
- * @param[in] expire Item expire.
- * @param[in] len  Value length. Used for blobs.
- * @param[in] pos  Which position the value is appended to. 0 for right,
- *                 1 for left position in the list.
+ * The LPUSH requests are pipelined by chunks of KB_PUSH_MANY_CHUNK values.
  *
- * @return 0 on success, -1 on error.
+ * @param[in] kb     KB handle where to store the items.
+ * @param[in] name   Key to push to.
+ * @param[in] values Values to push.
+ * @param[in] count  Number of values.
+ *
+ * @return Number of values which could not be pushed, -1 on error.
  */
 static int
-redis_add_str_unique_volatile (kb_t kb, const char *name, const char *str,
-                               int expire, size_t len, int pos)
+redis_push_str_many (kb_t kb, const char *name, const char **values,
+                     size_t count)
 {
   struct kb_redis *kbr;
-  redisReply *rep = NULL;
-  int rc = 0;
   redisContext *ctx;
+  size_t start, i;
+  int failed = 0;
 
   kbr = redis_kb (kb);
   if (get_redis_ctx (kbr) < 0)
     return -1;
   ctx = kbr->rctx;
 
-  /* Some VTs still rely on values being unique (ie. a value inserted multiple
-   * times, will only be present once.)
-   * Once these are fixed, the LREM becomes redundant and should be removed.
-   */
-  if (len == 0)
+  for (start = 0; start < count; start += KB_PUSH_MANY_CHUNK)
     {
-      redisAppendCommand (ctx, "LREM %s 1 %s", name, str);
-      redisAppendCommand (ctx, "%s %s %s", pos ? "LPUSH" : "RPUSH", name, str);
-      redisAppendCommand (ctx, "EXPIRE %s %d", name, expire);
-      /* Check LREM reply. */
-      redisGetReply (ctx, (void **) &rep);
-      if (rep && rep->type == REDIS_REPLY_INTEGER && rep->integer == 1)
-        g_debug ("Key '%s' already contained value '%s'", name, str);
-      freeReplyObject (rep);
-      /* Check PUSH reply. */
-      redisGetReply (ctx, (void **) &rep);
-      if (rep == NULL || rep->type == REDIS_REPLY_ERROR)
-        {
-          rc = -1;
-          goto out;
-        }
-      /* Check EXPIRE reply. */
-      redisGetReply (ctx, (void **) &rep);
-      if (rep == NULL || rep->type == REDIS_REPLY_ERROR
-          || (rep && rep->type == REDIS_REPLY_INTEGER && rep->integer != 1))
+      size_t end = MIN (start + KB_PUSH_MANY_CHUNK, count);
+
+      for (i = start; i < end; i++)
+        redis_append (ctx, "LPUSH %s %s", name, values[i]);
+      for (i = start; i < end; i++)
         {
-          g_warning ("%s: Not able to set expire", __func__);
-          rc = -1;
-          goto out;
+          redisReply *rep = NULL;
+
+          if (redis_get_reply (ctx, &rep) != REDIS_OK)
+            {
+              g_log (G_LOG_DOMAIN, G_LOG_LEVEL_CRITICAL,
+                     "%s: redis connection error: %s", __func__, ctx->errstr);
+              redis_lnk_reset (kb);
+              return -1;
+            }
+          if (rep->type == REDIS_REPLY_ERROR)
+            failed++;
+          freeReplyObject (rep);
         }
     }
-  else
+
+  return failed;
+}
+
+/**
+ * @brief Remove popped values from the SET index of unique insertions.
+ *
+ * Only done when the index is enabled. A value pushed again meanwhile is
+ * removed from the index too, which then no longer matches the list and is
+ * rebuilt by the next unique insertion.
+ *
+ * @param[in] kbr     Subclass of struct kb the values were popped from.
+ * @param[in] name    Name of the list.
+ * @param[in] values  Popped values.
+ * @param[in] count   Number of values.
+ */
+static void
+redis_unindex (struct kb_redis *kbr, const char *name, const char **values,
+               size_t count)
+{
+  redisReply *rep;
+  size_t i;
+
+  if (!kbr->unique_index || count == 0)
+    return;
+
+  for (i = 0; i < count; i++)
+    redis_append (kbr->rctx, "SREM " KB_UNIQUE_INDEX_PREFIX "%s %s", name,
+                  values[i]);
+  for (i = 0; i < count; i++)
     {
-      redisAppendCommand (ctx, "LREM %s 1 %b", name, str, len);
-      redisAppendCommand (ctx, "%s %s %b", pos ? "LPUSH" : "RPUSH", name, str,
-                          len);
-      redisAppendCommand (ctx, "EXPIRE %s %d", name, expire);
-      /* Check LREM reply. */
-      redisGetReply (ctx, (void **) &rep);
-      if (rep && rep->type == REDIS_REPLY_INTEGER && rep->integer == 1)
-        g_debug ("Key '%s' already contained string '%s'", name, str);
-      freeReplyObject (rep);
-      /* Check PUSH reply. */
-      redisGetReply (ctx, (void **) &rep);
-      if (rep == NULL || rep->type == REDIS_REPLY_ERROR)
-        {
-          rc = -1;
-          goto out;
-        }
-      /* Check EXPIRE reply. */
-      redisGetReply (ctx, (void **) &rep);
-      if (rep == NULL || rep->type == REDIS_REPLY_ERROR
-          || (rep && rep->type == REDIS_REPLY_INTEGER && rep->integer != 1))
+      if (redis_get_reply (kbr->rctx, &rep) != REDIS_OK)
         {
-          g_warning ("%s: Not able to set expire", __func__);
-          rc = -1;
-          goto out;
+          redis_lnk_reset ((kb_t) kbr);
+          return;
         }
+      freeReplyObject (rep);
     }
-
-out:
-  if (rep != NULL)
-    freeReplyObject (rep);
-
-  return rc;
 }
 
 /**
- * @brief Insert (append) a new unique entry under a given name.
+ * @brief Pops a single KB string item.
  *
- * @param[in] kb  KB handle where to store the item.
- * @param[in] name  Item name.
- * @param[in] str  Item value.
- * @param[in] len  Value length. Used for blobs.
- * @param[in] pos  Which position the value is appended to. 0 for right,
- *                 1 for left position in the list.
+ * @param[in] kb  KB handle where to fetch the item.
+ * @param[in] name  Name of the key from where to retrieve.
  *
- * @return 0 on success, non-null on error.
+ * @return A string to be freed or NULL if list is empty or on error.
  */
-static int
-redis_add_str_unique (kb_t kb, const char *name, const char *str, size_t len,
-                      int pos)
+static char *
+redis_pop_str (kb_t kb, const char *name)
 {
   struct kb_redis *kbr;
-  redisReply *rep = NULL;
-  int rc = 0;
-  redisContext *ctx;
+  redisReply *rep;
+  char *value = NULL;
 
   kbr = redis_kb (kb);
-  if (get_redis_ctx (kbr) < 0)
-    return -1;
-  ctx = kbr->rctx;
-
-  /* Some VTs still rely on values being unique (ie. a value inserted multiple
-   * times, will only be present once.)
-   * Once these are fixed, the LREM becomes redundant and should be removed.
-   */
-  if (len == 0)
-    {
-      redisAppendCommand (ctx, "LREM %s 1 %s", name, str);
-      redisAppendCommand (ctx, "%s %s %s", pos ? "LPUSH" : "RPUSH", name, str);
-      redisGetReply (ctx, (void **) &rep);
-      if (rep && rep->type == REDIS_REPLY_INTEGER && rep->integer == 1)
-        g_debug ("Key '%s' already contained value '%s'", name, str);
-      freeReplyObject (rep);
-      redisGetReply (ctx, (void **) &rep);
-    }
-  else
-    {
-      redisAppendCommand (ctx, "LREM %s 1 %b", name, str, len);
-      redisAppendCommand (ctx, "%s %s %b", pos ? "LPUSH" : "RPUSH", name, str,
-                          len);
-      redisGetReply (ctx, (void **) &rep);
-      if (rep && rep->type == REDIS_REPLY_INTEGER && rep->integer == 1)
-        g_debug ("Key '%s' already contained string '%s'", name, str);
-      freeReplyObject (rep);
-      redisGetReply (ctx, (void **) &rep);
-    }
-  if (rep == NULL || rep->type == REDIS_REPLY_ERROR)
-    rc = -1;
+  rep = redis_cmd (kbr, "RPOP %s", name);
+  if (!rep)
+    return NULL;
 
-  if (rep != NULL)
-    freeReplyObject (rep);
+  if (rep->type == REDIS_REPLY_STRING)
+    value = g_strdup (rep->str);
+  freeReplyObject (rep);
+  redis_unindex (kbr, name, (const char **) &value, value ? 1 : 0);
 
-  return rc;
+  return value;
 }
 
 /**
- * @brief Insert (append) a new entry under a given name.
+ * @brief Pop a single KB string item, waiting for one if there is none.
  *
- * @param[in] kb  KB handle where to store the item.
- * @param[in] name  Item name.
- * @param[in] str  Item value.
- * @param[in] len  Value length. Used for blobs.
+ * @param[in] kb       KB handle where to fetch the item.
+ * @param[in] name     Name of the element to retrieve.
+ * @param[in] timeout  Seconds to wait at most, 0 to wait forever.
  *
- * @return 0 on success, non-null on error.
+ * @return The string to be freed with g_free, NULL on timeout or error.
  */
-static int
-redis_add_str (kb_t kb, const char *name, const char *str, size_t len)
+static char *
+redis_pop_str_blocking (kb_t kb, const char *name, int timeout)
 {
   struct kb_redis *kbr;
   redisReply *rep;
-  int rc = 0;
+  char *value = NULL;
 
   kbr = redis_kb (kb);
-  if (len == 0)
-    rep = redis_cmd (kbr, "RPUSH %s %s", name, str);
-  else
-    rep = redis_cmd (kbr, "RPUSH %s %b", name, str, len);
-  if (!rep || rep->type == REDIS_REPLY_ERROR)
-    rc = -1;
+  rep = redis_cmd (kbr, "BRPOP %s %d", name, MAX (timeout, 0));
+  if (!rep)
+    return NULL;
 
-  if (rep)
-    freeReplyObject (rep);
-  return rc;
+  /* Reply is the name and the value, or nil on timeout. */
+  if (rep->type == REDIS_REPLY_ARRAY && rep->elements == 2
+      && rep->element[1]->type == REDIS_REPLY_STRING)
+    value = g_strdup (rep->element[1]->str);
+  freeReplyObject (rep);
+  redis_unindex (kbr, name, (const char **) &value, value ? 1 : 0);
+
+  return value;
 }
 
 /**
- * @brief Set (replace) a new entry under a given name.
+ * @brief Pop several KB string items at once.
  *
- * @param[in] kb  KB handle where to store the item.
- * @param[in] name  Item name.
- * @param[in] val  Item value.
- * @param[in] len  Value length. Used for blobs.
+ * @param[in]  kb      KB handle where to fetch the items.
+ * @param[in]  name    Name of the elements to retrieve.
+ * @param[in]  count   Maximum number of items to pop.
+ * @param[out] values  The strings to be freed with g_free, at least count.
  *
- * @return 0 on success, non-null on error.
+ * @return Number of popped items, -1 on error.
  */
 static int
-redis_set_str (kb_t kb, const char *name, const char *val, size_t len)
+redis_pop_str_many (kb_t kb, const char *name, size_t count, char **values)
 {
   struct kb_redis *kbr;
-  redisReply *rep = NULL;
-  redisContext *ctx;
-  int rc = 0, i = 4;
+  redisReply *rep = NULL, *range;
+  int i, n = 0;
 
-  kbr = redis_kb (kb);
+  if (count == 0)
+    return 0;
+  count = MIN (count, G_MAXINT / 2);
+
+  kbr = redis_kb (kb);
+  if (get_redis_ctx (kbr) < 0)
+    return -1;
+
+  /* RPOP with a count needs redis 6.2, a transaction works with all
+   * versions. */
+  redis_append (kbr->rctx, "MULTI");
+  redis_append (kbr->rctx, "LRANGE %s %d -1", name, -(int) count);
+  redis_append (kbr->rctx, "LTRIM %s 0 %d", name, -(int) count - 1);
+  redis_append (kbr->rctx, "EXEC");
+  for (i = 0; i < 4; i++)
+    {
+      if (rep)
+        freeReplyObject (rep);
+      rep = NULL;
+      if (redis_get_reply (kbr->rctx, &rep) != REDIS_OK)
+        {
+          g_log (G_LOG_DOMAIN, G_LOG_LEVEL_CRITICAL,
+                 "%s: redis connection error: %s", __func__,
+                 kbr->rctx->errstr);
+          redis_lnk_reset (kb);
+          return -1;
+        }
+    }
+
+  /* Reply of EXEC holds the replies of LRANGE and LTRIM. */
+  if (rep->type != REDIS_REPLY_ARRAY || rep->elements != 2
+      || rep->element[0]->type != REDIS_REPLY_ARRAY)
+    {
+      freeReplyObject (rep);
+      return -1;
+    }
+  range = rep->element[0];
+  /* RPOP pops the last element first. */
+  for (i = range->elements - 1; i >= 0; i--)
+    if (range->element[i]->type == REDIS_REPLY_STRING)
+      values[n++] = g_strdup (range->element[i]->str);
+  freeReplyObject (rep);
+  redis_unindex (kbr, name, (const char **) values, n);
+
+  return n;
+}
+
+/**
+ * @brief Get a single KB integer item.
+ *
+ * @param[in] kb  KB handle where to fetch the item.
+ * @param[in] name  Name of the element to retrieve.
+ *
+ * @return An integer.
+ */
+static int
+redis_get_int (kb_t kb, const char *name)
+{
+  struct kb_item *kbi;
+
+  kbi = redis_get_single (kb, name, KB_TYPE_INT);
+  if (kbi != NULL)
+    {
+      int res;
+
+      res = kbi->v_int;
+      kb_item_free (kbi);
+      return res;
+    }
+  return -1;
+}
+
+/**
+ * @brief Encode the fields of a nvt in the order of enum kb_nvt_pos.
+ *
+ * @param[in]  nvt       nvt to encode.
+ * @param[in]  filename  Path to nvt.
+ * @param[out] fields    Fields, up to NVT_NAME_POS.
+ * @param[out] alloc     Fields to free with g_free.
+ */
+static void
+nvt_fields (const nvti_t *nvt, const char *filename, const char **fields,
+            gchar **alloc)
+{
+  nvti_refs_split_str (nvt, &alloc[0], &alloc[1], &alloc[2]);
+  alloc[3] = g_strdup_printf ("%d", nvti_category (nvt));
+  fields[NVT_FILENAME_POS] = filename;
+  fields[NVT_REQUIRED_KEYS_POS] = nvti_required_keys (nvt);
+  fields[NVT_MANDATORY_KEYS_POS] = nvti_mandatory_keys (nvt);
+  fields[NVT_EXCLUDED_KEYS_POS] = nvti_excluded_keys (nvt);
+  fields[NVT_REQUIRED_UDP_PORTS_POS] = nvti_required_udp_ports (nvt);
+  fields[NVT_REQUIRED_PORTS_POS] = nvti_required_ports (nvt);
+  fields[NVT_DEPENDENCIES_POS] = nvti_dependencies (nvt);
+  fields[NVT_TAGS_POS] = nvti_tag (nvt);
+  fields[NVT_CVES_POS] = alloc[0];
+  fields[NVT_BIDS_POS] = alloc[1];
+  fields[NVT_XREFS_POS] = alloc[2];
+  fields[NVT_CATEGORY_POS] = alloc[3];
+  fields[NVT_FAMILY_POS] = nvti_family (nvt);
+  fields[NVT_NAME_POS] = nvti_name (nvt);
+}
+
+/**
+ * @brief Build a nvti from its fields in the order of enum kb_nvt_pos.
+ *
+ * @param[in] oid     OID of the nvt.
+ * @param[in] fields  Fields, up to NVT_NAME_POS.
+ *
+ * @return nvti_t of NVT.
+ */
+static nvti_t *
+nvt_from_fields (const char *oid, const char **fields)
+{
+  nvti_t *nvti = nvti_new ();
+
+  nvti_set_oid (nvti, oid);
+  nvti_set_required_keys (nvti, fields[NVT_REQUIRED_KEYS_POS]);
+  nvti_set_mandatory_keys (nvti, fields[NVT_MANDATORY_KEYS_POS]);
+  nvti_set_excluded_keys (nvti, fields[NVT_EXCLUDED_KEYS_POS]);
+  nvti_set_required_udp_ports (nvti, fields[NVT_REQUIRED_UDP_PORTS_POS]);
+  nvti_set_required_ports (nvti, fields[NVT_REQUIRED_PORTS_POS]);
+  nvti_set_dependencies (nvti, fields[NVT_DEPENDENCIES_POS]);
+  nvti_set_tag (nvti, fields[NVT_TAGS_POS]);
+  nvti_add_refs (nvti, "cve", fields[NVT_CVES_POS], "");
+  nvti_add_refs (nvti, "bid", fields[NVT_BIDS_POS], "");
+  nvti_add_refs (nvti, NULL, fields[NVT_XREFS_POS], "");
+  nvti_set_category (nvti, atoi (fields[NVT_CATEGORY_POS]));
+  nvti_set_family (nvti, fields[NVT_FAMILY_POS]);
+  nvti_set_name (nvti, fields[NVT_NAME_POS]);
+
+  return nvti;
+}
+
+/* Compact encoding of nvts.
+ *
+ * A nvt is stored as a single string under nvt:<oid>:
+ * - KB_NVT_BLOB_MAGIC and the version byte,
+ * - the number of fields, then the fields in the order of enum kb_nvt_pos,
+ *   followed by the score of the severity vector (empty if none),
+ * - the number of prefs, then for each pref its id, name, type and default.
+ *
+ * Numbers are 32 bits little endian. Strings are prefixed by their length
+ * and followed by a NUL byte, so that they are used in place when decoding.
+ */
+
+/**
+ * @brief Magic prefix of the compact encoding of nvts.
+ */
+#define KB_NVT_BLOB_MAGIC "GVT"
+
+/**
+ * @brief Version of the compact encoding of nvts.
+ */
+#define KB_NVT_BLOB_VERSION 1
+
+/**
+ * @brief Position of the score of the severity vector in the compact
+ *        encoding, after the fields of enum kb_nvt_pos.
+ */
+#define KB_NVT_BLOB_SEVERITY_POS (NVT_NAME_POS + 1)
+
+/**
+ * @brief Cursor over a nvt in the compact encoding.
+ */
+struct nvt_blob
+{
+  const char *data;     /**< Encoded nvt. */
+  size_t len;           /**< Length of the encoded nvt. */
+  size_t pos;           /**< Current position. */
+  const char *severity; /**< Score of the severity vector, NULL if absent. */
+};
+
+static void
+nvt_blob_put_u32 (GString *blob, guint32 value)
+{
+  value = GUINT32_TO_LE (value);
+  g_string_append_len (blob, (const char *) &value, sizeof (value));
+}
+
+static void
+nvt_blob_put_str (GString *blob, const char *str)
+{
+  size_t len;
+
+  if (str == NULL)
+    str = "";
+  len = strlen (str);
+  nvt_blob_put_u32 (blob, len);
+  /* Including the NUL byte. */
+  g_string_append_len (blob, str, len + 1);
+}
+
+/**
+ * @brief Encode a nvt in the compact encoding.
+ *
+ * @param[in] nvt       nvt to encode.
+ * @param[in] filename  Path to nvt.
+ *
+ * @return Encoded nvt, to be freed with g_string_free.
+ */
+static GString *
+nvt_blob_encode (const nvti_t *nvt, const char *filename)
+{
+  GString *blob = g_string_sized_new (2048);
+  const char *fields[NVT_NAME_POS + 1];
+  gchar *alloc[4];
+  unsigned int i;
+
+  nvt_fields (nvt, filename, fields, alloc);
+  g_string_append (blob, KB_NVT_BLOB_MAGIC);
+  g_string_append_c (blob, KB_NVT_BLOB_VERSION);
+  nvt_blob_put_u32 (blob, KB_NVT_BLOB_SEVERITY_POS + 1);
+  for (i = 0; i <= NVT_NAME_POS; i++)
+    nvt_blob_put_str (blob, fields[i]);
+  for (i = 0; i < G_N_ELEMENTS (alloc); i++)
+    g_free (alloc[i]);
+  if (nvti_severity_vector_score (nvt) >= 0)
+    {
+      gchar score[G_ASCII_DTOSTR_BUF_SIZE];
+
+      nvt_blob_put_str (
+        blob, g_ascii_dtostr (score, sizeof (score),
+                              nvti_severity_vector_score (nvt)));
+    }
+  else
+    nvt_blob_put_str (blob, "");
+
+  nvt_blob_put_u32 (blob, nvti_pref_len (nvt));
+  for (i = 0; i < nvti_pref_len (nvt); i++)
+    {
+      const nvtpref_t *pref = nvti_pref (nvt, i);
+
+      nvt_blob_put_u32 (blob, nvtpref_id (pref));
+      nvt_blob_put_str (blob, nvtpref_name (pref));
+      nvt_blob_put_str (blob, nvtpref_type (pref));
+      nvt_blob_put_str (blob, nvtpref_default (pref));
+    }
+
+  return blob;
+}
+
+static int
+nvt_blob_get_u32 (struct nvt_blob *blob, guint32 *value)
+{
+  if (blob->len - blob->pos < sizeof (*value))
+    return -1;
+  memcpy (value, blob->data + blob->pos, sizeof (*value));
+  *value = GUINT32_FROM_LE (*value);
+  blob->pos += sizeof (*value);
+  return 0;
+}
+
+static int
+nvt_blob_get_str (struct nvt_blob *blob, const char **str)
+{
+  guint32 len;
+
+  if (nvt_blob_get_u32 (blob, &len) || blob->len - blob->pos <= len
+      || blob->data[blob->pos + len] != '\0')
+    return -1;
+  *str = blob->data + blob->pos;
+  blob->pos += len + 1;
+  return 0;
+}
+
+/**
+ * @brief Decode the fields of a nvt in the compact encoding.
+ *
+ * @param[out] blob    Cursor, positioned at the prefs on success.
+ * @param[in]  data    Encoded nvt.
+ * @param[in]  len     Length of encoded nvt.
+ * @param[out] fields  Fields up to NVT_NAME_POS, pointing into data.
+ *
+ * @return 0 on success, -1 if data isn't a valid encoded nvt.
+ */
+static int
+nvt_blob_decode (struct nvt_blob *blob, const char *data, size_t len,
+                 const char **fields)
+{
+  guint32 count, i;
+
+  blob->data = data;
+  blob->len = len;
+  blob->severity = NULL;
+  /* Magic and version byte. */
+  blob->pos = sizeof (KB_NVT_BLOB_MAGIC);
+  if (len < blob->pos || memcmp (data, KB_NVT_BLOB_MAGIC, blob->pos - 1)
+      || data[blob->pos - 1] != KB_NVT_BLOB_VERSION)
+    return -1;
+  if (nvt_blob_get_u32 (blob, &count) || count < NVT_NAME_POS + 1)
+    return -1;
+  for (i = 0; i < count; i++)
+    {
+      const char *field;
+
+      if (nvt_blob_get_str (blob, &field))
+        return -1;
+      /* Fields added by later versions are skipped. */
+      if (i <= NVT_NAME_POS)
+        fields[i] = field;
+      else if (i == KB_NVT_BLOB_SEVERITY_POS && *field)
+        blob->severity = field;
+    }
+  return 0;
+}
+
+/**
+ * @brief Decode the prefs of a nvt in the compact encoding.
+ *
+ * @param[in]  blob  Cursor positioned at the prefs by nvt_blob_decode.
+ *
+ * @return List of nvtpref_t, in reverse order like redis_get_nvt_prefs.
+ */
+static GSList *
+nvt_blob_get_prefs (struct nvt_blob *blob)
+{
+  GSList *list = NULL;
+  guint32 count;
+
+  if (nvt_blob_get_u32 (blob, &count))
+    return NULL;
+  while (count--)
+    {
+      const char *name, *type, *dflt;
+      guint32 id;
+
+      if (nvt_blob_get_u32 (blob, &id) || nvt_blob_get_str (blob, &name)
+          || nvt_blob_get_str (blob, &type) || nvt_blob_get_str (blob, &dflt))
+        break;
+      list = g_slist_prepend (list, nvtpref_new ((int) id, name, type, dflt));
+    }
+  return list;
+}
+
+/**
+ * @brief Get a nvt, in the encoding it was last seen in.
+ *
+ * Falls back to the other encoding if the nvt is stored in it.
+ *
+ * @param[in] kbr    Subclass of struct kb where the nvt is stored.
+ * @param[in] oid    OID of the nvt.
+ * @param[in] start  First field to get in the list encoding.
+ * @param[in] end    Last field to get in the list encoding.
+ *
+ * @return Reply, a string for the compact encoding or an array for the list
+ *         encoding. NULL on error.
+ */
+static redisReply *
+redis_nvt_reply (struct kb_redis *kbr, const char *oid, int start, int end)
+{
+  redisReply *rep;
+  int tries;
+
+  for (tries = 0; tries < 2; tries++)
+    {
+      if (kbr->nvt_read_compact > 0)
+        rep = redis_cmd (kbr, "GET nvt:%s", oid);
+      else
+        rep = redis_cmd (kbr, "LRANGE nvt:%s %d %d", oid, start, end);
+      if (rep == NULL || rep->type != REDIS_REPLY_ERROR
+          || strncmp (rep->str, "WRONGTYPE", 9))
+        return rep;
+      /* Stored in the other encoding. */
+      freeReplyObject (rep);
+      kbr->nvt_read_compact = kbr->nvt_read_compact > 0 ? -1 : 1;
+    }
+  return NULL;
+}
+
+/**
+ * @brief Get a field of a NVT from a reply.
+ *
+ * @param[in] rep       Reply of redis_nvt_reply, or of LINDEX filename:<name>
+ *                      for the positions from NVT_TIMESTAMP_POS.
+ * @param[in] position  Position of field to get.
+ *
+ * @return Value of field, NULL otherwise.
+ */
+static char *
+redis_nvt_field_from_reply (redisReply *rep, enum kb_nvt_pos position)
+{
+  if (rep->type == REDIS_REPLY_INTEGER)
+    return g_strdup_printf ("%lld", rep->integer);
+  if (rep->type == REDIS_REPLY_STRING && position >= NVT_TIMESTAMP_POS)
+    return g_strdup (rep->str);
+  if (rep->type == REDIS_REPLY_STRING)
+    {
+      struct nvt_blob blob;
+      const char *fields[NVT_NAME_POS + 1];
+
+      if (nvt_blob_decode (&blob, rep->str, rep->len, fields) == 0)
+        return g_strdup (fields[position]);
+    }
+  else if (rep->type == REDIS_REPLY_ARRAY && rep->elements == 1
+           && rep->element[0]->type == REDIS_REPLY_STRING)
+    return g_strdup (rep->element[0]->str);
+  return NULL;
+}
+
+/**
+ * @brief Get field of a NVT.
+ *
+ * @param[in] kb        KB handle where to store the nvt.
+ * @param[in] oid       OID of NVT to get from.
+ * @param[in] position  Position of field to get.
+ *
+ * @return Value of field, NULL otherwise.
+ */
+static char *
+redis_get_nvt (kb_t kb, const char *oid, enum kb_nvt_pos position)
+{
+  struct kb_redis *kbr;
+  redisReply *rep;
+  char *res;
+
+  kbr = redis_kb (kb);
+  if (position >= NVT_TIMESTAMP_POS)
+    rep = redis_cmd (kbr, "LINDEX filename:%s %d", oid,
+                     position - NVT_TIMESTAMP_POS);
+  else
+    rep = redis_nvt_reply (kbr, oid, position, position);
+  if (!rep)
+    return NULL;
+  res = redis_nvt_field_from_reply (rep, position);
+  freeReplyObject (rep);
+
+  return res;
+}
+
+/**
+ * @brief Get a field of several NVTs at once.
+ *
+ * The requests of all nvts are pipelined.
+ *
+ * @param[in]  kb        KB handle where the nvts are stored.
+ * @param[in]  oids      OIDs of the nvts, or filenames for the positions
+ *                       from NVT_TIMESTAMP_POS.
+ * @param[in]  count     Number of OIDs.
+ * @param[in]  position  Position of field to get.
+ * @param[out] values    Array of count elements where to store the values,
+ *                       to be freed. NULL for nvts not found.
+ *
+ * @return Number of values found, -1 on error.
+ */
+static int
+redis_get_nvt_field_many (kb_t kb, const char **oids, size_t count,
+                          enum kb_nvt_pos position, char **values)
+{
+  struct kb_redis *kbr;
+  size_t i;
+  int found = 0, tries;
+
+  for (i = 0; i < count; i++)
+    values[i] = NULL;
+  if (count == 0)
+    return 0;
+
+  kbr = redis_kb (kb);
+  if (get_redis_ctx (kbr) < 0)
+    return -1;
+
+  /* Nvts stored in the other encoding are read again once. */
+  for (tries = 0; tries < 2; tries++)
+    {
+      int compact = kbr->nvt_read_compact > 0, wrongtype = 0;
+
+      for (i = 0; i < count; i++)
+        {
+          if (values[i])
+            continue;
+          if (position >= NVT_TIMESTAMP_POS)
+            redis_append (kbr->rctx, "LINDEX filename:%s %d", oids[i],
+                          position - NVT_TIMESTAMP_POS);
+          else if (compact)
+            redis_append (kbr->rctx, "GET nvt:%s", oids[i]);
+          else
+            redis_append (kbr->rctx, "LRANGE nvt:%s %d %d", oids[i], position,
+                          position);
+        }
+
+      for (i = 0; i < count; i++)
+        {
+          redisReply *rep = NULL;
+
+          if (values[i])
+            continue;
+          if (redis_get_reply (kbr->rctx, &rep) != REDIS_OK)
+            {
+              g_log (G_LOG_DOMAIN, G_LOG_LEVEL_CRITICAL,
+                     "%s: redis connection error: %s", __func__,
+                     kbr->rctx->errstr);
+              redis_lnk_reset (kb);
+              for (i = 0; i < count; i++)
+                {
+                  g_free (values[i]);
+                  values[i] = NULL;
+                }
+              return -1;
+            }
+          if (rep->type == REDIS_REPLY_ERROR
+              && !strncmp (rep->str, "WRONGTYPE", 9))
+            wrongtype = 1;
+          else if ((values[i] = redis_nvt_field_from_reply (rep, position)))
+            found++;
+          freeReplyObject (rep);
+        }
+
+      if (!wrongtype || position >= NVT_TIMESTAMP_POS)
+        break;
+      /* Stored in the other encoding. */
+      kbr->nvt_read_compact = compact ? -1 : 1;
+    }
+
+  return found;
+}
+
+/**
+ * @brief Build a nvti from a reply of redis_nvt_reply.
+ *
+ * For nvts in the compact encoding, the prefs are included.
+ *
+ * @param[in] oid  OID of the nvt.
+ * @param[in] rep  Reply, for all fields in the list encoding.
+ *
+ * @return nvti_t of NVT, NULL otherwise.
+ */
+static nvti_t *
+redis_nvt_from_reply (const char *oid, redisReply *rep)
+{
+  const char *fields[NVT_NAME_POS + 1];
+  nvti_t *nvti = NULL;
+
+  if (rep->type == REDIS_REPLY_STRING)
+    {
+      struct nvt_blob blob;
+
+      if (nvt_blob_decode (&blob, rep->str, rep->len, fields) == 0)
+        {
+          GSList *prefs, *pref;
+
+          nvti = nvt_from_fields (oid, fields);
+          /* The score was computed when the nvt was stored. */
+          if (blob.severity)
+            nvti_set_severity_vector_score (
+              nvti, g_ascii_strtod (blob.severity, NULL));
+          prefs = g_slist_reverse (nvt_blob_get_prefs (&blob));
+          for (pref = prefs; pref; pref = pref->next)
+            nvti_add_pref (nvti, pref->data);
+          g_slist_free (prefs);
+        }
+    }
+  else if (rep->type == REDIS_REPLY_ARRAY && rep->elements == NVT_NAME_POS + 1)
+    {
+      unsigned int i;
+
+      for (i = 0; i <= NVT_NAME_POS; i++)
+        fields[i] = rep->element[i]->str;
+      nvti = nvt_from_fields (oid, fields);
+    }
+
+  return nvti;
+}
+
+/**
+ * @brief Parse a pref of a nvt stored in the list encoding.
+ *
+ * @param[in] str  Pref as stored under oid:<oid>:prefs.
+ *
+ * @return The pref, NULL if str isn't a valid pref.
+ */
+static nvtpref_t *
+nvt_pref_parse (const char *str)
+{
+  nvtpref_t *pref = NULL;
+  char **array;
+
+  array = g_strsplit (str, "|||", -1);
+  if (g_strv_length (array) == 4)
+    pref = nvtpref_new (atoi (array[0]), array[1], array[2], array[3]);
+  g_strfreev (array);
+  return pref;
+}
+
+/**
+ * @brief Get a full NVT.
+ *
+ * For nvts in the compact encoding, the prefs are included.
+ *
+ * @param[in] kb        KB handle where to store the nvt.
+ * @param[in] oid       OID of NVT to get.
+ *
+ * @return nvti_t of NVT, NULL otherwise.
+ */
+static nvti_t *
+redis_get_nvt_all (kb_t kb, const char *oid)
+{
+  redisReply *rep;
+  nvti_t *nvti;
+
+  rep = redis_nvt_reply (redis_kb (kb), oid, NVT_FILENAME_POS, NVT_NAME_POS);
+  if (!rep)
+    return NULL;
+  nvti = redis_nvt_from_reply (oid, rep);
+  freeReplyObject (rep);
+
+  return nvti;
+}
+
+/**
+ * @brief Get several full NVTs, including their prefs, at once.
+ *
+ * The requests of all nvts are pipelined: a single GET per nvt in the
+ * compact encoding, the fields and the prefs list in the list encoding.
+ *
+ * @param[in]  kb     KB handle where the nvts are stored.
+ * @param[in]  oids   OIDs of the nvts to get.
+ * @param[in]  count  Number of OIDs.
+ * @param[out] nvtis  Array of count elements where to store the nvts, to be
+ *                    freed with nvti_free(). NULL for OIDs not found.
+ *
+ * @return Number of nvts found, -1 on error.
+ */
+static int
+redis_get_nvt_many (kb_t kb, const char **oids, size_t count, nvti_t **nvtis)
+{
+  struct kb_redis *kbr;
+  size_t i;
+  int found = 0, tries;
+
+  for (i = 0; i < count; i++)
+    nvtis[i] = NULL;
+  if (count == 0)
+    return 0;
+
+  kbr = redis_kb (kb);
   if (get_redis_ctx (kbr) < 0)
     return -1;
-  ctx = kbr->rctx;
-  redisAppendCommand (ctx, "MULTI");
-  redisAppendCommand (ctx, "DEL %s", name);
-  if (len == 0)
-    redisAppendCommand (ctx, "RPUSH %s %s", name, val);
-  else
-    redisAppendCommand (ctx, "RPUSH %s %b", name, val, len);
-  redisAppendCommand (ctx, "EXEC");
-  while (i--)
+
+  /* Nvts stored in the other encoding are read again once. */
+  for (tries = 0; tries < 2; tries++)
     {
-      redisGetReply (ctx, (void **) &rep);
-      if (!rep || rep->type == REDIS_REPLY_ERROR)
-        rc = -1;
+      int compact = kbr->nvt_read_compact > 0, wrongtype = 0;
+
+      for (i = 0; i < count; i++)
+        {
+          if (nvtis[i])
+            continue;
+          if (compact)
+            redis_append (kbr->rctx, "GET nvt:%s", oids[i]);
+          else
+            {
+              redis_append (kbr->rctx, "LRANGE nvt:%s %d %d", oids[i],
+                            NVT_FILENAME_POS, NVT_NAME_POS);
+              redis_append (kbr->rctx, "LRANGE oid:%s:prefs 0 -1", oids[i]);
+            }
+        }
+
+      for (i = 0; i < count; i++)
+        {
+          redisReply *rep = NULL, *prefs = NULL;
+
+          if (nvtis[i])
+            continue;
+          if (redis_get_reply (kbr->rctx, &rep) != REDIS_OK
+              || (!compact && redis_get_reply (kbr->rctx, &prefs) != REDIS_OK))
+            {
+              g_log (G_LOG_DOMAIN, G_LOG_LEVEL_CRITICAL,
+                     "%s: redis connection error: %s", __func__,
+                     kbr->rctx->errstr);
+              if (rep)
+                freeReplyObject (rep);
+              redis_lnk_reset (kb);
+              for (i = 0; i < count; i++)
+                {
+                  nvti_free (nvtis[i]);
+                  nvtis[i] = NULL;
+                }
+              return -1;
+            }
+          if (rep->type == REDIS_REPLY_ERROR
+              && !strncmp (rep->str, "WRONGTYPE", 9))
+            wrongtype = 1;
+          else if ((nvtis[i] = redis_nvt_from_reply (oids[i], rep)))
+            {
+              found++;
+              if (prefs && prefs->type == REDIS_REPLY_ARRAY)
+                {
+                  size_t j;
+
+                  for (j = 0; j < prefs->elements; j++)
+                    {
+                      nvtpref_t *pref = NULL;
+
+                      if (prefs->element[j]->type == REDIS_REPLY_STRING)
+                        pref = nvt_pref_parse (prefs->element[j]->str);
+                      if (pref)
+                        nvti_add_pref (nvtis[i], pref);
+                    }
+                }
+            }
+          freeReplyObject (rep);
+          if (prefs)
+            freeReplyObject (prefs);
+        }
+
+      if (!wrongtype)
+        break;
+      /* Stored in the other encoding. */
+      kbr->nvt_read_compact = compact ? -1 : 1;
+    }
+
+  return found;
+}
+
+/**
+ * @brief Get the prefs of a NVT.
+ *
+ * @param[in] kb        KB handle where the nvt is stored.
+ * @param[in] oid       OID of NVT to get the prefs of.
+ *
+ * @return List of nvtpref_t, the last stored one first. NULL if none.
+ */
+static GSList *
+redis_get_nvt_prefs (kb_t kb, const char *oid)
+{
+  struct kb_redis *kbr;
+  redisReply *rep;
+  GSList *list = NULL;
+  size_t i;
+
+  kbr = redis_kb (kb);
+  if (kbr->nvt_read_compact == 0)
+    {
+      /* Find the encoding the cache uses. */
+      rep = redis_cmd (kbr, "TYPE nvt:%s", oid);
+      if (rep && rep->type == REDIS_REPLY_STATUS)
+        {
+          if (!strcmp (rep->str, "string"))
+            kbr->nvt_read_compact = 1;
+          else if (!strcmp (rep->str, "list"))
+            kbr->nvt_read_compact = -1;
+        }
+      if (rep)
+        freeReplyObject (rep);
+    }
+
+  if (kbr->nvt_read_compact > 0)
+    {
+      rep = redis_nvt_reply (kbr, oid, 0, 0);
+      if (rep && rep->type == REDIS_REPLY_STRING)
+        {
+          struct nvt_blob blob;
+          const char *fields[NVT_NAME_POS + 1];
+
+          if (nvt_blob_decode (&blob, rep->str, rep->len, fields) == 0)
+            list = nvt_blob_get_prefs (&blob);
+          freeReplyObject (rep);
+          return list;
+        }
       if (rep)
         freeReplyObject (rep);
+      /* Not found, or redis_nvt_reply switched to the list encoding. */
+      if (kbr->nvt_read_compact > 0)
+        return NULL;
+    }
+
+  rep = redis_cmd (kbr, "LRANGE oid:%s:prefs 0 -1", oid);
+  if (rep == NULL)
+    return NULL;
+  if (rep->type == REDIS_REPLY_ARRAY)
+    for (i = 0; i < rep->elements; i++)
+      {
+        nvtpref_t *pref = NULL;
+
+        if (rep->element[i]->type == REDIS_REPLY_STRING)
+          pref = nvt_pref_parse (rep->element[i]->str);
+        if (pref)
+          list = g_slist_prepend (list, pref);
+      }
+  freeReplyObject (rep);
+
+  return list;
+}
+
+/**
+ * @brief Select the encoding of the nvts stored by a KB handle.
+ *
+ * @param[in] kb      KB handle.
+ * @param[in] enable  1 for the compact encoding, 0 for the list encoding.
+ *
+ * @return 0 on success.
+ */
+static int
+redis_set_nvt_compact (kb_t kb, int enable)
+{
+  redis_kb (kb)->nvt_compact = !!enable;
+  redis_kb (kb)->nvt_read_compact = enable ? 1 : -1;
+  return 0;
+}
+
+/**
+ * @brief Get all items stored under a given name.
+ *
+ * @param[in] kb  KB handle where to fetch the items.
+ * @param[in] name  Name of the elements to retrieve.
+ *
+ * @return Linked struct kb_item instances to be freed with kb_item_free() or
+ *         NULL if no element was found or on error.
+ */
+static struct kb_item *
+redis_get_all (kb_t kb, const char *name)
+{
+  struct kb_redis *kbr;
+  struct kb_item *kbi;
+  redisReply *rep;
+
+  kbr = redis_kb (kb);
+
+  rep = redis_cmd (kbr, "LRANGE %s 0 -1", name);
+  if (rep == NULL)
+    return NULL;
+
+  kbi = redis2kbitem (name, rep);
+
+  freeReplyObject (rep);
+
+  return kbi;
+}
+
+/**
+ * @brief Iterate over all names matching a given pattern.
+ *
+ * Uses SCAN, so that the server isn't blocked for the whole iteration.
+ * Names returned more than once by SCAN are only passed once to the callback.
+ *
+ * @param[in] kb         KB handle where to look for the names.
+ * @param[in] pattern    '*' pattern of the names to iterate over.
+ * @param[in] cb         Callback called for each matching name.
+ * @param[in] user_data  User data passed to the callback.
+ *
+ * @return 0 when all names were iterated, 1 if the callback stopped the
+ *         iteration, -1 on error.
+ */
+static int
+redis_iterate_pattern (kb_t kb, const char *pattern, kb_pattern_cb cb,
+                       void *user_data)
+{
+  struct kb_redis *kbr;
+  GHashTable *seen;
+  char *cursor;
+  int rc = 0;
+
+  kbr = redis_kb (kb);
+  seen = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  cursor = g_strdup ("0");
+  do
+    {
+      redisReply *rep, *names;
+      size_t i;
+
+      rep = redis_cmd (kbr, "SCAN %s MATCH %s COUNT %d", cursor, pattern,
+                       KB_SCAN_COUNT);
+      g_free (cursor);
+      cursor = NULL;
+      if (rep == NULL || rep->type != REDIS_REPLY_ARRAY || rep->elements != 2
+          || rep->element[0]->type != REDIS_REPLY_STRING
+          || rep->element[1]->type != REDIS_REPLY_ARRAY)
+        {
+          if (rep != NULL)
+            freeReplyObject (rep);
+          rc = -1;
+          break;
+        }
+
+      cursor = g_strdup (rep->element[0]->str);
+      names = rep->element[1];
+      for (i = 0; i < names->elements && rc == 0; i++)
+        {
+          const char *name = names->element[i]->str;
+
+          if (names->element[i]->type != REDIS_REPLY_STRING
+              || g_hash_table_contains (seen, name))
+            continue;
+          g_hash_table_add (seen, g_strdup (name));
+          if (cb (name, user_data))
+            rc = 1;
+        }
+      freeReplyObject (rep);
+    }
+  while (rc == 0 && strcmp (cursor, "0"));
+
+  g_free (cursor);
+  g_hash_table_destroy (seen);
+  return rc;
+}
+
+/**
+ * @brief Add a name to an array. Callback for redis_iterate_pattern.
+ *
+ * @param[in] name   Name to add.
+ * @param[in] names  GPtrArray of names.
+ *
+ * @return 0 to continue the iteration.
+ */
+static int
+collect_name (const char *name, void *names)
+{
+  g_ptr_array_add ((GPtrArray *) names, g_strdup (name));
+  return 0;
+}
+
+/**
+ * @brief Get all items stored under a given pattern.
+ *
+ * @param[in] kb  KB handle where to fetch the items.
+ * @param[in] pattern  '*' pattern of the elements to retrieve.
+ *
+ * @return Linked struct kb_item instances to be freed with kb_item_free() or
+ *         NULL if no element was found or on error.
+ */
+static struct kb_item *
+redis_get_pattern (kb_t kb, const char *pattern)
+{
+  struct kb_redis *kbr;
+  struct kb_item *kbi = NULL;
+  GPtrArray *names;
+  unsigned int i;
+
+  kbr = redis_kb (kb);
+  names = g_ptr_array_new_with_free_func (g_free);
+  if (redis_iterate_pattern (kb, pattern, collect_name, names) < 0
+      || get_redis_ctx (kbr) < 0)
+    {
+      g_ptr_array_free (names, TRUE);
+      return NULL;
+    }
+
+  for (i = 0; i < names->len; i++)
+    redis_append (kbr->rctx, "LRANGE %s 0 -1",
+                  (char *) g_ptr_array_index (names, i));
+
+  for (i = 0; i < names->len; i++)
+    {
+      struct kb_item *tmp;
+      redisReply *rep_range = NULL;
+
+      if (redis_get_reply (kbr->rctx, &rep_range) != REDIS_OK)
+        {
+          /* The remaining replies are lost, the connection must not be
+           * used again. */
+          g_log (G_LOG_DOMAIN, G_LOG_LEVEL_CRITICAL,
+                 "%s: redis connection error: %s", __func__,
+                 kbr->rctx->errstr);
+          redis_lnk_reset (kb);
+          kb_item_free (kbi);
+          kbi = NULL;
+          break;
+        }
+      if (!rep_range)
+        continue;
+      tmp = redis2kbitem (g_ptr_array_index (names, i), rep_range);
+      if (!tmp)
+        {
+          freeReplyObject (rep_range);
+          continue;
+        }
+
+      if (kbi)
+        {
+          struct kb_item *tmp2;
+
+          tmp2 = tmp;
+          while (tmp->next)
+            tmp = tmp->next;
+          tmp->next = kbi;
+          kbi = tmp2;
+        }
+      else
+        kbi = tmp;
+      freeReplyObject (rep_range);
+    }
+
+  g_ptr_array_free (names, TRUE);
+  return kbi;
+}
+
+/**
+ * @brief Add the OID of a nvt:OID name to a list. Callback for
+ *        redis_iterate_pattern.
+ *
+ * @param[in] name  Name of the NVT key.
+ * @param[in] list  Pointer to the GSList of OIDs.
+ *
+ * @return 0 to continue the iteration.
+ */
+static int
+collect_oid (const char *name, void *list)
+{
+  /* Fetch OID values from key names nvt:OID. */
+  *(GSList **) list = g_slist_prepend (*(GSList **) list, g_strdup (name + 4));
+  return 0;
+}
+
+/**
+ * @brief Get all NVT OIDs.
+ *
+ * @param[in] kb  KB handle where to fetch the items.
+ *
+ * @return Linked list of all OIDs or NULL.
+ */
+static GSList *
+redis_get_oids (kb_t kb)
+{
+  GSList *list = NULL;
+
+  if (redis_iterate_pattern (kb, "nvt:*", collect_oid, &list) < 0)
+    {
+      g_slist_free_full (list, g_free);
+      return NULL;
     }
 
-  return rc;
+  return list;
+}
+
+/**
+ * @brief Count a name. Callback for redis_iterate_pattern.
+ *
+ * @param[in] name   Unused.
+ * @param[in] count  Pointer to the size_t counter.
+ *
+ * @return 0 to continue the iteration.
+ */
+static int
+count_name (const char *name, void *count)
+{
+  (void) name;
+  (*(size_t *) count)++;
+  return 0;
+}
+
+/**
+ * @brief Count all items stored under a given pattern.
+ *
+ * @param[in] kb  KB handle where to count the items.
+ * @param[in] pattern  '*' pattern of the elements to count.
+ *
+ * @return Count of items.
+ */
+static size_t
+redis_count (kb_t kb, const char *pattern)
+{
+  size_t count = 0;
+
+  if (redis_iterate_pattern (kb, pattern, count_name, &count) < 0)
+    return 0;
+
+  return count;
 }
 
 /**
- * @brief Insert (append) a new unique entry under a given name.
+ * @brief Delete all entries under a given name.
  *
  * @param[in] kb  KB handle where to store the item.
  * @param[in] name  Item name.
- * @param[in] val  Item value.
- * @param[in] expire Item expire.
  *
  * @return 0 on success, non-null on error.
  */
 static int
-redis_add_int_unique_volatile (kb_t kb, const char *name, int val, int expire)
+redis_del_items (kb_t kb, const char *name)
 {
   struct kb_redis *kbr;
   redisReply *rep;
   int rc = 0;
-  redisContext *ctx;
 
   kbr = redis_kb (kb);
-  if (get_redis_ctx (kbr) < 0)
-    return -1;
-  ctx = kbr->rctx;
-  redisAppendCommand (ctx, "LREM %s 1 %d", name, val);
-  redisAppendCommand (ctx, "RPUSH %s %d", name, val);
-  redisAppendCommand (ctx, "EXPIRE %s %d", name, expire);
-  /* Check LREM reply. */
-  redisGetReply (ctx, (void **) &rep);
-  if (rep && rep->type == REDIS_REPLY_INTEGER && rep->integer == 1)
-    g_debug ("Key '%s' already contained integer '%d'", name, val);
-  freeReplyObject (rep);
-  /* Check PUSH reply. */
-  redisGetReply (ctx, (void **) &rep);
+
+  /* Let the server free large lists in the background, if supported. */
+  if (kbr->lazy_free >= 0)
+    {
+      rep = redis_cmd (kbr, "UNLINK %s " KB_UNIQUE_INDEX_PREFIX "%s", name,
+                       name);
+      if (rep && redis_unsupported (rep))
+        {
+          freeReplyObject (rep);
+          rep = NULL;
+          kbr->lazy_free = -1;
+        }
+      else if (rep && rep->type != REDIS_REPLY_ERROR)
+        kbr->lazy_free = 1;
+    }
+  if (kbr->lazy_free < 0)
+    rep = redis_cmd (kbr, "DEL %s " KB_UNIQUE_INDEX_PREFIX "%s", name, name);
   if (rep == NULL || rep->type == REDIS_REPLY_ERROR)
+    rc = -1;
+
+  if (rep != NULL)
+    freeReplyObject (rep);
+
+  return rc;
+}
+
+/**
+ * @brief Insert a unique value into a list with KB_SCRIPT_ADD_UNIQUE.
+ *
+ * @param[in] kbr     Subclass of struct kb where to store the item.
+ * @param[in] name    Item name.
+ * @param[in] str     Item value.
+ * @param[in] len     Value length.
+ * @param[in] pos     Which position the value is appended to. 0 for right,
+ *                    1 for left position in the list.
+ * @param[in] expire  Item expire, 0 for none.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+redis_add_unique (struct kb_redis *kbr, const char *name, const char *str,
+                  size_t len, int pos, int expire)
+{
+  redisReply *rep = NULL;
+  int rc = 0;
+
+  /* Some VTs still rely on values being unique (ie. a value inserted multiple
+   * times, will only be present once.)
+   * Once these are fixed, the unique insertion becomes redundant and should
+   * be removed.
+   */
+  rep = redis_cmd (kbr,
+                   "EVALSHA %s 2 %s " KB_UNIQUE_INDEX_PREFIX "%s %b %d %d %d",
+                   redis_add_unique_sha (), name, name, str, len, pos ? 1 : 0,
+                   expire, kbr->unique_index);
+  /* Script not cached (yet), e.g. first use or after a server restart. */
+  if (rep == NULL || (rep->type == REDIS_REPLY_ERROR
+                      && !strncmp (rep->str, "NOSCRIPT", 8)))
     {
-      rc = -1;
-      goto out;
+      if (rep)
+        freeReplyObject (rep);
+      rep = redis_cmd (kbr,
+                       "EVAL %s 2 %s " KB_UNIQUE_INDEX_PREFIX "%s %b %d %d %d",
+                       KB_SCRIPT_ADD_UNIQUE, name, name, str, len, pos ? 1 : 0,
+                       expire, kbr->unique_index);
     }
-  /* Check EXPIRE reply. */
-  redisGetReply (ctx, (void **) &rep);
-  if (rep == NULL || rep->type == REDIS_REPLY_ERROR
-      || (rep && rep->type == REDIS_REPLY_INTEGER && rep->integer != 1))
+
+  if (rep == NULL || rep->type == REDIS_REPLY_ERROR)
     {
-      g_warning ("%s: Not able to set expire", __func__);
+      if (rep && expire)
+        g_warning ("%s: Not able to set expire", __func__);
       rc = -1;
-      goto out;
     }
+  else if (rep->type == REDIS_REPLY_INTEGER && rep->integer == 1)
+    g_debug ("Key '%s' already contained value '%.*s'", name, (int) len, str);
 
-out:
   if (rep != NULL)
     freeReplyObject (rep);
 
   return rc;
 }
 
+/**
+ * @brief Insert (append) a new unique and volatile entry under a given name.
+ *
+ * @param[in] kb  KB handle where to store the item.
+ * @param[in] name  Item name.
+ * @param[in] str  Item value.
+ * @param[in] expire Item expire.
+ * @param[in] len  Value length. Used for blobs.
+ * @param[in] pos  Which position the value is appended to. 0 for right,
+ *                 1 for left position in the list.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+redis_add_str_unique_volatile (kb_t kb, const char *name, const char *str,
+                               int expire, size_t len, int pos)
+{
+  if (str == NULL)
+    return -1;
+
+  return redis_add_unique (redis_kb (kb), name, str,
+                           len ? len : strlen (str), pos, expire);
+}
+
 /**
  * @brief Insert (append) a new unique entry under a given name.
  *
  * @param[in] kb  KB handle where to store the item.
  * @param[in] name  Item name.
- * @param[in] val  Item value.
+ * @param[in] str  Item value.
+ * @param[in] len  Value length. Used for blobs.
+ * @param[in] pos  Which position the value is appended to. 0 for right,
+ *                 1 for left position in the list.
  *
  * @return 0 on success, non-null on error.
  */
 static int
-redis_add_int_unique (kb_t kb, const char *name, int val)
+redis_add_str_unique (kb_t kb, const char *name, const char *str, size_t len,
+                      int pos)
+{
+  if (str == NULL)
+    return -1;
+
+  return redis_add_unique (redis_kb (kb), name, str,
+                           len ? len : strlen (str), pos, 0);
+}
+
+/**
+ * @brief Insert (append) a new entry under a given name.
+ *
+ * @param[in] kb  KB handle where to store the item.
+ * @param[in] name  Item name.
+ * @param[in] str  Item value.
+ * @param[in] len  Value length. Used for blobs.
+ *
+ * @return 0 on success, non-null on error.
+ */
+static int
+redis_add_str (kb_t kb, const char *name, const char *str, size_t len)
 {
   struct kb_redis *kbr;
   redisReply *rep;
   int rc = 0;
+
+  kbr = redis_kb (kb);
+  if (len == 0)
+    rep = redis_cmd (kbr, "RPUSH %s %s", name, str);
+  else
+    rep = redis_cmd (kbr, "RPUSH %s %b", name, str, len);
+  if (!rep || rep->type == REDIS_REPLY_ERROR)
+    rc = -1;
+
+  if (rep)
+    freeReplyObject (rep);
+  return rc;
+}
+
+/**
+ * @brief Set (replace) a new entry under a given name.
+ *
+ * @param[in] kb  KB handle where to store the item.
+ * @param[in] name  Item name.
+ * @param[in] val  Item value.
+ * @param[in] len  Value length. Used for blobs.
+ *
+ * @return 0 on success, non-null on error.
+ */
+static int
+redis_set_str (kb_t kb, const char *name, const char *val, size_t len)
+{
+  struct kb_redis *kbr;
+  redisReply *rep = NULL;
   redisContext *ctx;
+  int rc = 0, i = 4;
 
   kbr = redis_kb (kb);
   if (get_redis_ctx (kbr) < 0)
     return -1;
   ctx = kbr->rctx;
-  redisAppendCommand (ctx, "LREM %s 1 %d", name, val);
-  redisAppendCommand (ctx, "RPUSH %s %d", name, val);
-  redisGetReply (ctx, (void **) &rep);
-  if (rep && rep->type == REDIS_REPLY_INTEGER && rep->integer == 1)
-    g_debug ("Key '%s' already contained integer '%d'", name, val);
-  freeReplyObject (rep);
-  redisGetReply (ctx, (void **) &rep);
-  if (rep == NULL || rep->type == REDIS_REPLY_ERROR)
+  redis_append (ctx, "MULTI");
+  redis_append (ctx, "DEL %s " KB_UNIQUE_INDEX_PREFIX "%s", name, name);
+  if (len == 0)
+    redis_append (ctx, "RPUSH %s %s", name, val);
+  else
+    redis_append (ctx, "RPUSH %s %b", name, val, len);
+  redis_append (ctx, "EXEC");
+  while (i--)
     {
-      rc = -1;
-      goto out;
+      redis_get_reply (ctx, &rep);
+      if (!rep || rep->type == REDIS_REPLY_ERROR)
+        rc = -1;
+      if (rep)
+        freeReplyObject (rep);
     }
 
-out:
-  if (rep != NULL)
-    freeReplyObject (rep);
-
   return rc;
 }
 
+/**
+ * @brief Number of items set per pipeline by redis_set_str_many.
+ */
+#define KB_SET_MANY_CHUNK 1000
+
+/**
+ * @brief Set (replace) the entries of several names at once.
+ *
+ * The requests are pipelined by chunks of KB_SET_MANY_CHUNK items.
+ *
+ * @param[in] kb      KB handle where to store the items.
+ * @param[in] names   Item names.
+ * @param[in] values  Item values, same order as names.
+ * @param[in] count   Number of items.
+ *
+ * @return Number of items which could not be set, -1 on error.
+ */
+static int
+redis_set_str_many (kb_t kb, const char **names, const char **values,
+                    size_t count)
+{
+  struct kb_redis *kbr;
+  redisContext *ctx;
+  size_t start, i;
+  int failed = 0;
+
+  kbr = redis_kb (kb);
+  if (get_redis_ctx (kbr) < 0)
+    return -1;
+  ctx = kbr->rctx;
+
+  for (start = 0; start < count; start += KB_SET_MANY_CHUNK)
+    {
+      size_t end = MIN (start + KB_SET_MANY_CHUNK, count);
+
+      for (i = start; i < end; i++)
+        {
+          redis_append (ctx, "DEL %s " KB_UNIQUE_INDEX_PREFIX "%s", names[i],
+                        names[i]);
+          redis_append (ctx, "RPUSH %s %s", names[i], values[i]);
+        }
+      for (i = start; i < end; i++)
+        {
+          redisReply *del = NULL, *push = NULL;
+
+          if (redis_get_reply (ctx, &del) != REDIS_OK
+              || redis_get_reply (ctx, &push) != REDIS_OK)
+            {
+              g_log (G_LOG_DOMAIN, G_LOG_LEVEL_CRITICAL,
+                     "%s: redis connection error: %s", __func__, ctx->errstr);
+              if (del)
+                freeReplyObject (del);
+              redis_lnk_reset (kb);
+              return -1;
+            }
+          if (push->type == REDIS_REPLY_ERROR)
+            failed++;
+          freeReplyObject (del);
+          freeReplyObject (push);
+        }
+    }
+
+  return failed;
+}
+
+/**
+ * @brief Insert (append) a new unique entry under a given name.
+ *
+ * @param[in] kb  KB handle where to store the item.
+ * @param[in] name  Item name.
+ * @param[in] val  Item value.
+ * @param[in] expire Item expire.
+ *
+ * @return 0 on success, non-null on error.
+ */
+static int
+redis_add_int_unique_volatile (kb_t kb, const char *name, int val, int expire)
+{
+  char str[16];
+
+  g_snprintf (str, sizeof (str), "%d", val);
+  return redis_add_unique (redis_kb (kb), name, str, strlen (str), 0, expire);
+}
+
+/**
+ * @brief Insert (append) a new unique entry under a given name.
+ *
+ * @param[in] kb  KB handle where to store the item.
+ * @param[in] name  Item name.
+ * @param[in] val  Item value.
+ *
+ * @return 0 on success, non-null on error.
+ */
+static int
+redis_add_int_unique (kb_t kb, const char *name, int val)
+{
+  char str[16];
+
+  g_snprintf (str, sizeof (str), "%d", val);
+  return redis_add_unique (redis_kb (kb), name, str, strlen (str), 0, 0);
+}
+
+/**
+ * @brief Enable or disable the SET index for unique insertions.
+ *
+ * @param[in] kb      KB handle.
+ * @param[in] enable  1 to enable, 0 to disable.
+ *
+ * @return 0 on success.
+ */
+static int
+redis_set_unique_index (kb_t kb, int enable)
+{
+  redis_kb (kb)->unique_index = !!enable;
+  return 0;
+}
+
 /**
  * @brief Insert (append) a new entry under a given name.
  *
@@ -1575,13 +3704,13 @@ redis_set_int (kb_t kb, const char *name, int val)
   if (get_redis_ctx (redis_kb (kb)) < 0)
     return -1;
   ctx = kbr->rctx;
-  redisAppendCommand (ctx, "MULTI");
-  redisAppendCommand (ctx, "DEL %s", name);
-  redisAppendCommand (ctx, "RPUSH %s %d", name, val);
-  redisAppendCommand (ctx, "EXEC");
+  redis_append (ctx, "MULTI");
+  redis_append (ctx, "DEL %s " KB_UNIQUE_INDEX_PREFIX "%s", name, name);
+  redis_append (ctx, "RPUSH %s %d", name, val);
+  redis_append (ctx, "EXEC");
   while (i--)
     {
-      redisGetReply (ctx, (void **) &rep);
+      redis_get_reply (ctx, &rep);
       if (!rep || rep->type == REDIS_REPLY_ERROR)
         rc = -1;
       if (rep)
@@ -1591,6 +3720,44 @@ redis_set_int (kb_t kb, const char *name, int val)
   return rc;
 }
 
+/**
+ * @brief Insert a new nvt in the compact encoding.
+ *
+ * @param[in] kbr       Subclass of struct kb where to store the nvt.
+ * @param[in] nvt       nvt to store.
+ * @param[in] filename  Path to nvt to store.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+redis_add_nvt_compact (struct kb_redis *kbr, const nvti_t *nvt,
+                       const char *filename)
+{
+  redisReply *rep;
+  GString *blob;
+  int rc = 0;
+
+  blob = nvt_blob_encode (nvt, filename);
+  rep = redis_cmd (kbr, "SET nvt:%s %b", nvti_oid (nvt), blob->str,
+                   blob->len);
+  g_string_free (blob, TRUE);
+  if (!rep || rep->type == REDIS_REPLY_ERROR)
+    rc = -1;
+  if (rep)
+    freeReplyObject (rep);
+
+  rep = redis_cmd (kbr, "DEL oid:%s:prefs", nvti_oid (nvt));
+  if (rep)
+    freeReplyObject (rep);
+  rep = redis_cmd (kbr, "RPUSH filename:%s %lu %s", filename, time (NULL),
+                   nvti_oid (nvt));
+  if (!rep || rep->type == REDIS_REPLY_ERROR)
+    rc = -1;
+  if (rep)
+    freeReplyObject (rep);
+  return rc;
+}
+
 /**
  * @brief Insert a new nvt.
  *
@@ -1612,11 +3779,12 @@ redis_add_nvt (kb_t kb, const nvti_t *nvt, const char *filename)
   if (!nvt || !filename)
     return -1;
 
-  cves = nvti_refs (nvt, "cve", "", 0);
-  bids = nvti_refs (nvt, "bid", "", 0);
-  xrefs = nvti_refs (nvt, NULL, "cve,bid", 1);
-
   kbr = redis_kb (kb);
+  if (kbr->nvt_compact)
+    return redis_add_nvt_compact (kbr, nvt, filename);
+
+  nvti_refs_split_str (nvt, &cves, &bids, &xrefs);
+
   rep = redis_cmd (
     kbr, "RPUSH nvt:%s %s %s %s %s %s %s %s %s %s %s %s %d %s %s",
     nvti_oid (nvt), filename,
@@ -1660,6 +3828,465 @@ redis_add_nvt (kb_t kb, const nvti_t *nvt, const char *filename)
   return rc;
 }
 
+/**
+ * @brief Append the commands to store a nvt to the redis output buffer.
+ *
+ * The commands are wrapped in a MULTI/EXEC block, so that each nvt is stored
+ * atomically. Previous entries of the OID are removed first.
+ *
+ * @param[in] ctx           Redis context.
+ * @param[in] nvt           nvt to store.
+ * @param[in] filename      Path to nvt to store.
+ * @param[in] old_filename  Path the OID is currently stored with, or NULL.
+ * @param[in] compact       Whether to use the compact encoding.
+ *
+ * @return Number of appended commands.
+ */
+static int
+redis_append_nvt (redisContext *ctx, const nvti_t *nvt, const char *filename,
+                  const char *old_filename, int compact)
+{
+  unsigned int i;
+  int cmds = 0;
+  gchar *cves, *bids, *xrefs;
+
+  redis_append (ctx, "MULTI");
+  cmds++;
+  redis_append (ctx, "DEL nvt:%s oid:%s:prefs filename:%s",
+                nvti_oid (nvt), nvti_oid (nvt), filename);
+  cmds++;
+  if (old_filename && strcmp (old_filename, filename))
+    {
+      redis_append (ctx, "DEL filename:%s", old_filename);
+      cmds++;
+    }
+  if (compact)
+    {
+      GString *blob = nvt_blob_encode (nvt, filename);
+
+      redis_append (ctx, "SET nvt:%s %b", nvti_oid (nvt), blob->str,
+                    blob->len);
+      cmds++;
+      g_string_free (blob, TRUE);
+    }
+  else
+    {
+      nvti_refs_split_str (nvt, &cves, &bids, &xrefs);
+      redis_append (
+        ctx, "RPUSH nvt:%s %s %s %s %s %s %s %s %s %s %s %s %d %s %s",
+        nvti_oid (nvt), filename,
+        nvti_required_keys (nvt) ? nvti_required_keys (nvt) : "",
+        nvti_mandatory_keys (nvt) ? nvti_mandatory_keys (nvt) : "",
+        nvti_excluded_keys (nvt) ? nvti_excluded_keys (nvt) : "",
+        nvti_required_udp_ports (nvt) ? nvti_required_udp_ports (nvt) : "",
+        nvti_required_ports (nvt) ? nvti_required_ports (nvt) : "",
+        nvti_dependencies (nvt) ? nvti_dependencies (nvt) : "",
+        nvti_tag (nvt) ? nvti_tag (nvt) : "", cves ? cves : "",
+        bids ? bids : "", xrefs ? xrefs : "", nvti_category (nvt),
+        nvti_family (nvt), nvti_name (nvt));
+      cmds++;
+      g_free (cves);
+      g_free (bids);
+      g_free (xrefs);
+
+      for (i = 0; i < nvti_pref_len (nvt); i++)
+        {
+          const nvtpref_t *pref = nvti_pref (nvt, i);
+
+          redis_append (ctx, "RPUSH oid:%s:prefs %d|||%s|||%s|||%s",
+                        nvti_oid (nvt), nvtpref_id (pref), nvtpref_name (pref),
+                        nvtpref_type (pref), nvtpref_default (pref));
+          cmds++;
+        }
+    }
+  redis_append (ctx, "RPUSH filename:%s %lu %s", filename, time (NULL),
+                nvti_oid (nvt));
+  cmds++;
+  redis_append (ctx, "EXEC");
+  cmds++;
+
+  return cmds;
+}
+
+/**
+ * @brief Read the replies of a nvt stored with redis_append_nvt.
+ *
+ * @param[in]  ctx   Redis context.
+ * @param[in]  cmds  Number of commands appended for the nvt.
+ * @param[out] rc    0 if the nvt was stored, -1 otherwise.
+ *
+ * @return 0 on success, -1 on connection error.
+ */
+static int
+redis_read_nvt_replies (redisContext *ctx, int cmds, int *rc)
+{
+  *rc = 0;
+  while (cmds--)
+    {
+      redisReply *rep = NULL;
+
+      if (redis_get_reply (ctx, &rep) != REDIS_OK)
+        {
+          *rc = -1;
+          return -1;
+        }
+      if (rep->type == REDIS_REPLY_ERROR || rep->type == REDIS_REPLY_NIL)
+        *rc = -1;
+      /* Last reply is the one of EXEC. */
+      else if (cmds == 0 && rep->type == REDIS_REPLY_ARRAY)
+        {
+          size_t i;
+
+          for (i = 0; i < rep->elements; i++)
+            if (rep->element[i]->type == REDIS_REPLY_ERROR)
+              *rc = -1;
+        }
+      freeReplyObject (rep);
+    }
+
+  return 0;
+}
+
+/**
+ * @brief Insert a batch of nvts.
+ *
+ * The nvts are sent in pipelined chunks. For each chunk, the filenames the
+ * OIDs are currently stored with are fetched in one exchange, then every nvt
+ * is stored in its own MULTI/EXEC block.
+ *
+ * @param[in]  kb         KB handle where to store the nvts.
+ * @param[in]  nvts       Array of nvts to store.
+ * @param[in]  filenames  Array of paths of the nvts, same order as nvts.
+ * @param[in]  count      Number of elements in nvts and filenames.
+ * @param[in]  chunk      Number of nvts per chunk.
+ * @param[out] errors     Array of count elements for per nvt result. May be
+ *                        NULL.
+ *
+ * @return Number of nvts which could not be stored, -1 on connection error.
+ *         After a connection error, errors marks the nvts which were stored
+ *         before it.
+ */
+static int
+redis_add_nvt_batch (kb_t kb, const nvti_t **nvts, const char **filenames,
+                     size_t count, size_t chunk, int *errors)
+{
+  struct kb_redis *kbr;
+  redisContext *ctx;
+  char **old_filenames;
+  int *cmds;
+  size_t start, i = 0;
+  int failed = 0;
+
+  if (count == 0)
+    return 0;
+  if (!nvts || !filenames)
+    return -1;
+
+  kbr = redis_kb (kb);
+  if (get_redis_ctx (kbr) < 0)
+    {
+      for (; errors && i < count; i++)
+        errors[i] = -1;
+      return -1;
+    }
+  ctx = kbr->rctx;
+  if (chunk == 0)
+    chunk = KB_NVT_BATCH_CHUNK_DEFAULT;
+
+  cmds = g_malloc0 (chunk * sizeof (int));
+  old_filenames = g_malloc0 (chunk * sizeof (char *));
+
+  for (start = 0; start < count; start += chunk)
+    {
+      size_t end = MIN (start + chunk, count);
+
+      /* Get the filenames the OIDs are currently stored with. */
+      for (i = start; i < end; i++)
+        if (nvts[i] && filenames[i] && nvti_oid (nvts[i]))
+          {
+            if (kbr->nvt_compact)
+              redis_append (ctx, "GET nvt:%s", nvti_oid (nvts[i]));
+            else
+              redis_append (ctx, "LINDEX nvt:%s %d", nvti_oid (nvts[i]),
+                            NVT_FILENAME_POS);
+          }
+      for (i = start; i < end; i++)
+        {
+          redisReply *rep = NULL;
+
+          old_filenames[i - start] = NULL;
+          cmds[i - start] = 0;
+          if (!nvts[i] || !filenames[i] || !nvti_oid (nvts[i]))
+            continue;
+          if (redis_get_reply (ctx, &rep) != REDIS_OK)
+            {
+              /* Nothing of this chunk was stored yet. */
+              i = start;
+              goto conn_err;
+            }
+          if (rep->type == REDIS_REPLY_STRING && kbr->nvt_compact)
+            {
+              struct nvt_blob blob;
+              const char *fields[NVT_NAME_POS + 1];
+
+              if (nvt_blob_decode (&blob, rep->str, rep->len, fields) == 0)
+                old_filenames[i - start] =
+                  g_strdup (fields[NVT_FILENAME_POS]);
+            }
+          else if (rep->type == REDIS_REPLY_STRING)
+            old_filenames[i - start] = g_strdup (rep->str);
+          /* Still stored in the list encoding, its filename is read
+           * below. */
+          cmds[i - start] = kbr->nvt_compact
+                            && rep->type == REDIS_REPLY_ERROR
+                            && !strncmp (rep->str, "WRONGTYPE", 9);
+          freeReplyObject (rep);
+        }
+
+      /* The filenames of the nvts still stored in the list encoding. */
+      for (i = start; i < end; i++)
+        if (cmds[i - start])
+          redis_append (ctx, "LINDEX nvt:%s %d", nvti_oid (nvts[i]),
+                        NVT_FILENAME_POS);
+      for (i = start; i < end; i++)
+        {
+          redisReply *rep = NULL;
+
+          if (!cmds[i - start])
+            continue;
+          if (redis_get_reply (ctx, &rep) != REDIS_OK)
+            {
+              i = start;
+              goto conn_err;
+            }
+          if (rep->type == REDIS_REPLY_STRING)
+            old_filenames[i - start] = g_strdup (rep->str);
+          freeReplyObject (rep);
+        }
+
+      for (i = start; i < end; i++)
+        {
+          cmds[i - start] = 0;
+          if (!nvts[i] || !filenames[i] || !nvti_oid (nvts[i]))
+            continue;
+          if (old_filenames[i - start]
+              && strcmp (old_filenames[i - start], filenames[i]))
+            g_debug ("%s: NVT with OID %s moved from %s to %s", __func__,
+                     nvti_oid (nvts[i]), old_filenames[i - start],
+                     filenames[i]);
+          cmds[i - start] =
+            redis_append_nvt (ctx, nvts[i], filenames[i],
+                              old_filenames[i - start], kbr->nvt_compact);
+        }
+
+      for (i = start; i < end; i++)
+        {
+          int rc = -1;
+
+          g_free (old_filenames[i - start]);
+          old_filenames[i - start] = NULL;
+          if (cmds[i - start]
+              && redis_read_nvt_replies (ctx, cmds[i - start], &rc))
+            goto conn_err;
+          if (errors)
+            errors[i] = rc;
+          if (rc)
+            failed++;
+        }
+    }
+
+  g_free (cmds);
+  g_free (old_filenames);
+  return failed;
+
+conn_err:
+  g_log (G_LOG_DOMAIN, G_LOG_LEVEL_CRITICAL,
+         "%s: redis connection error while storing nvts: %s", __func__,
+         ctx->errstr);
+  for (start = 0; start < chunk; start++)
+    g_free (old_filenames[start]);
+  g_free (old_filenames);
+  g_free (cmds);
+  for (; errors && i < count; i++)
+    errors[i] = -1;
+  redis_lnk_reset (kb);
+  return -1;
+}
+
+/**
+ * @brief Channel of the invalidation messages of client-side caching.
+ */
+#define KB_INVALIDATE_CHANNEL "__redis__:invalidate"
+
+/**
+ * @brief Stop tracking the keys read through a KB handle.
+ *
+ * The tracking state belongs to the connections, so the data connection is
+ * closed, never handed to the pool.
+ *
+ * @param[in] kbr     Subclass of struct kb.
+ * @param[in] notify  Whether to tell the callback that invalidations may
+ *                    have been lost.
+ */
+static void
+redis_track_stop (struct kb_redis *kbr, int notify)
+{
+  kb_invalidate_cb cb = kbr->track_cb;
+
+  if (kbr->tctx == NULL)
+    return;
+  redisFree (kbr->tctx);
+  kbr->tctx = NULL;
+  kbr->track_cb = NULL;
+  if (kbr->rctx)
+    {
+      redisFree (kbr->rctx);
+      kbr->rctx = NULL;
+    }
+  if (notify && cb)
+    cb (NULL, kbr->track_data);
+}
+
+/**
+ * @brief Track the keys read through a KB handle, with Redis 6 client-side
+ *        caching.
+ *
+ * The data connection stays in RESP2: its invalidations are redirected to a
+ * second connection subscribed to KB_INVALIDATE_CHANNEL, which
+ * redis_track_poll reads.
+ *
+ * @param[in] kb    KB handle.
+ * @param[in] cb    Callback of the invalidations, NULL to stop tracking.
+ * @param[in] data  User data passed to the callback.
+ *
+ * @return 0 on success, -1 on error or if the server doesn't support it.
+ */
+static int
+redis_track (kb_t kb, kb_invalidate_cb cb, void *data)
+{
+  struct kb_redis *kbr = redis_kb (kb);
+  redisReply *rep;
+  long long id;
+
+  redis_track_stop (kbr, 0);
+  if (cb == NULL)
+    return 0;
+  if (get_redis_ctx (kbr) < 0)
+    return -1;
+
+  kbr->tctx = connect_redis (kbr->path, strlen (kbr->path));
+  if (kbr->tctx == NULL || kbr->tctx->err)
+    goto err;
+  rep = redisCommand (kbr->tctx, "CLIENT ID");
+  if (rep == NULL || rep->type != REDIS_REPLY_INTEGER)
+    goto err_reply;
+  id = rep->integer;
+  freeReplyObject (rep);
+  rep = redisCommand (kbr->tctx, "SUBSCRIBE " KB_INVALIDATE_CHANNEL);
+  if (rep == NULL || rep->type != REDIS_REPLY_ARRAY)
+    goto err_reply;
+  freeReplyObject (rep);
+
+  rep = redisCommand (kbr->rctx, "CLIENT TRACKING ON REDIRECT %lld", id);
+  if (rep == NULL || rep->type != REDIS_REPLY_STATUS)
+    goto err_reply;
+  freeReplyObject (rep);
+
+  kbr->track_cb = cb;
+  kbr->track_data = data;
+  return 0;
+
+err_reply:
+  if (rep != NULL)
+    {
+      g_debug ("%s: client-side caching not available: %s", __func__,
+               rep->type == REDIS_REPLY_ERROR ? rep->str : "unexpected reply");
+      freeReplyObject (rep);
+    }
+err:
+  if (kbr->tctx == NULL)
+    return -1;
+  kbr->track_cb = NULL;
+  redis_track_stop (kbr, 0);
+  return -1;
+}
+
+/**
+ * @brief Pass an invalidation message to the tracking callback.
+ *
+ * @param[in] kbr  Subclass of struct kb.
+ * @param[in] rep  Message, ["message", channel, keys or nil on a flush].
+ */
+static void
+redis_track_message (struct kb_redis *kbr, const redisReply *rep)
+{
+  const redisReply *keys;
+  size_t i;
+
+  if (rep->type != REDIS_REPLY_ARRAY || rep->elements != 3
+      || rep->element[0]->type != REDIS_REPLY_STRING
+      || strcmp (rep->element[0]->str, "message"))
+    return;
+
+  keys = rep->element[2];
+  if (keys->type != REDIS_REPLY_ARRAY)
+    {
+      kbr->track_cb (NULL, kbr->track_data);
+      return;
+    }
+  for (i = 0; i < keys->elements; i++)
+    if (keys->element[i]->type == REDIS_REPLY_STRING)
+      kbr->track_cb (keys->element[i]->str, kbr->track_data);
+}
+
+/**
+ * @brief Deliver the invalidations received so far, without waiting.
+ *
+ * @param[in] kb  KB handle.
+ *
+ * @return 0 on success, -1 if not tracking or the tracking was lost.
+ */
+static int
+redis_track_poll (kb_t kb)
+{
+  struct kb_redis *kbr = redis_kb (kb);
+  struct pollfd pfd;
+
+  if (kbr->tctx == NULL)
+    return -1;
+
+  pfd.fd = kbr->tctx->fd;
+  pfd.events = POLLIN;
+  while (poll (&pfd, 1, 0) > 0)
+    {
+      void *rep;
+
+      if (redisBufferRead (kbr->tctx) != REDIS_OK)
+        {
+          redis_track_stop (kbr, 1);
+          return -1;
+        }
+      do
+        {
+          rep = NULL;
+          if (redisGetReplyFromReader (kbr->tctx, &rep) != REDIS_OK)
+            {
+              redis_track_stop (kbr, 1);
+              return -1;
+            }
+          if (rep)
+            {
+              redis_track_message (kbr, rep);
+              freeReplyObject (rep);
+            }
+        }
+      while (rep && kbr->tctx);
+      if (kbr->tctx == NULL)
+        return -1;
+    }
+  return 0;
+}
+
 /**
  * @brief Reset connection to the KB. This is called after each fork() to make
  *        sure connections aren't shared between concurrent processes.
@@ -1675,9 +4302,16 @@ redis_lnk_reset (kb_t kb)
 
   kbr = redis_kb (kb);
 
+  /* Invalidations may be lost while the connection is down. */
+  redis_track_stop (kbr, 1);
+
   if (kbr->rctx != NULL)
     {
-      redisFree (kbr->rctx);
+      /* Never hand a connection inherited through fork() to the pool. */
+      if (kbr->pooled && kbr->pid == getpid ())
+        kb_pool_put (kbr->path, kbr->rctx, kbr->db);
+      else
+        redisFree (kbr->rctx);
       kbr->rctx = NULL;
     }
 
@@ -1685,22 +4319,17 @@ redis_lnk_reset (kb_t kb)
 }
 
 /**
- * @brief Flush all the KB's content. Delete all namespaces.
+ * @brief Delete the namespaces of the Redis server of a KB handle.
  *
- * @param[in] kb        KB handle.
+ * @param[in] kbr       Subclass of struct kb, with the path of the server.
  * @param[in] except    Don't flush DB with except key.
  *
- * @return 0 on success, non-null on error.
+ * @return 0 on success, -1 on connection error.
  */
 static int
-redis_flush_all (kb_t kb, const char *except)
+redis_flush_shard (struct kb_redis *kbr, const char *except)
 {
   unsigned int i = 1;
-  struct kb_redis *kbr;
-
-  kbr = redis_kb (kb);
-  if (kbr->rctx)
-    redisFree (kbr->rctx);
 
   g_debug ("%s: deleting all DBs at %s except %s", __func__, kbr->path, except);
   do
@@ -1717,6 +4346,8 @@ redis_flush_all (kb_t kb, const char *except)
           kbr->rctx = NULL;
           return -1;
         }
+      if (kbr->max_db == 0)
+        fetch_max_db_index (kbr);
 
       kbr->db = i;
       rep = redisCommand (kbr->rctx, "HEXISTS %s %d", GLOBAL_DBINDEX_NAME, i);
@@ -1741,7 +4372,7 @@ redis_flush_all (kb_t kb, const char *except)
           /* Don't remove DB if it has "except" key. */
           if (except)
             {
-              char *tmp = kb_item_get_str (kb, except);
+              char *tmp = kb_item_get_str ((kb_t) kbr, except);
               if (tmp)
                 {
                   g_free (tmp);
@@ -1758,9 +4389,51 @@ redis_flush_all (kb_t kb, const char *except)
     }
   while (i < kbr->max_db);
 
+  return 0;
+}
+
+/**
+ * @brief Flush all the KB's content. Delete all namespaces.
+ *
+ * With a sharded KB path, the namespaces of all servers are deleted.
+ *
+ * @param[in] kb        KB handle.
+ * @param[in] except    Don't flush DB with except key.
+ *
+ * @return 0 on success, non-null on error.
+ */
+static int
+redis_flush_all (kb_t kb, const char *except)
+{
+  struct kb_redis *kbr;
+  gchar **paths;
+  unsigned int count, shard;
+  int rc = 0;
+
+  kbr = redis_kb (kb);
+  if (kbr->rctx)
+    redisFree (kbr->rctx);
+  kbr->rctx = NULL;
+
+  paths = redis_shard_paths (kbr->kb_path ? kbr->kb_path : kbr->path, &count);
+  for (shard = 0; shard < count; shard++)
+    {
+      if (kbr->kb_path)
+        {
+          g_free (kbr->path);
+          kbr->path = g_strdup (paths[shard]);
+          kbr->shard = shard;
+          kbr->max_db = 0;
+        }
+      if (redis_flush_shard (kbr, except))
+        rc = -1;
+    }
+  g_strfreev (paths);
+
   g_free (kbr->path);
+  g_free (kbr->kb_path);
   g_free (kb);
-  return 0;
+  return rc;
 }
 
 /**
@@ -1795,9 +4468,70 @@ err_cleanup:
   return rc;
 }
 
+/**
+ * @brief Delete the keys of the current DB one SCAN batch at a time.
+ *
+ * Unlike FLUSHDB, this doesn't stall the server until all of them are freed.
+ * Other clients are served between the batches.
+ *
+ * @param[in] kbr Subclass of struct kb.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+redis_flush_incremental (struct kb_redis *kbr)
+{
+  char *cursor = g_strdup ("0");
+  int rc = 0;
+
+  do
+    {
+      redisReply *rep, *names;
+      size_t i;
+
+      rep = redis_cmd (kbr, "SCAN %s COUNT %d", cursor, KB_SCAN_COUNT);
+      g_free (cursor);
+      cursor = NULL;
+      if (rep == NULL || rep->type != REDIS_REPLY_ARRAY || rep->elements != 2
+          || rep->element[0]->type != REDIS_REPLY_STRING
+          || rep->element[1]->type != REDIS_REPLY_ARRAY)
+        {
+          if (rep != NULL)
+            freeReplyObject (rep);
+          rc = -1;
+          break;
+        }
+
+      cursor = g_strdup (rep->element[0]->str);
+      names = rep->element[1];
+      for (i = 0; i < names->elements; i++)
+        redis_append (kbr->rctx, "DEL %s", names->element[i]->str);
+      for (i = 0; i < names->elements; i++)
+        {
+          redisReply *del = NULL;
+
+          if (redis_get_reply (kbr->rctx, &del) != REDIS_OK)
+            {
+              redis_lnk_reset ((kb_t) kbr);
+              rc = -1;
+              break;
+            }
+          freeReplyObject (del);
+        }
+      freeReplyObject (rep);
+    }
+  while (rc == 0 && strcmp (cursor, "0"));
+
+  g_free (cursor);
+  return rc;
+}
+
 /**
  * @brief Delete all the KB's content.
  *
+ * The server frees the memory in the background if it supports it. Otherwise
+ * the keys are deleted incrementally.
+ *
  * @param[in] kbr Subclass of struct kb.
  *
  * @return 0 on success, non-null on error.
@@ -1806,7 +4540,7 @@ int
 redis_delete_all (struct kb_redis *kbr)
 {
   int rc;
-  redisReply *rep;
+  redisReply *rep = NULL;
   struct sigaction new_action, original_action;
 
   /* Ignore SIGPIPE, in case of a lost connection. */
@@ -1819,13 +4553,27 @@ redis_delete_all (struct kb_redis *kbr)
 
   if (kbr)
     g_debug ("%s: deleting all elements from KB #%u", __func__, kbr->db);
-  rep = redis_cmd (kbr, "FLUSHDB");
+  if (kbr && kbr->lazy_free < 0)
+    {
+      rc = redis_flush_incremental (kbr);
+      goto err_cleanup;
+    }
+  rep = redis_cmd (kbr, "FLUSHDB ASYNC");
+  if (rep && redis_unsupported (rep))
+    {
+      freeReplyObject (rep);
+      rep = NULL;
+      kbr->lazy_free = -1;
+      rc = redis_flush_incremental (kbr);
+      goto err_cleanup;
+    }
   if (rep == NULL || rep->type != REDIS_REPLY_STATUS)
     {
       rc = -1;
       goto err_cleanup;
     }
 
+  kbr->lazy_free = 1;
   rc = 0;
 
 err_cleanup:
@@ -1850,23 +4598,37 @@ static const struct kb_operations KBRedisOperations = {
   .kb_get_single = redis_get_single,
   .kb_get_str = redis_get_str,
   .kb_get_int = redis_get_int,
+  .kb_get_many = redis_get_many,
   .kb_get_nvt = redis_get_nvt,
   .kb_get_nvt_all = redis_get_nvt_all,
+  .kb_get_nvt_prefs = redis_get_nvt_prefs,
+  .kb_get_nvt_many = redis_get_nvt_many,
+  .kb_get_nvt_field_many = redis_get_nvt_field_many,
   .kb_get_nvt_oids = redis_get_oids,
   .kb_push_str = redis_push_str,
+  .kb_push_str_many = redis_push_str_many,
   .kb_pop_str = redis_pop_str,
+  .kb_pop_str_blocking = redis_pop_str_blocking,
+  .kb_pop_str_many = redis_pop_str_many,
   .kb_get_all = redis_get_all,
   .kb_get_pattern = redis_get_pattern,
   .kb_count = redis_count,
+  .kb_iterate_pattern = redis_iterate_pattern,
   .kb_add_str = redis_add_str,
   .kb_add_str_unique = redis_add_str_unique,
   .kb_add_str_unique_volatile = redis_add_str_unique_volatile,
   .kb_set_str = redis_set_str,
+  .kb_set_str_many = redis_set_str_many,
   .kb_add_int = redis_add_int,
   .kb_add_int_unique = redis_add_int_unique,
   .kb_add_int_unique_volatile = redis_add_int_unique_volatile,
+  .kb_set_unique_index = redis_set_unique_index,
   .kb_set_int = redis_set_int,
   .kb_add_nvt = redis_add_nvt,
+  .kb_add_nvt_batch = redis_add_nvt_batch,
+  .kb_set_nvt_compact = redis_set_nvt_compact,
+  .kb_track = redis_track,
+  .kb_track_poll = redis_track_poll,
   .kb_del_items = redis_del_items,
   .kb_lnk_reset = redis_lnk_reset,
   .kb_save = redis_save,
@@ -1875,3 +4637,665 @@ static const struct kb_operations KBRedisOperations = {
   .kb_get_kb_index = redis_get_kb_index};
 
 const struct kb_operations *KBDefaultOperations = &KBRedisOperations;
+
+/**
+ * @brief Asynchronous connection to a KB.
+ */
+struct kb_async
+{
+  redisAsyncContext *actx; /**< Redis asynchronous client context. */
+  GMainContext *context;   /**< Main context the connection is attached to. */
+  GMainLoop *loop;         /**< Loop of the I/O thread, if one was started. */
+  GThread *thread;         /**< I/O thread, if no main context was given. */
+  GSource *source;         /**< Source watching the connection socket. */
+  int pending;             /**< Number of requests waiting for replies. */
+  GMutex lock;             /**< Lock for pending. */
+  GCond cond;              /**< Signaled when pending reaches 0. */
+};
+
+/**
+ * @brief GSource watching the socket of an asynchronous redis connection.
+ */
+struct kb_async_source
+{
+  GSource source;          /**< Parent source. */
+  redisAsyncContext *actx; /**< Redis asynchronous client context. */
+  gpointer fd_tag;         /**< Tag of the watched socket. */
+  GIOCondition events;     /**< Events hiredis is interested in. */
+};
+
+/**
+ * @brief Asynchronous request, made of one or more redis commands.
+ */
+struct kb_async_req
+{
+  struct kb_async *akb; /**< Connection to send the request on. */
+  GPtrArray *cmds;      /**< Formatted redis commands. */
+  GArray *lens;         /**< Lengths of the formatted commands. */
+  guint remaining;      /**< Number of replies still to be received. */
+  int rc;               /**< 0 if all commands succeeded, -1 otherwise. */
+  kb_async_cb cb;       /**< Completion callback. */
+  void *user_data;      /**< User data passed to the callback. */
+  char *eval;           /**< EVAL command to send if EVALSHA fails with
+                             NOSCRIPT, NULL if none. */
+  int eval_len;         /**< Length of the EVAL command. */
+};
+
+static void
+kb_async_update_events (struct kb_async_source *src, GIOCondition add,
+                        GIOCondition del)
+{
+  src->events = (src->events | add) & ~del;
+  g_source_modify_unix_fd (&src->source, src->fd_tag, src->events);
+}
+
+static void
+kb_async_add_read (void *data)
+{
+  kb_async_update_events (data, G_IO_IN, 0);
+}
+
+static void
+kb_async_del_read (void *data)
+{
+  kb_async_update_events (data, 0, G_IO_IN);
+}
+
+static void
+kb_async_add_write (void *data)
+{
+  kb_async_update_events (data, G_IO_OUT, 0);
+}
+
+static void
+kb_async_del_write (void *data)
+{
+  kb_async_update_events (data, 0, G_IO_OUT);
+}
+
+static void
+kb_async_cleanup (void *data)
+{
+  struct kb_async_source *src = data;
+
+  /* Called by hiredis when the context is freed. */
+  src->actx = NULL;
+  g_source_destroy (&src->source);
+}
+
+static gboolean
+kb_async_source_prepare (GSource *source, gint *timeout)
+{
+  (void) source;
+  *timeout = -1;
+  return FALSE;
+}
+
+static gboolean
+kb_async_source_check (GSource *source)
+{
+  struct kb_async_source *src = (struct kb_async_source *) source;
+
+  return !!(g_source_query_unix_fd (source, src->fd_tag)
+            & (src->events | G_IO_HUP | G_IO_ERR));
+}
+
+static gboolean
+kb_async_source_dispatch (GSource *source, GSourceFunc callback,
+                          gpointer user_data)
+{
+  struct kb_async_source *src = (struct kb_async_source *) source;
+  GIOCondition revents;
+
+  (void) callback;
+  (void) user_data;
+  revents = g_source_query_unix_fd (source, src->fd_tag);
+  if (src->actx && (revents & G_IO_OUT))
+    redisAsyncHandleWrite (src->actx);
+  /* The context may have been freed while handling the write. */
+  if (src->actx && (revents & (G_IO_IN | G_IO_HUP | G_IO_ERR)))
+    redisAsyncHandleRead (src->actx);
+
+  return G_SOURCE_CONTINUE;
+}
+
+static GSourceFuncs kb_async_source_funcs = {
+  kb_async_source_prepare,
+  kb_async_source_check,
+  kb_async_source_dispatch,
+  NULL,
+  NULL,
+  NULL,
+};
+
+/**
+ * @brief Attach an asynchronous redis context to a GMainContext.
+ *
+ * @param[in] actx     Redis asynchronous client context.
+ * @param[in] context  Main context to attach to.
+ *
+ * @return The source watching the socket.
+ */
+static GSource *
+kb_async_attach (redisAsyncContext *actx, GMainContext *context)
+{
+  struct kb_async_source *src;
+
+  src = (struct kb_async_source *) g_source_new (
+    &kb_async_source_funcs, sizeof (struct kb_async_source));
+  src->actx = actx;
+  src->events = 0;
+  src->fd_tag = g_source_add_unix_fd (&src->source, actx->c.fd, 0);
+
+  actx->ev.data = src;
+  actx->ev.addRead = kb_async_add_read;
+  actx->ev.delRead = kb_async_del_read;
+  actx->ev.addWrite = kb_async_add_write;
+  actx->ev.delWrite = kb_async_del_write;
+  actx->ev.cleanup = kb_async_cleanup;
+
+  g_source_attach (&src->source, context);
+  return &src->source;
+}
+
+/**
+ * @brief Complete a request: call its callback and release it.
+ *
+ * @param[in] req  Request to complete.
+ */
+static void
+kb_async_req_done (struct kb_async_req *req)
+{
+  struct kb_async *akb = req->akb;
+
+  if (req->cb)
+    req->cb (req->rc, req->user_data);
+  g_ptr_array_free (req->cmds, TRUE);
+  g_array_free (req->lens, TRUE);
+  redisFreeCommand (req->eval);
+  g_free (req);
+
+  g_mutex_lock (&akb->lock);
+  if (--akb->pending == 0)
+    g_cond_broadcast (&akb->cond);
+  g_mutex_unlock (&akb->lock);
+}
+
+static void
+kb_async_reply (redisAsyncContext *actx, void *reply, void *privdata)
+{
+  struct kb_async_req *req = privdata;
+  redisReply *rep = reply;
+
+  /* Script not cached (yet), send it along. */
+  if (rep && rep->type == REDIS_REPLY_ERROR && req->eval
+      && !strncmp (rep->str, "NOSCRIPT", 8))
+    {
+      char *eval = req->eval;
+
+      req->eval = NULL;
+      if (redisAsyncFormattedCommand (actx, kb_async_reply, req, eval,
+                                      req->eval_len)
+          == REDIS_OK)
+        {
+          redisFreeCommand (eval);
+          return;
+        }
+      redisFreeCommand (eval);
+    }
+  /* reply is NULL when the connection is lost. */
+  if (rep == NULL || rep->type == REDIS_REPLY_ERROR)
+    req->rc = -1;
+  if (--req->remaining == 0)
+    kb_async_req_done (req);
+}
+
+static void
+kb_async_disconnected (const redisAsyncContext *actx, int status)
+{
+  struct kb_async *akb = actx->data;
+
+  if (status != REDIS_OK)
+    g_warning ("%s: connection to redis lost: %s", __func__, actx->errstr);
+  akb->actx = NULL;
+}
+
+/**
+ * @brief Send the commands of a request. Runs in the connection's context.
+ *
+ * @param[in] data  Request to send.
+ *
+ * @return G_SOURCE_REMOVE.
+ */
+static gboolean
+kb_async_req_dispatch (gpointer data)
+{
+  struct kb_async_req *req = data;
+  guint i;
+
+  req->remaining = req->cmds->len;
+  for (i = 0; i < req->cmds->len; i++)
+    if (req->akb->actx == NULL
+        || redisAsyncFormattedCommand (req->akb->actx, kb_async_reply, req,
+                                       g_ptr_array_index (req->cmds, i),
+                                       g_array_index (req->lens, int, i))
+             != REDIS_OK)
+      {
+        req->rc = -1;
+        req->remaining--;
+      }
+  if (req->remaining == 0)
+    kb_async_req_done (req);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+free_formatted_command (gpointer cmd)
+{
+  redisFreeCommand (cmd);
+}
+
+/**
+ * @brief Create a new request.
+ *
+ * @param[in] akb        Connection to send the request on.
+ * @param[in] cb         Completion callback, may be NULL.
+ * @param[in] user_data  User data passed to the callback.
+ *
+ * @return New request.
+ */
+static struct kb_async_req *
+kb_async_req_new (kb_async_t akb, kb_async_cb cb, void *user_data)
+{
+  struct kb_async_req *req;
+
+  req = g_malloc0 (sizeof (struct kb_async_req));
+  req->akb = akb;
+  req->cmds = g_ptr_array_new_with_free_func (free_formatted_command);
+  req->lens = g_array_new (FALSE, FALSE, sizeof (int));
+  req->cb = cb;
+  req->user_data = user_data;
+  return req;
+}
+
+/**
+ * @brief Append a redis command to a request.
+ *
+ * @param[in] req  Request.
+ * @param[in] fmt  Formatted variable argument list with the cmd.
+ */
+static void
+kb_async_req_append (struct kb_async_req *req, const char *fmt, ...)
+{
+  va_list ap;
+  char *cmd = NULL;
+  int len;
+
+  va_start (ap, fmt);
+  len = redisvFormatCommand (&cmd, fmt, ap);
+  va_end (ap);
+  if (len < 0)
+    {
+      req->rc = -1;
+      return;
+    }
+  g_ptr_array_add (req->cmds, cmd);
+  g_array_append_val (req->lens, len);
+}
+
+/**
+ * @brief Append a unique insertion with KB_SCRIPT_ADD_UNIQUE to a request.
+ *
+ * The insertion is sent with EVALSHA, and with EVAL if the server does not
+ * have the script cached yet.
+ *
+ * @param[in] req   Request, with no other unique insertion.
+ * @param[in] name  Item name.
+ * @param[in] str   Item value.
+ * @param[in] len   Value length.
+ * @param[in] pos   Which position the value is appended to. 0 for right,
+ *                  1 for left position in the list.
+ */
+static void
+kb_async_req_append_unique (struct kb_async_req *req, const char *name,
+                            const char *str, size_t len, int pos)
+{
+  kb_async_req_append (req,
+                       "EVALSHA %s 2 %s " KB_UNIQUE_INDEX_PREFIX "%s %b %d 0 0",
+                       redis_add_unique_sha (), name, name, str, len,
+                       pos ? 1 : 0);
+  req->eval_len = redisFormatCommand (
+    &req->eval, "EVAL %s 2 %s " KB_UNIQUE_INDEX_PREFIX "%s %b %d 0 0",
+    KB_SCRIPT_ADD_UNIQUE, name, name, str, len, pos ? 1 : 0);
+  if (req->eval_len < 0)
+    {
+      req->eval = NULL;
+      req->rc = -1;
+    }
+}
+
+/**
+ * @brief Queue a request for sending.
+ *
+ * @param[in] req  Request.
+ *
+ * @return 0 on success, -1 if the request could not be formatted.
+ */
+static int
+kb_async_req_send (struct kb_async_req *req)
+{
+  struct kb_async *akb = req->akb;
+
+  if (req->rc)
+    {
+      g_ptr_array_free (req->cmds, TRUE);
+      g_array_free (req->lens, TRUE);
+      redisFreeCommand (req->eval);
+      g_free (req);
+      return -1;
+    }
+
+  g_mutex_lock (&akb->lock);
+  akb->pending++;
+  g_mutex_unlock (&akb->lock);
+  g_main_context_invoke (akb->context, kb_async_req_dispatch, req);
+  return 0;
+}
+
+static gpointer
+kb_async_run (gpointer data)
+{
+  struct kb_async *akb = data;
+
+  g_main_context_push_thread_default (akb->context);
+  g_main_loop_run (akb->loop);
+  g_main_context_pop_thread_default (akb->context);
+  return NULL;
+}
+
+/**
+ * @brief Open an asynchronous connection to a KB.
+ *
+ * @param[in] kb_path   Path to KB. With several Redis servers, kb_index
+ *                      selects the server too.
+ * @param[in] kb_index  DB index.
+ * @param[in] context   Main context to attach the connection to. If NULL, a
+ *                      dedicated I/O thread is started.
+ *
+ * @return Asynchronous KB connection, NULL on error.
+ */
+kb_async_t
+kb_async_new (const char *kb_path, int kb_index, GMainContext *context)
+{
+  struct kb_async *akb;
+  struct kb_async_req *req;
+  redisAsyncContext *actx;
+  unsigned int shard, db;
+  char *host, *path;
+  int port;
+
+  if (kb_path == NULL)
+    return NULL;
+
+  if ((path = redis_shard_route (kb_path, kb_index, &shard, &db)) == NULL)
+    {
+      g_warning ("%s: KB index %d is not in %s", __func__, kb_index, kb_path);
+      return NULL;
+    }
+  if ((host = parse_tcp_addr (path, strlen (path), &port)) == NULL)
+    actx = redisAsyncConnectUnix (path);
+  else
+    {
+      actx = redisAsyncConnect (host, port);
+      free (host);
+    }
+  if (actx == NULL || actx->err)
+    {
+      g_log (G_LOG_DOMAIN, G_LOG_LEVEL_CRITICAL,
+             "%s: redis connection error to %s: %s", __func__, path,
+             actx ? actx->errstr : strerror (ENOMEM));
+      if (actx)
+        redisAsyncFree (actx);
+      g_free (path);
+      return NULL;
+    }
+  g_free (path);
+
+  akb = g_malloc0 (sizeof (struct kb_async));
+  g_mutex_init (&akb->lock);
+  g_cond_init (&akb->cond);
+  akb->actx = actx;
+  actx->data = akb;
+  redisAsyncSetDisconnectCallback (actx, kb_async_disconnected);
+
+  if (context)
+    akb->context = g_main_context_ref (context);
+  else
+    akb->context = g_main_context_new ();
+  akb->source = kb_async_attach (actx, akb->context);
+
+  /* Commands are queued until the connection is established. */
+  req = kb_async_req_new (akb, NULL, NULL);
+  kb_async_req_append (req, "SELECT %u", db);
+  kb_async_req_send (req);
+
+  if (context == NULL)
+    {
+      akb->loop = g_main_loop_new (akb->context, FALSE);
+      akb->thread = g_thread_new ("kb_async", kb_async_run, akb);
+    }
+
+  return akb;
+}
+
+/**
+ * @brief Wait until all queued operations of a connection completed.
+ *
+ * When the connection is attached to a caller provided main context, the
+ * context is iterated, so the caller has to own it.
+ *
+ * @param[in] akb  Asynchronous KB connection.
+ */
+void
+kb_async_wait (kb_async_t akb)
+{
+  if (akb == NULL)
+    return;
+
+  if (akb->thread)
+    {
+      g_mutex_lock (&akb->lock);
+      while (akb->pending)
+        g_cond_wait (&akb->cond, &akb->lock);
+      g_mutex_unlock (&akb->lock);
+      return;
+    }
+
+  while (g_atomic_int_get (&akb->pending))
+    g_main_context_iteration (akb->context, TRUE);
+}
+
+static gboolean
+kb_async_disconnect (gpointer data)
+{
+  struct kb_async *akb = data;
+
+  if (akb->actx)
+    {
+      akb->actx->data = NULL;
+      redisAsyncSetDisconnectCallback (akb->actx, NULL);
+      redisAsyncDisconnect (akb->actx);
+      akb->actx = NULL;
+    }
+  if (akb->loop)
+    g_main_loop_quit (akb->loop);
+
+  return G_SOURCE_REMOVE;
+}
+
+/**
+ * @brief Wait for all queued operations, then close an asynchronous KB
+ *        connection.
+ *
+ * @param[in] akb  Asynchronous KB connection.
+ */
+void
+kb_async_free (kb_async_t akb)
+{
+  if (akb == NULL)
+    return;
+
+  kb_async_wait (akb);
+  if (akb->thread)
+    {
+      g_main_context_invoke (akb->context, kb_async_disconnect, akb);
+      g_thread_join (akb->thread);
+      g_main_loop_unref (akb->loop);
+    }
+  else
+    kb_async_disconnect (akb);
+
+  g_source_destroy (akb->source);
+  g_source_unref (akb->source);
+  g_main_context_unref (akb->context);
+  g_mutex_clear (&akb->lock);
+  g_cond_clear (&akb->cond);
+  g_free (akb);
+}
+
+/**
+ * @brief Asynchronously push a new entry under a given key.
+ *
+ * @param[in] akb        Asynchronous KB connection.
+ * @param[in] name       Key to push to.
+ * @param[in] value      Value to push.
+ * @param[in] cb         Completion callback, may be NULL.
+ * @param[in] user_data  User data passed to the callback.
+ *
+ * @return 0 if the operation was queued, -1 on error.
+ */
+int
+kb_async_push_str (kb_async_t akb, const char *name, const char *value,
+                   kb_async_cb cb, void *user_data)
+{
+  struct kb_async_req *req;
+
+  if (!akb || !value)
+    return -1;
+
+  req = kb_async_req_new (akb, cb, user_data);
+  kb_async_req_append (req, "LPUSH %s %s", name, value);
+  return kb_async_req_send (req);
+}
+
+/**
+ * @brief Asynchronously insert (append) a new entry under a given name.
+ *
+ * @param[in] akb        Asynchronous KB connection.
+ * @param[in] name       Item name.
+ * @param[in] str        Item value.
+ * @param[in] len        Value length. Used for blobs.
+ * @param[in] cb         Completion callback, may be NULL.
+ * @param[in] user_data  User data passed to the callback.
+ *
+ * @return 0 if the operation was queued, -1 on error.
+ */
+int
+kb_async_add_str (kb_async_t akb, const char *name, const char *str,
+                  size_t len, kb_async_cb cb, void *user_data)
+{
+  struct kb_async_req *req;
+
+  if (!akb || !str)
+    return -1;
+
+  req = kb_async_req_new (akb, cb, user_data);
+  if (len == 0)
+    kb_async_req_append (req, "RPUSH %s %s", name, str);
+  else
+    kb_async_req_append (req, "RPUSH %s %b", name, str, len);
+  return kb_async_req_send (req);
+}
+
+/**
+ * @brief Asynchronously insert (append) a new unique entry under a given
+ *        name.
+ *
+ * @param[in] akb        Asynchronous KB connection.
+ * @param[in] name       Item name.
+ * @param[in] str        Item value.
+ * @param[in] len        Value length. Used for blobs.
+ * @param[in] pos        Which position the value is appended to. 0 for right,
+ *                       1 for left position in the list.
+ * @param[in] cb         Completion callback, may be NULL.
+ * @param[in] user_data  User data passed to the callback.
+ *
+ * @return 0 if the operation was queued, -1 on error.
+ */
+int
+kb_async_add_str_unique (kb_async_t akb, const char *name, const char *str,
+                         size_t len, int pos, kb_async_cb cb, void *user_data)
+{
+  struct kb_async_req *req;
+
+  if (!akb || !str)
+    return -1;
+
+  req = kb_async_req_new (akb, cb, user_data);
+  kb_async_req_append_unique (req, name, str, len ? len : strlen (str), pos);
+  return kb_async_req_send (req);
+}
+
+/**
+ * @brief Asynchronously insert (append) a new entry under a given name.
+ *
+ * @param[in] akb        Asynchronous KB connection.
+ * @param[in] name       Item name.
+ * @param[in] val        Item value.
+ * @param[in] cb         Completion callback, may be NULL.
+ * @param[in] user_data  User data passed to the callback.
+ *
+ * @return 0 if the operation was queued, -1 on error.
+ */
+int
+kb_async_add_int (kb_async_t akb, const char *name, int val, kb_async_cb cb,
+                  void *user_data)
+{
+  struct kb_async_req *req;
+
+  if (!akb)
+    return -1;
+
+  req = kb_async_req_new (akb, cb, user_data);
+  kb_async_req_append (req, "RPUSH %s %d", name, val);
+  return kb_async_req_send (req);
+}
+
+/**
+ * @brief Asynchronously insert (append) a new unique entry under a given
+ *        name.
+ *
+ * @param[in] akb        Asynchronous KB connection.
+ * @param[in] name       Item name.
+ * @param[in] val        Item value.
+ * @param[in] cb         Completion callback, may be NULL.
+ * @param[in] user_data  User data passed to the callback.
+ *
+ * @return 0 if the operation was queued, -1 on error.
+ */
+int
+kb_async_add_int_unique (kb_async_t akb, const char *name, int val,
+                         kb_async_cb cb, void *user_data)
+{
+  struct kb_async_req *req;
+  char str[16];
+
+  if (!akb)
+    return -1;
+
+  g_snprintf (str, sizeof (str), "%d", val);
+  req = kb_async_req_new (akb, cb, user_data);
+  kb_async_req_append_unique (req, name, str, strlen (str), 0);
+  return kb_async_req_send (req);
+}
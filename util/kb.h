@@ -15,6 +15,7 @@
 
 #include <assert.h>
 #include <stddef.h>    /* for NULL */
+#include <string.h>    /* for strncmp */
 #include <sys/types.h> /* for size_t */
 
 /**
@@ -26,6 +27,11 @@
 #define KB_PATH_DEFAULT "/run/redis/redis.sock"
 #endif
 
+/**
+ * @brief Default number of NVTs sent per pipelined chunk by kb_nvt_add_batch.
+ */
+#define KB_NVT_BATCH_CHUNK_DEFAULT 256
+
 /**
  * @brief Possible type of a kb_item.
  */
@@ -97,6 +103,23 @@ struct kb
  */
 typedef struct kb *kb_t;
 
+/**
+ * @brief Callback called for each name matching a pattern.
+ *
+ * Receives the matching name and the user data. Returns 0 to continue the
+ * iteration, non-zero to stop it.
+ */
+typedef int (*kb_pattern_cb) (const char *, void *);
+
+/**
+ * @brief Callback called for each name whose value changed on the server
+ *        after being read, see kb_track.
+ *
+ * Receives the name, or NULL if any value may have changed, and the user
+ * data.
+ */
+typedef void (*kb_invalidate_cb) (const char *, void *);
+
 /**
  * @brief KB interface. Functions provided by an implementation. All functions
  *        have to be provided, there is no default/fallback. These functions
@@ -124,6 +147,12 @@ struct kb_operations
    * Function provided by an implementation to get single kb int item.
    */
   int (*kb_get_int) (kb_t, const char *);
+  /**
+   * Function provided by an implementation to get single kb elements
+   * of several names at once.
+   */
+  int (*kb_get_many) (kb_t, const char **, size_t, enum kb_item_type,
+                      struct kb_item **);
   /**
    * Function provided by an implementation to get field of NVT.
    */
@@ -132,6 +161,21 @@ struct kb_operations
    * Function provided by an implementation to get a full NVT.
    */
   nvti_t *(*kb_get_nvt_all) (kb_t, const char *);
+  /**
+   * Function provided by an implementation to get the prefs of a NVT.
+   */
+  GSList *(*kb_get_nvt_prefs) (kb_t, const char *);
+  /**
+   * Function provided by an implementation to get several full NVTs,
+   * including their prefs, at once. Optional.
+   */
+  int (*kb_get_nvt_many) (kb_t, const char **, size_t, nvti_t **);
+  /**
+   * Function provided by an implementation to get a field of several NVTs
+   * at once. Optional.
+   */
+  int (*kb_get_nvt_field_many) (kb_t, const char **, size_t, enum kb_nvt_pos,
+                                char **);
   /**
    * Function provided by an implementation to get list of OIDs.
    */
@@ -140,10 +184,25 @@ struct kb_operations
    * Function provided by an implementation to push a new value under a key.
    */
   int (*kb_push_str) (kb_t, const char *, const char *);
+  /**
+   * Function provided by an implementation to push several values under a
+   * key at once. Optional.
+   */
+  int (*kb_push_str_many) (kb_t, const char *, const char **, size_t);
   /**
    * Function provided by an implementation to pop a str under a key.
    */
   char *(*kb_pop_str) (kb_t, const char *);
+  /**
+   * Function provided by an implementation to pop a str under a key,
+   * waiting for one to be pushed. Optional.
+   */
+  char *(*kb_pop_str_blocking) (kb_t, const char *, int);
+  /**
+   * Function provided by an implementation to pop several strs under a key.
+   * Optional.
+   */
+  int (*kb_pop_str_many) (kb_t, const char *, size_t, char **);
   /**
    * Function provided by an implementation to get all items stored
    * under a given name.
@@ -159,6 +218,11 @@ struct kb_operations
    * under a given pattern.
    */
   size_t (*kb_count) (kb_t, const char *);
+  /**
+   * Function provided by an implementation to incrementally iterate over all
+   * names matching a given pattern.
+   */
+  int (*kb_iterate_pattern) (kb_t, const char *, kb_pattern_cb, void *);
   /**
    * Function provided by an implementation to insert (append) a new entry
    * under a given name.
@@ -180,6 +244,11 @@ struct kb_operations
    * under a given name.
    */
   int (*kb_set_str) (kb_t, const char *, const char *, size_t);
+  /**
+   * Function provided by an implementation to set (replace) the entries
+   * of several names at once. Optional.
+   */
+  int (*kb_set_str_many) (kb_t, const char **, const char **, size_t);
   /**
    * Function provided by an implementation to insert (append) a new entry
    * under a given name.
@@ -195,6 +264,11 @@ struct kb_operations
    * unique and volatile entry under a given name.
    */
   int (*kb_add_int_unique_volatile) (kb_t, const char *, int, int);
+  /**
+   * Function provided by an implementation to enable or disable an index
+   * speeding up unique insertions. Optional.
+   */
+  int (*kb_set_unique_index) (kb_t, int);
   /**
    * Function provided by an implementation to get (replace) a new entry
    * under a given name.
@@ -205,6 +279,27 @@ struct kb_operations
    * insert a new nvt.
    */
   int (*kb_add_nvt) (kb_t, const nvti_t *, const char *);
+  /**
+   * Function provided by an implementation to insert a batch of nvts.
+   * Optional, kb_nvt_add_batch falls back to kb_add_nvt if not provided.
+   */
+  int (*kb_add_nvt_batch) (kb_t, const nvti_t **, const char **, size_t,
+                           size_t, int *);
+  /**
+   * Function provided by an implementation to select the compact encoding
+   * of stored nvts. Optional.
+   */
+  int (*kb_set_nvt_compact) (kb_t, int);
+  /**
+   * Function provided by an implementation to get notified of changes of
+   * the values read through the handle. Optional.
+   */
+  int (*kb_track) (kb_t, kb_invalidate_cb, void *);
+  /**
+   * Function provided by an implementation to deliver the pending change
+   * notifications. Optional.
+   */
+  int (*kb_track_poll) (kb_t);
   /**
    * Function provided by an implementation to delete all entries
    * under a given name.
@@ -219,12 +314,37 @@ struct kb_operations
 };
 
 /**
- * @brief Default KB operations.
- *        No selection mechanism is provided yet since there's only one
- *        implementation (redis-based).
+ * @brief Default KB operations (redis-based).
  */
 extern const struct kb_operations *KBDefaultOperations;
 
+/**
+ * @brief Shared memory KB operations, for deployments without redis.
+ */
+extern const struct kb_operations *KBShmOperations;
+
+/**
+ * @brief Scheme of KB paths handled by the shared memory backend.
+ */
+#define KB_SHM_SCHEME "shm://"
+
+/**
+ * @brief Select the KB operations handling a KB path.
+ *
+ * @param[in] kb_path   Path to KB.
+ *
+ * @return KBShmOperations for "shm://<name>" paths, KBDefaultOperations
+ *         otherwise.
+ */
+static inline const struct kb_operations *
+kb_select_operations (const char *kb_path)
+{
+  if (kb_path
+      && !strncmp (kb_path, KB_SHM_SCHEME, sizeof (KB_SHM_SCHEME) - 1))
+    return KBShmOperations;
+  return KBDefaultOperations;
+}
+
 /**
  * @brief Release a KB item (or a list).
  */
@@ -234,6 +354,10 @@ kb_item_free (struct kb_item *);
 /**
  * @brief Initialize a new Knowledge Base object.
  *
+ * A Redis kb_path may list several servers separated by commas, the KB is
+ * then created on the one with the most free DBs.  kb_get_kb_index,
+ * kb_direct_conn and kb_find route to the server transparently.
+ *
  * @param[in] kb  Reference to a kb_t to initialize.
  * @param[in] kb_path   Path to KB.
  *
@@ -242,13 +366,15 @@ kb_item_free (struct kb_item *);
 static inline int
 kb_new (kb_t *kb, const char *kb_path)
 {
+  const struct kb_operations *ops = kb_select_operations (kb_path);
+
   assert (kb);
-  assert (KBDefaultOperations);
-  assert (KBDefaultOperations->kb_new);
+  assert (ops);
+  assert (ops->kb_new);
 
   *kb = NULL;
 
-  return KBDefaultOperations->kb_new (kb, kb_path);
+  return ops->kb_new (kb, kb_path);
 }
 
 /**
@@ -262,10 +388,12 @@ kb_new (kb_t *kb, const char *kb_path)
 static inline kb_t
 kb_direct_conn (const char *kb_path, const int kb_index)
 {
-  assert (KBDefaultOperations);
-  assert (KBDefaultOperations->kb_direct_conn);
+  const struct kb_operations *ops = kb_select_operations (kb_path);
 
-  return KBDefaultOperations->kb_direct_conn (kb_path, kb_index);
+  assert (ops);
+  assert (ops->kb_direct_conn);
+
+  return ops->kb_direct_conn (kb_path, kb_index);
 }
 
 /**
@@ -279,10 +407,12 @@ kb_direct_conn (const char *kb_path, const int kb_index)
 static inline kb_t
 kb_find (const char *kb_path, const char *key)
 {
-  assert (KBDefaultOperations);
-  assert (KBDefaultOperations->kb_find);
+  const struct kb_operations *ops = kb_select_operations (kb_path);
+
+  assert (ops);
+  assert (ops->kb_find);
 
-  return KBDefaultOperations->kb_find (kb_path, key);
+  return ops->kb_find (kb_path, key);
 }
 
 /**
@@ -358,6 +488,99 @@ kb_item_get_int (kb_t kb, const char *name)
   return kb->kb_ops->kb_get_int (kb, name);
 }
 
+/**
+ * @brief Get single KB elements of several names at once.
+ *
+ * @param[in]  kb     KB handle where to fetch the items.
+ * @param[in]  names  Names of the elements to retrieve.
+ * @param[in]  count  Number of names.
+ * @param[in]  type   Desired element type.
+ * @param[out] items  Array of count elements where to store the items, to be
+ *                    freed with kb_item_free(). NULL for names without element.
+ *
+ * @return Number of elements found, -1 on error.
+ */
+static inline int
+kb_item_get_many (kb_t kb, const char **names, size_t count,
+                  enum kb_item_type type, struct kb_item **items)
+{
+  assert (kb);
+  assert (kb->kb_ops);
+  assert (kb->kb_ops->kb_get_many);
+  assert (items);
+
+  return kb->kb_ops->kb_get_many (kb, names, count, type, items);
+}
+
+/**
+ * @brief Get single KB string items of several names at once.
+ *
+ * @param[in]  kb      KB handle where to fetch the items.
+ * @param[in]  names   Names of the elements to retrieve.
+ * @param[in]  count   Number of names.
+ * @param[out] values  Array of count elements where to store the strings, to
+ *                     be freed. NULL for names without element.
+ *
+ * @return Number of elements found, -1 on error.
+ */
+static inline int
+kb_item_get_str_many (kb_t kb, const char **names, size_t count,
+                      char **values)
+{
+  struct kb_item **items;
+  size_t i;
+  int found;
+
+  assert (values);
+
+  items = g_malloc0 (count * sizeof (struct kb_item *));
+  found = kb_item_get_many (kb, names, count, KB_TYPE_STR, items);
+  for (i = 0; i < count; i++)
+    {
+      values[i] = NULL;
+      if (items[i] == NULL)
+        continue;
+      values[i] = items[i]->v_str;
+      items[i]->v_str = NULL;
+      kb_item_free (items[i]);
+    }
+  g_free (items);
+
+  return found;
+}
+
+/**
+ * @brief Get single KB integer items of several names at once.
+ *
+ * @param[in]  kb      KB handle where to fetch the items.
+ * @param[in]  names   Names of the elements to retrieve.
+ * @param[in]  count   Number of names.
+ * @param[out] values  Array of count elements where to store the integers.
+ *                     -1 for names without element.
+ *
+ * @return Number of elements found, -1 on error.
+ */
+static inline int
+kb_item_get_int_many (kb_t kb, const char **names, size_t count, int *values)
+{
+  struct kb_item **items;
+  size_t i;
+  int found;
+
+  assert (values);
+
+  items = g_malloc0 (count * sizeof (struct kb_item *));
+  found = kb_item_get_many (kb, names, count, KB_TYPE_INT, items);
+  for (i = 0; i < count; i++)
+    {
+      values[i] = items[i] ? items[i]->v_int : -1;
+      kb_item_free (items[i]);
+    }
+  g_free (items);
+
+  return found;
+}
+
 /**
  * @brief Get all items stored under a given name.
  *
@@ -396,6 +619,32 @@ kb_item_get_pattern (kb_t kb, const char *pattern)
   return kb->kb_ops->kb_get_pattern (kb, pattern);
 }
 
+/**
+ * @brief Iterate over all names matching a given pattern.
+ *
+ * The iteration is incremental, so that large KBs don't block the server.
+ * Each matching name is passed once to the callback.
+ *
+ * @param[in] kb         KB handle where to look for the names.
+ * @param[in] pattern    '*' pattern of the names to iterate over.
+ * @param[in] cb         Callback called for each matching name.
+ * @param[in] user_data  User data passed to the callback.
+ *
+ * @return 0 when all names were iterated, 1 if the callback stopped the
+ *         iteration, -1 on error.
+ */
+static inline int
+kb_item_iterate_pattern (kb_t kb, const char *pattern, kb_pattern_cb cb,
+                         void *user_data)
+{
+  assert (kb);
+  assert (kb->kb_ops);
+  assert (kb->kb_ops->kb_iterate_pattern);
+  assert (cb);
+
+  return kb->kb_ops->kb_iterate_pattern (kb, pattern, cb, user_data);
+}
+
 /**
  * @brief Push a new value under a given key.
  *
@@ -415,6 +664,37 @@ kb_item_push_str (kb_t kb, const char *name, const char *value)
   return kb->kb_ops->kb_push_str (kb, name, value);
 }
 
+/**
+ * @brief Push several values under a given key.
+ *
+ * The values are pushed in order, as by kb_item_push_str calls.
+ *
+ * @param[in] kb     KB handle where to store the items.
+ * @param[in] name   Key to push to.
+ * @param[in] values Values to push.
+ * @param[in] count  Number of values.
+ *
+ * @return Number of values which could not be pushed, -1 on error.
+ */
+static inline int
+kb_item_push_str_many (kb_t kb, const char *name, const char **values,
+                       size_t count)
+{
+  size_t i;
+  int failed = 0;
+
+  assert (kb);
+  assert (kb->kb_ops);
+
+  if (kb->kb_ops->kb_push_str_many)
+    return kb->kb_ops->kb_push_str_many (kb, name, values, count);
+
+  for (i = 0; i < count; i++)
+    if (kb_item_push_str (kb, name, values[i]))
+      failed++;
+  return failed;
+}
+
 /**
  * @brief Pop a single KB string item.
  *
@@ -434,6 +714,59 @@ kb_item_pop_str (kb_t kb, const char *name)
   return kb->kb_ops->kb_pop_str (kb, name);
 }
 
+/**
+ * @brief Pop a single KB string item, waiting for one if there is none.
+ *
+ * Implementations without support for waiting return immediately.
+ *
+ * @param[in] kb       KB handle where to fetch the item.
+ * @param[in] name     Name of the element to retrieve.
+ * @param[in] timeout  Seconds to wait at most, 0 to wait forever.
+ *
+ * @return The string to be freed with g_free, NULL on timeout or error.
+ */
+static inline char *
+kb_item_pop_str_blocking (kb_t kb, const char *name, int timeout)
+{
+  assert (kb);
+  assert (kb->kb_ops);
+
+  if (kb->kb_ops->kb_pop_str_blocking == NULL)
+    return kb_item_pop_str (kb, name);
+
+  return kb->kb_ops->kb_pop_str_blocking (kb, name, timeout);
+}
+
+/**
+ * @brief Pop several KB string items at once.
+ *
+ * Items are popped in the order kb_item_pop_str pops them.
+ *
+ * @param[in]  kb      KB handle where to fetch the items.
+ * @param[in]  name    Name of the elements to retrieve.
+ * @param[in]  count   Maximum number of items to pop.
+ * @param[out] values  The strings to be freed with g_free, at least count.
+ *
+ * @return Number of popped items, -1 on error.
+ */
+static inline int
+kb_item_pop_str_many (kb_t kb, const char *name, size_t count, char **values)
+{
+  size_t i;
+
+  assert (kb);
+  assert (kb->kb_ops);
+  assert (values);
+
+  if (kb->kb_ops->kb_pop_str_many != NULL)
+    return kb->kb_ops->kb_pop_str_many (kb, name, count, values);
+
+  for (i = 0; i < count; i++)
+    if ((values[i] = kb_item_pop_str (kb, name)) == NULL)
+      break;
+  return i;
+}
+
 /**
  * @brief Count all items stored under a given pattern.
  *
@@ -517,11 +850,11 @@ kb_add_str_unique_volatile (kb_t kb, const char *name, const char *str,
                             int expire, size_t len, int pos)
 {
   assert (kb);
-  assert (KBDefaultOperations);
-  assert (KBDefaultOperations->kb_add_str_unique_volatile);
+  assert (kb->kb_ops);
+  assert (kb->kb_ops->kb_add_str_unique_volatile);
 
-  return KBDefaultOperations->kb_add_str_unique_volatile (kb, name, str, expire,
-                                                          len, pos);
+  return kb->kb_ops->kb_add_str_unique_volatile (kb, name, str, expire, len,
+                                                 pos);
 }
 
 /**
@@ -544,6 +877,35 @@ kb_item_set_str (kb_t kb, const char *name, const char *str, size_t len)
   return kb->kb_ops->kb_set_str (kb, name, str, len);
 }
 
+/**
+ * @brief Set (replace) the entries of several names at once.
+ *
+ * @param[in] kb      KB handle where to store the items.
+ * @param[in] names   Item names.
+ * @param[in] values  Item values, same order as names.
+ * @param[in] count   Number of items.
+ *
+ * @return Number of items which could not be set, -1 on error.
+ */
+static inline int
+kb_item_set_str_many (kb_t kb, const char **names, const char **values,
+                      size_t count)
+{
+  size_t i;
+  int failed = 0;
+
+  assert (kb);
+  assert (kb->kb_ops);
+
+  if (kb->kb_ops->kb_set_str_many)
+    return kb->kb_ops->kb_set_str_many (kb, names, values, count);
+
+  for (i = 0; i < count; i++)
+    if (kb_item_set_str (kb, names[i], values[i], 0))
+      failed++;
+  return failed;
+}
+
 /**
  * @brief Insert (append) a new entry under a given name.
  *
@@ -597,11 +959,36 @@ static inline int
 kb_add_int_unique_volatile (kb_t kb, const char *name, int val, int expire)
 {
   assert (kb);
-  assert (KBDefaultOperations);
-  assert (KBDefaultOperations->kb_add_int_unique_volatile);
+  assert (kb->kb_ops);
+  assert (kb->kb_ops->kb_add_int_unique_volatile);
 
-  return KBDefaultOperations->kb_add_int_unique_volatile (kb, name, val,
-                                                          expire);
+  return kb->kb_ops->kb_add_int_unique_volatile (kb, name, val, expire);
+}
+
+/**
+ * @brief Enable or disable the index speeding up unique insertions.
+ *
+ * With the index, inserting a value which isn't present yet doesn't need to
+ * search the whole list anymore, at the cost of some memory on the server.
+ * The pops, deletions and sets of the handle keep the index up to date. A
+ * list written otherwise, e.g. by another process, gets its index rebuilt
+ * when the sizes of both differ.
+ *
+ * @param[in] kb      KB handle.
+ * @param[in] enable  1 to enable, 0 to disable.
+ *
+ * @return 0 on success, -1 if not supported by the implementation.
+ */
+static inline int
+kb_set_unique_index (kb_t kb, int enable)
+{
+  assert (kb);
+  assert (kb->kb_ops);
+
+  if (kb->kb_ops->kb_set_unique_index == NULL)
+    return -1;
+
+  return kb->kb_ops->kb_set_unique_index (kb, enable);
 }
 
 /**
@@ -642,6 +1029,54 @@ kb_nvt_add (kb_t kb, const nvti_t *nvt, const char *filename)
   return kb->kb_ops->kb_add_nvt (kb, nvt, filename);
 }
 
+/**
+ * @brief Insert a batch of nvts.
+ *
+ * The implementation may pipeline the insertion and send the nvts in chunks
+ * to reduce the number of round trips.
+ *
+ * @param[in]  kb         KB handle where to store the nvts.
+ * @param[in]  nvts       Array of nvts to store.
+ * @param[in]  filenames  Array of paths of the nvts, same order as nvts.
+ * @param[in]  count      Number of elements in nvts and filenames.
+ * @param[in]  chunk      Number of nvts per chunk, 0 for default.
+ * @param[out] errors     Array of count elements for per nvt result (0 on
+ *                        success, non-null on error). May be NULL.
+ *
+ * @return Number of nvts which could not be stored, -1 on a connection or
+ *         transport error, after which errors is still filled.
+ */
+static inline int
+kb_nvt_add_batch (kb_t kb, const nvti_t **nvts, const char **filenames,
+                  size_t count, size_t chunk, int *errors)
+{
+  size_t i;
+  int failed = 0;
+
+  assert (kb);
+  assert (kb->kb_ops);
+
+  if (chunk == 0)
+    chunk = KB_NVT_BATCH_CHUNK_DEFAULT;
+
+  if (kb->kb_ops->kb_add_nvt_batch != NULL)
+    return kb->kb_ops->kb_add_nvt_batch (kb, nvts, filenames, count, chunk,
+                                         errors);
+
+  assert (kb->kb_ops->kb_add_nvt);
+  for (i = 0; i < count; i++)
+    {
+      int rc = kb->kb_ops->kb_add_nvt (kb, nvts[i], filenames[i]);
+
+      if (errors)
+        errors[i] = rc;
+      if (rc)
+        failed++;
+    }
+
+  return failed;
+}
+
 /**
  * @brief Get field of a NVT.
  *
@@ -661,6 +1096,40 @@ kb_nvt_get (kb_t kb, const char *oid, enum kb_nvt_pos position)
   return kb->kb_ops->kb_get_nvt (kb, oid, position);
 }
 
+/**
+ * @brief Get a field of several NVTs at once.
+ *
+ * @param[in]  kb        KB handle where the nvts are stored.
+ * @param[in]  oids      OIDs of the nvts, or filenames for the positions
+ *                       from NVT_TIMESTAMP_POS.
+ * @param[in]  count     Number of OIDs.
+ * @param[in]  position  Position of field to get.
+ * @param[out] values    Array of count elements where to store the values,
+ *                       to be freed. NULL for nvts not found.
+ *
+ * @return Number of values found, -1 on error.
+ */
+static inline int
+kb_nvt_get_many_field (kb_t kb, const char **oids, size_t count,
+                       enum kb_nvt_pos position, char **values)
+{
+  size_t i;
+  int found = 0;
+
+  assert (kb);
+  assert (kb->kb_ops);
+  assert (values);
+
+  if (kb->kb_ops->kb_get_nvt_field_many)
+    return kb->kb_ops->kb_get_nvt_field_many (kb, oids, count, position,
+                                              values);
+
+  for (i = 0; i < count; i++)
+    if ((values[i] = kb_nvt_get (kb, oids[i], position)))
+      found++;
+  return found;
+}
+
 /**
  * @brief Get a full NVT.
  *
@@ -679,6 +1148,158 @@ kb_nvt_get_all (kb_t kb, const char *oid)
   return kb->kb_ops->kb_get_nvt_all (kb, oid);
 }
 
+/**
+ * @brief Get the prefs of a NVT.
+ *
+ * @param[in] kb        KB handle where the nvt is stored.
+ * @param[in] oid       OID of NVT to get the prefs of.
+ *
+ * @return List of nvtpref_t, the last stored one first. NULL if none.
+ */
+static inline GSList *
+kb_nvt_get_prefs (kb_t kb, const char *oid)
+{
+  assert (kb);
+  assert (kb->kb_ops);
+  assert (kb->kb_ops->kb_get_nvt_prefs);
+
+  return kb->kb_ops->kb_get_nvt_prefs (kb, oid);
+}
+
+/**
+ * @brief Get several full NVTs, including their prefs, at once.
+ *
+ * @param[in]  kb     KB handle where the nvts are stored.
+ * @param[in]  oids   OIDs of the nvts to get.
+ * @param[in]  count  Number of OIDs.
+ * @param[out] nvtis  Array of count elements where to store the nvts, to be
+ *                    freed with nvti_free(). NULL for OIDs not found.
+ *
+ * @return Number of nvts found, -1 on error.
+ */
+static inline int
+kb_nvt_get_many (kb_t kb, const char **oids, size_t count, nvti_t **nvtis)
+{
+  size_t i;
+  int found = 0;
+
+  assert (kb);
+  assert (kb->kb_ops);
+  assert (nvtis);
+
+  if (kb->kb_ops->kb_get_nvt_many)
+    return kb->kb_ops->kb_get_nvt_many (kb, oids, count, nvtis);
+
+  for (i = 0; i < count; i++)
+    {
+      GSList *prefs, *pref;
+
+      nvtis[i] = kb_nvt_get_all (kb, oids[i]);
+      if (nvtis[i] == NULL)
+        continue;
+      found++;
+      if (nvti_pref_len (nvtis[i]))
+        continue;
+      /* The prefs are returned last stored first. */
+      prefs = g_slist_reverse (kb_nvt_get_prefs (kb, oids[i]));
+      for (pref = prefs; pref; pref = pref->next)
+        nvti_add_pref (nvtis[i], pref->data);
+      g_slist_free (prefs);
+    }
+  return found;
+}
+
+/**
+ * @brief Get a full NVT, including its prefs.
+ *
+ * @param[in] kb        KB handle where the nvt is stored.
+ * @param[in] oid       OID of NVT to get.
+ *
+ * @return nvti_t of NVT, to be freed with nvti_free(). NULL otherwise.
+ */
+static inline nvti_t *
+kb_nvt_get_full (kb_t kb, const char *oid)
+{
+  nvti_t *nvti = NULL;
+
+  if (kb_nvt_get_many (kb, &oid, 1, &nvti) < 0)
+    return NULL;
+  return nvti;
+}
+
+/**
+ * @brief Select the encoding of the nvts stored by a KB handle.
+ *
+ * The compact encoding stores all fields and prefs of a nvt in a single
+ * value, read back with one request. Readers understand both encodings.
+ *
+ * @param[in] kb      KB handle.
+ * @param[in] enable  1 for the compact encoding, 0 for the list encoding.
+ *
+ * @return 0 on success, -1 if not supported by the implementation.
+ */
+static inline int
+kb_nvt_set_compact (kb_t kb, int enable)
+{
+  assert (kb);
+  assert (kb->kb_ops);
+
+  if (kb->kb_ops->kb_set_nvt_compact == NULL)
+    return -1;
+
+  return kb->kb_ops->kb_set_nvt_compact (kb, enable);
+}
+
+/**
+ * @brief Get notified of changes of the values read through a KB handle.
+ *
+ * Once enabled, the server remembers the names read through the handle.
+ * When one of their values changes, kb_track_poll calls the callback with
+ * the name, so that a copy kept by the caller can be dropped. The callback
+ * gets NULL when the notifications may have been lost, e.g. on a reset of
+ * the connection, after which tracking has to be enabled again.
+ *
+ * @param[in] kb    KB handle.
+ * @param[in] cb    Callback, NULL to disable tracking.
+ * @param[in] data  User data passed to the callback.
+ *
+ * @return 0 on success, -1 if not supported by the implementation or the
+ *         server.
+ */
+static inline int
+kb_track (kb_t kb, kb_invalidate_cb cb, void *data)
+{
+  assert (kb);
+  assert (kb->kb_ops);
+
+  if (kb->kb_ops->kb_track == NULL)
+    return -1;
+
+  return kb->kb_ops->kb_track (kb, cb, data);
+}
+
+/**
+ * @brief Deliver the pending change notifications of a KB handle.
+ *
+ * Doesn't wait, calls the callback given to kb_track for each notification
+ * received so far.
+ *
+ * @param[in] kb  KB handle.
+ *
+ * @return 0 on success, -1 if tracking is not enabled or was lost.
+ */
+static inline int
+kb_track_poll (kb_t kb)
+{
+  assert (kb);
+  assert (kb->kb_ops);
+
+  if (kb->kb_ops->kb_track_poll == NULL)
+    return -1;
+
+  return kb->kb_ops->kb_track_poll (kb);
+}
+
 /**
  * @brief Get list of NVT OIDs.
  *
@@ -739,6 +1360,10 @@ kb_save (kb_t kb)
  * @brief Reset connection to the KB. This is called after each fork() to make
  *
  *        sure connections aren't shared between concurrent processes.
+ *
+ *        Connections of KBs obtained with kb_direct_conn() or kb_find() are
+ *        returned to a process-wide pool and reused by later calls, unless
+ *        they were inherited from another process.
  * @param[in] kb  KB handle.
  *
  * @return 0 on success, non-null on error.
@@ -796,4 +1421,84 @@ kb_get_kb_index (kb_t kb)
   return kb->kb_ops->kb_get_kb_index (kb);
 }
 
+/* Statistics of redis commands. */
+
+/**
+ * @brief Number of buckets of the latency histogram.
+ */
+#define KB_STATS_HIST_BUCKETS 32
+
+/**
+ * @brief Statistics of a redis command.
+ *
+ * Commands sent in a pipeline are counted under their own name, but their
+ * replies and the time spent waiting for them are counted under "PIPELINE".
+ */
+struct kb_cmd_stats
+{
+  const char *cmd;                 /**< Command name. */
+  unsigned long calls;             /**< Number of calls. */
+  unsigned long errors;            /**< Number of failed calls. */
+  unsigned long long bytes_sent;   /**< Bytes of formatted commands. */
+  unsigned long long bytes_recv;   /**< Payload bytes of the replies. */
+  unsigned long long usec_total;   /**< Total latency. */
+  unsigned long p50_usec;          /**< Median latency (approximate). */
+  unsigned long p99_usec;          /**< 99th percentile latency (approx.). */
+  unsigned long hist[KB_STATS_HIST_BUCKETS]; /**< Calls by latency, bucket i
+                                                  counts calls of less than
+                                                  2^i microseconds. */
+};
+
+struct kb_cmd_stats *
+kb_get_stats (size_t *);
+
+void
+kb_reset_stats (void);
+
+void
+kb_stats_log_on_delete (int);
+
+/* Asynchronous KB connections. */
+
+/**
+ * @brief Asynchronous connection to a KB, based on the redis asynchronous
+ *        client.
+ */
+typedef struct kb_async *kb_async_t;
+
+/**
+ * @brief Callback called when an asynchronous KB operation completed.
+ *
+ * Receives 0 on success or -1 on error, and the user data. It's called from
+ * the main context the connection is attached to.
+ */
+typedef void (*kb_async_cb) (int, void *);
+
+kb_async_t
+kb_async_new (const char *, int, GMainContext *);
+
+void
+kb_async_wait (kb_async_t);
+
+void
+kb_async_free (kb_async_t);
+
+int
+kb_async_push_str (kb_async_t, const char *, const char *, kb_async_cb,
+                   void *);
+
+int
+kb_async_add_str (kb_async_t, const char *, const char *, size_t,
+                  kb_async_cb, void *);
+
+int
+kb_async_add_str_unique (kb_async_t, const char *, const char *, size_t, int,
+                         kb_async_cb, void *);
+
+int
+kb_async_add_int (kb_async_t, const char *, int, kb_async_cb, void *);
+
+int
+kb_async_add_int_unique (kb_async_t, const char *, int, kb_async_cb, void *);
+
 #endif
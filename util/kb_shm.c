@@ -0,0 +1,1308 @@
+/* SPDX-FileCopyrightText: 2026 Greenbone AG
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/**
+ * @file
+ * @brief Knowledge base management API - Shared memory backend.
+ *
+ * A Redis-less KB for single host deployments. All KBs of a path live in one
+ * POSIX shared memory object, which every process opening the same path maps.
+ * The object holds a hash table of named lists, the same data model as the
+ * redis backend. Namespaces are identified by an index, like redis databases.
+ * All accesses are serialized by a robust, process-shared mutex stored in the
+ * object itself. References inside the object are offsets, so that processes
+ * can map it at different addresses.
+ */
+
+#define _GNU_SOURCE
+
+#include "kb.h"
+
+#include "../base/memstats.h" /* for gvm_memstats_alloc */
+
+#include <errno.h>    /* for errno, EEXIST, EOWNERDEAD */
+#include <fcntl.h>    /* for O_RDWR, O_CREAT, O_EXCL */
+#include <fnmatch.h>  /* for fnmatch */
+#include <glib.h>     /* for g_malloc0, g_free, g_strdup */
+#include <pthread.h>  /* for pthread_mutex_t */
+#include <stdint.h>   /* for uint64_t */
+#include <stdlib.h>   /* for atoi */
+#include <string.h>   /* for memcpy, strlen, strcmp */
+#include <sys/mman.h> /* for shm_open, mmap, munmap */
+#include <sys/stat.h> /* for fstat */
+#include <time.h>     /* for time */
+#include <unistd.h>   /* for ftruncate, close */
+
+#undef G_LOG_DOMAIN
+/**
+ * @brief GLib logging domain.
+ */
+#define G_LOG_DOMAIN "libgvm util"
+
+/**
+ * @brief Size of the shared memory object. Pages are only allocated when
+ *        used.
+ */
+#define KB_SHM_SIZE ((uint64_t) 1024 * 1024 * 1024)
+
+/**
+ * @brief Number of namespaces, index 0 is reserved.
+ */
+#define KB_SHM_MAX_DB 512
+
+/**
+ * @brief Number of hash table buckets.
+ */
+#define KB_SHM_BUCKETS (1 << 18)
+
+/**
+ * @brief Number of allocator size classes (powers of two).
+ */
+#define KB_SHM_CLASSES 40
+
+/**
+ * @brief Smallest allocator size class (32 bytes).
+ */
+#define KB_SHM_MIN_CLASS 5
+
+/**
+ * @brief Interval of polling for blocking pops, in microseconds.
+ */
+#define KB_SHM_POLL_USEC 10000
+
+/**
+ * @brief Marker of an initialized shared memory object.
+ */
+#define KB_SHM_MAGIC 0x47564d4b /* "GVMK" */
+
+/**
+ * @brief Version of the shared memory layout.
+ */
+#define KB_SHM_VERSION 1
+
+/**
+ * @brief Header at the start of the shared memory object.
+ */
+struct shm_header
+{
+  uint32_t magic;                       /**< KB_SHM_MAGIC once initialized. */
+  uint32_t version;                     /**< Layout version. */
+  uint64_t size;                        /**< Size of the object. */
+  uint64_t top;                         /**< Start of never allocated memory. */
+  pthread_mutex_t lock;                 /**< Lock for the whole object. */
+  uint64_t free_lists[KB_SHM_CLASSES];  /**< Free blocks per size class. */
+  uint8_t db_used[KB_SHM_MAX_DB];       /**< Namespaces in use. */
+  uint64_t buckets[KB_SHM_BUCKETS];     /**< Hash table of keys. */
+};
+
+/**
+ * @brief A named list.
+ */
+struct shm_key
+{
+  uint64_t next;    /**< Next key in the bucket. */
+  uint64_t head;    /**< First item. */
+  uint64_t tail;    /**< Last item. */
+  int64_t expire;   /**< Expiration time, 0 for none. */
+  uint32_t db;      /**< Namespace of the key. */
+  uint32_t namelen; /**< Length of the name. */
+  char name[];      /**< NUL terminated name. */
+};
+
+/**
+ * @brief An element of a list. Integers are stored as strings, like redis
+ *        does.
+ */
+struct shm_item
+{
+  uint64_t prev; /**< Previous item. */
+  uint64_t next; /**< Next item. */
+  uint64_t len;  /**< Length of the value. */
+  char data[];   /**< NUL terminated value. */
+};
+
+static const struct kb_operations KBShmOps;
+
+/**
+ * @brief Subclass of struct kb for the shared memory backend.
+ */
+struct kb_shm
+{
+  struct kb kb;            /**< Parent KB handle. */
+  struct shm_header *hdr;  /**< Mapped shared memory object. */
+  unsigned int db;         /**< Namespace index. */
+};
+#define shm_kb(__kb) ((struct kb_shm *) (__kb))
+
+#define SHM_PTR(__k, __off) ((void *) ((char *) (__k)->hdr + (__off)))
+
+/* Memory and locking. */
+
+static void
+shm_lock (struct kb_shm *k)
+{
+  /* Recover from a process which died while holding the lock. */
+  if (pthread_mutex_lock (&k->hdr->lock) == EOWNERDEAD)
+    pthread_mutex_consistent (&k->hdr->lock);
+}
+
+static void
+shm_unlock (struct kb_shm *k)
+{
+  pthread_mutex_unlock (&k->hdr->lock);
+}
+
+/**
+ * @brief Allocate memory in the shared memory object. Lock must be held.
+ *
+ * @param[in] k     KB handle.
+ * @param[in] size  Size to allocate.
+ *
+ * @return Offset of the allocated memory, 0 if out of memory.
+ */
+static uint64_t
+shm_alloc (struct kb_shm *k, size_t size)
+{
+  struct shm_header *hdr = k->hdr;
+  uint64_t off;
+  unsigned int cls = KB_SHM_MIN_CLASS;
+
+  /* Blocks start with their size class. */
+  size += sizeof (uint64_t);
+  while (cls < KB_SHM_CLASSES - 1 && ((uint64_t) 1 << cls) < size)
+    cls++;
+
+  if (hdr->free_lists[cls])
+    {
+      off = hdr->free_lists[cls];
+      hdr->free_lists[cls] = *(uint64_t *) SHM_PTR (k, off + sizeof (uint64_t));
+    }
+  else
+    {
+      if (hdr->top + ((uint64_t) 1 << cls) > hdr->size)
+        {
+          g_warning ("%s: shared memory KB is full", __func__);
+          return 0;
+        }
+      off = hdr->top;
+      hdr->top += (uint64_t) 1 << cls;
+    }
+  *(uint64_t *) SHM_PTR (k, off) = cls;
+
+  return off + sizeof (uint64_t);
+}
+
+/**
+ * @brief Release memory allocated with shm_alloc. Lock must be held.
+ *
+ * @param[in] k    KB handle.
+ * @param[in] off  Offset of the memory.
+ */
+static void
+shm_free (struct kb_shm *k, uint64_t off)
+{
+  uint64_t block = off - sizeof (uint64_t);
+  uint64_t cls = *(uint64_t *) SHM_PTR (k, block);
+
+  *(uint64_t *) SHM_PTR (k, off) = k->hdr->free_lists[cls];
+  k->hdr->free_lists[cls] = block;
+}
+
+/* Keys and lists. Lock must be held for all of these. */
+
+static uint64_t *
+shm_bucket (struct kb_shm *k, const char *name)
+{
+  /* FNV-1a */
+  uint32_t hash = 2166136261u ^ k->db;
+
+  while (*name)
+    {
+      hash ^= (unsigned char) *name++;
+      hash *= 16777619u;
+    }
+  return &k->hdr->buckets[hash % KB_SHM_BUCKETS];
+}
+
+static void
+shm_key_clear (struct kb_shm *k, struct shm_key *key)
+{
+  uint64_t off = key->head;
+
+  while (off)
+    {
+      uint64_t next = ((struct shm_item *) SHM_PTR (k, off))->next;
+
+      shm_free (k, off);
+      off = next;
+    }
+  key->head = key->tail = 0;
+}
+
+/**
+ * @brief Remove a key and its list.
+ *
+ * @param[in] k     KB handle.
+ * @param[in] link  Link pointing to the key.
+ */
+static void
+shm_key_remove (struct kb_shm *k, uint64_t *link)
+{
+  uint64_t off = *link;
+  struct shm_key *key = SHM_PTR (k, off);
+
+  shm_key_clear (k, key);
+  *link = key->next;
+  shm_free (k, off);
+}
+
+/**
+ * @brief Find a key of the handle's namespace. Expired keys are removed.
+ *
+ * @param[in]  k     KB handle.
+ * @param[in]  name  Name of the key.
+ * @param[out] link  Link pointing to the key, may be NULL.
+ *
+ * @return The key, NULL if not found.
+ */
+static struct shm_key *
+shm_key_find (struct kb_shm *k, const char *name, uint64_t **link)
+{
+  uint64_t *l = shm_bucket (k, name);
+
+  while (*l)
+    {
+      struct shm_key *key = SHM_PTR (k, *l);
+
+      if (key->db == k->db && !strcmp (key->name, name))
+        {
+          if (key->expire && key->expire <= time (NULL))
+            {
+              shm_key_remove (k, l);
+              return NULL;
+            }
+          if (link)
+            *link = l;
+          return key;
+        }
+      l = &key->next;
+    }
+  return NULL;
+}
+
+static struct shm_key *
+shm_key_get_or_create (struct kb_shm *k, const char *name)
+{
+  struct shm_key *key;
+  uint64_t *bucket, off;
+  size_t namelen;
+
+  if ((key = shm_key_find (k, name, NULL)))
+    return key;
+
+  namelen = strlen (name);
+  if (!(off = shm_alloc (k, sizeof (struct shm_key) + namelen + 1)))
+    return NULL;
+  key = SHM_PTR (k, off);
+  bucket = shm_bucket (k, name);
+  key->next = *bucket;
+  key->head = key->tail = 0;
+  key->expire = 0;
+  key->db = k->db;
+  key->namelen = namelen;
+  memcpy (key->name, name, namelen + 1);
+  *bucket = off;
+
+  return key;
+}
+
+/**
+ * @brief Push a value to a list.
+ *
+ * @param[in] k     KB handle.
+ * @param[in] key   Key of the list.
+ * @param[in] str   Value.
+ * @param[in] len   Length of value.
+ * @param[in] left  1 to push at the head, 0 at the tail.
+ *
+ * @return 0 on success, -1 if out of memory.
+ */
+static int
+shm_list_push (struct kb_shm *k, struct shm_key *key, const char *str,
+               size_t len, int left)
+{
+  struct shm_item *item;
+  uint64_t off;
+
+  if (!(off = shm_alloc (k, sizeof (struct shm_item) + len + 1)))
+    return -1;
+  item = SHM_PTR (k, off);
+  item->len = len;
+  memcpy (item->data, str, len);
+  item->data[len] = '\0';
+
+  if (left)
+    {
+      item->prev = 0;
+      item->next = key->head;
+      if (key->head)
+        ((struct shm_item *) SHM_PTR (k, key->head))->prev = off;
+      else
+        key->tail = off;
+      key->head = off;
+    }
+  else
+    {
+      item->next = 0;
+      item->prev = key->tail;
+      if (key->tail)
+        ((struct shm_item *) SHM_PTR (k, key->tail))->next = off;
+      else
+        key->head = off;
+      key->tail = off;
+    }
+  return 0;
+}
+
+static void
+shm_list_unlink (struct kb_shm *k, struct shm_key *key, uint64_t off)
+{
+  struct shm_item *item = SHM_PTR (k, off);
+
+  if (item->prev)
+    ((struct shm_item *) SHM_PTR (k, item->prev))->next = item->next;
+  else
+    key->head = item->next;
+  if (item->next)
+    ((struct shm_item *) SHM_PTR (k, item->next))->prev = item->prev;
+  else
+    key->tail = item->prev;
+  shm_free (k, off);
+}
+
+/**
+ * @brief Remove the first occurrence of a value from a list.
+ *
+ * @return 1 if a value was removed, 0 otherwise.
+ */
+static int
+shm_list_remove (struct kb_shm *k, struct shm_key *key, const char *str,
+                 size_t len)
+{
+  uint64_t off;
+
+  for (off = key->head; off;
+       off = ((struct shm_item *) SHM_PTR (k, off))->next)
+    {
+      struct shm_item *item = SHM_PTR (k, off);
+
+      if (item->len == len && !memcmp (item->data, str, len))
+        {
+          shm_list_unlink (k, key, off);
+          return 1;
+        }
+    }
+  return 0;
+}
+
+static struct shm_item *
+shm_list_index (struct kb_shm *k, struct shm_key *key, int index)
+{
+  uint64_t off = key->head;
+
+  while (off && index--)
+    off = ((struct shm_item *) SHM_PTR (k, off))->next;
+  return off ? SHM_PTR (k, off) : NULL;
+}
+
+/**
+ * @brief Remove all keys of the handle's namespace.
+ */
+static void
+shm_db_clear (struct kb_shm *k)
+{
+  unsigned int i;
+
+  for (i = 0; i < KB_SHM_BUCKETS; i++)
+    {
+      uint64_t *l = &k->hdr->buckets[i];
+
+      while (*l)
+        {
+          struct shm_key *key = SHM_PTR (k, *l);
+
+          if (key->db == k->db)
+            shm_key_remove (k, l);
+          else
+            l = &key->next;
+        }
+    }
+}
+
+/* Mapping. */
+
+/**
+ * @brief Map the shared memory object of a path, creating it if needed.
+ *
+ * @param[in] kb_path  Path to KB, "shm://<name>".
+ *
+ * @return Mapped header, NULL on error.
+ */
+static struct shm_header *
+shm_map (const char *kb_path)
+{
+  struct shm_header *hdr;
+  struct stat st;
+  char *name;
+  int fd, creator = 1, tries;
+
+  name = g_strdup_printf ("/gvm-kb-%s", kb_path + strlen (KB_SHM_SCHEME));
+  g_strdelimit (name + 1, "/", '_');
+  fd = shm_open (name, O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd < 0 && errno == EEXIST)
+    {
+      creator = 0;
+      fd = shm_open (name, O_RDWR, 0600);
+    }
+  if (fd < 0)
+    {
+      g_log (G_LOG_DOMAIN, G_LOG_LEVEL_CRITICAL, "%s: shm_open %s: %s",
+             __func__, name, strerror (errno));
+      g_free (name);
+      return NULL;
+    }
+
+  if (creator && ftruncate (fd, KB_SHM_SIZE))
+    {
+      g_log (G_LOG_DOMAIN, G_LOG_LEVEL_CRITICAL, "%s: ftruncate %s: %s",
+             __func__, name, strerror (errno));
+      close (fd);
+      shm_unlink (name);
+      g_free (name);
+      return NULL;
+    }
+  /* Wait for the creator to size the object. */
+  for (tries = 0; !creator && tries < 1000; tries++)
+    {
+      if (fstat (fd, &st) == 0 && (uint64_t) st.st_size >= KB_SHM_SIZE)
+        break;
+      g_usleep (1000);
+    }
+  g_free (name);
+
+  hdr = mmap (NULL, KB_SHM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close (fd);
+  if (hdr == MAP_FAILED)
+    {
+      g_log (G_LOG_DOMAIN, G_LOG_LEVEL_CRITICAL, "%s: mmap: %s", __func__,
+             strerror (errno));
+      return NULL;
+    }
+
+  if (creator)
+    {
+      pthread_mutexattr_t attr;
+
+      pthread_mutexattr_init (&attr);
+      pthread_mutexattr_setpshared (&attr, PTHREAD_PROCESS_SHARED);
+      pthread_mutexattr_setrobust (&attr, PTHREAD_MUTEX_ROBUST);
+      pthread_mutex_init (&hdr->lock, &attr);
+      pthread_mutexattr_destroy (&attr);
+      hdr->version = KB_SHM_VERSION;
+      hdr->size = KB_SHM_SIZE;
+      hdr->top = (sizeof (struct shm_header) + 15) & ~(uint64_t) 15;
+      __atomic_store_n (&hdr->magic, KB_SHM_MAGIC, __ATOMIC_RELEASE);
+      return hdr;
+    }
+
+  for (tries = 0; tries < 1000; tries++)
+    {
+      if (__atomic_load_n (&hdr->magic, __ATOMIC_ACQUIRE) == KB_SHM_MAGIC)
+        break;
+      g_usleep (1000);
+    }
+  if (hdr->magic != KB_SHM_MAGIC || hdr->version != KB_SHM_VERSION)
+    {
+      g_log (G_LOG_DOMAIN, G_LOG_LEVEL_CRITICAL,
+             "%s: %s is not a valid shared memory KB", __func__, kb_path);
+      munmap (hdr, KB_SHM_SIZE);
+      return NULL;
+    }
+  return hdr;
+}
+
+static struct kb_shm *
+shm_handle_new (const char *kb_path, unsigned int db)
+{
+  struct kb_shm *k;
+  struct shm_header *hdr;
+
+  if (!(hdr = shm_map (kb_path)))
+    return NULL;
+  k = g_malloc0 (sizeof (struct kb_shm));
+  k->kb.kb_ops = &KBShmOps;
+  k->hdr = hdr;
+  k->db = db;
+  return k;
+}
+
+static void
+shm_handle_free (struct kb_shm *k)
+{
+  munmap (k->hdr, KB_SHM_SIZE);
+  g_free (k);
+}
+
+/* KB operations. */
+
+/**
+ * @brief Initialize a new Knowledge Base object in a free namespace.
+ *
+ * @param[in] kb  Reference to a kb_t to initialize.
+ * @param[in] kb_path   Path to KB.
+ *
+ * @return 0 on success, -1 on connection error, -2 when no namespace is
+ *         available, -3 when given kb_path was NULL.
+ */
+static int
+shm_new (kb_t *kb, const char *kb_path)
+{
+  struct kb_shm *k;
+  unsigned int i;
+
+  if (kb_path == NULL)
+    return -3;
+  if (!(k = shm_handle_new (kb_path, 0)))
+    return -1;
+
+  shm_lock (k);
+  for (i = 1; i < KB_SHM_MAX_DB; i++)
+    if (!k->hdr->db_used[i])
+      {
+        k->hdr->db_used[i] = 1;
+        k->db = i;
+        /* Ensure that the new kb is clean */
+        shm_db_clear (k);
+        break;
+      }
+  shm_unlock (k);
+
+  if (k->db == 0)
+    {
+      g_log (G_LOG_DOMAIN, G_LOG_LEVEL_CRITICAL,
+             "No shared memory KB available");
+      shm_handle_free (k);
+      return -2;
+    }
+
+  *kb = (kb_t) k;
+  return 0;
+}
+
+static int
+shm_delete (kb_t kb)
+{
+  struct kb_shm *k = shm_kb (kb);
+
+  shm_lock (k);
+  shm_db_clear (k);
+  k->hdr->db_used[k->db] = 0;
+  shm_unlock (k);
+  shm_handle_free (k);
+  return 0;
+}
+
+static kb_t
+shm_find (const char *kb_path, const char *key)
+{
+  struct kb_shm *k;
+  unsigned int i;
+
+  if (kb_path == NULL || key == NULL)
+    return NULL;
+  if (!(k = shm_handle_new (kb_path, 0)))
+    return NULL;
+
+  shm_lock (k);
+  for (i = 1; i < KB_SHM_MAX_DB; i++)
+    {
+      if (!k->hdr->db_used[i])
+        continue;
+      k->db = i;
+      if (shm_key_find (k, key, NULL))
+        {
+          shm_unlock (k);
+          return (kb_t) k;
+        }
+    }
+  shm_unlock (k);
+
+  shm_handle_free (k);
+  return NULL;
+}
+
+static kb_t
+shm_direct_conn (const char *kb_path, const int kb_index)
+{
+  if (kb_path == NULL || kb_index <= 0 || kb_index >= KB_SHM_MAX_DB)
+    return NULL;
+  return (kb_t) shm_handle_new (kb_path, kb_index);
+}
+
+static struct kb_item *
+shm_kbitem (const char *name, const struct shm_item *item, int force_int)
+{
+  struct kb_item *kbi;
+  size_t namelen = strlen (name) + 1;
+
+  kbi = g_malloc0 (sizeof (struct kb_item) + namelen);
+  gvm_memstats_alloc (GVM_MEM_KB, sizeof (struct kb_item) + namelen);
+  if (force_int)
+    {
+      kbi->type = KB_TYPE_INT;
+      kbi->v_int = atoi (item->data);
+    }
+  else
+    {
+      kbi->type = KB_TYPE_STR;
+      kbi->v_str = g_strndup (item->data, item->len);
+      kbi->len = item->len;
+    }
+  kbi->namelen = namelen;
+  memcpy (kbi->name, name, namelen);
+  return kbi;
+}
+
+static struct kb_item *
+shm_get_single (kb_t kb, const char *name, enum kb_item_type type)
+{
+  struct kb_shm *k = shm_kb (kb);
+  struct shm_key *key;
+  struct kb_item *kbi = NULL;
+
+  shm_lock (k);
+  if ((key = shm_key_find (k, name, NULL)) && key->tail)
+    kbi = shm_kbitem (name, SHM_PTR (k, key->tail), type == KB_TYPE_INT);
+  shm_unlock (k);
+  return kbi;
+}
+
+static char *
+shm_get_str (kb_t kb, const char *name)
+{
+  struct kb_item *kbi;
+  char *res = NULL;
+
+  if ((kbi = shm_get_single (kb, name, KB_TYPE_STR)))
+    {
+      res = kbi->v_str;
+      kbi->v_str = NULL;
+      kb_item_free (kbi);
+    }
+  return res;
+}
+
+static int
+shm_get_int (kb_t kb, const char *name)
+{
+  struct kb_item *kbi;
+  int res = -1;
+
+  if ((kbi = shm_get_single (kb, name, KB_TYPE_INT)))
+    {
+      res = kbi->v_int;
+      kb_item_free (kbi);
+    }
+  return res;
+}
+
+static int
+shm_get_many (kb_t kb, const char **names, size_t count,
+              enum kb_item_type type, struct kb_item **items)
+{
+  size_t i;
+  int found = 0;
+
+  for (i = 0; i < count; i++)
+    if ((items[i] = shm_get_single (kb, names[i], type)))
+      found++;
+  return found;
+}
+
+/**
+ * @brief Get all items of a list, in the order of redis2kbitem (reversed).
+ *        Lock must be held.
+ */
+static struct kb_item *
+shm_list_items (struct kb_shm *k, struct shm_key *key)
+{
+  struct kb_item *kbi = NULL;
+  uint64_t off;
+
+  for (off = key->head; off;
+       off = ((struct shm_item *) SHM_PTR (k, off))->next)
+    {
+      struct kb_item *tmp = shm_kbitem (key->name, SHM_PTR (k, off), 0);
+
+      tmp->next = kbi;
+      kbi = tmp;
+    }
+  return kbi;
+}
+
+static struct kb_item *
+shm_get_all (kb_t kb, const char *name)
+{
+  struct kb_shm *k = shm_kb (kb);
+  struct shm_key *key;
+  struct kb_item *kbi = NULL;
+
+  shm_lock (k);
+  if ((key = shm_key_find (k, name, NULL)))
+    kbi = shm_list_items (k, key);
+  shm_unlock (k);
+  return kbi;
+}
+
+/**
+ * @brief Collect the names of the handle's namespace matching a pattern.
+ *        Lock must be held.
+ *
+ * @return GPtrArray of names.
+ */
+static GPtrArray *
+shm_match (struct kb_shm *k, const char *pattern)
+{
+  GPtrArray *names = g_ptr_array_new_with_free_func (g_free);
+  time_t now = time (NULL);
+  unsigned int i;
+
+  for (i = 0; i < KB_SHM_BUCKETS; i++)
+    {
+      uint64_t off;
+
+      for (off = k->hdr->buckets[i]; off;
+           off = ((struct shm_key *) SHM_PTR (k, off))->next)
+        {
+          struct shm_key *key = SHM_PTR (k, off);
+
+          if (key->db == k->db && (!key->expire || key->expire > now)
+              && key->head && !fnmatch (pattern, key->name, 0))
+            g_ptr_array_add (names, g_strdup (key->name));
+        }
+    }
+  return names;
+}
+
+static struct kb_item *
+shm_get_pattern (kb_t kb, const char *pattern)
+{
+  struct kb_shm *k = shm_kb (kb);
+  struct kb_item *kbi = NULL;
+  GPtrArray *names;
+  unsigned int i;
+
+  shm_lock (k);
+  names = shm_match (k, pattern);
+  for (i = 0; i < names->len; i++)
+    {
+      struct shm_key *key;
+      struct kb_item *tmp, *last;
+
+      if (!(key = shm_key_find (k, g_ptr_array_index (names, i), NULL))
+          || !(tmp = shm_list_items (k, key)))
+        continue;
+      for (last = tmp; last->next; last = last->next)
+        ;
+      last->next = kbi;
+      kbi = tmp;
+    }
+  shm_unlock (k);
+  g_ptr_array_free (names, TRUE);
+  return kbi;
+}
+
+static int
+shm_iterate_pattern (kb_t kb, const char *pattern, kb_pattern_cb cb,
+                     void *user_data)
+{
+  struct kb_shm *k = shm_kb (kb);
+  GPtrArray *names;
+  unsigned int i;
+  int rc = 0;
+
+  shm_lock (k);
+  names = shm_match (k, pattern);
+  shm_unlock (k);
+
+  /* Callbacks are called without the lock, they may use the KB. */
+  for (i = 0; i < names->len && rc == 0; i++)
+    if (cb (g_ptr_array_index (names, i), user_data))
+      rc = 1;
+  g_ptr_array_free (names, TRUE);
+  return rc;
+}
+
+static size_t
+shm_count (kb_t kb, const char *pattern)
+{
+  struct kb_shm *k = shm_kb (kb);
+  GPtrArray *names;
+  size_t count;
+
+  shm_lock (k);
+  names = shm_match (k, pattern);
+  shm_unlock (k);
+  count = names->len;
+  g_ptr_array_free (names, TRUE);
+  return count;
+}
+
+static GSList *
+shm_get_oids (kb_t kb)
+{
+  struct kb_shm *k = shm_kb (kb);
+  GPtrArray *names;
+  GSList *list = NULL;
+  unsigned int i;
+
+  shm_lock (k);
+  names = shm_match (k, "nvt:*");
+  shm_unlock (k);
+  /* Fetch OID values from key names nvt:OID. */
+  for (i = 0; i < names->len; i++)
+    list = g_slist_prepend (
+      list, g_strdup ((char *) g_ptr_array_index (names, i) + 4));
+  g_ptr_array_free (names, TRUE);
+  return list;
+}
+
+/**
+ * @brief Insert a value into a list.
+ *
+ * @param[in] kb      KB handle.
+ * @param[in] name    Item name.
+ * @param[in] str     Item value.
+ * @param[in] len     Value length, 0 for strlen(str).
+ * @param[in] left    1 to push at the head, 0 at the tail.
+ * @param[in] unique  Whether to remove a previous occurrence of the value.
+ * @param[in] replace Whether to remove all previous values.
+ * @param[in] expire  Expiration in seconds, 0 for none.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+shm_insert (kb_t kb, const char *name, const char *str, size_t len, int left,
+            int unique, int replace, int expire)
+{
+  struct kb_shm *k = shm_kb (kb);
+  struct shm_key *key;
+  int rc = -1;
+
+  if (name == NULL || str == NULL)
+    return -1;
+  if (len == 0)
+    len = strlen (str);
+
+  shm_lock (k);
+  if ((key = shm_key_get_or_create (k, name)))
+    {
+      if (replace)
+        shm_key_clear (k, key);
+      else if (unique && shm_list_remove (k, key, str, len))
+        g_debug ("Key '%s' already contained value '%.*s'", name, (int) len,
+                 str);
+      rc = shm_list_push (k, key, str, len, left);
+      if (expire > 0)
+        key->expire = time (NULL) + expire;
+    }
+  shm_unlock (k);
+  return rc;
+}
+
+static int
+shm_push_str (kb_t kb, const char *name, const char *value)
+{
+  return shm_insert (kb, name, value, 0, 1, 0, 0, 0);
+}
+
+static char *
+shm_pop_str (kb_t kb, const char *name)
+{
+  struct kb_shm *k = shm_kb (kb);
+  struct shm_key *key;
+  uint64_t *link;
+  char *value = NULL;
+
+  shm_lock (k);
+  if ((key = shm_key_find (k, name, &link)) && key->tail)
+    {
+      value = g_strdup (((struct shm_item *) SHM_PTR (k, key->tail))->data);
+      shm_list_unlink (k, key, key->tail);
+      /* Like redis, drop empty lists. */
+      if (!key->head)
+        shm_key_remove (k, link);
+    }
+  shm_unlock (k);
+  return value;
+}
+
+static char *
+shm_pop_str_blocking (kb_t kb, const char *name, int timeout)
+{
+  gint64 end = g_get_monotonic_time () + (gint64) timeout * G_USEC_PER_SEC;
+  char *value;
+
+  /* There is no notification, poll. */
+  while ((value = shm_pop_str (kb, name)) == NULL
+         && (timeout <= 0 || g_get_monotonic_time () < end))
+    g_usleep (KB_SHM_POLL_USEC);
+  return value;
+}
+
+static int
+shm_pop_str_many (kb_t kb, const char *name, size_t count, char **values)
+{
+  struct kb_shm *k = shm_kb (kb);
+  struct shm_key *key;
+  uint64_t *link;
+  size_t n = 0;
+
+  shm_lock (k);
+  if ((key = shm_key_find (k, name, &link)))
+    {
+      while (n < count && key->tail)
+        {
+          values[n++] =
+            g_strdup (((struct shm_item *) SHM_PTR (k, key->tail))->data);
+          shm_list_unlink (k, key, key->tail);
+        }
+      if (!key->head)
+        shm_key_remove (k, link);
+    }
+  shm_unlock (k);
+  return n;
+}
+
+static int
+shm_add_str (kb_t kb, const char *name, const char *str, size_t len)
+{
+  return shm_insert (kb, name, str, len, 0, 0, 0, 0);
+}
+
+static int
+shm_add_str_unique (kb_t kb, const char *name, const char *str, size_t len,
+                    int pos)
+{
+  return shm_insert (kb, name, str, len, pos, 1, 0, 0);
+}
+
+static int
+shm_add_str_unique_volatile (kb_t kb, const char *name, const char *str,
+                             int expire, size_t len, int pos)
+{
+  return shm_insert (kb, name, str, len, pos, 1, 0, expire);
+}
+
+static int
+shm_set_str (kb_t kb, const char *name, const char *val, size_t len)
+{
+  return shm_insert (kb, name, val, len, 0, 0, 1, 0);
+}
+
+static int
+shm_add_int (kb_t kb, const char *name, int val)
+{
+  char str[16];
+
+  g_snprintf (str, sizeof (str), "%d", val);
+  return shm_insert (kb, name, str, 0, 0, 0, 0, 0);
+}
+
+static int
+shm_add_int_unique (kb_t kb, const char *name, int val)
+{
+  char str[16];
+
+  g_snprintf (str, sizeof (str), "%d", val);
+  return shm_insert (kb, name, str, 0, 0, 1, 0, 0);
+}
+
+static int
+shm_add_int_unique_volatile (kb_t kb, const char *name, int val, int expire)
+{
+  char str[16];
+
+  g_snprintf (str, sizeof (str), "%d", val);
+  return shm_insert (kb, name, str, 0, 0, 1, 0, expire);
+}
+
+static int
+shm_set_int (kb_t kb, const char *name, int val)
+{
+  char str[16];
+
+  g_snprintf (str, sizeof (str), "%d", val);
+  return shm_insert (kb, name, str, 0, 0, 0, 1, 0);
+}
+
+static int
+shm_del_items (kb_t kb, const char *name)
+{
+  struct kb_shm *k = shm_kb (kb);
+  uint64_t *link;
+
+  shm_lock (k);
+  if (shm_key_find (k, name, &link))
+    shm_key_remove (k, link);
+  shm_unlock (k);
+  return 0;
+}
+
+static char *
+shm_get_nvt (kb_t kb, const char *oid, enum kb_nvt_pos position)
+{
+  struct kb_shm *k = shm_kb (kb);
+  struct shm_key *key;
+  struct shm_item *item;
+  char name[4096], *res = NULL;
+  int index;
+
+  if (position >= NVT_TIMESTAMP_POS)
+    {
+      g_snprintf (name, sizeof (name), "filename:%s", oid);
+      index = position - NVT_TIMESTAMP_POS;
+    }
+  else
+    {
+      g_snprintf (name, sizeof (name), "nvt:%s", oid);
+      index = position;
+    }
+
+  shm_lock (k);
+  if ((key = shm_key_find (k, name, NULL))
+      && (item = shm_list_index (k, key, index)))
+    res = g_strdup (item->data);
+  shm_unlock (k);
+  return res;
+}
+
+static nvti_t *
+shm_get_nvt_all (kb_t kb, const char *oid)
+{
+  struct kb_shm *k = shm_kb (kb);
+  struct shm_key *key;
+  char name[4096], *fields[NVT_NAME_POS + 1];
+  nvti_t *nvti = NULL;
+  int i;
+
+  g_snprintf (name, sizeof (name), "nvt:%s", oid);
+  shm_lock (k);
+  if (!(key = shm_key_find (k, name, NULL)))
+    {
+      shm_unlock (k);
+      return NULL;
+    }
+  for (i = 0; i <= NVT_NAME_POS; i++)
+    {
+      struct shm_item *item = shm_list_index (k, key, i);
+
+      if (!item)
+        break;
+      fields[i] = item->data;
+    }
+  if (i > NVT_NAME_POS)
+    {
+      nvti = nvti_new ();
+      nvti_set_oid (nvti, oid);
+      nvti_set_required_keys (nvti, fields[NVT_REQUIRED_KEYS_POS]);
+      nvti_set_mandatory_keys (nvti, fields[NVT_MANDATORY_KEYS_POS]);
+      nvti_set_excluded_keys (nvti, fields[NVT_EXCLUDED_KEYS_POS]);
+      nvti_set_required_udp_ports (nvti, fields[NVT_REQUIRED_UDP_PORTS_POS]);
+      nvti_set_required_ports (nvti, fields[NVT_REQUIRED_PORTS_POS]);
+      nvti_set_dependencies (nvti, fields[NVT_DEPENDENCIES_POS]);
+      nvti_set_tag (nvti, fields[NVT_TAGS_POS]);
+      nvti_add_refs (nvti, "cve", fields[NVT_CVES_POS], "");
+      nvti_add_refs (nvti, "bid", fields[NVT_BIDS_POS], "");
+      nvti_add_refs (nvti, NULL, fields[NVT_XREFS_POS], "");
+      nvti_set_category (nvti, atoi (fields[NVT_CATEGORY_POS]));
+      nvti_set_family (nvti, fields[NVT_FAMILY_POS]);
+      nvti_set_name (nvti, fields[NVT_NAME_POS]);
+    }
+  shm_unlock (k);
+  return nvti;
+}
+
+/**
+ * @brief Get the prefs of a NVT.
+ *
+ * @return List of nvtpref_t, the last stored one first. NULL if none.
+ */
+static GSList *
+shm_get_nvt_prefs (kb_t kb, const char *oid)
+{
+  struct kb_item *prefs, *element;
+  char name[4096];
+  GSList *list = NULL;
+
+  g_snprintf (name, sizeof (name), "oid:%s:prefs", oid);
+  prefs = element = shm_get_all (kb, name);
+  while (element)
+    {
+      char **array = g_strsplit (element->v_str, "|||", -1);
+
+      if (g_strv_length (array) == 4)
+        list = g_slist_prepend (
+          list, nvtpref_new (atoi (array[0]), array[1], array[2], array[3]));
+      g_strfreev (array);
+      element = element->next;
+    }
+  kb_item_free (prefs);
+
+  /* Like the redis backend, the last stored pref comes first. */
+  return g_slist_reverse (list);
+}
+
+static int
+shm_add_nvt (kb_t kb, const nvti_t *nvt, const char *filename)
+{
+  char name[4096], value[64];
+  gchar *cves, *bids, *xrefs, *category;
+  const char *fields[NVT_NAME_POS + 1];
+  unsigned int i;
+  int rc = 0;
+
+  if (!nvt || !filename)
+    return -1;
+
+  nvti_refs_split_str (nvt, &cves, &bids, &xrefs);
+  category = g_strdup_printf ("%d", nvti_category (nvt));
+  fields[NVT_FILENAME_POS] = filename;
+  fields[NVT_REQUIRED_KEYS_POS] = nvti_required_keys (nvt);
+  fields[NVT_MANDATORY_KEYS_POS] = nvti_mandatory_keys (nvt);
+  fields[NVT_EXCLUDED_KEYS_POS] = nvti_excluded_keys (nvt);
+  fields[NVT_REQUIRED_UDP_PORTS_POS] = nvti_required_udp_ports (nvt);
+  fields[NVT_REQUIRED_PORTS_POS] = nvti_required_ports (nvt);
+  fields[NVT_DEPENDENCIES_POS] = nvti_dependencies (nvt);
+  fields[NVT_TAGS_POS] = nvti_tag (nvt);
+  fields[NVT_CVES_POS] = cves;
+  fields[NVT_BIDS_POS] = bids;
+  fields[NVT_XREFS_POS] = xrefs;
+  fields[NVT_CATEGORY_POS] = category;
+  fields[NVT_FAMILY_POS] = nvti_family (nvt);
+  fields[NVT_NAME_POS] = nvti_name (nvt);
+
+  g_snprintf (name, sizeof (name), "nvt:%s", nvti_oid (nvt));
+  for (i = 0; i <= NVT_NAME_POS; i++)
+    if (shm_add_str (kb, name, fields[i] ? fields[i] : "", 0))
+      rc = -1;
+  g_free (cves);
+  g_free (bids);
+  g_free (xrefs);
+  g_free (category);
+
+  g_snprintf (name, sizeof (name), "oid:%s:prefs", nvti_oid (nvt));
+  if (nvti_pref_len (nvt))
+    shm_del_items (kb, name);
+  for (i = 0; i < nvti_pref_len (nvt); i++)
+    {
+      const nvtpref_t *pref = nvti_pref (nvt, i);
+      gchar *str;
+
+      str = g_strdup_printf ("%d|||%s|||%s|||%s", nvtpref_id (pref),
+                             nvtpref_name (pref), nvtpref_type (pref),
+                             nvtpref_default (pref));
+      if (shm_add_str (kb, name, str, 0))
+        rc = -1;
+      g_free (str);
+    }
+
+  g_snprintf (name, sizeof (name), "filename:%s", filename);
+  g_snprintf (value, sizeof (value), "%lu", (unsigned long) time (NULL));
+  if (shm_add_str (kb, name, value, 0)
+      || shm_add_str (kb, name, nvti_oid (nvt), 0))
+    rc = -1;
+
+  return rc;
+}
+
+static int
+shm_lnk_reset (kb_t kb)
+{
+  /* The mapping and the lock are shared with forked children on purpose. */
+  (void) kb;
+  return 0;
+}
+
+static int
+shm_flush_all (kb_t kb, const char *except)
+{
+  struct kb_shm *k = shm_kb (kb);
+  unsigned int i;
+
+  g_debug ("%s: deleting all shared memory KBs except %s", __func__, except);
+  shm_lock (k);
+  for (i = 1; i < KB_SHM_MAX_DB; i++)
+    {
+      if (!k->hdr->db_used[i])
+        continue;
+      k->db = i;
+      /* Don't remove KB if it has "except" key. */
+      if (except && shm_key_find (k, except, NULL))
+        continue;
+      shm_db_clear (k);
+      k->hdr->db_used[i] = 0;
+    }
+  shm_unlock (k);
+
+  shm_handle_free (k);
+  return 0;
+}
+
+static int
+shm_get_kb_index (kb_t kb)
+{
+  return shm_kb (kb)->db ? (int) shm_kb (kb)->db : -1;
+}
+
+/**
+ * @brief Shared memory KB operations.
+ */
+static const struct kb_operations KBShmOps = {
+  .kb_new = shm_new,
+  .kb_find = shm_find,
+  .kb_delete = shm_delete,
+  .kb_get_single = shm_get_single,
+  .kb_get_str = shm_get_str,
+  .kb_get_int = shm_get_int,
+  .kb_get_many = shm_get_many,
+  .kb_get_nvt = shm_get_nvt,
+  .kb_get_nvt_all = shm_get_nvt_all,
+  .kb_get_nvt_prefs = shm_get_nvt_prefs,
+  .kb_get_nvt_oids = shm_get_oids,
+  .kb_push_str = shm_push_str,
+  .kb_pop_str = shm_pop_str,
+  .kb_pop_str_blocking = shm_pop_str_blocking,
+  .kb_pop_str_many = shm_pop_str_many,
+  .kb_get_all = shm_get_all,
+  .kb_get_pattern = shm_get_pattern,
+  .kb_count = shm_count,
+  .kb_iterate_pattern = shm_iterate_pattern,
+  .kb_add_str = shm_add_str,
+  .kb_add_str_unique = shm_add_str_unique,
+  .kb_add_str_unique_volatile = shm_add_str_unique_volatile,
+  .kb_set_str = shm_set_str,
+  .kb_add_int = shm_add_int,
+  .kb_add_int_unique = shm_add_int_unique,
+  .kb_add_int_unique_volatile = shm_add_int_unique_volatile,
+  .kb_set_int = shm_set_int,
+  .kb_add_nvt = shm_add_nvt,
+  .kb_del_items = shm_del_items,
+  .kb_lnk_reset = shm_lnk_reset,
+  .kb_flush = shm_flush_all,
+  .kb_direct_conn = shm_direct_conn,
+  .kb_get_kb_index = shm_get_kb_index};
+
+const struct kb_operations *KBShmOperations = &KBShmOps;
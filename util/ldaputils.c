@@ -36,6 +36,13 @@
  * LDAP directory server.
  */
 
+static gboolean
+ldap_pool_enabled (void);
+
+static int
+ldap_pool_authenticate (ldap_auth_info_t, const gchar *, const gchar *,
+                        const gchar *);
+
 /**
  * @brief Wrapper function to use glib logging for LDAP debug logging.
  */
@@ -107,6 +114,14 @@ ldap_connect_authenticate (
 
   dn = ldap_auth_info_auth_dn (info, username);
 
+  if (ldap_pool_enabled ())
+    {
+      int ret = ldap_pool_authenticate (info, dn, password, cacert);
+
+      g_free (dn);
+      return ret;
+    }
+
   ldap = ldap_auth_bind_2 (info->ldap_host, dn, password,
                            !info->allow_plaintext, cacert, info->ldaps_only);
 
@@ -387,83 +402,84 @@ ldap_init_internal_ldaps_only (const char *host)
 }
 
 /**
- * @brief Setup and bind to an LDAP.
+ * @brief Write a CA certificate to a temporary file and use it for TLS.
  *
- * @param[in] host              Host to connect to.
- * @param[in] userdn            DN to authenticate against
- * @param[in] password          Password for userdn.
- * @param[in] force_encryption  Whether or not to abort if connection
- *                              encryption via StartTLS or ldaps failed.
- * @param[in] cacert            CA Certificate for LDAP_OPT_X_TLS_CACERTFILE,
- *                              or NULL.
- * @param[in] ldaps_only        Whether to try only LDAPS.
+ * @param[in]  cacert  CA Certificate for LDAP_OPT_X_TLS_CACERTFILE, or NULL.
+ * @param[out] name    Name of the file.
  *
- * @return LDAP Handle or NULL if an error occurred, authentication failed etc.
+ * @return File descriptor, or -1 if there is no file.
  */
-LDAP *
-ldap_auth_bind_2 (const gchar *host, const gchar *userdn, const gchar *password,
-                  gboolean force_encryption, const gchar *cacert,
-                  gboolean ldaps_only)
+static gint
+ldap_cacert_file_new (const gchar *cacert, gchar **name)
 {
-  LDAP *ldap;
-  int ldap_return;
-  struct berval credential;
-  gchar *name;
+  GError *error = NULL;
   gint fd;
 
-  if (host == NULL || userdn == NULL || password == NULL)
-    return NULL;
-
-  // Prevent empty password, bind against ADS will succeed with
-  // empty password by default.
-  if (strlen (password) == 0)
-    return NULL;
-
-  if (force_encryption == FALSE)
-    g_warning ("Allowed plaintext LDAP authentication.");
+  if (cacert == NULL)
+    return -1;
 
-  if (cacert)
+  fd = g_file_open_tmp (NULL, name, &error);
+  if (fd == -1)
+    {
+      g_warning ("Could not open temp file for LDAP CACERTFILE: %s",
+                 error->message);
+      g_error_free (error);
+    }
+  else
     {
-      GError *error;
+      if (g_chmod (*name, 0600))
+        g_warning ("Could not chmod for LDAP CACERTFILE");
 
-      error = NULL;
-      fd = g_file_open_tmp (NULL, &name, &error);
-      if (fd == -1)
+      g_file_set_contents (*name, cacert, strlen (cacert), &error);
+      if (error)
         {
-          g_warning ("Could not open temp file for LDAP CACERTFILE: %s",
-                     error->message);
+          g_warning ("Could not write LDAP CACERTFILE: %s", error->message);
           g_error_free (error);
         }
       else
         {
-          if (g_chmod (name, 0600))
-            g_warning ("Could not chmod for LDAP CACERTFILE");
-
-          g_file_set_contents (name, cacert, strlen (cacert), &error);
-          if (error)
-            {
-              g_warning ("Could not write LDAP CACERTFILE: %s", error->message);
-              g_error_free (error);
-            }
-          else
-            {
-              if (ldap_set_option (NULL, LDAP_OPT_X_TLS_CACERTFILE, name)
-                  != LDAP_OPT_SUCCESS)
-                g_warning ("Could not set LDAP CACERTFILE option.");
-            }
+          if (ldap_set_option (NULL, LDAP_OPT_X_TLS_CACERTFILE, *name)
+              != LDAP_OPT_SUCCESS)
+            g_warning ("Could not set LDAP CACERTFILE option.");
         }
     }
-  else
-    fd = -1;
-
-  if (ldaps_only)
-    ldap = ldap_init_internal_ldaps_only (host);
-  else
-    ldap = ldap_init_internal (host, force_encryption);
+  return fd;
+}
 
-  if (ldap == NULL)
-    goto fail;
+/**
+ * @brief Remove the temporary file of a CA certificate.
+ *
+ * @param[in]  fd    File descriptor, or -1 if there is no file.
+ * @param[in]  name  Name of the file.
+ */
+static void
+ldap_cacert_file_free (gint fd, gchar *name)
+{
+  if (fd > -1)
+    {
+      g_unlink (name);
+      close (fd);
+      g_free (name);
+    }
+}
 
+/**
+ * @brief Bind an LDAP connection as a user.
+ *
+ * If the DN starts with a uid attribute the DN of the user is searched for
+ * first, with an anonymous bind.
+ *
+ * @param[in] ldap      LDAP connection.
+ * @param[in] userdn    DN to authenticate against
+ * @param[in] password  Password for userdn.
+ *
+ * @return LDAP_SUCCESS on success, else the LDAP error.
+ */
+static int
+ldap_auth_bind_user (LDAP *ldap, const gchar *userdn, const gchar *password)
+{
+  int ldap_return;
+  struct berval credential;
   int do_search = 0;
   LDAPDN dn = NULL;
   gchar *use_dn = NULL;
@@ -501,7 +517,8 @@ ldap_auth_bind_2 (const gchar *host, const gchar *userdn, const gchar *password,
         {
           g_warning ("LDAP anonymous authentication failure: %s",
                      ldap_err2string (ldap_return));
-          goto fail;
+          g_strfreev (uid);
+          return ldap_return;
         }
       else
         {
@@ -535,38 +552,344 @@ ldap_auth_bind_2 (const gchar *host, const gchar *userdn, const gchar *password,
   else
     use_dn = g_strdup (userdn);
 
-  if (use_dn != NULL)
+  credential.bv_val = g_strdup (password);
+  credential.bv_len = strlen (password);
+  ldap_return = ldap_sasl_bind_s (ldap, use_dn, LDAP_SASL_SIMPLE, &credential,
+                                  NULL, NULL, NULL);
+  g_free (credential.bv_val);
+  g_free (use_dn);
+  if (ldap_return != LDAP_SUCCESS)
+    g_warning ("LDAP authentication failure: %s.",
+               ldap_err2string (ldap_return));
+  return ldap_return;
+}
+
+/**
+ * @brief Setup and bind to an LDAP.
+ *
+ * @param[in] host              Host to connect to.
+ * @param[in] userdn            DN to authenticate against
+ * @param[in] password          Password for userdn.
+ * @param[in] force_encryption  Whether or not to abort if connection
+ *                              encryption via StartTLS or ldaps failed.
+ * @param[in] cacert            CA Certificate for LDAP_OPT_X_TLS_CACERTFILE,
+ *                              or NULL.
+ * @param[in] ldaps_only        Whether to try only LDAPS.
+ *
+ * @return LDAP Handle or NULL if an error occurred, authentication failed etc.
+ */
+LDAP *
+ldap_auth_bind_2 (const gchar *host, const gchar *userdn, const gchar *password,
+                  gboolean force_encryption, const gchar *cacert,
+                  gboolean ldaps_only)
+{
+  LDAP *ldap;
+  gchar *name = NULL;
+  gint fd;
+
+  if (host == NULL || userdn == NULL || password == NULL)
+    return NULL;
+
+  // Prevent empty password, bind against ADS will succeed with
+  // empty password by default.
+  if (strlen (password) == 0)
+    return NULL;
+
+  if (force_encryption == FALSE)
+    g_warning ("Allowed plaintext LDAP authentication.");
+
+  fd = ldap_cacert_file_new (cacert, &name);
+
+  if (ldaps_only)
+    ldap = ldap_init_internal_ldaps_only (host);
+  else
+    ldap = ldap_init_internal (host, force_encryption);
+
+  if (ldap && ldap_auth_bind_user (ldap, userdn, password) != LDAP_SUCCESS)
     {
-      credential.bv_val = g_strdup (password);
-      credential.bv_len = strlen (password);
-      ldap_return = ldap_sasl_bind_s (ldap, use_dn, LDAP_SASL_SIMPLE,
-                                      &credential, NULL, NULL, NULL);
-      g_free (credential.bv_val);
-      g_free (use_dn);
-      if (ldap_return != LDAP_SUCCESS)
+      ldap_unbind_ext_s (ldap, NULL, NULL);
+      ldap = NULL;
+    }
+
+  ldap_cacert_file_free (fd, name);
+  return ldap;
+}
+
+/**
+ * @brief Idle LDAP connection of the pool.
+ */
+typedef struct
+{
+  LDAP *ldap;  ///< Connection, with TLS established.
+  gint64 used; ///< When it was last used, monotonic.
+} ldap_pooled_t;
+
+static GHashTable *ldap_pool = NULL; ///< Idle connections, by server key.
+static GMutex ldap_pool_mutex;       ///< Lock for the pool.
+static guint ldap_pool_max_idle;     ///< Idle connections per server.
+static gint64 ldap_pool_timeout;     ///< Microseconds a connection may idle.
+
+/**
+ * @brief Close the idle connections of a server.
+ *
+ * @param[in] queue  Idle connections.
+ */
+static void
+ldap_pool_queue_free (gpointer queue)
+{
+  ldap_pooled_t *pooled;
+
+  while ((pooled = g_queue_pop_head (queue)))
+    {
+      ldap_unbind_ext_s (pooled->ldap, NULL, NULL);
+      g_free (pooled);
+    }
+  g_queue_free (queue);
+}
+
+/**
+ * @brief Enable pooling of LDAP connections for ldap_connect_authenticate.
+ *
+ * Connections are kept after an authentication and bound again for the
+ * next user of the same server, saving the TCP and TLS handshakes.
+ *
+ * @param[in] max_idle      Idle connections kept per server.
+ * @param[in] idle_timeout  Seconds an idle connection is kept.
+ *
+ * @return 0 success, -1 error.
+ */
+int
+ldap_auth_pool_enable (guint max_idle, guint idle_timeout)
+{
+  if (max_idle == 0)
+    return -1;
+
+  g_mutex_lock (&ldap_pool_mutex);
+  if (ldap_pool == NULL)
+    ldap_pool = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                       ldap_pool_queue_free);
+  ldap_pool_max_idle = max_idle;
+  ldap_pool_timeout = (gint64) idle_timeout * G_USEC_PER_SEC;
+  g_mutex_unlock (&ldap_pool_mutex);
+  return 0;
+}
+
+/**
+ * @brief Disable pooling of LDAP connections and close the idle ones.
+ */
+void
+ldap_auth_pool_disable (void)
+{
+  GHashTable *pool;
+
+  g_mutex_lock (&ldap_pool_mutex);
+  pool = ldap_pool;
+  ldap_pool = NULL;
+  g_mutex_unlock (&ldap_pool_mutex);
+  if (pool)
+    g_hash_table_destroy (pool);
+}
+
+/**
+ * @brief Check whether pooling of LDAP connections is enabled.
+ *
+ * @return TRUE if enabled, else FALSE.
+ */
+static gboolean
+ldap_pool_enabled (void)
+{
+  gboolean enabled;
+
+  g_mutex_lock (&ldap_pool_mutex);
+  enabled = ldap_pool != NULL;
+  g_mutex_unlock (&ldap_pool_mutex);
+  return enabled;
+}
+
+/**
+ * @brief Get the pool key of a server.
+ *
+ * Connections are only shared between the same host, encryption settings
+ * and CA certificate.
+ *
+ * @param[in] info    Schema and address to use.
+ * @param[in] cacert  CA Certificate, or NULL.
+ *
+ * @return Key, free with g_free.
+ */
+static gchar *
+ldap_pool_key (ldap_auth_info_t info, const gchar *cacert)
+{
+  gchar *checksum, *key;
+
+  checksum = cacert ? g_compute_checksum_for_string (G_CHECKSUM_SHA256,
+                                                     cacert, -1)
+                    : NULL;
+  key = g_strdup_printf ("%s\n%d%d\n%s", info->ldap_host,
+                         info->allow_plaintext ? 1 : 0,
+                         info->ldaps_only ? 1 : 0, checksum ? checksum : "");
+  g_free (checksum);
+  return key;
+}
+
+/**
+ * @brief Take an idle connection from the pool.
+ *
+ * Connections idle for too long are closed.
+ *
+ * @param[in] key  Pool key of the server.
+ *
+ * @return Connection, or NULL if there is none.
+ */
+static LDAP *
+ldap_pool_take (const gchar *key)
+{
+  GQueue *queue;
+  ldap_pooled_t *pooled;
+  gint64 now = g_get_monotonic_time ();
+  LDAP *ldap = NULL;
+  GSList *expired = NULL;
+
+  g_mutex_lock (&ldap_pool_mutex);
+  queue = ldap_pool ? g_hash_table_lookup (ldap_pool, key) : NULL;
+  while (queue && ldap == NULL && (pooled = g_queue_pop_tail (queue)))
+    {
+      if (now - pooled->used > ldap_pool_timeout)
+        expired = g_slist_prepend (expired, pooled->ldap);
+      else
+        ldap = pooled->ldap;
+      g_free (pooled);
+    }
+  g_mutex_unlock (&ldap_pool_mutex);
+
+  /* Close outside the lock, as unbinding talks to the server. */
+  while (expired)
+    {
+      ldap_unbind_ext_s (expired->data, NULL, NULL);
+      expired = g_slist_delete_link (expired, expired);
+    }
+  return ldap;
+}
+
+/**
+ * @brief Return a connection to the pool, or close it if the pool is full.
+ *
+ * @param[in] key   Pool key of the server.
+ * @param[in] ldap  Connection.
+ */
+static void
+ldap_pool_release (const gchar *key, LDAP *ldap)
+{
+  GQueue *queue;
+
+  g_mutex_lock (&ldap_pool_mutex);
+  if (ldap_pool)
+    {
+      queue = g_hash_table_lookup (ldap_pool, key);
+      if (queue == NULL)
         {
-          g_warning ("LDAP authentication failure: %s.",
-                     ldap_err2string (ldap_return));
-          goto fail;
+          queue = g_queue_new ();
+          g_hash_table_insert (ldap_pool, g_strdup (key), queue);
+        }
+      if (g_queue_get_length (queue) < ldap_pool_max_idle)
+        {
+          ldap_pooled_t *pooled = g_malloc (sizeof (ldap_pooled_t));
+
+          pooled->ldap = ldap;
+          pooled->used = g_get_monotonic_time ();
+          g_queue_push_tail (queue, pooled);
+          ldap = NULL;
         }
+    }
+  g_mutex_unlock (&ldap_pool_mutex);
+
+  if (ldap)
+    ldap_unbind_ext_s (ldap, NULL, NULL);
+}
+
+/**
+ * @brief Whether an LDAP error means that the connection is unusable.
+ *
+ * @param[in] ldap_return  LDAP error.
+ *
+ * @return TRUE if the connection has to be closed, else FALSE.
+ */
+static gboolean
+ldap_error_is_fatal (int ldap_return)
+{
+  return ldap_return == LDAP_SERVER_DOWN || ldap_return == LDAP_CONNECT_ERROR
+         || ldap_return == LDAP_TIMEOUT || ldap_return == LDAP_UNAVAILABLE
+         || ldap_return == LDAP_BUSY || ldap_return == LDAP_LOCAL_ERROR
+         || ldap_return == LDAP_ENCODING_ERROR
+         || ldap_return == LDAP_DECODING_ERROR;
+}
+
+/**
+ * @brief Authenticate with a pooled connection.
+ *
+ * An idle connection is bound again as the user.  If the bind shows that the
+ * connection is gone, a new one is opened.
+ *
+ * @param[in] info      Schema and address to use.
+ * @param[in] dn        DN to authenticate against.
+ * @param[in] password  Password to use.
+ * @param[in] cacert    CA Certificate for LDAP_OPT_X_TLS_CACERTFILE, or NULL.
+ *
+ * @return 0 authentication success, -1 failure or error.
+ */
+static int
+ldap_pool_authenticate (ldap_auth_info_t info, const gchar *dn,
+                        const gchar *password, const gchar *cacert)
+{
+  LDAP *ldap;
+  gchar *key, *name = NULL;
+  gint fd;
+  int ldap_return;
 
-      if (fd > -1)
+  // Prevent empty password, bind against ADS will succeed with
+  // empty password by default.
+  if (dn == NULL || strlen (password) == 0)
+    return -1;
+
+  key = ldap_pool_key (info, cacert);
+  while ((ldap = ldap_pool_take (key)))
+    {
+      ldap_return = ldap_auth_bind_user (ldap, dn, password);
+      if (!ldap_error_is_fatal (ldap_return))
         {
-          g_unlink (name);
-          close (fd);
-          g_free (name);
+          ldap_pool_release (key, ldap);
+          g_free (key);
+          return ldap_return == LDAP_SUCCESS ? 0 : -1;
         }
-      return ldap;
+      g_debug ("%s: Dropping pooled LDAP connection: %s", __func__,
+               ldap_err2string (ldap_return));
+      ldap_unbind_ext_s (ldap, NULL, NULL);
     }
 
-fail:
-  if (fd > -1)
+  if (info->allow_plaintext)
+    g_warning ("Allowed plaintext LDAP authentication.");
+
+  fd = ldap_cacert_file_new (cacert, &name);
+  if (info->ldaps_only)
+    ldap = ldap_init_internal_ldaps_only (info->ldap_host);
+  else
+    ldap = ldap_init_internal (info->ldap_host, !info->allow_plaintext);
+  if (ldap == NULL)
     {
-      g_unlink (name);
-      close (fd);
-      g_free (name);
+      ldap_cacert_file_free (fd, name);
+      g_free (key);
+      g_debug ("Could not bind to ldap host %s", info->ldap_host);
+      return -1;
     }
-  return NULL;
+
+  ldap_return = ldap_auth_bind_user (ldap, dn, password);
+  ldap_cacert_file_free (fd, name);
+  if (ldap_error_is_fatal (ldap_return))
+    ldap_unbind_ext_s (ldap, NULL, NULL);
+  else
+    ldap_pool_release (key, ldap);
+  g_free (key);
+  return ldap_return == LDAP_SUCCESS ? 0 : -1;
 }
 
 /**
@@ -704,6 +1027,30 @@ ldap_connect_authenticate (
   return -1;
 }
 
+/**
+ * @brief Dummy function for Manager.
+ *
+ * @param max_idle      Idle connections kept per server.
+ * @param idle_timeout  Seconds an idle connection is kept.
+ *
+ * @return -1.
+ */
+int
+ldap_auth_pool_enable (guint max_idle, guint idle_timeout)
+{
+  (void) max_idle;
+  (void) idle_timeout;
+  return -1;
+}
+
+/**
+ * @brief Dummy function for Manager.
+ */
+void
+ldap_auth_pool_disable (void)
+{
+}
+
 /**
  * @brief Dummy function for Manager.
  *
@@ -39,6 +39,12 @@ ldap_connect_authenticate (const gchar *, const gchar *,
 
 void ldap_auth_info_free (ldap_auth_info_t);
 
+int
+ldap_auth_pool_enable (guint, guint);
+
+void
+ldap_auth_pool_disable (void);
+
 ldap_auth_info_t
 ldap_auth_info_new (const gchar *, const gchar *, gboolean);
 
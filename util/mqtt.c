@@ -22,6 +22,15 @@
  * mqtt_publish_single_message() is a convenience function for sending single
  * messages. Do not send repeated messages via this function as a new connection
  * is established every call.
+ *
+ * For high volumes of messages mqtt_async_start() starts a publisher thread.
+ * mqtt_publish_async() then queues messages for it instead of waiting for the
+ * delivery of each one.  mqtt_reset() publishes the queue before it
+ * destroys the client, so the thread has to be started again afterwards.
+ *
+ * Instead of polling mqtt_retrieve_message(), subscribers can register
+ * callbacks with mqtt_subscribe_callback() and start a receive thread with
+ * mqtt_dispatch_start().  The thread stops on mqtt_reset() too.
  */
 
 #include "mqtt.h"
@@ -30,6 +39,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h> /* for getpid */
 
 #undef G_LOG_DOMAIN
 #define G_LOG_DOMAIN "libgvm util"
@@ -215,11 +225,18 @@ mqtt_client_data_destroy (mqtt_t **mqtt)
 
 /**
  * @brief Destroy MQTTClient handle and free mqtt_t.
+ *
+ * Messages queued with mqtt_publish_async are published first.
  */
 void
 mqtt_reset ()
 {
   g_debug ("%s: start", __func__);
+
+  /* Publish the queued messages while there is a client. */
+  mqtt_async_stop ();
+  mqtt_dispatch_stop ();
+
   mqtt_t *mqtt = mqtt_get_global_client ();
 
   if (mqtt == NULL)
@@ -515,6 +532,372 @@ mqtt_publish (const char *topic, const char *msg)
   return rc;
 }
 
+/**
+ * @brief Message queued for the publisher thread.
+ */
+typedef struct
+{
+  gchar *topic;   ///< Topic to publish on.
+  gchar *payload; ///< Message.
+  int len;        ///< Length of the message.
+} mqtt_message_t;
+
+/**
+ * @brief State of the asynchronous publishing.
+ */
+typedef struct
+{
+  mqtt_async_opts_t opts; ///< Options.
+  GQueue *queue;          ///< Messages waiting for the publisher.
+  GMutex mutex;           ///< Lock for the state.
+  GCond queued;           ///< Signals a message queued, or the stop.
+  GCond room;             ///< Signals room in the queue.
+  GCond done;             ///< Signals messages delivered or failed.
+  guint64 accepted;       ///< Messages queued, in total.
+  guint64 finished;       ///< Messages delivered or failed, in total.
+  guint failed;           ///< Messages failed since the last flush.
+  gboolean stopping;      ///< Whether the publisher should stop.
+  GThread *thread;        ///< Publisher thread.
+  pid_t pid;              ///< Process running the publisher thread.
+} mqtt_async_t;
+
+static mqtt_async_t *mqtt_async = NULL;
+
+/**
+ * @brief Free a queued message.
+ *
+ * @param message  Message.
+ */
+static void
+mqtt_message_free (mqtt_message_t *message)
+{
+  g_free (message->topic);
+  g_free (message->payload);
+  g_free (message);
+}
+
+/**
+ * @brief Account for a message that is delivered or failed, and free it.
+ *
+ * @param async    Asynchronous publishing.
+ * @param message  Message.
+ * @param ok       Whether the message was delivered.
+ */
+static void
+mqtt_async_finish (mqtt_async_t *async, mqtt_message_t *message, gboolean ok)
+{
+  if (!ok)
+    g_debug ("%s: Message could not be published on topic %s", __func__,
+             message->topic);
+  mqtt_message_free (message);
+
+  g_mutex_lock (&async->mutex);
+  async->finished++;
+  if (!ok)
+    async->failed++;
+  g_cond_broadcast (&async->done);
+  g_mutex_unlock (&async->mutex);
+}
+
+/**
+ * @brief Start publishing a message with the global client, without waiting.
+ *
+ * @param async    Asynchronous publishing.
+ * @param message  Message.
+ * @param[out] token  Delivery token of the message.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+static int
+mqtt_async_send (mqtt_async_t *async, mqtt_message_t *message,
+                 MQTTClient_deliveryToken *token)
+{
+  MQTTClient_message pubmsg = MQTTClient_message_initializer;
+  MQTTResponse resp;
+  mqtt_t *mqtt;
+
+  if ((mqtt_get_global_client ()) == NULL)
+    mqtt_reinit ();
+  mqtt = mqtt_get_global_client ();
+  if (mqtt == NULL || mqtt->client == NULL)
+    return -1;
+
+  pubmsg.payload = message->payload;
+  pubmsg.payloadlen = message->len;
+  pubmsg.qos = async->opts.qos;
+  pubmsg.retained = 0;
+
+  resp = MQTTClient_publishMessage5 (mqtt->client, message->topic, &pubmsg,
+                                     token);
+  if (resp.reasonCode != MQTTCLIENT_SUCCESS)
+    {
+      g_warning ("%s: Failed to publish: %s", __func__,
+                 MQTTClient_strerror (resp.reasonCode));
+      MQTTResponse_free (resp);
+      return -1;
+    }
+  return 0;
+}
+
+/**
+ * @brief Wait for the delivery of a message in flight.
+ *
+ * @param async    Asynchronous publishing.
+ * @param message  Message.
+ * @param token    Delivery token of the message.
+ */
+static void
+mqtt_async_complete (mqtt_async_t *async, mqtt_message_t *message,
+                     MQTTClient_deliveryToken token)
+{
+  mqtt_t *mqtt = mqtt_get_global_client ();
+  int rc = MQTTCLIENT_FAILURE;
+
+  if (mqtt && mqtt->client)
+    rc = MQTTClient_waitForCompletion (mqtt->client, token, TIMEOUT);
+  mqtt_async_finish (async, message, rc == MQTTCLIENT_SUCCESS);
+}
+
+/**
+ * @brief Publisher thread.
+ *
+ * Takes batches of messages from the queue and publishes them, with at most
+ * the window of messages waiting for their acknowledgement.  When the queue
+ * is empty all messages in flight are waited for.
+ *
+ * @param data  Asynchronous publishing.
+ *
+ * @return NULL.
+ */
+static gpointer
+mqtt_async_run (gpointer data)
+{
+  mqtt_async_t *async = data;
+  mqtt_message_t **batch, **inflight;
+  MQTTClient_deliveryToken *tokens;
+  guint head, count, taken, index;
+  gboolean idle;
+
+  batch = g_new (mqtt_message_t *, async->opts.batch);
+  inflight = g_new (mqtt_message_t *, async->opts.window);
+  tokens = g_new (MQTTClient_deliveryToken, async->opts.window);
+  head = count = 0;
+
+  for (;;)
+    {
+      g_mutex_lock (&async->mutex);
+      while (g_queue_is_empty (async->queue) && !async->stopping)
+        g_cond_wait (&async->queued, &async->mutex);
+      if (g_queue_is_empty (async->queue))
+        {
+          g_mutex_unlock (&async->mutex);
+          break;
+        }
+      for (taken = 0;
+           taken < async->opts.batch && !g_queue_is_empty (async->queue);
+           taken++)
+        batch[taken] = g_queue_pop_head (async->queue);
+      g_cond_broadcast (&async->room);
+      g_mutex_unlock (&async->mutex);
+
+      for (index = 0; index < taken; index++)
+        {
+          guint slot;
+
+          if (count == async->opts.window)
+            {
+              mqtt_async_complete (async, inflight[head], tokens[head]);
+              head = (head + 1) % async->opts.window;
+              count--;
+            }
+          slot = (head + count) % async->opts.window;
+          if (mqtt_async_send (async, batch[index], &tokens[slot]) == 0)
+            {
+              inflight[slot] = batch[index];
+              count++;
+            }
+          else
+            mqtt_async_finish (async, batch[index], FALSE);
+        }
+
+      g_mutex_lock (&async->mutex);
+      idle = g_queue_is_empty (async->queue);
+      g_mutex_unlock (&async->mutex);
+      if (idle)
+        for (; count; count--)
+          {
+            mqtt_async_complete (async, inflight[head], tokens[head]);
+            head = (head + 1) % async->opts.window;
+          }
+    }
+
+  g_free (batch);
+  g_free (inflight);
+  g_free (tokens);
+  return NULL;
+}
+
+/**
+ * @brief Start publishing messages asynchronously.
+ *
+ * A publisher thread then publishes the messages of mqtt_publish_async with
+ * the global client.
+ *
+ * @param opts  Options, NULL for QoS 1, a window of 32 and batches of 16
+ *              from a queue of 4096, blocking when full.
+ *
+ * @return 0 on success, -1 on error or if already started.
+ */
+int
+mqtt_async_start (const mqtt_async_opts_t *opts)
+{
+  mqtt_async_t *async;
+  GError *error = NULL;
+
+  if (mqtt_async)
+    return -1;
+  if (opts && (opts->qos < 0 || opts->qos > 2 || opts->window == 0
+               || opts->batch == 0 || opts->capacity == 0))
+    return -1;
+
+  async = g_malloc0 (sizeof (mqtt_async_t));
+  if (opts)
+    async->opts = *opts;
+  else
+    {
+      async->opts.qos = QOS;
+      async->opts.window = 32;
+      async->opts.batch = 16;
+      async->opts.capacity = 4096;
+      async->opts.block = TRUE;
+    }
+  async->queue = g_queue_new ();
+  g_mutex_init (&async->mutex);
+  g_cond_init (&async->queued);
+  g_cond_init (&async->room);
+  g_cond_init (&async->done);
+  async->pid = getpid ();
+
+  async->thread =
+    g_thread_try_new ("mqtt publisher", mqtt_async_run, async, &error);
+  if (async->thread == NULL)
+    {
+      g_warning ("%s: Failed to start publisher: %s", __func__,
+                 error->message);
+      g_error_free (error);
+      g_queue_free (async->queue);
+      g_mutex_clear (&async->mutex);
+      g_cond_clear (&async->queued);
+      g_cond_clear (&async->room);
+      g_cond_clear (&async->done);
+      g_free (async);
+      return -1;
+    }
+  mqtt_async = async;
+  return 0;
+}
+
+/**
+ * @brief Queue a message for the publisher thread.
+ *
+ * Without mqtt_async_start the message is published with mqtt_publish.
+ *
+ * @param topic  Topic to publish on.
+ * @param msg    Message to publish.
+ *
+ * @return 0 on success, -1 if the queue is full and the options do not
+ *         block, else as mqtt_publish.
+ */
+int
+mqtt_publish_async (const char *topic, const char *msg)
+{
+  mqtt_async_t *async = mqtt_async;
+  mqtt_message_t *message;
+
+  if (async == NULL || async->pid != getpid ())
+    return mqtt_publish (topic, msg);
+
+  g_mutex_lock (&async->mutex);
+  while (g_queue_get_length (async->queue) >= async->opts.capacity)
+    {
+      if (!async->opts.block)
+        {
+          g_mutex_unlock (&async->mutex);
+          return -1;
+        }
+      g_cond_wait (&async->room, &async->mutex);
+    }
+  message = g_malloc (sizeof (mqtt_message_t));
+  message->topic = g_strdup (topic);
+  message->payload = g_strdup (msg);
+  message->len = (int) strlen (msg);
+  g_queue_push_tail (async->queue, message);
+  async->accepted++;
+  g_cond_signal (&async->queued);
+  g_mutex_unlock (&async->mutex);
+  return 0;
+}
+
+/**
+ * @brief Wait until all queued messages are delivered or failed.
+ *
+ * @return Number of messages that failed since the previous flush.
+ */
+int
+mqtt_async_flush (void)
+{
+  mqtt_async_t *async = mqtt_async;
+  guint64 target;
+  int failed;
+
+  if (async == NULL || async->pid != getpid ())
+    return 0;
+
+  g_mutex_lock (&async->mutex);
+  target = async->accepted;
+  while (async->finished < target)
+    g_cond_wait (&async->done, &async->mutex);
+  failed = async->failed;
+  async->failed = 0;
+  g_mutex_unlock (&async->mutex);
+  return failed;
+}
+
+/**
+ * @brief Stop publishing asynchronously, after publishing the queue.
+ *
+ * In a forked child the publisher thread of the parent does not exist, so
+ * the messages of the parent are dropped.
+ */
+void
+mqtt_async_stop (void)
+{
+  mqtt_async_t *async = mqtt_async;
+
+  if (async == NULL)
+    return;
+  mqtt_async = NULL;
+  if (async->pid != getpid ())
+    /* The locks may be held by threads of the parent, so leave it all. */
+    return;
+
+  g_mutex_lock (&async->mutex);
+  async->stopping = TRUE;
+  g_cond_signal (&async->queued);
+  g_mutex_unlock (&async->mutex);
+  g_thread_join (async->thread);
+
+  if (async->failed)
+    g_debug ("%s: %u messages could not be published", __func__,
+             async->failed);
+  g_queue_free (async->queue);
+  g_mutex_clear (&async->mutex);
+  g_cond_clear (&async->queued);
+  g_cond_clear (&async->room);
+  g_cond_clear (&async->done);
+  g_free (async);
+}
+
 /**
  * @brief Send a single message.
  *
@@ -835,3 +1218,331 @@ mqtt_retrieve_message (char **topic, int *topic_len, char **payload,
   return mqtt_retrieve_message_r (mqtt_get_global_client (), topic, topic_len,
                                   payload, payload_len, timeout);
 }
+
+/**
+ * @brief Subscription with a callback.
+ */
+typedef struct
+{
+  gchar *filter;            ///< Topic filter, with + and # wildcards.
+  mqtt_message_func_t func; ///< Callback.
+  gpointer data;            ///< Data for the callback.
+} mqtt_subscription_t;
+
+/**
+ * @brief Message to dispatch to the callbacks of its subscriptions.
+ */
+typedef struct
+{
+  char *topic;                  ///< Topic, from the client.
+  int topic_len;                ///< Length of the topic.
+  MQTTClient_message *message;  ///< Message, from the client.
+  mqtt_subscription_t *matches; ///< Copies of the matching subscriptions.
+  guint count;                  ///< Number of matching subscriptions.
+} mqtt_delivery_t;
+
+/**
+ * @brief State of the dispatch of received messages.
+ */
+typedef struct
+{
+  GThread *thread;   ///< Receive thread.
+  GThreadPool *pool; ///< Threads running the callbacks, or NULL.
+  gint running;      ///< Whether the receive thread should go on.
+  pid_t pid;         ///< Process running the receive thread.
+} mqtt_dispatch_t;
+
+static GSList *mqtt_subscriptions = NULL; ///< Subscriptions with callbacks.
+static GMutex mqtt_subscriptions_mutex;   ///< Lock for the subscriptions.
+static mqtt_dispatch_t *mqtt_dispatch = NULL;
+
+/**
+ * @brief Check whether a topic matches a topic filter.
+ *
+ * @param filter     Topic filter, with + and # wildcards.
+ * @param topic      Topic.
+ * @param topic_len  Length of the topic.
+ *
+ * @return TRUE if the topic matches, else FALSE.
+ */
+static gboolean
+mqtt_topic_matches (const char *filter, const char *topic, int topic_len)
+{
+  const char *end = topic + topic_len;
+
+  while (*filter)
+    {
+      if (*filter == '#')
+        return TRUE;
+      if (*filter == '+')
+        {
+          while (topic < end && *topic != '/')
+            topic++;
+          filter++;
+        }
+      else
+        {
+          if (topic == end || *topic != *filter)
+            {
+              /* "a/#" matches "a" too. */
+              return topic == end && filter[0] == '/' && filter[1] == '#'
+                     && filter[2] == '\0';
+            }
+          topic++;
+          filter++;
+        }
+    }
+  return topic == end;
+}
+
+/**
+ * @brief Run the callbacks of a received message and free it.
+ *
+ * @param delivery  Received message.
+ */
+static void
+mqtt_delivery_run (mqtt_delivery_t *delivery)
+{
+  guint index;
+
+  for (index = 0; index < delivery->count; index++)
+    delivery->matches[index].func (
+      delivery->topic, delivery->topic_len, delivery->message->payload,
+      delivery->message->payloadlen, delivery->matches[index].data);
+
+  g_free (delivery->matches);
+  MQTTClient_freeMessage (&delivery->message);
+  MQTTClient_free (delivery->topic);
+  g_free (delivery);
+}
+
+/**
+ * @brief Run the callbacks of a received message, in the thread pool.
+ *
+ * @param delivery  Received message.
+ * @param data      Unused.
+ */
+static void
+mqtt_delivery_pool_run (gpointer delivery, gpointer data)
+{
+  (void) data;
+  mqtt_delivery_run (delivery);
+}
+
+/**
+ * @brief Receive thread.
+ *
+ * Receives the messages of the subscriptions with the global client and
+ * hands them to the callbacks of the matching subscriptions.
+ *
+ * @param data  Dispatch state.
+ *
+ * @return NULL.
+ */
+static gpointer
+mqtt_dispatch_run (gpointer data)
+{
+  mqtt_dispatch_t *dispatch = data;
+
+  while (g_atomic_int_get (&dispatch->running))
+    {
+      mqtt_delivery_t *delivery;
+      MQTTClient_message *message = NULL;
+      char *topic = NULL;
+      int topic_len = 0, rc;
+      mqtt_t *mqtt;
+      GSList *item;
+      guint count;
+
+      mqtt = mqtt_get_global_client ();
+      if (mqtt == NULL || mqtt->client == NULL)
+        {
+          g_usleep (100000);
+          continue;
+        }
+      rc = MQTTClient_receive (mqtt->client, &topic, &topic_len, &message,
+                               100);
+      if ((rc != MQTTCLIENT_SUCCESS && rc != MQTTCLIENT_TOPICNAME_TRUNCATED)
+          || message == NULL)
+        {
+          if (topic)
+            MQTTClient_free (topic);
+          if (rc != MQTTCLIENT_SUCCESS)
+            g_usleep (100000);
+          continue;
+        }
+      if (topic_len == 0)
+        topic_len = strlen (topic);
+
+      delivery = g_malloc (sizeof (mqtt_delivery_t));
+      delivery->topic = topic;
+      delivery->topic_len = topic_len;
+      delivery->message = message;
+
+      g_mutex_lock (&mqtt_subscriptions_mutex);
+      delivery->matches =
+        g_new (mqtt_subscription_t, g_slist_length (mqtt_subscriptions));
+      count = 0;
+      for (item = mqtt_subscriptions; item; item = item->next)
+        {
+          mqtt_subscription_t *subscription = item->data;
+
+          if (mqtt_topic_matches (subscription->filter, topic, topic_len))
+            delivery->matches[count++] = *subscription;
+        }
+      g_mutex_unlock (&mqtt_subscriptions_mutex);
+      delivery->count = count;
+
+      if (dispatch->pool)
+        g_thread_pool_push (dispatch->pool, delivery, NULL);
+      else
+        mqtt_delivery_run (delivery);
+    }
+  return NULL;
+}
+
+/**
+ * @brief Start the dispatch of received messages to the callbacks.
+ *
+ * A receive thread then takes over from mqtt_retrieve_message.  The
+ * payloads given to the callbacks are only valid during the call.
+ *
+ * @param threads  Number of threads running the callbacks, 0 to run them in
+ *                 the receive thread.  With threads the callbacks of
+ *                 different messages may run in any order.
+ *
+ * @return 0 on success, -1 on error or if already started.
+ */
+int
+mqtt_dispatch_start (guint threads)
+{
+  mqtt_dispatch_t *dispatch;
+  GError *error = NULL;
+
+  if (mqtt_dispatch)
+    return -1;
+
+  dispatch = g_malloc0 (sizeof (mqtt_dispatch_t));
+  dispatch->pid = getpid ();
+  dispatch->running = 1;
+  if (threads)
+    {
+      dispatch->pool = g_thread_pool_new (mqtt_delivery_pool_run, NULL,
+                                          threads, FALSE, &error);
+      if (dispatch->pool == NULL)
+        {
+          g_warning ("%s: Failed to create thread pool: %s", __func__,
+                     error->message);
+          g_error_free (error);
+          g_free (dispatch);
+          return -1;
+        }
+    }
+  dispatch->thread =
+    g_thread_try_new ("mqtt receiver", mqtt_dispatch_run, dispatch, &error);
+  if (dispatch->thread == NULL)
+    {
+      g_warning ("%s: Failed to start receiver: %s", __func__,
+                 error->message);
+      g_error_free (error);
+      if (dispatch->pool)
+        g_thread_pool_free (dispatch->pool, TRUE, FALSE);
+      g_free (dispatch);
+      return -1;
+    }
+  mqtt_dispatch = dispatch;
+  return 0;
+}
+
+/**
+ * @brief Stop the dispatch of received messages.
+ *
+ * Waits for the callbacks of the messages already received.
+ */
+void
+mqtt_dispatch_stop (void)
+{
+  mqtt_dispatch_t *dispatch = mqtt_dispatch;
+
+  if (dispatch == NULL)
+    return;
+  mqtt_dispatch = NULL;
+  if (dispatch->pid != getpid ())
+    /* The receive thread is in the parent only. */
+    return;
+
+  g_atomic_int_set (&dispatch->running, 0);
+  g_thread_join (dispatch->thread);
+  if (dispatch->pool)
+    g_thread_pool_free (dispatch->pool, FALSE, TRUE);
+  g_free (dispatch);
+}
+
+/**
+ * @brief Subscribe to a topic with a callback.
+ *
+ * The callback gets the messages of the topic once mqtt_dispatch_start
+ * was called.
+ *
+ * @param topic  Topic filter, with + and # wildcards.
+ * @param func   Callback.
+ * @param data   Data for the callback.
+ *
+ * @return 0 on success, -1 when mqtt is not initialized, -2 when subscription
+ * failed.
+ */
+int
+mqtt_subscribe_callback (const char *topic, mqtt_message_func_t func,
+                         gpointer data)
+{
+  mqtt_subscription_t *subscription;
+  int rc;
+
+  if (topic == NULL || func == NULL)
+    return -1;
+  rc = mqtt_subscribe (topic);
+  if (rc)
+    return rc;
+
+  subscription = g_malloc (sizeof (mqtt_subscription_t));
+  subscription->filter = g_strdup (topic);
+  subscription->func = func;
+  subscription->data = data;
+  g_mutex_lock (&mqtt_subscriptions_mutex);
+  mqtt_subscriptions = g_slist_append (mqtt_subscriptions, subscription);
+  g_mutex_unlock (&mqtt_subscriptions_mutex);
+  return 0;
+}
+
+/**
+ * @brief Unsubscribe the callbacks of a topic.
+ *
+ * With a thread pool, callbacks of messages already received may still run
+ * until mqtt_dispatch_stop.
+ *
+ * @param topic  Topic filter given to mqtt_subscribe_callback.
+ *
+ * @return 0 on success, -1 when given mqtt is not useable, -2 when unsubscribe
+ * failed.
+ */
+int
+mqtt_unsubscribe_callback (const char *topic)
+{
+  GSList *item, *next;
+
+  g_mutex_lock (&mqtt_subscriptions_mutex);
+  for (item = mqtt_subscriptions; item; item = next)
+    {
+      mqtt_subscription_t *subscription = item->data;
+
+      next = item->next;
+      if (strcmp (subscription->filter, topic) == 0)
+        {
+          mqtt_subscriptions = g_slist_delete_link (mqtt_subscriptions, item);
+          g_free (subscription->filter);
+          g_free (subscription);
+        }
+    }
+  g_mutex_unlock (&mqtt_subscriptions_mutex);
+  return mqtt_unsubscribe (topic);
+}
@@ -31,6 +31,30 @@ mqtt_reset (void);
 int
 mqtt_publish (const char *, const char *);
 
+/**
+ * @brief Options of the asynchronous publishing.
+ */
+typedef struct
+{
+  int qos;        ///< QoS of the messages.
+  guint window;   ///< Messages in flight, waiting for acknowledgement.
+  guint batch;    ///< Messages taken from the queue at once.
+  guint capacity; ///< Messages queued at most.
+  gboolean block; ///< Whether to wait when the queue is full, else fail.
+} mqtt_async_opts_t;
+
+int
+mqtt_async_start (const mqtt_async_opts_t *);
+
+int
+mqtt_publish_async (const char *, const char *);
+
+int
+mqtt_async_flush (void);
+
+void
+mqtt_async_stop (void);
+
 int
 mqtt_publish_single_message_auth (const char *, const char *, const char *,
                                   const char *, const char *);
@@ -47,4 +71,24 @@ mqtt_retrieve_message (char **, int *, char **, int *, const unsigned int);
 int
 mqtt_unsubscribe (const char *);
 
+/**
+ * @brief Callback for a received message.
+ *
+ * The topic and payload are only valid during the call.
+ */
+typedef void (*mqtt_message_func_t) (const char *, int, const void *, int,
+                                     gpointer);
+
+int
+mqtt_subscribe_callback (const char *, mqtt_message_func_t, gpointer);
+
+int
+mqtt_unsubscribe_callback (const char *);
+
+int
+mqtt_dispatch_start (guint);
+
+void
+mqtt_dispatch_stop (void);
+
 #endif /* _GVM_MQTT_H */
@@ -22,9 +22,12 @@
 #include <errno.h>
 #include <stdio.h>    /* for fopen */
 #include <stdlib.h>   /* for atoi */
+#include <fcntl.h>    /* for open */
 #include <string.h>   /* for strcmp */
+#include <sys/mman.h> /* for mmap */
 #include <sys/stat.h> /* for stat, st_mtime */
 #include <time.h>     /* for time, time_t */
+#include <unistd.h>   /* for close */
 
 #undef G_LOG_DOMAIN
 /**
@@ -32,10 +35,329 @@
  */
 #define G_LOG_DOMAIN "libgvm util"
 
+/**
+ * @brief Default maximum number of NVTs kept in the process-local LRU.
+ */
+#define NVTICACHE_LRU_MAX_ENTRIES 4096
+
+/**
+ * @brief Default maximum size of the process-local LRU, in bytes.
+ */
+#define NVTICACHE_LRU_MAX_BYTES (32 * 1024 * 1024)
+
 char *src_path = NULL; /**< The directory of the source files. */
 kb_t cache_kb = NULL;  /**< Cache KB handler. */
 int cache_saved = 1;   /**< If cache was saved. */
 
+/**
+ * @brief NVT kept in the process-local LRU.
+ */
+struct lru_entry
+{
+  nvti_t *nvti; /**< The NVT, its OID is the key. */
+  size_t size;  /**< Estimated memory used by the entry. */
+  GList link;   /**< Link in lru_queue. */
+};
+
+static GHashTable *lru_table = NULL; /**< Entries by OID. */
+static GQueue lru_queue = G_QUEUE_INIT; /**< Entries, most recent first. */
+static size_t lru_bytes = 0;            /**< Size of all entries. */
+static size_t lru_max_entries = NVTICACHE_LRU_MAX_ENTRIES;
+static size_t lru_max_bytes = NVTICACHE_LRU_MAX_BYTES;
+static size_t lru_hits = 0;   /**< Lookups served by the LRU. */
+static size_t lru_misses = 0; /**< Lookups which went to the KB. */
+static int lru_tracked = 0;   /**< 1 if the KB invalidates the LRU, -1 if it
+                                   can't, 0 if not tried yet. */
+
+/**
+ * @brief Estimate the memory used by a NVT in the LRU.
+ *
+ * @param nvti  The NVT.
+ *
+ * @return Estimated size in bytes.
+ */
+static size_t
+lru_entry_size (const nvti_t *nvti)
+{
+  const char *strs[] = {
+    nvti_oid (nvti),           nvti_name (nvti),
+    nvti_required_keys (nvti), nvti_mandatory_keys (nvti),
+    nvti_excluded_keys (nvti), nvti_required_udp_ports (nvti),
+    nvti_required_ports (nvti), nvti_dependencies (nvti),
+    nvti_tag (nvti),           nvti_family (nvti)};
+  size_t i, size;
+
+  /* Fixed overhead of the entry, the nvti and the hash table. */
+  size = sizeof (struct lru_entry) + 512;
+  for (i = 0; i < G_N_ELEMENTS (strs); i++)
+    if (strs[i])
+      size += strlen (strs[i]) + 1;
+  return size + 64 * (nvti_vtref_len (nvti) + nvti_pref_len (nvti));
+}
+
+static void
+lru_entry_free (gpointer data)
+{
+  struct lru_entry *entry = data;
+
+  g_queue_unlink (&lru_queue, &entry->link);
+  lru_bytes -= entry->size;
+  nvti_free (entry->nvti);
+  g_free (entry);
+}
+
+/**
+ * @brief Remove all NVTs from the LRU.
+ */
+static void
+lru_clear (void)
+{
+  if (lru_table)
+    g_hash_table_remove_all (lru_table);
+}
+
+/**
+ * @brief Remove a NVT from the LRU.
+ *
+ * @param oid  OID of the NVT.
+ */
+static void
+lru_remove (const char *oid)
+{
+  if (lru_table && oid)
+    g_hash_table_remove (lru_table, oid);
+}
+
+/**
+ * @brief Drop the NVT of a key changed in the KB. Callback for kb_track.
+ *
+ * @param name  Key, nvt:OID or oid:OID:prefs. NULL if any key may have
+ *              changed.
+ * @param data  Unused.
+ */
+static void
+lru_invalidate (const char *name, void *data)
+{
+  const char *end;
+  gchar *oid;
+
+  (void) data;
+  if (name == NULL)
+    {
+      lru_clear ();
+      lru_tracked = 0;
+      return;
+    }
+  if (!strncmp (name, "nvt:", 4))
+    {
+      lru_remove (name + 4);
+      return;
+    }
+  if (strncmp (name, "oid:", 4) || (end = strchr (name + 4, ':')) == NULL)
+    return;
+  oid = g_strndup (name + 4, end - name - 4);
+  lru_remove (oid);
+  g_free (oid);
+}
+
+/**
+ * @brief Bring the LRU up to date with the KB.
+ *
+ * With client-side caching, the KB tells which NVTs changed since they were
+ * read, so the LRU serves them with strong consistency on feed updates.
+ * Without it, NVTs stay in the LRU until evicted or reset, as before.
+ */
+static void
+lru_sync (void)
+{
+  if (lru_tracked == 0)
+    {
+      /* NVTs read before tracking started are not tracked. */
+      lru_clear ();
+      lru_tracked = kb_track (cache_kb, lru_invalidate, NULL) ? -1 : 1;
+    }
+  else if (lru_tracked == 1 && kb_track_poll (cache_kb))
+    {
+      lru_clear ();
+      lru_tracked = kb_track (cache_kb, lru_invalidate, NULL) ? -1 : 1;
+    }
+}
+
+/**
+ * @brief Evict the least recently used NVTs until the limits are met.
+ */
+static void
+lru_evict (void)
+{
+  while (lru_queue.tail
+         && (lru_queue.length > lru_max_entries || lru_bytes > lru_max_bytes))
+    {
+      struct lru_entry *entry = lru_queue.tail->data;
+
+      g_hash_table_remove (lru_table, nvti_oid (entry->nvti));
+    }
+}
+
+/**
+ * @brief Get a NVT from the LRU, fetching it from the KB on a miss.
+ *
+ * @param oid  OID of the NVT.
+ *
+ * @return The NVT, owned by the LRU and valid until the next LRU call. NULL
+ *         if the LRU is disabled or the NVT could not be fetched.
+ */
+static const nvti_t *
+lru_lookup (const char *oid)
+{
+  struct lru_entry *entry;
+  nvti_t *nvti;
+
+  if (lru_max_entries == 0 || lru_max_bytes == 0 || oid == NULL)
+    return NULL;
+  if (lru_table == NULL)
+    lru_table =
+      g_hash_table_new_full (g_str_hash, g_str_equal, NULL, lru_entry_free);
+  lru_sync ();
+
+  entry = g_hash_table_lookup (lru_table, oid);
+  if (entry)
+    {
+      lru_hits++;
+      g_queue_unlink (&lru_queue, &entry->link);
+      g_queue_push_head_link (&lru_queue, &entry->link);
+      return entry->nvti;
+    }
+
+  lru_misses++;
+  nvti = kb_nvt_get_all (cache_kb, oid);
+  if (nvti == NULL || nvti_oid (nvti) == NULL)
+    {
+      nvti_free (nvti);
+      return NULL;
+    }
+  entry = g_malloc0 (sizeof (struct lru_entry));
+  entry->nvti = nvti;
+  entry->size = lru_entry_size (nvti);
+  entry->link.data = entry;
+  lru_bytes += entry->size;
+  g_queue_push_head_link (&lru_queue, &entry->link);
+  /* The key is owned by the nvti. */
+  g_hash_table_insert (lru_table, nvti_oid (nvti), entry);
+  lru_evict ();
+
+  /* The entry itself may be evicted if it's larger than the limit. */
+  entry = g_hash_table_lookup (lru_table, oid);
+  return entry ? entry->nvti : NULL;
+}
+
+/**
+ * @brief Set the limits of the process-local LRU of NVTs.
+ *
+ * The nvticache_get_* accessors serve NVTs from the LRU, instead of asking
+ * the KB each time. If the KB supports kb_track (Redis 6 and later), NVTs
+ * changed in the KB are dropped from the LRU. A limit of 0 disables the LRU.
+ *
+ * @param max_entries  Maximum number of NVTs.
+ * @param max_bytes    Maximum estimated memory used by the NVTs.
+ */
+void
+nvticache_set_lru_limits (size_t max_entries, size_t max_bytes)
+{
+  lru_max_entries = max_entries;
+  lru_max_bytes = max_bytes;
+  if (max_entries == 0 || max_bytes == 0)
+    lru_clear ();
+  else if (lru_table)
+    lru_evict ();
+}
+
+/**
+ * @brief Get the statistics of the process-local LRU of NVTs.
+ *
+ * @param[out] hits     Lookups served by the LRU, or NULL.
+ * @param[out] misses   Lookups which went to the KB, or NULL.
+ * @param[out] entries  Number of NVTs in the LRU, or NULL.
+ * @param[out] bytes    Estimated memory used by the NVTs, or NULL.
+ */
+void
+nvticache_get_lru_stats (size_t *hits, size_t *misses, size_t *entries,
+                         size_t *bytes)
+{
+  if (hits)
+    *hits = lru_hits;
+  if (misses)
+    *misses = lru_misses;
+  if (entries)
+    *entries = lru_queue.length;
+  if (bytes)
+    *bytes = lru_bytes;
+}
+
+/**
+ * @brief Get a field of a NVT, from the LRU if possible.
+ *
+ * @param oid       OID of the NVT.
+ * @param position  Field to get.
+ *
+ * @return Value of field, NULL otherwise.
+ */
+static char *
+nvticache_get_field (const char *oid, enum kb_nvt_pos position)
+{
+  const nvti_t *nvti;
+  const char *value;
+
+  assert (cache_kb);
+
+  nvti = lru_lookup (oid);
+  if (nvti == NULL)
+    return kb_nvt_get (cache_kb, oid, position);
+
+  switch (position)
+    {
+    case NVT_REQUIRED_KEYS_POS:
+      value = nvti_required_keys (nvti);
+      break;
+    case NVT_MANDATORY_KEYS_POS:
+      value = nvti_mandatory_keys (nvti);
+      break;
+    case NVT_EXCLUDED_KEYS_POS:
+      value = nvti_excluded_keys (nvti);
+      break;
+    case NVT_REQUIRED_UDP_PORTS_POS:
+      value = nvti_required_udp_ports (nvti);
+      break;
+    case NVT_REQUIRED_PORTS_POS:
+      value = nvti_required_ports (nvti);
+      break;
+    case NVT_DEPENDENCIES_POS:
+      value = nvti_dependencies (nvti);
+      break;
+    case NVT_TAGS_POS:
+      value = nvti_tag (nvti);
+      break;
+    case NVT_CVES_POS:
+      return nvti_refs (nvti, "cve", "", 0);
+    case NVT_BIDS_POS:
+      return nvti_refs (nvti, "bid", "", 0);
+    case NVT_XREFS_POS:
+      return nvti_refs (nvti, NULL, "cve,bid", 1);
+    case NVT_CATEGORY_POS:
+      return g_strdup_printf ("%d", nvti_category (nvti));
+    case NVT_FAMILY_POS:
+      value = nvti_family (nvti);
+      break;
+    case NVT_NAME_POS:
+      value = nvti_name (nvti);
+      break;
+    default:
+      /* Not part of the nvti. */
+      return kb_nvt_get (cache_kb, oid, position);
+    }
+  /* The KB returns empty fields as empty strings. */
+  return g_strdup (value ? value : "");
+}
+
 /**
  * @brief Return whether the nvt cache is initialized.
  *
@@ -63,6 +385,8 @@ nvticache_init (const char *src, const char *kb_path)
   if (src_path)
     g_free (src_path);
   src_path = g_strdup (src);
+  lru_clear ();
+  lru_tracked = 0;
   if (cache_kb)
     kb_lnk_reset (cache_kb);
   cache_kb = kb_find (kb_path, NVTICACHE_STR);
@@ -115,12 +439,122 @@ nvticache_check (const gchar *filename)
   return ret;
 }
 
+/**
+ * @brief Number of files stat'ed by a task of nvticache_check_many.
+ */
+#define NVTICACHE_STAT_CHUNK 256
+
+/**
+ * @brief Maximum number of threads stat'ing files in nvticache_check_many.
+ */
+#define NVTICACHE_STAT_THREADS 8
+
+/**
+ * @brief Files stat'ed by the workers of nvticache_check_many.
+ */
+struct stat_job
+{
+  const gchar **filenames; /**< Files, relative to src_path. */
+  time_t *mtimes;          /**< Modification times, -1 on failure. */
+  size_t count;            /**< Number of files. */
+};
+
+/**
+ * @brief Stat a chunk of the files of a stat_job.
+ *
+ * @param data       Index of the chunk plus one.
+ * @param user_data  The stat_job.
+ */
+static void
+stat_chunk (gpointer data, gpointer user_data)
+{
+  struct stat_job *job = user_data;
+  size_t i, start, end;
+
+  start = (GPOINTER_TO_SIZE (data) - 1) * NVTICACHE_STAT_CHUNK;
+  end = MIN (start + NVTICACHE_STAT_CHUNK, job->count);
+  for (i = start; i < end; i++)
+    {
+      struct stat src_stat;
+      char *src_file;
+
+      src_file = g_build_filename (src_path, job->filenames[i], NULL);
+      job->mtimes[i] = stat (src_file, &src_stat) < 0 ? -1 : src_stat.st_mtime;
+      g_free (src_file);
+    }
+}
+
+/**
+ * @brief Check which nvts of a list of files are missing or outdated in
+ *        the cache.
+ *
+ * This is the bulk form of nvticache_check, for loading a whole feed. The
+ * timestamps of all files are fetched from the cache with a single
+ * pipelined exchange, while the files are stat'ed by a pool of threads.
+ *
+ * @param filenames  Names of the original NVTs, relative to the base
+ *                   location of NVTs like for nvticache_check.
+ * @param count      Number of filenames.
+ *
+ * @return List of copies of the filenames which need to be parsed again.
+ */
+GSList *
+nvticache_check_many (const gchar **filenames, size_t count)
+{
+  struct stat_job job;
+  GThreadPool *pool;
+  GSList *stale = NULL;
+  char **times;
+  size_t i, chunks;
+
+  assert (cache_kb);
+
+  if (count == 0)
+    return NULL;
+  job.filenames = filenames;
+  job.mtimes = g_malloc_n (count, sizeof (time_t));
+  job.count = count;
+  chunks = (count + NVTICACHE_STAT_CHUNK - 1) / NVTICACHE_STAT_CHUNK;
+
+  pool = g_thread_pool_new (
+    stat_chunk, &job,
+    MIN (chunks, MIN (g_get_num_processors (), NVTICACHE_STAT_THREADS)),
+    FALSE, NULL);
+  for (i = 0; i < chunks; i++)
+    if (pool == NULL
+        || !g_thread_pool_push (pool, GSIZE_TO_POINTER (i + 1), NULL))
+      stat_chunk (GSIZE_TO_POINTER (i + 1), &job);
+
+  /* Fetch the timestamps while the files are stat'ed. */
+  times = g_malloc0_n (count, sizeof (char *));
+  if (kb_nvt_get_many_field (cache_kb, filenames, count, NVT_TIMESTAMP_POS,
+                             times)
+      < 0)
+    g_warning ("%s: Failed to get the timestamps of the nvts", __func__);
+
+  if (pool)
+    g_thread_pool_free (pool, FALSE, TRUE);
+
+  for (i = 0; i < count; i++)
+    {
+      if (!times[i] || job.mtimes[i] < 0 || atoi (times[i]) <= job.mtimes[i])
+        stale = g_slist_prepend (stale, g_strdup (filenames[i]));
+      g_free (times[i]);
+    }
+  g_free (times);
+  g_free (job.mtimes);
+
+  return g_slist_reverse (stale);
+}
+
 /**
  * @brief Reset connection to KB. To be called after a fork().
  */
 void
 nvticache_reset (void)
 {
+  lru_clear ();
+  lru_tracked = 0;
   if (cache_kb)
     kb_lnk_reset (cache_kb);
 }
@@ -228,6 +662,7 @@ nvticache_add (const nvti_t *nvti, const char *filename)
 
   g_free (dummy);
 
+  lru_remove (oid);
   if (kb_nvt_add (cache_kb, nvti, filename))
     goto kb_fail;
   cache_saved = 0;
@@ -237,6 +672,41 @@ kb_fail:
   return -1;
 }
 
+/**
+ * @brief Add a batch of NVT Informations to the cache.
+ *
+ * Meant for feed loads. The NVTs are pipelined to the KB in chunks. Previous
+ * entries of an OID are replaced, like in nvticache_add.
+ *
+ * @param nvtis     Array of the NVT Informations to add.
+ * @param filenames Array of the names of the original NVTs without the path
+ *                  to the base location of NVTs, same order as nvtis.
+ * @param count     Number of elements in nvtis and filenames.
+ * @param errors    Array of count elements where the result of each NVT is
+ *                  stored (0 on success). May be NULL.
+ *
+ * @return Number of NVTs which could not be added, -1 on connection error.
+ */
+int
+nvticache_add_batch (const nvti_t **nvtis, const char **filenames,
+                     size_t count, int *errors)
+{
+  size_t i;
+  int failed;
+
+  assert (cache_kb);
+
+  for (i = 0; i < count; i++)
+    if (nvtis[i])
+      lru_remove (nvti_oid (nvtis[i]));
+  failed = kb_nvt_add_batch (cache_kb, nvtis, filenames, count, 0, errors);
+  /* Some NVTs may have been stored before a connection error. */
+  if (failed < 0 || (size_t) failed < count)
+    cache_saved = 0;
+
+  return failed;
+}
+
 /**
  * @brief Get the full source filename of an OID.
  *
@@ -298,8 +768,7 @@ nvticache_get_filename (const char *oid)
 char *
 nvticache_get_required_keys (const char *oid)
 {
-  assert (cache_kb);
-  return kb_nvt_get (cache_kb, oid, NVT_REQUIRED_KEYS_POS);
+  return nvticache_get_field (oid, NVT_REQUIRED_KEYS_POS);
 }
 
 /**
@@ -312,8 +781,7 @@ nvticache_get_required_keys (const char *oid)
 char *
 nvticache_get_mandatory_keys (const char *oid)
 {
-  assert (cache_kb);
-  return kb_nvt_get (cache_kb, oid, NVT_MANDATORY_KEYS_POS);
+  return nvticache_get_field (oid, NVT_MANDATORY_KEYS_POS);
 }
 
 /**
@@ -326,8 +794,7 @@ nvticache_get_mandatory_keys (const char *oid)
 char *
 nvticache_get_excluded_keys (const char *oid)
 {
-  assert (cache_kb);
-  return kb_nvt_get (cache_kb, oid, NVT_EXCLUDED_KEYS_POS);
+  return nvticache_get_field (oid, NVT_EXCLUDED_KEYS_POS);
 }
 
 /**
@@ -340,8 +807,7 @@ nvticache_get_excluded_keys (const char *oid)
 char *
 nvticache_get_required_udp_ports (const char *oid)
 {
-  assert (cache_kb);
-  return kb_nvt_get (cache_kb, oid, NVT_REQUIRED_UDP_PORTS_POS);
+  return nvticache_get_field (oid, NVT_REQUIRED_UDP_PORTS_POS);
 }
 
 /**
@@ -354,8 +820,7 @@ nvticache_get_required_udp_ports (const char *oid)
 char *
 nvticache_get_required_ports (const char *oid)
 {
-  assert (cache_kb);
-  return kb_nvt_get (cache_kb, oid, NVT_REQUIRED_PORTS_POS);
+  return nvticache_get_field (oid, NVT_REQUIRED_PORTS_POS);
 }
 
 /**
@@ -368,87 +833,375 @@ nvticache_get_required_ports (const char *oid)
 char *
 nvticache_get_dependencies (const char *oid)
 {
-  assert (cache_kb);
-  return kb_nvt_get (cache_kb, oid, NVT_DEPENDENCIES_POS);
+  return nvticache_get_field (oid, NVT_DEPENDENCIES_POS);
 }
 
 /**
- * @brief Get the Category from a plugin OID.
- *
- * @param[in]   oid     OID to match.
- *
- * @return Category matching OID, -1 otherwise.
+ * @brief Dependency graph of the NVTs, while it is computed.
  */
-int
-nvticache_get_category (const char *oid)
+struct dep_graph
 {
-  int category;
-  char *category_s;
-
-  assert (cache_kb);
-  category_s = kb_nvt_get (cache_kb, oid, NVT_CATEGORY_POS);
-  category = atoi (category_s);
-  g_free (category_s);
-  return category;
-}
+  GHashTable *deps;     /**< Array of the OIDs of the dependencies, by OID. */
+  GHashTable *closures; /**< Ordered closure of the dependencies, by OID. */
+  GHashTable *visiting; /**< OIDs being visited, to detect cycles. */
+};
 
 /**
- * @brief Get the name from a plugin OID.
+ * @brief Compute the ordered closure of the dependencies of a NVT.
  *
- * @param[in]   oid     OID to match.
+ * @param graph  The dependency graph.
+ * @param oid    OID of the NVT, owned by graph.
  *
- * @return Name matching OID, NULL otherwise.
+ * @return Array of the OIDs of all direct and indirect dependencies, each
+ *         one after its own dependencies. Owned by graph.
  */
-char *
-nvticache_get_name (const char *oid)
+static GPtrArray *
+dep_closure (struct dep_graph *graph, const char *oid)
 {
-  assert (cache_kb);
-  return kb_nvt_get (cache_kb, oid, NVT_NAME_POS);
+  GPtrArray *closure, *deps;
+  GHashTable *seen;
+  guint i, j;
+
+  if ((closure = g_hash_table_lookup (graph->closures, oid)))
+    return closure;
+
+  closure = g_ptr_array_new ();
+  seen = g_hash_table_new (g_str_hash, g_str_equal);
+  g_hash_table_add (graph->visiting, (gpointer) oid);
+  deps = g_hash_table_lookup (graph->deps, oid);
+  for (i = 0; deps && i < deps->len; i++)
+    {
+      const char *dep = g_ptr_array_index (deps, i);
+      GPtrArray *sub;
+
+      if (g_hash_table_contains (graph->visiting, dep))
+        {
+          g_debug ("%s: Dependency cycle between %s and %s", __func__, oid,
+                   dep);
+          continue;
+        }
+      sub = dep_closure (graph, dep);
+      for (j = 0; j <= sub->len; j++)
+        {
+          const char *elem = j < sub->len ? g_ptr_array_index (sub, j) : dep;
+
+          if (!g_hash_table_contains (seen, elem))
+            {
+              g_hash_table_add (seen, (gpointer) elem);
+              g_ptr_array_add (closure, (gpointer) elem);
+            }
+        }
+    }
+  g_hash_table_remove (graph->visiting, oid);
+  g_hash_table_destroy (seen);
+  g_hash_table_insert (graph->closures, (gpointer) oid, closure);
+  return closure;
 }
 
 /**
- * @brief Get the cves from a plugin OID.
+ * @brief Add a name to an array. Callback for kb_item_iterate_pattern.
  *
- * @param[in]   oid     OID to match.
+ * @param name       Name matching the pattern.
+ * @param user_data  Array of names to add it to.
  *
- * @return CVEs matching OID, NULL otherwise.
+ * @return 0 to continue the iteration.
  */
-char *
-nvticache_get_cves (const char *oid)
+static int
+collect_name (const char *name, void *user_data)
 {
-  assert (cache_kb);
-  return kb_nvt_get (cache_kb, oid, NVT_CVES_POS);
+  g_ptr_array_add (user_data, g_strdup (name));
+  return 0;
 }
 
 /**
- * @brief Get the bids from a plugin OID.
+ * @brief Compute the dependency graph of the NVTs and store it in the cache.
  *
- * @param[in]   oid     OID to match.
+ * For each NVT, the script names of its dependencies are resolved to OIDs
+ * and the transitive closure of its dependencies is stored under
+ * deps:<oid>, in launch order. The closures of NVTs no longer in the feed
+ * are deleted. The graph is computed only once per feed version.
  *
- * @return BIDs matching OID, NULL otherwise.
+ * @return Number of NVTs, -1 on error.
  */
-char *
-nvticache_get_bids (const char *oid)
+int
+nvticache_update_dependencies (void)
 {
+  struct dep_graph graph;
+  GSList *oids, *element;
+  const char **oid_array, **names, **values;
+  char **dependencies, *feed_version, *deps_version;
+  GHashTable *filenames;
+  GHashTableIter iter;
+  gpointer key;
+  size_t count, i;
+  int ret = -1;
+
   assert (cache_kb);
-  return kb_nvt_get (cache_kb, oid, NVT_BIDS_POS);
+
+  feed_version = nvticache_feed_version ();
+  deps_version = kb_item_get_str (cache_kb, NVTICACHE_DEPS_STR);
+  if (feed_version && !g_strcmp0 (feed_version, deps_version))
+    {
+      g_free (feed_version);
+      g_free (deps_version);
+      return kb_item_count (cache_kb, "deps:*");
+    }
+  g_free (deps_version);
+
+  oids = nvticache_get_oids ();
+  count = g_slist_length (oids);
+  oid_array = g_malloc0_n (count + 1, sizeof (char *));
+  for (element = oids, i = 0; element; element = element->next)
+    oid_array[i++] = element->data;
+  dependencies = g_malloc0_n (count + 1, sizeof (char *));
+  if (kb_nvt_get_many_field (cache_kb, oid_array, count, NVT_DEPENDENCIES_POS,
+                             dependencies)
+      < 0)
+    goto out;
+
+  /* Resolve the script names with a single exchange. */
+  filenames = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  for (i = 0; i < count; i++)
+    {
+      gchar **deps, **dep;
+
+      if (dependencies[i] == NULL)
+        continue;
+      deps = g_strsplit (dependencies[i], ",", 0);
+      for (dep = deps; *dep; dep++)
+        if (*g_strstrip (*dep))
+          g_hash_table_replace (filenames, g_strdup (*dep), NULL);
+      g_strfreev (deps);
+    }
+  names = g_malloc0_n (g_hash_table_size (filenames) + 1, sizeof (char *));
+  values = g_malloc0_n (g_hash_table_size (filenames) + 1, sizeof (char *));
+  i = 0;
+  g_hash_table_iter_init (&iter, filenames);
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+    names[i++] = key;
+  if (kb_nvt_get_many_field (cache_kb, names, i, NVT_OID_POS, (char **) values)
+      < 0)
+    {
+      g_free (names);
+      g_free (values);
+      g_hash_table_destroy (filenames);
+      goto out;
+    }
+  while (i--)
+    g_hash_table_insert (filenames, g_strdup (names[i]), (char *) values[i]);
+  g_free (names);
+  g_free (values);
+
+  graph.deps = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+                                      (GDestroyNotify) g_ptr_array_unref);
+  graph.closures = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+                                          (GDestroyNotify) g_ptr_array_unref);
+  graph.visiting = g_hash_table_new (g_str_hash, g_str_equal);
+  for (i = 0; i < count; i++)
+    {
+      GPtrArray *deps = g_ptr_array_new ();
+      gchar **dep_names, **dep;
+
+      g_hash_table_insert (graph.deps, (gpointer) oid_array[i], deps);
+      if (dependencies[i] == NULL)
+        continue;
+      dep_names = g_strsplit (dependencies[i], ",", 0);
+      for (dep = dep_names; *dep; dep++)
+        {
+          const char *dep_oid;
+
+          if (!*g_strstrip (*dep))
+            continue;
+          dep_oid = g_hash_table_lookup (filenames, *dep);
+          if (dep_oid)
+            g_ptr_array_add (deps, (gpointer) dep_oid);
+          else
+            g_debug ("%s: Unknown dependency %s of %s", __func__, *dep,
+                     oid_array[i]);
+        }
+      g_strfreev (dep_names);
+    }
+
+  names = g_malloc0_n (count + 1, sizeof (char *));
+  values = g_malloc0_n (count + 1, sizeof (char *));
+  for (i = 0; i < count; i++)
+    {
+      GPtrArray *closure = dep_closure (&graph, oid_array[i]);
+
+      names[i] = g_strdup_printf ("deps:%s", oid_array[i]);
+      g_ptr_array_add (closure, NULL);
+      values[i] = g_strjoinv (",", (gchar **) closure->pdata);
+      g_ptr_array_remove_index (closure, closure->len - 1);
+    }
+  if (kb_item_set_str_many (cache_kb, names, values, count) == 0)
+    {
+      GPtrArray *stored = g_ptr_array_new_with_free_func (g_free);
+
+      /* Drop the closures of NVTs removed from the feed. */
+      kb_item_iterate_pattern (cache_kb, "deps:*", collect_name, stored);
+      for (i = 0; i < stored->len; i++)
+        {
+          const char *name = g_ptr_array_index (stored, i);
+
+          if (!g_hash_table_contains (graph.deps, name + strlen ("deps:")))
+            kb_del_items (cache_kb, name);
+        }
+      g_ptr_array_free (stored, TRUE);
+
+      /* Only once all closures are stored. */
+      kb_item_set_str (cache_kb, NVTICACHE_DEPS_STR,
+                       feed_version ? feed_version : "", 0);
+      ret = count;
+    }
+  g_strfreev ((gchar **) names);
+  g_strfreev ((gchar **) values);
+  g_hash_table_destroy (graph.deps);
+  g_hash_table_destroy (graph.closures);
+  g_hash_table_destroy (graph.visiting);
+  g_hash_table_destroy (filenames);
+
+out:
+  for (i = 0; i < count; i++)
+    g_free (dependencies[i]);
+  g_free (dependencies);
+  g_free (oid_array);
+  g_slist_free_full (oids, g_free);
+  g_free (feed_version);
+  return ret;
 }
 
 /**
- * @brief Get the xrefs from a plugin OID.
+ * @brief Get the launch order of a set of NVTs and their dependencies.
  *
- * @param[in]   oid     OID to match.
+ * The dependency graph is computed first if the feed version changed.
  *
- * @return XREFs matching OID, NULL otherwise.
+ * @param[in] oids   OIDs of the requested NVTs.
+ * @param[in] count  Number of OIDs.
+ *
+ * @return List of the OIDs of the requested NVTs and all their dependencies,
+ *         each one after its own dependencies. To be freed with
+ *         g_slist_free_full and g_free.
  */
-char *
-nvticache_get_xrefs (const char *oid)
+GSList *
+nvticache_get_launch_order (const char **oids, size_t count)
 {
+  GSList *order = NULL;
+  GHashTable *seen;
+  char **names, **closures;
+  size_t i;
+
   assert (cache_kb);
-  return kb_nvt_get (cache_kb, oid, NVT_XREFS_POS);
-}
 
-/**
+  if (nvticache_update_dependencies () < 0)
+    return NULL;
+
+  names = g_malloc0_n (count + 1, sizeof (char *));
+  closures = g_malloc0_n (count + 1, sizeof (char *));
+  for (i = 0; i < count; i++)
+    names[i] = g_strdup_printf ("deps:%s", oids[i]);
+  kb_item_get_str_many (cache_kb, (const char **) names, count, closures);
+
+  /* Each closure is in launch order, so is the concatenation of the closures
+   * and the requested OIDs without duplicates. */
+  seen = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  for (i = 0; i < count; i++)
+    {
+      gchar **deps, **dep;
+
+      deps = g_strsplit (closures[i] ? closures[i] : "", ",", 0);
+      for (dep = deps;; dep++)
+        {
+          const char *oid = *dep ? *dep : oids[i];
+
+          if (*oid && !g_hash_table_contains (seen, oid))
+            {
+              g_hash_table_add (seen, g_strdup (oid));
+              order = g_slist_prepend (order, g_strdup (oid));
+            }
+          if (*dep == NULL)
+            break;
+        }
+      g_strfreev (deps);
+    }
+  g_hash_table_destroy (seen);
+  g_strfreev (names);
+  g_strfreev (closures);
+
+  return g_slist_reverse (order);
+}
+
+/**
+ * @brief Get the Category from a plugin OID.
+ *
+ * @param[in]   oid     OID to match.
+ *
+ * @return Category matching OID, -1 otherwise.
+ */
+int
+nvticache_get_category (const char *oid)
+{
+  int category;
+  char *category_s;
+
+  category_s = nvticache_get_field (oid, NVT_CATEGORY_POS);
+  category = atoi (category_s);
+  g_free (category_s);
+  return category;
+}
+
+/**
+ * @brief Get the name from a plugin OID.
+ *
+ * @param[in]   oid     OID to match.
+ *
+ * @return Name matching OID, NULL otherwise.
+ */
+char *
+nvticache_get_name (const char *oid)
+{
+  return nvticache_get_field (oid, NVT_NAME_POS);
+}
+
+/**
+ * @brief Get the cves from a plugin OID.
+ *
+ * @param[in]   oid     OID to match.
+ *
+ * @return CVEs matching OID, NULL otherwise.
+ */
+char *
+nvticache_get_cves (const char *oid)
+{
+  return nvticache_get_field (oid, NVT_CVES_POS);
+}
+
+/**
+ * @brief Get the bids from a plugin OID.
+ *
+ * @param[in]   oid     OID to match.
+ *
+ * @return BIDs matching OID, NULL otherwise.
+ */
+char *
+nvticache_get_bids (const char *oid)
+{
+  return nvticache_get_field (oid, NVT_BIDS_POS);
+}
+
+/**
+ * @brief Get the xrefs from a plugin OID.
+ *
+ * @param[in]   oid     OID to match.
+ *
+ * @return XREFs matching OID, NULL otherwise.
+ */
+char *
+nvticache_get_xrefs (const char *oid)
+{
+  return nvticache_get_field (oid, NVT_XREFS_POS);
+}
+
+/**
  * @brief Get the family from a plugin OID.
  *
  * @param[in]   oid     OID to match.
@@ -458,8 +1211,7 @@ nvticache_get_xrefs (const char *oid)
 char *
 nvticache_get_family (const char *oid)
 {
-  assert (cache_kb);
-  return kb_nvt_get (cache_kb, oid, NVT_FAMILY_POS);
+  return nvticache_get_field (oid, NVT_FAMILY_POS);
 }
 
 /**
@@ -472,8 +1224,7 @@ nvticache_get_family (const char *oid)
 char *
 nvticache_get_tags (const char *oid)
 {
-  assert (cache_kb);
-  return kb_nvt_get (cache_kb, oid, NVT_TAGS_POS);
+  return nvticache_get_field (oid, NVT_TAGS_POS);
 }
 
 /**
@@ -490,6 +1241,38 @@ nvticache_get_nvt (const char *oid)
   return kb_nvt_get_all (cache_kb, oid);
 }
 
+/**
+ * @brief Get a full NVT, including its prefs, with a single KB exchange.
+ *
+ * @param[in]   oid     OID to match.
+ *
+ * @return Full nvti with prefs matching OID, NULL otherwise.
+ */
+nvti_t *
+nvticache_get_nvt_full (const char *oid)
+{
+  assert (cache_kb);
+  return kb_nvt_get_full (cache_kb, oid);
+}
+
+/**
+ * @brief Get several full NVTs, including their prefs, with a single KB
+ *        exchange.
+ *
+ * @param[in]   oids    OIDs to match.
+ * @param[in]   count   Number of OIDs.
+ * @param[out]  nvtis   Array of count elements where to store the nvtis, to
+ *                      be freed with nvti_free(). NULL for unknown OIDs.
+ *
+ * @return Number of nvtis found, -1 on error.
+ */
+int
+nvticache_get_nvts (const char **oids, size_t count, nvti_t **nvtis)
+{
+  assert (cache_kb);
+  return kb_nvt_get_many (cache_kb, oids, count, nvtis);
+}
+
 /**
  * @brief Get the prefs from a plugin OID.
  *
@@ -500,29 +1283,9 @@ nvticache_get_nvt (const char *oid)
 GSList *
 nvticache_get_prefs (const char *oid)
 {
-  char pattern[4096];
-  struct kb_item *prefs, *element;
-  GSList *list = NULL;
-
   assert (cache_kb);
 
-  g_snprintf (pattern, sizeof (pattern), "oid:%s:prefs", oid);
-  prefs = element = kb_item_get_all (cache_kb, pattern);
-  while (element)
-    {
-      nvtpref_t *np;
-      char **array = g_strsplit (element->v_str, "|||", -1);
-
-      assert (array[3]);
-      assert (!array[4]);
-      np = nvtpref_new (atoi (array[0]), array[1], array[2], array[3]);
-      g_strfreev (array);
-      list = g_slist_append (list, np);
-      element = element->next;
-    }
-  kb_item_free (prefs);
-
-  return list;
+  return kb_nvt_get_prefs (cache_kb, oid);
 }
 
 /**
@@ -565,6 +1328,7 @@ nvticache_delete (const char *oid)
   assert (cache_kb);
   assert (oid);
 
+  lru_remove (oid);
   filename = nvticache_get_filename (oid);
   g_snprintf (pattern, sizeof (pattern), "oid:%s:prefs", oid);
   kb_del_items (cache_kb, pattern);
@@ -590,6 +1354,737 @@ nvticache_feed_version (void)
   return kb_item_get_str (cache_kb, NVTICACHE_STR);
 }
 
+/**
+ * @brief Parse a feed manifest.
+ *
+ * Each line of a manifest is the path of a NVT relative to the base location
+ * of NVTs, its modification time and a hash of its content, separated by
+ * tabs. The manifest is modified in place.
+ *
+ * @param[in] manifest  Content of the manifest.
+ *
+ * @return Table of the "mtime\thash" strings of the NVTs by path, pointing
+ *         into the manifest.
+ */
+static GHashTable *
+manifest_parse (char *manifest)
+{
+  GHashTable *entries = g_hash_table_new (g_str_hash, g_str_equal);
+  char *line, *next;
+
+  for (line = manifest; line && *line; line = next)
+    {
+      char *tab;
+
+      next = strchr (line, '\n');
+      if (next)
+        *next++ = '\0';
+      tab = strchr (line, '\t');
+      if (tab == NULL || tab == line || strchr (tab + 1, '\t') == NULL)
+        continue;
+      *tab = '\0';
+      g_hash_table_insert (entries, line, tab + 1);
+    }
+  return entries;
+}
+
+/**
+ * @brief Update the cache incrementally from a feed manifest.
+ *
+ * The manifest is compared to the one stored in the cache by the previous
+ * sync. Only the NVTs which were added or changed are parsed and added to
+ * the cache, and the NVTs of removed files are deleted. The feed version is
+ * bumped once all NVTs are updated. If the cache has no manifest yet, all
+ * NVTs of the manifest are added.
+ *
+ * @param[in] manifest  Path of the manifest, see manifest_parse for the
+ *                      format.
+ * @param[in] parse     Function parsing a NVT, given its path relative to the
+ *                      base location of NVTs. Returns NULL on failure.
+ * @param[in] data      Data passed to parse.
+ *
+ * @return Number of NVTs added, changed or removed, -1 on error.
+ */
+int
+nvticache_sync (const char *manifest, nvticache_parse_func_t parse,
+                void *data)
+{
+  char *content = NULL, *old_content, *feed_version;
+  GHashTable *entries, *old_entries;
+  GHashTableIter iter;
+  gpointer path, entry;
+  GString *stored;
+  GError *error = NULL;
+  int changed = 0, failed = 0;
+
+  assert (cache_kb);
+  assert (parse);
+
+  if (!g_file_get_contents (manifest, &content, NULL, &error))
+    {
+      g_warning ("%s: %s", __func__, error->message);
+      g_error_free (error);
+      return -1;
+    }
+  old_content = kb_item_get_str (cache_kb, NVTICACHE_MANIFEST_STR);
+  entries = manifest_parse (content);
+  old_entries = manifest_parse (old_content);
+  stored = g_string_sized_new (strlen (content) + 1);
+
+  g_hash_table_iter_init (&iter, entries);
+  while (g_hash_table_iter_next (&iter, &path, &entry))
+    {
+      const char *old_entry = g_hash_table_lookup (old_entries, path);
+      nvti_t *nvti;
+
+      if (old_entry == NULL || strcmp (old_entry, entry))
+        {
+          nvti = parse (path, data);
+          if (nvti == NULL || nvticache_add (nvti, path))
+            {
+              /* Left out of the stored manifest, to be tried again. */
+              g_warning ("%s: Failed to update %s", __func__,
+                         (const char *) path);
+              nvti_free (nvti);
+              failed++;
+              continue;
+            }
+          nvti_free (nvti);
+          changed++;
+        }
+      g_string_append_printf (stored, "%s\t%s\n", (const char *) path,
+                              (const char *) entry);
+    }
+
+  g_hash_table_iter_init (&iter, old_entries);
+  while (g_hash_table_iter_next (&iter, &path, NULL))
+    {
+      char *oid;
+
+      if (g_hash_table_contains (entries, path))
+        continue;
+      oid = kb_nvt_get (cache_kb, path, NVT_OID_POS);
+      /* The file may have been taken over by another path. */
+      if (oid)
+        {
+          char *filename = nvticache_get_filename (oid);
+
+          if (!g_strcmp0 (filename, path))
+            nvticache_delete (oid);
+          g_free (filename);
+          changed++;
+        }
+      g_free (oid);
+    }
+
+  g_hash_table_destroy (old_entries);
+  g_hash_table_destroy (entries);
+  g_free (old_content);
+  g_free (content);
+
+  if (kb_item_set_str (cache_kb, NVTICACHE_MANIFEST_STR, stored->str, 0))
+    changed = -1;
+  g_string_free (stored, TRUE);
+
+  /* Readers see the new version only once all NVTs are updated. */
+  if (changed >= 0 && failed == 0 && (feed_version = nvt_feed_version ()))
+    {
+      kb_item_set_str (cache_kb, NVTICACHE_STR, feed_version, 0);
+      g_free (feed_version);
+    }
+  lru_clear ();
+  if (changed > 0)
+    g_message ("Updated %d NVTs of the NVT cache incrementally", changed);
+
+  return changed;
+}
+
+/* Snapshots of the cache.
+ *
+ * A snapshot file is made of:
+ * - a header: NVTICACHE_SNAPSHOT_MAGIC, the version, the number of NVTs, the
+ *   number of buckets of the index and the offset of the index,
+ * - the feed version,
+ * - the NVTs, each one prefixed by its length: the OID, the fields in the
+ *   order of enum kb_nvt_pos up to NVT_NAME_POS, the number of prefs, then
+ *   for each pref its id, name, type and default,
+ * - the index, a table of the offsets of the NVTs by hash of their OID,
+ *   with linear probing. Empty buckets are 0.
+ *
+ * Numbers are little endian, 32 bits except for offsets which are 64 bits.
+ * Strings are prefixed by their length and followed by a NUL byte, so that
+ * they are used in place in the mapped file.
+ */
+
+/**
+ * @brief Magic prefix of snapshot files.
+ */
+#define NVTICACHE_SNAPSHOT_MAGIC "GVMNVTS"
+
+/**
+ * @brief Version of the format of snapshot files.
+ */
+#define NVTICACHE_SNAPSHOT_VERSION 1
+
+/**
+ * @brief Size of the header of snapshot files.
+ */
+#define NVTICACHE_SNAPSHOT_HEADER (sizeof (NVTICACHE_SNAPSHOT_MAGIC) + 20)
+
+/**
+ * @brief Number of NVTs fetched or added at once for snapshots.
+ */
+#define NVTICACHE_SNAPSHOT_CHUNK 1000
+
+/**
+ * @brief Snapshot file, mapped in memory.
+ */
+struct nvticache_snapshot
+{
+  const char *map;          /**< Mapped file. */
+  size_t len;               /**< Length of the file. */
+  guint32 count;            /**< Number of NVTs. */
+  guint32 buckets;          /**< Number of buckets of the index. */
+  const char *index;        /**< Index of the NVTs. */
+  const char *feed_version; /**< Feed version of the NVTs. */
+  size_t first;             /**< Offset of the first NVT. */
+};
+
+/**
+ * @brief NVT written to a snapshot, for the index.
+ */
+struct snapshot_entry
+{
+  guint32 hash;   /**< Hash of the OID. */
+  guint64 offset; /**< Offset of the NVT. */
+};
+
+/**
+ * @brief Cursor over a snapshot file.
+ */
+struct snapshot_cursor
+{
+  const char *data; /**< Data of the file. */
+  size_t len;       /**< End of the current part. */
+  size_t pos;       /**< Current position. */
+};
+
+static void
+snapshot_put_u32 (GString *buf, guint32 value)
+{
+  value = GUINT32_TO_LE (value);
+  g_string_append_len (buf, (const char *) &value, sizeof (value));
+}
+
+static void
+snapshot_put_u64 (GString *buf, guint64 value)
+{
+  value = GUINT64_TO_LE (value);
+  g_string_append_len (buf, (const char *) &value, sizeof (value));
+}
+
+static void
+snapshot_put_str (GString *buf, const char *str)
+{
+  size_t len;
+
+  if (str == NULL)
+    str = "";
+  len = strlen (str);
+  snapshot_put_u32 (buf, len);
+  /* Including the NUL byte. */
+  g_string_append_len (buf, str, len + 1);
+}
+
+static int
+snapshot_get_u32 (struct snapshot_cursor *cur, guint32 *value)
+{
+  if (cur->len - cur->pos < sizeof (*value))
+    return -1;
+  memcpy (value, cur->data + cur->pos, sizeof (*value));
+  *value = GUINT32_FROM_LE (*value);
+  cur->pos += sizeof (*value);
+  return 0;
+}
+
+static int
+snapshot_get_u64 (struct snapshot_cursor *cur, guint64 *value)
+{
+  if (cur->len - cur->pos < sizeof (*value))
+    return -1;
+  memcpy (value, cur->data + cur->pos, sizeof (*value));
+  *value = GUINT64_FROM_LE (*value);
+  cur->pos += sizeof (*value);
+  return 0;
+}
+
+static int
+snapshot_get_str (struct snapshot_cursor *cur, const char **str)
+{
+  guint32 len;
+
+  if (snapshot_get_u32 (cur, &len) || cur->len - cur->pos <= len
+      || cur->data[cur->pos + len] != '\0')
+    return -1;
+  *str = cur->data + cur->pos;
+  cur->pos += len + 1;
+  return 0;
+}
+
+/**
+ * @brief Append a NVT to a snapshot.
+ *
+ * @param[in] buf       Buffer of the NVT.
+ * @param[in] nvti      The NVT.
+ * @param[in] filename  Path to the NVT.
+ */
+static void
+snapshot_put_nvt (GString *buf, const nvti_t *nvti, const char *filename)
+{
+  gchar *cves, *bids, *xrefs, *category;
+  guint32 len;
+  unsigned int i;
+
+  /* Length, set once the NVT is written. */
+  snapshot_put_u32 (buf, 0);
+  snapshot_put_str (buf, nvti_oid (nvti));
+
+  nvti_refs_split_str (nvti, &cves, &bids, &xrefs);
+  category = g_strdup_printf ("%d", nvti_category (nvti));
+  snapshot_put_str (buf, filename);
+  snapshot_put_str (buf, nvti_required_keys (nvti));
+  snapshot_put_str (buf, nvti_mandatory_keys (nvti));
+  snapshot_put_str (buf, nvti_excluded_keys (nvti));
+  snapshot_put_str (buf, nvti_required_udp_ports (nvti));
+  snapshot_put_str (buf, nvti_required_ports (nvti));
+  snapshot_put_str (buf, nvti_dependencies (nvti));
+  snapshot_put_str (buf, nvti_tag (nvti));
+  snapshot_put_str (buf, cves);
+  snapshot_put_str (buf, bids);
+  snapshot_put_str (buf, xrefs);
+  snapshot_put_str (buf, category);
+  snapshot_put_str (buf, nvti_family (nvti));
+  snapshot_put_str (buf, nvti_name (nvti));
+  g_free (cves);
+  g_free (bids);
+  g_free (xrefs);
+  g_free (category);
+
+  snapshot_put_u32 (buf, nvti_pref_len (nvti));
+  for (i = 0; i < nvti_pref_len (nvti); i++)
+    {
+      const nvtpref_t *pref = nvti_pref (nvti, i);
+
+      snapshot_put_u32 (buf, nvtpref_id (pref));
+      snapshot_put_str (buf, nvtpref_name (pref));
+      snapshot_put_str (buf, nvtpref_type (pref));
+      snapshot_put_str (buf, nvtpref_default (pref));
+    }
+
+  len = GUINT32_TO_LE (buf->len - sizeof (len));
+  memcpy (buf->str, &len, sizeof (len));
+}
+
+/**
+ * @brief Read a NVT from a snapshot.
+ *
+ * @param[in]  snap      The snapshot.
+ * @param[in]  offset    Offset of the NVT.
+ * @param[in]  oid       OID the NVT must have, or NULL.
+ * @param[out] filename  Path to the NVT, pointing into the snapshot. May be
+ *                       NULL.
+ * @param[out] next      Offset of the next NVT. May be NULL.
+ *
+ * @return The NVT, NULL if invalid or if the OID doesn't match.
+ */
+static nvti_t *
+snapshot_get_nvt (const struct nvticache_snapshot *snap, guint64 offset,
+                  const char *oid, const char **filename, guint64 *next)
+{
+  /* The NVTs lie between the feed version and the index. */
+  struct snapshot_cursor cur = {snap->map, snap->index - snap->map, offset};
+  const char *fields[NVT_NAME_POS + 1], *nvt_oid;
+  guint32 len, count, i;
+  nvti_t *nvti;
+
+  if (offset < snap->first || offset >= cur.len || offset >= snap->len
+      || snapshot_get_u32 (&cur, &len) || cur.len - cur.pos < len)
+    return NULL;
+  cur.len = cur.pos + len;
+  if (next)
+    *next = cur.len;
+  if (snapshot_get_str (&cur, &nvt_oid) || (oid && strcmp (oid, nvt_oid)))
+    return NULL;
+  for (i = 0; i <= NVT_NAME_POS; i++)
+    if (snapshot_get_str (&cur, &fields[i]))
+      return NULL;
+
+  nvti = nvti_new ();
+  nvti_set_oid (nvti, nvt_oid);
+  nvti_set_required_keys (nvti, fields[NVT_REQUIRED_KEYS_POS]);
+  nvti_set_mandatory_keys (nvti, fields[NVT_MANDATORY_KEYS_POS]);
+  nvti_set_excluded_keys (nvti, fields[NVT_EXCLUDED_KEYS_POS]);
+  nvti_set_required_udp_ports (nvti, fields[NVT_REQUIRED_UDP_PORTS_POS]);
+  nvti_set_required_ports (nvti, fields[NVT_REQUIRED_PORTS_POS]);
+  nvti_set_dependencies (nvti, fields[NVT_DEPENDENCIES_POS]);
+  nvti_set_tag (nvti, fields[NVT_TAGS_POS]);
+  nvti_add_refs (nvti, "cve", fields[NVT_CVES_POS], "");
+  nvti_add_refs (nvti, "bid", fields[NVT_BIDS_POS], "");
+  nvti_add_refs (nvti, NULL, fields[NVT_XREFS_POS], "");
+  nvti_set_category (nvti, atoi (fields[NVT_CATEGORY_POS]));
+  nvti_set_family (nvti, fields[NVT_FAMILY_POS]);
+  nvti_set_name (nvti, fields[NVT_NAME_POS]);
+
+  if (snapshot_get_u32 (&cur, &count))
+    count = 0;
+  for (i = 0; i < count; i++)
+    {
+      const char *name, *type, *dflt;
+      guint32 id;
+
+      if (snapshot_get_u32 (&cur, &id) || snapshot_get_str (&cur, &name)
+          || snapshot_get_str (&cur, &type) || snapshot_get_str (&cur, &dflt))
+        break;
+      nvti_add_pref (nvti, nvtpref_new ((int) id, name, type, dflt));
+    }
+
+  if (filename)
+    *filename = fields[NVT_FILENAME_POS];
+  return nvti;
+}
+
+/**
+ * @brief Save a snapshot of the cache to a file.
+ *
+ * Meant to be called after a successful feed load. The file is written
+ * next to its destination first, then renamed.
+ *
+ * @param[in] path  Path of the snapshot file.
+ *
+ * @return Number of NVTs saved, -1 on error.
+ */
+int
+nvticache_save_snapshot (const char *path)
+{
+  GSList *oids, *element;
+  GArray *offsets;
+  GString *buf;
+  FILE *file;
+  gchar *tmp_path, *feed_version;
+  guint64 offset, *index;
+  guint32 buckets, i;
+  int ret = -1, failed = 0;
+
+  assert (cache_kb);
+
+  tmp_path = g_strdup_printf ("%s.tmp", path);
+  file = fopen (tmp_path, "w");
+  if (file == NULL)
+    {
+      g_warning ("%s: Failed to open %s: %s", __func__, tmp_path,
+                 strerror (errno));
+      g_free (tmp_path);
+      return -1;
+    }
+
+  /* Header, written again once the index is known. */
+  buf = g_string_sized_new (4096);
+  feed_version = nvticache_feed_version ();
+  g_string_append_len (buf, NVTICACHE_SNAPSHOT_MAGIC,
+                       sizeof (NVTICACHE_SNAPSHOT_MAGIC));
+  g_string_append_len (buf, "", NVTICACHE_SNAPSHOT_HEADER - buf->len);
+  snapshot_put_str (buf, feed_version);
+  g_free (feed_version);
+  if (fwrite (buf->str, buf->len, 1, file) != 1)
+    goto out;
+  offset = buf->len;
+
+  offsets = g_array_new (FALSE, FALSE, sizeof (struct snapshot_entry));
+  oids = nvticache_get_oids ();
+  element = oids;
+  while (element && !failed)
+    {
+      const char *chunk[NVTICACHE_SNAPSHOT_CHUNK];
+      nvti_t *nvtis[NVTICACHE_SNAPSHOT_CHUNK];
+      char *filenames[NVTICACHE_SNAPSHOT_CHUNK];
+      size_t count = 0, j;
+
+      for (; element && count < NVTICACHE_SNAPSHOT_CHUNK;
+           element = element->next)
+        chunk[count++] = element->data;
+      if (nvticache_get_nvts (chunk, count, nvtis) < 0)
+        {
+          failed = 1;
+          break;
+        }
+      if (kb_nvt_get_many_field (cache_kb, chunk, count, NVT_FILENAME_POS,
+                                 filenames)
+          < 0)
+        memset (filenames, 0, sizeof (filenames));
+      for (j = 0; j < count; j++)
+        {
+          if (nvtis[j] && filenames[j] && !failed)
+            {
+              struct snapshot_entry entry;
+
+              g_string_truncate (buf, 0);
+              snapshot_put_nvt (buf, nvtis[j], filenames[j]);
+              if (fwrite (buf->str, buf->len, 1, file) != 1)
+                failed = 1;
+              entry.hash = g_str_hash (nvti_oid (nvtis[j]));
+              entry.offset = offset;
+              g_array_append_val (offsets, entry);
+              offset += buf->len;
+            }
+          nvti_free (nvtis[j]);
+          g_free (filenames[j]);
+        }
+    }
+  g_slist_free_full (oids, g_free);
+  /* A failed chunk, the last one included, leaves a truncated snapshot. */
+  if (failed)
+    {
+      g_array_free (offsets, TRUE);
+      goto out;
+    }
+
+  /* Index, with at least twice as many buckets as NVTs. */
+  for (buckets = 16; buckets < 2 * offsets->len; buckets *= 2)
+    ;
+  index = g_malloc0_n (buckets, sizeof (guint64));
+  for (i = 0; i < offsets->len; i++)
+    {
+      struct snapshot_entry *entry =
+        &g_array_index (offsets, struct snapshot_entry, i);
+      guint32 bucket = entry->hash & (buckets - 1);
+
+      while (index[bucket])
+        bucket = (bucket + 1) & (buckets - 1);
+      index[bucket] = GUINT64_TO_LE (entry->offset);
+    }
+  g_string_truncate (buf, 0);
+  g_string_append_len (buf, NVTICACHE_SNAPSHOT_MAGIC,
+                       sizeof (NVTICACHE_SNAPSHOT_MAGIC));
+  snapshot_put_u32 (buf, NVTICACHE_SNAPSHOT_VERSION);
+  snapshot_put_u32 (buf, offsets->len);
+  snapshot_put_u32 (buf, buckets);
+  snapshot_put_u64 (buf, offset);
+  ret = offsets->len;
+  if (fwrite (index, sizeof (guint64), buckets, file) != buckets
+      || fseek (file, 0, SEEK_SET)
+      || fwrite (buf->str, buf->len, 1, file) != 1)
+    ret = -1;
+  g_free (index);
+  g_array_free (offsets, TRUE);
+
+out:
+  g_string_free (buf, TRUE);
+  if (fclose (file))
+    ret = -1;
+  if (ret >= 0 && rename (tmp_path, path))
+    {
+      g_warning ("%s: Failed to rename %s: %s", __func__, tmp_path,
+                 strerror (errno));
+      ret = -1;
+    }
+  if (ret < 0)
+    unlink (tmp_path);
+  g_free (tmp_path);
+  return ret;
+}
+
+/**
+ * @brief Open a snapshot of the cache.
+ *
+ * The file is mapped in memory, the NVTs are read with
+ * nvticache_snapshot_get through the index of the snapshot.
+ *
+ * @param[in] path  Path of the snapshot file.
+ *
+ * @return The snapshot, to be closed with nvticache_snapshot_close. NULL on
+ *         error.
+ */
+struct nvticache_snapshot *
+nvticache_snapshot_open (const char *path)
+{
+  struct nvticache_snapshot *snap;
+  struct snapshot_cursor cur;
+  struct stat st;
+  guint32 version;
+  guint64 index;
+  void *map;
+  int fd;
+
+  fd = open (path, O_RDONLY);
+  if (fd < 0)
+    {
+      g_warning ("%s: Failed to open %s: %s", __func__, path,
+                 strerror (errno));
+      return NULL;
+    }
+  if (fstat (fd, &st) < 0 || (size_t) st.st_size < NVTICACHE_SNAPSHOT_HEADER)
+    {
+      g_warning ("%s: Invalid snapshot %s", __func__, path);
+      close (fd);
+      return NULL;
+    }
+  map = mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close (fd);
+  if (map == MAP_FAILED)
+    {
+      g_warning ("%s: Failed to map %s: %s", __func__, path, strerror (errno));
+      return NULL;
+    }
+
+  snap = g_malloc0 (sizeof (struct nvticache_snapshot));
+  snap->map = map;
+  snap->len = st.st_size;
+  cur.data = snap->map;
+  cur.len = snap->len;
+  cur.pos = sizeof (NVTICACHE_SNAPSHOT_MAGIC);
+  if (memcmp (snap->map, NVTICACHE_SNAPSHOT_MAGIC, cur.pos)
+      || snapshot_get_u32 (&cur, &version)
+      || version != NVTICACHE_SNAPSHOT_VERSION
+      || snapshot_get_u32 (&cur, &snap->count)
+      || snapshot_get_u32 (&cur, &snap->buckets)
+      || snapshot_get_u64 (&cur, &index)
+      || snapshot_get_str (&cur, &snap->feed_version) || snap->buckets == 0
+      || (snap->buckets & (snap->buckets - 1)) || index < cur.pos
+      || index > snap->len
+      || (snap->len - index) / sizeof (guint64) < snap->buckets)
+    {
+      g_warning ("%s: Invalid snapshot %s", __func__, path);
+      nvticache_snapshot_close (snap);
+      return NULL;
+    }
+  snap->first = cur.pos;
+  snap->index = snap->map + index;
+  return snap;
+}
+
+/**
+ * @brief Close a snapshot of the cache.
+ *
+ * @param[in] snap  The snapshot.
+ */
+void
+nvticache_snapshot_close (struct nvticache_snapshot *snap)
+{
+  if (snap == NULL)
+    return;
+  munmap ((void *) snap->map, snap->len);
+  g_free (snap);
+}
+
+/**
+ * @brief Get a full NVT, including its prefs, from a snapshot.
+ *
+ * @param[in] snap  The snapshot.
+ * @param[in] oid   OID of the NVT.
+ *
+ * @return The NVT, to be freed with nvti_free. NULL if not found.
+ */
+nvti_t *
+nvticache_snapshot_get (const struct nvticache_snapshot *snap,
+                        const char *oid)
+{
+  guint32 bucket, tries;
+
+  assert (snap);
+  if (oid == NULL)
+    return NULL;
+
+  bucket = g_str_hash (oid) & (snap->buckets - 1);
+  for (tries = 0; tries < snap->buckets; tries++)
+    {
+      guint64 offset;
+      nvti_t *nvti;
+
+      memcpy (&offset, snap->index + bucket * sizeof (offset),
+              sizeof (offset));
+      offset = GUINT64_FROM_LE (offset);
+      if (offset == 0)
+        break;
+      if ((nvti = snapshot_get_nvt (snap, offset, oid, NULL, NULL)))
+        return nvti;
+      bucket = (bucket + 1) & (snap->buckets - 1);
+    }
+  return NULL;
+}
+
+/**
+ * @brief Load a snapshot of the cache into the cache.
+ *
+ * The NVTs are added in batches, then the feed version of the snapshot is
+ * set, as after a feed load.
+ *
+ * @param[in] path  Path of the snapshot file.
+ *
+ * @return Number of NVTs loaded, -1 on error.
+ */
+int
+nvticache_load_snapshot (const char *path)
+{
+  struct nvticache_snapshot *snap;
+  const nvti_t *nvtis[NVTICACHE_SNAPSHOT_CHUNK];
+  const char *filenames[NVTICACHE_SNAPSHOT_CHUNK];
+  guint64 offset, end;
+  size_t count = 0, i;
+  int loaded = 0;
+
+  assert (cache_kb);
+
+  snap = nvticache_snapshot_open (path);
+  if (snap == NULL)
+    return -1;
+
+  end = snap->index - snap->map;
+  for (offset = snap->first; offset < end || count;)
+    {
+      nvti_t *nvti = NULL;
+
+      if (offset < end)
+        {
+          nvti = snapshot_get_nvt (snap, offset, NULL, &filenames[count],
+                                   &offset);
+          if (nvti == NULL)
+            {
+              g_warning ("%s: Invalid NVT in %s", __func__, path);
+              loaded = -1;
+              break;
+            }
+          nvtis[count++] = nvti;
+        }
+      if (count == NVTICACHE_SNAPSHOT_CHUNK || (nvti == NULL && count))
+        {
+          int errors[NVTICACHE_SNAPSHOT_CHUNK];
+
+          if (nvticache_add_batch (nvtis, filenames, count, errors) < 0)
+            {
+              g_warning ("%s: Cannot store the NVTs of %s", __func__, path);
+              loaded = -1;
+            }
+          for (i = 0; i < count; i++)
+            {
+              if (loaded >= 0 && errors[i] == 0)
+                loaded++;
+              nvti_free ((nvti_t *) nvtis[i]);
+            }
+          count = 0;
+          if (loaded < 0)
+            break;
+        }
+    }
+  for (i = 0; i < count; i++)
+    nvti_free ((nvti_t *) nvtis[i]);
+
+  if (loaded >= 0)
+    kb_item_set_str (cache_kb, NVTICACHE_STR, snap->feed_version, 0);
+  lru_clear ();
+  nvticache_snapshot_close (snap);
+  return loaded;
+}
+
 /**
  * @brief Check if the plugins feed was newer than cached feed.
  *
@@ -607,5 +2102,8 @@ nvticache_check_feed (void)
   ret = strcmp (cached, current);
   g_free (cached);
   g_free (current);
+  /* The NVTs in the LRU may be outdated. */
+  if (ret)
+    lru_clear ();
   return ret;
 }
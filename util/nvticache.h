@@ -22,6 +22,21 @@
 #define NVTICACHE_STR "nvticache"
 #endif
 
+/**
+ * @brief Name of the item storing the manifest of the last nvticache_sync.
+ */
+#define NVTICACHE_MANIFEST_STR NVTICACHE_STR ".manifest"
+
+/**
+ * @brief Name of the item storing the feed version of the dependency graph.
+ */
+#define NVTICACHE_DEPS_STR NVTICACHE_STR ".deps"
+
+/**
+ * @brief Function parsing a NVT, for nvticache_sync.
+ */
+typedef nvti_t *(*nvticache_parse_func_t) (const char *, void *);
+
 int
 nvticache_init (const char *, const char *);
 
@@ -40,9 +55,15 @@ nvticache_initialized (void);
 int
 nvticache_check (const gchar *);
 
+GSList *
+nvticache_check_many (const gchar **, size_t);
+
 int
 nvticache_add (const nvti_t *, const char *);
 
+int
+nvticache_add_batch (const nvti_t **, const char **, size_t, int *);
+
 char *
 nvticache_get_src (const char *);
 
@@ -94,9 +115,21 @@ nvticache_get_category (const char *);
 char *
 nvticache_get_dependencies (const char *);
 
+int
+nvticache_update_dependencies (void);
+
+GSList *
+nvticache_get_launch_order (const char **, size_t);
+
 nvti_t *
 nvticache_get_nvt (const char *);
 
+nvti_t *
+nvticache_get_nvt_full (const char *);
+
+int
+nvticache_get_nvts (const char **, size_t, nvti_t **);
+
 GSList *
 nvticache_get_oids (void);
 
@@ -112,4 +145,33 @@ nvticache_feed_version (void);
 int
 nvticache_check_feed (void);
 
+int
+nvticache_sync (const char *, nvticache_parse_func_t, void *);
+
+/**
+ * @brief Snapshot of the cache, mapped in memory.
+ */
+typedef struct nvticache_snapshot nvticache_snapshot_t;
+
+int
+nvticache_save_snapshot (const char *);
+
+int
+nvticache_load_snapshot (const char *);
+
+nvticache_snapshot_t *
+nvticache_snapshot_open (const char *);
+
+nvti_t *
+nvticache_snapshot_get (const nvticache_snapshot_t *, const char *);
+
+void
+nvticache_snapshot_close (nvticache_snapshot_t *);
+
+void
+nvticache_set_lru_limits (size_t, size_t);
+
+void
+nvticache_get_lru_stats (size_t *, size_t *, size_t *, size_t *);
+
 #endif /* not _GVM_NVTICACHE_H */
@@ -11,6 +11,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 // UFC_crypt defines crypt_r when only when __USE_GNU is set
 // this shouldn't affect other implementations
 #define __USE_GNU
@@ -28,6 +29,22 @@
 #define CRYPT_OUTPUT_SIZE 384
 #endif
 
+// struct crypt_data is about 128 KB, so each thread keeps its own.
+static GPrivate pba_crypt_data_key = G_PRIVATE_INIT (free);
+
+static struct crypt_data *
+pba_crypt_data (void)
+{
+  struct crypt_data *data = g_private_get (&pba_crypt_data_key);
+
+  if (data == NULL)
+    {
+      data = calloc (1, sizeof (struct crypt_data));
+      g_private_set (&pba_crypt_data_key, data);
+    }
+  return data;
+}
+
 static int
 is_prefix_supported (const char *id)
 {
@@ -188,7 +205,7 @@ pba_hash (struct PBASettings *setting, const char *password)
       tmp--;
     }
 
-  data = calloc (1, sizeof (struct crypt_data));
+  data = pba_crypt_data ();
   rslt = crypt_r (password, settings, data);
   if (rslt == NULL)
     goto exit;
@@ -204,8 +221,6 @@ pba_hash (struct PBASettings *setting, const char *password)
         tmp[0] = '0';
     }
 exit:
-  if (data != NULL)
-    free (data);
   if (settings != NULL)
     free (settings);
   return result;
@@ -233,7 +248,7 @@ pba_verify_hash (const struct PBASettings *setting, const char *hash,
       int hash_size;
       hash_size = hash ? strlen (hash) : strlen (invalid_hash);
 
-      data = calloc (1, sizeof (struct crypt_data));
+      data = pba_crypt_data ();
       // manipulate hash to reapply pepper
       tmp = calloc (1, CRYPT_OUTPUT_SIZE);
 
@@ -274,9 +289,150 @@ pba_verify_hash (const struct PBASettings *setting, const char *hash,
     }
 exit:
   free (invalid_hash);
-  if (data != NULL)
-    free (data);
   if (tmp != NULL)
     free (tmp);
   return result;
 }
+
+// jobs of pba_verify_hash_async
+struct pba_job
+{
+  const struct PBASettings *settings;
+  char *hash;
+  char *password;
+  pba_verify_callback callback;
+  void *data;
+};
+
+static GThreadPool *pba_pool = NULL;
+static unsigned int pba_pool_max_queued = 0;
+static gint pba_pool_queued = 0;
+
+static void
+pba_job_free (struct pba_job *job)
+{
+  // the password should not linger in freed memory
+  if (job->password != NULL)
+    {
+      explicit_bzero (job->password, strlen (job->password));
+      free (job->password);
+    }
+  free (job->hash);
+  free (job);
+}
+
+static void
+pba_job_run (gpointer job_data, gpointer user_data)
+{
+  struct pba_job *job = job_data;
+  enum pba_rc result;
+
+  (void) user_data;
+  result = pba_verify_hash (job->settings, job->hash, job->password);
+  g_atomic_int_add (&pba_pool_queued, -1);
+  job->callback (result, job->data);
+  pba_job_free (job);
+}
+
+int
+pba_pool_init (unsigned int threads, unsigned int max_queued)
+{
+  GError *error = NULL;
+
+  if (pba_pool != NULL || threads == 0 || max_queued == 0)
+    return -1;
+  // pba_verify_hash may need it for old hashes, initialize it only once
+  if (initialized == FALSE && gvm_auth_init () != 0)
+    return -1;
+  pba_pool = g_thread_pool_new (pba_job_run, NULL, threads, FALSE, &error);
+  if (pba_pool == NULL)
+    {
+      g_warning ("%s: %s", __func__, error->message);
+      g_error_free (error);
+      return -1;
+    }
+  pba_pool_max_queued = max_queued;
+  return 0;
+}
+
+void
+pba_pool_finalize (void)
+{
+  if (pba_pool == NULL)
+    return;
+  g_thread_pool_free (pba_pool, FALSE, TRUE);
+  pba_pool = NULL;
+}
+
+int
+pba_verify_hash_async (const struct PBASettings *setting, const char *hash,
+                       const char *password, pba_verify_callback callback,
+                       void *data)
+{
+  struct pba_job *job;
+
+  if (pba_pool == NULL || callback == NULL)
+    return -1;
+  if ((unsigned int) g_atomic_int_add (&pba_pool_queued, 1)
+      >= pba_pool_max_queued)
+    {
+      g_atomic_int_add (&pba_pool_queued, -1);
+      return -1;
+    }
+  job = calloc (1, sizeof (struct pba_job));
+  job->settings = setting;
+  job->hash = hash ? strdup (hash) : NULL;
+  job->password = password ? strdup (password) : NULL;
+  job->callback = callback;
+  job->data = data;
+  if (!g_thread_pool_push (pba_pool, job, NULL))
+    {
+      g_atomic_int_add (&pba_pool_queued, -1);
+      pba_job_free (job);
+      return -1;
+    }
+  return 0;
+}
+
+static long long
+pba_time_hash (struct PBASettings *setting)
+{
+  struct timespec start, end;
+  char *hash;
+
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  hash = pba_hash (setting, "calibration password");
+  clock_gettime (CLOCK_MONOTONIC, &end);
+  if (hash == NULL)
+    return -1;
+  free (hash);
+  return (end.tv_sec - start.tv_sec) * 1000000000LL
+         + (end.tv_nsec - start.tv_nsec);
+}
+
+unsigned int
+pba_calibrate (unsigned int target_ms)
+{
+  struct PBASettings setting = {{0}, PBA_CALIBRATE_COUNT_MIN, PREFIX_DEFAULT};
+  long long elapsed;
+  double count;
+  int round;
+
+  if (target_ms == 0)
+    return 0;
+  // the second round corrects for the fixed costs of the first
+  count = setting.count;
+  for (round = 0; round < 2; round++)
+    {
+      setting.count = count;
+      elapsed = pba_time_hash (&setting);
+      if (elapsed <= 0)
+        return 0;
+      count = (double) setting.count * target_ms * 1000000 / elapsed;
+      if (count < PBA_CALIBRATE_COUNT_MIN)
+        count = PBA_CALIBRATE_COUNT_MIN;
+      else if (count > PBA_CALIBRATE_COUNT_MAX)
+        count = PBA_CALIBRATE_COUNT_MAX;
+    }
+  return count;
+}
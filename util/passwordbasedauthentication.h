@@ -73,4 +73,50 @@ pba_verify_hash (const struct PBASettings *settings, const char *hash,
 void
 pba_finalize (struct PBASettings *settings);
 
+/* is called with the result of pba_verify_hash_async and its DATA */
+typedef void (*pba_verify_callback) (enum pba_rc result, void *data);
+
+/**
+ * pba_pool_init starts a pool of THREADS threads for pba_verify_hash_async,
+ * accepting at most MAX_QUEUED verifications that are queued or running.
+ *
+ * Returns 0 on success or -1 on failure or when the pool is already started.
+ */
+int
+pba_pool_init (unsigned int threads, unsigned int max_queued);
+
+/**
+ * pba_pool_finalize waits for the queued verifications and stops the pool.
+ */
+void
+pba_pool_finalize (void);
+
+/**
+ * pba_verify_hash_async runs pba_verify_hash in the pool and calls CALLBACK
+ * with the result and DATA from a thread of the pool.
+ *
+ * HASH and PASSWORD are copied, SETTINGS must stay valid until CALLBACK is
+ * called.
+ *
+ * Returns 0 when the verification is queued or -1 when the pool is not
+ * started or full.
+ */
+int
+pba_verify_hash_async (const struct PBASettings *settings, const char *hash,
+                       const char *password, pba_verify_callback callback,
+                       void *data);
+
+/* bounds of the count of the default prefix */
+#define PBA_CALIBRATE_COUNT_MIN 1000
+#define PBA_CALIBRATE_COUNT_MAX 999999999
+
+/**
+ * pba_calibrate measures pba_hash with the default prefix and returns the
+ * count for which a hash takes about TARGET_MS milliseconds on this machine.
+ *
+ * Returns the count or 0 on failure.
+ */
+unsigned int
+pba_calibrate (unsigned int target_ms);
+
 #endif
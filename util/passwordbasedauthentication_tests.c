@@ -112,6 +112,45 @@ Ensure (PBA, handle_md5_hash)
   pba_finalize (settings);
 }
 
+static void
+store_result (enum pba_rc result, void *data)
+{
+  g_atomic_int_set ((gint *) data, result);
+}
+
+Ensure (PBA, verify_hash_async)
+{
+  struct PBASettings setting = {"4242", 20000, "$6$"};
+  gint valid = ERR, invalid = ERR;
+  char *hash;
+
+  hash = pba_hash (&setting, "*password");
+  assert_not_equal (hash, NULL);
+  assert_equal (pba_verify_hash_async (&setting, hash, "*password",
+                                       store_result, &valid),
+                -1);
+  assert_equal (pba_pool_init (2, 8), 0);
+  assert_equal (pba_verify_hash_async (&setting, hash, "*password",
+                                       store_result, &valid),
+                0);
+  assert_equal (pba_verify_hash_async (&setting, hash, "*password1",
+                                       store_result, &invalid),
+                0);
+  free (hash);
+  pba_pool_finalize ();
+  assert_equal (valid, VALID);
+  assert_equal (invalid, INVALID);
+}
+
+Ensure (PBA, calibrate_returns_count_in_bounds)
+{
+  unsigned int count = pba_calibrate (1);
+
+  assert_true (count >= PBA_CALIBRATE_COUNT_MIN);
+  assert_true (count <= PBA_CALIBRATE_COUNT_MAX);
+  assert_equal (pba_calibrate (0), 0);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -130,6 +169,8 @@ main (int argc, char **argv)
   add_test_with_context (suite, PBA, handle_md5_hash);
   add_test_with_context (suite, PBA, defaults);
   add_test_with_context (suite, PBA, initialization);
+  add_test_with_context (suite, PBA, verify_hash_async);
+  add_test_with_context (suite, PBA, calibrate_returns_count_in_bounds);
   if (argc > 1)
     return run_single_test (suite, argv[1], create_text_reporter ());
   return run_test_suite (suite, create_text_reporter ());
@@ -16,6 +16,7 @@
 #include "serverutils.h"
 
 #include "../base/hosts.h" /* for is_hostname, is_ipv4_address, is_ipv6_add.. */
+#include "../base/probes.h" /* for GVM_PROBE2, GVM_PROBE3 */
 
 #include <arpa/inet.h>
 #include <errno.h>  /* for errno, ENOTCONN, EAGAIN */
@@ -23,13 +24,18 @@
 #include <gcrypt.h> /* for gcry_control */
 #include <glib.h>   /* for g_warning, g_free, g_debug, gchar, g_markup... */
 #include <gnutls/x509.h> /* for gnutls_x509_crt_..., gnutls_x509_privkey_... */
+#include <limits.h>     /* for IOV_MAX */
 #include <netdb.h>      /* for addrinfo, freeaddrinfo, gai_strerror, getad... */
+#include <poll.h>       /* for poll */
 #include <signal.h>     /* for sigaction, SIGPIPE, sigemptyset, SIG_IGN */
 #include <stdio.h>      /* for fclose, FILE, SEEK_END, SEEK_SET */
 #include <string.h>     /* for strerror, strlen, memset */
 #include <sys/socket.h> /* for shutdown, connect, socket, SHUT_RDWR, SOCK_... */
+#include <sys/stat.h>   /* for stat */
 #include <sys/types.h>
-#include <unistd.h> /* for close, ssize_t, usleep */
+#include <sys/uio.h> /* for writev, iovec */
+#include <sys/un.h>  /* for sockaddr_un */
+#include <unistd.h>  /* for close, ssize_t, usleep */
 
 #undef G_LOG_DOMAIN
 /**
@@ -43,6 +49,8 @@ static int
 server_new_internal (unsigned int, const char *, const gchar *, const gchar *,
                      const gchar *, gnutls_session_t *,
                      gnutls_certificate_credentials_t *);
+static void
+credentials_release (gnutls_certificate_credentials_t);
 
 /* Connections. */
 
@@ -297,6 +305,227 @@ client_cert_callback (gnutls_session_t session,
   return 0;
 }
 
+/* Session resumption. */
+
+/**
+ * @brief Entry of the client session cache.
+ *
+ * Entries live as long as the process, so that a session can point to its
+ * entry to store the tickets it receives.
+ */
+typedef struct
+{
+  gnutls_datum_t data; ///< Session data to resume from, empty if none.
+} session_cache_entry_t;
+
+/**
+ * @brief Lock for the session cache and its entries.
+ */
+static GMutex session_cache_mutex;
+
+/**
+ * @brief Client session cache, keyed by host, port and certificates.
+ */
+static GHashTable *session_cache = NULL;
+
+/**
+ * @brief Key for resuming the sessions of the server end.
+ */
+static gnutls_datum_t session_ticket_key = {NULL, 0};
+
+/**
+ * @brief Get the session cache entry for a server and client certificate.
+ *
+ * @param[in]  host      Host.
+ * @param[in]  port      Port.
+ * @param[in]  ca_mem    CA cert or NULL.
+ * @param[in]  pub_mem   Public key or NULL.
+ * @param[in]  priv_mem  Private key or NULL.
+ *
+ * @return Entry, created if needed.
+ */
+static session_cache_entry_t *
+session_cache_entry (const char *host, int port, const char *ca_mem,
+                     const char *pub_mem, const char *priv_mem)
+{
+  session_cache_entry_t *entry;
+  GChecksum *checksum;
+  gchar *key;
+
+  /* Hash the certificates, to not keep copies of the private key. */
+  checksum = g_checksum_new (G_CHECKSUM_SHA256);
+  g_checksum_update (checksum, (const guchar *) (ca_mem ? ca_mem : ""), -1);
+  g_checksum_update (checksum, (const guchar *) "\n--\n", -1);
+  g_checksum_update (checksum, (const guchar *) (pub_mem ? pub_mem : ""), -1);
+  g_checksum_update (checksum, (const guchar *) "\n--\n", -1);
+  g_checksum_update (checksum, (const guchar *) (priv_mem ? priv_mem : ""),
+                     -1);
+  key = g_strdup_printf ("%s:%d:%s", host, port,
+                         g_checksum_get_string (checksum));
+  g_checksum_free (checksum);
+
+  g_mutex_lock (&session_cache_mutex);
+  if (session_cache == NULL)
+    session_cache = g_hash_table_new (g_str_hash, g_str_equal);
+  entry = g_hash_table_lookup (session_cache, key);
+  if (entry == NULL)
+    {
+      entry = g_malloc0 (sizeof (*entry));
+      g_hash_table_insert (session_cache, key, entry);
+    }
+  else
+    g_free (key);
+  g_mutex_unlock (&session_cache_mutex);
+  return entry;
+}
+
+/**
+ * @brief Store the resumption data of a session in its cache entry.
+ *
+ * @param[in]  session  Session, with the cache entry as its pointer.
+ */
+static void
+session_cache_store (gnutls_session_t session)
+{
+  session_cache_entry_t *entry;
+  gnutls_datum_t data;
+
+  entry = gnutls_session_get_ptr (session);
+  if (entry == NULL || gnutls_session_get_data2 (session, &data))
+    return;
+  g_mutex_lock (&session_cache_mutex);
+  gnutls_free (entry->data.data);
+  entry->data = data;
+  g_mutex_unlock (&session_cache_mutex);
+}
+
+/**
+ * @brief Drop the resumption data of a session from its cache entry.
+ *
+ * @param[in]  session  Session, with the cache entry as its pointer.
+ */
+static void
+session_cache_forget (gnutls_session_t session)
+{
+  session_cache_entry_t *entry;
+
+  entry = gnutls_session_get_ptr (session);
+  if (entry == NULL)
+    return;
+  g_mutex_lock (&session_cache_mutex);
+  gnutls_free (entry->data.data);
+  entry->data.data = NULL;
+  entry->data.size = 0;
+  g_mutex_unlock (&session_cache_mutex);
+}
+
+/**
+ * @brief Handshake hook storing the tickets the server sends.
+ *
+ * With TLS 1.3 the ticket comes after the handshake, with the first reply.
+ *
+ * @param[in]  session   Session.
+ * @param[in]  htype     Handshake message type.
+ * @param[in]  when      Whether before or after the message is processed.
+ * @param[in]  incoming  Whether the message was received.
+ * @param[in]  msg       Message.
+ *
+ * @return 0, to carry on with the handshake.
+ */
+static int
+session_cache_ticket_hook (gnutls_session_t session, unsigned int htype,
+                           unsigned int when, unsigned int incoming,
+                           const gnutls_datum_t *msg)
+{
+  (void) msg;
+  if (htype == GNUTLS_HANDSHAKE_NEW_SESSION_TICKET && when == GNUTLS_HOOK_POST
+      && incoming && gnutls_protocol_get_version (session) == GNUTLS_TLS1_3)
+    session_cache_store (session);
+  return 0;
+}
+
+/**
+ * @brief Prepare a client session to resume from the session cache.
+ *
+ * @param[in]  session  Session.
+ * @param[in]  entry    Session cache entry of the server.
+ */
+static void
+session_cache_attach (gnutls_session_t session, session_cache_entry_t *entry)
+{
+  gnutls_session_set_ptr (session, entry);
+  gnutls_handshake_set_hook_function (session,
+                                      GNUTLS_HANDSHAKE_NEW_SESSION_TICKET,
+                                      GNUTLS_HOOK_POST,
+                                      session_cache_ticket_hook);
+  g_mutex_lock (&session_cache_mutex);
+  if (entry->data.size
+      && gnutls_session_set_data (session, entry->data.data, entry->data.size))
+    g_debug ("%s: failed to set session data", __func__);
+  g_mutex_unlock (&session_cache_mutex);
+}
+
+/**
+ * @brief Drop all the client sessions kept for resumption.
+ *
+ * The next connection to each server does a full handshake again.
+ */
+void
+gvm_server_session_cache_clear (void)
+{
+  GHashTableIter iter;
+  gpointer entry;
+
+  g_mutex_lock (&session_cache_mutex);
+  if (session_cache)
+    {
+      g_hash_table_iter_init (&iter, session_cache);
+      while (g_hash_table_iter_next (&iter, NULL, &entry))
+        {
+          gnutls_free (((session_cache_entry_t *) entry)->data.data);
+          ((session_cache_entry_t *) entry)->data.data = NULL;
+          ((session_cache_entry_t *) entry)->data.size = 0;
+        }
+    }
+  g_mutex_unlock (&session_cache_mutex);
+}
+
+/**
+ * @brief Enable session tickets on the server end of a session.
+ *
+ * The ticket key is generated once, so that clients can resume on any
+ * later session of the process.
+ *
+ * @param[in]  session  Server session.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+session_ticket_enable_server (gnutls_session_t session)
+{
+  int ret;
+
+  g_mutex_lock (&session_cache_mutex);
+  if (session_ticket_key.data == NULL
+      && (ret = gnutls_session_ticket_key_generate (&session_ticket_key)))
+    {
+      g_mutex_unlock (&session_cache_mutex);
+      g_warning ("%s: failed to generate ticket key: %s", __func__,
+                 gnutls_strerror (ret));
+      return -1;
+    }
+  g_mutex_unlock (&session_cache_mutex);
+
+  ret = gnutls_session_ticket_enable_server (session, &session_ticket_key);
+  if (ret)
+    {
+      g_warning ("%s: failed to enable session tickets: %s", __func__,
+                 gnutls_strerror (ret));
+      return -1;
+    }
+  return 0;
+}
+
 /**
  * @brief Connect to the server using a given host, port and cert.
  *
@@ -315,6 +544,7 @@ gvm_server_open_verify (gnutls_session_t *session, const char *host, int port,
                         const char *ca_mem, const char *pub_mem,
                         const char *priv_mem, int verify)
 {
+  long long start = GVM_PROBE_USEC ();
   int ret;
   int server_socket;
   struct addrinfo address_hints;
@@ -323,6 +553,7 @@ gvm_server_open_verify (gnutls_session_t *session, const char *host, int port,
   int host_type;
 
   gnutls_certificate_credentials_t credentials;
+  session_cache_entry_t *cache_entry;
 
   /* Ensure that host and port have sane values. */
   if (port < 1 || port > 65535)
@@ -340,9 +571,6 @@ gvm_server_open_verify (gnutls_session_t *session, const char *host, int port,
       return -1;
     }
 
-  /** @warning On success we are leaking the credentials. We can't free
-      them because the session only makes a shallow copy. */
-
   if (gvm_server_new_mem (GNUTLS_CLIENT, ca_mem, pub_mem, priv_mem, session,
                           &credentials))
     {
@@ -359,6 +587,10 @@ gvm_server_open_verify (gnutls_session_t *session, const char *host, int port,
                                                 client_cert_callback);
     }
 
+  /* Resume the last session with this server, if any. */
+  cache_entry = session_cache_entry (host, port, ca_mem, pub_mem, priv_mem);
+  session_cache_attach (*session, cache_entry);
+
   /* Create the port string. */
 
   port_string = g_strdup_printf ("%i", port);
@@ -376,7 +608,7 @@ gvm_server_open_verify (gnutls_session_t *session, const char *host, int port,
       g_warning ("Failed to get server addresses for %s: %s", host,
                  gai_strerror (errno));
       gnutls_deinit (*session);
-      gnutls_certificate_free_credentials (credentials);
+      credentials_release (credentials);
       return -1;
     }
   g_free (port_string);
@@ -396,7 +628,7 @@ gvm_server_open_verify (gnutls_session_t *session, const char *host, int port,
           g_warning ("Failed to create server socket");
           freeaddrinfo (addresses);
           gnutls_deinit (*session);
-          gnutls_certificate_free_credentials (credentials);
+          credentials_release (credentials);
           return -1;
         }
 
@@ -416,31 +648,45 @@ gvm_server_open_verify (gnutls_session_t *session, const char *host, int port,
     {
       g_warning ("Failed to connect to server");
       gnutls_deinit (*session);
-      gnutls_certificate_free_credentials (credentials);
+      credentials_release (credentials);
       return -1;
     }
 
   g_debug ("   Connected to server '%s' port %d.", host, port);
+  GVM_PROBE2 (gvm_server_open_connect, port, GVM_PROBE_USEC () - start);
 
   /* Complete setup of server session. */
+  start = GVM_PROBE_USEC ();
   ret = server_attach_internal (server_socket, session, host, port);
+  GVM_PROBE3 (gvm_server_open_handshake, port, GVM_PROBE_USEC () - start, ret);
   if (ret)
     {
       if (ret == -2)
         {
           close (server_socket);
           gnutls_deinit (*session);
-          gnutls_certificate_free_credentials (credentials);
+          credentials_release (credentials);
         }
       close (server_socket);
       return -1;
     }
   if (verify && gvm_server_verify (*session))
     {
+      session_cache_forget (*session);
       close (server_socket);
       return -1;
     }
 
+  if (gnutls_session_is_resumed (*session))
+    g_debug ("   Resumed session with server '%s' port %d.", host, port);
+  else if (gnutls_protocol_get_version (*session) != GNUTLS_TLS1_3)
+    /* Before TLS 1.3 the session can be resumed as soon as it is set up. */
+    session_cache_store (*session);
+
+  /* The session only makes a shallow copy of the credentials, but the cache
+   * keeps credentials from memory for the life of the process. */
+  credentials_release (credentials);
+
   return server_socket;
 }
 
@@ -576,77 +822,166 @@ gvm_server_attach (int socket, gnutls_session_t *session)
 }
 
 /**
- * @brief Send a string to the server.
+ * @brief Size of a full TLS record, at which corked data is flushed.
+ */
+#define SEND_RECORD_SIZE 16384
+
+/**
+ * @brief Allocation above which the send buffer of a thread is not kept.
+ */
+#define SEND_BUFFER_KEEP 1048576
+
+/**
+ * @brief Free a send buffer.
+ *
+ * @param[in]  buffer  Buffer.
+ */
+static void
+send_buffer_free (gpointer buffer)
+{
+  g_string_free ((GString *) buffer, TRUE);
+}
+
+/**
+ * @brief Buffer of the thread for formatting commands, kept between sends.
+ */
+static GPrivate send_buffer_key = G_PRIVATE_INIT (send_buffer_free);
+
+/**
+ * @brief Format a string into the send buffer of the thread.
+ *
+ * @param[in]  fmt  Format of string.
+ * @param[in]  ap   Args for fmt.
+ *
+ * @return Buffer, to pass to send_buffer_done.
+ */
+static GString *
+send_buffer_vprintf (const char *fmt, va_list ap)
+{
+  GString *buffer = g_private_get (&send_buffer_key);
+
+  if (buffer == NULL)
+    {
+      buffer = g_string_sized_new (4096);
+      g_private_set (&send_buffer_key, buffer);
+    }
+  g_string_vprintf (buffer, fmt, ap);
+  return buffer;
+}
+
+/**
+ * @brief Finish with the send buffer of the thread.
+ *
+ * Drops the buffer if a large command grew it, to not keep the memory.
+ *
+ * @param[in]  buffer  Buffer from send_buffer_vprintf.
+ */
+static void
+send_buffer_done (GString *buffer)
+{
+  if (buffer->allocated_len > SEND_BUFFER_KEEP)
+    g_private_replace (&send_buffer_key, g_string_sized_new (4096));
+  else
+    g_string_truncate (buffer, 0);
+}
+
+/**
+ * @brief Send data from several buffers to the server.
+ *
+ * Corks the session, so that the buffers go out in full records instead of
+ * one or more records each.
  *
  * @param[in]  session  Pointer to GNUTLS session.
- * @param[in]  fmt      Format of string to send.
- * @param[in]  ap       Args for fmt.
+ * @param[in]  iov      Buffers to send.
+ * @param[in]  iovcnt   Number of buffers.
  * @param[in]  quiet    Whether to log debug and info messages.  Useful for
  *                      hiding passwords.
  *
  * @return 0 on success, 1 if server closed connection, -1 on error.
  */
 static int
-gvm_server_vsendf_internal (gnutls_session_t *session, const char *fmt,
-                            va_list ap, int quiet)
+gvm_server_sendv_internal (gnutls_session_t *session, const struct iovec *iov,
+                           int iovcnt, int quiet)
 {
-  char *sref, *string;
-  int rc = 0, left;
-
-  left = vasprintf (&string, fmt, ap);
-  if (left == -1)
-    string = NULL;
+  int rc = 0, index;
+  ssize_t ret;
 
-  sref = string;
-  while (left > 0)
+  gnutls_record_cork (*session);
+  for (index = 0; index < iovcnt && rc == 0; index++)
     {
-      ssize_t count;
+      const char *string = iov[index].iov_base;
+      size_t left = iov[index].iov_len;
 
-      if (quiet == 0)
-        g_debug ("   send %d from %.*s[...]", left, left < 30 ? left : 30,
-                 string);
-      count = gnutls_record_send (*session, string, left);
-      if (count < 0)
+      while (left > 0)
         {
-          if (count == GNUTLS_E_INTERRUPTED)
-            /* Interrupted, try write again. */
-            continue;
-          if (count == GNUTLS_E_REHANDSHAKE)
+          ssize_t count;
+
+          if (quiet == 0)
+            g_debug ("   send %zu from %.*s[...]", left,
+                     left < 30 ? (int) left : 30, string);
+          /* Corked data is copied, send it a record at a time. */
+          count = gnutls_record_send (*session, string,
+                                      MIN (left, SEND_RECORD_SIZE));
+          if (count < 0)
+            {
+              if (count == GNUTLS_E_INTERRUPTED || count == GNUTLS_E_AGAIN)
+                /* Interrupted, try write again. */
+                continue;
+              if (count == GNUTLS_E_REHANDSHAKE)
+                {
+                  /* \todo Rehandshake. */
+                  if (quiet == 0)
+                    g_message ("   %s rehandshake", __func__);
+                  continue;
+                }
+              g_warning ("Failed to write to server: %s",
+                         gnutls_strerror (count));
+              rc = -1;
+              break;
+            }
+          if (count == 0)
             {
-              /* \todo Rehandshake. */
+              /* Server closed connection. */
               if (quiet == 0)
-                g_message ("   %s rehandshake", __func__);
-              continue;
+                g_debug ("=  server closed");
+              rc = 1;
+              break;
             }
-          g_warning ("Failed to write to server: %s", gnutls_strerror (count));
-          rc = -1;
-          goto out;
-        }
-      if (count == 0)
-        {
-          /* Server closed connection. */
           if (quiet == 0)
-            g_debug ("=  server closed");
-          rc = 1;
-          goto out;
+            g_debug ("=> %.*s", (int) count, string);
+          string += count;
+          left -= count;
+
+          if (gnutls_record_check_corked (*session) >= SEND_RECORD_SIZE)
+            {
+              ret = gnutls_record_uncork (*session, GNUTLS_RECORD_WAIT);
+              if (ret < 0)
+                {
+                  g_warning ("Failed to write to server: %s",
+                             gnutls_strerror (ret));
+                  rc = -1;
+                  break;
+                }
+              gnutls_record_cork (*session);
+            }
         }
-      if (quiet == 0)
-        g_debug ("=> %.*s", (int) count, string);
-      string += count;
-      left -= count;
     }
-  if (quiet == 0)
-    g_debug ("=> done");
 
-out:
-  g_free (sref);
+  ret = gnutls_record_uncork (*session, GNUTLS_RECORD_WAIT);
+  if (ret < 0 && rc == 0)
+    {
+      g_warning ("Failed to write to server: %s", gnutls_strerror (ret));
+      rc = -1;
+    }
+  if (rc == 0 && quiet == 0)
+    g_debug ("=> done");
   return rc;
 }
 
 /**
  * @brief Send a string to the server.
  *
- * @param[in]  socket   Socket.
+ * @param[in]  session  Pointer to GNUTLS session.
  * @param[in]  fmt      Format of string to send.
  * @param[in]  ap       Args for fmt.
  * @param[in]  quiet    Whether to log debug and info messages.  Useful for
@@ -655,46 +990,185 @@ out:
  * @return 0 on success, 1 if server closed connection, -1 on error.
  */
 static int
-unix_vsendf_internal (int socket, const char *fmt, va_list ap, int quiet)
+gvm_server_vsendf_internal (gnutls_session_t *session, const char *fmt,
+                            va_list ap, int quiet)
 {
-  char *string_start, *string;
-  int rc = 0, left;
+  GString *buffer;
+  struct iovec iov;
+  int rc;
 
-  left = vasprintf (&string, fmt, ap);
-  if (left == -1)
-    string = NULL;
+  buffer = send_buffer_vprintf (fmt, ap);
+  iov.iov_base = buffer->str;
+  iov.iov_len = buffer->len;
+  rc = gvm_server_sendv_internal (session, &iov, 1, quiet);
+  send_buffer_done (buffer);
+  return rc;
+}
 
-  string_start = string;
-  while (left > 0)
+/**
+ * @brief Send data from several buffers to the server.
+ *
+ * @param[in]  socket   Socket.
+ * @param[in]  iov      Buffers to send.
+ * @param[in]  iovcnt   Number of buffers.
+ * @param[in]  quiet    Whether to log debug and info messages.  Useful for
+ *                      hiding passwords.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+unix_sendv_internal (int socket, const struct iovec *iov, int iovcnt,
+                     int quiet)
+{
+  struct iovec *left;
+  int rc = 0, count_left;
+
+  /* Copy the buffers, to advance over what was written. */
+  left = g_new (struct iovec, iovcnt);
+  memcpy (left, iov, iovcnt * sizeof (*iov));
+  count_left = iovcnt;
+  while (count_left > 0)
     {
       ssize_t count;
 
+      if (left->iov_len == 0)
+        {
+          left++;
+          count_left--;
+          continue;
+        }
       if (quiet == 0)
-        g_debug ("   send %d from %.*s[...]", left, left < 30 ? left : 30,
-                 string);
-      count = write (socket, string, left);
+        g_debug ("   send %zu from %.*s[...]", left->iov_len,
+                 left->iov_len < 30 ? (int) left->iov_len : 30,
+                 (char *) left->iov_base);
+      count = writev (socket, left, MIN (count_left, IOV_MAX));
       if (count < 0)
         {
           if (errno == EINTR || errno == EAGAIN)
             continue;
           g_warning ("Failed to write to server: %s", strerror (errno));
           rc = -1;
-          goto out;
+          break;
         }
-      if (quiet == 0)
-        g_debug ("=> %.*s", (int) count, string);
+      while (count > 0)
+        {
+          size_t part = MIN ((size_t) count, left->iov_len);
 
-      string += count;
-      left -= count;
+          if (quiet == 0)
+            g_debug ("=> %.*s", (int) part, (char *) left->iov_base);
+          left->iov_base = (char *) left->iov_base + part;
+          left->iov_len -= part;
+          count -= part;
+          if (left->iov_len == 0)
+            {
+              left++;
+              count_left--;
+            }
+        }
     }
-  if (quiet == 0)
+  if (rc == 0 && quiet == 0)
     g_debug ("=> done");
 
-out:
-  g_free (string_start);
+  g_free (left - (iovcnt - count_left));
+  return rc;
+}
+
+/**
+ * @brief Send a string to the server.
+ *
+ * @param[in]  socket   Socket.
+ * @param[in]  fmt      Format of string to send.
+ * @param[in]  ap       Args for fmt.
+ * @param[in]  quiet    Whether to log debug and info messages.  Useful for
+ *                      hiding passwords.
+ *
+ * @return 0 on success, 1 if server closed connection, -1 on error.
+ */
+static int
+unix_vsendf_internal (int socket, const char *fmt, va_list ap, int quiet)
+{
+  GString *buffer;
+  struct iovec iov;
+  int rc;
+
+  buffer = send_buffer_vprintf (fmt, ap);
+  iov.iov_base = buffer->str;
+  iov.iov_len = buffer->len;
+  rc = unix_sendv_internal (socket, &iov, 1, quiet);
+  send_buffer_done (buffer);
   return rc;
 }
 
+/**
+ * @brief Send data from several buffers to the connection.
+ *
+ * @param[in]  connection  Connection.
+ * @param[in]  iov         Buffers to send.
+ * @param[in]  iovcnt      Number of buffers.
+ * @param[in]  quiet       Whether to log debug and info messages.  Useful for
+ *                         hiding passwords.
+ *
+ * @return 0 on success, 1 if server closed connection, -1 on error.
+ */
+static int
+gvm_connection_sendv_internal (gvm_connection_t *connection,
+                               const struct iovec *iov, int iovcnt, int quiet)
+{
+  if (connection->tls)
+    return gvm_server_sendv_internal (&connection->session, iov, iovcnt,
+                                      quiet);
+  return unix_sendv_internal (connection->socket, iov, iovcnt, quiet);
+}
+
+/**
+ * @brief Send data from several buffers to the server, without copying it
+ * @brief into one string first.
+ *
+ * @param[in]  session  Pointer to GNUTLS session.
+ * @param[in]  iov      Buffers to send.
+ * @param[in]  iovcnt   Number of buffers.
+ *
+ * @return 0 on success, 1 if server closed connection, -1 on error.
+ */
+int
+gvm_server_sendv (gnutls_session_t *session, const struct iovec *iov,
+                  int iovcnt)
+{
+  return gvm_server_sendv_internal (session, iov, iovcnt, 0);
+}
+
+/**
+ * @brief Send data from several buffers to the server, with one writev
+ * @brief where possible.
+ *
+ * @param[in]  socket   Socket to send through.
+ * @param[in]  iov      Buffers to send.
+ * @param[in]  iovcnt   Number of buffers.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int
+gvm_socket_sendv (int socket, const struct iovec *iov, int iovcnt)
+{
+  return unix_sendv_internal (socket, iov, iovcnt, 0);
+}
+
+/**
+ * @brief Send data from several buffers to the connection.
+ *
+ * @param[in]  connection  Connection.
+ * @param[in]  iov         Buffers to send.
+ * @param[in]  iovcnt      Number of buffers.
+ *
+ * @return 0 on success, 1 if server closed connection, -1 on error.
+ */
+int
+gvm_connection_sendv (gvm_connection_t *connection, const struct iovec *iov,
+                      int iovcnt)
+{
+  return gvm_connection_sendv_internal (connection, iov, iovcnt, 0);
+}
+
 /**
  * @brief Send a string to the connection.
  *
@@ -887,12 +1361,16 @@ int
 gvm_server_sendf_xml (gnutls_session_t *session, const char *format, ...)
 {
   va_list ap;
+  struct iovec iov;
   gchar *msg;
   int rc;
 
   va_start (ap, format);
   msg = g_markup_vprintf_escaped (format, ap);
-  rc = gvm_server_sendf (session, "%s", msg);
+  /* Send the escaped string as it is, without formatting it again. */
+  iov.iov_base = msg;
+  iov.iov_len = strlen (msg);
+  rc = gvm_server_sendv_internal (session, &iov, 1, 0);
   g_free (msg);
   va_end (ap);
   return rc;
@@ -912,12 +1390,16 @@ int
 gvm_connection_sendf_xml (gvm_connection_t *connection, const char *format, ...)
 {
   va_list ap;
+  struct iovec iov;
   gchar *msg;
   int rc;
 
   va_start (ap, format);
   msg = g_markup_vprintf_escaped (format, ap);
-  rc = gvm_connection_sendf (connection, "%s", msg);
+  /* Send the escaped string as it is, without formatting it again. */
+  iov.iov_base = msg;
+  iov.iov_len = strlen (msg);
+  rc = gvm_connection_sendv_internal (connection, &iov, 1, 0);
   g_free (msg);
   va_end (ap);
   return rc;
@@ -939,12 +1421,16 @@ int
 gvm_server_sendf_xml_quiet (gnutls_session_t *session, const char *format, ...)
 {
   va_list ap;
+  struct iovec iov;
   gchar *msg;
   int rc;
 
   va_start (ap, format);
   msg = g_markup_vprintf_escaped (format, ap);
-  rc = gvm_server_sendf_quiet (session, "%s", msg);
+  /* Send the escaped string as it is, without formatting it again. */
+  iov.iov_base = msg;
+  iov.iov_len = strlen (msg);
+  rc = gvm_server_sendv_internal (session, &iov, 1, 1);
   g_free (msg);
   va_end (ap);
   return rc;
@@ -967,26 +1453,28 @@ gvm_connection_sendf_xml_quiet (gvm_connection_t *connection,
                                 const char *format, ...)
 {
   va_list ap;
+  struct iovec iov;
   gchar *msg;
   int rc;
 
   va_start (ap, format);
   msg = g_markup_vprintf_escaped (format, ap);
-  rc = gvm_connection_sendf_quiet (connection, "%s", msg);
+  /* Send the escaped string as it is, without formatting it again. */
+  iov.iov_base = msg;
+  iov.iov_len = strlen (msg);
+  rc = gvm_connection_sendv_internal (connection, &iov, 1, 1);
   g_free (msg);
   va_end (ap);
   return rc;
 }
 
 /**
- * @brief Initialize a server session.
- *
- * @param[in]  server_credentials  Credentials to be allocated.
+ * @brief Initialize the security libraries for a session.
  *
  * @return 0 on success, -1 on error.
  */
 static int
-server_new_gnutls_init (gnutls_certificate_credentials_t *server_credentials)
+server_new_gnutls_init (void)
 {
   /* Turn off use of /dev/random, as this can block. */
   gcry_control (GCRYCTL_ENABLE_QUICK_RANDOM, 0);
@@ -997,15 +1485,317 @@ server_new_gnutls_init (gnutls_certificate_credentials_t *server_credentials)
       g_warning ("Failed to initialize GNUTLS.");
       return -1;
     }
-  /* Setup server session. */
-  if (gnutls_certificate_allocate_credentials (server_credentials))
-    {
-      g_warning ("%s: failed to allocate server credentials\n", __func__);
-      return -1;
-    }
   return 0;
 }
 
+/* Credentials cache. */
+
+/**
+ * @brief Loaded credentials, shared by all sessions using the same files or
+ * @brief certificates.
+ */
+typedef struct
+{
+  gnutls_certificate_credentials_t credentials; ///< Credentials.
+  gint64 stamps[3]; ///< Modification times of the files, 0 for memory.
+  int refs;         ///< References, one for the cache if still current.
+} credentials_entry_t;
+
+/**
+ * @brief Lock for the credentials cache.
+ */
+static GMutex credentials_mutex;
+
+/**
+ * @brief Current credentials, keyed by file names or certificate digest.
+ */
+static GHashTable *credentials_cache = NULL;
+
+/**
+ * @brief Credentials entries, keyed by their credentials.
+ */
+static GHashTable *credentials_owners = NULL;
+
+/**
+ * @brief Get the modification time of a file.
+ *
+ * @param[in]  file  File name, or NULL.
+ *
+ * @return Modification time in nanoseconds, 0 if no file, -1 on error.
+ */
+static gint64
+credentials_file_stamp (const char *file)
+{
+  struct stat st;
+
+  if (file == NULL)
+    return 0;
+  if (stat (file, &st))
+    return -1;
+  return (gint64) st.st_mtim.tv_sec * G_GINT64_CONSTANT (1000000000)
+         + st.st_mtim.tv_nsec;
+}
+
+/**
+ * @brief Drop a reference to a credentials entry.
+ *
+ * Must be called with the lock of the cache held.
+ *
+ * @param[in]  entry  Entry, freed with its credentials at the last reference.
+ */
+static void
+credentials_entry_unref (credentials_entry_t *entry)
+{
+  if (--entry->refs > 0)
+    return;
+  g_hash_table_remove (credentials_owners, entry->credentials);
+  gnutls_certificate_free_credentials (entry->credentials);
+  g_free (entry);
+}
+
+/**
+ * @brief Load credentials from files.
+ *
+ * @param[in]   ca_cert_file  Certificate authority file or NULL.
+ * @param[in]   cert_file     Certificate file or NULL.
+ * @param[in]   key_file      Key file or NULL.
+ * @param[out]  credentials   Credentials.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+credentials_load_files (const gchar *ca_cert_file, const gchar *cert_file,
+                        const gchar *key_file,
+                        gnutls_certificate_credentials_t *credentials)
+{
+  if (gnutls_certificate_allocate_credentials (credentials))
+    {
+      g_warning ("%s: failed to allocate server credentials\n", __func__);
+      return -1;
+    }
+
+  if (cert_file && key_file)
+    {
+      int ret;
+
+      ret = gnutls_certificate_set_x509_key_file (
+        *credentials, cert_file, key_file, GNUTLS_X509_FMT_PEM);
+      if (ret < 0)
+        {
+          g_warning ("%s: failed to set credentials key file: %s\n", __func__,
+                     gnutls_strerror (ret));
+          g_warning ("%s:   cert file: %s\n", __func__, cert_file);
+          g_warning ("%s:   key file : %s\n", __func__, key_file);
+          gnutls_certificate_free_credentials (*credentials);
+          return -1;
+        }
+    }
+
+  if (ca_cert_file)
+    {
+      int ret;
+
+      ret = gnutls_certificate_set_x509_trust_file (
+        *credentials, ca_cert_file, GNUTLS_X509_FMT_PEM);
+      if (ret < 0)
+        {
+          g_warning ("%s: failed to set credentials trust file: %s\n", __func__,
+                     gnutls_strerror (ret));
+          g_warning ("%s: trust file: %s\n", __func__, ca_cert_file);
+          gnutls_certificate_free_credentials (*credentials);
+          return -1;
+        }
+    }
+
+  return 0;
+}
+
+/**
+ * @brief Load credentials from certificates in memory.
+ *
+ * @param[in]   ca_cert      Certificate authority public key or NULL.
+ * @param[in]   pub_key      Public key or NULL.
+ * @param[in]   priv_key     Private key or NULL.
+ * @param[out]  credentials  Credentials.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+credentials_load_mem (const char *ca_cert, const char *pub_key,
+                      const char *priv_key,
+                      gnutls_certificate_credentials_t *credentials)
+{
+  if (gnutls_certificate_allocate_credentials (credentials))
+    {
+      g_warning ("%s: failed to allocate server credentials\n", __func__);
+      return -1;
+    }
+
+  if (pub_key && priv_key)
+    {
+      int ret;
+      gnutls_datum_t pub, priv;
+
+      pub.data = (void *) pub_key;
+      pub.size = strlen (pub_key);
+      priv.data = (void *) priv_key;
+      priv.size = strlen (priv_key);
+
+      ret = gnutls_certificate_set_x509_key_mem (*credentials, &pub, &priv,
+                                                 GNUTLS_X509_FMT_PEM);
+      if (ret < 0)
+        {
+          g_warning ("%s: %s\n", __func__, gnutls_strerror (ret));
+          gnutls_certificate_free_credentials (*credentials);
+          return -1;
+        }
+    }
+
+  if (ca_cert)
+    {
+      int ret;
+      gnutls_datum_t data;
+
+      data.data = (void *) ca_cert;
+      data.size = strlen (ca_cert);
+      ret = gnutls_certificate_set_x509_trust_mem (*credentials, &data,
+                                                   GNUTLS_X509_FMT_PEM);
+      if (ret < 0)
+        {
+          g_warning ("%s: %s\n", __func__, gnutls_strerror (ret));
+          gnutls_certificate_free_credentials (*credentials);
+          return -1;
+        }
+    }
+
+  return 0;
+}
+
+/**
+ * @brief Get shared credentials, loading them if needed.
+ *
+ * The credentials are loaded again when one of the files changed.
+ * Credentials still used by sessions stay valid until released.
+ *
+ * @param[in]   ca_cert_file  Certificate authority file or NULL.
+ * @param[in]   cert_file     Certificate file or NULL.
+ * @param[in]   key_file      Key file or NULL.
+ * @param[in]   ca_cert       Certificate authority public key or NULL.
+ * @param[in]   pub_key       Public key or NULL.
+ * @param[in]   priv_key      Private key or NULL.
+ * @param[out]  credentials   Credentials, to release with credentials_release.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+credentials_acquire (const gchar *ca_cert_file, const gchar *cert_file,
+                     const gchar *key_file, const char *ca_cert,
+                     const char *pub_key, const char *priv_key,
+                     gnutls_certificate_credentials_t *credentials)
+{
+  credentials_entry_t *entry;
+  gint64 stamps[3];
+  gchar *key;
+  gboolean files;
+
+  files = ca_cert_file || cert_file || key_file;
+  if (files)
+    {
+      stamps[0] = credentials_file_stamp (ca_cert_file);
+      stamps[1] = credentials_file_stamp (cert_file);
+      stamps[2] = credentials_file_stamp (key_file);
+      key = g_strdup_printf ("file:%s\n%s\n%s",
+                             ca_cert_file ? ca_cert_file : "",
+                             cert_file ? cert_file : "",
+                             key_file ? key_file : "");
+    }
+  else
+    {
+      GChecksum *checksum;
+
+      /* Hash the certificates, to not keep copies of the private key. */
+      checksum = g_checksum_new (G_CHECKSUM_SHA256);
+      g_checksum_update (checksum, (const guchar *) (ca_cert ? ca_cert : ""),
+                         -1);
+      g_checksum_update (checksum, (const guchar *) "\n--\n", -1);
+      g_checksum_update (checksum, (const guchar *) (pub_key ? pub_key : ""),
+                         -1);
+      g_checksum_update (checksum, (const guchar *) "\n--\n", -1);
+      g_checksum_update (checksum, (const guchar *) (priv_key ? priv_key : ""),
+                         -1);
+      key = g_strdup_printf ("mem:%s", g_checksum_get_string (checksum));
+      g_checksum_free (checksum);
+      stamps[0] = stamps[1] = stamps[2] = 0;
+    }
+
+  g_mutex_lock (&credentials_mutex);
+  if (credentials_cache == NULL)
+    {
+      credentials_cache =
+        g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+      credentials_owners = g_hash_table_new (g_direct_hash, g_direct_equal);
+    }
+
+  entry = g_hash_table_lookup (credentials_cache, key);
+  if (entry && memcmp (entry->stamps, stamps, sizeof (stamps)) == 0
+      && stamps[0] >= 0 && stamps[1] >= 0 && stamps[2] >= 0)
+    {
+      entry->refs++;
+      *credentials = entry->credentials;
+      g_mutex_unlock (&credentials_mutex);
+      g_free (key);
+      return 0;
+    }
+
+  if (entry)
+    {
+      /* Changed on disk, sessions still using the old ones keep them. */
+      g_hash_table_remove (credentials_cache, key);
+      credentials_entry_unref (entry);
+    }
+
+  if (files ? credentials_load_files (ca_cert_file, cert_file, key_file,
+                                      credentials)
+            : credentials_load_mem (ca_cert, pub_key, priv_key, credentials))
+    {
+      g_mutex_unlock (&credentials_mutex);
+      g_free (key);
+      return -1;
+    }
+
+  entry = g_malloc0 (sizeof (*entry));
+  entry->credentials = *credentials;
+  memcpy (entry->stamps, stamps, sizeof (stamps));
+  entry->refs = 2;
+  g_hash_table_insert (credentials_cache, key, entry);
+  g_hash_table_insert (credentials_owners, entry->credentials, entry);
+  g_mutex_unlock (&credentials_mutex);
+  return 0;
+}
+
+/**
+ * @brief Release credentials.
+ *
+ * Credentials that did not come from the cache are freed.
+ *
+ * @param[in]  credentials  Credentials.
+ */
+static void
+credentials_release (gnutls_certificate_credentials_t credentials)
+{
+  credentials_entry_t *entry = NULL;
+
+  g_mutex_lock (&credentials_mutex);
+  if (credentials_owners)
+    entry = g_hash_table_lookup (credentials_owners, credentials);
+  if (entry)
+    credentials_entry_unref (entry);
+  g_mutex_unlock (&credentials_mutex);
+
+  if (entry == NULL)
+    gnutls_certificate_free_credentials (credentials);
+}
+
 /**
  * @brief Set the server credencials.
  *
@@ -1056,8 +1846,15 @@ server_new_gnutls_set (unsigned int end_type, const char *priority,
     }
 
   if (end_type == GNUTLS_SERVER)
-    gnutls_certificate_server_set_request (*server_session,
-                                           GNUTLS_CERT_REQUEST);
+    {
+      gnutls_certificate_server_set_request (*server_session,
+                                             GNUTLS_CERT_REQUEST);
+      if (session_ticket_enable_server (*server_session))
+        {
+          gnutls_deinit (*server_session);
+          return -1;
+        }
+    }
   return 0;
 }
 
@@ -1081,46 +1878,17 @@ server_new_internal (unsigned int end_type, const char *priority,
                      const gchar *key_file, gnutls_session_t *server_session,
                      gnutls_certificate_credentials_t *server_credentials)
 {
-  if (server_new_gnutls_init (server_credentials))
+  if (server_new_gnutls_init ())
     return -1;
 
-  if (cert_file && key_file)
-    {
-      int ret;
-
-      ret = gnutls_certificate_set_x509_key_file (
-        *server_credentials, cert_file, key_file, GNUTLS_X509_FMT_PEM);
-      if (ret < 0)
-        {
-          g_warning ("%s: failed to set credentials key file: %s\n", __func__,
-                     gnutls_strerror (ret));
-          g_warning ("%s:   cert file: %s\n", __func__, cert_file);
-          g_warning ("%s:   key file : %s\n", __func__, key_file);
-          gnutls_certificate_free_credentials (*server_credentials);
-          return -1;
-        }
-    }
-
-  if (ca_cert_file)
-    {
-      int ret;
-
-      ret = gnutls_certificate_set_x509_trust_file (
-        *server_credentials, ca_cert_file, GNUTLS_X509_FMT_PEM);
-      if (ret < 0)
-        {
-          g_warning ("%s: failed to set credentials trust file: %s\n", __func__,
-                     gnutls_strerror (ret));
-          g_warning ("%s: trust file: %s\n", __func__, ca_cert_file);
-          gnutls_certificate_free_credentials (*server_credentials);
-          return -1;
-        }
-    }
+  if (credentials_acquire (ca_cert_file, cert_file, key_file, NULL, NULL, NULL,
+                           server_credentials))
+    return -1;
 
   if (server_new_gnutls_set (end_type, priority, server_session,
                              server_credentials))
     {
-      gnutls_certificate_free_credentials (*server_credentials);
+      credentials_release (*server_credentials);
       return -1;
     }
 
@@ -1136,7 +1904,9 @@ server_new_internal (unsigned int end_type, const char *priority,
  * @param[in]   cert_file           Certificate file.
  * @param[in]   key_file            Key file.
  * @param[out]  server_session      The session with the server.
- * @param[out]  server_credentials  Server credentials.
+ * @param[out]  server_credentials  Server credentials, shared with other
+ *                                  sessions using the same files.  Release
+ *                                  them with gvm_server_free.
  *
  * @return 0 on success, -1 on error.
  */
@@ -1158,7 +1928,9 @@ gvm_server_new (unsigned int end_type, gchar *ca_cert_file, gchar *cert_file,
  * @param[in]   pub_key     Public key.
  * @param[in]   priv_key    Private key.
  * @param[out]  session     The session with the server.
- * @param[out]  credentials Server credentials.
+ * @param[out]  credentials Server credentials, shared with other sessions
+ *                          using the same certificates.  Release them with
+ *                          gvm_server_free.
  *
  * @return 0 on success, -1 on error.
  */
@@ -1168,57 +1940,37 @@ gvm_server_new_mem (unsigned int end_type, const char *ca_cert,
                     gnutls_session_t *session,
                     gnutls_certificate_credentials_t *credentials)
 {
-  if (server_new_gnutls_init (credentials))
+  if (server_new_gnutls_init ())
     return -1;
 
-  if (pub_key && priv_key)
-    {
-      int ret;
-      gnutls_datum_t pub, priv;
-
-      pub.data = (void *) pub_key;
-      pub.size = strlen (pub_key);
-      priv.data = (void *) priv_key;
-      priv.size = strlen (priv_key);
-
-      ret = gnutls_certificate_set_x509_key_mem (*credentials, &pub, &priv,
-                                                 GNUTLS_X509_FMT_PEM);
-      if (ret < 0)
-        {
-          g_warning ("%s: %s\n", __func__, gnutls_strerror (ret));
-          return -1;
-        }
-    }
-
-  if (ca_cert)
-    {
-      int ret;
-      gnutls_datum_t data;
-
-      data.data = (void *) ca_cert;
-      data.size = strlen (ca_cert);
-      ret = gnutls_certificate_set_x509_trust_mem (*credentials, &data,
-                                                   GNUTLS_X509_FMT_PEM);
-      if (ret < 0)
-        {
-          g_warning ("%s: %s\n", __func__, gnutls_strerror (ret));
-          gnutls_certificate_free_credentials (*credentials);
-          return -1;
-        }
-    }
+  if (credentials_acquire (NULL, NULL, NULL, ca_cert, pub_key, priv_key,
+                           credentials))
+    return -1;
 
   if (server_new_gnutls_set (end_type, NULL, session, credentials))
     {
-      gnutls_certificate_free_credentials (*credentials);
+      credentials_release (*credentials);
       return -1;
     }
 
   return 0;
 }
 
+/**
+ * @brief Loaded Diffie-Hellman parameters of a file.
+ */
+typedef struct
+{
+  gnutls_dh_params_t params; ///< Parameters.
+  gint64 stamp;              ///< Modification time of the file.
+} dhparams_entry_t;
+
 /**
  * @brief Set a gnutls session's  Diffie-Hellman parameters.
  *
+ * The parameters of each file are loaded once, and again when the file
+ * changes.
+ *
  * @param[in]   creds           GnuTLS credentials.
  * @param[in]   dhparams_file   Path to PEM file containing the DH parameters.
  *
@@ -1228,31 +1980,58 @@ int
 set_gnutls_dhparams (gnutls_certificate_credentials_t creds,
                      const char *dhparams_file)
 {
-  int ret;
-  gnutls_datum_t data;
+  static GHashTable *dhparams_cache = NULL;
+  dhparams_entry_t *entry;
+  gint64 stamp;
 
   if (!creds || !dhparams_file)
     return -1;
 
-  if (load_gnutls_file (dhparams_file, &data))
-    return -1;
-
-/* Disable false positive warning about potential leak of memory */
-#ifndef __clang_analyzer__
-
-  gnutls_dh_params_t params = g_malloc0 (sizeof (gnutls_dh_params_t));
-  ret = gnutls_dh_params_import_pkcs3 (params, &data, GNUTLS_X509_FMT_PEM);
-  unload_gnutls_file (&data);
-  if (ret)
+  stamp = credentials_file_stamp (dhparams_file);
+  g_mutex_lock (&credentials_mutex);
+  if (dhparams_cache == NULL)
+    dhparams_cache =
+      g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  entry = g_hash_table_lookup (dhparams_cache, dhparams_file);
+  if (entry == NULL || entry->stamp != stamp || stamp < 0)
     {
-      g_free (params);
-      return -1;
-    }
-  else
-    gnutls_certificate_set_dh_params (creds, params);
-  return 0;
-
-#endif
+      gnutls_dh_params_t params;
+      gnutls_datum_t data;
+      int ret;
+
+      if (load_gnutls_file (dhparams_file, &data))
+        {
+          g_mutex_unlock (&credentials_mutex);
+          return -1;
+        }
+      if (gnutls_dh_params_init (&params))
+        {
+          unload_gnutls_file (&data);
+          g_mutex_unlock (&credentials_mutex);
+          return -1;
+        }
+      ret = gnutls_dh_params_import_pkcs3 (params, &data, GNUTLS_X509_FMT_PEM);
+      unload_gnutls_file (&data);
+      if (ret)
+        {
+          gnutls_dh_params_deinit (params);
+          g_mutex_unlock (&credentials_mutex);
+          return -1;
+        }
+      /* Credentials only refer to the parameters, so parameters replaced
+       * after a change of the file are kept for the ones still using them. */
+      if (entry == NULL)
+        {
+          entry = g_malloc0 (sizeof (*entry));
+          g_hash_table_insert (dhparams_cache, g_strdup (dhparams_file),
+                               entry);
+        }
+      entry->params = params;
+      entry->stamp = stamp;
+    }
+  gnutls_certificate_set_dh_params (creds, entry->params);
+  g_mutex_unlock (&credentials_mutex);
+  return 0;
 }
 
 /**
@@ -1313,7 +2092,7 @@ gvm_server_free (int server_socket, gnutls_session_t server_session,
           return -1;
         }
       gnutls_deinit (server_session);
-      gnutls_certificate_free_credentials (server_credentials);
+      credentials_release (server_credentials);
     }
   else
     {
@@ -1325,3 +2104,885 @@ gvm_server_free (int server_socket, gnutls_session_t server_session,
 
   return 0;
 }
+
+/* Non-blocking connections. */
+
+/**
+ * @brief State of a non-blocking connection.
+ */
+typedef enum
+{
+  ASYNC_CONNECTING, ///< Waiting for the socket to connect.
+  ASYNC_HANDSHAKE,  ///< Shaking hands with the server.
+  ASYNC_READY,      ///< Connected, running the queued operations.
+  ASYNC_FAILED      ///< Failed, all operations fail.
+} async_state_t;
+
+/**
+ * @brief Operation queued on a non-blocking connection.
+ */
+typedef struct
+{
+  gboolean read;                   ///< Whether a read, else a send.
+  GString *out;                    ///< Data to send.
+  gsize sent;                      ///< Bytes of out sent so far.
+  int timeout;                     ///< Timeout in seconds, 0 for none.
+  gint64 deadline;                 ///< Monotonic deadline, 0 for none.
+  gvm_async_read_func_t read_func; ///< Consumes the data read.
+  gvm_async_done_func_t done_func; ///< Function called when done.
+  gpointer data;                   ///< Data for the functions.
+} async_operation_t;
+
+/**
+ * @brief Non-blocking connection.
+ */
+struct gvm_async_connection
+{
+  async_state_t state;                          ///< State.
+  int socket;                                   ///< Socket, or -1.
+  int tls;                                      ///< Whether TLS, else UNIX.
+  gnutls_session_t session;                     ///< Session.
+  gnutls_certificate_credentials_t credentials; ///< Credentials.
+  int verify;                                   ///< Whether to verify.
+  gchar *host;                                  ///< Host, for diagnostics.
+  int port;                                     ///< Port, for diagnostics.
+  struct addrinfo *addresses;                   ///< Server addresses.
+  struct addrinfo *address;                     ///< Address connecting to.
+  gint64 deadline;                              ///< Setup deadline, or 0.
+  GQueue operations;                            ///< Operations, current first.
+  gchar *buffer;                                ///< Buffer for reading.
+};
+
+/**
+ * @brief Size of the read buffer of a non-blocking connection.
+ */
+#define ASYNC_BUFFER_SIZE 65536
+
+/**
+ * @brief Get the deadline for a timeout.
+ *
+ * @param[in]  timeout  Timeout in seconds, 0 for none.
+ *
+ * @return Monotonic deadline, 0 for none.
+ */
+static gint64
+async_deadline (int timeout)
+{
+  if (timeout <= 0)
+    return 0;
+  return g_get_monotonic_time () + (gint64) timeout * G_USEC_PER_SEC;
+}
+
+/**
+ * @brief Finish an operation, calling its function.
+ *
+ * @param[in]  connection  Connection.
+ * @param[in]  operation   Operation, removed from the queue and freed.
+ * @param[in]  status      Status for the function.
+ */
+static void
+async_operation_finish (gvm_async_connection_t *connection,
+                        async_operation_t *operation, int status)
+{
+  g_queue_remove (&connection->operations, operation);
+  if (operation->done_func)
+    operation->done_func (connection, status, operation->data);
+  if (operation->out)
+    g_string_free (operation->out, TRUE);
+  g_free (operation);
+}
+
+/**
+ * @brief Fail a connection and all its operations.
+ *
+ * @param[in]  connection  Connection.
+ * @param[in]  status      Status for the functions of the operations.
+ */
+static void
+async_fail (gvm_async_connection_t *connection, int status)
+{
+  connection->state = ASYNC_FAILED;
+  while (!g_queue_is_empty (&connection->operations))
+    async_operation_finish (connection,
+                            g_queue_peek_head (&connection->operations),
+                            status);
+}
+
+/**
+ * @brief Start connecting to the next address of the server.
+ *
+ * @param[in]  connection  Connection.
+ *
+ * @return 0 if connecting, -1 if no address is left.
+ */
+static int
+async_connect_next (gvm_async_connection_t *connection)
+{
+  if (connection->socket >= 0)
+    {
+      close (connection->socket);
+      connection->socket = -1;
+      connection->address = connection->address->ai_next;
+    }
+
+  for (; connection->address;
+       connection->address = connection->address->ai_next)
+    {
+      struct addrinfo *address = connection->address;
+
+      connection->socket =
+        socket (address->ai_family, SOCK_STREAM | SOCK_NONBLOCK, 0);
+      if (connection->socket == -1)
+        continue;
+      if (connect (connection->socket, address->ai_addr, address->ai_addrlen)
+            == 0
+          || errno == EINPROGRESS || errno == EAGAIN)
+        return 0;
+      close (connection->socket);
+      connection->socket = -1;
+    }
+  return -1;
+}
+
+/**
+ * @brief Try to finish connecting the socket.
+ *
+ * @param[in]  connection  Connection.
+ *
+ * @return 0 connected, 1 still connecting, -1 failed.
+ */
+static int
+async_connect_check (gvm_async_connection_t *connection)
+{
+  struct pollfd pfd;
+  int error;
+  socklen_t length = sizeof (error);
+
+  pfd.fd = connection->socket;
+  pfd.events = POLLOUT;
+  pfd.revents = 0;
+  if (poll (&pfd, 1, 0) == 0)
+    return 1;
+  if (getsockopt (connection->socket, SOL_SOCKET, SO_ERROR, &error, &length)
+      || error)
+    {
+      g_debug ("%s: failed to connect: %s", __func__,
+               strerror (error ? error : errno));
+      return -1;
+    }
+  return 0;
+}
+
+/**
+ * @brief Run the setup of a connection as far as possible.
+ *
+ * @param[in]  connection  Connection.
+ *
+ * @return 0 ready, 1 waiting for the socket, -1 failed, -4 timeout.
+ */
+static int
+async_setup (gvm_async_connection_t *connection)
+{
+  if (connection->deadline
+      && g_get_monotonic_time () >= connection->deadline)
+    {
+      g_warning ("%s: timeout connecting to %s", __func__, connection->host);
+      return -4;
+    }
+
+  while (connection->state == ASYNC_CONNECTING)
+    {
+      int ret;
+
+      ret = async_connect_check (connection);
+      if (ret == 1)
+        return 1;
+      if (ret == 0)
+        {
+          connection->state =
+            connection->tls ? ASYNC_HANDSHAKE : ASYNC_READY;
+          if (connection->tls)
+            gnutls_transport_set_int (connection->session,
+                                      connection->socket);
+          break;
+        }
+      if (connection->addresses == NULL || async_connect_next (connection))
+        {
+          g_warning ("%s: failed to connect to %s", __func__,
+                     connection->host);
+          return -1;
+        }
+    }
+
+  if (connection->state == ASYNC_HANDSHAKE)
+    {
+      int ret = gnutls_handshake (connection->session);
+
+      if (ret == GNUTLS_E_AGAIN || ret == GNUTLS_E_INTERRUPTED)
+        return 1;
+      if (ret < 0)
+        {
+          g_debug ("Failed to shake hands with server '%s' port %d: %s",
+                   connection->host, connection->port, gnutls_strerror (ret));
+          return -1;
+        }
+      if (connection->verify && gvm_server_verify (connection->session))
+        {
+          session_cache_forget (connection->session);
+          return -1;
+        }
+      if (!gnutls_session_is_resumed (connection->session)
+          && gnutls_protocol_get_version (connection->session)
+               != GNUTLS_TLS1_3)
+        session_cache_store (connection->session);
+      g_debug ("   Shook hands with server '%s' port %d.", connection->host,
+               connection->port);
+      connection->state = ASYNC_READY;
+    }
+  return 0;
+}
+
+/**
+ * @brief Run the current send operation as far as possible.
+ *
+ * @param[in]  connection  Connection.
+ * @param[in]  operation   Operation.
+ *
+ * @return 0 done, 1 waiting for the socket, -1 error.
+ */
+static int
+async_send (gvm_async_connection_t *connection, async_operation_t *operation)
+{
+  while (operation->sent < operation->out->len)
+    {
+      const char *data = operation->out->str + operation->sent;
+      gsize left = operation->out->len - operation->sent;
+      ssize_t count;
+
+      if (connection->tls)
+        {
+          count = gnutls_record_send (connection->session, data, left);
+          if (count == GNUTLS_E_AGAIN)
+            return 1;
+          if (count == GNUTLS_E_INTERRUPTED)
+            continue;
+          if (count < 0)
+            {
+              g_warning ("Failed to write to server: %s",
+                         gnutls_strerror (count));
+              return -1;
+            }
+        }
+      else
+        {
+          count = write (connection->socket, data, left);
+          if (count < 0)
+            {
+              if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return 1;
+              if (errno == EINTR)
+                continue;
+              g_warning ("Failed to write to server: %s", strerror (errno));
+              return -1;
+            }
+        }
+      operation->sent += count;
+    }
+  return 0;
+}
+
+/**
+ * @brief Run the current read operation as far as possible.
+ *
+ * @param[in]  connection  Connection.
+ * @param[in]  operation   Operation.
+ *
+ * @return 0 done, 1 waiting for the socket, -1 error, -3 end of file, or
+ *         the negative status of the read function.
+ */
+static int
+async_read (gvm_async_connection_t *connection, async_operation_t *operation)
+{
+  while (1)
+    {
+      ssize_t count;
+      int ret;
+
+      if (connection->tls)
+        {
+          count = gnutls_record_recv (connection->session, connection->buffer,
+                                      ASYNC_BUFFER_SIZE);
+          if (count == GNUTLS_E_AGAIN)
+            return 1;
+          if (count == GNUTLS_E_INTERRUPTED || count == GNUTLS_E_REHANDSHAKE)
+            continue;
+          if (count < 0)
+            {
+              g_debug ("%s: failed to read from server: %s", __func__,
+                       gnutls_strerror (count));
+              return -1;
+            }
+        }
+      else
+        {
+          count = read (connection->socket, connection->buffer,
+                        ASYNC_BUFFER_SIZE);
+          if (count < 0)
+            {
+              if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return 1;
+              if (errno == EINTR)
+                continue;
+              g_debug ("%s: failed to read from server: %s", __func__,
+                       strerror (errno));
+              return -1;
+            }
+        }
+      if (count == 0)
+        return -3;
+
+      ret = operation->read_func (connection, connection->buffer, count,
+                                  operation->data);
+      if (ret)
+        return ret > 0 ? 0 : ret;
+    }
+}
+
+/**
+ * @brief Queue an operation on a connection.
+ *
+ * @param[in]  connection  Connection.
+ * @param[in]  operation   Operation.
+ *
+ * @return 0 on success, -1 if the connection failed.
+ */
+static int
+async_queue (gvm_async_connection_t *connection, async_operation_t *operation)
+{
+  if (connection->state == ASYNC_FAILED)
+    {
+      if (operation->out)
+        g_string_free (operation->out, TRUE);
+      g_free (operation);
+      return -1;
+    }
+  /* Operations queued behind others start their timeout when they start. */
+  if (g_queue_is_empty (&connection->operations))
+    operation->deadline = async_deadline (operation->timeout);
+  g_queue_push_tail (&connection->operations, operation);
+  return 0;
+}
+
+/**
+ * @brief Start a non-blocking connection to a server.
+ *
+ * The name of the host is resolved before returning.  Connecting and
+ * shaking hands continue in gvm_async_connection_dispatch, so sends and
+ * reads can be queued right away.
+ *
+ * @param[in]  host      Host to connect to.
+ * @param[in]  port      Port to connect to.
+ * @param[in]  ca_mem    CA cert or NULL.
+ * @param[in]  pub_mem   Public key or NULL.
+ * @param[in]  priv_mem  Private key or NULL.
+ * @param[in]  timeout   Timeout to connect and shake hands in seconds, 0 for
+ *                       none.
+ *
+ * @return Connection, NULL on error.
+ */
+gvm_async_connection_t *
+gvm_async_connection_new (const char *host, int port, const char *ca_mem,
+                          const char *pub_mem, const char *priv_mem,
+                          int timeout)
+{
+  gvm_async_connection_t *connection;
+  struct addrinfo address_hints;
+  gchar *port_string;
+  int host_type, ret;
+
+  if (port < 1 || port > 65535)
+    {
+      g_warning ("Failed to create client TLS session. "
+                 "Invalid port %d",
+                 port);
+      return NULL;
+    }
+  host_type = gvm_get_host_type (host);
+  if (!(host_type == HOST_TYPE_NAME || host_type == HOST_TYPE_IPV4
+        || host_type == HOST_TYPE_IPV6))
+    {
+      g_warning ("Failed to create client TLS session. Invalid host %s", host);
+      return NULL;
+    }
+
+  connection = g_malloc0 (sizeof (*connection));
+  connection->socket = -1;
+  connection->tls = 1;
+  connection->host = g_strdup (host);
+  connection->port = port;
+  connection->verify = ca_mem && pub_mem && priv_mem;
+  connection->deadline = async_deadline (timeout);
+  g_queue_init (&connection->operations);
+
+  if (gvm_server_new_mem (GNUTLS_CLIENT, ca_mem, pub_mem, priv_mem,
+                          &connection->session, &connection->credentials))
+    {
+      g_warning ("Failed to create client TLS session.");
+      g_free (connection->host);
+      g_free (connection);
+      return NULL;
+    }
+  if (ca_mem && pub_mem && priv_mem)
+    {
+      set_cert_pub_mem (pub_mem);
+      set_cert_priv_mem (priv_mem);
+      gnutls_certificate_set_retrieve_function (connection->credentials,
+                                                client_cert_callback);
+    }
+  session_cache_attach (connection->session,
+                        session_cache_entry (host, port, ca_mem, pub_mem,
+                                             priv_mem));
+
+  port_string = g_strdup_printf ("%i", port);
+  memset (&address_hints, 0, sizeof (address_hints));
+  address_hints.ai_family = AF_UNSPEC;
+  address_hints.ai_socktype = SOCK_STREAM;
+  ret = getaddrinfo (host, port_string, &address_hints,
+                     &connection->addresses);
+  g_free (port_string);
+  if (ret)
+    {
+      g_warning ("Failed to get server addresses for %s: %s", host,
+                 gai_strerror (ret));
+      connection->addresses = NULL;
+      gvm_async_connection_free (connection);
+      return NULL;
+    }
+  connection->address = connection->addresses;
+  if (async_connect_next (connection))
+    {
+      g_warning ("Failed to connect to server");
+      gvm_async_connection_free (connection);
+      return NULL;
+    }
+  connection->buffer = g_malloc (ASYNC_BUFFER_SIZE);
+  return connection;
+}
+
+/**
+ * @brief Start a non-blocking connection to a UNIX socket.
+ *
+ * @param[in]  path     Path of the socket.
+ * @param[in]  timeout  Timeout to connect in seconds, 0 for none.
+ *
+ * @return Connection, NULL on error.
+ */
+gvm_async_connection_t *
+gvm_async_connection_new_unix (const char *path, int timeout)
+{
+  gvm_async_connection_t *connection;
+  struct sockaddr_un addr;
+
+  if (path == NULL || strlen (path) >= sizeof (addr.sun_path))
+    return NULL;
+
+  memset (&addr, 0, sizeof (addr));
+  addr.sun_family = AF_UNIX;
+  g_strlcpy (addr.sun_path, path, sizeof (addr.sun_path));
+
+  connection = g_malloc0 (sizeof (*connection));
+  connection->host = g_strdup (path);
+  connection->deadline = async_deadline (timeout);
+  g_queue_init (&connection->operations);
+  connection->socket = socket (AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  if (connection->socket == -1
+      || (connect (connection->socket, (struct sockaddr *) &addr,
+                   sizeof (addr))
+            && errno != EINPROGRESS && errno != EAGAIN))
+    {
+      g_warning ("Failed to connect to %s: %s", path, strerror (errno));
+      gvm_async_connection_free (connection);
+      return NULL;
+    }
+  connection->buffer = g_malloc (ASYNC_BUFFER_SIZE);
+  return connection;
+}
+
+/**
+ * @brief Free a non-blocking connection, closing its socket.
+ *
+ * Operations still queued are finished with status -5.  Must not be called
+ * from the function of an operation of the connection.
+ *
+ * @param[in]  connection  Connection.
+ */
+void
+gvm_async_connection_free (gvm_async_connection_t *connection)
+{
+  if (connection == NULL)
+    return;
+
+  async_fail (connection, -5);
+  if (connection->tls)
+    {
+      if (connection->socket >= 0)
+        gvm_server_free (connection->socket, connection->session,
+                         connection->credentials);
+      else
+        {
+          gnutls_deinit (connection->session);
+          credentials_release (connection->credentials);
+          gnutls_global_deinit ();
+        }
+    }
+  else if (connection->socket >= 0)
+    close (connection->socket);
+  if (connection->addresses)
+    freeaddrinfo (connection->addresses);
+  g_free (connection->buffer);
+  g_free (connection->host);
+  g_free (connection);
+}
+
+/**
+ * @brief Queue sending data on a non-blocking connection.
+ *
+ * @param[in]  connection  Connection.
+ * @param[in]  data        Data to send, copied.
+ * @param[in]  length      Length of data, -1 if NULL terminated.
+ * @param[in]  timeout     Timeout in seconds from the start of the send, 0
+ *                         for none.
+ * @param[in]  done_func   Function called when sent or failed, or NULL.
+ * @param[in]  func_data   Data for done_func.
+ *
+ * @return 0 on success, -1 if the connection failed.
+ */
+int
+gvm_async_connection_send (gvm_async_connection_t *connection,
+                           const char *data, gssize length, int timeout,
+                           gvm_async_done_func_t done_func, gpointer func_data)
+{
+  async_operation_t *operation;
+
+  operation = g_malloc0 (sizeof (*operation));
+  operation->out = g_string_new_len (data, length < 0 ? (gssize) strlen (data)
+                                                      : length);
+  operation->timeout = timeout;
+  operation->done_func = done_func;
+  operation->data = func_data;
+  return async_queue (connection, operation);
+}
+
+/**
+ * @brief Queue sending a formatted string on a non-blocking connection.
+ *
+ * @param[in]  connection  Connection.
+ * @param[in]  timeout     Timeout in seconds from the start of the send, 0
+ *                         for none.
+ * @param[in]  done_func   Function called when sent or failed, or NULL.
+ * @param[in]  func_data   Data for done_func.
+ * @param[in]  format      printf-style format string for message.
+ *
+ * @return 0 on success, -1 if the connection failed.
+ */
+int
+gvm_async_connection_sendf (gvm_async_connection_t *connection, int timeout,
+                            gvm_async_done_func_t done_func,
+                            gpointer func_data, const char *format, ...)
+{
+  async_operation_t *operation;
+  va_list ap;
+
+  operation = g_malloc0 (sizeof (*operation));
+  operation->out = g_string_new ("");
+  va_start (ap, format);
+  g_string_vprintf (operation->out, format, ap);
+  va_end (ap);
+  operation->timeout = timeout;
+  operation->done_func = done_func;
+  operation->data = func_data;
+  return async_queue (connection, operation);
+}
+
+/**
+ * @brief Queue reading from a non-blocking connection.
+ *
+ * The read is done when read_func returns 1.  Data read after that in the
+ * same chunk is dropped, as in the blocking readers.
+ *
+ * @param[in]  connection  Connection.
+ * @param[in]  timeout     Timeout in seconds from the start of the read, 0
+ *                         for none.
+ * @param[in]  read_func   Function consuming each chunk read.
+ * @param[in]  done_func   Function called when done or failed, or NULL.
+ * @param[in]  func_data   Data for read_func and done_func.
+ *
+ * @return 0 on success, -1 if the connection failed.
+ */
+int
+gvm_async_connection_read (gvm_async_connection_t *connection, int timeout,
+                           gvm_async_read_func_t read_func,
+                           gvm_async_done_func_t done_func, gpointer func_data)
+{
+  async_operation_t *operation;
+
+  if (read_func == NULL)
+    return -1;
+  operation = g_malloc0 (sizeof (*operation));
+  operation->read = TRUE;
+  operation->timeout = timeout;
+  operation->read_func = read_func;
+  operation->done_func = done_func;
+  operation->data = func_data;
+  return async_queue (connection, operation);
+}
+
+/**
+ * @brief Get the socket of a non-blocking connection, for polling.
+ *
+ * The socket can change while connecting, when an address of the server
+ * fails and the next one is tried.
+ *
+ * @param[in]  connection  Connection.
+ *
+ * @return Socket, -1 if none.
+ */
+int
+gvm_async_connection_fd (gvm_async_connection_t *connection)
+{
+  return connection->state == ASYNC_FAILED ? -1 : connection->socket;
+}
+
+/**
+ * @brief Get the events a non-blocking connection waits for.
+ *
+ * @param[in]  connection  Connection.
+ *
+ * @return G_IO_IN and/or G_IO_OUT, which match POLLIN and POLLOUT, or 0 if
+ *         the connection has nothing to do.
+ */
+GIOCondition
+gvm_async_connection_condition (gvm_async_connection_t *connection)
+{
+  async_operation_t *operation;
+
+  switch (connection->state)
+    {
+    case ASYNC_CONNECTING:
+      return G_IO_OUT;
+    case ASYNC_HANDSHAKE:
+      return gnutls_record_get_direction (connection->session) ? G_IO_OUT
+                                                               : G_IO_IN;
+    case ASYNC_READY:
+      operation = g_queue_peek_head (&connection->operations);
+      if (operation == NULL)
+        return 0;
+      if (connection->tls && operation->sent
+          && gnutls_record_get_direction (connection->session))
+        return G_IO_OUT;
+      return operation->read ? G_IO_IN : G_IO_OUT;
+    default:
+      return 0;
+    }
+}
+
+/**
+ * @brief Check whether TLS has data for the current read, that polling the
+ * @brief socket would miss.
+ *
+ * @param[in]  connection  Connection.
+ *
+ * @return TRUE if pending data, else FALSE.
+ */
+static gboolean
+async_pending (gvm_async_connection_t *connection)
+{
+  async_operation_t *operation;
+
+  if (connection->state != ASYNC_READY || connection->tls == 0)
+    return FALSE;
+  operation = g_queue_peek_head (&connection->operations);
+  return operation && operation->read
+         && gnutls_record_check_pending (connection->session) > 0;
+}
+
+/**
+ * @brief Get the next deadline of a non-blocking connection.
+ *
+ * The deadline is now if the connection can run without waiting for the
+ * socket.
+ *
+ * @param[in]  connection  Connection.
+ *
+ * @return Deadline in g_get_monotonic_time time, 0 for none.
+ */
+gint64
+gvm_async_connection_deadline (gvm_async_connection_t *connection)
+{
+  async_operation_t *operation;
+
+  if (connection->state == ASYNC_FAILED)
+    return 0;
+  if (async_pending (connection))
+    return g_get_monotonic_time ();
+  if (connection->state != ASYNC_READY)
+    return connection->deadline;
+  operation = g_queue_peek_head (&connection->operations);
+  return operation ? operation->deadline : 0;
+}
+
+/**
+ * @brief Run a non-blocking connection as far as possible without blocking.
+ *
+ * To be called when the socket is ready for the condition of the
+ * connection, or when the deadline of the connection passed.  Calls the
+ * functions of the operations that finish.
+ *
+ * On an error or timeout the connection fails, with all its operations.
+ *
+ * @param[in]  connection  Connection.
+ *
+ * @return 0 if the connection is fine, -1 if it failed.
+ */
+int
+gvm_async_connection_dispatch (gvm_async_connection_t *connection)
+{
+  async_operation_t *operation;
+  int ret;
+
+  if (connection->state == ASYNC_FAILED)
+    return -1;
+
+  if (connection->state != ASYNC_READY)
+    {
+      ret = async_setup (connection);
+      if (ret == 1)
+        return 0;
+      if (ret)
+        {
+          async_fail (connection, ret);
+          return -1;
+        }
+    }
+
+  while ((operation = g_queue_peek_head (&connection->operations)))
+    {
+      if (operation->deadline && g_get_monotonic_time () >= operation->deadline)
+        {
+          g_warning ("%s: timeout on connection to %s", __func__,
+                     connection->host);
+          async_fail (connection, -4);
+          return -1;
+        }
+      ret = operation->read ? async_read (connection, operation)
+                            : async_send (connection, operation);
+      if (ret == 1)
+        return 0;
+      if (ret)
+        {
+          async_fail (connection, ret);
+          return -1;
+        }
+      async_operation_finish (connection, operation, 0);
+      operation = g_queue_peek_head (&connection->operations);
+      if (operation)
+        operation->deadline = async_deadline (operation->timeout);
+    }
+  return 0;
+}
+
+/**
+ * @brief GSource running a non-blocking connection.
+ */
+typedef struct
+{
+  GSource source;                     ///< Source.
+  gvm_async_connection_t *connection; ///< Connection.
+  gpointer tag;                       ///< Tag of the polled socket.
+  int socket;                         ///< Polled socket.
+} async_source_t;
+
+/**
+ * @brief Prepare a connection source for polling.
+ *
+ * @param[in]   source   Source.
+ * @param[out]  timeout  Timeout for polling.
+ *
+ * @return TRUE if TLS has data pending, else FALSE to poll the socket.
+ */
+static gboolean
+async_source_prepare (GSource *source, gint *timeout)
+{
+  async_source_t *async_source = (async_source_t *) source;
+  gvm_async_connection_t *connection = async_source->connection;
+  int socket = gvm_async_connection_fd (connection);
+  gint64 deadline;
+
+  if (socket != async_source->socket)
+    {
+      if (async_source->tag)
+        g_source_remove_unix_fd (source, async_source->tag);
+      async_source->tag = NULL;
+      async_source->socket = socket;
+      if (socket >= 0)
+        async_source->tag = g_source_add_unix_fd (source, socket, 0);
+    }
+  if (async_source->tag)
+    g_source_modify_unix_fd (source, async_source->tag,
+                             gvm_async_connection_condition (connection));
+
+  deadline = gvm_async_connection_deadline (connection);
+  g_source_set_ready_time (source, deadline ? deadline : -1);
+  *timeout = -1;
+  return async_pending (connection);
+}
+
+/**
+ * @brief Dispatch a connection source.
+ *
+ * @param[in]  source     Source.
+ * @param[in]  callback   Function called after each dispatch, or NULL.
+ * @param[in]  user_data  Data for callback.
+ *
+ * @return Result of callback, G_SOURCE_CONTINUE if none.
+ */
+static gboolean
+async_source_dispatch (GSource *source, GSourceFunc callback,
+                       gpointer user_data)
+{
+  async_source_t *async_source = (async_source_t *) source;
+
+  gvm_async_connection_dispatch (async_source->connection);
+  if (callback)
+    return callback (user_data);
+  return G_SOURCE_CONTINUE;
+}
+
+/**
+ * @brief Functions of a connection source.
+ */
+static GSourceFuncs async_source_funcs = {
+  async_source_prepare, NULL, async_source_dispatch, NULL, NULL, NULL};
+
+/**
+ * @brief Make a GSource that runs a non-blocking connection.
+ *
+ * Attach it to a GMainContext to run the connection there.  The source must
+ * be destroyed before the connection is freed.
+ *
+ * @param[in]  connection  Connection.
+ *
+ * @return Source.
+ */
+GSource *
+gvm_async_connection_source_new (gvm_async_connection_t *connection)
+{
+  async_source_t *async_source;
+
+  async_source = (async_source_t *) g_source_new (&async_source_funcs,
+                                                  sizeof (async_source_t));
+  async_source->connection = connection;
+  async_source->socket = -1;
+  async_source->tag = NULL;
+  return (GSource *) async_source;
+}
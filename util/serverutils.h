@@ -18,6 +18,7 @@
 #include <gnutls/gnutls.h> /* for gnutls_session_t, gnutls_certificate_cred... */
 #include <stdarg.h>        /* for va_list */
 #include <sys/param.h>
+#include <sys/uio.h> /* for iovec */
 #ifdef __FreeBSD__
 #include <netinet/in.h>
 #endif
@@ -65,6 +66,9 @@ gvm_server_open_with_cert (gnutls_session_t *, const char *, int, const char *,
 int
 gvm_server_close (int, gnutls_session_t);
 
+void
+gvm_server_session_cache_clear (void);
+
 int
 gvm_server_attach (int, gnutls_session_t *);
 
@@ -77,6 +81,13 @@ gvm_server_vsendf (gnutls_session_t *, const char *, va_list);
 int
 gvm_socket_vsendf (int, const char *, va_list);
 
+int
+gvm_server_sendv (gnutls_session_t *, const struct iovec *, int);
+int
+gvm_socket_sendv (int, const struct iovec *, int);
+int
+gvm_connection_sendv (gvm_connection_t *, const struct iovec *, int);
+
 int
 gvm_server_sendf_xml (gnutls_session_t *, const char *, ...);
 int
@@ -113,4 +124,66 @@ unload_gnutls_file (gnutls_datum_t *);
 int
 set_gnutls_dhparams (gnutls_certificate_credentials_t, const char *);
 
+/**
+ * @brief Non-blocking connection.
+ */
+typedef struct gvm_async_connection gvm_async_connection_t;
+
+/**
+ * @brief Function called when an operation of a non-blocking connection is
+ * @brief done.
+ *
+ * The status is 0 on success, -1 on error, -3 on end of file, -4 on timeout,
+ * -5 if the connection was freed, or the status of the read function.
+ */
+typedef void (*gvm_async_done_func_t) (gvm_async_connection_t *, int,
+                                       gpointer);
+
+/**
+ * @brief Function consuming data read by a non-blocking connection.
+ *
+ * Returns 1 when the read is done, 0 for more data, or a negative status.
+ */
+typedef int (*gvm_async_read_func_t) (gvm_async_connection_t *, const char *,
+                                      gsize, gpointer);
+
+gvm_async_connection_t *
+gvm_async_connection_new (const char *, int, const char *, const char *,
+                          const char *, int);
+
+gvm_async_connection_t *
+gvm_async_connection_new_unix (const char *, int);
+
+void
+gvm_async_connection_free (gvm_async_connection_t *);
+
+int
+gvm_async_connection_send (gvm_async_connection_t *, const char *, gssize, int,
+                           gvm_async_done_func_t, gpointer);
+
+int
+gvm_async_connection_sendf (gvm_async_connection_t *, int,
+                            gvm_async_done_func_t, gpointer, const char *, ...)
+  __attribute__ ((format (printf, 5, 6)));
+
+int
+gvm_async_connection_read (gvm_async_connection_t *, int,
+                           gvm_async_read_func_t, gvm_async_done_func_t,
+                           gpointer);
+
+int
+gvm_async_connection_fd (gvm_async_connection_t *);
+
+GIOCondition
+gvm_async_connection_condition (gvm_async_connection_t *);
+
+gint64
+gvm_async_connection_deadline (gvm_async_connection_t *);
+
+int
+gvm_async_connection_dispatch (gvm_async_connection_t *);
+
+GSource *
+gvm_async_connection_source_new (gvm_async_connection_t *);
+
 #endif /* not _GVM_SERVERUTILS_H */
@@ -10,10 +10,17 @@
 
 #include "uuidutils.h"
 
+#include <errno.h>
 #include <glib.h>
 #include <stdlib.h>
+#include <string.h>
 #include <uuid/uuid.h>
 
+#if defined(__linux__) && defined(__GLIBC__) && __GLIBC_PREREQ(2, 25)
+#include <sys/random.h> /* for getrandom */
+#define HAVE_GETRANDOM 1
+#endif
+
 #undef G_LOG_DOMAIN
 /**
  * @brief GLib logging domain.
@@ -53,3 +60,171 @@ gvm_uuid_make (void)
 
   return id;
 }
+
+/**
+ * @brief Number of UUIDs whose random bytes are fetched at once.
+ */
+#define UUID_BATCH_CHUNK 256
+
+/**
+ * @brief Fill memory with random bytes from the kernel CSPRNG.
+ *
+ * @param[out]  buf  The memory.
+ * @param[in]   len  Length of the memory, a multiple of 16.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+uuid_random_bytes (unsigned char *buf, size_t len)
+{
+#ifdef HAVE_GETRANDOM
+  while (len)
+    {
+      ssize_t ret = getrandom (buf, len, 0);
+
+      if (ret < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          g_warning ("%s: getrandom failed: %s", __func__, strerror (errno));
+          return -1;
+        }
+      buf += ret;
+      len -= ret;
+    }
+#else
+  for (; len >= sizeof (uuid_t); buf += sizeof (uuid_t), len -= sizeof (uuid_t))
+    uuid_generate_random (buf);
+#endif
+  return 0;
+}
+
+/**
+ * @brief Write a UUID as text, like uuid_unparse does.
+ *
+ * @param[in]   uuid  The UUID.
+ * @param[out]  out   Buffer of GVM_UUID_SIZE bytes for the text.
+ */
+static void
+uuid_encode (const unsigned char *uuid, char *out)
+{
+  static const char hex[] = "0123456789abcdef";
+  int i;
+
+  for (i = 0; i < 16; i++)
+    {
+      if (i == 4 || i == 6 || i == 8 || i == 10)
+        *out++ = '-';
+      *out++ = hex[uuid[i] >> 4];
+      *out++ = hex[uuid[i] & 0x0f];
+    }
+  *out = '\0';
+}
+
+/**
+ * @brief Get the timestamp and sequence number of the next version 7 UUIDs.
+ *
+ * The sequence number takes the place of the random bits after the
+ * timestamp, so that UUIDs made in the same millisecond by this process
+ * stay ordered.  When it runs out the timestamp is moved forward.
+ *
+ * @param[in]   count      Number of UUIDs to reserve.
+ * @param[out]  first_ms   Timestamp of the first UUID, in milliseconds.
+ * @param[out]  first_seq  Sequence number of the first UUID.
+ */
+static void
+uuid_v7_reserve (size_t count, guint64 *first_ms, guint *first_seq)
+{
+  static GMutex mutex;
+  static guint64 last_ms = 0;
+  static guint seq = 0;
+  guint64 now_ms = g_get_real_time () / 1000;
+
+  g_mutex_lock (&mutex);
+  if (now_ms > last_ms)
+    {
+      last_ms = now_ms;
+      seq = 0;
+    }
+  else if (++seq > 0xfff)
+    {
+      last_ms++;
+      seq = 0;
+    }
+  *first_ms = last_ms;
+  *first_seq = seq;
+
+  /* Reserve the rest of the batch. */
+  seq += count - 1;
+  last_ms += seq >> 12;
+  seq &= 0xfff;
+  g_mutex_unlock (&mutex);
+}
+
+/**
+ * @brief Make many universal identifiers at once.
+ *
+ * The random bits come from the kernel CSPRNG, fetched for many UUIDs at a
+ * time.  None are kept between calls, so a forked process will not repeat
+ * the UUIDs of its parent.
+ *
+ * Time ordered UUIDs made by one process sort in the order they were made,
+ * which keeps inserts into database indexes local.
+ *
+ * @param[in]   kind   Kind of the UUIDs.
+ * @param[out]  buf    Buffer for count strings of GVM_UUID_SIZE bytes each,
+ *                     one after the other.
+ * @param[in]   count  Number of UUIDs to make.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int
+gvm_uuid_make_batch (gvm_uuid_kind_t kind, char *buf, size_t count)
+{
+  unsigned char bytes[UUID_BATCH_CHUNK * 16];
+  guint64 ms = 0;
+  guint seq = 0;
+
+  if (buf == NULL && count)
+    return -1;
+
+  if (kind == GVM_UUID_TIME_ORDERED && count)
+    uuid_v7_reserve (count, &ms, &seq);
+
+  while (count)
+    {
+      size_t chunk = MIN (count, UUID_BATCH_CHUNK), i;
+
+      if (uuid_random_bytes (bytes, chunk * 16))
+        return -1;
+
+      for (i = 0; i < chunk; i++)
+        {
+          unsigned char *uuid = bytes + i * 16;
+
+          if (kind == GVM_UUID_TIME_ORDERED)
+            {
+              int byte;
+
+              for (byte = 0; byte < 6; byte++)
+                uuid[byte] = ms >> (40 - 8 * byte);
+              uuid[6] = 0x70 | (seq >> 8);
+              uuid[7] = seq & 0xff;
+              if (++seq > 0xfff)
+                {
+                  ms++;
+                  seq = 0;
+                }
+            }
+          else
+            uuid[6] = 0x40 | (uuid[6] & 0x0f);
+          uuid[8] = 0x80 | (uuid[8] & 0x3f);
+
+          uuid_encode (uuid, buf);
+          buf += GVM_UUID_SIZE;
+        }
+      count -= chunk;
+    }
+
+  return 0;
+}
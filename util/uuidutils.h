@@ -11,7 +11,26 @@
 #ifndef _GVM_UUIDUTILS_H
 #define _GVM_UUIDUTILS_H
 
+#include <stddef.h> /* for size_t */
+
+/**
+ * @brief Size of a UUID string, including the terminating NULL.
+ */
+#define GVM_UUID_SIZE 37
+
+/**
+ * @brief Kinds of UUIDs to make in a batch.
+ */
+typedef enum
+{
+  GVM_UUID_RANDOM,       ///< Random UUIDs, version 4.
+  GVM_UUID_TIME_ORDERED, ///< UUIDs ordered by creation time, version 7.
+} gvm_uuid_kind_t;
+
 char *
 gvm_uuid_make (void);
 
+int
+gvm_uuid_make_batch (gvm_uuid_kind_t, char *, size_t);
+
 #endif /* not _GVM_UUIDUTILS_H */
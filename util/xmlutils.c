@@ -14,16 +14,28 @@
 
 #include "xmlutils.h"
 
+#include "../base/memstats.h" /* for gvm_memstats_alloc, gvm_memstats_free */
+#include "../base/probes.h"   /* for GVM_PROBE1, GVM_PROBE2 */
+
 #include <assert.h>      /* for assert */
 #include <errno.h>       /* for errno, EAGAIN, EINTR */
-#include <fcntl.h>       /* for fcntl, F_SETFL, O_NONBLOCK */
+#include <fcntl.h>       /* for fcntl, open, F_SETFL, O_NONBLOCK */
 #include <glib.h>        /* for g_free, GSList, g_markup_parse_context_free */
 #include <glib/gtypes.h> /* for GPOINTER_TO_INT, GINT_TO_POINTER, gsize */
 #include <libxml/parser.h>
 #include <libxml/tree.h>
-#include <string.h> /* for strcmp, strerror, strlen */
-#include <time.h>   /* for time, time_t */
-#include <unistd.h> /* for ssize_t */
+#include <poll.h>     /* for poll */
+#include <string.h>   /* for memchr, strcmp, strerror, strlen */
+#include <sys/mman.h> /* for mmap, munmap */
+#include <sys/stat.h> /* for fstat */
+#include <time.h>     /* for time, time_t */
+#include <unistd.h>   /* for close, read, ssize_t */
+
+#if defined(__SSE2__)
+#include <emmintrin.h> /* for _mm_cmpeq_epi8, _mm_movemask_epi8 */
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h> /* for vceqq_u8, vmaxvq_u8 */
+#endif
 
 #undef G_LOG_DOMAIN
 /**
@@ -32,10 +44,153 @@
 #define G_LOG_DOMAIN "libgvm util"
 
 /**
- * @brief Size of the buffer for reading from the manager.
+ * @brief Maximum size of the buffer for reading from the manager.
  */
 #define BUFFER_SIZE 1048576
 
+/**
+ * @brief Initial size of the buffer for reading from the manager.
+ */
+#define BUFFER_SIZE_MIN 65536
+
+/**
+ * @brief Whether to trace the reads from the manager, at debug level.
+ *
+ * Off by default, because formatting every chunk read costs as much as
+ * parsing it.
+ */
+#ifndef XML_READ_TRACE
+#define XML_READ_TRACE 0
+#endif
+
+/**
+ * @brief Log a read from the manager, if tracing is on.
+ */
+#define READ_TRACE(...)        \
+  do                           \
+    {                          \
+      if (XML_READ_TRACE)      \
+        g_debug (__VA_ARGS__); \
+    }                          \
+  while (0)
+
+/**
+ * @brief Buffer for reading from the manager.
+ */
+typedef struct
+{
+  char *data;      ///< Data.
+  gsize size;      ///< Size of the data.
+  gboolean in_use; ///< Whether a read is using the buffer.
+} read_buffer_t;
+
+/**
+ * @brief Free a read buffer.
+ *
+ * @param[in]  buffer  Buffer.
+ */
+static void
+read_buffer_free (gpointer buffer)
+{
+  g_free (((read_buffer_t *) buffer)->data);
+  g_free (buffer);
+}
+
+/**
+ * @brief Read buffer of the thread, kept between reads.
+ */
+static GPrivate read_buffer_key = G_PRIVATE_INIT (read_buffer_free);
+
+/**
+ * @brief Get a buffer for reading from the manager.
+ *
+ * Returns the buffer of the thread, or a new one if a read is already
+ * using it, like a read from a streaming callback.
+ *
+ * @return Buffer, to release with read_buffer_release.
+ */
+static read_buffer_t *
+read_buffer_get (void)
+{
+  read_buffer_t *buffer = g_private_get (&read_buffer_key);
+
+  if (buffer && buffer->in_use)
+    {
+      buffer = g_malloc (sizeof (*buffer));
+      buffer->size = BUFFER_SIZE_MIN;
+      buffer->data = g_malloc (buffer->size);
+      buffer->in_use = FALSE;
+      return buffer;
+    }
+  if (buffer == NULL)
+    {
+      buffer = g_malloc (sizeof (*buffer));
+      buffer->size = BUFFER_SIZE_MIN;
+      buffer->data = g_malloc (buffer->size);
+      g_private_set (&read_buffer_key, buffer);
+    }
+  buffer->in_use = TRUE;
+  return buffer;
+}
+
+/**
+ * @brief Release a buffer from read_buffer_get.
+ *
+ * @param[in]  buffer  Buffer.
+ */
+static void
+read_buffer_release (read_buffer_t *buffer)
+{
+  if (buffer->in_use)
+    buffer->in_use = FALSE;
+  else
+    read_buffer_free (buffer);
+}
+
+/**
+ * @brief Grow a read buffer if a read filled it, up to BUFFER_SIZE.
+ *
+ * @param[in]  buffer  Buffer.
+ * @param[in]  count   Number of bytes read into the buffer.
+ */
+static void
+read_buffer_adapt (read_buffer_t *buffer, gsize count)
+{
+  if (count < buffer->size || buffer->size >= BUFFER_SIZE)
+    return;
+  g_free (buffer->data);
+  buffer->size = MIN (buffer->size * 2, BUFFER_SIZE);
+  buffer->data = g_malloc (buffer->size);
+}
+
+/**
+ * @brief Wait for a socket to become readable.
+ *
+ * @param[in]  socket     Socket.
+ * @param[in]  last_time  Time of the last read.
+ * @param[in]  timeout    Idle time before giving up, in seconds.
+ *
+ * @return FALSE if the idle time ran out, else TRUE.
+ */
+static gboolean
+wait_readable (int socket, time_t last_time, int timeout)
+{
+  struct pollfd pfd;
+  time_t left;
+
+  pfd.fd = socket;
+  pfd.events = POLLIN;
+  while ((left = timeout - (time (NULL) - last_time)) > 0)
+    {
+      int ret = poll (&pfd, 1, left * 1000);
+
+      if (ret > 0 || (ret == -1 && errno != EINTR))
+        /* Readable, or an error for the read to report. */
+        return TRUE;
+    }
+  return FALSE;
+}
+
 /**
  * @brief Create an entity.
  *
@@ -49,13 +204,94 @@ make_entity (const char *name, const char *text)
 {
   entity_t entity;
   entity = g_malloc (sizeof (*entity));
+  gvm_memstats_alloc (GVM_MEM_ENTITIES, sizeof (*entity));
   entity->name = g_strdup (name ? name : "");
   entity->text = g_strdup (text ? text : "");
   entity->entities = NULL;
   entity->attributes = NULL;
+  entity->attribute_array = NULL;
+  entity->arena = NULL;
+  entity->child_index = NULL;
+  entity->child_index_tail = NULL;
   return entity;
 }
 
+/**
+ * @brief Size of the blocks of an entity arena.
+ */
+#define ARENA_BLOCK_SIZE 16384
+
+/**
+ * @brief Memory of an entity tree parsed by parse_entity_arena.
+ *
+ * Entities, their attribute arrays and the list nodes of their children are
+ * bump allocated from blocks, the strings are in a string chunk with the
+ * element and attribute names interned.  The whole tree is freed at once.
+ */
+struct entity_arena
+{
+  GStringChunk *strings; ///< Names and texts.
+  gpointer *blocks;      ///< Last block, starting with a link to the previous.
+  gchar *next;           ///< Free space in the last block.
+  gsize left;            ///< Size of the free space in the last block.
+  entity_t root;         ///< Root entity of the tree.
+  GSList *indexes;       ///< Child indexes of the entities.
+  gsize size;            ///< Size of the blocks, for the memory accounting.
+};
+
+/**
+ * @brief Allocate memory from an entity arena.
+ *
+ * @param[in]  arena  Arena.
+ * @param[in]  size   Size of the memory.
+ *
+ * @return Memory, freed with the arena.
+ */
+static gpointer
+arena_alloc (entity_arena_t *arena, gsize size)
+{
+  gpointer memory;
+
+  size = (size + sizeof (gpointer) - 1) & ~(sizeof (gpointer) - 1);
+  if (size > arena->left)
+    {
+      gsize block_size = MAX (ARENA_BLOCK_SIZE, size + sizeof (gpointer));
+      gpointer *block = g_malloc (block_size);
+
+      block[0] = arena->blocks;
+      arena->blocks = block;
+      arena->size += block_size;
+      gvm_memstats_alloc (GVM_MEM_ENTITIES, block_size);
+      arena->next = (gchar *) (block + 1);
+      arena->left = block_size - sizeof (gpointer);
+    }
+  memory = arena->next;
+  arena->next += size;
+  arena->left -= size;
+  return memory;
+}
+
+/**
+ * @brief Free an entity arena with all the entities in it.
+ *
+ * @param[in]  arena  Arena.
+ */
+static void
+arena_free (entity_arena_t *arena)
+{
+  while (arena->blocks)
+    {
+      gpointer *block = arena->blocks;
+
+      arena->blocks = block[0];
+      g_free (block);
+    }
+  gvm_memstats_free (GVM_MEM_ENTITIES, arena->size);
+  g_slist_free_full (arena->indexes, (GDestroyNotify) g_hash_table_destroy);
+  g_string_chunk_free (arena->strings);
+  g_free (arena);
+}
+
 /**
  * @brief Return all the entities from an entities_t after the first.
  *
@@ -109,17 +345,29 @@ add_entity (entities_t *entities, const char *name, const char *text)
 /**
  * @brief Free an entity, recursively.
  *
+ * An entity from parse_entity_arena is only freed with the root of its tree.
+ *
  * @param[in]  entity  The entity, can be NULL.
  */
 void
 free_entity (entity_t entity)
 {
+  if (entity && entity->arena)
+    {
+      /* Entities in an arena go with the root. */
+      if (entity->arena->root == entity)
+        arena_free (entity->arena);
+      return;
+    }
   if (entity)
     {
       g_free (entity->name);
       g_free (entity->text);
       if (entity->attributes)
         g_hash_table_destroy (entity->attributes);
+      g_strfreev ((gchar **) entity->attribute_array);
+      if (entity->child_index)
+        g_hash_table_destroy (entity->child_index);
       if (entity->entities)
         {
           GSList *list = entity->entities;
@@ -131,6 +379,7 @@ free_entity (entity_t entity)
           g_slist_free (entity->entities);
         }
       g_free (entity);
+      gvm_memstats_free (GVM_MEM_ENTITIES, sizeof (*entity));
     }
 }
 
@@ -182,28 +431,135 @@ compare_entity_with_name (gconstpointer entity, gconstpointer name)
 }
 
 /**
- * @brief Get a child of an entity.
+ * @brief Number of children from which lookups use an index.
+ */
+#define CHILD_INDEX_MIN 8
+
+/**
+ * @brief Look up the first child of an entity with a name in the index.
+ *
+ * Creates the index if needed, and adds the children appended since the
+ * last lookup.
  *
  * @param[in]  entity  Entity.
  * @param[in]  name    Name of the child.
  *
- * @return Entity if found, else NULL.
+ * @return List of the children from the first with the name, else NULL.
  */
-entity_t
-entity_child (entity_t entity, const char *name)
+static entities_t
+child_index_lookup (entity_t entity, const char *name)
+{
+  entities_t list;
+
+  if (entity->child_index == NULL)
+    {
+      entity->child_index = g_hash_table_new (g_str_hash, g_str_equal);
+      entity->child_index_tail = NULL;
+      if (entity->arena)
+        entity->arena->indexes =
+          g_slist_prepend (entity->arena->indexes, entity->child_index);
+    }
+
+  list = entity->child_index_tail ? entity->child_index_tail->next
+                                  : entity->entities;
+  for (; list; list = list->next)
+    {
+      entity_t child = (entity_t) list->data;
+
+      if (!g_hash_table_contains (entity->child_index, child->name))
+        g_hash_table_insert (entity->child_index, child->name, list);
+      entity->child_index_tail = list;
+    }
+
+  return g_hash_table_lookup (entity->child_index, name);
+}
+
+/**
+ * @brief Drop the child index of an entity, after removing children.
+ *
+ * @param[in]  entity  Entity.
+ */
+static void
+child_index_clear (entity_t entity)
+{
+  if (entity->child_index == NULL)
+    return;
+  if (entity->arena)
+    entity->arena->indexes =
+      g_slist_remove (entity->arena->indexes, entity->child_index);
+  g_hash_table_destroy (entity->child_index);
+  entity->child_index = NULL;
+  entity->child_index_tail = NULL;
+}
+
+/**
+ * @brief Get the children of an entity from the first one with a name.
+ *
+ * Entities with many children get an index on the first lookup, so that
+ * looking up each of their fields stays cheap.  Children may be appended
+ * afterwards, but not removed.  Use next_entities_named to get the following
+ * children with the name.
+ *
+ * @param[in]  entity  Entity.
+ * @param[in]  name    Name of the child.
+ *
+ * @return List of the children from the first with the name, else NULL.
+ */
+entities_t
+entity_children_named (entity_t entity, const char *name)
 {
+  entities_t list;
+  int count;
+
   if (!entity)
     return NULL;
 
-  if (entity->entities)
+  if (entity->child_index)
+    return child_index_lookup (entity, name);
+
+  count = 0;
+  for (list = entity->entities; list; list = list->next)
     {
-      entities_t match =
-        g_slist_find_custom (entity->entities, name, compare_entity_with_name);
-      return match ? (entity_t) match->data : NULL;
+      if (strcmp (((entity_t) list->data)->name, name) == 0)
+        return list;
+      if (++count == CHILD_INDEX_MIN && list->next)
+        return child_index_lookup (entity, name);
     }
   return NULL;
 }
 
+/**
+ * @brief Get the next child with a name.
+ *
+ * @param[in]  entities  List of children, as from entity_children_named.
+ * @param[in]  name      Name of the child.
+ *
+ * @return List of the children from the next with the name, else NULL.
+ */
+entities_t
+next_entities_named (entities_t entities, const char *name)
+{
+  if (entities == NULL)
+    return NULL;
+  return g_slist_find_custom (entities->next, name, compare_entity_with_name);
+}
+
+/**
+ * @brief Get a child of an entity.
+ *
+ * @param[in]  entity  Entity.
+ * @param[in]  name    Name of the child.
+ *
+ * @return Entity if found, else NULL.
+ */
+entity_t
+entity_child (entity_t entity, const char *name)
+{
+  entities_t match = entity_children_named (entity, name);
+
+  return match ? (entity_t) match->data : NULL;
+}
+
 /**
  * @brief Get an attribute of an entity.
  *
@@ -219,13 +575,55 @@ entity_attribute (entity_t entity, const char *name)
     return NULL;
 
   if (entity->attributes)
-    return (const char *) g_hash_table_lookup (entity->attributes, name);
+    {
+      const char *value = g_hash_table_lookup (entity->attributes, name);
+
+      if (value)
+        return value;
+    }
+  if (entity->attribute_array)
+    {
+      const gchar **attribute;
+
+      for (attribute = entity->attribute_array; *attribute; attribute += 2)
+        if (strcmp (attribute[0], name) == 0)
+          return attribute[1];
+    }
   return NULL;
 }
 
+/**
+ * @brief Call a function for each attribute of an entity.
+ *
+ * @param[in]  entity  Entity.
+ * @param[in]  func    Function, called with name, value and data.
+ * @param[in]  data    Data for the function.
+ */
+static void
+foreach_entity_attribute (entity_t entity, GHFunc func, gpointer data)
+{
+  if (entity->attributes)
+    g_hash_table_foreach (entity->attributes, func, data);
+  if (entity->attribute_array)
+    {
+      const gchar **attribute;
+
+      for (attribute = entity->attribute_array; *attribute; attribute += 2)
+        func ((gpointer) attribute[0], (gpointer) attribute[1], data);
+    }
+}
+
+/**
+ * @brief Number of attributes up to which they are kept in an array.
+ */
+#define INLINE_ATTRIBUTES_MAX 2
+
 /**
  * @brief Add attributes from an XML callback to an entity.
  *
+ * Few attributes are kept in an array, which is cheaper to build and search
+ * than a hash table.
+ *
  * @param[in]  entity  The entity.
  * @param[in]  names   List of attribute names.
  * @param[in]  values  List of attribute values.
@@ -233,7 +631,29 @@ entity_attribute (entity_t entity, const char *name)
 static void
 add_attributes (entity_t entity, const gchar **names, const gchar **values)
 {
-  if (names && values && *names && *values)
+  int count;
+
+  if (names == NULL || values == NULL)
+    return;
+  for (count = 0; names[count] && values[count]; count++)
+    if (count == INLINE_ATTRIBUTES_MAX)
+      break;
+
+  if (count && names[count] == NULL && entity->attributes == NULL
+      && entity->attribute_array == NULL)
+    {
+      const gchar **array = g_new (const gchar *, 2 * count + 1);
+      int index;
+
+      for (index = 0; index < count; index++)
+        {
+          array[2 * index] = g_strdup (names[index]);
+          array[2 * index + 1] = g_strdup (values[index]);
+        }
+      array[2 * count] = NULL;
+      entity->attribute_array = array;
+    }
+  else if (*names && *values)
     {
       if (entity->attributes == NULL)
         entity->attributes =
@@ -482,7 +902,78 @@ handle_error (GMarkupParseContext *context, GError *error, gpointer user_data)
 }
 
 /**
- * @brief Try read an XML entity tree from the manager.
+ * @brief Context for streaming the elements at one depth while parsing.
+ */
+typedef struct
+{
+  context_data_t context;    ///< Tree context, first for the tree handlers.
+  int depth;                 ///< Depth of the current element, root is 0.
+  int stream_depth;          ///< Depth of the streamed elements.
+  entity_stream_func_t func; ///< Function called with each streamed element.
+  gpointer func_data;        ///< Data for the function.
+} stream_context_t;
+
+/**
+ * @brief Handle the start of an XML element when streaming.
+ *
+ * @param[in]  context           Parser context.
+ * @param[in]  element_name      XML element name.
+ * @param[in]  attribute_names   XML attribute name.
+ * @param[in]  attribute_values  XML attribute values.
+ * @param[in]  user_data         Stream context.
+ * @param[in]  error             Error parameter.
+ */
+static void
+stream_handle_start_element (GMarkupParseContext *context,
+                             const gchar *element_name,
+                             const gchar **attribute_names,
+                             const gchar **attribute_values,
+                             gpointer user_data, GError **error)
+{
+  stream_context_t *data = (stream_context_t *) user_data;
+
+  data->depth++;
+  handle_start_element (context, element_name, attribute_names,
+                        attribute_values, &data->context, error);
+}
+
+/**
+ * @brief Handle the end of an XML element when streaming.
+ *
+ * Passes an element at the stream depth to the stream function, after
+ * removing it from its parent, and frees it.
+ *
+ * @param[in]  context           Parser context.
+ * @param[in]  element_name      XML element name.
+ * @param[in]  user_data         Stream context.
+ * @param[in]  error             Error parameter.
+ */
+static void
+stream_handle_end_element (GMarkupParseContext *context,
+                           const gchar *element_name, gpointer user_data,
+                           GError **error)
+{
+  stream_context_t *data = (stream_context_t *) user_data;
+
+  if (data->depth == data->stream_depth && data->context.current
+      && data->context.current->next)
+    {
+      entity_t entity = (entity_t) data->context.current->data;
+      entity_t parent = (entity_t) data->context.current->next->data;
+
+      parent->entities = g_slist_remove (parent->entities, entity);
+      child_index_clear (parent);
+      handle_end_element (context, element_name, &data->context, error);
+      data->func (entity, data->func_data);
+      free_entity (entity);
+    }
+  else
+    handle_end_element (context, element_name, &data->context, error);
+  data->depth--;
+}
+
+/**
+ * @brief Try read an XML entity tree from the manager, optionally streaming.
  *
  * @param[in]   session        Pointer to GNUTLS session.
  * @param[in]   timeout        Server idle time before giving up, in seconds.  0
@@ -493,14 +984,22 @@ handle_error (GMarkupParseContext *context, GError *error, gpointer user_data)
  *                             remains NULL.  If a pointer to NULL then it
  * points to a freshly allocated GString on successful return. Otherwise it
  * points to an existing GString onto which the text is appended.
+ * @param[in]   depth          Depth of the elements to stream, root is 0.
+ * @param[in]   func           Function to call with each element at depth,
+ *                             NULL to read the whole tree.
+ * @param[in]   func_data      Data for func.
  *
  * @return 0 success, -1 read error, -2 parse error, -3 end of file, -4 timeout,
  * -5 null buffer.
  */
-int
-try_read_entity_and_string (gnutls_session_t *session, int timeout,
-                            entity_t *entity, GString **string_return)
+static int
+try_read_entity_stream_tls (gnutls_session_t *session, int timeout,
+                            entity_t *entity, GString **string_return,
+                            int depth, entity_stream_func_t func,
+                            gpointer func_data)
 {
+  stream_context_t stream_data;
+  context_data_t *context_data = &stream_data.context;
   GMarkupParser xml_parser;
   GError *error = NULL;
   GMarkupParseContext *xml_context;
@@ -509,7 +1008,7 @@ try_read_entity_and_string (gnutls_session_t *session, int timeout,
   time_t last_time;
 
   // Buffer for reading from the manager.
-  char *buffer;
+  read_buffer_t *buffer;
 
   /* Record the start time. */
 
@@ -531,7 +1030,7 @@ try_read_entity_and_string (gnutls_session_t *session, int timeout,
     /* Quiet compiler. */
     socket = 0;
 
-  buffer = g_malloc0 (BUFFER_SIZE);
+  buffer = read_buffer_get ();
   if (!buffer)
     return -5;
 
@@ -546,7 +1045,13 @@ try_read_entity_and_string (gnutls_session_t *session, int timeout,
 
   /* Create the XML parser. */
 
-  if (entity)
+  if (entity && func)
+    {
+      xml_parser.start_element = stream_handle_start_element;
+      xml_parser.end_element = stream_handle_end_element;
+      xml_parser.text = handle_text;
+    }
+  else if (entity)
     {
       xml_parser.start_element = handle_start_element;
       xml_parser.end_element = handle_end_element;
@@ -561,15 +1066,18 @@ try_read_entity_and_string (gnutls_session_t *session, int timeout,
   xml_parser.passthrough = NULL;
   xml_parser.error = handle_error;
 
-  context_data_t context_data;
-  context_data.done = FALSE;
-  context_data.first = NULL;
-  context_data.current = NULL;
+  stream_data.depth = -1;
+  stream_data.stream_depth = depth;
+  stream_data.func = func;
+  stream_data.func_data = func_data;
+  context_data->done = FALSE;
+  context_data->first = NULL;
+  context_data->current = NULL;
 
   /* Setup the XML context. */
 
   xml_context =
-    g_markup_parse_context_new (&xml_parser, 0, &context_data, NULL);
+    g_markup_parse_context_new (&xml_parser, 0, &stream_data, NULL);
 
   /* Read and parse, until encountering end of file or error. */
 
@@ -579,8 +1087,8 @@ try_read_entity_and_string (gnutls_session_t *session, int timeout,
       int retries = 10;
       while (1)
         {
-          g_debug ("   asking for %i\n", BUFFER_SIZE);
-          count = gnutls_record_recv (*session, buffer, BUFFER_SIZE);
+          READ_TRACE ("   asking for %zu\n", buffer->size);
+          count = gnutls_record_recv (*session, buffer->data, buffer->size);
           if (count < 0)
             {
               if (count == GNUTLS_E_INTERRUPTED)
@@ -589,14 +1097,14 @@ try_read_entity_and_string (gnutls_session_t *session, int timeout,
               if ((timeout > 0) && (count == GNUTLS_E_AGAIN))
                 {
                   /* Server still busy, either timeout or try read again. */
-                  if ((timeout - (time (NULL) - last_time)) <= 0)
+                  if (!wait_readable (socket, last_time, timeout))
                     {
                       g_warning ("   timeout\n");
                       if (fcntl (socket, F_SETFL, 0L) < 0)
                         g_warning ("%s :failed to set socket flag: %s",
                                    __func__, strerror (errno));
                       g_markup_parse_context_free (xml_context);
-                      g_free (buffer);
+                      read_buffer_release (buffer);
                       return -4;
                     }
                   continue;
@@ -617,10 +1125,10 @@ try_read_entity_and_string (gnutls_session_t *session, int timeout,
               if (count == GNUTLS_E_REHANDSHAKE)
                 /* Try again. TODO Rehandshake. */
                 continue;
-              if (context_data.first && context_data.first->data)
+              if (context_data->first && context_data->first->data)
                 {
-                  free_entity (context_data.first->data);
-                  g_slist_free_1 (context_data.first);
+                  free_entity (context_data->first->data);
+                  g_slist_free_1 (context_data->first);
                 }
               if (string && *string_return == NULL)
                 g_string_free (string, TRUE);
@@ -631,7 +1139,7 @@ try_read_entity_and_string (gnutls_session_t *session, int timeout,
                                strerror (errno));
                 }
               g_markup_parse_context_free (xml_context);
-              g_free (buffer);
+              read_buffer_release (buffer);
               return -1;
             }
           if (count == 0)
@@ -643,10 +1151,10 @@ try_read_entity_and_string (gnutls_session_t *session, int timeout,
                   g_warning ("   End error: %s\n", error->message);
                   g_error_free (error);
                 }
-              if (context_data.first && context_data.first->data)
+              if (context_data->first && context_data->first->data)
                 {
-                  free_entity (context_data.first->data);
-                  g_slist_free_1 (context_data.first);
+                  free_entity (context_data->first->data);
+                  g_slist_free_1 (context_data->first);
                 }
               if (string && *string_return == NULL)
                 g_string_free (string, TRUE);
@@ -657,25 +1165,26 @@ try_read_entity_and_string (gnutls_session_t *session, int timeout,
                                strerror (errno));
                 }
               g_markup_parse_context_free (xml_context);
-              g_free (buffer);
+              read_buffer_release (buffer);
               return -3;
             }
           break;
         }
 
-      g_debug ("<= %.*s\n", (int) count, buffer);
+      READ_TRACE ("<= %.*s\n", (int) count, buffer->data);
 
       if (string)
-        g_string_append_len (string, buffer, count);
+        g_string_append_len (string, buffer->data, count);
 
-      g_markup_parse_context_parse (xml_context, buffer, count, &error);
+      g_markup_parse_context_parse (xml_context, buffer->data, count,
+                                    &error);
       if (error)
         {
           g_error_free (error);
-          if (context_data.first && context_data.first->data)
+          if (context_data->first && context_data->first->data)
             {
-              free_entity (context_data.first->data);
-              g_slist_free_1 (context_data.first);
+              free_entity (context_data->first->data);
+              g_slist_free_1 (context_data->first);
             }
           if (string && *string_return == NULL)
             g_string_free (string, TRUE);
@@ -686,38 +1195,40 @@ try_read_entity_and_string (gnutls_session_t *session, int timeout,
                            strerror (errno));
             }
           g_markup_parse_context_free (xml_context);
-          g_free (buffer);
+          read_buffer_release (buffer);
           return -2;
         }
-      if (context_data.done)
+      if (context_data->done)
         {
           g_markup_parse_context_end_parse (xml_context, &error);
           if (error)
             {
               g_warning ("   End error: %s\n", error->message);
               g_error_free (error);
-              if (context_data.first && context_data.first->data)
+              if (context_data->first && context_data->first->data)
                 {
-                  free_entity (context_data.first->data);
-                  g_slist_free_1 (context_data.first);
+                  free_entity (context_data->first->data);
+                  g_slist_free_1 (context_data->first);
                 }
               if (timeout > 0)
                 fcntl (socket, F_SETFL, 0L);
               g_markup_parse_context_free (xml_context);
-              g_free (buffer);
+              read_buffer_release (buffer);
               return -2;
             }
           if (entity)
-            *entity = (entity_t) context_data.first->data;
+            *entity = (entity_t) context_data->first->data;
           if (string)
             *string_return = string;
           if (timeout > 0)
             fcntl (socket, F_SETFL, 0L);
           g_markup_parse_context_free (xml_context);
-          g_free (buffer);
+          read_buffer_release (buffer);
           return 0;
         }
 
+      read_buffer_adapt (buffer, count);
+
       if ((timeout > 0) && (time (&last_time) == -1))
         {
           g_warning ("   failed to get current time (1): %s\n",
@@ -726,28 +1237,52 @@ try_read_entity_and_string (gnutls_session_t *session, int timeout,
             g_warning ("%s :failed to set socket flag: %s", __func__,
                        strerror (errno));
           g_markup_parse_context_free (xml_context);
-          g_free (buffer);
+          read_buffer_release (buffer);
           return -1;
         }
     }
 }
 
 /**
- * @brief Try read a response from a TLS session.
+ * @brief Try read an XML entity tree from the manager.
  *
  * @param[in]   session        Pointer to GNUTLS session.
  * @param[in]   timeout        Server idle time before giving up, in seconds.  0
- *                             to wait forever.
+ * to wait forever.
+ * @param[out]  entity         Pointer to an entity tree.
  * @param[out]  string_return  An optional return location for the text read
- *                             from the session.
- *
- * If string_return is NULL then it simply remains NULL.  If it is pointer to
- * NULL then it points to a freshly allocated GString on successful return.
- * Otherwise it must point to an existing GString onto which the text is
- * appended.
+ *                             from the session.  If NULL then it simply
+ *                             remains NULL.  If a pointer to NULL then it
+ * points to a freshly allocated GString on successful return. Otherwise it
+ * points to an existing GString onto which the text is appended.
  *
- * @return 0 success, -1 read error, -4 timeout, -5 null buffer.
- */
+ * @return 0 success, -1 read error, -2 parse error, -3 end of file, -4 timeout,
+ * -5 null buffer.
+ */
+int
+try_read_entity_and_string (gnutls_session_t *session, int timeout,
+                            entity_t *entity, GString **string_return)
+{
+  return try_read_entity_stream_tls (session, timeout, entity, string_return,
+                                     0, NULL, NULL);
+}
+
+/**
+ * @brief Try read a response from a TLS session.
+ *
+ * @param[in]   session        Pointer to GNUTLS session.
+ * @param[in]   timeout        Server idle time before giving up, in seconds.  0
+ *                             to wait forever.
+ * @param[out]  string_return  An optional return location for the text read
+ *                             from the session.
+ *
+ * If string_return is NULL then it simply remains NULL.  If it is pointer to
+ * NULL then it points to a freshly allocated GString on successful return.
+ * Otherwise it must point to an existing GString onto which the text is
+ * appended.
+ *
+ * @return 0 success, -1 read error, -4 timeout, -5 null buffer.
+ */
 static int
 try_read_string (gnutls_session_t *session, int timeout,
                  GString **string_return)
@@ -755,7 +1290,7 @@ try_read_string (gnutls_session_t *session, int timeout,
   GString *string;
   int socket;
   time_t last_time;
-  char *buffer; // Buffer for reading from the server.
+  read_buffer_t *buffer; // Buffer for reading from the server.
 
   /* Record the start time. */
 
@@ -777,7 +1312,7 @@ try_read_string (gnutls_session_t *session, int timeout,
     /* Quiet compiler. */
     socket = 0;
 
-  buffer = g_malloc0 (BUFFER_SIZE);
+  buffer = read_buffer_get ();
   if (!buffer)
     return -5;
 
@@ -798,8 +1333,8 @@ try_read_string (gnutls_session_t *session, int timeout,
       int retries = 10;
       while (1)
         {
-          g_debug ("   asking for %i\n", BUFFER_SIZE);
-          count = gnutls_record_recv (*session, buffer, BUFFER_SIZE);
+          READ_TRACE ("   asking for %zu\n", buffer->size);
+          count = gnutls_record_recv (*session, buffer->data, buffer->size);
           if (count < 0)
             {
               if (count == GNUTLS_E_INTERRUPTED)
@@ -808,13 +1343,13 @@ try_read_string (gnutls_session_t *session, int timeout,
               if ((timeout > 0) && (count == GNUTLS_E_AGAIN))
                 {
                   /* Server still busy, either timeout or try read again. */
-                  if ((timeout - (time (NULL) - last_time)) <= 0)
+                  if (!wait_readable (socket, last_time, timeout))
                     {
                       g_warning ("   timeout\n");
                       if (fcntl (socket, F_SETFL, 0L) < 0)
                         g_warning ("%s: failed to set socket flag: %s",
                                    __func__, strerror (errno));
-                      g_free (buffer);
+                      read_buffer_release (buffer);
                       return -4;
                     }
                   continue;
@@ -843,7 +1378,7 @@ try_read_string (gnutls_session_t *session, int timeout,
                     g_warning ("%s: failed to set socket flag: %s", __func__,
                                strerror (errno));
                 }
-              g_free (buffer);
+              read_buffer_release (buffer);
               return -1;
             }
           if (count == 0)
@@ -857,16 +1392,18 @@ try_read_string (gnutls_session_t *session, int timeout,
                 }
               if (string)
                 *string_return = string;
-              g_free (buffer);
+              read_buffer_release (buffer);
               return 0;
             }
           break;
         }
 
-      g_debug ("<= %.*s\n", (int) count, buffer);
+      READ_TRACE ("<= %.*s\n", (int) count, buffer->data);
 
       if (string)
-        g_string_append_len (string, buffer, count);
+        g_string_append_len (string, buffer->data, count);
+
+      read_buffer_adapt (buffer, count);
 
       if ((timeout > 0) && (time (&last_time) == -1))
         {
@@ -875,12 +1412,121 @@ try_read_string (gnutls_session_t *session, int timeout,
           if (fcntl (socket, F_SETFL, 0L) < 0)
             g_warning ("%s :failed to set socket flag: %s", __func__,
                        strerror (errno));
-          g_free (buffer);
+          read_buffer_release (buffer);
           return -1;
         }
     }
 }
 
+/**
+ * @brief Try read a response from a TLS session, passing on each chunk.
+ *
+ * Nothing is kept between the chunks, so the memory used does not depend on
+ * the size of the response.
+ *
+ * @param[in]  session    Pointer to GNUTLS session.
+ * @param[in]  timeout    Server idle time before giving up, in seconds.  0
+ *                        to wait forever.
+ * @param[in]  func       Function called with each chunk read.  Returns 1
+ *                        when the response is complete, 0 to read more, or
+ *                        a negative number to give up.
+ * @param[in]  func_data  Data for func.
+ *
+ * @return 0 success, -1 read error, -3 end of file, -4 timeout, -5 null
+ * buffer, or the negative return of func.
+ */
+int
+try_read_chunks (gnutls_session_t *session, int timeout, read_chunk_func_t func,
+                 gpointer func_data)
+{
+  int socket, ret;
+  time_t last_time;
+  read_buffer_t *buffer; // Buffer for reading from the server.
+
+  if (time (&last_time) == -1)
+    {
+      g_warning ("   failed to get current time: %s\n", strerror (errno));
+      return -1;
+    }
+
+  if (timeout > 0)
+    {
+      /* Turn off blocking. */
+
+      socket = GPOINTER_TO_INT (gnutls_transport_get_ptr (*session));
+      if (fcntl (socket, F_SETFL, O_NONBLOCK) == -1)
+        return -1;
+    }
+  else
+    /* Quiet compiler. */
+    socket = 0;
+
+  buffer = read_buffer_get ();
+  if (!buffer)
+    return -5;
+
+  ret = 0;
+  while (ret == 0)
+    {
+      ssize_t count;
+      int retries = 10;
+
+      while (1)
+        {
+          READ_TRACE ("   asking for %zu\n", buffer->size);
+          count = gnutls_record_recv (*session, buffer->data, buffer->size);
+          if (count == GNUTLS_E_INTERRUPTED || count == GNUTLS_E_REHANDSHAKE)
+            continue;
+          if (count == GNUTLS_E_AGAIN)
+            {
+              /* Server still busy, either timeout or try read again. */
+              if (timeout > 0)
+                {
+                  if (wait_readable (socket, last_time, timeout))
+                    continue;
+                  g_warning ("   timeout\n");
+                  ret = -4;
+                }
+              else if (retries-- > 0)
+                continue;
+            }
+          break;
+        }
+      if (ret)
+        break;
+      if (count <= 0)
+        {
+          ret = count == 0 ? -3 : -1;
+          break;
+        }
+
+      READ_TRACE ("<= %.*s\n", (int) count, buffer->data);
+
+      ret = func (buffer->data, count, func_data);
+      if (ret > 0)
+        {
+          ret = 0;
+          break;
+        }
+      if (ret < 0)
+        break;
+
+      read_buffer_adapt (buffer, count);
+
+      if ((timeout > 0) && (time (&last_time) == -1))
+        {
+          g_warning ("   failed to get current time (1): %s\n",
+                     strerror (errno));
+          ret = -1;
+        }
+    }
+
+  if (timeout > 0 && fcntl (socket, F_SETFL, 0L) < 0)
+    g_warning ("%s: failed to set socket flag: %s", __func__, strerror (errno));
+  read_buffer_release (buffer);
+  return ret;
+}
+
 /**
  * @brief Try read an XML entity tree from the socket.
  *
@@ -902,7 +1548,7 @@ try_read_string_s (int socket, int timeout, GString **string_return)
   GString *string;
   time_t last_time;
   /* Buffer for reading from the socket. */
-  char *buffer;
+  read_buffer_t *buffer;
 
   /* Record the start time. */
 
@@ -920,7 +1566,7 @@ try_read_string_s (int socket, int timeout, GString **string_return)
         return -1;
     }
 
-  buffer = g_malloc0 (BUFFER_SIZE);
+  buffer = read_buffer_get ();
   if (!buffer)
     return -5;
 
@@ -940,8 +1586,8 @@ try_read_string_s (int socket, int timeout, GString **string_return)
       int count;
       while (1)
         {
-          g_debug ("   asking for %i\n", BUFFER_SIZE);
-          count = read (socket, buffer, BUFFER_SIZE);
+          READ_TRACE ("   asking for %zu\n", buffer->size);
+          count = read (socket, buffer->data, buffer->size);
           if (count < 0)
             {
               if (errno == EINTR)
@@ -952,13 +1598,13 @@ try_read_string_s (int socket, int timeout, GString **string_return)
                   if (errno == EAGAIN)
                     {
                       /* Server still busy, either timeout or try read again. */
-                      if ((timeout - (time (NULL) - last_time)) <= 0)
+                      if (!wait_readable (socket, last_time, timeout))
                         {
                           g_warning ("   timeout\n");
                           if (fcntl (socket, F_SETFL, 0L) < 0)
                             g_warning ("%s :failed to set socket flag: %s",
                                        __func__, strerror (errno));
-                          g_free (buffer);
+                          read_buffer_release (buffer);
                           if (string && *string_return == NULL)
                             g_string_free (string, TRUE);
                           return -4;
@@ -970,7 +1616,7 @@ try_read_string_s (int socket, int timeout, GString **string_return)
                 g_string_free (string, TRUE);
               if (timeout > 0)
                 fcntl (socket, F_SETFL, 0L);
-              g_free (buffer);
+              read_buffer_release (buffer);
               return -1;
             }
           if (count == 0)
@@ -984,16 +1630,18 @@ try_read_string_s (int socket, int timeout, GString **string_return)
                 }
               if (string)
                 *string_return = string;
-              g_free (buffer);
+              read_buffer_release (buffer);
               return 0;
             }
           break;
         }
 
-      g_debug ("<= %.*s\n", (int) count, buffer);
+      READ_TRACE ("<= %.*s\n", (int) count, buffer->data);
 
       if (string)
-        g_string_append_len (string, buffer, count);
+        g_string_append_len (string, buffer->data, count);
+
+      read_buffer_adapt (buffer, count);
 
       if ((timeout > 0) && (time (&last_time) == -1))
         {
@@ -1002,7 +1650,7 @@ try_read_string_s (int socket, int timeout, GString **string_return)
           if (fcntl (socket, F_SETFL, 0L) < 0)
             g_warning ("%s :failed to set server socket flag: %s", __func__,
                        strerror (errno));
-          g_free (buffer);
+          read_buffer_release (buffer);
           if (string && *string_return == NULL)
             g_string_free (string, TRUE);
           return -1;
@@ -1011,7 +1659,125 @@ try_read_string_s (int socket, int timeout, GString **string_return)
 }
 
 /**
- * @brief Try read an XML entity tree from the socket.
+ * @brief Try read a response from a socket, passing on each chunk.
+ *
+ * @param[in]  socket     Socket to read from.
+ * @param[in]  timeout    Server idle time before giving up, in seconds.  0
+ *                        to wait forever.
+ * @param[in]  func       Function called with each chunk read.  Returns 1
+ *                        when the response is complete, 0 to read more, or
+ *                        a negative number to give up.
+ * @param[in]  func_data  Data for func.
+ *
+ * @return 0 success, -1 read error, -3 end of file, -4 timeout, -5 null
+ * buffer, or the negative return of func.
+ */
+static int
+try_read_chunks_s (int socket, int timeout, read_chunk_func_t func,
+                   gpointer func_data)
+{
+  time_t last_time;
+  read_buffer_t *buffer; // Buffer for reading from the socket.
+  int ret;
+
+  if (time (&last_time) == -1)
+    {
+      g_warning ("   failed to get current time: %s\n", strerror (errno));
+      return -1;
+    }
+
+  if (timeout > 0)
+    {
+      /* Turn off blocking. */
+
+      if (fcntl (socket, F_SETFL, O_NONBLOCK) == -1)
+        return -1;
+    }
+
+  buffer = read_buffer_get ();
+  if (!buffer)
+    return -5;
+
+  ret = 0;
+  while (ret == 0)
+    {
+      ssize_t count;
+
+      READ_TRACE ("   asking for %zu\n", buffer->size);
+      count = read (socket, buffer->data, buffer->size);
+      if (count < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          if (timeout > 0 && errno == EAGAIN)
+            {
+              /* Server still busy, either timeout or try read again. */
+              if (wait_readable (socket, last_time, timeout))
+                continue;
+              g_warning ("   timeout\n");
+              ret = -4;
+            }
+          else
+            ret = -1;
+          break;
+        }
+      if (count == 0)
+        {
+          ret = -3;
+          break;
+        }
+
+      READ_TRACE ("<= %.*s\n", (int) count, buffer->data);
+
+      ret = func (buffer->data, count, func_data);
+      if (ret > 0)
+        {
+          ret = 0;
+          break;
+        }
+      if (ret < 0)
+        break;
+
+      read_buffer_adapt (buffer, count);
+
+      if ((timeout > 0) && (time (&last_time) == -1))
+        {
+          g_warning ("   failed to get current time (1): %s\n",
+                     strerror (errno));
+          ret = -1;
+        }
+    }
+
+  if (timeout > 0 && fcntl (socket, F_SETFL, 0L) < 0)
+    g_warning ("%s: failed to set socket flag: %s", __func__, strerror (errno));
+  read_buffer_release (buffer);
+  return ret;
+}
+
+/**
+ * @brief Try read a response from a connection, passing on each chunk.
+ *
+ * @param[in]  connection  Connection.
+ * @param[in]  timeout     Server idle time before giving up, in seconds.  0
+ *                         to wait forever.
+ * @param[in]  func        Function called with each chunk read, as for
+ *                         try_read_chunks.
+ * @param[in]  func_data   Data for func.
+ *
+ * @return 0 success, -1 read error, -3 end of file, -4 timeout, -5 null
+ * buffer, or the negative return of func.
+ */
+int
+try_read_chunks_c (gvm_connection_t *connection, int timeout,
+                   read_chunk_func_t func, gpointer func_data)
+{
+  if (connection->tls)
+    return try_read_chunks (&connection->session, timeout, func, func_data);
+  return try_read_chunks_s (connection->socket, timeout, func, func_data);
+}
+
+/**
+ * @brief Try read an XML entity tree from the socket, optionally streaming.
  *
  * @param[in]   socket         Socket to read from.
  * @param[in]   timeout        Server idle time before giving up, in seconds.  0
@@ -1022,21 +1788,28 @@ try_read_string_s (int socket, int timeout, GString **string_return)
  *                             remains NULL.  If a pointer to NULL then it
  * points to a freshly allocated GString on successful return. Otherwise it
  * points to an existing GString onto which the text is appended.
+ * @param[in]   depth          Depth of the elements to stream, root is 0.
+ * @param[in]   func           Function to call with each element at depth,
+ *                             NULL to read the whole tree.
+ * @param[in]   func_data      Data for func.
  *
  * @return 0 success, -1 read error, -2 parse error, -3 end of file, -4 timeout,
  * -5 null buffer.
  */
 static int
-try_read_entity_and_string_s (int socket, int timeout, entity_t *entity,
-                              GString **string_return)
+try_read_entity_stream_s (int socket, int timeout, entity_t *entity,
+                          GString **string_return, int depth,
+                          entity_stream_func_t func, gpointer func_data)
 {
+  stream_context_t stream_data;
+  context_data_t *context_data = &stream_data.context;
   GMarkupParser xml_parser;
   GError *error = NULL;
   GMarkupParseContext *xml_context;
   GString *string;
   time_t last_time;
   /* Buffer for reading from the socket. */
-  char *buffer;
+  read_buffer_t *buffer;
 
   /* Record the start time. */
 
@@ -1054,7 +1827,7 @@ try_read_entity_and_string_s (int socket, int timeout, entity_t *entity,
         return -1;
     }
 
-  buffer = g_malloc0 (BUFFER_SIZE);
+  buffer = read_buffer_get ();
   if (!buffer)
     return -5;
 
@@ -1069,7 +1842,13 @@ try_read_entity_and_string_s (int socket, int timeout, entity_t *entity,
 
   /* Create the XML parser. */
 
-  if (entity)
+  if (entity && func)
+    {
+      xml_parser.start_element = stream_handle_start_element;
+      xml_parser.end_element = stream_handle_end_element;
+      xml_parser.text = handle_text;
+    }
+  else if (entity)
     {
       xml_parser.start_element = handle_start_element;
       xml_parser.end_element = handle_end_element;
@@ -1084,15 +1863,18 @@ try_read_entity_and_string_s (int socket, int timeout, entity_t *entity,
   xml_parser.passthrough = NULL;
   xml_parser.error = handle_error;
 
-  context_data_t context_data;
-  context_data.done = FALSE;
-  context_data.first = NULL;
-  context_data.current = NULL;
+  stream_data.depth = -1;
+  stream_data.stream_depth = depth;
+  stream_data.func = func;
+  stream_data.func_data = func_data;
+  context_data->done = FALSE;
+  context_data->first = NULL;
+  context_data->current = NULL;
 
   /* Setup the XML context. */
 
   xml_context =
-    g_markup_parse_context_new (&xml_parser, 0, &context_data, NULL);
+    g_markup_parse_context_new (&xml_parser, 0, &stream_data, NULL);
 
   /* Read and parse, until encountering end of file or error. */
 
@@ -1101,8 +1883,8 @@ try_read_entity_and_string_s (int socket, int timeout, entity_t *entity,
       int count;
       while (1)
         {
-          g_debug ("   asking for %i\n", BUFFER_SIZE);
-          count = read (socket, buffer, BUFFER_SIZE);
+          READ_TRACE ("   asking for %zu\n", buffer->size);
+          count = read (socket, buffer->data, buffer->size);
           if (count < 0)
             {
               if (errno == EINTR)
@@ -1113,14 +1895,14 @@ try_read_entity_and_string_s (int socket, int timeout, entity_t *entity,
                   if (errno == EAGAIN)
                     {
                       /* Server still busy, either timeout or try read again. */
-                      if ((timeout - (time (NULL) - last_time)) <= 0)
+                      if (!wait_readable (socket, last_time, timeout))
                         {
                           g_warning ("   timeout\n");
                           if (fcntl (socket, F_SETFL, 0L) < 0)
                             g_warning ("%s :failed to set socket flag: %s",
                                        __func__, strerror (errno));
                           g_markup_parse_context_free (xml_context);
-                          g_free (buffer);
+                          read_buffer_release (buffer);
                           if (string && *string_return == NULL)
                             g_string_free (string, TRUE);
                           return -4;
@@ -1128,17 +1910,17 @@ try_read_entity_and_string_s (int socket, int timeout, entity_t *entity,
                     }
                   continue;
                 }
-              if (context_data.first && context_data.first->data)
+              if (context_data->first && context_data->first->data)
                 {
-                  free_entity (context_data.first->data);
-                  g_slist_free_1 (context_data.first);
+                  free_entity (context_data->first->data);
+                  g_slist_free_1 (context_data->first);
                 }
               if (string && *string_return == NULL)
                 g_string_free (string, TRUE);
               if (timeout > 0)
                 fcntl (socket, F_SETFL, 0L);
               g_markup_parse_context_free (xml_context);
-              g_free (buffer);
+              read_buffer_release (buffer);
               return -1;
             }
           if (count == 0)
@@ -1150,10 +1932,10 @@ try_read_entity_and_string_s (int socket, int timeout, entity_t *entity,
                   g_warning ("   End error: %s\n", error->message);
                   g_error_free (error);
                 }
-              if (context_data.first && context_data.first->data)
+              if (context_data->first && context_data->first->data)
                 {
-                  free_entity (context_data.first->data);
-                  g_slist_free_1 (context_data.first);
+                  free_entity (context_data->first->data);
+                  g_slist_free_1 (context_data->first);
                 }
               if (string && *string_return == NULL)
                 g_string_free (string, TRUE);
@@ -1164,26 +1946,27 @@ try_read_entity_and_string_s (int socket, int timeout, entity_t *entity,
                                strerror (errno));
                 }
               g_markup_parse_context_free (xml_context);
-              g_free (buffer);
+              read_buffer_release (buffer);
               return -3;
             }
           break;
         }
 
-      g_debug ("<= %.*s\n", (int) count, buffer);
+      READ_TRACE ("<= %.*s\n", (int) count, buffer->data);
 
       if (string)
-        g_string_append_len (string, buffer, count);
+        g_string_append_len (string, buffer->data, count);
 
-      g_markup_parse_context_parse (xml_context, buffer, count, &error);
+      g_markup_parse_context_parse (xml_context, buffer->data, count,
+                                    &error);
       if (error)
         {
           g_error_free (error);
           // FIX there may be multiple entries in list
-          if (context_data.first && context_data.first->data)
+          if (context_data->first && context_data->first->data)
             {
-              free_entity (context_data.first->data);
-              g_slist_free_1 (context_data.first);
+              free_entity (context_data->first->data);
+              g_slist_free_1 (context_data->first);
             }
           if (string && *string_return == NULL)
             g_string_free (string, TRUE);
@@ -1194,41 +1977,43 @@ try_read_entity_and_string_s (int socket, int timeout, entity_t *entity,
                            strerror (errno));
             }
           g_markup_parse_context_free (xml_context);
-          g_free (buffer);
+          read_buffer_release (buffer);
           return -2;
         }
-      if (context_data.done)
+      if (context_data->done)
         {
           g_markup_parse_context_end_parse (xml_context, &error);
           if (error)
             {
               g_warning ("   End error: %s\n", error->message);
               g_error_free (error);
-              if (context_data.first && context_data.first->data)
+              if (context_data->first && context_data->first->data)
                 {
-                  free_entity (context_data.first->data);
-                  g_slist_free_1 (context_data.first);
+                  free_entity (context_data->first->data);
+                  g_slist_free_1 (context_data->first);
                 }
               if (timeout > 0)
                 fcntl (socket, F_SETFL, 0L);
               g_markup_parse_context_free (xml_context);
-              g_free (buffer);
+              read_buffer_release (buffer);
               if (string && *string_return == NULL)
                 g_string_free (string, TRUE);
               return -2;
             }
           if (entity)
-            *entity = (entity_t) context_data.first->data;
+            *entity = (entity_t) context_data->first->data;
           if (string)
             *string_return = string;
           if (timeout > 0)
             fcntl (socket, F_SETFL, 0L);
-          g_slist_free (context_data.first);
+          g_slist_free (context_data->first);
           g_markup_parse_context_free (xml_context);
-          g_free (buffer);
+          read_buffer_release (buffer);
           return 0;
         }
 
+      read_buffer_adapt (buffer, count);
+
       if ((timeout > 0) && (time (&last_time) == -1))
         {
           g_warning ("   failed to get current time (1): %s\n",
@@ -1237,7 +2022,7 @@ try_read_entity_and_string_s (int socket, int timeout, entity_t *entity,
             g_warning ("%s :failed to set server socket flag: %s", __func__,
                        strerror (errno));
           g_markup_parse_context_free (xml_context);
-          g_free (buffer);
+          read_buffer_release (buffer);
           if (string && *string_return == NULL)
             g_string_free (string, TRUE);
           return -1;
@@ -1245,6 +2030,30 @@ try_read_entity_and_string_s (int socket, int timeout, entity_t *entity,
     }
 }
 
+/**
+ * @brief Try read an XML entity tree from the socket.
+ *
+ * @param[in]   socket         Socket to read from.
+ * @param[in]   timeout        Server idle time before giving up, in seconds.  0
+ * to wait forever.
+ * @param[out]  entity         Pointer to an entity tree.
+ * @param[out]  string_return  An optional return location for the text read
+ *                             from the session.  If NULL then it simply
+ *                             remains NULL.  If a pointer to NULL then it
+ * points to a freshly allocated GString on successful return. Otherwise it
+ * points to an existing GString onto which the text is appended.
+ *
+ * @return 0 success, -1 read error, -2 parse error, -3 end of file, -4 timeout,
+ * -5 null buffer.
+ */
+static int
+try_read_entity_and_string_s (int socket, int timeout, entity_t *entity,
+                              GString **string_return)
+{
+  return try_read_entity_stream_s (socket, timeout, entity, string_return, 0,
+                                   NULL, NULL);
+}
+
 /**
  * @brief Try read an XML entity tree from the manager.
  *
@@ -1457,6 +2266,98 @@ try_read_entity_c (gvm_connection_t *connection, int timeout, entity_t *entity)
                                        NULL);
 }
 
+/**
+ * @brief Try read an XML entity tree from the manager, streaming the elements
+ * @brief at one depth.
+ *
+ * Each element at the depth is passed to the function once it is complete,
+ * and freed when the function returns, so that the memory used stays bounded
+ * for large responses, like the results of a report or the VTs of a scanner.
+ * The rest of the tree is returned in entity.
+ *
+ * @param[in]   connection  Connection.
+ * @param[in]   timeout     Server idle time before giving up, in seconds.  0
+ *                          to wait forever.
+ * @param[in]   depth       Depth of the elements to stream, the children of
+ *                          the root are at 1.
+ * @param[in]   func        Function to call with each element at depth.  The
+ *                          element is freed after the call.
+ * @param[in]   func_data   Data for func.
+ * @param[out]  entity      Pointer to the tree without the streamed elements,
+ *                          or NULL to free it.
+ *
+ * @return 0 success, -1 read error, -2 parse error, -3 end of file, -4 timeout,
+ * -5 null buffer, -6 argument error.
+ */
+int
+try_read_entity_stream_c (gvm_connection_t *connection, int timeout, int depth,
+                          entity_stream_func_t func, gpointer func_data,
+                          entity_t *entity)
+{
+  entity_t tree = NULL;
+  int ret;
+
+  if (depth < 1 || func == NULL)
+    return -6;
+
+  if (connection->tls)
+    ret = try_read_entity_stream_tls (&connection->session, timeout, &tree,
+                                      NULL, depth, func, func_data);
+  else
+    ret = try_read_entity_stream_s (connection->socket, timeout, &tree, NULL,
+                                    depth, func, func_data);
+  if (ret == 0)
+    {
+      if (entity)
+        *entity = tree;
+      else
+        free_entity (tree);
+    }
+  return ret;
+}
+
+/**
+ * @brief Pass the elements at one depth of a parsed tree to a function.
+ *
+ * Does for a tree already in memory what try_read_entity_stream_c does
+ * while reading: each element at depth is removed from its parent, passed
+ * to func in document order, and freed.
+ *
+ * @param[in]  entity     Entity tree, not from parse_entity_arena.
+ * @param[in]  depth      Depth of the elements to stream, entity is 0.
+ * @param[in]  func       Function to call with each element at depth.
+ * @param[in]  func_data  Data for func.
+ */
+void
+entity_stream_children (entity_t entity, int depth, entity_stream_func_t func,
+                        gpointer func_data)
+{
+  entities_t list;
+
+  if (entity == NULL || func == NULL || depth < 1 || entity->arena)
+    return;
+
+  if (depth > 1)
+    {
+      for (list = entity->entities; list; list = list->next)
+        entity_stream_children ((entity_t) list->data, depth - 1, func,
+                                func_data);
+      return;
+    }
+
+  child_index_clear (entity);
+  list = entity->entities;
+  entity->entities = NULL;
+  while (list)
+    {
+      entity_t child = (entity_t) list->data;
+
+      list = g_slist_delete_link (list, list);
+      func (child, func_data);
+      free_entity (child);
+    }
+}
+
 /**
  * @brief Read an XML entity tree from the manager.
  *
@@ -1496,26 +2397,38 @@ read_entity_s (int socket, entity_t *entity)
 int
 read_entity_c (gvm_connection_t *connection, entity_t *entity)
 {
-  return try_read_entity_c (connection, 0, entity);
+  long long start = GVM_PROBE_USEC ();
+  int ret;
+
+  GVM_PROBE1 (read_entity_c_start, connection->tls);
+  ret = try_read_entity_c (connection, 0, entity);
+  GVM_PROBE2 (read_entity_c_end, ret, GVM_PROBE_USEC () - start);
+  return ret;
 }
 
 /**
- * @brief Read an XML entity tree from a string.
+ * @brief Incremental entity parser.
+ */
+struct entity_parser
+{
+  context_data_t context;           ///< Tree context, for the handlers.
+  GMarkupParseContext *xml_context; ///< Parser.
+  int status;                       ///< 0 parsing, 1 done, -2 parse error.
+};
+
+/**
+ * @brief Create a parser for an XML entity tree arriving in pieces.
  *
- * @param[in]   string  Input string.
- * @param[out]  entity  Pointer to an entity tree.
+ * For example from a non-blocking connection, feeding each piece from the
+ * read function of gvm_async_connection_read.
  *
- * @return 0 success, -1 read error, -2 parse error, -3 XML ended prematurely.
+ * @return Parser.
  */
-int
-parse_entity (const char *string, entity_t *entity)
+entity_parser_t *
+entity_parser_new (void)
 {
+  entity_parser_t *parser;
   GMarkupParser xml_parser;
-  GError *error = NULL;
-  GMarkupParseContext *xml_context;
-  context_data_t context_data;
-
-  /* Create the XML parser. */
 
   xml_parser.start_element = handle_start_element;
   xml_parser.end_element = handle_end_element;
@@ -1523,13 +2436,149 @@ parse_entity (const char *string, entity_t *entity)
   xml_parser.passthrough = NULL;
   xml_parser.error = handle_error;
 
-  context_data.done = FALSE;
-  context_data.first = NULL;
-  context_data.current = NULL;
-
-  /* Setup the XML context. */
+  parser = g_malloc0 (sizeof (*parser));
+  parser->xml_context =
+    g_markup_parse_context_new (&xml_parser, 0, &parser->context, NULL);
+  return parser;
+}
 
-  xml_context =
+/**
+ * @brief Feed a piece of XML to an entity parser.
+ *
+ * Once the root element is complete, further pieces are ignored.
+ *
+ * @param[in]  parser  Parser.
+ * @param[in]  data    XML.
+ * @param[in]  length  Length of data.
+ *
+ * @return 1 when the entity is complete, 0 for more data, -2 parse error.
+ */
+int
+entity_parser_feed (entity_parser_t *parser, const char *data, gsize length)
+{
+  GError *error = NULL;
+
+  if (parser->status)
+    return parser->status;
+
+  READ_TRACE ("<= %.*s\n", (int) length, data);
+  g_markup_parse_context_parse (parser->xml_context, data, length, &error);
+  if (error == NULL && parser->context.done)
+    g_markup_parse_context_end_parse (parser->xml_context, &error);
+  if (error)
+    {
+      g_warning ("   Parse error: %s\n", error->message);
+      g_error_free (error);
+      parser->status = -2;
+    }
+  else if (parser->context.done)
+    parser->status = 1;
+  return parser->status;
+}
+
+/**
+ * @brief Feed a piece of XML to an entity parser, up to the end of the root
+ * @brief element.
+ *
+ * The rest of the piece is left for the parser of the next entity, as when
+ * several responses arrive back to back.
+ *
+ * @param[in]  parser  Parser.
+ * @param[in]  data    XML.
+ * @param[in]  length  Length of data.
+ * @param[out] used    Number of bytes of data used.
+ *
+ * @return 1 when the entity is complete, 0 for more data, -2 parse error.
+ */
+int
+entity_parser_feed_part (entity_parser_t *parser, const char *data,
+                         gsize length, gsize *used)
+{
+  int ret = parser->status;
+
+  *used = 0;
+  while (ret == 0 && *used < length)
+    {
+      const char *end;
+      gsize piece;
+
+      /* The root element can only end at a '>'. */
+      end = memchr (data + *used, '>', length - *used);
+      piece = end ? (gsize) (end - (data + *used)) + 1 : length - *used;
+      ret = entity_parser_feed (parser, data + *used, piece);
+      *used += piece;
+    }
+  return ret;
+}
+
+/**
+ * @brief Take the entity from a parser that completed it.
+ *
+ * @param[in]  parser  Parser.
+ *
+ * @return Entity, which the caller must free, or NULL if not complete.
+ */
+entity_t
+entity_parser_take (entity_parser_t *parser)
+{
+  entity_t entity;
+
+  if (parser->status != 1 || parser->context.first == NULL)
+    return NULL;
+  entity = (entity_t) parser->context.first->data;
+  g_slist_free (parser->context.first);
+  parser->context.first = NULL;
+  return entity;
+}
+
+/**
+ * @brief Free an entity parser, with any entity not taken.
+ *
+ * @param[in]  parser  Parser.
+ */
+void
+entity_parser_free (entity_parser_t *parser)
+{
+  if (parser == NULL)
+    return;
+  if (parser->context.first && parser->context.first->data)
+    free_entity (parser->context.first->data);
+  g_slist_free (parser->context.first);
+  g_markup_parse_context_free (parser->xml_context);
+  g_free (parser);
+}
+
+/**
+ * @brief Read an XML entity tree from a string.
+ *
+ * @param[in]   string  Input string.
+ * @param[out]  entity  Pointer to an entity tree.
+ *
+ * @return 0 success, -1 read error, -2 parse error, -3 XML ended prematurely.
+ */
+int
+parse_entity (const char *string, entity_t *entity)
+{
+  GMarkupParser xml_parser;
+  GError *error = NULL;
+  GMarkupParseContext *xml_context;
+  context_data_t context_data;
+
+  /* Create the XML parser. */
+
+  xml_parser.start_element = handle_start_element;
+  xml_parser.end_element = handle_end_element;
+  xml_parser.text = handle_text;
+  xml_parser.passthrough = NULL;
+  xml_parser.error = handle_error;
+
+  context_data.done = FALSE;
+  context_data.first = NULL;
+  context_data.current = NULL;
+
+  /* Setup the XML context. */
+
+  xml_context =
     g_markup_parse_context_new (&xml_parser, 0, &context_data, NULL);
 
   /* Parse the string. */
@@ -1572,19 +2621,422 @@ parse_entity (const char *string, entity_t *entity)
 }
 
 /**
- * @brief Print an XML entity for g_slist_foreach to a GString.
+ * @brief Element open while parsing into an arena.
+ */
+typedef struct
+{
+  entity_t entity; ///< Element.
+  GSList *tail;    ///< Last child of the element.
+} arena_open_t;
+
+/**
+ * @brief Context for parsing into an arena.
+ */
+typedef struct
+{
+  entity_arena_t *arena; ///< Arena.
+  GArray *open;          ///< Stack of open elements, of arena_open_t.
+  gboolean done;         ///< Whether the root element is complete.
+} arena_context_t;
+
+/**
+ * @brief Handle the start of an XML element when parsing into an arena.
  *
- * @param[in]  entity  The entity, as a gpointer.
- * @param[in]  string  The stream to which to print, as a gpointer.
+ * @param[in]  context           Parser context.
+ * @param[in]  element_name      XML element name.
+ * @param[in]  attribute_names   XML attribute name.
+ * @param[in]  attribute_values  XML attribute values.
+ * @param[in]  user_data         Arena context.
+ * @param[in]  error             Error parameter.
  */
 static void
-foreach_print_entity_to_string (gpointer entity, gpointer string)
+arena_handle_start_element (GMarkupParseContext *context,
+                            const gchar *element_name,
+                            const gchar **attribute_names,
+                            const gchar **attribute_values, gpointer user_data,
+                            GError **error)
 {
-  print_entity_to_string ((entity_t) entity, (GString *) string);
+  arena_context_t *data = (arena_context_t *) user_data;
+  entity_arena_t *arena = data->arena;
+  arena_open_t open;
+  entity_t entity;
+  int count;
+
+  (void) context;
+  (void) error;
+  if (data->done)
+    return;
+
+  entity = arena_alloc (arena, sizeof (*entity));
+  entity->name = g_string_chunk_insert_const (arena->strings, element_name);
+  entity->text = NULL;
+  entity->attributes = NULL;
+  entity->attribute_array = NULL;
+  entity->entities = NULL;
+  entity->arena = arena;
+  entity->child_index = NULL;
+  entity->child_index_tail = NULL;
+
+  for (count = 0; attribute_names[count] && attribute_values[count]; count++)
+    ;
+  if (count)
+    {
+      int index;
+
+      entity->attribute_array =
+        arena_alloc (arena, (2 * count + 1) * sizeof (gchar *));
+      for (index = 0; index < count; index++)
+        {
+          entity->attribute_array[2 * index] = g_string_chunk_insert_const (
+            arena->strings, attribute_names[index]);
+          entity->attribute_array[2 * index + 1] =
+            g_string_chunk_insert (arena->strings, attribute_values[index]);
+        }
+      entity->attribute_array[2 * count] = NULL;
+    }
+
+  if (data->open->len)
+    {
+      arena_open_t *parent =
+        &g_array_index (data->open, arena_open_t, data->open->len - 1);
+      GSList *node = arena_alloc (arena, sizeof (*node));
+
+      node->data = entity;
+      node->next = NULL;
+      if (parent->tail)
+        parent->tail->next = node;
+      else
+        parent->entity->entities = node;
+      parent->tail = node;
+    }
+  else
+    arena->root = entity;
+
+  /* "Push" the element. */
+  open.entity = entity;
+  open.tail = NULL;
+  g_array_append_val (data->open, open);
 }
 
 /**
- * @brief Print an XML attribute for g_hash_table_foreach to a GString.
+ * @brief Handle the end of an XML element when parsing into an arena.
+ *
+ * @param[in]  context           Parser context.
+ * @param[in]  element_name      XML element name.
+ * @param[in]  user_data         Arena context.
+ * @param[in]  error             Error parameter.
+ */
+static void
+arena_handle_end_element (GMarkupParseContext *context,
+                          const gchar *element_name, gpointer user_data,
+                          GError **error)
+{
+  arena_context_t *data = (arena_context_t *) user_data;
+  entity_t entity;
+
+  (void) context;
+  (void) element_name;
+  (void) error;
+  if (data->done)
+    return;
+
+  /* "Pop" the element. */
+  assert (data->open->len);
+  entity = g_array_index (data->open, arena_open_t, data->open->len - 1).entity;
+  if (entity->text == NULL)
+    entity->text = g_string_chunk_insert_len (data->arena->strings, "", 0);
+  g_array_set_size (data->open, data->open->len - 1);
+  if (data->open->len == 0)
+    data->done = TRUE;
+}
+
+/**
+ * @brief Handle additional text of an XML element when parsing into an arena.
+ *
+ * @param[in]  context           Parser context.
+ * @param[in]  text              The text.
+ * @param[in]  text_len          Length of the text.
+ * @param[in]  user_data         Arena context.
+ * @param[in]  error             Error parameter.
+ */
+static void
+arena_handle_text (GMarkupParseContext *context, const gchar *text,
+                   gsize text_len, gpointer user_data, GError **error)
+{
+  arena_context_t *data = (arena_context_t *) user_data;
+  GStringChunk *strings = data->arena->strings;
+  entity_t current;
+
+  (void) context;
+  (void) error;
+  if (data->done || data->open->len == 0)
+    return;
+
+  current =
+    g_array_index (data->open, arena_open_t, data->open->len - 1).entity;
+  if (current->text)
+    {
+      gchar *joined = g_strconcat (current->text, text, NULL);
+
+      current->text = g_string_chunk_insert (strings, joined);
+      g_free (joined);
+    }
+  else
+    current->text = g_string_chunk_insert_len (strings, text, text_len);
+}
+
+/**
+ * @brief Read an XML entity tree from a string into an arena.
+ *
+ * The tree is like the one from parse_entity, and is read with the same
+ * functions, but the whole tree is in one block allocated arena with the
+ * names interned and the attributes in arrays.  This makes parsing and
+ * freeing large responses cheaper.  The tree must not be modified, and
+ * is freed as a whole by free_entity on the root.
+ *
+ * @param[in]   string  Input string.
+ * @param[out]  entity  Pointer to an entity tree.
+ *
+ * @return 0 success, -2 parse error, -3 XML ended prematurely.
+ */
+int
+parse_entity_arena (const char *string, entity_t *entity)
+{
+  GMarkupParser xml_parser;
+  GError *error = NULL;
+  GMarkupParseContext *xml_context;
+  arena_context_t context_data;
+  int ret;
+
+  /* Create the XML parser. */
+
+  xml_parser.start_element = arena_handle_start_element;
+  xml_parser.end_element = arena_handle_end_element;
+  xml_parser.text = arena_handle_text;
+  xml_parser.passthrough = NULL;
+  xml_parser.error = handle_error;
+
+  context_data.arena = g_malloc0 (sizeof (*context_data.arena));
+  context_data.arena->strings = g_string_chunk_new (ARENA_BLOCK_SIZE);
+  context_data.open = g_array_new (FALSE, FALSE, sizeof (arena_open_t));
+  context_data.done = FALSE;
+
+  /* Setup the XML context. */
+
+  xml_context =
+    g_markup_parse_context_new (&xml_parser, 0, &context_data, NULL);
+
+  /* Parse the string. */
+
+  ret = -3;
+  g_markup_parse_context_parse (xml_context, string, strlen (string), &error);
+  if (error)
+    {
+      g_error_free (error);
+      ret = -2;
+    }
+  else if (context_data.done)
+    {
+      g_markup_parse_context_end_parse (xml_context, &error);
+      if (error)
+        {
+          g_warning ("   End error: %s\n", error->message);
+          g_error_free (error);
+          ret = -2;
+        }
+      else
+        ret = 0;
+    }
+
+  g_markup_parse_context_free (xml_context);
+  g_array_free (context_data.open, TRUE);
+  if (ret)
+    arena_free (context_data.arena);
+  else
+    *entity = context_data.arena->root;
+  return ret;
+}
+
+/**
+ * @brief Whether a byte may need escaping, for the scalar scan.
+ *
+ * The markup characters, the control characters and the bytes starting
+ * the escaped C1 control characters.
+ *
+ * @param[in]  c  Byte.
+ */
+#define XML_SPECIAL_BYTE(c)                                               \
+  ((c) < 0x20 || (c) == '<' || (c) == '>' || (c) == '&' || (c) == '\'' \
+   || (c) == '"' || (c) == 0x7f || (c) == 0xc2)
+
+/**
+ * @brief Get the length of the start of a text without special bytes.
+ *
+ * @param[in]  text  Text.
+ * @param[in]  len   Length of the text.
+ *
+ * @return Number of bytes before the first byte that may need escaping.
+ */
+static gsize
+xml_clean_run (const guchar *text, gsize len)
+{
+  gsize index = 0;
+
+#if defined(__SSE2__)
+  const __m128i lt = _mm_set1_epi8 ('<'), gt = _mm_set1_epi8 ('>');
+  const __m128i amp = _mm_set1_epi8 ('&'), apos = _mm_set1_epi8 ('\'');
+  const __m128i quot = _mm_set1_epi8 ('"'), del = _mm_set1_epi8 (0x7f);
+  const __m128i c1 = _mm_set1_epi8 ((char) 0xc2);
+  const __m128i control = _mm_set1_epi8 (0x1f);
+
+  for (; index + 16 <= len; index += 16)
+    {
+      __m128i chunk = _mm_loadu_si128 ((const __m128i *) (text + index));
+      __m128i special;
+      int mask;
+
+      special = _mm_or_si128 (_mm_cmpeq_epi8 (chunk, lt),
+                              _mm_cmpeq_epi8 (chunk, gt));
+      special = _mm_or_si128 (special, _mm_cmpeq_epi8 (chunk, amp));
+      special = _mm_or_si128 (special, _mm_cmpeq_epi8 (chunk, apos));
+      special = _mm_or_si128 (special, _mm_cmpeq_epi8 (chunk, quot));
+      special = _mm_or_si128 (special, _mm_cmpeq_epi8 (chunk, del));
+      special = _mm_or_si128 (special, _mm_cmpeq_epi8 (chunk, c1));
+      /* Below 0x20 when the unsigned minimum with 0x1f is the byte. */
+      special = _mm_or_si128 (
+        special, _mm_cmpeq_epi8 (_mm_min_epu8 (chunk, control), chunk));
+      mask = _mm_movemask_epi8 (special);
+      if (mask)
+        return index + __builtin_ctz (mask);
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  for (; index + 16 <= len; index += 16)
+    {
+      uint8x16_t chunk = vld1q_u8 (text + index);
+      uint8x16_t special;
+
+      special = vorrq_u8 (vceqq_u8 (chunk, vdupq_n_u8 ('<')),
+                          vceqq_u8 (chunk, vdupq_n_u8 ('>')));
+      special = vorrq_u8 (special, vceqq_u8 (chunk, vdupq_n_u8 ('&')));
+      special = vorrq_u8 (special, vceqq_u8 (chunk, vdupq_n_u8 ('\'')));
+      special = vorrq_u8 (special, vceqq_u8 (chunk, vdupq_n_u8 ('"')));
+      special = vorrq_u8 (special, vceqq_u8 (chunk, vdupq_n_u8 (0x7f)));
+      special = vorrq_u8 (special, vceqq_u8 (chunk, vdupq_n_u8 (0xc2)));
+      special = vorrq_u8 (special, vcltq_u8 (chunk, vdupq_n_u8 (0x20)));
+      if (vmaxvq_u8 (special))
+        break;
+    }
+#endif
+
+  for (; index < len; index++)
+    if (XML_SPECIAL_BYTE (text[index]))
+      break;
+  return index;
+}
+
+/**
+ * @brief Append text to a string, escaped for XML.
+ *
+ * Escapes like g_markup_escape_text, but appends directly to the string,
+ * scanning for the characters to escape many bytes at a time and copying
+ * the runs between them in bulk.
+ *
+ * @param[in]  string  String.
+ * @param[in]  text    Text, UTF-8.
+ * @param[in]  len     Length of the text, or -1 if NUL terminated.
+ */
+void
+xml_string_append_escaped (GString *string, const char *text, gssize len)
+{
+  const guchar *next, *end;
+
+  if (text == NULL)
+    return;
+  if (len < 0)
+    len = strlen (text);
+
+  next = (const guchar *) text;
+  end = next + len;
+  while (next < end)
+    {
+      gsize run = xml_clean_run (next, end - next);
+
+      g_string_append_len (string, (const char *) next, run);
+      next += run;
+      if (next == end)
+        break;
+
+      switch (*next)
+        {
+        case '<':
+          g_string_append_len (string, "&lt;", 4);
+          break;
+        case '>':
+          g_string_append_len (string, "&gt;", 4);
+          break;
+        case '&':
+          g_string_append_len (string, "&amp;", 5);
+          break;
+        case '\'':
+          g_string_append_len (string, "&apos;", 6);
+          break;
+        case '"':
+          g_string_append_len (string, "&quot;", 6);
+          break;
+        case '\t':
+        case '\n':
+        case '\r':
+          g_string_append_c (string, *next);
+          break;
+        case 0xc2:
+          /* U+0080 to U+009F, except U+0085, are escaped. */
+          if (next + 1 < end && next[1] >= 0x80 && next[1] <= 0x9f
+              && next[1] != 0x85)
+            {
+              g_string_append_printf (string, "&#x%x;", next[1]);
+              next++;
+            }
+          else
+            g_string_append_c (string, *next);
+          break;
+        case 0:
+          g_string_append_c (string, *next);
+          break;
+        default:
+          g_string_append_printf (string, "&#x%x;", *next);
+          break;
+        }
+      next++;
+    }
+}
+
+/**
+ * @brief Estimate the size of an XML entity tree printed to a string.
+ *
+ * @param[in]  entity  Entity tree.
+ *
+ * @return Size of the tree without escaping.
+ */
+static gsize
+entity_string_size (entity_t entity)
+{
+  gsize size;
+  const gchar **attribute;
+  GSList *list;
+
+  size = 2 * strlen (entity->name) + 5 + strlen (entity->text);
+  if (entity->attributes)
+    size += 16 * g_hash_table_size (entity->attributes);
+  if (entity->attribute_array)
+    for (attribute = entity->attribute_array; *attribute; attribute += 2)
+      size += strlen (attribute[0]) + strlen (attribute[1]) + 4;
+  for (list = entity->entities; list; list = list->next)
+    size += entity_string_size (list->data);
+  return size;
+}
+
+/**
+ * @brief Print an XML attribute for foreach_entity_attribute to a GString.
  *
  * @param[in]  name    The attribute name.
  * @param[in]  value   The attribute value.
@@ -1594,34 +3046,54 @@ static void
 foreach_print_attribute_to_string (gpointer name, gpointer value,
                                    gpointer string)
 {
-  gchar *text_escaped;
-  text_escaped = g_markup_escape_text ((gchar *) value, -1);
-  g_string_append_printf ((GString *) string, " %s=\"%s\"", (char *) name,
-                          text_escaped);
-  g_free (text_escaped);
+  g_string_append_c ((GString *) string, ' ');
+  g_string_append ((GString *) string, (char *) name);
+  g_string_append_len ((GString *) string, "=\"", 2);
+  xml_string_append_escaped ((GString *) string, (char *) value, -1);
+  g_string_append_c ((GString *) string, '"');
+}
+
+/**
+ * @brief Print an XML entity tree to a GString, without reserving space.
+ *
+ * @param[in]      entity  Entity tree to print to string.
+ * @param[in,out]  string  String to write to.
+ */
+static void
+append_entity_to_string (entity_t entity, GString *string)
+{
+  GSList *list;
+
+  g_string_append_c (string, '<');
+  g_string_append (string, entity->name);
+  foreach_entity_attribute (entity, foreach_print_attribute_to_string, string);
+  g_string_append_c (string, '>');
+  xml_string_append_escaped (string, entity->text, -1);
+  for (list = entity->entities; list; list = list->next)
+    append_entity_to_string (list->data, string);
+  g_string_append_len (string, "</", 2);
+  g_string_append (string, entity->name);
+  g_string_append_c (string, '>');
 }
 
 /**
  * @brief Print an XML entity tree to a GString, appending it if string is not
  * @brief empty.
  *
+ * Grows the string once for the whole tree beforehand.
+ *
  * @param[in]      entity  Entity tree to print to string.
  * @param[in,out]  string  String to write to.
  */
 void
 print_entity_to_string (entity_t entity, GString *string)
 {
-  gchar *text_escaped = NULL;
-  g_string_append_printf (string, "<%s", entity->name);
-  if (entity->attributes && g_hash_table_size (entity->attributes))
-    g_hash_table_foreach (entity->attributes, foreach_print_attribute_to_string,
-                          string);
-  g_string_append_printf (string, ">");
-  text_escaped = g_markup_escape_text (entity->text, -1);
-  g_string_append_printf (string, "%s", text_escaped);
-  g_free (text_escaped);
-  g_slist_foreach (entity->entities, foreach_print_entity_to_string, string);
-  g_string_append_printf (string, "</%s>", entity->name);
+  gsize len = string->len;
+
+  /* Setting the size allocates, truncating keeps the allocation. */
+  g_string_set_size (string, len + entity_string_size (entity));
+  g_string_truncate (string, len);
+  append_entity_to_string (entity, string);
 }
 
 /**
@@ -1660,8 +3132,7 @@ print_entity (FILE *stream, entity_t entity)
 {
   gchar *text_escaped = NULL;
   fprintf (stream, "<%s", entity->name);
-  if (entity->attributes && g_hash_table_size (entity->attributes))
-    g_hash_table_foreach (entity->attributes, foreach_print_attribute, stream);
+  foreach_entity_attribute (entity, foreach_print_attribute, stream);
   fprintf (stream, ">");
   text_escaped = g_markup_escape_text (entity->text, -1);
   fprintf (stream, "%s", text_escaped);
@@ -1709,9 +3180,7 @@ print_entity_format (entity_t entity, gpointer indent)
     printf ("  ");
 
   printf ("<%s", entity->name);
-  if (entity->attributes && g_hash_table_size (entity->attributes))
-    g_hash_table_foreach (entity->attributes, foreach_print_attribute_format,
-                          indent);
+  foreach_entity_attribute (entity, foreach_print_attribute_format, indent);
   printf (">");
 
   text_escaped = g_markup_escape_text (entity->text, -1);
@@ -1731,22 +3200,27 @@ print_entity_format (entity_t entity, gpointer indent)
 }
 
 /**
- * @brief Look for a key-value pair in a hash table.
- *
- * @param[in]  key          Key.
- * @param[in]  value        Value.
- * @param[in]  attributes2  The hash table.
+ * @brief Look for an attribute of one entity in another, for
+ * @brief foreach_entity_attribute.
  *
- * @return FALSE if found, TRUE otherwise.
+ * @param[in]  key      Attribute name.
+ * @param[in]  value    Attribute value.
+ * @param[in]  compare  Other entity and whether a compare failed, as an
+ *                      array of two pointers.
  */
-static gboolean
-compare_find_attribute (gpointer key, gpointer value, gpointer attributes2)
+static void
+compare_find_attribute (gpointer key, gpointer value, gpointer compare)
 {
-  gchar *value2 = g_hash_table_lookup (attributes2, key);
+  gpointer *other = compare;
+  const char *value2;
+
+  if (other[1])
+    return;
+  value2 = entity_attribute ((entity_t) other[0], key);
   if (value2 && strcmp (value, value2) == 0)
-    return FALSE;
+    return;
   g_debug ("  compare failed attribute: %s\n", (char *) value);
-  return TRUE;
+  other[1] = GINT_TO_POINTER (1);
 }
 
 /**
@@ -1778,17 +3252,19 @@ compare_entities (entity_t entity1, entity_t entity2)
       return 1;
     }
 
-  if (entity1->attributes == NULL)
+  if (entity1->attributes == NULL && entity1->attribute_array == NULL)
     {
-      if (entity2->attributes)
+      if (entity2->attributes || entity2->attribute_array)
         return 1;
     }
   else
     {
-      if (entity2->attributes == NULL)
+      gpointer compare[2] = {entity2, NULL};
+
+      if (entity2->attributes == NULL && entity2->attribute_array == NULL)
         return 1;
-      if (g_hash_table_find (entity1->attributes, compare_find_attribute,
-                             (gpointer) entity2->attributes))
+      foreach_entity_attribute (entity1, compare_find_attribute, compare);
+      if (compare[1])
         {
           g_debug ("  compare failed attributes\n");
           return 1;
@@ -1854,131 +3330,653 @@ xml_string_append (GString *xml, const char *format, ...)
   g_free (piece);
 }
 
-/* XML file utilities */
-
+/* XML file utilities */
+
+/**
+ * @brief Handle the opening tag of an element in an XML search.
+ *
+ * @param[in]   ctx               The parse context.
+ * @param[in]   element_name      The name of the element.
+ * @param[in]   attribute_names   NULL-terminated array of attribute names.
+ * @param[in]   attribute_values  NULL-terminated array of attribute values.
+ * @param[in]   data              The search data struct.
+ * @param[out]  error             Pointer to error output location.
+ */
+static void
+xml_search_handle_start_element (GMarkupParseContext *ctx,
+                                 const gchar *element_name,
+                                 const gchar **attribute_names,
+                                 const gchar **attribute_values, gpointer data,
+                                 GError **error)
+{
+  (void) ctx;
+  (void) error;
+
+  xml_search_data_t *search_data = ((xml_search_data_t *) data);
+
+  if (strcmp (element_name, search_data->find_element) == 0
+      && search_data->found == 0)
+    {
+      g_debug ("%s: Found element <%s>", __func__, element_name);
+
+      if (search_data->find_attributes
+          && g_hash_table_size (search_data->find_attributes))
+        {
+          int index;
+          GHashTable *found_attributes;
+          found_attributes =
+            g_hash_table_new_full (g_str_hash, g_str_equal, NULL, NULL);
+          index = 0;
+          while (attribute_names[index])
+            {
+              gchar *searched_value;
+              searched_value = g_hash_table_lookup (
+                search_data->find_attributes, attribute_names[index]);
+              if (searched_value
+                  && strcmp (searched_value, attribute_values[index]) == 0)
+                {
+                  g_debug ("%s: Found attribute %s=\"%s\"", __func__,
+                           attribute_names[index], searched_value);
+                  g_hash_table_add (found_attributes, searched_value);
+                }
+              index++;
+            }
+          g_debug ("%s: Found %d of %d attributes", __func__,
+                   g_hash_table_size (found_attributes),
+                   g_hash_table_size (search_data->find_attributes));
+
+          if (g_hash_table_size (found_attributes)
+              == g_hash_table_size (search_data->find_attributes))
+            {
+              search_data->found = 1;
+            }
+
+          g_hash_table_destroy (found_attributes);
+        }
+      else
+        {
+          search_data->found = 1;
+        }
+    }
+}
+
+/**
+ * @brief Size of the chunks in which an XML file is searched.
+ *
+ * Parsing stops at the end of the chunk in which the element is found.
+ */
+#define XML_FILE_BUFFER_SIZE 65536
+
+/**
+ * @brief Map a regular XML file into memory.
+ *
+ * @param[in]   file_path  Path of the XML file.
+ * @param[out]  st         Status of the file.
+ * @param[out]  map        Contents of the file, NULL if not mapped.  To
+ *                         unmap with munmap.
+ *
+ * @return File descriptor, to close, -1 if the file could not be opened.
+ */
+static int
+xml_file_map (const gchar *file_path, struct stat *st, const char **map)
+{
+  int fd;
+
+  *map = NULL;
+  fd = open (file_path, O_RDONLY);
+  if (fd < 0)
+    return -1;
+  if (fstat (fd, st) == 0 && S_ISREG (st->st_mode) && st->st_size > 0)
+    {
+      void *addr = mmap (NULL, st->st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+      if (addr != MAP_FAILED)
+        *map = addr;
+    }
+  return fd;
+}
+
+/**
+ * @brief Tests if an XML file contains an element with given attributes.
+ *
+ * Regular files are mapped into memory, and parsing stops soon after the
+ * first match.
+ *
+ * @param[in]   file_path         Path of the XML file.
+ * @param[in]   find_element      Name of the element to find.
+ * @param[in]   find_attributes   GHashTable of attributes to find.
+ *
+ * @return  1 if element was found, 0 if not.
+ */
+int
+find_element_in_xml_file (gchar *file_path, gchar *find_element,
+                          GHashTable *find_attributes)
+{
+  struct stat st;
+  const char *map;
+  int fd;
+  gsize offset;
+  GMarkupParser xml_parser;
+  GMarkupParseContext *xml_context;
+  xml_search_data_t search_data;
+  GError *error = NULL;
+
+  search_data.find_element = find_element;
+  search_data.find_attributes = find_attributes;
+  search_data.found = 0;
+
+  /* Create the XML parser. */
+  xml_parser.start_element = xml_search_handle_start_element;
+  xml_parser.end_element = NULL;
+  xml_parser.text = NULL;
+  xml_parser.passthrough = NULL;
+  xml_parser.error = NULL;
+  xml_context = g_markup_parse_context_new (&xml_parser, 0, &search_data, NULL);
+
+  fd = xml_file_map (file_path, &st, &map);
+  if (fd < 0)
+    {
+      g_markup_parse_context_free (xml_context);
+      g_warning ("%s: Failed to open '%s':", __func__, strerror (errno));
+      return 0;
+    }
+
+  if (map)
+    {
+      madvise ((void *) map, st.st_size, MADV_SEQUENTIAL);
+      for (offset = 0; offset < (gsize) st.st_size && !search_data.found;
+           offset += XML_FILE_BUFFER_SIZE)
+        if (!g_markup_parse_context_parse (
+              xml_context, map + offset,
+              MIN (XML_FILE_BUFFER_SIZE, st.st_size - offset), &error))
+          break;
+      munmap ((void *) map, st.st_size);
+    }
+  else
+    {
+      gchar *buffer = g_malloc (XML_FILE_BUFFER_SIZE);
+      ssize_t read_len;
+
+      while (!search_data.found
+             && (read_len = read (fd, buffer, XML_FILE_BUFFER_SIZE)) > 0
+             && g_markup_parse_context_parse (xml_context, buffer, read_len,
+                                              &error))
+        {
+        }
+      g_free (buffer);
+    }
+  if (!search_data.found && error == NULL)
+    g_markup_parse_context_end_parse (xml_context, &error);
+  g_clear_error (&error);
+
+  close (fd);
+
+  g_markup_parse_context_free (xml_context);
+  return search_data.found;
+}
+#undef XML_FILE_BUFFER_SIZE
+
+/**
+ * @brief Version of the format of XML index files.
+ */
+#define XML_INDEX_VERSION 1
+
+/**
+ * @brief Index of the elements with a given name of an XML file.
+ */
+typedef struct
+{
+  gchar *element; /**< Name of the indexed elements. */
+  gint64 size;    /**< Size of the XML file. */
+  gint64 mtime;   /**< Modification time of the XML file, in nanoseconds. */
+  gint64 first;   /**< Offset of the first element, -1 if none. */
+  GHashTable *offsets; /**< Offsets of the elements, as GArrays of gint64,
+                            by "name=value" of each of their attributes. */
+} xml_index_t;
+
+/**
+ * @brief Indexes of XML files, by index file path.
+ */
+static GHashTable *xml_index_cache = NULL;
+
+/**
+ * @brief Lock for xml_index_cache.
+ */
+static GMutex xml_index_cache_lock;
+
+/**
+ * @brief Free an XML index.
+ *
+ * @param[in]  data  The index.
+ */
+static void
+xml_index_free (gpointer data)
+{
+  xml_index_t *index = data;
+
+  if (index == NULL)
+    return;
+  g_free (index->element);
+  g_hash_table_destroy (index->offsets);
+  g_free (index);
+}
+
+/**
+ * @brief Create an empty XML index.
+ *
+ * @param[in]  element  Name of the elements to index.
+ * @param[in]  st       Status of the XML file.
+ *
+ * @return The index.  Free with xml_index_free.
+ */
+static xml_index_t *
+xml_index_new (const gchar *element, const struct stat *st)
+{
+  xml_index_t *index = g_malloc0 (sizeof (*index));
+
+  index->element = g_strdup (element);
+  index->size = st->st_size;
+  index->mtime = (gint64) st->st_mtim.tv_sec * G_GINT64_CONSTANT (1000000000)
+                 + st->st_mtim.tv_nsec;
+  index->first = -1;
+  index->offsets = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                          (GDestroyNotify) g_array_unref);
+  return index;
+}
+
+/**
+ * @brief Add an attribute of an element to an XML index.
+ *
+ * @param[in]  index   The index.
+ * @param[in]  name    Name of the attribute.
+ * @param[in]  value   Value of the attribute.
+ * @param[in]  offset  Offset of the element in the XML file.
+ */
+static void
+xml_index_add (xml_index_t *index, const gchar *name, const gchar *value,
+               gint64 offset)
+{
+  gchar *key = g_strdup_printf ("%s=%s", name, value);
+  GArray *offsets = g_hash_table_lookup (index->offsets, key);
+
+  if (offsets == NULL)
+    {
+      offsets = g_array_new (FALSE, FALSE, sizeof (gint64));
+      g_hash_table_insert (index->offsets, key, offsets);
+    }
+  else
+    g_free (key);
+  g_array_append_val (offsets, offset);
+}
+
+/**
+ * @brief Data for building an XML index.
+ */
+typedef struct
+{
+  xml_index_t *index; /**< The index being built. */
+  gint64 offset;      /**< Offset of the piece of the file being parsed. */
+} xml_index_build_t;
+
+/**
+ * @brief Handle the opening tag of an element while building an XML index.
+ *
+ * @param[in]   ctx               The parse context.
+ * @param[in]   element_name      The name of the element.
+ * @param[in]   attribute_names   NULL-terminated array of attribute names.
+ * @param[in]   attribute_values  NULL-terminated array of attribute values.
+ * @param[in]   data              The build data struct.
+ * @param[out]  error             Pointer to error output location.
+ */
+static void
+xml_index_handle_start_element (GMarkupParseContext *ctx,
+                                const gchar *element_name,
+                                const gchar **attribute_names,
+                                const gchar **attribute_values, gpointer data,
+                                GError **error)
+{
+  xml_index_build_t *build = data;
+  int i;
+
+  (void) ctx;
+  (void) error;
+
+  if (strcmp (element_name, build->index->element))
+    return;
+  if (build->index->first < 0)
+    build->index->first = build->offset;
+  for (i = 0; attribute_names[i]; i++)
+    xml_index_add (build->index, attribute_names[i], attribute_values[i],
+                   build->offset);
+}
+
+/**
+ * @brief Build the index of the elements with a given name of an XML file.
+ *
+ * The file is parsed in pieces which each start at a '<'.  Attribute values
+ * cannot contain a '<', so an element is reported while the piece starting
+ * with its opening tag is parsed, which gives the offset of the element.
+ *
+ * @param[in]  map      Contents of the XML file.
+ * @param[in]  st       Status of the XML file.
+ * @param[in]  element  Name of the elements to index.
+ *
+ * @return The index, NULL if the file could not be parsed.
+ */
+static xml_index_t *
+xml_index_build (const char *map, const struct stat *st, const gchar *element)
+{
+  GMarkupParser xml_parser = {xml_index_handle_start_element, NULL, NULL,
+                              NULL, NULL};
+  GMarkupParseContext *xml_context;
+  xml_index_build_t build;
+  const char *start, *end = map + st->st_size;
+  GError *error = NULL;
+
+  build.index = xml_index_new (element, st);
+  xml_context = g_markup_parse_context_new (&xml_parser, 0, &build, NULL);
+  for (start = map; start < end && error == NULL;)
+    {
+      const char *next = memchr (start + 1, '<', end - start - 1);
+
+      if (next == NULL)
+        next = end;
+      build.offset = start - map;
+      g_markup_parse_context_parse (xml_context, start, next - start, &error);
+      start = next;
+    }
+  if (error == NULL)
+    g_markup_parse_context_end_parse (xml_context, &error);
+  g_markup_parse_context_free (xml_context);
+  if (error)
+    {
+      g_warning ("%s: Failed to parse XML file: %s", __func__,
+                 error->message);
+      g_error_free (error);
+      xml_index_free (build.index);
+      return NULL;
+    }
+  return build.index;
+}
+
+/**
+ * @brief Append an attribute entry of an XML index to an index file.
+ *
+ * @param[in]  key    "name=value" of the attribute.
+ * @param[in]  value  Offsets of the elements.
+ * @param[in]  data   GString of the index file.
+ */
+static void
+xml_index_save_entry (gpointer key, gpointer value, gpointer data)
+{
+  GArray *offsets = value;
+  gchar *escaped = g_strescape (key, NULL);
+  guint i;
+
+  g_string_append (data, escaped);
+  for (i = 0; i < offsets->len; i++)
+    g_string_append_printf (data, "\t%" G_GINT64_FORMAT,
+                            g_array_index (offsets, gint64, i));
+  g_string_append_c (data, '\n');
+  g_free (escaped);
+}
+
+/**
+ * @brief Write an XML index to an index file.
+ *
+ * The file has a header line with the version, the size and modification
+ * time of the XML file, the offset of the first element and its name,
+ * followed by a line per attribute "name=value", escaped, with the offsets
+ * of the elements separated by tabs.
+ *
+ * @param[in]  index       The index.
+ * @param[in]  index_path  Path of the index file.
+ */
+static void
+xml_index_save (xml_index_t *index, const gchar *index_path)
+{
+  GString *data;
+  GError *error = NULL;
+
+  data = g_string_new (NULL);
+  g_string_append_printf (data,
+                          "%d %" G_GINT64_FORMAT " %" G_GINT64_FORMAT
+                          " %" G_GINT64_FORMAT " %s\n",
+                          XML_INDEX_VERSION, index->size, index->mtime,
+                          index->first, index->element);
+  g_hash_table_foreach (index->offsets, xml_index_save_entry, data);
+  if (!g_file_set_contents (index_path, data->str, data->len, &error))
+    {
+      g_debug ("%s: Failed to write '%s': %s", __func__, index_path,
+               error->message);
+      g_error_free (error);
+    }
+  g_string_free (data, TRUE);
+}
+
 /**
- * @brief Handle the opening tag of an element in an XML search.
+ * @brief Read an XML index from an index file.
  *
- * @param[in]   ctx               The parse context.
- * @param[in]   element_name      The name of the element.
- * @param[in]   attribute_names   NULL-terminated array of attribute names.
- * @param[in]   attribute_values  NULL-terminated array of attribute values.
- * @param[in]   data              The search data struct.
- * @param[out]  error             Pointer to error output location.
+ * @param[in]  index_path  Path of the index file.
+ * @param[in]  element     Name of the indexed elements.
+ * @param[in]  st          Status of the XML file.
+ *
+ * @return The index, NULL if missing, invalid or out of date.
  */
-static void
-xml_search_handle_start_element (GMarkupParseContext *ctx,
-                                 const gchar *element_name,
-                                 const gchar **attribute_names,
-                                 const gchar **attribute_values, gpointer data,
-                                 GError **error)
+static xml_index_t *
+xml_index_load (const gchar *index_path, const gchar *element,
+                const struct stat *st)
 {
-  (void) ctx;
-  (void) error;
-
-  xml_search_data_t *search_data = ((xml_search_data_t *) data);
+  gchar *contents, **lines, **line;
+  xml_index_t *index;
+  gint64 size, mtime, first;
+  int version, name_start = 0;
 
-  if (strcmp (element_name, search_data->find_element) == 0
-      && search_data->found == 0)
+  if (!g_file_get_contents (index_path, &contents, NULL, NULL))
+    return NULL;
+  lines = g_strsplit (contents, "\n", -1);
+  g_free (contents);
+
+  index = xml_index_new (element, st);
+  if (sscanf (lines[0],
+              "%d %" G_GINT64_FORMAT " %" G_GINT64_FORMAT " %" G_GINT64_FORMAT
+              " %n",
+              &version, &size, &mtime, &first, &name_start)
+        != 4
+      || name_start == 0 || version != XML_INDEX_VERSION
+      || size != index->size || mtime != index->mtime
+      || strcmp (lines[0] + name_start, element))
     {
-      g_debug ("%s: Found element <%s>", __func__, element_name);
+      g_strfreev (lines);
+      xml_index_free (index);
+      return NULL;
+    }
+  index->first = first;
 
-      if (search_data->find_attributes
-          && g_hash_table_size (search_data->find_attributes))
+  for (line = lines + 1; *line; line++)
+    {
+      gchar **fields, *key;
+      GArray *offsets;
+      int i;
+
+      if (**line == '\0')
+        continue;
+      fields = g_strsplit (*line, "\t", -1);
+      key = g_strcompress (fields[0]);
+      offsets = g_array_new (FALSE, FALSE, sizeof (gint64));
+      for (i = 1; fields[i]; i++)
         {
-          int index;
-          GHashTable *found_attributes;
-          found_attributes =
-            g_hash_table_new_full (g_str_hash, g_str_equal, NULL, NULL);
-          index = 0;
-          while (attribute_names[index])
-            {
-              gchar *searched_value;
-              searched_value = g_hash_table_lookup (
-                search_data->find_attributes, attribute_names[index]);
-              if (searched_value
-                  && strcmp (searched_value, attribute_values[index]) == 0)
-                {
-                  g_debug ("%s: Found attribute %s=\"%s\"", __func__,
-                           attribute_names[index], searched_value);
-                  g_hash_table_add (found_attributes, searched_value);
-                }
-              index++;
-            }
-          g_debug ("%s: Found %d of %d attributes", __func__,
-                   g_hash_table_size (found_attributes),
-                   g_hash_table_size (search_data->find_attributes));
-
-          if (g_hash_table_size (found_attributes)
-              == g_hash_table_size (search_data->find_attributes))
-            {
-              search_data->found = 1;
-            }
+          gint64 offset = g_ascii_strtoll (fields[i], NULL, 10);
 
-          g_hash_table_destroy (found_attributes);
-        }
-      else
-        {
-          search_data->found = 1;
+          g_array_append_val (offsets, offset);
         }
+      g_hash_table_insert (index->offsets, key, offsets);
+      g_strfreev (fields);
     }
+  g_strfreev (lines);
+  return index;
 }
 
-#define XML_FILE_BUFFER_SIZE 1048576
-int
 /**
- * @brief Tests if an XML file contains an element with given attributes.
+ * @brief Tests if the element at an offset of an XML file has given
+ * attributes.
+ *
+ * Parses only the opening tag of the element.
+ *
+ * @param[in]  map          Contents of the XML file.
+ * @param[in]  size         Size of the XML file.
+ * @param[in]  offset       Offset of the element.
+ * @param[in]  search_data  The search data struct.
+ *
+ * @return 1 if the element matches, 0 if not.
+ */
+static int
+xml_index_check (const char *map, gsize size, gint64 offset,
+                 xml_search_data_t *search_data)
+{
+  GMarkupParser xml_parser = {xml_search_handle_start_element, NULL, NULL,
+                              NULL, NULL};
+  GMarkupParseContext *xml_context;
+  const char *end;
+
+  if (offset < 0 || (gsize) offset >= size || map[offset] != '<')
+    return 0;
+  end = memchr (map + offset + 1, '<', size - offset - 1);
+  if (end == NULL)
+    end = map + size;
+
+  search_data->found = 0;
+  xml_context = g_markup_parse_context_new (&xml_parser, 0, search_data, NULL);
+  g_markup_parse_context_parse (xml_context, map + offset,
+                                end - (map + offset), NULL);
+  g_markup_parse_context_free (xml_context);
+  return search_data->found;
+}
+
+/**
+ * @brief Tests if an XML file contains an element with given attributes,
+ * using an index of the file.
+ *
+ * The index maps each attribute of the elements named find_element to the
+ * offsets of these elements in the file, so that a lookup only parses the
+ * opening tags of the candidate elements.  It is kept in memory and in an
+ * index file, and rebuilt when the size or modification time of the XML
+ * file changes, or when searching for elements with another name.
  *
  * @param[in]   file_path         Path of the XML file.
  * @param[in]   find_element      Name of the element to find.
  * @param[in]   find_attributes   GHashTable of attributes to find.
+ * @param[in]   index_path        Path of the index file, NULL for the path
+ *                                of the XML file followed by ".index".
  *
  * @return  1 if element was found, 0 if not.
  */
-find_element_in_xml_file (gchar *file_path, gchar *find_element,
-                          GHashTable *find_attributes)
+int
+find_element_in_xml_file_indexed (const gchar *file_path,
+                                  const gchar *find_element,
+                                  GHashTable *find_attributes,
+                                  const gchar *index_path)
 {
-  gchar buffer[XML_FILE_BUFFER_SIZE];
-  FILE *file;
-  int read_len;
-  GMarkupParser xml_parser;
-  GMarkupParseContext *xml_context;
+  struct stat st;
+  const char *map;
+  gchar *default_path = NULL;
+  xml_index_t *index;
   xml_search_data_t search_data;
-  GError *error = NULL;
-
-  search_data.find_element = find_element;
-  search_data.find_attributes = find_attributes;
-  search_data.found = 0;
+  int fd, found = 0;
 
-  /* Create the XML parser. */
-  xml_parser.start_element = xml_search_handle_start_element;
-  xml_parser.end_element = NULL;
-  xml_parser.text = NULL;
-  xml_parser.passthrough = NULL;
-  xml_parser.error = NULL;
-  xml_context = g_markup_parse_context_new (&xml_parser, 0, &search_data, NULL);
+  if (file_path == NULL || find_element == NULL)
+    return 0;
 
-  file = fopen (file_path, "r");
-  if (file == NULL)
+  fd = xml_file_map (file_path, &st, &map);
+  if (fd < 0)
     {
-      g_markup_parse_context_free (xml_context);
       g_warning ("%s: Failed to open '%s':", __func__, strerror (errno));
       return 0;
     }
+  if (map == NULL)
+    {
+      close (fd);
+      return find_element_in_xml_file ((gchar *) file_path,
+                                       (gchar *) find_element,
+                                       find_attributes);
+    }
+  if (index_path == NULL)
+    index_path = default_path = g_strdup_printf ("%s.index", file_path);
+
+  g_mutex_lock (&xml_index_cache_lock);
+  if (xml_index_cache == NULL)
+    xml_index_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                             xml_index_free);
+  index = g_hash_table_lookup (xml_index_cache, index_path);
+  if (index == NULL || index->size != st.st_size
+      || index->mtime
+           != (gint64) st.st_mtim.tv_sec * G_GINT64_CONSTANT (1000000000)
+                + st.st_mtim.tv_nsec
+      || strcmp (index->element, find_element))
+    {
+      index = xml_index_load (index_path, find_element, &st);
+      if (index == NULL)
+        {
+          index = xml_index_build (map, &st, find_element);
+          if (index)
+            xml_index_save (index, index_path);
+        }
+      if (index)
+        g_hash_table_insert (xml_index_cache, g_strdup (index_path), index);
+      else
+        g_hash_table_remove (xml_index_cache, index_path);
+    }
 
-  while ((read_len = fread (&buffer, sizeof (char), XML_FILE_BUFFER_SIZE, file))
-         && g_markup_parse_context_parse (xml_context, buffer, read_len, &error)
-         && error == NULL)
+  search_data.find_element = (gchar *) find_element;
+  search_data.find_attributes = find_attributes;
+  if (index == NULL)
+    found = 0;
+  else if (find_attributes == NULL || g_hash_table_size (find_attributes) == 0)
+    found = index->first >= 0;
+  else
     {
+      GHashTableIter iter;
+      gpointer name, value;
+      GArray *offsets;
+      gchar *key;
+      guint i;
+
+      /* Any attribute narrows down the candidates, which are checked for
+       * all the attributes. */
+      g_hash_table_iter_init (&iter, find_attributes);
+      g_hash_table_iter_next (&iter, &name, &value);
+      key = g_strdup_printf ("%s=%s", (gchar *) name, (gchar *) value);
+      offsets = g_hash_table_lookup (index->offsets, key);
+      g_free (key);
+      for (i = 0; offsets && i < offsets->len && !found; i++)
+        found = xml_index_check (map, st.st_size,
+                                 g_array_index (offsets, gint64, i),
+                                 &search_data);
     }
-  g_markup_parse_context_end_parse (xml_context, &error);
+  g_mutex_unlock (&xml_index_cache_lock);
 
-  fclose (file);
+  munmap ((void *) map, st.st_size);
+  close (fd);
+  g_free (default_path);
+  return found;
+}
 
-  g_markup_parse_context_free (xml_context);
-  return search_data.found;
+/**
+ * @brief Free the indexes of XML files kept in memory.
+ *
+ * The index files are kept.
+ */
+void
+xml_file_index_cache_clear (void)
+{
+  g_mutex_lock (&xml_index_cache_lock);
+  if (xml_index_cache)
+    {
+      g_hash_table_destroy (xml_index_cache);
+      xml_index_cache = NULL;
+    }
+  g_mutex_unlock (&xml_index_cache_lock);
 }
-#undef XML_FILE_BUFFER_SIZE
 
 /* The new faster parser that uses libxml2. */
 
@@ -2275,12 +4273,10 @@ element_to_string (element_t element)
 void
 print_element_to_string (element_t element, GString *string)
 {
-  gchar *text_escaped, *text;
+  gchar *text;
   element_t ch;
   xmlAttr *attribute;
 
-  text_escaped = NULL;
-
   g_string_append_printf (string, "<%s", element_name (element));
 
   attribute = element->properties;
@@ -2290,10 +4286,9 @@ print_element_to_string (element_t element, GString *string)
 
       value = xmlNodeListGetString (element->doc, attribute->children, 1);
 
-      text_escaped = g_markup_escape_text ((gchar *) value, -1);
-      g_string_append_printf (string, " %s=\"%s\"", attribute->name,
-                              text_escaped);
-      g_free (text_escaped);
+      g_string_append_printf (string, " %s=\"", attribute->name);
+      xml_string_append_escaped (string, (gchar *) value, -1);
+      g_string_append_c (string, '"');
 
       xmlFree (value);
 
@@ -2303,10 +4298,8 @@ print_element_to_string (element_t element, GString *string)
   g_string_append_printf (string, ">");
 
   text = element_text (element);
-  text_escaped = g_markup_escape_text (text, -1);
+  xml_string_append_escaped (string, text, -1);
   g_free (text);
-  g_string_append_printf (string, "%s", text_escaped);
-  g_free (text_escaped);
 
   ch = element_first_child (element);
   while (ch)
@@ -2332,8 +4325,32 @@ struct xml_file_iterator_struct
   xmlParserCtxtPtr parser_ctxt; //< libXML parser context for building DOM
   gchar *file_path;             //< Path to the XML file being processed
   FILE *file;                   //< Stream pointer for the XML file
+  const char *map;              //< Mapping of the file, NULL if not mapped
+  gsize map_size;               //< Size of the mapping
+  gsize offset;                 //< Offset of the next byte to parse
+  GQueue *offset_queue;         //< End offsets of the queued subelements
+  gsize checkpoint;             //< End offset of the last subelement done
+  gsize last_offset;            //< Offset after the last parser callback,
+                                //< while finding the prefix
+  gsize prefix_end;             //< Offset of the first subelement
+  gboolean find_prefix;         //< Whether to stop at the first subelement
 };
 
+/**
+ * @brief Get the offset in the file up to which the parser has parsed.
+ *
+ * @param[in] iterator  Iterator.
+ *
+ * @return Offset.
+ */
+static gsize
+xml_file_iterator_parsed (xml_file_iterator_t iterator)
+{
+  long consumed = xmlByteConsumed (iterator->parser_ctxt);
+
+  return consumed > 0 ? (gsize) consumed : 0;
+}
+
 /**
  * @brief XML file iterator parser callback for element start.
  *
@@ -2361,9 +4378,21 @@ xml_file_iterator_start_element_ns (void *ctx, const xmlChar *localname,
                                     const xmlChar **attributes)
 {
   xml_file_iterator_t iterator = (xml_file_iterator_t) ctx;
+
+  if (iterator->parser_ctxt->nodeNr == iterator->output_depth
+      && iterator->find_prefix)
+    {
+      /* Resuming, only the part before the first subelement is needed. */
+      iterator->prefix_end = iterator->last_offset;
+      iterator->find_prefix = FALSE;
+      xmlStopParser (iterator->parser_ctxt);
+      return;
+    }
   xmlSAX2StartElementNs (iterator->parser_ctxt, localname, prefix, URI,
                          nb_namespaces, namespaces, nb_attributes, nb_defaulted,
                          attributes);
+  if (iterator->find_prefix)
+    iterator->last_offset = xml_file_iterator_parsed (iterator);
 }
 
 /**
@@ -2405,6 +4434,9 @@ xml_file_iterator_end_element_ns (void *ctx, const xmlChar *localname,
               if (child_copy)
                 {
                   g_queue_push_tail (iterator->element_queue, child_copy);
+                  g_queue_push_tail (
+                    iterator->offset_queue,
+                    GSIZE_TO_POINTER (xml_file_iterator_parsed (iterator)));
                 }
             }
 
@@ -2414,6 +4446,8 @@ xml_file_iterator_end_element_ns (void *ctx, const xmlChar *localname,
           child = parent->children;
         }
     }
+  if (iterator->find_prefix)
+    iterator->last_offset = xml_file_iterator_parsed (iterator);
 }
 
 /**
@@ -2745,6 +4779,8 @@ xml_file_iterator_characters (void *ctx, const xmlChar *ch, int len)
 {
   xml_file_iterator_t iterator = (xml_file_iterator_t) ctx;
   xmlSAX2Characters (iterator->parser_ctxt, ch, len);
+  if (iterator->find_prefix)
+    iterator->last_offset = xml_file_iterator_parsed (iterator);
 }
 
 /**
@@ -2782,6 +4818,8 @@ xml_file_iterator_processing_instruction (void *ctx, const xmlChar *target,
 {
   xml_file_iterator_t iterator = (xml_file_iterator_t) ctx;
   xmlSAX2ProcessingInstruction (iterator->parser_ctxt, target, data);
+  if (iterator->find_prefix)
+    iterator->last_offset = xml_file_iterator_parsed (iterator);
 }
 
 /**
@@ -2798,6 +4836,8 @@ xml_file_iterator_comment (void *ctx, const xmlChar *value)
 {
   xml_file_iterator_t iterator = (xml_file_iterator_t) ctx;
   xmlSAX2Comment (iterator->parser_ctxt, value);
+  if (iterator->find_prefix)
+    iterator->last_offset = xml_file_iterator_parsed (iterator);
 }
 
 /**
@@ -2870,6 +4910,8 @@ int
 xml_file_iterator_init_from_file_path (xml_file_iterator_t iterator,
                                        const char *file_path, int output_depth)
 {
+  struct stat st;
+
   if (iterator == NULL)
     return -1;
 
@@ -2888,7 +4930,23 @@ xml_file_iterator_init_from_file_path (xml_file_iterator_t iterator,
   if (iterator->file == NULL)
     return 2;
 
+  /* Map regular files, to parse them without copying. */
+  if (fstat (fileno (iterator->file), &st) == 0 && S_ISREG (st.st_mode)
+      && st.st_size > 0)
+    {
+      void *map = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE,
+                        fileno (iterator->file), 0);
+
+      if (map != MAP_FAILED)
+        {
+          madvise (map, st.st_size, MADV_SEQUENTIAL);
+          iterator->map = map;
+          iterator->map_size = st.st_size;
+        }
+    }
+
   iterator->element_queue = g_queue_new ();
+  iterator->offset_queue = g_queue_new ();
 
   iterator->file_path = g_strdup (file_path);
 
@@ -2914,6 +4972,9 @@ xml_file_iterator_free (xml_file_iterator_t iterator)
   if (iterator == NULL)
     return;
 
+  if (iterator->map)
+    munmap ((void *) iterator->map, iterator->map_size);
+
   if (iterator->file)
     {
       fclose (iterator->file);
@@ -2921,6 +4982,9 @@ xml_file_iterator_free (xml_file_iterator_t iterator)
 
   g_free (iterator->file_path);
 
+  if (iterator->offset_queue)
+    g_queue_free (iterator->offset_queue);
+
   if (iterator->element_queue)
     {
       g_queue_free_full (iterator->element_queue,
@@ -2953,11 +5017,14 @@ xml_file_iterator_rewind (xml_file_iterator_t iterator)
     {
       rewind (iterator->file);
     }
+  iterator->offset = 0;
+  iterator->checkpoint = 0;
 
   if (iterator->element_queue)
     {
       g_queue_clear_full (iterator->element_queue,
                           (GDestroyNotify) (element_free));
+      g_queue_clear (iterator->offset_queue);
     }
 
   if (iterator->parser_ctxt)
@@ -2978,16 +5045,64 @@ xml_file_iterator_rewind (xml_file_iterator_t iterator)
 #define XML_FILE_ITERATOR_BUFFER_SIZE 8192
 
 /**
- * @brief Get the next subelement from a XML file iterator
+ * @brief Size of the chunks parsed from a mapped file.
+ */
+#define XML_FILE_ITERATOR_MAP_CHUNK 65536
+
+/**
+ * @brief Read the next chunk of the file of an XML file iterator.
+ *
+ * @param[in]  iterator  The XML file iterator.
+ * @param[in]  buffer    Buffer of XML_FILE_ITERATOR_BUFFER_SIZE bytes, used
+ *                       if the file is not mapped.
+ * @param[in]  limit     Offset at which to stop reading.
+ * @param[out] chunk     Start of the chunk.
+ *
+ * @return Size of the chunk, 0 at the end, -1 on error.
+ */
+static gssize
+xml_file_iterator_read (xml_file_iterator_t iterator, char *buffer,
+                        gsize limit, const char **chunk)
+{
+  gsize size;
+
+  if (iterator->map)
+    {
+      limit = MIN (limit, iterator->map_size);
+      if (iterator->offset >= limit)
+        return 0;
+      size = MIN (limit - iterator->offset, XML_FILE_ITERATOR_MAP_CHUNK);
+      *chunk = iterator->map + iterator->offset;
+    }
+  else
+    {
+      if (iterator->offset >= limit)
+        return 0;
+      size = fread (buffer, 1,
+                    MIN (limit - iterator->offset,
+                         XML_FILE_ITERATOR_BUFFER_SIZE),
+                    iterator->file);
+      if (size == 0 && ferror (iterator->file))
+        return -1;
+      *chunk = buffer;
+    }
+  iterator->offset += size;
+  return size;
+}
+
+/**
+ * @brief Get the next subelement from a XML file iterator, with its offset.
  *
  * @param[in]  iterator   The XML file iterator to get the element from.
+ * @param[out] offset     Offset after the end of the subelement.
  * @param[out] error      Error message output, set to NULL on success / EOF
  *
  * @return The next subelement (free with element_free) or NULL if finished or
  *         on error.
  */
-element_t
-xml_file_iterator_next (xml_file_iterator_t iterator, gchar **error)
+static element_t
+xml_file_iterator_next_offset (xml_file_iterator_t iterator, gsize *offset,
+                               gchar **error)
 {
   gboolean continue_read = TRUE;
 
@@ -3003,28 +5118,25 @@ xml_file_iterator_next (xml_file_iterator_t iterator, gchar **error)
 
   while (continue_read && g_queue_is_empty (iterator->element_queue))
     {
-      int chars_read;
+      gssize chars_read;
       char buffer[XML_FILE_ITERATOR_BUFFER_SIZE];
+      const char *chunk;
 
-      chars_read =
-        fread (buffer, 1, XML_FILE_ITERATOR_BUFFER_SIZE, iterator->file);
-      if (chars_read == 0)
+      chars_read = xml_file_iterator_read (iterator, buffer, G_MAXSIZE, &chunk);
+      if (chars_read < 0)
         {
-          if (feof (iterator->file))
-            {
-              continue_read = FALSE;
-            }
-          else if (ferror (iterator->file))
-            {
-              if (error)
-                *error = g_strdup ("error reading file");
-              return NULL;
-            }
+          if (error)
+            *error = g_strdup ("error reading file");
+          return NULL;
+        }
+      else if (chars_read == 0)
+        {
+          continue_read = FALSE;
         }
       else
         {
           int ret;
-          ret = xmlParseChunk (iterator->parser_ctxt, buffer, chars_read,
+          ret = xmlParseChunk (iterator->parser_ctxt, chunk, chars_read,
                                continue_read == 0);
           if (ret)
             {
@@ -3045,8 +5157,255 @@ xml_file_iterator_next (xml_file_iterator_t iterator, gchar **error)
 
   if (!g_queue_is_empty (iterator->element_queue))
     {
+      *offset = GPOINTER_TO_SIZE (g_queue_pop_head (iterator->offset_queue));
       return g_queue_pop_head (iterator->element_queue);
     }
 
   return NULL;
 }
+
+/**
+ * @brief Get the next subelement from a XML file iterator
+ *
+ * @param[in]  iterator   The XML file iterator to get the element from.
+ * @param[out] error      Error message output, set to NULL on success / EOF
+ *
+ * @return The next subelement (free with element_free) or NULL if finished or
+ *         on error.
+ */
+element_t
+xml_file_iterator_next (xml_file_iterator_t iterator, gchar **error)
+{
+  element_t element;
+  gsize offset;
+
+  element = xml_file_iterator_next_offset (iterator, &offset, error);
+  if (element)
+    __atomic_store_n (&iterator->checkpoint, offset, __ATOMIC_RELAXED);
+  return element;
+}
+
+/**
+ * @brief Get the checkpoint of an XML file iterator.
+ *
+ * The checkpoint is the offset in the file after the last subelement that
+ * was returned by xml_file_iterator_next or processed by
+ * xml_file_iterator_run, with all subelements before it processed too.
+ * It may be read from the processing threads.
+ *
+ * @param[in]  iterator  The XML file iterator.
+ *
+ * @return Offset to pass to xml_file_iterator_resume.
+ */
+gsize
+xml_file_iterator_checkpoint (xml_file_iterator_t iterator)
+{
+  return __atomic_load_n (&iterator->checkpoint, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Resume an XML file iterator after a checkpoint.
+ *
+ * Parses the start of the file up to the first subelement, to open the
+ * enclosing elements, and continues after the checkpoint.  The subelements
+ * must share their enclosing elements, like the items of a feed file.
+ *
+ * @param[in]  iterator    The XML file iterator, freshly initialized or
+ *                         rewound.
+ * @param[in]  checkpoint  Checkpoint from xml_file_iterator_checkpoint.
+ *
+ * @return 0 success, 1 error creating parser context, 2 error reading file,
+ *         3 checkpoint out of range or no subelement before it.
+ */
+int
+xml_file_iterator_resume (xml_file_iterator_t iterator, gsize checkpoint)
+{
+  char buffer[XML_FILE_ITERATOR_BUFFER_SIZE];
+  const char *chunk;
+  gssize chars_read;
+
+  if (iterator == NULL || iterator->initialized == 0)
+    return 1;
+  if (checkpoint == 0)
+    return 0;
+  if (iterator->map && checkpoint > iterator->map_size)
+    return 3;
+
+  /* Find the end of the part before the first subelement. */
+  iterator->prefix_end = 0;
+  iterator->last_offset = 0;
+  iterator->find_prefix = TRUE;
+  while (iterator->find_prefix
+         && (chars_read = xml_file_iterator_read (iterator, buffer, checkpoint,
+                                                  &chunk))
+              > 0)
+    xmlParseChunk (iterator->parser_ctxt, chunk, chars_read, 0);
+  iterator->find_prefix = FALSE;
+  if (iterator->prefix_end == 0)
+    return 3;
+
+  /* Parse that part with a new parser, and continue after the checkpoint. */
+  if (xml_file_iterator_rewind (iterator))
+    return 1;
+  while ((chars_read = xml_file_iterator_read (iterator, buffer,
+                                               iterator->prefix_end, &chunk))
+         > 0)
+    if (xmlParseChunk (iterator->parser_ctxt, chunk, chars_read, 0))
+      return 3;
+  if (chars_read < 0)
+    return 2;
+
+  if (iterator->map == NULL && fseeko (iterator->file, checkpoint, SEEK_SET))
+    return 2;
+  iterator->offset = checkpoint;
+  iterator->checkpoint = checkpoint;
+  return 0;
+}
+
+/**
+ * @brief Subelement queued for processing by xml_file_iterator_run.
+ */
+typedef struct
+{
+  element_t element; ///< Subelement.
+  gsize sequence;    ///< Position of the subelement in the file.
+  gsize offset;      ///< Offset after the end of the subelement.
+} xml_file_iterator_item_t;
+
+/**
+ * @brief State shared by the threads of xml_file_iterator_run.
+ */
+typedef struct
+{
+  xml_file_iterator_t iterator;  ///< Iterator.
+  xml_file_iterator_func_t func; ///< Function to process subelements.
+  gpointer data;                 ///< Data for func.
+  GMutex mutex;                  ///< Mutex for the fields below.
+  GCond cond;                    ///< Signalled when an item is done.
+  guint in_flight;               ///< Number of items queued or processing.
+  guint max_in_flight;           ///< Maximum of in_flight.
+  gsize *done_offsets;           ///< Offsets of done items, 0 if not done,
+                                 ///< by sequence modulo max_in_flight.
+  gsize next_commit;             ///< Sequence of the next item to commit.
+} xml_file_iterator_run_t;
+
+/**
+ * @brief Process a subelement in a thread of xml_file_iterator_run.
+ *
+ * @param[in]  data  The item.
+ * @param[in]  user_data  The state.
+ */
+static void
+xml_file_iterator_run_item (gpointer data, gpointer user_data)
+{
+  xml_file_iterator_item_t *item = data;
+  xml_file_iterator_run_t *run = user_data;
+
+  run->func (item->element, run->data);
+  element_free (item->element);
+
+  g_mutex_lock (&run->mutex);
+  run->done_offsets[item->sequence % run->max_in_flight] = item->offset;
+  /* Advance the checkpoint over the items done in file order. */
+  while (run->done_offsets[run->next_commit % run->max_in_flight])
+    {
+      gsize *slot = &run->done_offsets[run->next_commit % run->max_in_flight];
+
+      __atomic_store_n (&run->iterator->checkpoint, *slot, __ATOMIC_RELAXED);
+      *slot = 0;
+      run->next_commit++;
+    }
+  run->in_flight--;
+  g_cond_signal (&run->cond);
+  g_mutex_unlock (&run->mutex);
+  g_free (item);
+}
+
+/**
+ * @brief Process all the remaining subelements of an XML file iterator.
+ *
+ * The file is parsed in the calling thread, while a pool of threads calls
+ * the function on the subelements.  The function may be called concurrently
+ * and out of order.  Each subelement is freed after the function returns.
+ * The number of subelements waiting for a thread is bounded, so that memory
+ * stays bounded for large files.
+ *
+ * @param[in]  iterator  The XML file iterator.
+ * @param[in]  threads   Number of processing threads, 1 or less to process
+ *                       the subelements in the calling thread.
+ * @param[in]  func      Function to call with each subelement.
+ * @param[in]  data      Data for func.
+ * @param[out] error     Error message output, set to NULL on success.
+ *
+ * @return 0 success, -1 error.
+ */
+int
+xml_file_iterator_run (xml_file_iterator_t iterator, int threads,
+                       xml_file_iterator_func_t func, gpointer data,
+                       gchar **error)
+{
+  xml_file_iterator_run_t run;
+  GThreadPool *pool;
+  element_t element;
+  gsize offset, sequence;
+  gchar *run_error = NULL;
+
+  if (error)
+    *error = NULL;
+
+  if (threads <= 1)
+    {
+      while ((element = xml_file_iterator_next (iterator, &run_error)))
+        {
+          func (element, data);
+          element_free (element);
+        }
+      goto done;
+    }
+
+  run.iterator = iterator;
+  run.func = func;
+  run.data = data;
+  g_mutex_init (&run.mutex);
+  g_cond_init (&run.cond);
+  run.in_flight = 0;
+  run.max_in_flight = 64 * threads;
+  run.done_offsets = g_new0 (gsize, run.max_in_flight);
+  run.next_commit = 0;
+  pool = g_thread_pool_new (xml_file_iterator_run_item, &run, threads, TRUE,
+                            NULL);
+
+  sequence = 0;
+  while ((element =
+            xml_file_iterator_next_offset (iterator, &offset, &run_error)))
+    {
+      xml_file_iterator_item_t *item = g_malloc (sizeof (*item));
+
+      g_mutex_lock (&run.mutex);
+      while (run.in_flight == run.max_in_flight)
+        g_cond_wait (&run.cond, &run.mutex);
+      run.in_flight++;
+      g_mutex_unlock (&run.mutex);
+
+      item->element = element;
+      item->sequence = sequence++;
+      /* A done offset of 0 means not done, offsets are after a subelement. */
+      item->offset = MAX (offset, 1);
+      g_thread_pool_push (pool, item, NULL);
+    }
+
+  /* Wait for the threads to finish. */
+  g_thread_pool_free (pool, FALSE, TRUE);
+  g_free (run.done_offsets);
+  g_cond_clear (&run.cond);
+  g_mutex_clear (&run.mutex);
+
+done:
+  if (run_error == NULL)
+    return 0;
+  if (error)
+    *error = run_error;
+  else
+    g_free (run_error);
+  return -1;
+}
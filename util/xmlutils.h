@@ -45,18 +45,39 @@ xml_handle_text (context_data_t *, const gchar *, gsize);
  */
 typedef GSList *entities_t;
 
+/**
+ * @brief Memory of an entity tree parsed by parse_entity_arena.
+ */
+typedef struct entity_arena entity_arena_t;
+
 /**
  * @brief XML element.
  */
 struct entity_s
 {
-  char *name;             ///< Name.
-  char *text;             ///< Text.
-  GHashTable *attributes; ///< Attributes.
-  entities_t entities;    ///< Children.
+  char *name;                    ///< Name.
+  char *text;                    ///< Text.
+  GHashTable *attributes;        ///< Attributes, when there are many.
+  entities_t entities;           ///< Children.
+  const gchar **attribute_array; ///< Few attributes or attributes in an arena,
+                                 ///< names and values alternating, NULL
+                                 ///< terminated.
+  entity_arena_t *arena;         ///< Arena of the tree, NULL if not in one.
+  GHashTable *child_index;       ///< First child by name, built on lookup.
+  entities_t child_index_tail;   ///< Last child in the index.
 };
 typedef struct entity_s *entity_t;
 
+/**
+ * @brief Function called with each element streamed while reading.
+ */
+typedef void (*entity_stream_func_t) (entity_t, gpointer);
+
+/**
+ * @brief Function called with each chunk of a response while reading.
+ */
+typedef int (*read_chunk_func_t) (const char *, gsize, gpointer);
+
 /**
  * @brief Data for xml search functions.
  */
@@ -80,6 +101,12 @@ int compare_entities (entity_t, entity_t);
 entity_t
 entity_child (entity_t, const char *);
 
+entities_t
+entity_children_named (entity_t, const char *);
+
+entities_t
+next_entities_named (entities_t, const char *);
+
 const char *
 entity_attribute (entity_t, const char *);
 
@@ -118,6 +145,19 @@ try_read_entity (gnutls_session_t *, int, entity_t *);
 int
 try_read_entity_c (gvm_connection_t *, int, entity_t *);
 
+int
+try_read_entity_stream_c (gvm_connection_t *, int, int, entity_stream_func_t,
+                          gpointer, entity_t *);
+
+void
+entity_stream_children (entity_t, int, entity_stream_func_t, gpointer);
+
+int
+try_read_chunks (gnutls_session_t *, int, read_chunk_func_t, gpointer);
+
+int
+try_read_chunks_c (gvm_connection_t *, int, read_chunk_func_t, gpointer);
+
 int
 read_entity (gnutls_session_t *, entity_t *);
 
@@ -127,6 +167,26 @@ read_entity_s (int, entity_t *);
 int
 read_entity_c (gvm_connection_t *, entity_t *);
 
+/**
+ * @brief Incremental entity parser.
+ */
+typedef struct entity_parser entity_parser_t;
+
+entity_parser_t *
+entity_parser_new (void);
+
+int
+entity_parser_feed (entity_parser_t *, const char *, gsize);
+
+int
+entity_parser_feed_part (entity_parser_t *, const char *, gsize, gsize *);
+
+entity_t
+entity_parser_take (entity_parser_t *);
+
+void
+entity_parser_free (entity_parser_t *);
+
 int
 read_string (gnutls_session_t *, GString **);
 
@@ -139,6 +199,9 @@ read_text_c (gvm_connection_t *, char **);
 int
 parse_entity (const char *, entity_t *);
 
+int
+parse_entity_arena (const char *, entity_t *);
+
 void
 print_entity_to_string (entity_t entity, GString *string);
 
@@ -147,11 +210,21 @@ int xml_count_entities (entities_t);
 void
 xml_string_append (GString *, const char *, ...);
 
+void
+xml_string_append_escaped (GString *, const char *, gssize);
+
 /* XML file utilities */
 
 int
 find_element_in_xml_file (gchar *, gchar *, GHashTable *);
 
+int
+find_element_in_xml_file_indexed (const gchar *, const gchar *, GHashTable *,
+                                  const gchar *);
+
+void
+xml_file_index_cache_clear (void);
+
 /* The new faster parser that uses libxml2. */
 
 typedef struct _xmlNode *element_t;
@@ -200,4 +273,19 @@ int xml_file_iterator_rewind (xml_file_iterator_t);
 element_t
 xml_file_iterator_next (xml_file_iterator_t, gchar **);
 
+gsize
+xml_file_iterator_checkpoint (xml_file_iterator_t);
+
+int
+xml_file_iterator_resume (xml_file_iterator_t, gsize);
+
+/**
+ * @brief Function called with each subelement by xml_file_iterator_run.
+ */
+typedef void (*xml_file_iterator_func_t) (element_t, gpointer);
+
+int
+xml_file_iterator_run (xml_file_iterator_t, int, xml_file_iterator_func_t,
+                       gpointer, gchar **);
+
 #endif /* not _GVM_XMLUTILS_H */
@@ -7,6 +7,7 @@
 
 #include <cgreen/cgreen.h>
 #include <cgreen/mocks.h>
+#include <sys/socket.h>
 
 Describe (xmlutils);
 BeforeEach (xmlutils)
@@ -162,6 +163,266 @@ Ensure (xmlutils, next_entities_handles_multiple_children)
   children = next_entities (children);
 }
 
+/* entity_child */
+
+Ensure (xmlutils, entity_child_finds_children_of_large_entities)
+{
+  entity_t entity, child;
+  entities_t list;
+  GString *xml;
+  int index;
+
+  xml = g_string_new ("<top>");
+  for (index = 0; index < 20; index++)
+    g_string_append_printf (xml, "<c%i>%i</c%i><r>%i</r>", index, index,
+                            index, index);
+  g_string_append (xml, "</top>");
+  assert_that (parse_entity (xml->str, &entity), is_equal_to (0));
+  g_string_free (xml, TRUE);
+
+  assert_that (entity_text (entity_child (entity, "c19")),
+               is_equal_to_string ("19"));
+  assert_that (entity_text (entity_child (entity, "c0")),
+               is_equal_to_string ("0"));
+  assert_that (entity_child (entity, "missing"), is_null);
+  assert_that (entity->child_index, is_not_null);
+
+  /* Children appended after the index was built. */
+  add_entity (&entity->entities, "late", "late text");
+  assert_that (entity_text (entity_child (entity, "late")),
+               is_equal_to_string ("late text"));
+
+  index = 0;
+  for (list = entity_children_named (entity, "r"); list;
+       list = next_entities_named (list, "r"))
+    {
+      child = first_entity (list);
+      assert_that (entity_name (child), is_equal_to_string ("r"));
+      assert_that (atoi (entity_text (child)), is_equal_to (index));
+      index++;
+    }
+  assert_that (index, is_equal_to (20));
+
+  free_entity (entity);
+}
+
+Ensure (xmlutils, entity_attribute_finds_few_and_many_attributes)
+{
+  entity_t entity, child;
+  const gchar *xml;
+
+  xml = "<top a=\"1\" b=\"2\"><c a=\"1\" b=\"2\" c=\"3\"/></top>";
+
+  assert_that (parse_entity (xml, &entity), is_equal_to (0));
+  assert_that (entity->attributes, is_null);
+  assert_that (entity_attribute (entity, "a"), is_equal_to_string ("1"));
+  assert_that (entity_attribute (entity, "b"), is_equal_to_string ("2"));
+  assert_that (entity_attribute (entity, "c"), is_null);
+
+  child = entity_child (entity, "c");
+  assert_that (child->attributes, is_not_null);
+  assert_that (entity_attribute (child, "c"), is_equal_to_string ("3"));
+  free_entity (entity);
+}
+
+/* parse_entity_arena */
+
+Ensure (xmlutils, parse_entity_arena_parses_tree)
+{
+  entity_t entity, child, other;
+  entities_t children;
+  const gchar *xml;
+
+  xml = "<top a=\"1\" b=\"two\"><x c=\"3\">x1</x><y>y &amp; z</y><x>x2</x>"
+        "</top>";
+
+  assert_that (parse_entity_arena (xml, &entity), is_equal_to (0));
+
+  assert_that (entity_name (entity), is_equal_to_string ("top"));
+  assert_that (entity_text (entity), is_equal_to_string (""));
+  assert_that (entity_attribute (entity, "a"), is_equal_to_string ("1"));
+  assert_that (entity_attribute (entity, "b"), is_equal_to_string ("two"));
+  assert_that (entity_attribute (entity, "c"), is_null);
+
+  children = entity->entities;
+  child = first_entity (children);
+  assert_that (entity_name (child), is_equal_to_string ("x"));
+  assert_that (entity_text (child), is_equal_to_string ("x1"));
+  assert_that (entity_attribute (child, "c"), is_equal_to_string ("3"));
+  children = next_entities (children);
+  child = first_entity (children);
+  assert_that (entity_text (child), is_equal_to_string ("y & z"));
+  assert_that (entity_attribute (child, "c"), is_null);
+  children = next_entities (children);
+  other = first_entity (children);
+  assert_that (entity_text (other), is_equal_to_string ("x2"));
+  /* Names are interned. */
+  assert_that (entity_name (other),
+               is_equal_to (entity_name (first_entity (entity->entities))));
+  assert_that (next_entities (children), is_null);
+  assert_that (xml_count_entities (entity->entities), is_equal_to (3));
+  assert_that (entity_child (entity, "y"), is_equal_to (child));
+
+  /* Freeing a child leaves the tree. */
+  free_entity (child);
+  assert_that (entity_text (child), is_equal_to_string ("y & z"));
+  free_entity (entity);
+}
+
+Ensure (xmlutils, parse_entity_arena_compares_with_parse_entity)
+{
+  entity_t entity, arena_entity;
+  GString *string, *arena_string;
+  const gchar *xml;
+
+  xml = "<top a=\"1\"><x c=\"3\">x1</x><y></y></top>";
+
+  assert_that (parse_entity (xml, &entity), is_equal_to (0));
+  assert_that (parse_entity_arena (xml, &arena_entity), is_equal_to (0));
+  assert_that (compare_entities (entity, arena_entity), is_equal_to (0));
+  assert_that (compare_entities (arena_entity, entity), is_equal_to (0));
+
+  string = g_string_new ("");
+  arena_string = g_string_new ("");
+  print_entity_to_string (entity, string);
+  print_entity_to_string (arena_entity, arena_string);
+  assert_that (arena_string->str, is_equal_to_string (string->str));
+
+  g_string_free (string, TRUE);
+  g_string_free (arena_string, TRUE);
+  free_entity (entity);
+  free_entity (arena_entity);
+}
+
+Ensure (xmlutils, parse_entity_arena_fails_on_bad_xml)
+{
+  entity_t entity = NULL;
+
+  assert_that (parse_entity_arena ("<top><a></b></top>", &entity),
+               is_equal_to (-2));
+  assert_that (parse_entity_arena ("<top><a></a>", &entity), is_equal_to (-3));
+  assert_that (entity, is_null);
+}
+
+/* try_read_entity_stream_c */
+
+static void
+collect_streamed (entity_t entity, gpointer texts)
+{
+  g_ptr_array_add ((GPtrArray *) texts,
+                   g_strdup_printf ("%s:%s", entity_name (entity),
+                                    entity_text (entity_child (entity, "v"))));
+}
+
+Ensure (xmlutils, try_read_entity_stream_c_streams_elements_at_depth)
+{
+  gvm_connection_t connection;
+  GPtrArray *texts;
+  entity_t entity;
+  int sockets[2];
+  const char *xml;
+
+  xml = "<r status=\"200\"><count>2</count><results><result><v>a</v>"
+        "</result><result><v>b</v></result></results></r>";
+  assert_that (socketpair (AF_UNIX, SOCK_STREAM, 0, sockets), is_equal_to (0));
+  assert_that (write (sockets[1], xml, strlen (xml)),
+               is_equal_to (strlen (xml)));
+  close (sockets[1]);
+
+  memset (&connection, 0, sizeof (connection));
+  connection.socket = sockets[0];
+  texts = g_ptr_array_new_with_free_func (g_free);
+  assert_that (try_read_entity_stream_c (&connection, 0, 2, collect_streamed,
+                                         texts, &entity),
+               is_equal_to (0));
+  close (sockets[0]);
+
+  assert_that (texts->len, is_equal_to (2));
+  assert_that (g_ptr_array_index (texts, 0), is_equal_to_string ("result:a"));
+  assert_that (g_ptr_array_index (texts, 1), is_equal_to_string ("result:b"));
+  assert_that (entity_attribute (entity, "status"), is_equal_to_string ("200"));
+  assert_that (entity_text (entity_child (entity, "count")),
+               is_equal_to_string ("2"));
+  assert_that (entity_child (entity, "results"), is_not_null);
+  assert_that (entity_child (entity_child (entity, "results"), "result"),
+               is_null);
+
+  g_ptr_array_free (texts, TRUE);
+  free_entity (entity);
+}
+
+/* entity_parser */
+
+Ensure (xmlutils, entity_parser_parses_xml_fed_in_pieces)
+{
+  entity_parser_t *parser;
+  entity_t entity;
+  const char *xml;
+  gsize index;
+
+  xml = "<r status=\"200\"><a>x &amp; y</a><b/></r>";
+  parser = entity_parser_new ();
+  for (index = 0; index < strlen (xml) - 1; index++)
+    {
+      assert_that (entity_parser_feed (parser, xml + index, 1),
+                   is_equal_to (0));
+      assert_that (entity_parser_take (parser), is_null);
+    }
+  assert_that (entity_parser_feed (parser, xml + index, 1), is_equal_to (1));
+  /* Later pieces are ignored. */
+  assert_that (entity_parser_feed (parser, "<s/>", 4), is_equal_to (1));
+
+  entity = entity_parser_take (parser);
+  assert_that (entity, is_not_null);
+  assert_that (entity_parser_take (parser), is_null);
+  entity_parser_free (parser);
+
+  assert_that (entity_attribute (entity, "status"), is_equal_to_string ("200"));
+  assert_that (entity_text (entity_child (entity, "a")),
+               is_equal_to_string ("x & y"));
+  assert_that (entity_child (entity, "b"), is_not_null);
+  free_entity (entity);
+}
+
+Ensure (xmlutils, entity_parser_fails_on_bad_xml)
+{
+  entity_parser_t *parser;
+
+  parser = entity_parser_new ();
+  assert_that (entity_parser_feed (parser, "<r><a></b>", 10),
+               is_equal_to (-2));
+  assert_that (entity_parser_feed (parser, "</r>", 4), is_equal_to (-2));
+  assert_that (entity_parser_take (parser), is_null);
+  entity_parser_free (parser);
+}
+
+Ensure (xmlutils, entity_parser_feed_part_leaves_next_entity)
+{
+  entity_parser_t *parser;
+  entity_t entity;
+  const char *xml;
+  gsize used;
+
+  xml = "<r status=\"200\"><a>1</a></r><r status=\"404\"/>";
+  parser = entity_parser_new ();
+  assert_that (entity_parser_feed_part (parser, xml, strlen (xml), &used),
+               is_equal_to (1));
+  assert_that (used, is_equal_to (strlen ("<r status=\"200\"><a>1</a></r>")));
+  entity = entity_parser_take (parser);
+  assert_that (entity_attribute (entity, "status"), is_equal_to_string ("200"));
+  free_entity (entity);
+  entity_parser_free (parser);
+
+  parser = entity_parser_new ();
+  assert_that (entity_parser_feed_part (parser, xml + used,
+                                        strlen (xml + used), &used),
+               is_equal_to (1));
+  entity = entity_parser_take (parser);
+  assert_that (entity_attribute (entity, "status"), is_equal_to_string ("404"));
+  free_entity (entity);
+  entity_parser_free (parser);
+}
+
 /* parse_element */
 
 Ensure (xmlutils, parse_element_parses_simple_xml)
@@ -504,6 +765,209 @@ Ensure (xmlutils, print_element_to_string_prints)
   element_free (element);
 }
 
+/* xml_string_append_escaped */
+
+Ensure (xmlutils, xml_string_append_escaped_matches_g_markup_escape_text)
+{
+  const gchar *texts[] = {
+    "",
+    "plain",
+    "a < b && c > d 'quoted' \"double\"",
+    "long clean run of text before a special character at the end <",
+    "tab\tnew line\nreturn\r control \x01\x1f\x7f end",
+    "C1 \xc2\x80 \xc2\x85 \xc2\x9f \xc2\xa0 \xc3\xa9 \xe2\x82\xac",
+    "<<<<<<<<<<<<<<<<&&&&&&&&&&&&&&&&>>>>>>>>>>>>>>>>>>>>",
+    NULL};
+  int index;
+
+  for (index = 0; texts[index]; index++)
+    {
+      GString *string = g_string_new ("prefix");
+      gchar *expected = g_markup_escape_text (texts[index], -1);
+
+      xml_string_append_escaped (string, texts[index], -1);
+      assert_that (string->str + strlen ("prefix"),
+                   is_equal_to_string (expected));
+      g_free (expected);
+      g_string_free (string, TRUE);
+    }
+}
+
+Ensure (xmlutils, print_entity_to_string_escapes)
+{
+  entity_t entity;
+  const gchar *xml;
+  GString *str;
+
+  xml = "<a aa=\"1 &amp; 2\">x &lt; y<b>&quot;q&quot;</b></a>";
+  str = g_string_new ("");
+
+  assert_that (parse_entity (xml, &entity), is_equal_to (0));
+  print_entity_to_string (entity, str);
+  assert_that (str->str,
+               is_equal_to_string ("<a aa=\"1 &amp; 2\">x &lt; y<b>&quot;q"
+                                   "&quot;</b></a>"));
+  g_string_free (str, TRUE);
+  free_entity (entity);
+}
+
+/* xml_file_iterator */
+
+/**
+ * @brief Write an XML file with items for the iterator tests.
+ *
+ * @param[in]  count  Number of items.
+ *
+ * @return Path of the file, to free.
+ */
+static gchar *
+write_items_file (int count)
+{
+  GString *xml;
+  gchar *path;
+  int fd, index;
+
+  xml = g_string_new ("<?xml version=\"1.0\"?>\n<list>\n");
+  for (index = 0; index < count; index++)
+    g_string_append_printf (xml, "  <item n=\"%i\">text %i</item>\n", index,
+                            index);
+  g_string_append (xml, "</list>\n");
+  fd = g_file_open_tmp ("xmlutils-tests-XXXXXX", &path, NULL);
+  assert_that (write (fd, xml->str, xml->len), is_equal_to (xml->len));
+  close (fd);
+  g_string_free (xml, TRUE);
+  return path;
+}
+
+Ensure (xmlutils, xml_file_iterator_resumes_after_checkpoint)
+{
+  xml_file_iterator_t iterator;
+  element_t element;
+  gchar *path, *error;
+  gsize checkpoint;
+  int index;
+
+  path = write_items_file (1000);
+
+  iterator = xml_file_iterator_new ();
+  assert_that (xml_file_iterator_init_from_file_path (iterator, path, 1),
+               is_equal_to (0));
+  for (index = 0; index < 600; index++)
+    {
+      element = xml_file_iterator_next (iterator, &error);
+      assert_that (element, is_not_null);
+      element_free (element);
+    }
+  checkpoint = xml_file_iterator_checkpoint (iterator);
+  assert_that (checkpoint, is_greater_than (0));
+  xml_file_iterator_free (iterator);
+
+  iterator = xml_file_iterator_new ();
+  assert_that (xml_file_iterator_init_from_file_path (iterator, path, 1),
+               is_equal_to (0));
+  assert_that (xml_file_iterator_resume (iterator, checkpoint),
+               is_equal_to (0));
+  for (index = 600; index < 1000; index++)
+    {
+      gchar *n;
+
+      element = xml_file_iterator_next (iterator, &error);
+      assert_that (element, is_not_null);
+      n = element_attribute (element, "n");
+      assert_that (atoi (n), is_equal_to (index));
+      g_free (n);
+      element_free (element);
+    }
+  assert_that (xml_file_iterator_next (iterator, &error), is_null);
+  assert_that (error, is_null);
+  xml_file_iterator_free (iterator);
+
+  unlink (path);
+  g_free (path);
+}
+
+static void
+count_item (element_t element, gpointer count)
+{
+  gchar *n = element_attribute (element, "n");
+
+  g_atomic_int_add ((gint *) count, atoi (n));
+  g_free (n);
+}
+
+Ensure (xmlutils, xml_file_iterator_run_processes_all_items)
+{
+  xml_file_iterator_t iterator;
+  gchar *path, *error, *contents;
+  gint sum = 0;
+
+  path = write_items_file (1000);
+
+  iterator = xml_file_iterator_new ();
+  assert_that (xml_file_iterator_init_from_file_path (iterator, path, 1),
+               is_equal_to (0));
+  assert_that (xml_file_iterator_run (iterator, 4, count_item, &sum, &error),
+               is_equal_to (0));
+  assert_that (error, is_null);
+  /* 0 + 1 + ... + 999. */
+  assert_that (sum, is_equal_to (499500));
+  /* All items are done, the checkpoint is after the last one. */
+  assert_that (g_file_get_contents (path, &contents, NULL, NULL), is_true);
+  assert_that (xml_file_iterator_checkpoint (iterator),
+               is_equal_to (g_strrstr (contents, "</item>")
+                            + strlen ("</item>") - contents));
+  g_free (contents);
+  xml_file_iterator_free (iterator);
+
+  unlink (path);
+  g_free (path);
+}
+
+Ensure (xmlutils, find_element_in_xml_file_finds_items)
+{
+  GHashTable *attributes;
+  gchar *path, *index_path;
+
+  path = write_items_file (1000);
+  index_path = g_strdup_printf ("%s.index", path);
+  attributes = g_hash_table_new (g_str_hash, g_str_equal);
+
+  g_hash_table_insert (attributes, "n", "999");
+  assert_that (find_element_in_xml_file (path, "item", attributes),
+               is_equal_to (1));
+  assert_that (find_element_in_xml_file_indexed (path, "item", attributes,
+                                                 NULL),
+               is_equal_to (1));
+  assert_that (g_file_test (index_path, G_FILE_TEST_EXISTS), is_true);
+
+  /* From the index file, then from the index in memory. */
+  xml_file_index_cache_clear ();
+  g_hash_table_insert (attributes, "n", "500");
+  assert_that (find_element_in_xml_file_indexed (path, "item", attributes,
+                                                 NULL),
+               is_equal_to (1));
+  g_hash_table_insert (attributes, "n", "1000");
+  assert_that (find_element_in_xml_file_indexed (path, "item", attributes,
+                                                 NULL),
+               is_equal_to (0));
+  assert_that (find_element_in_xml_file (path, "item", attributes),
+               is_equal_to (0));
+  g_hash_table_insert (attributes, "m", "1");
+  g_hash_table_insert (attributes, "n", "1");
+  assert_that (find_element_in_xml_file_indexed (path, "item", attributes,
+                                                 NULL),
+               is_equal_to (0));
+  assert_that (find_element_in_xml_file_indexed (path, "list", NULL, NULL),
+               is_equal_to (1));
+
+  xml_file_index_cache_clear ();
+  g_hash_table_destroy (attributes);
+  unlink (index_path);
+  g_free (index_path);
+  unlink (path);
+  g_free (path);
+}
+
 /* Test suite. */
 
 int
@@ -523,6 +987,24 @@ main (int argc, char **argv)
   add_test_with_context (suite, xmlutils,
                          next_entities_handles_multiple_children);
 
+  add_test_with_context (suite, xmlutils,
+                         entity_child_finds_children_of_large_entities);
+  add_test_with_context (suite, xmlutils,
+                         entity_attribute_finds_few_and_many_attributes);
+
+  add_test_with_context (suite, xmlutils, parse_entity_arena_parses_tree);
+  add_test_with_context (suite, xmlutils,
+                         parse_entity_arena_compares_with_parse_entity);
+  add_test_with_context (suite, xmlutils, parse_entity_arena_fails_on_bad_xml);
+
+  add_test_with_context (suite, xmlutils,
+                         try_read_entity_stream_c_streams_elements_at_depth);
+  add_test_with_context (suite, xmlutils,
+                         entity_parser_parses_xml_fed_in_pieces);
+  add_test_with_context (suite, xmlutils, entity_parser_fails_on_bad_xml);
+  add_test_with_context (suite, xmlutils,
+                         entity_parser_feed_part_leaves_next_entity);
+
   add_test_with_context (suite, xmlutils, parse_element_parses_simple_xml);
   add_test_with_context (suite, xmlutils,
                          parse_element_parses_xml_with_attributes);
@@ -536,6 +1018,16 @@ main (int argc, char **argv)
   add_test_with_context (suite, xmlutils, parse_element_free_using_child);
 
   add_test_with_context (suite, xmlutils, print_element_to_string_prints);
+  add_test_with_context (
+    suite, xmlutils, xml_string_append_escaped_matches_g_markup_escape_text);
+  add_test_with_context (suite, xmlutils, print_entity_to_string_escapes);
+
+  add_test_with_context (suite, xmlutils,
+                         xml_file_iterator_resumes_after_checkpoint);
+  add_test_with_context (suite, xmlutils,
+                         xml_file_iterator_run_processes_all_items);
+  add_test_with_context (suite, xmlutils,
+                         find_element_in_xml_file_finds_items);
 
   add_test_with_context (suite, xmlutils,
                          element_next_handles_multiple_children);